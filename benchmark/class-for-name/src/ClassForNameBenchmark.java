@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import com.google.caliper.SimpleBenchmark;
+
+public class ClassForNameBenchmark extends SimpleBenchmark {
+  // Boot classes, looked up in the boot class table.
+  static final String[] bootClassNames = {
+    "java.lang.Object",
+    "java.lang.String",
+    "java.util.ArrayList",
+    "java.util.HashMap",
+    "java.util.concurrent.ConcurrentHashMap",
+    "java.lang.reflect.Method",
+  };
+
+  // Application classes, looked up in the class table of the application class loader.
+  static final String[] appClassNames = {
+    "ClassForNameBenchmark",
+    "ClassForNameBenchmark$Worker",
+  };
+
+  public ClassForNameBenchmark() {
+    // Make sure all the classes are loaded before the benchmark starts.
+    lookup(bootClassNames, 1);
+    lookup(appClassNames, 1);
+  }
+
+  static class Worker extends Thread {
+    final String[] names;
+    final int reps;
+
+    Worker(String[] names, int reps) {
+      this.names = names;
+      this.reps = reps;
+    }
+
+    @Override
+    public void run() {
+      lookup(names, reps);
+    }
+  }
+
+  static void lookup(String[] names, int reps) {
+    try {
+      for (int i = 0; i < reps; ++i) {
+        for (String name : names) {
+          Class.forName(name);
+        }
+      }
+    } catch (ClassNotFoundException e) {
+      throw new RuntimeException(e);
+    }
+  }
+
+  // Each thread does `reps` iterations, so that the time per rep stays constant with perfect
+  // scaling.
+  static void lookupOnThreads(String[] names, int reps, int numThreads) {
+    Worker[] workers = new Worker[numThreads];
+    for (int i = 0; i < numThreads; ++i) {
+      workers[i] = new Worker(names, reps);
+      workers[i].start();
+    }
+    try {
+      for (Worker worker : workers) {
+        worker.join();
+      }
+    } catch (InterruptedException e) {
+      throw new RuntimeException(e);
+    }
+  }
+
+  public void timeBootClassForName1Thread(int reps) {
+    lookupOnThreads(bootClassNames, reps, 1);
+  }
+
+  public void timeBootClassForName4Threads(int reps) {
+    lookupOnThreads(bootClassNames, reps, 4);
+  }
+
+  public void timeBootClassForName8Threads(int reps) {
+    lookupOnThreads(bootClassNames, reps, 8);
+  }
+
+  public void timeAppClassForName1Thread(int reps) {
+    lookupOnThreads(appClassNames, reps, 1);
+  }
+
+  public void timeAppClassForName4Threads(int reps) {
+    lookupOnThreads(appClassNames, reps, 4);
+  }
+
+  public void timeAppClassForName8Threads(int reps) {
+    lookupOnThreads(appClassNames, reps, 8);
+  }
+}
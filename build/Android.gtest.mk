@@ -25,6 +25,8 @@ include art/build/Android.common_build.mk
 GTEST_DEX_DIRECTORIES := \
   AbstractMethod \
   AllFields \
+  ClassDependencies \
+  ClassDependenciesModified \
   ExceptionHandle \
   GetMethodSignature \
   ImageLayoutA \
@@ -71,13 +73,18 @@ $(ART_TEST_TARGET_GTEST_MainStripped_DEX): $(ART_TEST_TARGET_GTEST_Main_DEX)
 ART_GTEST_dex2oat_environment_tests_DEX_DEPS := Main MainStripped MultiDex MultiDexModifiedSecondary Nested
 
 ART_GTEST_class_linker_test_DEX_DEPS := Interfaces MultiDex MyClass Nested Statics StaticsFromCode
-ART_GTEST_compiler_driver_test_DEX_DEPS := AbstractMethod StaticLeafMethods ProfileTestMultiDex
+ART_GTEST_compile_scheduler_test_DEX_DEPS := Transaction
+ART_GTEST_compiler_driver_test_DEX_DEPS := AbstractMethod ClassDependencies ClassDependenciesModified \
+  StaticLeafMethods ProfileTestMultiDex Transaction
 ART_GTEST_dex_cache_test_DEX_DEPS := Main Packages
 ART_GTEST_dex_file_test_DEX_DEPS := GetMethodSignature Main Nested
-ART_GTEST_dex2oat_test_DEX_DEPS := $(ART_GTEST_dex2oat_environment_tests_DEX_DEPS)
+ART_GTEST_dex_layout_test_DEX_DEPS := Transaction
+ART_GTEST_dex2oat_test_DEX_DEPS := $(ART_GTEST_dex2oat_environment_tests_DEX_DEPS) ClassDependencies ClassDependenciesModified
 ART_GTEST_exception_test_DEX_DEPS := ExceptionHandle
+ART_GTEST_id_lookup_table_test_DEX_DEPS := Lookup
 ART_GTEST_image_test_DEX_DEPS := ImageLayoutA ImageLayoutB
 ART_GTEST_instrumentation_test_DEX_DEPS := Instrumentation
+ART_GTEST_jit_test_DEX_DEPS := ClassDependencies ClassDependenciesModified
 ART_GTEST_jni_compiler_test_DEX_DEPS := MyClassNatives
 ART_GTEST_jni_internal_test_DEX_DEPS := AllFields StaticLeafMethods
 ART_GTEST_oat_file_assistant_test_DEX_DEPS := $(ART_GTEST_dex2oat_environment_tests_DEX_DEPS)
@@ -191,6 +198,7 @@ RUNTIME_GTEST_COMMON_SRC_FILES := \
   runtime/arch/x86/instruction_set_features_x86_test.cc \
   runtime/arch/x86_64/instruction_set_features_x86_64_test.cc \
   runtime/barrier_test.cc \
+  runtime/base/adler32_test.cc \
   runtime/base/arena_allocator_test.cc \
   runtime/base/bit_field_test.cc \
   runtime/base/bit_utils_test.cc \
@@ -230,6 +238,7 @@ RUNTIME_GTEST_COMMON_SRC_FILES := \
   runtime/gc/task_processor_test.cc \
   runtime/gtest_test.cc \
   runtime/handle_scope_test.cc \
+  runtime/id_lookup_table_test.cc \
   runtime/indenter_test.cc \
   runtime/indirect_reference_table_test.cc \
   runtime/instrumentation_test.cc \
@@ -237,6 +246,7 @@ RUNTIME_GTEST_COMMON_SRC_FILES := \
   runtime/interpreter/safe_math_test.cc \
   runtime/interpreter/unstarted_runtime_test.cc \
   runtime/java_vm_ext_test.cc \
+  runtime/jit/jit_test.cc \
   runtime/jit/profile_compilation_info_test.cc \
   runtime/lambda/closure_test.cc \
   runtime/lambda/shorty_field_type_test.cc \
@@ -252,6 +262,7 @@ RUNTIME_GTEST_COMMON_SRC_FILES := \
   runtime/parsed_options_test.cc \
   runtime/prebuilt_tools_test.cc \
   runtime/reference_table_test.cc \
+  runtime/startup_timeline_test.cc \
   runtime/thread_pool_test.cc \
   runtime/transaction_test.cc \
   runtime/type_lookup_table_test.cc \
@@ -267,12 +278,16 @@ COMPILER_GTEST_COMMON_SRC_FILES := \
   runtime/reflection_test.cc \
   compiler/compiled_method_test.cc \
   compiler/debug/dwarf/dwarf_test.cc \
+  compiler/dex/dex_layout_test.cc \
+  compiler/driver/compile_scheduler_test.cc \
   compiler/driver/compiled_method_storage_test.cc \
   compiler/driver/compiler_driver_test.cc \
   compiler/elf_writer_test.cc \
   compiler/exception_test.cc \
   compiler/image_test.cc \
   compiler/jni/jni_compiler_test.cc \
+  compiler/linker/code_layout_test.cc \
+  compiler/linker/linker_patch_table_test.cc \
   compiler/linker/multi_oat_relative_patcher_test.cc \
   compiler/linker/output_stream_test.cc \
   compiler/oat_test.cc \
@@ -760,11 +775,13 @@ ART_TEST_TARGET_GTEST$(2ND_ART_PHONY_TEST_TARGET_SUFFIX)_RULES :=
 ART_TEST_TARGET_GTEST_RULES :=
 ART_GTEST_TARGET_ANDROID_ROOT :=
 ART_GTEST_class_linker_test_DEX_DEPS :=
+ART_GTEST_compile_scheduler_test_DEX_DEPS :=
 ART_GTEST_compiler_driver_test_DEX_DEPS :=
 ART_GTEST_dex_file_test_DEX_DEPS :=
 ART_GTEST_exception_test_DEX_DEPS :=
 ART_GTEST_elf_writer_test_HOST_DEPS :=
 ART_GTEST_elf_writer_test_TARGET_DEPS :=
+ART_GTEST_jit_test_DEX_DEPS :=
 ART_GTEST_jni_compiler_test_DEX_DEPS :=
 ART_GTEST_jni_internal_test_DEX_DEPS :=
 ART_GTEST_oat_file_assistant_test_DEX_DEPS :=
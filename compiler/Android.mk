@@ -21,18 +21,24 @@ include art/build/Android.common_build.mk
 LIBART_COMPILER_SRC_FILES := \
 	compiled_method.cc \
 	debug/elf_debug_writer.cc \
+	dex/dex_layout.cc \
 	dex/dex_to_dex_compiler.cc \
 	dex/verified_method.cc \
 	dex/verification_results.cc \
 	dex/quick_compiler_callbacks.cc \
 	dex/quick/dex_file_method_inliner.cc \
 	dex/quick/dex_file_to_method_inliner_map.cc \
+	driver/compile_cache.cc \
+	driver/compile_scheduler.cc \
 	driver/compiled_method_storage.cc \
 	driver/compiler_driver.cc \
 	driver/compiler_options.cc \
 	driver/dex_compilation_unit.cc \
+	driver/incremental_compilation.cc \
 	linker/buffered_output_stream.cc \
+	linker/code_layout.cc \
 	linker/file_output_stream.cc \
+	linker/linker_patch_table.cc \
 	linker/multi_oat_relative_patcher.cc \
 	linker/output_stream.cc \
 	linker/vector_output_stream.cc \
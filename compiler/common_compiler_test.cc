@@ -148,6 +148,10 @@ ProfileCompilationInfo* CommonCompilerTest::GetProfileCompilationInfo() {
   return nullptr;
 }
 
+bool CommonCompilerTest::IsAppImage() const {
+  return false;
+}
+
 void CommonCompilerTest::SetUp() {
   CommonRuntimeTest::SetUp();
   {
@@ -179,8 +183,8 @@ void CommonCompilerTest::CreateCompilerDriver(Compiler::Kind kind,
                                             kind,
                                             isa,
                                             instruction_set_features_.get(),
-                                            /* boot_image */ true,
-                                            /* app_image */ false,
+                                            /* boot_image */ !IsAppImage(),
+                                            /* app_image */ IsAppImage(),
                                             GetImageClasses(),
                                             GetCompiledClasses(),
                                             GetCompiledMethods(),
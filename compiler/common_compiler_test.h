@@ -78,6 +78,9 @@ class CommonCompilerTest : public CommonRuntimeTest {
 
   virtual ProfileCompilationInfo* GetProfileCompilationInfo();
 
+  // Whether the compiler-driver compiles an app image instead of a boot image.
+  virtual bool IsAppImage() const;
+
   virtual void TearDown();
 
   void CompileClass(mirror::ClassLoader* class_loader, const char* class_name)
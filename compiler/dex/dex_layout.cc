@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dex_layout.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/bit_utils.h"
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "dex_instruction-inl.h"
+#include "jit/offline_profiling_info.h"
+#include "leb128.h"
+#include "method_reference.h"
+#include "modifiers.h"
+
+namespace art {
+
+// Groups of items, in layout order.
+static constexpr uint8_t kGroupHot = 0u;      // Used by a method in the profile.
+static constexpr uint8_t kGroupStartup = 1u;  // Used by a class initializer of a profiled class.
+static constexpr uint8_t kGroupOther = 2u;
+
+static constexpr uint32_t kCodeItemAlignment = 4u;
+
+// Returns the size of the code item, including its tries and catch handlers.
+static uint32_t CodeItemSize(const DexFile::CodeItem& code_item) {
+  const uint8_t* start = reinterpret_cast<const uint8_t*>(&code_item);
+  if (code_item.tries_size_ == 0u) {
+    const uint16_t* insns_end = &code_item.insns_[code_item.insns_size_in_code_units_];
+    return reinterpret_cast<const uint8_t*>(insns_end) - start;
+  }
+  const uint8_t* ptr = DexFile::GetCatchHandlerData(code_item, 0u);
+  for (uint32_t handlers_size = DecodeUnsignedLeb128(&ptr); handlers_size != 0u; --handlers_size) {
+    int32_t size = DecodeSignedLeb128(&ptr);
+    for (int32_t i = 0, num_types = std::abs(size); i != num_types; ++i) {
+      DecodeUnsignedLeb128(&ptr);  // Type index.
+      DecodeUnsignedLeb128(&ptr);  // Address.
+    }
+    if (size <= 0) {
+      DecodeUnsignedLeb128(&ptr);  // Catch-all address.
+    }
+  }
+  return ptr - start;
+}
+
+// Encode `value` as ULEB128 in exactly `size` bytes, using a longer encoding than necessary
+// if needed.
+static void EncodeUnsignedLeb128FixedSize(uint8_t* dest, uint32_t value, size_t size) {
+  DCHECK_LE(UnsignedLeb128Size(value), size);
+  for (size_t i = 0; i + 1u != size; ++i) {
+    dest[i] = static_cast<uint8_t>(value & 0x7fu) | 0x80u;
+    value >>= 7;
+  }
+  dest[size - 1u] = static_cast<uint8_t>(value);
+}
+
+const DexFile::MapItem* DexLayout::FindSection(uint16_t type) const {
+  const DexFile::MapList* map_list = reinterpret_cast<const DexFile::MapList*>(
+      dex_file_.Begin() + dex_file_.GetHeader().map_off_);
+  for (uint32_t i = 0; i != map_list->size_; ++i) {
+    if (map_list->list_[i].type_ == type) {
+      return &map_list->list_[i];
+    }
+  }
+  return nullptr;
+}
+
+DexLayout::DataItem* DexLayout::FindItem(std::vector<DataItem>* items, uint32_t offset) {
+  auto it = std::lower_bound(items->begin(),
+                             items->end(),
+                             offset,
+                             [](const DataItem& item, uint32_t off) { return item.offset < off; });
+  return (it != items->end() && it->offset == offset) ? &*it : nullptr;
+}
+
+void DexLayout::MarkHotMethod(uint32_t method_idx, const DexFile::CodeItem* code_item) {
+  // Resolving and linking the method looks up its name, shorty and declaring class.
+  const DexFile::MethodId& method_id = dex_file_.GetMethodId(method_idx);
+  hot_strings_[method_id.name_idx_] = true;
+  hot_strings_[dex_file_.GetProtoId(method_id.proto_idx_).shorty_idx_] = true;
+  hot_strings_[dex_file_.GetTypeId(method_id.class_idx_).descriptor_idx_] = true;
+
+  // The strings loaded by the method.
+  const uint16_t* insns = code_item->insns_;
+  const uint32_t insns_size = code_item->insns_size_in_code_units_;
+  for (uint32_t dex_pc = 0u; dex_pc < insns_size; ) {
+    const Instruction* inst = Instruction::At(insns + dex_pc);
+    if (inst->Opcode() == Instruction::CONST_STRING) {
+      hot_strings_[inst->VRegB_21c()] = true;
+    } else if (inst->Opcode() == Instruction::CONST_STRING_JUMBO) {
+      hot_strings_[inst->VRegB_31c()] = true;
+    }
+    dex_pc += inst->SizeInCodeUnits();
+  }
+}
+
+bool DexLayout::CollectCodeItems(std::string* error_msg) {
+  const DexFile::MapItem* section = FindSection(DexFile::kDexTypeCodeItem);
+  if (section == nullptr) {
+    return true;  // No code.
+  }
+  uint32_t offset = section->offset_;
+  code_items_.reserve(section->size_);
+  for (uint32_t i = 0; i != section->size_; ++i) {
+    offset = RoundUp(offset, kCodeItemAlignment);
+    uint32_t size = CodeItemSize(*dex_file_.GetCodeItem(offset));
+    code_items_.push_back(DataItem { offset, size, offset, kGroupOther });
+    offset += size;
+  }
+  code_items_size_ = offset - section->offset_;
+
+  for (uint32_t class_def_idx = 0; class_def_idx != dex_file_.NumClassDefs(); ++class_def_idx) {
+    const DexFile::ClassDef& class_def = dex_file_.GetClassDef(class_def_idx);
+    const bool profiled_class = profile_.ContainsClass(dex_file_, class_def_idx);
+    if (profiled_class) {
+      hot_strings_[dex_file_.GetTypeId(class_def.class_idx_).descriptor_idx_] = true;
+    }
+    const uint8_t* ptr = dex_file_.GetClassData(class_def);
+    if (ptr == nullptr) {
+      continue;
+    }
+    // Walk the class_data_item by hand, ClassDataItemIterator does not expose where the
+    // code_off of a method is encoded.
+    const uint32_t num_static_fields = DecodeUnsignedLeb128(&ptr);
+    const uint32_t num_instance_fields = DecodeUnsignedLeb128(&ptr);
+    const uint32_t num_direct_methods = DecodeUnsignedLeb128(&ptr);
+    const uint32_t num_virtual_methods = DecodeUnsignedLeb128(&ptr);
+    for (uint32_t i = 0; i != num_static_fields + num_instance_fields; ++i) {
+      DecodeUnsignedLeb128(&ptr);  // Field index delta.
+      DecodeUnsignedLeb128(&ptr);  // Access flags.
+    }
+    uint32_t method_idx = 0u;
+    for (uint32_t i = 0; i != num_direct_methods + num_virtual_methods; ++i) {
+      if (i == num_direct_methods) {
+        method_idx = 0u;  // The virtual methods restart the index deltas.
+      }
+      method_idx += DecodeUnsignedLeb128(&ptr);
+      const uint32_t access_flags = DecodeUnsignedLeb128(&ptr);
+      const uint32_t position = ptr - dex_file_.Begin();
+      const uint32_t code_off = DecodeUnsignedLeb128(&ptr);
+      if (code_off == 0u) {
+        continue;
+      }
+      DataItem* item = FindItem(&code_items_, code_off);
+      if (item == nullptr) {
+        *error_msg = StringPrintf("Method %u has an invalid code item offset %x",
+                                  method_idx,
+                                  code_off);
+        return false;
+      }
+      code_off_positions_.push_back(position);
+      uint8_t group = kGroupOther;
+      if (profile_.ContainsMethod(MethodReference(&dex_file_, method_idx))) {
+        group = kGroupHot;
+      } else if (profiled_class &&
+                 (access_flags & (kAccStatic | kAccConstructor)) ==
+                     (kAccStatic | kAccConstructor)) {
+        group = kGroupStartup;
+      }
+      if (group != kGroupOther) {
+        MarkHotMethod(method_idx, dex_file_.GetCodeItem(code_off));
+        item->group = std::min(item->group, group);
+      }
+    }
+  }
+  return true;
+}
+
+bool DexLayout::CollectStringData(std::string* error_msg) {
+  const DexFile::MapItem* section = FindSection(DexFile::kDexTypeStringDataItem);
+  if (section == nullptr) {
+    return true;  // No strings.
+  }
+  const uint8_t* ptr = dex_file_.Begin() + section->offset_;
+  string_data_.reserve(section->size_);
+  for (uint32_t i = 0; i != section->size_; ++i) {
+    const uint32_t offset = ptr - dex_file_.Begin();
+    DecodeUnsignedLeb128(&ptr);  // UTF-16 length.
+    ptr += strlen(reinterpret_cast<const char*>(ptr)) + 1u;
+    const uint32_t size = (ptr - dex_file_.Begin()) - offset;
+    string_data_.push_back(DataItem { offset, size, offset, kGroupOther });
+  }
+  string_data_size_ = (ptr - dex_file_.Begin()) - section->offset_;
+
+  for (uint32_t string_idx = 0; string_idx != dex_file_.NumStringIds(); ++string_idx) {
+    const uint32_t string_data_off = dex_file_.GetStringId(string_idx).string_data_off_;
+    DataItem* item = FindItem(&string_data_, string_data_off);
+    if (item == nullptr) {
+      *error_msg = StringPrintf("String %u has an invalid string data offset %x",
+                                string_idx,
+                                string_data_off);
+      return false;
+    }
+    if (hot_strings_[string_idx]) {
+      item->group = kGroupHot;
+    }
+  }
+  return true;
+}
+
+void DexLayout::LayoutSection(std::vector<DataItem>* items,
+                              uint32_t alignment,
+                              bool keep_leb_size) {
+  std::vector<DataItem*> order;
+  for (size_t begin = 0u, end; begin != items->size(); begin = end) {
+    // Find the run of items whose offsets have the same ULEB128 length.
+    end = begin + 1u;
+    if (keep_leb_size) {
+      const uint32_t leb_size = UnsignedLeb128Size((*items)[begin].offset);
+      while (end != items->size() && UnsignedLeb128Size((*items)[end].offset) == leb_size) {
+        ++end;
+      }
+    } else {
+      end = items->size();
+    }
+    // The last item of the run stays last. Since the items are aligned, the run then ends
+    // exactly where it did and all other items start before the original start of the last.
+    order.clear();
+    for (size_t i = begin; i != end - 1u; ++i) {
+      order.push_back(&(*items)[i]);
+    }
+    std::stable_sort(order.begin(),
+                     order.end(),
+                     [](const DataItem* lhs, const DataItem* rhs) {
+                       return lhs->group < rhs->group;
+                     });
+    order.push_back(&(*items)[end - 1u]);
+    uint32_t offset = (*items)[begin].offset;
+    for (DataItem* item : order) {
+      offset = RoundUp(offset, alignment);
+      item->new_offset = offset;
+      offset += item->size;
+    }
+    DCHECK_EQ(offset, (*items)[end - 1u].offset + (*items)[end - 1u].size);
+  }
+}
+
+void DexLayout::MoveItems(const std::vector<DataItem>& items,
+                          uint32_t section_size,
+                          const uint8_t* src,
+                          uint8_t* dest) {
+  if (items.empty()) {
+    return;
+  }
+  // Clear the section first, the alignment padding must be zero.
+  std::fill_n(dest + items.front().offset, section_size, 0u);
+  for (const DataItem& item : items) {
+    memcpy(dest + item.new_offset, src + item.offset, item.size);
+  }
+}
+
+bool DexLayout::Layout(const DexFile& dex_file,
+                       const ProfileCompilationInfo& profile,
+                       std::vector<uint8_t>* output,
+                       std::string* error_msg) {
+  DexLayout layout(dex_file, profile);
+  layout.hot_strings_.resize(dex_file.NumStringIds(), false);
+  if (!layout.CollectCodeItems(error_msg) || !layout.CollectStringData(error_msg)) {
+    return false;
+  }
+  // Code items are referenced by ULEB128 offsets in class_data_items, strings by the fixed
+  // size offsets of the string ids.
+  LayoutSection(&layout.code_items_, kCodeItemAlignment, /* keep_leb_size */ true);
+  LayoutSection(&layout.string_data_, /* alignment */ 1u, /* keep_leb_size */ false);
+
+  const uint8_t* src = dex_file.Begin();
+  output->assign(src, src + dex_file.Size());
+  uint8_t* dest = output->data();
+  MoveItems(layout.code_items_, layout.code_items_size_, src, dest);
+  MoveItems(layout.string_data_, layout.string_data_size_, src, dest);
+
+  // Update the references to the moved items.
+  for (uint32_t position : layout.code_off_positions_) {
+    const uint8_t* ptr = src + position;
+    const uint32_t code_off = DecodeUnsignedLeb128(&ptr);
+    const DataItem* item = FindItem(&layout.code_items_, code_off);
+    EncodeUnsignedLeb128FixedSize(dest + position, item->new_offset, ptr - (src + position));
+  }
+  DexFile::StringId* string_ids =
+      reinterpret_cast<DexFile::StringId*>(dest + dex_file.GetHeader().string_ids_off_);
+  for (uint32_t string_idx = 0; string_idx != dex_file.NumStringIds(); ++string_idx) {
+    const DataItem* item = FindItem(&layout.string_data_, string_ids[string_idx].string_data_off_);
+    string_ids[string_idx].string_data_off_ = item->new_offset;
+  }
+
+  // Update the checksum. The signature is left alone, the runtime does not check it.
+  DexFile::Header* header = reinterpret_cast<DexFile::Header*>(dest);
+  const uint32_t non_sum = sizeof(header->magic_) + sizeof(header->checksum_);
+  header->checksum_ = adler32(adler32(0L, Z_NULL, 0), dest + non_sum, output->size() - non_sum);
+
+  std::unique_ptr<const DexFile> laid_out_dex_file = DexFile::Open(dest,
+                                                                  output->size(),
+                                                                  dex_file.GetLocation(),
+                                                                  dex_file.GetLocationChecksum(),
+                                                                  /* oat_dex_file */ nullptr,
+                                                                  /* verify */ true,
+                                                                  error_msg);
+  if (laid_out_dex_file == nullptr) {
+    *error_msg = "Laid out dex file failed verification: " + *error_msg;
+    return false;
+  }
+
+  if (VLOG_IS_ON(compiler)) {
+    auto count_hot = [](const std::vector<DataItem>& items) {
+      return std::count_if(items.begin(),
+                           items.end(),
+                           [](const DataItem& item) { return item.group != kGroupOther; });
+    };
+    LOG(INFO) << "Laid out " << dex_file.GetLocation() << ": "
+              << count_hot(layout.code_items_) << "/" << layout.code_items_.size()
+              << " code items and "
+              << count_hot(layout.string_data_) << "/" << layout.string_data_.size()
+              << " strings used at startup";
+  }
+  return true;
+}
+
+}  // namespace art
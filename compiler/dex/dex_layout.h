@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_DEX_DEX_LAYOUT_H_
+#define ART_COMPILER_DEX_DEX_LAYOUT_H_
+
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "dex_file.h"
+
+namespace art {
+
+class ProfileCompilationInfo;
+
+// Rewrites a dex file so that the code items and strings used at startup, according to a
+// profile, are grouped together instead of being scattered across the file in the order the
+// dex file was written in.
+//
+// Only the order of the items within the code item and string data sections changes. The ids,
+// class definitions and all other sections stay where they are, so the result has the same size
+// and the same method and string indexes as the original. The code items are ordered:
+//   - code of the methods in the profile,
+//   - class initializers of the classes in the profile,
+//   - all other code, in the original order.
+// Strings referenced by the profiled methods and classes come first in the string data section.
+class DexLayout {
+ public:
+  // Write the laid out copy of `dex_file` to `output`. The result is opened with the
+  // DexFileVerifier before returning. Returns false and sets `error_msg` on failure.
+  static bool Layout(const DexFile& dex_file,
+                     const ProfileCompilationInfo& profile,
+                     std::vector<uint8_t>* output,
+                     std::string* error_msg);
+
+ private:
+  // A code item or string data item, with its offset in the original dex file.
+  struct DataItem {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t new_offset;
+    uint8_t group;  // Lower groups are laid out first.
+  };
+
+  DexLayout(const DexFile& dex_file, const ProfileCompilationInfo& profile)
+      : dex_file_(dex_file), profile_(profile) {}
+
+  const DexFile::MapItem* FindSection(uint16_t type) const;
+  bool CollectCodeItems(std::string* error_msg);
+  bool CollectStringData(std::string* error_msg);
+  void MarkHotMethod(uint32_t method_idx, const DexFile::CodeItem* code_item);
+
+  // Assign new offsets to the items of a section, grouped by DataItem::group. Items are only
+  // moved between offsets whose ULEB128 encoding has the same length, so that references in
+  // class_data_items keep their size.
+  static void LayoutSection(std::vector<DataItem>* items, uint32_t alignment, bool keep_leb_size);
+  static void MoveItems(const std::vector<DataItem>& items,
+                        uint32_t section_size,
+                        const uint8_t* src,
+                        uint8_t* dest);
+  static DataItem* FindItem(std::vector<DataItem>* items, uint32_t offset);
+
+  const DexFile& dex_file_;
+  const ProfileCompilationInfo& profile_;
+
+  std::vector<DataItem> code_items_;
+  uint32_t code_items_size_ = 0u;
+  // Positions of the code_off of the class_data_item methods, in the original dex file.
+  std::vector<uint32_t> code_off_positions_;
+  std::vector<DataItem> string_data_;
+  uint32_t string_data_size_ = 0u;
+  std::vector<bool> hot_strings_;
+
+  DISALLOW_COPY_AND_ASSIGN(DexLayout);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_DEX_DEX_LAYOUT_H_
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dex/dex_layout.h"
+
+#include <limits>
+#include <set>
+
+#include "common_runtime_test.h"
+#include "dex_file.h"
+#include "jit/offline_profiling_info.h"
+#include "method_reference.h"
+#include "safe_map.h"
+
+namespace art {
+
+class DexLayoutTest : public CommonRuntimeTest {
+ protected:
+  // Returns the code item offsets of the methods with code, by method index.
+  static SafeMap<uint32_t, uint32_t> GetCodeItemOffsets(const DexFile& dex_file) {
+    SafeMap<uint32_t, uint32_t> code_item_offsets;
+    for (uint32_t i = 0; i != dex_file.NumClassDefs(); ++i) {
+      const uint8_t* class_data = dex_file.GetClassData(dex_file.GetClassDef(i));
+      if (class_data == nullptr) {
+        continue;
+      }
+      ClassDataItemIterator it(dex_file, class_data);
+      while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+        it.Next();
+      }
+      while (it.HasNextDirectMethod() || it.HasNextVirtualMethod()) {
+        if (it.GetMethodCodeItemOffset() != 0u) {
+          code_item_offsets.Put(it.GetMemberIndex(), it.GetMethodCodeItemOffset());
+        }
+        it.Next();
+      }
+    }
+    return code_item_offsets;
+  }
+
+  std::unique_ptr<const DexFile> OpenLaidOut(const DexFile& dex_file,
+                                             const ProfileCompilationInfo& profile,
+                                             std::vector<uint8_t>* output) {
+    std::string error_msg;
+    EXPECT_TRUE(DexLayout::Layout(dex_file, profile, output, &error_msg)) << error_msg;
+    EXPECT_EQ(dex_file.Size(), output->size());
+    std::unique_ptr<const DexFile> laid_out = DexFile::Open(output->data(),
+                                                            output->size(),
+                                                            dex_file.GetLocation(),
+                                                            dex_file.GetLocationChecksum(),
+                                                            /* oat_dex_file */ nullptr,
+                                                            /* verify */ true,
+                                                            &error_msg);
+    EXPECT_TRUE(laid_out != nullptr) << error_msg;
+    return laid_out;
+  }
+};
+
+TEST_F(DexLayoutTest, EmptyProfile) {
+  std::unique_ptr<const DexFile> dex_file = OpenTestDexFile("Transaction");
+  ProfileCompilationInfo profile;
+  std::vector<uint8_t> output;
+  std::unique_ptr<const DexFile> laid_out = OpenLaidOut(*dex_file, profile, &output);
+  ASSERT_TRUE(laid_out != nullptr);
+  // Nothing is hot, so nothing moves.
+  EXPECT_EQ(0, memcmp(dex_file->Begin(), output.data(), output.size()));
+}
+
+TEST_F(DexLayoutTest, HotCodeItemsFirst) {
+  std::unique_ptr<const DexFile> dex_file = OpenTestDexFile("Transaction");
+  SafeMap<uint32_t, uint32_t> code_item_offsets = GetCodeItemOffsets(*dex_file);
+  ASSERT_GE(code_item_offsets.size(), 4u);
+
+  // Sort the methods by the offset of their code items and profile the second half, except
+  // the method with the last code item, which stays in place.
+  std::vector<std::pair<uint32_t, uint32_t>> by_offset;
+  for (const auto& entry : code_item_offsets) {
+    by_offset.emplace_back(entry.second, entry.first);
+  }
+  std::sort(by_offset.begin(), by_offset.end());
+  std::set<uint32_t> hot_methods;
+  std::vector<MethodReference> profiled_methods;
+  for (size_t i = by_offset.size() / 2u; i + 1u < by_offset.size(); ++i) {
+    hot_methods.insert(by_offset[i].second);
+    profiled_methods.emplace_back(dex_file.get(), by_offset[i].second);
+  }
+  ProfileCompilationInfo profile;
+  ASSERT_TRUE(profile.AddMethodsAndClasses(profiled_methods, std::set<DexCacheResolvedClasses>()));
+
+  std::vector<uint8_t> output;
+  std::unique_ptr<const DexFile> laid_out = OpenLaidOut(*dex_file, profile, &output);
+  ASSERT_TRUE(laid_out != nullptr);
+
+  // The code is unchanged and the hot code items come before all others.
+  SafeMap<uint32_t, uint32_t> new_code_item_offsets = GetCodeItemOffsets(*laid_out);
+  ASSERT_EQ(code_item_offsets.size(), new_code_item_offsets.size());
+  uint32_t max_hot_offset = 0u;
+  uint32_t min_cold_offset = std::numeric_limits<uint32_t>::max();
+  for (const auto& entry : new_code_item_offsets) {
+    const DexFile::CodeItem* old_code_item =
+        dex_file->GetCodeItem(code_item_offsets.Get(entry.first));
+    const DexFile::CodeItem* new_code_item = laid_out->GetCodeItem(entry.second);
+    ASSERT_EQ(old_code_item->insns_size_in_code_units_, new_code_item->insns_size_in_code_units_);
+    EXPECT_EQ(old_code_item->registers_size_, new_code_item->registers_size_);
+    EXPECT_EQ(old_code_item->tries_size_, new_code_item->tries_size_);
+    EXPECT_EQ(old_code_item->debug_info_off_, new_code_item->debug_info_off_);
+    EXPECT_EQ(0, memcmp(old_code_item->insns_,
+                        new_code_item->insns_,
+                        old_code_item->insns_size_in_code_units_ * sizeof(uint16_t)));
+    if (hot_methods.find(entry.first) != hot_methods.end()) {
+      max_hot_offset = std::max(max_hot_offset, entry.second);
+    } else {
+      min_cold_offset = std::min(min_cold_offset, entry.second);
+    }
+  }
+  EXPECT_LT(max_hot_offset, min_cold_offset);
+
+  // The strings are unchanged and the names of the hot methods come first.
+  ASSERT_EQ(dex_file->NumStringIds(), laid_out->NumStringIds());
+  for (uint32_t i = 0; i != dex_file->NumStringIds(); ++i) {
+    EXPECT_STREQ(dex_file->GetStringData(dex_file->GetStringId(i)),
+                 laid_out->GetStringData(laid_out->GetStringId(i)));
+  }
+  for (uint32_t method_idx : hot_methods) {
+    uint32_t name_idx = laid_out->GetMethodId(method_idx).name_idx_;
+    EXPECT_LE(laid_out->GetStringId(name_idx).string_data_off_,
+              dex_file->GetStringId(name_idx).string_data_off_);
+  }
+}
+
+}  // namespace art
@@ -0,0 +1,725 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "driver/compile_cache.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#if defined(__linux__)
+#include <link.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <ostream>
+#include <unordered_map>
+
+#include "arch/instruction_set_features.h"
+#include "base/casts.h"
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "base/unix_file/fd_file.h"
+#include "compiled_method.h"
+#include "dex_file-inl.h"
+#include "dex_instruction-inl.h"
+#include "driver/compiler_driver.h"
+#include "driver/compiler_options.h"
+#include "driver/incremental_compilation.h"
+#include "linker/linker_patch_table.h"
+#include "oat.h"
+#include "os.h"
+#include "utils.h"
+#include "utils/array_ref.h"
+
+namespace art {
+
+// Identifies the format of the cache entries.
+static constexpr uint8_t kEntryMagic[] = { 'c', 'c', 'e', '\n', '0', '0', '1', '\0' };
+
+// Two independent 64-bit hashes of the key material. A collision would silently produce wrong
+// code, so a single 32-bit or 64-bit hash is not enough.
+class CompileCache::KeyHasher {
+ public:
+  KeyHasher() : hash1_(UINT64_C(0xcbf29ce484222325)), hash2_(UINT64_C(0x6a09e667f3bcc909)) {}
+
+  void Update(const void* data, size_t size) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i != size; ++i) {
+      // FNV-1a and a multiplicative hash with a rotation.
+      hash1_ = (hash1_ ^ bytes[i]) * UINT64_C(0x100000001b3);
+      hash2_ = hash2_ ^ bytes[i];
+      hash2_ = ((hash2_ << 23) | (hash2_ >> 41)) * UINT64_C(0x9e3779b97f4a7c15);
+    }
+  }
+
+  void Update(uint32_t value) {
+    Update(&value, sizeof(value));
+  }
+
+  // Includes the terminating null character, so that consecutive strings stay separate.
+  void Update(const char* str) {
+    Update(str, strlen(str) + 1u);
+  }
+
+  void Update(const std::string& str) {
+    Update(str.c_str(), str.size() + 1u);
+  }
+
+  void Update(const Key& key) {
+    Update(&key.hash1, sizeof(key.hash1));
+    Update(&key.hash2, sizeof(key.hash2));
+  }
+
+  Key Finish() const {
+    return Key { hash1_, hash2_ };
+  }
+
+ private:
+  uint64_t hash1_;
+  uint64_t hash2_;
+};
+
+#if defined(__linux__)
+// ELF note header. The fields are 32-bit words in both ELF32 and ELF64.
+struct NoteHeader {
+  uint32_t n_namesz;
+  uint32_t n_descsz;
+  uint32_t n_type;
+};
+static constexpr uint32_t kNoteGnuBuildId = 3u;  // NT_GNU_BUILD_ID.
+
+// The module containing `address` and its GNU build ID, found with dl_iterate_phdr().
+struct BuildIdSearch {
+  uintptr_t address;
+  bool found_module;
+  std::string build_id;
+};
+
+static int FindBuildId(struct dl_phdr_info* info, size_t size ATTRIBUTE_UNUSED, void* data) {
+  BuildIdSearch* search = reinterpret_cast<BuildIdSearch*>(data);
+  bool contains_address = false;
+  for (size_t i = 0; i != info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+    uintptr_t start = info->dlpi_addr + phdr.p_vaddr;
+    if (phdr.p_type == PT_LOAD && search->address >= start &&
+        search->address - start < phdr.p_memsz) {
+      contains_address = true;
+    }
+  }
+  if (!contains_address) {
+    return 0;
+  }
+  search->found_module = true;
+  for (size_t i = 0; i != info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_NOTE) {
+      continue;
+    }
+    const uint8_t* note = reinterpret_cast<const uint8_t*>(info->dlpi_addr + phdr.p_vaddr);
+    const uint8_t* notes_end = note + phdr.p_memsz;
+    while (note + sizeof(NoteHeader) <= notes_end) {
+      const NoteHeader* header = reinterpret_cast<const NoteHeader*>(note);
+      const uint8_t* name = note + sizeof(NoteHeader);
+      const uint8_t* desc = name + RoundUp(header->n_namesz, 4u);
+      note = desc + RoundUp(header->n_descsz, 4u);
+      if (note > notes_end) {
+        break;
+      }
+      if (header->n_type == kNoteGnuBuildId &&
+          header->n_namesz == 4u &&
+          memcmp(name, "GNU", 4u) == 0) {
+        search->build_id.assign(reinterpret_cast<const char*>(desc), header->n_descsz);
+        return 1;
+      }
+    }
+  }
+  return 1;
+}
+#endif
+
+bool CompileCache::HashModuleBuild(KeyHasher* hasher,
+                                   const void* address,
+                                   const char* module_name,
+                                   std::string* error_msg) {
+#if defined(__linux__)
+  BuildIdSearch search = { reinterpret_cast<uintptr_t>(address), false, std::string() };
+  dl_iterate_phdr(FindBuildId, &search);
+  if (!search.build_id.empty()) {
+    hasher->Update("build-id");
+    hasher->Update(search.build_id);
+    return true;
+  }
+#endif
+  // Without a build ID, hash the whole library or executable containing the module.
+  Dl_info dl_info;
+  if (dladdr(address, &dl_info) == 0 || dl_info.dli_fname == nullptr) {
+    *error_msg = StringPrintf("could not find the %s library", module_name);
+    return false;
+  }
+  std::unique_ptr<File> file(OS::OpenFileForReading(dl_info.dli_fname));
+  if (file == nullptr) {
+    *error_msg = StringPrintf("could not open the %s library '%s'", module_name, dl_info.dli_fname);
+    return false;
+  }
+  int64_t length = file->GetLength();
+  std::vector<uint8_t> contents(std::max<int64_t>(length, 0));
+  if (length <= 0 || !file->ReadFully(contents.data(), contents.size())) {
+    *error_msg = StringPrintf("could not read the %s library '%s'", module_name, dl_info.dli_fname);
+    return false;
+  }
+  hasher->Update("contents");
+  hasher->Update(contents.data(), contents.size());
+  return true;
+}
+
+bool CompileCache::HashCompilerBuild(KeyHasher* hasher, std::string* error_msg) {
+  // The compiled code also depends on the runtime, for example on the layout of its objects and
+  // on its entrypoints. With static linking, both are found in the same executable.
+  return HashModuleBuild(hasher,
+                         reinterpret_cast<const void*>(&CompileCache::HashCompilerBuild),
+                         "compiler",
+                         error_msg) &&
+         HashModuleBuild(hasher,
+                         reinterpret_cast<const void*>(&OatHeader::Create),
+                         "runtime",
+                         error_msg);
+}
+
+std::unique_ptr<CompileCache> CompileCache::Create(
+    const std::string& directory,
+    const std::vector<const DexFile*>& dex_files,
+    const CompilerDriver& driver,
+    const SafeMap<std::string, std::string>& key_value_store,
+    uint32_t image_file_location_oat_checksum,
+    std::string* error_msg) {
+  Key options_key;
+  if (!ComputeOptionsKey(
+          driver, key_value_store, image_file_location_oat_checksum, &options_key, error_msg)) {
+    return nullptr;
+  }
+  if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+    *error_msg = StringPrintf("Failed to create compile cache directory '%s': %s",
+                              directory.c_str(),
+                              strerror(errno));
+    return nullptr;
+  }
+  std::unique_ptr<CompileCache> compile_cache(new CompileCache(directory, options_key));
+  compile_cache->ComputeClassKeys(dex_files);
+  return compile_cache;
+}
+
+CompileCache::CompileCache(const std::string& directory, const Key& options_key)
+    : directory_(directory),
+      options_key_(options_key),
+      class_keys_(),
+      num_hits_(0u),
+      num_misses_(0u),
+      num_stores_(0u) {
+}
+
+CompileCache::~CompileCache() {
+}
+
+bool CompileCache::ComputeOptionsKey(const CompilerDriver& driver,
+                                     const SafeMap<std::string, std::string>& key_value_store,
+                                     uint32_t image_file_location_oat_checksum,
+                                     Key* key,
+                                     std::string* error_msg) {
+  const CompilerOptions& options = driver.GetCompilerOptions();
+  if (options.GenerateAnyDebugInfo()) {
+    *error_msg = "the compile cache does not record debug info";
+    return false;
+  }
+
+  KeyHasher hasher;
+  hasher.Update(kEntryMagic, sizeof(kEntryMagic));
+  hasher.Update(OatHeader::kOatVersion, sizeof(OatHeader::kOatVersion));
+  // Compilers with the same oat version can still generate different code.
+  if (!HashCompilerBuild(&hasher, error_msg)) {
+    return false;
+  }
+  hasher.Update(static_cast<uint32_t>(driver.GetInstructionSet()));
+  hasher.Update(driver.GetInstructionSetFeatures()->GetFeatureString());
+  hasher.Update(image_file_location_oat_checksum);
+  static const char* const kKeys[] = {
+      OatHeader::kPicKey,
+      OatHeader::kDebuggableKey,
+      OatHeader::kNativeDebuggableKey,
+      OatHeader::kCompilerFilter,
+      OatHeader::kClassPathKey,
+      OatHeader::kBootClassPathKey,
+  };
+  for (const char* store_key : kKeys) {
+    auto it = key_value_store.find(store_key);
+    hasher.Update(store_key);
+    hasher.Update((it != key_value_store.end()) ? it->second.c_str() : "");
+  }
+  hasher.Update(static_cast<uint32_t>(options.GetInlineDepthLimit()));
+  hasher.Update(static_cast<uint32_t>(options.GetInlineMaxCodeUnits()));
+  hasher.Update(static_cast<uint32_t>(options.GetImplicitNullChecks()));
+  hasher.Update(static_cast<uint32_t>(options.GetImplicitStackOverflowChecks()));
+  hasher.Update(static_cast<uint32_t>(options.GetImplicitSuspendChecks()));
+  hasher.Update(static_cast<uint32_t>(options.GetIncludePatchInformation()));
+  if (options.GetNoInlineFromDexFile() != nullptr) {
+    for (const DexFile* dex_file : *options.GetNoInlineFromDexFile()) {
+      hasher.Update(dex_file->GetLocation());
+      hasher.Update(dex_file->GetLocationChecksum());
+    }
+  }
+  *key = hasher.Finish();
+  return true;
+}
+
+CompileCache::Key CompileCache::HashClassDefinition(const DexFile& dex_file,
+                                                    uint16_t class_def_idx) {
+  KeyHasher hasher;
+  // The dex cache arrays are laid out by the number of ids, and the code embeds their offsets.
+  hasher.Update(dex_file.NumStringIds());
+  hasher.Update(dex_file.NumTypeIds());
+  hasher.Update(dex_file.NumFieldIds());
+  hasher.Update(dex_file.NumMethodIds());
+
+  auto hash_type = [&dex_file, &hasher](uint32_t type_idx) {
+    hasher.Update(type_idx);
+    hasher.Update((type_idx != DexFile::kDexNoIndex16) ? dex_file.StringByTypeIdx(type_idx) : "");
+  };
+  auto hash_field = [&dex_file, &hasher, &hash_type](uint32_t field_idx) {
+    const DexFile::FieldId& field_id = dex_file.GetFieldId(field_idx);
+    hasher.Update(field_idx);
+    hash_type(field_id.class_idx_);
+    hash_type(field_id.type_idx_);
+    hasher.Update(dex_file.GetFieldName(field_id));
+  };
+  auto hash_method = [&dex_file, &hasher, &hash_type](uint32_t method_idx) {
+    const DexFile::MethodId& method_id = dex_file.GetMethodId(method_idx);
+    hasher.Update(method_idx);
+    hash_type(method_id.class_idx_);
+    hasher.Update(dex_file.GetMethodName(method_id));
+    hasher.Update(dex_file.GetMethodSignature(method_id).ToString());
+  };
+
+  const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_idx);
+  hash_type(class_def.class_idx_);
+  hasher.Update(class_def.access_flags_);
+  hash_type(class_def.superclass_idx_);
+  const DexFile::TypeList* interfaces = dex_file.GetInterfacesList(class_def);
+  for (uint32_t i = 0, size = (interfaces != nullptr) ? interfaces->Size() : 0u; i != size; ++i) {
+    hash_type(interfaces->GetTypeItem(i).type_idx_);
+  }
+
+  const uint8_t* class_data = dex_file.GetClassData(class_def);
+  if (class_data == nullptr) {
+    return hasher.Finish();
+  }
+  for (ClassDataItemIterator it(dex_file, class_data); it.HasNext(); it.Next()) {
+    hasher.Update(it.GetRawMemberAccessFlags());
+    if (it.HasNextStaticField() || it.HasNextInstanceField()) {
+      hash_field(it.GetMemberIndex());
+      continue;
+    }
+    hash_method(it.GetMemberIndex());
+    const DexFile::CodeItem* code_item = it.GetMethodCodeItem();
+    if (code_item == nullptr) {
+      hasher.Update(0u);
+      continue;
+    }
+    hasher.Update(code_item->registers_size_);
+    hasher.Update(code_item->ins_size_);
+    hasher.Update(code_item->outs_size_);
+    hasher.Update(code_item->insns_size_in_code_units_);
+    hasher.Update(code_item->insns_, code_item->insns_size_in_code_units_ * sizeof(uint16_t));
+    for (uint32_t i = 0; i != code_item->tries_size_; ++i) {
+      const DexFile::TryItem* try_item = DexFile::GetTryItems(*code_item, i);
+      hasher.Update(try_item->start_addr_);
+      hasher.Update(try_item->insn_count_);
+      for (CatchHandlerIterator handler(*code_item, *try_item); handler.HasNext(); handler.Next()) {
+        hash_type(handler.GetHandlerTypeIndex());
+        hasher.Update(handler.GetHandlerAddress());
+      }
+    }
+    // The meaning of the indexes used by the code.
+    const Instruction* inst = Instruction::At(code_item->insns_);
+    const Instruction* end = Instruction::At(code_item->insns_ +
+                                             code_item->insns_size_in_code_units_);
+    for (; inst < end; inst = inst->Next()) {
+      Instruction::Code opcode = inst->Opcode();
+      Instruction::IndexType index_type = Instruction::IndexTypeOf(opcode);
+      if (index_type != Instruction::kIndexTypeRef &&
+          index_type != Instruction::kIndexStringRef &&
+          index_type != Instruction::kIndexFieldRef &&
+          index_type != Instruction::kIndexMethodRef) {
+        continue;
+      }
+      uint32_t index = (Instruction::FormatOf(opcode) == Instruction::k22c)
+          ? inst->VRegC_22c()
+          : inst->VRegB();
+      switch (index_type) {
+        case Instruction::kIndexTypeRef:
+          hash_type(index);
+          break;
+        case Instruction::kIndexStringRef:
+          hasher.Update(index);
+          hasher.Update(dex_file.StringDataByIdx(index));
+          break;
+        case Instruction::kIndexFieldRef:
+          hash_field(index);
+          break;
+        default:
+          DCHECK_EQ(index_type, Instruction::kIndexMethodRef);
+          hash_method(index);
+          break;
+      }
+    }
+  }
+  return hasher.Finish();
+}
+
+void CompileCache::ComputeClassKeys(const std::vector<const DexFile*>& dex_files) {
+  struct ClassInfo {
+    const DexFile* dex_file;
+    uint16_t class_def_idx;
+    Key definition_key;
+  };
+  std::vector<ClassInfo> classes;
+  std::unordered_map<std::string, size_t> class_indexes;
+  for (const DexFile* dex_file : dex_files) {
+    for (uint16_t i = 0; i != dex_file->NumClassDefs(); ++i) {
+      // Only the first definition of a class is ever used.
+      class_indexes.emplace(dex_file->GetClassDescriptor(dex_file->GetClassDef(i)),
+                            classes.size());
+      classes.push_back({ dex_file, i, HashClassDefinition(*dex_file, i) });
+    }
+  }
+  std::vector<std::vector<size_t>> dependencies(classes.size());
+  std::vector<std::string> descriptors;
+  for (size_t i = 0; i != classes.size(); ++i) {
+    descriptors.clear();
+    IncrementalCompilation::CollectReferencedClasses(
+        *classes[i].dex_file, classes[i].class_def_idx, &descriptors);
+    for (const std::string& descriptor : descriptors) {
+      auto it = class_indexes.find(descriptor);
+      if (it != class_indexes.end() && it->second != i) {
+        dependencies[i].push_back(it->second);
+      }
+    }
+    std::sort(dependencies[i].begin(), dependencies[i].end());
+    dependencies[i].erase(std::unique(dependencies[i].begin(), dependencies[i].end()),
+                          dependencies[i].end());
+  }
+
+  // The key of a class covers the definitions of all the classes it depends on, transitively.
+  // Classes depending on each other form strongly connected components with a common key,
+  // computed when Tarjan's algorithm completes the component. The components are completed
+  // in reverse topological order, so the keys of their dependencies are known by then.
+  static constexpr size_t kNotVisited = static_cast<size_t>(-1);
+  std::vector<size_t> visit_index(classes.size(), kNotVisited);
+  std::vector<size_t> low_link(classes.size(), 0u);
+  std::vector<bool> on_stack(classes.size(), false);
+  std::vector<size_t> component_stack;
+  std::vector<Key> keys(classes.size());
+  std::vector<std::pair<size_t, size_t>> call_stack;  // Class and next dependency.
+  size_t next_visit_index = 0u;
+  for (size_t root = 0; root != classes.size(); ++root) {
+    if (visit_index[root] != kNotVisited) {
+      continue;
+    }
+    call_stack.emplace_back(root, 0u);
+    while (!call_stack.empty()) {
+      size_t current = call_stack.back().first;
+      size_t dependency_pos = call_stack.back().second;
+      if (dependency_pos == 0u && visit_index[current] == kNotVisited) {
+        visit_index[current] = next_visit_index;
+        low_link[current] = next_visit_index;
+        ++next_visit_index;
+        component_stack.push_back(current);
+        on_stack[current] = true;
+      }
+      if (dependency_pos != dependencies[current].size()) {
+        ++call_stack.back().second;
+        size_t dependency = dependencies[current][dependency_pos];
+        if (visit_index[dependency] == kNotVisited) {
+          call_stack.emplace_back(dependency, 0u);
+        } else if (on_stack[dependency]) {
+          low_link[current] = std::min(low_link[current], visit_index[dependency]);
+        }
+        continue;
+      }
+      call_stack.pop_back();
+      if (!call_stack.empty()) {
+        size_t caller = call_stack.back().first;
+        low_link[caller] = std::min(low_link[caller], low_link[current]);
+      }
+      if (low_link[current] != visit_index[current]) {
+        continue;
+      }
+      // `current` is the root of a completed component.
+      auto component_begin =
+          std::find(component_stack.begin(), component_stack.end(), current);
+      std::vector<size_t> members(component_begin, component_stack.end());
+      component_stack.erase(component_begin, component_stack.end());
+      for (size_t member : members) {
+        on_stack[member] = false;
+      }
+      std::vector<Key> member_keys;
+      std::vector<Key> dependency_keys;
+      for (size_t member : members) {
+        member_keys.push_back(classes[member].definition_key);
+        for (size_t dependency : dependencies[member]) {
+          if (std::find(members.begin(), members.end(), dependency) == members.end()) {
+            dependency_keys.push_back(keys[dependency]);
+          }
+        }
+      }
+      // Sort the keys so that the result does not depend on the order of the classes.
+      auto less = [](const Key& lhs, const Key& rhs) {
+        return (lhs.hash1 != rhs.hash1) ? lhs.hash1 < rhs.hash1 : lhs.hash2 < rhs.hash2;
+      };
+      std::sort(member_keys.begin(), member_keys.end(), less);
+      std::sort(dependency_keys.begin(), dependency_keys.end(), less);
+      dependency_keys.erase(std::unique(dependency_keys.begin(), dependency_keys.end()),
+                            dependency_keys.end());
+      KeyHasher hasher;
+      hasher.Update(static_cast<uint32_t>(member_keys.size()));
+      for (const Key& key : member_keys) {
+        hasher.Update(key);
+      }
+      for (const Key& key : dependency_keys) {
+        hasher.Update(key);
+      }
+      Key component_key = hasher.Finish();
+      for (size_t member : members) {
+        keys[member] = component_key;
+      }
+    }
+  }
+
+  for (const DexFile* dex_file : dex_files) {
+    class_keys_.Put(dex_file, std::vector<Key>(dex_file->NumClassDefs()));
+  }
+  for (size_t i = 0; i != classes.size(); ++i) {
+    // Mix in the definition, the key of the component is shared by all its classes.
+    KeyHasher hasher;
+    hasher.Update(keys[i]);
+    hasher.Update(classes[i].definition_key);
+    auto keys_it = class_keys_.find(classes[i].dex_file);
+    DCHECK(keys_it != class_keys_.end());
+    keys_it->second[classes[i].class_def_idx] = hasher.Finish();
+  }
+}
+
+CompileCache::Key CompileCache::GetMethodKey(const DexFile& dex_file,
+                                             uint16_t class_def_idx,
+                                             uint32_t method_idx) const {
+  KeyHasher hasher;
+  hasher.Update(options_key_);
+  auto keys_it = class_keys_.find(&dex_file);
+  DCHECK(keys_it != class_keys_.end());
+  hasher.Update(keys_it->second[class_def_idx]);
+  hasher.Update(method_idx);
+  return hasher.Finish();
+}
+
+std::string CompileCache::GetEntryFilename(const Key& key) const {
+  return StringPrintf("%s/%016" PRIx64 "%016" PRIx64 ".cce",
+                      directory_.c_str(),
+                      key.hash1,
+                      key.hash2);
+}
+
+static void AppendUint32(std::vector<uint8_t>* data, uint32_t value) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+  data->insert(data->end(), bytes, bytes + sizeof(value));
+}
+
+static void AppendArray(std::vector<uint8_t>* data, ArrayRef<const uint8_t> array) {
+  AppendUint32(data, dchecked_integral_cast<uint32_t>(array.size()));
+  data->insert(data->end(), array.begin(), array.end());
+}
+
+// Reads the next uint32_t of an entry. Returns false if the entry is truncated.
+static bool ReadUint32(const std::vector<uint8_t>& data, size_t* pos, uint32_t* value) {
+  if (data.size() - *pos < sizeof(*value)) {
+    return false;
+  }
+  memcpy(value, data.data() + *pos, sizeof(*value));
+  *pos += sizeof(*value);
+  return true;
+}
+
+static bool ReadArray(const std::vector<uint8_t>& data,
+                      size_t* pos,
+                      ArrayRef<const uint8_t>* array) {
+  uint32_t size;
+  if (!ReadUint32(data, pos, &size) || data.size() - *pos < size) {
+    return false;
+  }
+  *array = ArrayRef<const uint8_t>(data.data() + *pos, size);
+  *pos += size;
+  return true;
+}
+
+// Entry layout:
+//   uint8_t magic[]           kEntryMagic.
+//   Key key                   The full key, checked when loading.
+//   uint32_t instruction_set
+//   uint32_t frame_size_in_bytes, core_spill_mask, fp_spill_mask
+//   uint32_t code_size, uint8_t code[]
+//   uint32_t vmap_table_size, uint8_t vmap_table[]
+//   LinkerPatchTable          The patches of the method, with its dex file at index 0.
+CompiledMethod* CompileCache::LoadCompiledMethod(CompilerDriver* driver,
+                                                 const DexFile& dex_file,
+                                                 uint16_t class_def_idx,
+                                                 uint32_t method_idx) {
+  Key key = GetMethodKey(dex_file, class_def_idx, method_idx);
+  std::string filename = GetEntryFilename(key);
+  std::unique_ptr<File> file(OS::OpenFileForReading(filename.c_str()));
+  if (file == nullptr) {
+    num_misses_.FetchAndAddRelaxed(1u);
+    return nullptr;
+  }
+  int64_t length = file->GetLength();
+  std::vector<uint8_t> data(std::max<int64_t>(length, 0));
+  bool read_ok = (length > 0) && file->ReadFully(data.data(), data.size());
+
+  size_t pos = sizeof(kEntryMagic) + sizeof(Key);
+  Key entry_key;
+  uint32_t instruction_set;
+  uint32_t frame_size_in_bytes;
+  uint32_t core_spill_mask;
+  uint32_t fp_spill_mask;
+  ArrayRef<const uint8_t> code;
+  ArrayRef<const uint8_t> vmap_table;
+  if (read_ok && data.size() >= pos) {
+    memcpy(&entry_key, data.data() + sizeof(kEntryMagic), sizeof(Key));
+  }
+  if (!read_ok ||
+      data.size() < pos ||
+      memcmp(data.data(), kEntryMagic, sizeof(kEntryMagic)) != 0 ||
+      !(entry_key == key) ||
+      !ReadUint32(data, &pos, &instruction_set) ||
+      instruction_set != static_cast<uint32_t>(driver->GetInstructionSet()) ||
+      !ReadUint32(data, &pos, &frame_size_in_bytes) ||
+      !ReadUint32(data, &pos, &core_spill_mask) ||
+      !ReadUint32(data, &pos, &fp_spill_mask) ||
+      !ReadArray(data, &pos, &code) ||
+      code.empty() ||
+      !ReadArray(data, &pos, &vmap_table) ||
+      linker::LinkerPatchTable::GetSize(data.data() + pos, data.size() - pos) == 0u) {
+    LOG(WARNING) << "Ignoring invalid compile cache entry " << filename;
+    num_misses_.FetchAndAddRelaxed(1u);
+    return nullptr;
+  }
+  std::vector<LinkerPatch> patches;
+  std::vector<uint8_t> original_code;
+  linker::LinkerPatchTable patch_table(data.data() + pos);
+  if (!patch_table.Decode(/* dex_file_index */ 0u,
+                          method_idx,
+                          std::vector<const DexFile*>{ &dex_file },
+                          &patches,
+                          &original_code)) {
+    num_misses_.FetchAndAddRelaxed(1u);
+    return nullptr;
+  }
+  // The code was stored before patching, so the original code is already in place.
+  CompiledMethod* compiled_method = CompiledMethod::SwapAllocCompiledMethod(
+      driver,
+      driver->GetInstructionSet(),
+      code,
+      frame_size_in_bytes,
+      core_spill_mask,
+      fp_spill_mask,
+      /* src_mapping_table */ ArrayRef<const SrcMapElem>(),
+      vmap_table,
+      /* cfi_info */ ArrayRef<const uint8_t>(),
+      ArrayRef<const LinkerPatch>(patches));
+  num_hits_.FetchAndAddRelaxed(1u);
+  return compiled_method;
+}
+
+void CompileCache::StoreCompiledMethod(const DexFile& dex_file,
+                                       uint16_t class_def_idx,
+                                       uint32_t method_idx,
+                                       const CompiledMethod& compiled_method) {
+  if (compiled_method.GetQuickCode().empty()) {
+    return;
+  }
+  std::vector<uint8_t> patch_table;
+  std::vector<const DexFile*> dex_files { &dex_file };
+  linker::LinkerPatchTable::Encode(
+      dex_files,
+      { linker::LinkerPatchTable::MethodEntry { 0u, method_idx, &compiled_method } },
+      &patch_table);
+  std::vector<LinkerPatch> patches;
+  std::vector<uint8_t> original_code;
+  if (!linker::LinkerPatchTable(patch_table.data()).Decode(
+          0u, method_idx, dex_files, &patches, &original_code)) {
+    return;  // Refers to other dex files.
+  }
+
+  Key key = GetMethodKey(dex_file, class_def_idx, method_idx);
+  std::vector<uint8_t> data(kEntryMagic, kEntryMagic + sizeof(kEntryMagic));
+  const uint8_t* key_bytes = reinterpret_cast<const uint8_t*>(&key);
+  data.insert(data.end(), key_bytes, key_bytes + sizeof(key));
+  AppendUint32(&data, static_cast<uint32_t>(compiled_method.GetInstructionSet()));
+  AppendUint32(&data, static_cast<uint32_t>(compiled_method.GetFrameSizeInBytes()));
+  AppendUint32(&data, compiled_method.GetCoreSpillMask());
+  AppendUint32(&data, compiled_method.GetFpSpillMask());
+  AppendArray(&data, compiled_method.GetQuickCode());
+  AppendArray(&data, compiled_method.GetVmapTable());
+  data.insert(data.end(), patch_table.begin(), patch_table.end());
+
+  // Write to a temporary file and rename it, so that readers never see a partial entry.
+  std::string filename = GetEntryFilename(key);
+  std::string temp_filename =
+      StringPrintf("%s.%d.%d.tmp", filename.c_str(), getpid(), GetTid());
+  std::unique_ptr<File> file(OS::CreateEmptyFile(temp_filename.c_str()));
+  if (file == nullptr) {
+    PLOG(WARNING) << "Failed to create compile cache entry " << temp_filename;
+    return;
+  }
+  if (!file->WriteFully(data.data(), data.size())) {
+    PLOG(WARNING) << "Failed to write compile cache entry " << temp_filename;
+    file->Erase();
+    return;
+  }
+  if (file->FlushCloseOrErase() != 0) {
+    PLOG(WARNING) << "Failed to flush and close compile cache entry " << temp_filename;
+    return;
+  }
+  if (rename(temp_filename.c_str(), filename.c_str()) != 0) {
+    PLOG(WARNING) << "Failed to rename compile cache entry " << temp_filename;
+    unlink(temp_filename.c_str());
+    return;
+  }
+  num_stores_.FetchAndAddRelaxed(1u);
+}
+
+void CompileCache::DumpStats(std::ostream& os) const {
+  size_t hits = GetNumberOfHits();
+  size_t lookups = hits + GetNumberOfMisses();
+  os << "Compile cache: " << hits << " hits in " << lookups << " lookups";
+  if (lookups != 0u) {
+    os << StringPrintf(" (%.1f%%)", 100.0 * hits / lookups);
+  }
+  os << ", " << GetNumberOfStores() << " stores";
+}
+
+}  // namespace art
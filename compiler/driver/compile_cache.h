@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_DRIVER_COMPILE_CACHE_H_
+#define ART_COMPILER_DRIVER_COMPILE_CACHE_H_
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "base/macros.h"
+#include "dex_file.h"
+#include "safe_map.h"
+
+namespace art {
+
+class CompiledMethod;
+class CompilerDriver;
+
+// CompileCache is an on-disk cache of compiled methods shared by dex2oat invocations, for
+// example on a build server compiling the same libraries into many apps.
+//
+// An entry is keyed by a hash of
+//   - the builds of the compiler and of the runtime (their GNU build IDs, or else the content
+//     of their libraries), the compiler options, the instruction set features, the boot image
+//     and the class path,
+//   - the definition of the class of the method, including the code of all its methods and the
+//     meaning of every index their code uses, and
+//   - the same for all the classes it depends on, transitively, as found by
+//     IncrementalCompilation::CollectReferencedClasses().
+// The compiled code embeds dex file indexes, so an entry is only found for a method of a dex
+// file with the same ids. Methods whose linker patches refer to other dex files are not cached.
+//
+// The entries are written to temporary files and renamed, so several processes can share the
+// directory. It is not used for images, whose code depends on the objects in the image.
+class CompileCache {
+ public:
+  // Open the cache `directory` for compiling `dex_files`, creating the directory if needed.
+  // Returns null and sets `error_msg` if the compilation cannot use the cache.
+  static std::unique_ptr<CompileCache> Create(
+      const std::string& directory,
+      const std::vector<const DexFile*>& dex_files,
+      const CompilerDriver& driver,
+      const SafeMap<std::string, std::string>& key_value_store,
+      uint32_t image_file_location_oat_checksum,
+      std::string* error_msg);
+
+  ~CompileCache();
+
+  // Returns the compiled method found in the cache, or null. Thread safe.
+  CompiledMethod* LoadCompiledMethod(CompilerDriver* driver,
+                                     const DexFile& dex_file,
+                                     uint16_t class_def_idx,
+                                     uint32_t method_idx);
+
+  // Add a method compiled by the optimizing compiler to the cache. Thread safe.
+  void StoreCompiledMethod(const DexFile& dex_file,
+                           uint16_t class_def_idx,
+                           uint32_t method_idx,
+                           const CompiledMethod& compiled_method);
+
+  size_t GetNumberOfHits() const {
+    return num_hits_.LoadRelaxed();
+  }
+
+  size_t GetNumberOfMisses() const {
+    return num_misses_.LoadRelaxed();
+  }
+
+  size_t GetNumberOfStores() const {
+    return num_stores_.LoadRelaxed();
+  }
+
+  void DumpStats(std::ostream& os) const;
+
+ private:
+  struct Key {
+    uint64_t hash1;
+    uint64_t hash2;
+
+    bool operator==(const Key& other) const {
+      return hash1 == other.hash1 && hash2 == other.hash2;
+    }
+  };
+
+  class KeyHasher;
+
+  CompileCache(const std::string& directory, const Key& options_key);
+
+  static bool ComputeOptionsKey(const CompilerDriver& driver,
+                                const SafeMap<std::string, std::string>& key_value_store,
+                                uint32_t image_file_location_oat_checksum,
+                                Key* key,
+                                std::string* error_msg);
+  // Adds the identity of the compiler and runtime builds to `hasher`.
+  static bool HashCompilerBuild(KeyHasher* hasher, std::string* error_msg);
+  // Adds the GNU build ID of the module containing `address`, or else its content, to `hasher`.
+  static bool HashModuleBuild(KeyHasher* hasher,
+                              const void* address,
+                              const char* module_name,
+                              std::string* error_msg);
+  static Key HashClassDefinition(const DexFile& dex_file, uint16_t class_def_idx);
+  void ComputeClassKeys(const std::vector<const DexFile*>& dex_files);
+
+  Key GetMethodKey(const DexFile& dex_file, uint16_t class_def_idx, uint32_t method_idx) const;
+  std::string GetEntryFilename(const Key& key) const;
+
+  const std::string directory_;
+  const Key options_key_;
+
+  // For each dex file, the keys of its classes, covering the classes they depend on.
+  SafeMap<const DexFile*, std::vector<Key>> class_keys_;
+
+  Atomic<size_t> num_hits_;
+  Atomic<size_t> num_misses_;
+  Atomic<size_t> num_stores_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompileCache);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_DRIVER_COMPILE_CACHE_H_
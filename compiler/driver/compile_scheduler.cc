@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "driver/compile_scheduler.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <ostream>
+
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "base/time_utils.h"
+#include "base/unix_file/fd_file.h"
+#include "dex_file-inl.h"
+#include "os.h"
+#include "utils.h"
+
+namespace art {
+
+// The estimated cost of compiling a method, in addition to one per code unit.
+static constexpr uint64_t kMethodCostOverhead = 32u;
+
+CompileScheduler::CompileScheduler() : wall_time_ns_(0u) {
+}
+
+CompileScheduler::~CompileScheduler() {
+}
+
+bool CompileScheduler::ReadClassTimes(const std::string& filename, std::string* error_msg) {
+  std::string content;
+  if (!ReadFileToString(filename, &content)) {
+    *error_msg = StringPrintf("Failed to read class compile times from '%s'", filename.c_str());
+    return false;
+  }
+  std::vector<std::string> lines;
+  Split(content, '\n', &lines);
+  for (const std::string& line : lines) {
+    size_t space = line.rfind(' ');
+    char* end = nullptr;
+    uint64_t time_ns = (space != std::string::npos)
+        ? strtoull(line.c_str() + space + 1u, &end, 10)
+        : 0u;
+    if (space == std::string::npos || space == 0u || end == line.c_str() + space + 1u ||
+        *end != '\0') {
+      *error_msg = StringPrintf("Malformed class compile time '%s' in '%s'",
+                                line.c_str(),
+                                filename.c_str());
+      previous_class_times_.clear();
+      return false;
+    }
+    previous_class_times_[line.substr(0u, space)] += time_ns;
+  }
+  return true;
+}
+
+bool CompileScheduler::WriteClassTimes(const std::string& filename, std::string* error_msg) const {
+  // Sort by descriptor, for a deterministic output.
+  std::map<std::string, uint64_t> times;
+  for (const auto& entry : class_times_) {
+    const DexFile* dex_file = entry.first;
+    for (size_t i = 0; i != dex_file->NumClassDefs(); ++i) {
+      uint64_t time_ns = entry.second[i].LoadRelaxed();
+      if (time_ns != 0u) {
+        times[dex_file->GetClassDescriptor(dex_file->GetClassDef(i))] += time_ns;
+      }
+    }
+  }
+  std::string content;
+  for (const auto& entry : times) {
+    content += StringPrintf("%s %" PRIu64 "\n", entry.first.c_str(), entry.second);
+  }
+  std::unique_ptr<File> file(OS::CreateEmptyFile(filename.c_str()));
+  if (file == nullptr) {
+    *error_msg = StringPrintf("Failed to create '%s'", filename.c_str());
+    return false;
+  }
+  if (!file->WriteFully(content.data(), content.size())) {
+    *error_msg = StringPrintf("Failed to write '%s'", filename.c_str());
+    file->Erase();
+    return false;
+  }
+  if (file->FlushCloseOrErase() != 0) {
+    *error_msg = StringPrintf("Failed to flush and close '%s'", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+void CompileScheduler::EstimateMethodCosts(const DexFile& dex_file,
+                                           uint16_t class_def_index,
+                                           std::vector<uint64_t>* costs) {
+  costs->clear();
+  const uint8_t* class_data = dex_file.GetClassData(dex_file.GetClassDef(class_def_index));
+  if (class_data == nullptr) {
+    return;
+  }
+  ClassDataItemIterator it(dex_file, class_data);
+  while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+    it.Next();
+  }
+  while (it.HasNextDirectMethod() || it.HasNextVirtualMethod()) {
+    const DexFile::CodeItem* code_item = it.GetMethodCodeItem();
+    costs->push_back(kMethodCostOverhead +
+                     ((code_item != nullptr) ? code_item->insns_size_in_code_units_ : 0u));
+    it.Next();
+  }
+}
+
+std::vector<CompileScheduler::WorkItem> CompileScheduler::Schedule(const DexFile& dex_file,
+                                                                   size_t thread_count) {
+  const size_t num_class_defs = dex_file.NumClassDefs();
+  std::unique_ptr<Atomic<uint64_t>[]>& class_times = class_times_[&dex_file];
+  if (class_times == nullptr) {
+    class_times.reset(new Atomic<uint64_t>[num_class_defs]);
+  }
+
+  std::vector<std::vector<uint64_t>> method_costs(num_class_defs);
+  std::vector<uint64_t> class_costs(num_class_defs, 0u);
+  std::vector<uint64_t> previous_times(num_class_defs, 0u);
+  uint64_t timed_classes_cost = 0u;
+  uint64_t timed_classes_time_ns = 0u;
+  for (size_t i = 0; i != num_class_defs; ++i) {
+    EstimateMethodCosts(dex_file, i, &method_costs[i]);
+    for (uint64_t cost : method_costs[i]) {
+      class_costs[i] += cost;
+    }
+    if (!previous_class_times_.empty() && class_costs[i] != 0u) {
+      auto it = previous_class_times_.find(dex_file.GetClassDescriptor(dex_file.GetClassDef(i)));
+      if (it != previous_class_times_.end() && it->second != 0u) {
+        previous_times[i] = it->second;
+        timed_classes_cost += class_costs[i];
+        timed_classes_time_ns += it->second;
+      }
+    }
+  }
+  // Prefer the times of the previous compilation, converted to the unit of the estimates so that
+  // they can be compared with the classes that were not compiled before.
+  if (timed_classes_time_ns != 0u) {
+    double cost_per_ns =
+        static_cast<double>(timed_classes_cost) / static_cast<double>(timed_classes_time_ns);
+    for (size_t i = 0; i != num_class_defs; ++i) {
+      if (previous_times[i] != 0u) {
+        uint64_t class_cost =
+            std::max<uint64_t>(static_cast<uint64_t>(previous_times[i] * cost_per_ns), 1u);
+        double scale = static_cast<double>(class_cost) / static_cast<double>(class_costs[i]);
+        for (uint64_t& cost : method_costs[i]) {
+          cost = static_cast<uint64_t>(cost * scale);
+        }
+        class_costs[i] = class_cost;
+      }
+    }
+  }
+
+  // Split the classes that cost more than a fraction of the work of a thread.
+  uint64_t total_cost = 0u;
+  for (uint64_t cost : class_costs) {
+    total_cost += cost;
+  }
+  const uint64_t max_item_cost = (thread_count > 1u)
+      ? std::max<uint64_t>(total_cost / (thread_count * kWorkItemsPerThread), 1u)
+      : std::numeric_limits<uint64_t>::max();
+  std::vector<WorkItem> work_items;
+  work_items.reserve(num_class_defs);
+  for (size_t i = 0; i != num_class_defs; ++i) {
+    const std::vector<uint64_t>& costs = method_costs[i];
+    if (costs.empty()) {
+      continue;  // Nothing to compile.
+    }
+    uint32_t begin_method = 0u;
+    uint64_t item_cost = 0u;
+    for (size_t m = 0; m != costs.size(); ++m) {
+      item_cost += costs[m];
+      if (item_cost >= max_item_cost && m + 1u != costs.size()) {
+        uint32_t end_method = static_cast<uint32_t>(m + 1u);
+        work_items.push_back(
+            WorkItem { static_cast<uint16_t>(i), begin_method, end_method, item_cost });
+        begin_method = end_method;
+        item_cost = 0u;
+      }
+    }
+    work_items.push_back(WorkItem {
+        static_cast<uint16_t>(i), begin_method, static_cast<uint32_t>(costs.size()), item_cost });
+  }
+  // Largest first. The sort is stable, so the order does not depend on the sort implementation.
+  std::stable_sort(work_items.begin(),
+                   work_items.end(),
+                   [](const WorkItem& lhs, const WorkItem& rhs) { return lhs.cost > rhs.cost; });
+  return work_items;
+}
+
+void CompileScheduler::RecordWorkItemTime(const DexFile& dex_file,
+                                          const WorkItem& item,
+                                          uint64_t time_ns) {
+  auto it = class_times_.find(&dex_file);
+  DCHECK(it != class_times_.end());
+  it->second[item.class_def_index].FetchAndAddRelaxed(time_ns);
+}
+
+void CompileScheduler::RecordThreadTimes(uint64_t wall_time_ns,
+                                         const std::vector<uint64_t>& busy_time_ns) {
+  wall_time_ns_ += wall_time_ns;
+  if (busy_time_ns_.size() < busy_time_ns.size()) {
+    busy_time_ns_.resize(busy_time_ns.size(), 0u);
+  }
+  for (size_t i = 0; i != busy_time_ns.size(); ++i) {
+    busy_time_ns_[i] += busy_time_ns[i];
+  }
+}
+
+void CompileScheduler::DumpUtilization(std::ostream& os) const {
+  if (wall_time_ns_ == 0u || busy_time_ns_.empty()) {
+    return;
+  }
+  uint64_t total_busy_time_ns = 0u;
+  os << "Compile thread utilization:";
+  for (uint64_t busy_time_ns : busy_time_ns_) {
+    os << StringPrintf(" %.1f%%", 100.0 * busy_time_ns / wall_time_ns_);
+    total_busy_time_ns += busy_time_ns;
+  }
+  os << StringPrintf(" (average %.1f%% of %s)",
+                     100.0 * total_busy_time_ns / (wall_time_ns_ * busy_time_ns_.size()),
+                     PrettyDuration(wall_time_ns_).c_str());
+}
+
+}  // namespace art
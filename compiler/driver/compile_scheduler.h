@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_DRIVER_COMPILE_SCHEDULER_H_
+#define ART_COMPILER_DRIVER_COMPILE_SCHEDULER_H_
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "atomic.h"
+#include "base/macros.h"
+#include "dex_file.h"
+
+namespace art {
+
+// CompileScheduler splits the classes of a dex file into work items for the compiler threads.
+//
+// The cost of a method is estimated from the size of its code, or taken from the compile time
+// of its class in a previous compilation when available. The work items are handed out largest
+// first and the methods of the classes that would take much longer than the average work of a
+// thread are split over several work items, so that the threads finish at about the same time.
+class CompileScheduler {
+ public:
+  // The methods of a class in the order of the class data, from `begin_method` to `end_method`.
+  struct WorkItem {
+    uint16_t class_def_index;
+    uint32_t begin_method;
+    uint32_t end_method;
+    uint64_t cost;
+  };
+
+  CompileScheduler();
+  ~CompileScheduler();
+
+  // Load the class compile times written by WriteClassTimes() in a previous compilation.
+  bool ReadClassTimes(const std::string& filename, std::string* error_msg);
+
+  // Write the time spent compiling each class, as "<descriptor> <nanoseconds>" lines.
+  bool WriteClassTimes(const std::string& filename, std::string* error_msg) const;
+
+  // Returns the work items for compiling `dex_file` with `thread_count` threads, in the order
+  // they should be handed out.
+  std::vector<WorkItem> Schedule(const DexFile& dex_file, size_t thread_count);
+
+  // Record the time spent compiling a work item. Thread safe.
+  void RecordWorkItemTime(const DexFile& dex_file, const WorkItem& item, uint64_t time_ns);
+
+  // Record how long each thread was busy while compiling a dex file that took `wall_time_ns`.
+  void RecordThreadTimes(uint64_t wall_time_ns, const std::vector<uint64_t>& busy_time_ns);
+
+  void DumpUtilization(std::ostream& os) const;
+
+  // The estimated cost of each method of a class, in the order of the class data.
+  static void EstimateMethodCosts(const DexFile& dex_file,
+                                  uint16_t class_def_index,
+                                  std::vector<uint64_t>* costs);
+
+ private:
+  // The number of work items per thread below which classes are not split.
+  static constexpr size_t kWorkItemsPerThread = 8u;
+
+  // The compile times of the classes of a previous compilation, by descriptor.
+  std::unordered_map<std::string, uint64_t> previous_class_times_;
+
+  // The compile times of the classes of each dex file, by class def index.
+  std::unordered_map<const DexFile*, std::unique_ptr<Atomic<uint64_t>[]>> class_times_;
+
+  uint64_t wall_time_ns_;
+  std::vector<uint64_t> busy_time_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompileScheduler);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_DRIVER_COMPILE_SCHEDULER_H_
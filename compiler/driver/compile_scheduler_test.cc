@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "driver/compile_scheduler.h"
+
+#include "common_runtime_test.h"
+#include "dex_file.h"
+
+namespace art {
+
+class CompileSchedulerTest : public CommonRuntimeTest {
+ protected:
+  // Check that the work items cover each method of each class exactly once and that they are
+  // ordered by decreasing cost.
+  static void CheckWorkItems(const DexFile& dex_file,
+                             const std::vector<CompileScheduler::WorkItem>& work_items) {
+    std::vector<std::vector<bool>> covered(dex_file.NumClassDefs());
+    for (size_t i = 0; i != dex_file.NumClassDefs(); ++i) {
+      std::vector<uint64_t> costs;
+      CompileScheduler::EstimateMethodCosts(dex_file, i, &costs);
+      covered[i].resize(costs.size(), false);
+    }
+    for (size_t i = 0; i != work_items.size(); ++i) {
+      const CompileScheduler::WorkItem& item = work_items[i];
+      ASSERT_LT(item.class_def_index, covered.size());
+      ASSERT_LT(item.begin_method, item.end_method);
+      ASSERT_LE(item.end_method, covered[item.class_def_index].size());
+      for (uint32_t m = item.begin_method; m != item.end_method; ++m) {
+        EXPECT_FALSE(covered[item.class_def_index][m]);
+        covered[item.class_def_index][m] = true;
+      }
+      if (i != 0u) {
+        EXPECT_GE(work_items[i - 1u].cost, item.cost);
+      }
+    }
+    for (const std::vector<bool>& class_covered : covered) {
+      for (bool method_covered : class_covered) {
+        EXPECT_TRUE(method_covered);
+      }
+    }
+  }
+};
+
+TEST_F(CompileSchedulerTest, SingleThread) {
+  std::unique_ptr<const DexFile> dex_file = OpenTestDexFile("Transaction");
+  CompileScheduler scheduler;
+  std::vector<CompileScheduler::WorkItem> work_items = scheduler.Schedule(*dex_file, 1u);
+  CheckWorkItems(*dex_file, work_items);
+  // Classes are not split when there is a single thread.
+  for (const CompileScheduler::WorkItem& item : work_items) {
+    EXPECT_EQ(0u, item.begin_method);
+  }
+}
+
+TEST_F(CompileSchedulerTest, SplitLargeClasses) {
+  std::unique_ptr<const DexFile> dex_file = OpenTestDexFile("Transaction");
+  CompileScheduler scheduler;
+  std::vector<CompileScheduler::WorkItem> work_items = scheduler.Schedule(*dex_file, 64u);
+  CheckWorkItems(*dex_file, work_items);
+  // With many threads, the methods of the largest classes are split over several work items.
+  EXPECT_GT(work_items.size(), scheduler.Schedule(*dex_file, 1u).size());
+}
+
+TEST_F(CompileSchedulerTest, PreviousClassTimes) {
+  std::unique_ptr<const DexFile> dex_file = OpenTestDexFile("Transaction");
+  ScratchFile times_file;
+  size_t slowest_class_def_index;
+  {
+    CompileScheduler scheduler;
+    std::vector<CompileScheduler::WorkItem> work_items = scheduler.Schedule(*dex_file, 1u);
+    ASSERT_GE(work_items.size(), 2u);
+    // Pretend that the cheapest class took the longest to compile.
+    slowest_class_def_index = work_items.back().class_def_index;
+    for (const CompileScheduler::WorkItem& item : work_items) {
+      uint64_t time_ns = (item.class_def_index == slowest_class_def_index) ? 1000000u : 1000u;
+      scheduler.RecordWorkItemTime(*dex_file, item, time_ns);
+    }
+    std::string error_msg;
+    ASSERT_TRUE(scheduler.WriteClassTimes(times_file.GetFilename(), &error_msg)) << error_msg;
+  }
+  CompileScheduler scheduler;
+  std::string error_msg;
+  ASSERT_TRUE(scheduler.ReadClassTimes(times_file.GetFilename(), &error_msg)) << error_msg;
+  std::vector<CompileScheduler::WorkItem> work_items = scheduler.Schedule(*dex_file, 1u);
+  CheckWorkItems(*dex_file, work_items);
+  EXPECT_EQ(slowest_class_def_index, work_items.front().class_def_index);
+}
+
+}  // namespace art
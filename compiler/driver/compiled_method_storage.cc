@@ -198,6 +198,17 @@ void CompiledMethodStorage::DumpMemoryUsage(std::ostream& os, bool extended) con
   }
 }
 
+void CompiledMethodStorage::SetWriteBackBatchSize(size_t batch_size) {
+  CHECK(swap_space_ != nullptr);
+  swap_space_->SetWriteBackBatchSize(batch_size);
+}
+
+void CompiledMethodStorage::WriteBack() const {
+  if (GetWriteBackBatchSize() != 0u) {
+    swap_space_->WriteBack();
+  }
+}
+
 const LengthPrefixedArray<uint8_t>* CompiledMethodStorage::DeduplicateCode(
     const ArrayRef<const uint8_t>& code) {
   return AllocateOrDeduplicateArray(code, &dedupe_code_);
@@ -45,6 +45,17 @@ class CompiledMethodStorage {
     return dedupe_enabled_;
   }
 
+  // Stream the compiled methods to the swap file in batches of `batch_size` bytes, keeping
+  // only the current batch in memory. Requires a swap file.
+  void SetWriteBackBatchSize(size_t batch_size);
+  size_t GetWriteBackBatchSize() const {
+    return (swap_space_ != nullptr) ? swap_space_->GetWriteBackBatchSize() : 0u;
+  }
+
+  // Write back the current batch early, for example at the end of a dex file. Does nothing
+  // unless batches are enabled.
+  void WriteBack() const;
+
   SwapAllocator<void> GetSwapSpaceAllocator() {
     return SwapAllocator<void>(swap_space_.get());
   }
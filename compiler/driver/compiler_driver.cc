@@ -44,7 +44,9 @@
 #include "dex/verified_method.h"
 #include "dex/quick/dex_file_method_inliner.h"
 #include "dex/quick/dex_file_to_method_inliner_map.h"
+#include "driver/compile_cache.h"
 #include "driver/compiler_options.h"
+#include "driver/incremental_compilation.h"
 #include "jni_internal.h"
 #include "object_lock.h"
 #include "profiler.h"
@@ -84,6 +86,9 @@ static constexpr bool kRestrictCompilationFiltersToImage = true;
 // Print additional info during profile guided compilation.
 static constexpr bool kDebugProfileGuidedCompilation = false;
 
+// Whether to run the class initializers of profiled app image classes at compile time.
+static constexpr bool kInitializeAppImageClasses = true;
+
 static double Percentage(size_t x, size_t y) {
   return 100.0 * (static_cast<double>(x)) / (static_cast<double>(x + y));
 }
@@ -397,6 +402,12 @@ CompilerDriver::CompilerDriver(
       compiler_context_(nullptr),
       support_boot_image_fixup_(instruction_set != kMips && instruction_set != kMips64),
       dex_files_for_oat_file_(nullptr),
+      incremental_compilation_(nullptr),
+      compile_shard_index_(0u),
+      num_compile_shards_(0u),
+      compiled_shards_(),
+      compile_cache_(nullptr),
+      compile_scheduler_(),
       compiled_method_storage_(swap_fd),
       profile_compilation_info_(profile_compilation_info),
       max_arena_alloc_(0),
@@ -625,11 +636,24 @@ static void CompileMethod(Thread* self,
         driver->IsMethodToCompile(method_ref) &&
         driver->ShouldCompileBasedOnProfile(method_ref);
 
-    if (compile) {
+    IncrementalCompilation* code_source = driver->GetCompiledCodeSource(dex_file, class_def_idx);
+    if (compile && code_source != nullptr) {
+      compiled_method =
+          code_source->LoadCompiledMethod(driver, dex_file, class_def_idx, method_idx);
+    }
+    CompileCache* compile_cache = driver->GetCompileCache();
+    if (compile && compiled_method == nullptr && compile_cache != nullptr) {
+      compiled_method =
+          compile_cache->LoadCompiledMethod(driver, dex_file, class_def_idx, method_idx);
+    }
+    if (compile && compiled_method == nullptr) {
       // NOTE: if compiler declines to compile this method, it will return null.
       compiled_method = driver->GetCompiler()->Compile(code_item, access_flags, invoke_type,
                                                        class_def_idx, method_idx, class_loader,
                                                        dex_file, dex_cache);
+      if (compiled_method != nullptr && compile_cache != nullptr) {
+        compile_cache->StoreCompiledMethod(dex_file, class_def_idx, method_idx, *compiled_method);
+      }
     }
     if (compiled_method == nullptr &&
         dex_to_dex_compilation_level != optimizer::DexToDexCompilationLevel::kDontDexToDexCompile) {
@@ -956,6 +980,22 @@ bool CompilerDriver::IsClassToCompile(const char* descriptor) const {
   return classes_to_compile_->find(descriptor) != classes_to_compile_->end();
 }
 
+bool CompilerDriver::IsInCompileShard(const DexFile& dex_file, uint16_t class_def_idx) const {
+  return num_compile_shards_ == 0u ||
+      GetShardIndex(class_def_idx, dex_file.NumClassDefs(), num_compile_shards_) ==
+          compile_shard_index_;
+}
+
+IncrementalCompilation* CompilerDriver::GetCompiledCodeSource(const DexFile& dex_file,
+                                                              uint16_t class_def_idx) const {
+  if (!compiled_shards_.empty()) {
+    size_t shard_index =
+        GetShardIndex(class_def_idx, dex_file.NumClassDefs(), compiled_shards_.size());
+    return compiled_shards_[shard_index];
+  }
+  return incremental_compilation_;
+}
+
 bool CompilerDriver::IsMethodToCompile(const MethodReference& method_ref) const {
   if (kRestrictCompilationFiltersToImage && !IsBootImage()) {
     return true;
@@ -1386,9 +1426,11 @@ bool CompilerDriver::CanAssumeStringIsPresentInDexCache(const DexFile& dex_file,
       class_linker->ResolveString(dex_file, string_idx, dex_cache);
       result = true;
     } else {
-      // Just check whether the dex cache already has the string.
+      // Just check whether the dex cache already has the string. Strings can be evicted from
+      // hashed strings arrays.
       DCHECK(Runtime::Current()->UseJitCompilation());
-      result = (dex_cache->GetResolvedString(string_idx) != nullptr);
+      result = !dex_cache->HasHashedStrings() &&
+          (dex_cache->GetResolvedString(string_idx) != nullptr);
     }
   }
   if (result) {
@@ -1901,15 +1943,24 @@ class ParallelCompilationManager {
     return dex_files_;
   }
 
-  void ForAll(size_t begin, size_t end, CompilationVisitor* visitor, size_t work_units)
+  // If `busy_time_ns` is not null, it receives the time each work unit spent visiting.
+  void ForAll(size_t begin,
+              size_t end,
+              CompilationVisitor* visitor,
+              size_t work_units,
+              std::vector<uint64_t>* busy_time_ns = nullptr)
       REQUIRES(!*Locks::mutator_lock_) {
     Thread* self = Thread::Current();
     self->AssertNoPendingException();
     CHECK_GT(work_units, 0U);
 
+    if (busy_time_ns != nullptr) {
+      busy_time_ns->assign(work_units, 0u);
+    }
     index_.StoreRelaxed(begin);
     for (size_t i = 0; i < work_units; ++i) {
-      thread_pool_->AddTask(self, new ForAllClosure(this, end, visitor));
+      uint64_t* task_busy_time_ns = (busy_time_ns != nullptr) ? &(*busy_time_ns)[i] : nullptr;
+      thread_pool_->AddTask(self, new ForAllClosure(this, end, visitor, task_busy_time_ns));
     }
     thread_pool_->StartWorkers(self);
 
@@ -1931,12 +1982,17 @@ class ParallelCompilationManager {
  private:
   class ForAllClosure : public Task {
    public:
-    ForAllClosure(ParallelCompilationManager* manager, size_t end, CompilationVisitor* visitor)
+    ForAllClosure(ParallelCompilationManager* manager,
+                  size_t end,
+                  CompilationVisitor* visitor,
+                  uint64_t* busy_time_ns)
         : manager_(manager),
           end_(end),
-          visitor_(visitor) {}
+          visitor_(visitor),
+          busy_time_ns_(busy_time_ns) {}
 
     virtual void Run(Thread* self) {
+      const uint64_t start_ns = (busy_time_ns_ != nullptr) ? NanoTime() : 0u;
       while (true) {
         const size_t index = manager_->NextIndex();
         if (UNLIKELY(index >= end_)) {
@@ -1945,6 +2001,9 @@ class ParallelCompilationManager {
         visitor_->Visit(index);
         self->AssertNoPendingException();
       }
+      if (busy_time_ns_ != nullptr) {
+        *busy_time_ns_ += NanoTime() - start_ns;
+      }
     }
 
     virtual void Finalize() {
@@ -1955,6 +2014,7 @@ class ParallelCompilationManager {
     ParallelCompilationManager* const manager_;
     const size_t end_;
     CompilationVisitor* const visitor_;
+    uint64_t* const busy_time_ns_;
   };
 
   AtomicInteger index_;
@@ -2435,8 +2495,13 @@ class InitializeClassVisitor : public CompilationVisitor {
           if (!klass->IsInitialized()) {
             // We need to initialize static fields, we only do this for image classes that aren't
             // marked with the $NoPreloadHolder (which implies this should not be initialized early).
-            bool can_init_static_fields = manager_->GetCompiler()->IsBootImage() &&
-                manager_->GetCompiler()->IsImageClass(descriptor) &&
+            // For app images the image classes come from the profile and the initializer runs in
+            // a strict transaction so that it cannot depend on or modify boot image state.
+            const CompilerDriver* const driver = manager_->GetCompiler();
+            const bool is_app_image = driver->InitializesAppImageClasses();
+            bool can_init_static_fields =
+                (driver->IsBootImage() || is_app_image) &&
+                driver->IsImageClass(descriptor) &&
                 !StringPiece(descriptor).ends_with("$NoPreloadHolder;");
             if (can_init_static_fields) {
               VLOG(compiler) << "Initializing: " << descriptor;
@@ -2445,7 +2510,7 @@ class InitializeClassVisitor : public CompilationVisitor {
               // a ReaderWriterMutex but we're holding the mutator lock so we fail mutex sanity
               // checks in Thread::AssertThreadSuspensionIsAllowable.
               Runtime* const runtime = Runtime::Current();
-              Transaction transaction;
+              Transaction transaction(/* strict */ is_app_image);
 
               // Run the class initializer in transaction mode.
               runtime->EnterTransactionMode(&transaction);
@@ -2473,6 +2538,20 @@ class InitializeClassVisitor : public CompilationVisitor {
                 soa.Self()->ClearException();
                 transaction.Rollback();
                 CHECK_EQ(old_status, klass->GetStatus()) << "Previous class status not restored";
+              } else if (transaction.IsStrict() && transaction.HasBootImageWrites()) {
+                // The initializer has side effects on the boot image that would not be visible
+                // at runtime, leave the class to be initialized when the app runs.
+                VLOG(compiler) << "Initialization of " << descriptor
+                    << " aborted because it writes to the boot image";
+                transaction.Rollback();
+                CHECK_EQ(old_status, klass->GetStatus()) << "Previous class status not restored";
+              } else if (transaction.IsStrict() && MayPruneWrittenClasses(&transaction)) {
+                // A class pruned from the app image is loaded again at runtime and its
+                // initializer runs again, so the writes to it must not be kept.
+                VLOG(compiler) << "Initialization of " << descriptor
+                    << " aborted because it writes to a class pruned from the app image";
+                transaction.Rollback();
+                CHECK_EQ(old_status, klass->GetStatus()) << "Previous class status not restored";
               }
             }
           }
@@ -2488,9 +2567,76 @@ class InitializeClassVisitor : public CompilationVisitor {
   }
 
  private:
+  bool MayPruneWrittenClasses(Transaction* transaction) const
+      SHARED_REQUIRES(Locks::mutator_lock_) {
+    std::vector<mirror::Class*> classes;
+    transaction->GetWrittenClasses(&classes);
+    std::unordered_set<mirror::Class*> visited;
+    for (mirror::Class* klass : classes) {
+      if (MayPruneAppImageClass(klass, &visited)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Conservatively checks the conditions of ImageWriter::PruneAppImageClass(), which runs after
+  // all the classes are initialized and cannot roll back their initialization.
+  bool MayPruneAppImageClass(mirror::Class* klass,
+                             std::unordered_set<mirror::Class*>* visited) const
+      SHARED_REQUIRES(Locks::mutator_lock_) {
+    if (klass == nullptr || Runtime::Current()->GetHeap()->ObjectIsInBootImageSpace(klass)) {
+      return false;
+    }
+    // A class already visited is either being checked or was not pruned.
+    if (!visited->insert(klass).second) {
+      return false;
+    }
+    std::string temp;
+    if (klass->GetClassLoader() == nullptr ||
+        klass->IsErroneous() ||
+        !manager_->GetCompiler()->IsImageClass(klass->GetDescriptor(&temp))) {
+      return true;
+    }
+    mirror::DexCache* dex_cache = klass->GetDexCache();
+    if (dex_cache != nullptr &&
+        !ContainsElement(manager_->GetDexFiles(), dex_cache->GetDexFile())) {
+      return true;
+    }
+    mirror::IfTable* if_table = klass->GetIfTable();
+    for (size_t i = 0, num_interfaces = klass->GetIfTableCount(); i != num_interfaces; ++i) {
+      if (MayPruneAppImageClass(if_table->GetInterface(i), visited)) {
+        return true;
+      }
+    }
+    if (klass->IsObjectArrayClass() && MayPruneAppImageClass(klass->GetComponentType(), visited)) {
+      return true;
+    }
+    size_t num_static_fields = klass->NumReferenceStaticFields();
+    if (num_static_fields != 0u && klass->IsResolved()) {
+      MemberOffset field_offset = klass->GetFirstReferenceStaticFieldOffset(
+          Runtime::Current()->GetClassLinker()->GetImagePointerSize());
+      for (size_t i = 0u; i != num_static_fields; ++i) {
+        mirror::Object* ref = klass->GetFieldObject<mirror::Object>(field_offset);
+        if (ref != nullptr &&
+            MayPruneAppImageClass(ref->IsClass() ? ref->AsClass() : ref->GetClass(), visited)) {
+          return true;
+        }
+        field_offset = MemberOffset(field_offset.Uint32Value() +
+                                    sizeof(mirror::HeapReference<mirror::Object>));
+      }
+    }
+    return MayPruneAppImageClass(klass->GetSuperClass(), visited);
+  }
+
   const ParallelCompilationManager* const manager_;
 };
 
+bool CompilerDriver::InitializesAppImageClasses() const {
+  // Only profile guided app images have a list of image classes.
+  return kInitializeAppImageClasses && IsAppImage() && GetImageClasses() != nullptr;
+}
+
 void CompilerDriver::InitializeClasses(jobject jni_class_loader,
                                        const DexFile& dex_file,
                                        const std::vector<const DexFile*>& dex_files,
@@ -2507,7 +2653,7 @@ void CompilerDriver::InitializeClasses(jobject jni_class_loader,
   ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
   ParallelCompilationManager context(class_linker, jni_class_loader, this, &dex_file, dex_files,
                                      init_thread_pool);
-  if (IsBootImage()) {
+  if (IsBootImage() || InitializesAppImageClasses()) {
     // TODO: remove this when transactional mode supports multithreading.
     init_thread_count = 1U;
   }
@@ -2600,6 +2746,8 @@ void CompilerDriver::Compile(jobject class_loader,
     const size_t arena_alloc = arena_pool->GetBytesAllocated();
     max_arena_alloc_ = std::max(arena_alloc, max_arena_alloc_);
     Runtime::Current()->ReclaimArenaPoolMemory();
+    // The code of this dex file is complete, do not keep it in memory until it is written.
+    compiled_method_storage_.WriteBack();
   }
 
   ArrayRef<DexFileMethodSet> dex_to_dex_references;
@@ -2619,16 +2767,31 @@ void CompilerDriver::Compile(jobject class_loader,
                    timings);
   }
   current_dex_to_dex_methods_ = nullptr;
+  compiled_method_storage_.WriteBack();
 
   VLOG(compiler) << "Compile: " << GetMemoryUsageString(false);
 }
 
 class CompileClassVisitor : public CompilationVisitor {
  public:
-  explicit CompileClassVisitor(const ParallelCompilationManager* manager) : manager_(manager) {}
+  CompileClassVisitor(const ParallelCompilationManager* manager,
+                      const std::vector<CompileScheduler::WorkItem>& work_items)
+      : manager_(manager), work_items_(work_items) {}
 
-  virtual void Visit(size_t class_def_index) REQUIRES(!Locks::mutator_lock_) OVERRIDE {
+  virtual void Visit(size_t index) REQUIRES(!Locks::mutator_lock_) OVERRIDE {
     ATRACE_CALL();
+    const CompileScheduler::WorkItem& work_item = work_items_[index];
+    const uint64_t start_ns = NanoTime();
+    CompileWorkItem(work_item);
+    manager_->GetCompiler()->GetCompileScheduler()->RecordWorkItemTime(
+        *manager_->GetDexFile(), work_item, NanoTime() - start_ns);
+  }
+
+ private:
+  // Compile the methods of a class that belong to the work item.
+  void CompileWorkItem(const CompileScheduler::WorkItem& work_item)
+      REQUIRES(!Locks::mutator_lock_) {
+    const uint16_t class_def_index = work_item.class_def_index;
     const DexFile& dex_file = *manager_->GetDexFile();
     const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_index);
     ClassLinker* class_linker = manager_->GetClassLinker();
@@ -2638,6 +2801,10 @@ class CompileClassVisitor : public CompilationVisitor {
     if (manager_->GetCompiler()->verification_results_->IsClassRejected(ref)) {
       return;
     }
+    // The classes of the other shards are compiled by other processes.
+    if (!manager_->GetCompiler()->IsInCompileShard(dex_file, class_def_index)) {
+      return;
+    }
     // Use a scoped object access to perform to the quick SkipClass check.
     const char* descriptor = dex_file.GetClassDescriptor(class_def);
     ScopedObjectAccess soa(Thread::Current());
@@ -2684,10 +2851,13 @@ class CompileClassVisitor : public CompilationVisitor {
     bool compilation_enabled = driver->IsClassToCompile(
         dex_file.StringByTypeIdx(class_def.class_idx_));
 
+    // The position of the method in the class data, see CompileScheduler::WorkItem.
+    uint32_t method_position = 0u;
     // Compile direct methods
     int64_t previous_direct_method_idx = -1;
     while (it.HasNextDirectMethod()) {
       uint32_t method_idx = it.GetMemberIndex();
+      bool in_work_item = IsInWorkItem(work_item, method_position++);
       if (method_idx == previous_direct_method_idx) {
         // smali can create dex files with two encoded_methods sharing the same method_idx
         // http://code.google.com/p/smali/issues/detail?id=119
@@ -2695,16 +2865,19 @@ class CompileClassVisitor : public CompilationVisitor {
         continue;
       }
       previous_direct_method_idx = method_idx;
-      CompileMethod(soa.Self(), driver, it.GetMethodCodeItem(), it.GetMethodAccessFlags(),
-                    it.GetMethodInvokeType(class_def), class_def_index,
-                    method_idx, jclass_loader, dex_file, dex_to_dex_compilation_level,
-                    compilation_enabled, dex_cache);
+      if (in_work_item) {
+        CompileMethod(soa.Self(), driver, it.GetMethodCodeItem(), it.GetMethodAccessFlags(),
+                      it.GetMethodInvokeType(class_def), class_def_index,
+                      method_idx, jclass_loader, dex_file, dex_to_dex_compilation_level,
+                      compilation_enabled, dex_cache);
+      }
       it.Next();
     }
     // Compile virtual methods
     int64_t previous_virtual_method_idx = -1;
     while (it.HasNextVirtualMethod()) {
       uint32_t method_idx = it.GetMemberIndex();
+      bool in_work_item = IsInWorkItem(work_item, method_position++);
       if (method_idx == previous_virtual_method_idx) {
         // smali can create dex files with two encoded_methods sharing the same method_idx
         // http://code.google.com/p/smali/issues/detail?id=119
@@ -2712,17 +2885,23 @@ class CompileClassVisitor : public CompilationVisitor {
         continue;
       }
       previous_virtual_method_idx = method_idx;
-      CompileMethod(soa.Self(), driver, it.GetMethodCodeItem(), it.GetMethodAccessFlags(),
-                    it.GetMethodInvokeType(class_def), class_def_index,
-                    method_idx, jclass_loader, dex_file, dex_to_dex_compilation_level,
-                    compilation_enabled, dex_cache);
+      if (in_work_item) {
+        CompileMethod(soa.Self(), driver, it.GetMethodCodeItem(), it.GetMethodAccessFlags(),
+                      it.GetMethodInvokeType(class_def), class_def_index,
+                      method_idx, jclass_loader, dex_file, dex_to_dex_compilation_level,
+                      compilation_enabled, dex_cache);
+      }
       it.Next();
     }
     DCHECK(!it.HasNext());
   }
 
- private:
+  static bool IsInWorkItem(const CompileScheduler::WorkItem& work_item, uint32_t method_position) {
+    return work_item.begin_method <= method_position && method_position < work_item.end_method;
+  }
+
   const ParallelCompilationManager* const manager_;
+  const std::vector<CompileScheduler::WorkItem>& work_items_;
 };
 
 void CompilerDriver::CompileDexFile(jobject class_loader,
@@ -2734,8 +2913,13 @@ void CompilerDriver::CompileDexFile(jobject class_loader,
   TimingLogger::ScopedTiming t("Compile Dex File", timings);
   ParallelCompilationManager context(Runtime::Current()->GetClassLinker(), class_loader, this,
                                      &dex_file, dex_files, thread_pool);
-  CompileClassVisitor visitor(&context);
-  context.ForAll(0, dex_file.NumClassDefs(), &visitor, thread_count);
+  std::vector<CompileScheduler::WorkItem> work_items =
+      compile_scheduler_.Schedule(dex_file, thread_count);
+  CompileClassVisitor visitor(&context, work_items);
+  std::vector<uint64_t> busy_time_ns;
+  const uint64_t start_ns = NanoTime();
+  context.ForAll(0, work_items.size(), &visitor, thread_count, &busy_time_ns);
+  compile_scheduler_.RecordThreadTimes(NanoTime() - start_ns, busy_time_ns);
 }
 
 void CompilerDriver::AddCompiledMethod(const MethodReference& method_ref,
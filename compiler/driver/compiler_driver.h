@@ -17,6 +17,7 @@
 #ifndef ART_COMPILER_DRIVER_COMPILER_DRIVER_H_
 #define ART_COMPILER_DRIVER_COMPILER_DRIVER_H_
 
+#include <algorithm>
 #include <set>
 #include <string>
 #include <unordered_set>
@@ -30,6 +31,7 @@
 #include "class_reference.h"
 #include "compiler.h"
 #include "dex_file.h"
+#include "driver/compile_scheduler.h"
 #include "driver/compiled_method_storage.h"
 #include "jit/offline_profiling_info.h"
 #include "invoke_type.h"
@@ -58,6 +60,8 @@ class CompiledMethod;
 class CompilerOptions;
 class DexCompilationUnit;
 class DexFileToMethodInlinerMap;
+class CompileCache;
+class IncrementalCompilation;
 struct InlineIGetIPutData;
 class InstructionSetFeatures;
 class ParallelCompilationManager;
@@ -118,6 +122,53 @@ class CompilerDriver {
         : ArrayRef<const DexFile* const>();
   }
 
+  // Reuse the code of the unchanged classes from a previous compilation.
+  void SetIncrementalCompilation(IncrementalCompilation* incremental_compilation) {
+    incremental_compilation_ = incremental_compilation;
+  }
+
+  // Compile only the classes of one shard, so that the shards of a large compilation can be
+  // compiled by separate processes. See GetShardIndex().
+  void SetCompileShard(size_t shard_index, size_t num_shards) {
+    DCHECK_LT(shard_index, num_shards);
+    compile_shard_index_ = shard_index;
+    num_compile_shards_ = num_shards;
+  }
+
+  // Take the code of the classes of each shard out of the output of the compilation of that
+  // shard.
+  void SetCompiledShards(const std::vector<IncrementalCompilation*>& compiled_shards) {
+    DCHECK(std::find(compiled_shards.begin(), compiled_shards.end(), nullptr) ==
+           compiled_shards.end());
+    compiled_shards_ = compiled_shards;
+  }
+
+  // The shards are contiguous ranges of the class definitions of each dex file.
+  static size_t GetShardIndex(size_t class_def_index, size_t num_class_defs, size_t num_shards) {
+    DCHECK_LT(class_def_index, num_class_defs);
+    return class_def_index * num_shards / num_class_defs;
+  }
+
+  bool IsInCompileShard(const DexFile& dex_file, uint16_t class_def_idx) const;
+
+  // Look up the compiled methods in an on-disk cache and add the newly compiled ones to it.
+  void SetCompileCache(CompileCache* compile_cache) {
+    compile_cache_ = compile_cache;
+  }
+
+  CompileCache* GetCompileCache() const {
+    return compile_cache_;
+  }
+
+  // The scheduler of the compilation work, see CompileScheduler.
+  CompileScheduler* GetCompileScheduler() {
+    return &compile_scheduler_;
+  }
+
+  // Returns where to take the already compiled code of a class from, or null.
+  IncrementalCompilation* GetCompiledCodeSource(const DexFile& dex_file,
+                                                uint16_t class_def_idx) const;
+
   void CompileAll(jobject class_loader,
                   const std::vector<const DexFile*>& dex_files,
                   TimingLogger* timings)
@@ -158,6 +209,14 @@ class CompilerDriver {
     return boot_image_;
   }
 
+  // Are we compiling an app image?
+  bool IsAppImage() const {
+    return app_image_;
+  }
+
+  // Are the static initializers of the image classes of an app image run at compile time?
+  bool InitializesAppImageClasses() const;
+
   const std::unordered_set<std::string>* GetImageClasses() const {
     return image_classes_.get();
   }
@@ -465,6 +524,10 @@ class CompilerDriver {
     return &compiled_method_storage_;
   }
 
+  const CompiledMethodStorage* GetCompiledMethodStorage() const {
+    return &compiled_method_storage_;
+  }
+
   // Can we assume that the klass is loaded?
   bool CanAssumeClassIsLoaded(mirror::Class* klass)
       SHARED_REQUIRES(Locks::mutator_lock_);
@@ -704,6 +767,21 @@ class CompilerDriver {
   // List of dex files that will be stored in the oat file.
   const std::vector<const DexFile*>* dex_files_for_oat_file_;
 
+  // Source of the code of unchanged classes, if any. Not owned.
+  IncrementalCompilation* incremental_compilation_;
+
+  // The shard compiled by this process, if the compilation is sharded.
+  size_t compile_shard_index_;
+  size_t num_compile_shards_;
+
+  // The outputs of the compilations of the shards, when merging them. Not owned.
+  std::vector<IncrementalCompilation*> compiled_shards_;
+
+  // The on-disk cache of compiled methods, if any. Not owned.
+  CompileCache* compile_cache_;
+
+  CompileScheduler compile_scheduler_;
+
   CompiledMethodStorage compiled_method_storage_;
 
   // Info for profile guided compilation.
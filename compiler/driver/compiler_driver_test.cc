@@ -23,7 +23,9 @@
 #include "art_method-inl.h"
 #include "class_linker-inl.h"
 #include "common_compiler_test.h"
+#include "compiled_method.h"
 #include "dex_file.h"
+#include "driver/compile_cache.h"
 #include "gc/heap.h"
 #include "mirror/class-inl.h"
 #include "mirror/class_loader.h"
@@ -93,6 +95,37 @@ class CompilerDriverTest : public CommonCompilerTest {
     }
   }
 
+  // Returns whether `compile_cache` has an entry for the method `name` of the class `descriptor`.
+  bool IsMethodCached(CompileCache* compile_cache,
+                      const DexFile& dex_file,
+                      const char* descriptor,
+                      const char* name) {
+    const DexFile::TypeId* type_id = dex_file.FindTypeId(descriptor);
+    CHECK(type_id != nullptr) << descriptor;
+    const DexFile::ClassDef* class_def =
+        dex_file.FindClassDef(dex_file.GetIndexForTypeId(*type_id));
+    CHECK(class_def != nullptr) << descriptor;
+    const uint8_t* class_data = dex_file.GetClassData(*class_def);
+    for (ClassDataItemIterator it(dex_file, class_data); it.HasNext(); it.Next()) {
+      if (!it.HasNextDirectMethod() && !it.HasNextVirtualMethod()) {
+        continue;
+      }
+      uint32_t method_idx = it.GetMemberIndex();
+      if (strcmp(dex_file.GetMethodName(dex_file.GetMethodId(method_idx)), name) != 0) {
+        continue;
+      }
+      CompiledMethod* compiled_method = compile_cache->LoadCompiledMethod(
+          compiler_driver_.get(), dex_file, dex_file.GetIndexForClassDef(*class_def), method_idx);
+      if (compiled_method == nullptr) {
+        return false;
+      }
+      CompiledMethod::ReleaseSwapAllocatedCompiledMethod(compiler_driver_.get(), compiled_method);
+      return true;
+    }
+    LOG(FATAL) << "Method not found: " << descriptor << " " << name;
+    UNREACHABLE();
+  }
+
   JNIEnv* env_;
   jclass class_;
   jmethodID mid_;
@@ -107,10 +140,11 @@ TEST_F(CompilerDriverTest, DISABLED_LARGE_CompileDexLibCore) {
   ASSERT_TRUE(java_lang_dex_file_ != nullptr);
   const DexFile& dex = *java_lang_dex_file_;
   mirror::DexCache* dex_cache = class_linker_->FindDexCache(soa.Self(), dex);
-  EXPECT_EQ(dex.NumStringIds(), dex_cache->NumStrings());
+  EXPECT_EQ(mirror::DexCache::NumStringSlots(dex.NumStringIds()), dex_cache->NumStrings());
+  // With hashed dex cache strings, a string shares its slot with other string indexes.
   for (size_t i = 0; i < dex_cache->NumStrings(); i++) {
-    const mirror::String* string = dex_cache->GetResolvedString(i);
-    EXPECT_TRUE(string != nullptr) << "string_idx=" << i;
+    const mirror::String* string = dex_cache->GetStrings()[i].Read();
+    EXPECT_TRUE(string != nullptr) << "slot=" << i;
   }
   EXPECT_EQ(dex.NumTypeIds(), dex_cache->NumResolvedTypes());
   for (size_t i = 0; i < dex_cache->NumResolvedTypes(); i++) {
@@ -130,12 +164,12 @@ TEST_F(CompilerDriverTest, DISABLED_LARGE_CompileDexLibCore) {
         << " " << dex.GetMethodDeclaringClassDescriptor(dex.GetMethodId(i)) << " "
         << dex.GetMethodName(dex.GetMethodId(i));
   }
-  EXPECT_EQ(dex.NumFieldIds(), dex_cache->NumResolvedFields());
+  EXPECT_EQ(mirror::DexCache::NumFieldSlots(dex.NumFieldIds()), dex_cache->NumResolvedFields());
+  // With hashed dex cache fields, a field shares its slot with other field indexes.
   for (size_t i = 0; i < dex_cache->NumResolvedFields(); i++) {
-    ArtField* field = cl->GetResolvedField(i, dex_cache);
-    EXPECT_TRUE(field != nullptr) << "field_idx=" << i
-                               << " " << dex.GetFieldDeclaringClassDescriptor(dex.GetFieldId(i))
-                               << " " << dex.GetFieldName(dex.GetFieldId(i));
+    ArtField* field =
+        mirror::DexCache::GetElementPtrSize(dex_cache->GetResolvedFields(), i, pointer_size);
+    EXPECT_TRUE(field != nullptr) << "slot=" << i;
   }
 
   // TODO check Class::IsVerified for all classes
@@ -175,6 +209,134 @@ TEST_F(CompilerDriverTest, AbstractMethodErrorStub) {
   }
 }
 
+TEST_F(CompilerDriverTest, CompileShard) {
+  TEST_DISABLED_FOR_READ_BARRIER_WITH_OPTIMIZING_FOR_UNSUPPORTED_INSTRUCTION_SETS();
+  // The shards are contiguous ranges of class definitions.
+  EXPECT_EQ(0u, CompilerDriver::GetShardIndex(0u, 5u, 2u));
+  EXPECT_EQ(0u, CompilerDriver::GetShardIndex(2u, 5u, 2u));
+  EXPECT_EQ(1u, CompilerDriver::GetShardIndex(3u, 5u, 2u));
+  EXPECT_EQ(1u, CompilerDriver::GetShardIndex(4u, 5u, 2u));
+  EXPECT_EQ(0u, CompilerDriver::GetShardIndex(0u, 1u, 2u));
+
+  Thread* self = Thread::Current();
+  jobject class_loader;
+  {
+    ScopedObjectAccess soa(self);
+    class_loader = LoadDex("StaticLeafMethods");
+  }
+  ASSERT_NE(class_loader, nullptr);
+
+  // The only class of the dex file is in the first shard, compiling the second one does nothing.
+  compiler_driver_->SetCompileShard(1u, 2u);
+  CompileAll(class_loader);
+
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  ScopedObjectAccess soa(self);
+  StackHandleScope<1> hs(self);
+  Handle<mirror::ClassLoader> h_loader(hs.NewHandle(
+      reinterpret_cast<mirror::ClassLoader*>(self->DecodeJObject(class_loader))));
+  mirror::Class* klass = class_linker->FindClass(self, "LStaticLeafMethods;", h_loader);
+  ASSERT_NE(klass, nullptr);
+  const auto pointer_size = class_linker->GetImagePointerSize();
+  for (auto& m : klass->GetDirectMethods(pointer_size)) {
+    const void* code = m.GetEntryPointFromQuickCompiledCodePtrSize(pointer_size);
+    ASSERT_NE(code, nullptr);
+    EXPECT_TRUE(class_linker->IsQuickToInterpreterBridge(code)) << PrettyMethod(&m, true);
+  }
+}
+
+TEST_F(CompilerDriverTest, CompileCache) {
+  TEST_DISABLED_FOR_READ_BARRIER_WITH_OPTIMIZING_FOR_UNSUPPORTED_INSTRUCTION_SETS();
+  Thread* self = Thread::Current();
+  jobject class_loader;
+  {
+    ScopedObjectAccess soa(self);
+    class_loader = LoadDex("StaticLeafMethods");
+  }
+  ASSERT_NE(class_loader, nullptr);
+  const std::vector<const DexFile*> dex_files = GetDexFiles(class_loader);
+  ASSERT_EQ(1u, dex_files.size());
+  const DexFile& dex_file = *dex_files[0];
+  std::string cache_dir = android_data_ + "/compile-cache";
+  SafeMap<std::string, std::string> key_value_store;
+  std::string error_msg;
+
+  // The first compilation fills the cache.
+  std::unique_ptr<CompileCache> compile_cache = CompileCache::Create(
+      cache_dir, dex_files, *compiler_driver_, key_value_store, 0u, &error_msg);
+  ASSERT_TRUE(compile_cache != nullptr) << error_msg;
+  compiler_driver_->SetCompileCache(compile_cache.get());
+  CompileAll(class_loader);
+  EXPECT_EQ(0u, compile_cache->GetNumberOfHits());
+  size_t num_stores = compile_cache->GetNumberOfStores();
+  EXPECT_NE(0u, num_stores);
+  SafeMap<uint32_t, std::vector<uint8_t>> code;
+  for (uint32_t method_idx = 0; method_idx != dex_file.NumMethodIds(); ++method_idx) {
+    CompiledMethod* compiled_method =
+        compiler_driver_->GetCompiledMethod(MethodReference(&dex_file, method_idx));
+    if (compiled_method != nullptr) {
+      code.Put(method_idx, std::vector<uint8_t>(compiled_method->GetQuickCode().begin(),
+                                                compiled_method->GetQuickCode().end()));
+    }
+  }
+
+  // The second compilation takes the same code out of the cache.
+  InstructionSet isa = compiler_driver_->GetInstructionSet();
+  CreateCompilerDriver(compiler_kind_, isa);
+  compile_cache = CompileCache::Create(
+      cache_dir, dex_files, *compiler_driver_, key_value_store, 0u, &error_msg);
+  ASSERT_TRUE(compile_cache != nullptr) << error_msg;
+  compiler_driver_->SetCompileCache(compile_cache.get());
+  CompileAll(class_loader);
+  EXPECT_EQ(num_stores, compile_cache->GetNumberOfHits());
+  EXPECT_EQ(0u, compile_cache->GetNumberOfStores());
+  for (const auto& entry : code) {
+    CompiledMethod* compiled_method =
+        compiler_driver_->GetCompiledMethod(MethodReference(&dex_file, entry.first));
+    ASSERT_TRUE(compiled_method != nullptr);
+    EXPECT_TRUE(ArrayRef<const uint8_t>(entry.second) == compiled_method->GetQuickCode());
+  }
+
+  // Changing a class invalidates the methods loading a field or calling a method of that type,
+  // even though their code does not name the class. ClassDependenciesModified has the same ids
+  // as ClassDependencies and only the code of Value differs.
+  jobject original_class_loader;
+  jobject modified_class_loader;
+  {
+    ScopedObjectAccess soa(self);
+    original_class_loader = LoadDex("ClassDependencies");
+    modified_class_loader = LoadDex("ClassDependenciesModified");
+  }
+  ASSERT_NE(original_class_loader, nullptr);
+  ASSERT_NE(modified_class_loader, nullptr);
+  const std::vector<const DexFile*> original_dex_files = GetDexFiles(original_class_loader);
+  const std::vector<const DexFile*> modified_dex_files = GetDexFiles(modified_class_loader);
+  ASSERT_EQ(1u, original_dex_files.size());
+  ASSERT_EQ(1u, modified_dex_files.size());
+  CreateCompilerDriver(compiler_kind_, isa);
+  compile_cache = CompileCache::Create(
+      cache_dir, original_dex_files, *compiler_driver_, key_value_store, 0u, &error_msg);
+  ASSERT_TRUE(compile_cache != nullptr) << error_msg;
+  compiler_driver_->SetCompileCache(compile_cache.get());
+  CompileAll(original_class_loader);
+  const DexFile& original_dex_file = *original_dex_files[0];
+  EXPECT_TRUE(IsMethodCached(compile_cache.get(), original_dex_file, "LFieldUser;", "field"));
+  EXPECT_TRUE(IsMethodCached(compile_cache.get(), original_dex_file, "LReturnUser;", "result"));
+  EXPECT_TRUE(IsMethodCached(compile_cache.get(), original_dex_file, "LUnrelated;", "run"));
+
+  CreateCompilerDriver(compiler_kind_, isa);
+  compile_cache = CompileCache::Create(
+      cache_dir, modified_dex_files, *compiler_driver_, key_value_store, 0u, &error_msg);
+  ASSERT_TRUE(compile_cache != nullptr) << error_msg;
+  const DexFile& modified_dex_file = *modified_dex_files[0];
+  EXPECT_FALSE(IsMethodCached(compile_cache.get(), modified_dex_file, "LFieldUser;", "field"));
+  EXPECT_FALSE(IsMethodCached(compile_cache.get(), modified_dex_file, "LReturnUser;", "result"));
+  EXPECT_TRUE(IsMethodCached(compile_cache.get(), modified_dex_file, "LUnrelated;", "run"));
+
+  ClearDirectory(cache_dir.c_str());
+  rmdir(cache_dir.c_str());
+}
+
 class CompilerDriverMethodsTest : public CompilerDriverTest {
  protected:
   std::unordered_set<std::string>* GetCompiledMethods() OVERRIDE {
@@ -315,6 +477,51 @@ TEST_F(CompilerDriverProfileTest, ProfileGuidedCompilation) {
   CheckCompiledMethods(class_loader, "LSecond;", s);
 }
 
+class CompilerDriverAppImageTest : public CompilerDriverTest {
+ protected:
+  std::unordered_set<std::string>* GetImageClasses() OVERRIDE {
+    return new std::unordered_set<std::string>({
+        "LTransaction$StaticFieldClass;",
+        "LTransaction$AppImagePrunedClass;"
+    });
+  }
+
+  bool IsAppImage() const OVERRIDE {
+    return true;
+  }
+};
+
+TEST_F(CompilerDriverAppImageTest, DoNotInitializePrunedClasses) {
+  TEST_DISABLED_FOR_READ_BARRIER_WITH_OPTIMIZING_FOR_UNSUPPORTED_INSTRUCTION_SETS();
+  Thread* self = Thread::Current();
+  jobject class_loader;
+  {
+    ScopedObjectAccess soa(self);
+    class_loader = LoadDex("Transaction");
+  }
+  ASSERT_NE(class_loader, nullptr);
+  ASSERT_TRUE(compiler_driver_->InitializesAppImageClasses());
+
+  CompileAll(class_loader);
+
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  ScopedObjectAccess soa(self);
+  StackHandleScope<1> hs(self);
+  Handle<mirror::ClassLoader> h_loader(hs.NewHandle(
+      reinterpret_cast<mirror::ClassLoader*>(self->DecodeJObject(class_loader))));
+  mirror::Class* kept_class =
+      class_linker->FindClass(self, "LTransaction$StaticFieldClass;", h_loader);
+  ASSERT_NE(kept_class, nullptr);
+  EXPECT_TRUE(kept_class->IsInitialized());
+  // The image writer would prune AppImagePrunedClass and the class would be initialized again
+  // at runtime, so it must be left uninitialized.
+  mirror::Class* pruned_class =
+      class_linker->FindClass(self, "LTransaction$AppImagePrunedClass;", h_loader);
+  ASSERT_NE(pruned_class, nullptr);
+  EXPECT_TRUE(pruned_class->IsVerified());
+  EXPECT_FALSE(pruned_class->IsInitialized());
+}
+
 // TODO: need check-cast test (when stub complete & we can throw/catch
 
 }  // namespace art
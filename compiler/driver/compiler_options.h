@@ -245,6 +245,12 @@ class CompilerOptions FINAL {
     return force_determinism_;
   }
 
+  // Should the oat file record the linker patches, so that its code can be reused by a later
+  // compilation of the same dex files?
+  bool GetRecordLinkerPatches() const {
+    return record_linker_patches_;
+  }
+
  private:
   void ParseDumpInitFailures(const StringPiece& option, UsageFn Usage);
   void ParseDumpCfgPasses(const StringPiece& option, UsageFn Usage);
@@ -298,6 +304,8 @@ class CompilerOptions FINAL {
   // outcomes.
   bool force_determinism_;
 
+  bool record_linker_patches_;
+
   friend class Dex2Oat;
 
   DISALLOW_COPY_AND_ASSIGN(CompilerOptions);
@@ -0,0 +1,547 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "driver/incremental_compilation.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+
+#include "arch/instruction_set_features.h"
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "compiled_method.h"
+#include "dex_file-inl.h"
+#include "dex_instruction-inl.h"
+#include "driver/compiler_driver.h"
+#include "driver/compiler_options.h"
+#include "leb128.h"
+#include "oat.h"
+#include "oat_file-inl.h"
+#include "oat_quick_method_header.h"
+#include "stack_map.h"
+#include "utils/array_ref.h"
+
+namespace art {
+
+std::unique_ptr<IncrementalCompilation> IncrementalCompilation::Create(
+    const std::string& oat_filename,
+    const std::vector<const DexFile*>& dex_files,
+    const CompilerDriver& driver,
+    const SafeMap<std::string, std::string>& key_value_store,
+    uint32_t image_file_location_oat_checksum,
+    std::string* error_msg) {
+  std::unique_ptr<OatFile> oat_file(OatFile::Open(oat_filename,
+                                                  oat_filename,
+                                                  /* requested_base */ nullptr,
+                                                  /* oat_file_begin */ nullptr,
+                                                  /* executable */ false,
+                                                  /* low_4gb */ false,
+                                                  /* abs_dex_location */ nullptr,
+                                                  error_msg));
+  if (oat_file == nullptr) {
+    *error_msg = StringPrintf("Failed to open '%s': %s", oat_filename.c_str(), error_msg->c_str());
+    return nullptr;
+  }
+  uint32_t patch_table_offset = oat_file->GetOatHeader().GetLinkerPatchesOffset();
+  if (patch_table_offset == 0u) {
+    *error_msg = StringPrintf("'%s' was compiled without --record-linker-patches",
+                              oat_filename.c_str());
+    return nullptr;
+  }
+  if (patch_table_offset >= oat_file->Size() ||
+      linker::LinkerPatchTable::GetSize(oat_file->Begin() + patch_table_offset,
+                                        oat_file->Size() - patch_table_offset) == 0u) {
+    *error_msg = StringPrintf("Invalid linker patches in '%s'", oat_filename.c_str());
+    return nullptr;
+  }
+  const uint8_t* patch_table = oat_file->Begin() + patch_table_offset;
+  std::unique_ptr<IncrementalCompilation> incremental_compilation(
+      new IncrementalCompilation(std::move(oat_file), patch_table));
+  if (!incremental_compilation->CheckOatHeader(
+          driver, key_value_store, image_file_location_oat_checksum, error_msg)) {
+    *error_msg = StringPrintf("Cannot reuse '%s': %s", oat_filename.c_str(), error_msg->c_str());
+    return nullptr;
+  }
+  incremental_compilation->FindReusableClasses(dex_files);
+  return incremental_compilation;
+}
+
+IncrementalCompilation::IncrementalCompilation(std::unique_ptr<OatFile> oat_file,
+                                               const uint8_t* patch_table)
+    : oat_file_(std::move(oat_file)),
+      patch_table_(patch_table),
+      patch_target_dex_files_(),
+      dex_file_data_(),
+      num_classes_(0u),
+      num_reusable_classes_(0u),
+      num_reused_methods_(0u) {
+}
+
+IncrementalCompilation::~IncrementalCompilation() {
+}
+
+bool IncrementalCompilation::CheckOatHeader(
+    const CompilerDriver& driver,
+    const SafeMap<std::string, std::string>& key_value_store,
+    uint32_t image_file_location_oat_checksum,
+    std::string* error_msg) const {
+  if (driver.IsBootImage() || driver.IsAppImage()) {
+    *error_msg = "images are always compiled from scratch";
+    return false;
+  }
+  if (driver.GetCompilerOptions().GenerateAnyDebugInfo()) {
+    // The debug info of the previous compilation is not recorded in the oat file.
+    *error_msg = "debug info is generated";
+    return false;
+  }
+  const OatHeader& header = oat_file_->GetOatHeader();
+  if (header.GetInstructionSet() != driver.GetInstructionSet() ||
+      header.GetInstructionSetFeaturesBitmap() != driver.GetInstructionSetFeatures()->AsBitmap()) {
+    *error_msg = "compiled for a different instruction set";
+    return false;
+  }
+  if (header.GetImageFileLocationOatChecksum() != image_file_location_oat_checksum) {
+    *error_msg = "compiled against a different boot image";
+    return false;
+  }
+  static const char* const kKeys[] = {
+      OatHeader::kPicKey,
+      OatHeader::kHasPatchInfoKey,
+      OatHeader::kDebuggableKey,
+      OatHeader::kNativeDebuggableKey,
+      OatHeader::kCompilerFilter,
+      OatHeader::kClassPathKey,
+      OatHeader::kBootClassPathKey,
+  };
+  for (const char* key : kKeys) {
+    const char* old_value = header.GetStoreValueByKey(key);
+    auto it = key_value_store.find(key);
+    const char* new_value = (it != key_value_store.end()) ? it->second.c_str() : nullptr;
+    if ((old_value == nullptr) != (new_value == nullptr) ||
+        (old_value != nullptr && strcmp(old_value, new_value) != 0)) {
+      *error_msg = StringPrintf("different %s", key);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IncrementalCompilation::IdsEqual(const DexFile& old_dex_file, const DexFile& new_dex_file) {
+  if (old_dex_file.NumStringIds() != new_dex_file.NumStringIds() ||
+      old_dex_file.NumTypeIds() != new_dex_file.NumTypeIds() ||
+      old_dex_file.NumProtoIds() != new_dex_file.NumProtoIds() ||
+      old_dex_file.NumFieldIds() != new_dex_file.NumFieldIds() ||
+      old_dex_file.NumMethodIds() != new_dex_file.NumMethodIds() ||
+      old_dex_file.NumClassDefs() != new_dex_file.NumClassDefs()) {
+    return false;
+  }
+  for (uint32_t i = 0; i != new_dex_file.NumStringIds(); ++i) {
+    uint32_t old_length;
+    uint32_t new_length;
+    const char* old_data = old_dex_file.StringDataAndUtf16LengthByIdx(i, &old_length);
+    const char* new_data = new_dex_file.StringDataAndUtf16LengthByIdx(i, &new_length);
+    if (old_length != new_length || strcmp(old_data, new_data) != 0) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i != new_dex_file.NumTypeIds(); ++i) {
+    if (old_dex_file.GetTypeId(i).descriptor_idx_ != new_dex_file.GetTypeId(i).descriptor_idx_) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i != new_dex_file.NumProtoIds(); ++i) {
+    const DexFile::ProtoId& old_proto_id = old_dex_file.GetProtoId(i);
+    const DexFile::ProtoId& new_proto_id = new_dex_file.GetProtoId(i);
+    if (old_proto_id.shorty_idx_ != new_proto_id.shorty_idx_ ||
+        old_proto_id.return_type_idx_ != new_proto_id.return_type_idx_) {
+      return false;
+    }
+    const DexFile::TypeList* old_params = old_dex_file.GetProtoParameters(old_proto_id);
+    const DexFile::TypeList* new_params = new_dex_file.GetProtoParameters(new_proto_id);
+    uint32_t num_params = (new_params != nullptr) ? new_params->Size() : 0u;
+    if (((old_params != nullptr) ? old_params->Size() : 0u) != num_params) {
+      return false;
+    }
+    for (uint32_t j = 0; j != num_params; ++j) {
+      if (old_params->GetTypeItem(j).type_idx_ != new_params->GetTypeItem(j).type_idx_) {
+        return false;
+      }
+    }
+  }
+  for (uint32_t i = 0; i != new_dex_file.NumFieldIds(); ++i) {
+    const DexFile::FieldId& old_field_id = old_dex_file.GetFieldId(i);
+    const DexFile::FieldId& new_field_id = new_dex_file.GetFieldId(i);
+    if (old_field_id.class_idx_ != new_field_id.class_idx_ ||
+        old_field_id.type_idx_ != new_field_id.type_idx_ ||
+        old_field_id.name_idx_ != new_field_id.name_idx_) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i != new_dex_file.NumMethodIds(); ++i) {
+    const DexFile::MethodId& old_method_id = old_dex_file.GetMethodId(i);
+    const DexFile::MethodId& new_method_id = new_dex_file.GetMethodId(i);
+    if (old_method_id.class_idx_ != new_method_id.class_idx_ ||
+        old_method_id.proto_idx_ != new_method_id.proto_idx_ ||
+        old_method_id.name_idx_ != new_method_id.name_idx_) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i != new_dex_file.NumClassDefs(); ++i) {
+    if (old_dex_file.GetClassDef(i).class_idx_ != new_dex_file.GetClassDef(i).class_idx_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the end of the encoded catch handlers of a code item with tries.
+static const uint8_t* GetCatchHandlerDataEnd(const DexFile::CodeItem* code_item) {
+  const uint8_t* ptr = DexFile::GetCatchHandlerData(*code_item, 0u);
+  uint32_t num_handlers = DecodeUnsignedLeb128(&ptr);
+  for (uint32_t i = 0; i != num_handlers; ++i) {
+    int32_t size = DecodeSignedLeb128(&ptr);
+    for (int32_t j = 0, num_typed = std::abs(size); j != num_typed; ++j) {
+      DecodeUnsignedLeb128(&ptr);  // Type index.
+      DecodeUnsignedLeb128(&ptr);  // Handler address.
+    }
+    if (size <= 0) {
+      DecodeUnsignedLeb128(&ptr);  // Catch-all handler address.
+    }
+  }
+  return ptr;
+}
+
+bool IncrementalCompilation::CodeItemsEqual(const DexFile::CodeItem* old_code_item,
+                                            const DexFile::CodeItem* new_code_item) {
+  if (old_code_item == nullptr || new_code_item == nullptr) {
+    return old_code_item == new_code_item;
+  }
+  if (old_code_item->registers_size_ != new_code_item->registers_size_ ||
+      old_code_item->ins_size_ != new_code_item->ins_size_ ||
+      old_code_item->outs_size_ != new_code_item->outs_size_ ||
+      old_code_item->tries_size_ != new_code_item->tries_size_ ||
+      old_code_item->insns_size_in_code_units_ != new_code_item->insns_size_in_code_units_ ||
+      memcmp(old_code_item->insns_,
+             new_code_item->insns_,
+             new_code_item->insns_size_in_code_units_ * sizeof(uint16_t)) != 0) {
+    return false;
+  }
+  if (new_code_item->tries_size_ != 0u) {
+    // The try items and the catch handlers follow each other.
+    const uint8_t* old_tries =
+        reinterpret_cast<const uint8_t*>(DexFile::GetTryItems(*old_code_item, 0u));
+    const uint8_t* new_tries =
+        reinterpret_cast<const uint8_t*>(DexFile::GetTryItems(*new_code_item, 0u));
+    size_t old_size = GetCatchHandlerDataEnd(old_code_item) - old_tries;
+    size_t new_size = GetCatchHandlerDataEnd(new_code_item) - new_tries;
+    if (old_size != new_size || memcmp(old_tries, new_tries, new_size) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IncrementalCompilation::ClassDefsEqual(const DexFile& old_dex_file,
+                                            const DexFile& new_dex_file,
+                                            uint16_t class_def_idx) {
+  const DexFile::ClassDef& old_class_def = old_dex_file.GetClassDef(class_def_idx);
+  const DexFile::ClassDef& new_class_def = new_dex_file.GetClassDef(class_def_idx);
+  if (old_class_def.access_flags_ != new_class_def.access_flags_ ||
+      old_class_def.superclass_idx_ != new_class_def.superclass_idx_) {
+    return false;
+  }
+  const DexFile::TypeList* old_interfaces = old_dex_file.GetInterfacesList(old_class_def);
+  const DexFile::TypeList* new_interfaces = new_dex_file.GetInterfacesList(new_class_def);
+  uint32_t num_interfaces = (new_interfaces != nullptr) ? new_interfaces->Size() : 0u;
+  if (((old_interfaces != nullptr) ? old_interfaces->Size() : 0u) != num_interfaces) {
+    return false;
+  }
+  for (uint32_t i = 0; i != num_interfaces; ++i) {
+    if (old_interfaces->GetTypeItem(i).type_idx_ != new_interfaces->GetTypeItem(i).type_idx_) {
+      return false;
+    }
+  }
+
+  const uint8_t* old_class_data = old_dex_file.GetClassData(old_class_def);
+  const uint8_t* new_class_data = new_dex_file.GetClassData(new_class_def);
+  if (old_class_data == nullptr || new_class_data == nullptr) {
+    return old_class_data == new_class_data;
+  }
+  ClassDataItemIterator old_it(old_dex_file, old_class_data);
+  ClassDataItemIterator new_it(new_dex_file, new_class_data);
+  if (old_it.NumStaticFields() != new_it.NumStaticFields() ||
+      old_it.NumInstanceFields() != new_it.NumInstanceFields() ||
+      old_it.NumDirectMethods() != new_it.NumDirectMethods() ||
+      old_it.NumVirtualMethods() != new_it.NumVirtualMethods()) {
+    return false;
+  }
+  for (; new_it.HasNext(); old_it.Next(), new_it.Next()) {
+    if (old_it.GetMemberIndex() != new_it.GetMemberIndex() ||
+        old_it.GetRawMemberAccessFlags() != new_it.GetRawMemberAccessFlags()) {
+      return false;
+    }
+    if ((new_it.HasNextDirectMethod() || new_it.HasNextVirtualMethod()) &&
+        !CodeItemsEqual(old_it.GetMethodCodeItem(), new_it.GetMethodCodeItem())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the descriptor of the class of a type, that is the element type of an array type.
+static const char* GetClassDescriptor(const DexFile& dex_file, uint32_t type_idx) {
+  const char* descriptor = dex_file.StringByTypeIdx(type_idx);
+  while (*descriptor == '[') {
+    ++descriptor;
+  }
+  return descriptor;
+}
+
+// Adds the descriptors of the classes of the return and parameter types of a prototype.
+static void CollectProtoClasses(const DexFile& dex_file,
+                                uint32_t proto_idx,
+                                std::vector<std::string>* descriptors) {
+  const DexFile::ProtoId& proto_id = dex_file.GetProtoId(proto_idx);
+  descriptors->push_back(GetClassDescriptor(dex_file, proto_id.return_type_idx_));
+  const DexFile::TypeList* parameters = dex_file.GetProtoParameters(proto_id);
+  for (uint32_t i = 0, size = (parameters != nullptr) ? parameters->Size() : 0u; i != size; ++i) {
+    descriptors->push_back(GetClassDescriptor(dex_file, parameters->GetTypeItem(i).type_idx_));
+  }
+}
+
+void IncrementalCompilation::CollectReferencedClasses(const DexFile& dex_file,
+                                                      uint16_t class_def_idx,
+                                                      std::vector<std::string>* descriptors) {
+  const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_idx);
+  if (class_def.superclass_idx_ != DexFile::kDexNoIndex16) {
+    descriptors->push_back(GetClassDescriptor(dex_file, class_def.superclass_idx_));
+  }
+  const DexFile::TypeList* interfaces = dex_file.GetInterfacesList(class_def);
+  for (uint32_t i = 0, size = (interfaces != nullptr) ? interfaces->Size() : 0u; i != size; ++i) {
+    descriptors->push_back(GetClassDescriptor(dex_file, interfaces->GetTypeItem(i).type_idx_));
+  }
+  const uint8_t* class_data = dex_file.GetClassData(class_def);
+  if (class_data == nullptr) {
+    return;
+  }
+  for (ClassDataItemIterator it(dex_file, class_data); it.HasNext(); it.Next()) {
+    const DexFile::CodeItem* code_item =
+        (it.HasNextDirectMethod() || it.HasNextVirtualMethod()) ? it.GetMethodCodeItem() : nullptr;
+    if (code_item == nullptr) {
+      continue;
+    }
+    // The compiler uses the types of the parameters, of the loaded fields, of the values returned
+    // by calls and of the caught exceptions, for example to remove type checks.
+    CollectProtoClasses(dex_file,
+                        dex_file.GetMethodId(it.GetMemberIndex()).proto_idx_,
+                        descriptors);
+    if (code_item->tries_size_ != 0u) {
+      const uint8_t* handlers_ptr = DexFile::GetCatchHandlerData(*code_item, 0);
+      uint32_t handlers_size = DecodeUnsignedLeb128(&handlers_ptr);
+      for (uint32_t idx = 0; idx < handlers_size; ++idx) {
+        CatchHandlerIterator iterator(handlers_ptr);
+        for (; iterator.HasNext(); iterator.Next()) {
+          if (iterator.GetHandlerTypeIndex() != DexFile::kDexNoIndex16) {
+            descriptors->push_back(GetClassDescriptor(dex_file, iterator.GetHandlerTypeIndex()));
+          }
+        }
+        handlers_ptr = iterator.EndDataPointer();
+      }
+    }
+    const Instruction* inst = Instruction::At(code_item->insns_);
+    const Instruction* end = Instruction::At(code_item->insns_ +
+                                             code_item->insns_size_in_code_units_);
+    for (; inst < end; inst = inst->Next()) {
+      Instruction::Code opcode = inst->Opcode();
+      Instruction::IndexType index_type = Instruction::IndexTypeOf(opcode);
+      if (index_type != Instruction::kIndexTypeRef &&
+          index_type != Instruction::kIndexFieldRef &&
+          index_type != Instruction::kIndexMethodRef) {
+        continue;
+      }
+      uint32_t index = (Instruction::FormatOf(opcode) == Instruction::k22c)
+          ? inst->VRegC_22c()
+          : inst->VRegB();
+      if (index_type == Instruction::kIndexTypeRef) {
+        descriptors->push_back(GetClassDescriptor(dex_file, index));
+      } else if (index_type == Instruction::kIndexFieldRef) {
+        const DexFile::FieldId& field_id = dex_file.GetFieldId(index);
+        descriptors->push_back(GetClassDescriptor(dex_file, field_id.class_idx_));
+        descriptors->push_back(GetClassDescriptor(dex_file, field_id.type_idx_));
+      } else {
+        const DexFile::MethodId& method_id = dex_file.GetMethodId(index);
+        descriptors->push_back(GetClassDescriptor(dex_file, method_id.class_idx_));
+        CollectProtoClasses(dex_file, method_id.proto_idx_, descriptors);
+      }
+    }
+  }
+}
+
+void IncrementalCompilation::FindReusableClasses(const std::vector<const DexFile*>& dex_files) {
+  const std::vector<const OatDexFile*>& oat_dex_files = oat_file_->GetOatDexFiles();
+  patch_target_dex_files_.assign(oat_dex_files.size(), nullptr);
+
+  // Compare the dex files with the ones of the previous compilation.
+  struct ClassInfo {
+    const DexFile* dex_file;
+    uint16_t class_def_idx;
+    bool reusable;
+  };
+  std::vector<ClassInfo> classes;
+  std::unordered_map<std::string, size_t> class_indexes;
+  for (const DexFile* dex_file : dex_files) {
+    DexFileData data = { nullptr, 0u, nullptr, std::vector<bool>() };
+    for (size_t i = 0; i != oat_dex_files.size(); ++i) {
+      if (oat_dex_files[i]->GetDexFileLocation() == dex_file->GetLocation()) {
+        std::string error_msg;
+        std::unique_ptr<const DexFile> old_dex_file = oat_dex_files[i]->OpenDexFile(&error_msg);
+        if (old_dex_file == nullptr) {
+          LOG(WARNING) << "Failed to open previous " << dex_file->GetLocation() << ": "
+                       << error_msg;
+        } else if (IdsEqual(*old_dex_file, *dex_file)) {
+          data.oat_dex_file = oat_dex_files[i];
+          data.oat_dex_file_index = i;
+          data.old_dex_file = std::move(old_dex_file);
+          patch_target_dex_files_[i] = dex_file;
+        }
+        break;
+      }
+    }
+    for (uint16_t i = 0; i != dex_file->NumClassDefs(); ++i) {
+      bool reusable = (data.old_dex_file != nullptr) &&
+          ClassDefsEqual(*data.old_dex_file, *dex_file, i);
+      // Only the first definition of a class is ever used.
+      class_indexes.emplace(dex_file->GetClassDescriptor(dex_file->GetClassDef(i)),
+                            classes.size());
+      classes.push_back({ dex_file, i, reusable });
+    }
+    data.reusable_classes.resize(dex_file->NumClassDefs(), false);
+    dex_file_data_.Put(dex_file, std::move(data));
+  }
+
+  // A class depending on a changed class cannot be reused either.
+  std::vector<std::vector<size_t>> dependents(classes.size());
+  std::vector<std::string> descriptors;
+  for (size_t i = 0; i != classes.size(); ++i) {
+    descriptors.clear();
+    CollectReferencedClasses(*classes[i].dex_file, classes[i].class_def_idx, &descriptors);
+    for (const std::string& descriptor : descriptors) {
+      auto it = class_indexes.find(descriptor);
+      if (it != class_indexes.end() && it->second != i) {
+        dependents[it->second].push_back(i);
+      }
+    }
+  }
+  std::deque<size_t> worklist;
+  for (size_t i = 0; i != classes.size(); ++i) {
+    if (!classes[i].reusable) {
+      worklist.push_back(i);
+    }
+  }
+  while (!worklist.empty()) {
+    size_t changed = worklist.front();
+    worklist.pop_front();
+    for (size_t dependent : dependents[changed]) {
+      if (classes[dependent].reusable) {
+        classes[dependent].reusable = false;
+        worklist.push_back(dependent);
+      }
+    }
+  }
+
+  num_classes_ = classes.size();
+  for (const ClassInfo& info : classes) {
+    if (info.reusable) {
+      auto data_it = dex_file_data_.find(info.dex_file);
+      DCHECK(data_it != dex_file_data_.end());
+      data_it->second.reusable_classes[info.class_def_idx] = true;
+      ++num_reusable_classes_;
+    }
+  }
+}
+
+CompiledMethod* IncrementalCompilation::LoadCompiledMethod(CompilerDriver* driver,
+                                                           const DexFile& dex_file,
+                                                           uint16_t class_def_idx,
+                                                           uint32_t method_idx) {
+  auto data_it = dex_file_data_.find(&dex_file);
+  if (data_it == dex_file_data_.end() || !data_it->second.reusable_classes[class_def_idx]) {
+    return nullptr;
+  }
+  const DexFileData& data = data_it->second;
+
+  // Find the index of the method within its class, which is the same in both dex files.
+  const uint8_t* class_data = dex_file.GetClassData(dex_file.GetClassDef(class_def_idx));
+  DCHECK(class_data != nullptr);
+  ClassDataItemIterator it(dex_file, class_data);
+  while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+    it.Next();
+  }
+  uint32_t class_method_index = 0u;
+  while (it.HasNext() && it.GetMemberIndex() != method_idx) {
+    ++class_method_index;
+    it.Next();
+  }
+  DCHECK(it.HasNext());
+
+  const OatFile::OatMethod oat_method =
+      data.oat_dex_file->GetOatClass(class_def_idx).GetOatMethod(class_method_index);
+  const OatQuickMethodHeader* method_header = oat_method.GetOatQuickMethodHeader();
+  if (method_header == nullptr || !method_header->IsOptimized()) {
+    return nullptr;
+  }
+  std::vector<LinkerPatch> patches;
+  std::vector<uint8_t> original_code;
+  if (!patch_table_.Decode(
+          data.oat_dex_file_index, method_idx, patch_target_dex_files_, &patches, &original_code)) {
+    return nullptr;
+  }
+
+  // Undo the patching done when writing the previous oat file.
+  std::vector<uint8_t> code(method_header->GetCode(),
+                            method_header->GetCode() + method_header->GetCodeSize());
+  for (size_t i = 0; i != patches.size(); ++i) {
+    size_t literal_offset = patches[i].LiteralOffset();
+    DCHECK_LE(literal_offset + linker::LinkerPatchTable::kPatchSiteSize, code.size());
+    std::copy_n(original_code.begin() + i * linker::LinkerPatchTable::kPatchSiteSize,
+                linker::LinkerPatchTable::kPatchSiteSize,
+                code.begin() + literal_offset);
+  }
+  const uint8_t* code_info = reinterpret_cast<const uint8_t*>(
+      method_header->GetOptimizedCodeInfoPtr());
+  CodeInfoEncoding encoding(code_info);
+  ArrayRef<const uint8_t> vmap_table(code_info, encoding.header_size + encoding.non_header_size);
+  QuickMethodFrameInfo frame_info = method_header->GetFrameInfo();
+  CompiledMethod* compiled_method = CompiledMethod::SwapAllocCompiledMethod(
+      driver,
+      driver->GetInstructionSet(),
+      ArrayRef<const uint8_t>(code),
+      frame_info.FrameSizeInBytes(),
+      frame_info.CoreSpillMask(),
+      frame_info.FpSpillMask(),
+      /* src_mapping_table */ ArrayRef<const SrcMapElem>(),
+      vmap_table,
+      /* cfi_info */ ArrayRef<const uint8_t>(),
+      ArrayRef<const LinkerPatch>(patches));
+  num_reused_methods_.FetchAndAddRelaxed(1u);
+  return compiled_method;
+}
+
+}  // namespace art
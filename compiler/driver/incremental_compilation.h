@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_DRIVER_INCREMENTAL_COMPILATION_H_
+#define ART_COMPILER_DRIVER_INCREMENTAL_COMPILATION_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "base/macros.h"
+#include "dex_file.h"
+#include "linker/linker_patch_table.h"
+#include "oat_file.h"
+#include "safe_map.h"
+
+namespace art {
+
+class CompiledMethod;
+class CompilerDriver;
+
+// IncrementalCompilation takes the compiled code of the classes that did not change out of the
+// oat file of a previous compilation, so that only the changed classes are compiled again.
+//
+// The previous oat file must have been written with --record-linker-patches, for the same
+// instruction set, boot image, class path and compiler options. A class is reused when
+//   - the ids of its dex file are identical in both compilations, so that all the indexes
+//     embedded in the code and the linker patches keep their meaning,
+//   - its definition and the code of its methods did not change, and
+//   - none of the classes it depends on changed, where a class depends on its superclass,
+//     its interfaces, the signatures of its methods that have code and all the classes whose
+//     types, fields or methods this code references, including the types of those fields, the
+//     signatures of those methods and the caught exception types.
+// The last rule is transitive and conservatively covers the code inlined from other classes.
+// The code of the reused methods is copied out of the previous oat file, the code at the patch
+// sites is restored and the patches are linked again when writing the new oat file.
+//
+// The same mechanism merges the outputs of a sharded compilation, where each shard is an oat
+// file compiled from the same dex files. See CompilerDriver::SetCompileShard().
+class IncrementalCompilation {
+ public:
+  // Open the previous oat file and find the reusable classes of `dex_files`, the dex files of
+  // the oat file being compiled. Returns null and sets `error_msg` if nothing can be reused.
+  static std::unique_ptr<IncrementalCompilation> Create(
+      const std::string& oat_filename,
+      const std::vector<const DexFile*>& dex_files,
+      const CompilerDriver& driver,
+      const SafeMap<std::string, std::string>& key_value_store,
+      uint32_t image_file_location_oat_checksum,
+      std::string* error_msg);
+
+  ~IncrementalCompilation();
+
+  // Returns the compiled method loaded from the previous oat file, or null if the method must
+  // be compiled. Thread safe.
+  CompiledMethod* LoadCompiledMethod(CompilerDriver* driver,
+                                     const DexFile& dex_file,
+                                     uint16_t class_def_idx,
+                                     uint32_t method_idx);
+
+  size_t GetNumberOfClasses() const {
+    return num_classes_;
+  }
+
+  size_t GetNumberOfReusableClasses() const {
+    return num_reusable_classes_;
+  }
+
+  size_t GetNumberOfReusedMethods() const {
+    return num_reused_methods_.LoadRelaxed();
+  }
+
+  // Collect the descriptors of the classes a class depends on: its superclass, its interfaces,
+  // the signatures of its methods that have code, the classes whose types, fields or methods
+  // this code references together with the types of these fields and methods, and the types of
+  // the exceptions it catches. Descriptors of primitive types may be included.
+  static void CollectReferencedClasses(const DexFile& dex_file,
+                                       uint16_t class_def_idx,
+                                       std::vector<std::string>* descriptors);
+
+ private:
+  struct DexFileData {
+    const OatDexFile* oat_dex_file;
+    uint32_t oat_dex_file_index;
+    std::unique_ptr<const DexFile> old_dex_file;
+    std::vector<bool> reusable_classes;
+  };
+
+  IncrementalCompilation(std::unique_ptr<OatFile> oat_file, const uint8_t* patch_table);
+
+  bool CheckOatHeader(const CompilerDriver& driver,
+                      const SafeMap<std::string, std::string>& key_value_store,
+                      uint32_t image_file_location_oat_checksum,
+                      std::string* error_msg) const;
+  void FindReusableClasses(const std::vector<const DexFile*>& dex_files);
+
+  static bool IdsEqual(const DexFile& old_dex_file, const DexFile& new_dex_file);
+  static bool ClassDefsEqual(const DexFile& old_dex_file,
+                             const DexFile& new_dex_file,
+                             uint16_t class_def_idx);
+  static bool CodeItemsEqual(const DexFile::CodeItem* old_code_item,
+                             const DexFile::CodeItem* new_code_item);
+
+  const std::unique_ptr<OatFile> oat_file_;
+  const linker::LinkerPatchTable patch_table_;
+
+  // The dex files of the previous oat file mapped to the dex files being compiled, or null if a
+  // dex file is not compiled again or cannot be reused.
+  std::vector<const DexFile*> patch_target_dex_files_;
+  SafeMap<const DexFile*, DexFileData> dex_file_data_;
+
+  size_t num_classes_;
+  size_t num_reusable_classes_;
+  Atomic<size_t> num_reused_methods_;
+
+  DISALLOW_COPY_AND_ASSIGN(IncrementalCompilation);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_DRIVER_INCREMENTAL_COMPILATION_H_
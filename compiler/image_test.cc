@@ -20,6 +20,7 @@
 #include <string>
 #include <vector>
 
+#include "base/time_utils.h"
 #include "base/unix_file/fd_file.h"
 #include "class_linker-inl.h"
 #include "common_compiler_test.h"
@@ -344,6 +345,47 @@ void ImageTest::TestWriteRead(ImageHeader::StorageMode storage_mode) {
     const auto& bitmap_section = image_header.GetImageSection(ImageHeader::kSectionImageBitmap);
     ASSERT_GE(bitmap_section.Offset(), sizeof(image_header));
     ASSERT_NE(0U, bitmap_section.Size());
+    if (storage_mode == ImageHeader::kStorageModeUncompressed) {
+      ASSERT_EQ(0U, image_header.GetBlocksCount());
+    } else {
+      // Compressed images are split into independently decompressed blocks.
+      const size_t image_data_size = image_header.GetImageSize() - sizeof(ImageHeader);
+      ASSERT_EQ(RoundUp(image_data_size, ImageHeader::kBlockSize) / ImageHeader::kBlockSize,
+                image_header.GetBlocksCount());
+      ASSERT_EQ(sizeof(ImageHeader) + image_header.GetDataSize(),
+                image_header.GetBlocksOffset() +
+                    image_header.GetBlocksCount() * sizeof(ImageHeader::Block));
+
+      // Decompress the blocks on this thread only and on the heap thread pool, which the boot
+      // image never uses since it is loaded before the main thread is attached.
+      ASSERT_GE(image_header.GetBlocksCount(), 2U);
+      ASSERT_TRUE(Runtime::Current()->GetHeap()->GetThreadPool() != nullptr);
+      std::vector<uint8_t> file_data(file->GetLength());
+      ASSERT_TRUE(file->PreadFully(file_data.data(), file_data.size(), 0));
+      std::vector<uint8_t> serial_image(image_header.GetImageSize());
+      std::vector<uint8_t> parallel_image(image_header.GetImageSize());
+      std::string error_msg;
+      uint64_t start_time = NanoTime();
+      ASSERT_TRUE(gc::space::ImageSpace::DecompressImage(image_header,
+                                                         serial_image.data(),
+                                                         file_data.data(),
+                                                         file_data.size(),
+                                                         /* max_threads */ 1U,
+                                                         &error_msg)) << error_msg;
+      const uint64_t serial_time = NanoTime() - start_time;
+      start_time = NanoTime();
+      ASSERT_TRUE(gc::space::ImageSpace::DecompressImage(image_header,
+                                                         parallel_image.data(),
+                                                         file_data.data(),
+                                                         file_data.size(),
+                                                         /* max_threads */ 4U,
+                                                         &error_msg)) << error_msg;
+      const uint64_t parallel_time = NanoTime() - start_time;
+      LOG(INFO) << "Decompressing " << image_header.GetBlocksCount() << " " << storage_mode
+                << " image blocks took " << PrettyDuration(serial_time) << " on one thread and "
+                << PrettyDuration(parallel_time) << " on four threads";
+      ASSERT_TRUE(serial_image == parallel_image);
+    }
 
     gc::Heap* heap = Runtime::Current()->GetHeap();
     ASSERT_TRUE(heap->HaveContinuousSpaces());
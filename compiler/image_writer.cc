@@ -225,19 +225,40 @@ bool ImageWriter::Write(int image_fd,
     char* image_data = reinterpret_cast<char*>(image_info.image_->Begin()) + sizeof(ImageHeader);
     size_t data_size;
     const char* image_data_to_write;
+    std::vector<ImageHeader::Block> blocks;
     const uint64_t compress_start_time = NanoTime();
 
     CHECK_EQ(image_header->storage_mode_, image_storage_mode_);
     switch (image_storage_mode_) {
       case ImageHeader::kStorageModeLZ4HC:  // Fall-through.
       case ImageHeader::kStorageModeLZ4: {
-        const size_t compressed_max_size = LZ4_compressBound(image_data_size);
+        // Compress the image data in independently decodable blocks so that the runtime can
+        // decompress them in parallel. The block table is stored right after the block data.
+        const size_t num_blocks = RoundUp(image_data_size, ImageHeader::kBlockSize) /
+            ImageHeader::kBlockSize;
+        const size_t compressed_max_size =
+            num_blocks * LZ4_compressBound(ImageHeader::kBlockSize) +
+            num_blocks * sizeof(ImageHeader::Block);
         compressed_data.reset(new char[compressed_max_size]);
-        data_size = LZ4_compress(
-            reinterpret_cast<char*>(image_info.image_->Begin()) + sizeof(ImageHeader),
-            &compressed_data[0],
-            image_data_size);
-
+        data_size = 0u;
+        for (size_t offset = 0; offset < image_data_size; offset += ImageHeader::kBlockSize) {
+          const size_t block_size = std::min(ImageHeader::kBlockSize, image_data_size - offset);
+          const size_t block_data_size = LZ4_compress(image_data + offset,
+                                                      &compressed_data[data_size],
+                                                      block_size);
+          CHECK_NE(block_data_size, 0u);
+          blocks.emplace_back(ImageHeader::kStorageModeLZ4,
+                              /*data_offset*/ sizeof(ImageHeader) + data_size,
+                              block_data_size,
+                              /*image_offset*/ sizeof(ImageHeader) + offset,
+                              block_size);
+          data_size += block_data_size;
+        }
+        CHECK_EQ(blocks.size(), num_blocks);
+        image_header->blocks_offset_ = sizeof(ImageHeader) + data_size;
+        image_header->blocks_count_ = blocks.size();
+        memcpy(&compressed_data[data_size], blocks.data(), blocks.size() * sizeof(blocks[0]));
+        data_size += blocks.size() * sizeof(blocks[0]);
         break;
       }
       /*
@@ -267,16 +288,19 @@ bool ImageWriter::Write(int image_fd,
     if (compressed_data != nullptr) {
       image_data_to_write = &compressed_data[0];
       VLOG(compiler) << "Compressed from " << image_data_size << " to " << data_size << " in "
+                     << blocks.size() << " blocks in "
                      << PrettyDuration(NanoTime() - compress_start_time);
       if (kIsDebugBuild) {
-        std::unique_ptr<uint8_t[]> temp(new uint8_t[image_data_size]);
-        const size_t decompressed_size = LZ4_decompress_safe(
-            reinterpret_cast<char*>(&compressed_data[0]),
-            reinterpret_cast<char*>(&temp[0]),
-            data_size,
-            image_data_size);
-        CHECK_EQ(decompressed_size, image_data_size);
-        CHECK_EQ(memcmp(image_data, &temp[0], image_data_size), 0) << image_storage_mode_;
+        std::unique_ptr<uint8_t[]> temp(new uint8_t[image_header->GetImageSize()]);
+        // Block offsets include the header, rebase the compressed data accordingly.
+        const uint8_t* const file_data =
+            reinterpret_cast<const uint8_t*>(&compressed_data[0]) - sizeof(ImageHeader);
+        for (const ImageHeader::Block& block : blocks) {
+          std::string error_msg;
+          CHECK(block.Decompress(temp.get(), file_data, &error_msg)) << error_msg;
+        }
+        CHECK_EQ(memcmp(image_data, &temp[sizeof(ImageHeader)], image_data_size), 0)
+            << image_storage_mode_;
       }
     }
 
@@ -868,9 +892,9 @@ void ImageWriter::PruneNonImageClasses() {
     if (!compile_app_image_) {
       DCHECK(IsBootClassLoaderClass(klass));
     }
-    bool result = class_linker->RemoveClass(name, klass->GetClassLoader());
-    DCHECK(result);
   }
+  size_t num_removed = class_linker->RemoveClasses(visitor.classes_to_prune_);
+  DCHECK_EQ(num_removed, visitor.classes_to_prune_.size());
 
   // Clear references to removed classes from the DexCaches.
   ArtMethod* resolution_method = runtime->GetResolutionMethod();
@@ -913,7 +937,10 @@ void ImageWriter::PruneNonImageClasses() {
     for (size_t i = 0; i < dex_cache->NumResolvedFields(); i++) {
       ArtField* field = mirror::DexCache::GetElementPtrSize(resolved_fields, i, target_ptr_size_);
       if (field != nullptr && !KeepClass(field->GetDeclaringClass())) {
-        dex_cache->SetResolvedField(i, nullptr, target_ptr_size_);
+        mirror::DexCache::SetElementPtrSize<ArtField*>(resolved_fields,
+                                                       i,
+                                                       nullptr,
+                                                       target_ptr_size_);
       }
     }
     // Clean the dex field. It might have been populated during the initialization phase, but
@@ -1713,15 +1740,11 @@ void ImageWriter::CopyAndFixupImTable(ImTable* orig, ImTable* copy) {
 }
 
 void ImageWriter::CopyAndFixupImtConflictTable(ImtConflictTable* orig, ImtConflictTable* copy) {
-  const size_t count = orig->NumEntries(target_ptr_size_);
-  for (size_t i = 0; i < count; ++i) {
-    ArtMethod* interface_method = orig->GetInterfaceMethod(i, target_ptr_size_);
-    ArtMethod* implementation_method = orig->GetImplementationMethod(i, target_ptr_size_);
-    copy->SetInterfaceMethod(i, target_ptr_size_, NativeLocationInImage(interface_method));
-    copy->SetImplementationMethod(i,
-                                  target_ptr_size_,
-                                  NativeLocationInImage(implementation_method));
-  }
+  copy->CopyFrom(orig,
+                 [this](ArtMethod* method) SHARED_REQUIRES(Locks::mutator_lock_) {
+                   return NativeLocationInImage(method);
+                 },
+                 target_ptr_size_);
 }
 
 void ImageWriter::CopyAndFixupNativeData(size_t oat_index) {
@@ -2157,6 +2180,12 @@ void ImageWriter::FixupDexCache(mirror::DexCache* orig_dex_cache,
       ArtField* copy = NativeLocationInImage(orig);
       mirror::DexCache::SetElementPtrSize(copy_fields, i, copy, target_ptr_size_);
     }
+    if (orig_dex_cache->HasHashedFields()) {
+      // The tags are plain indexes and need no fixup.
+      memcpy(mirror::DexCache::GetFieldTags(copy_fields, target_ptr_size_),
+             mirror::DexCache::GetFieldTags(orig_fields, target_ptr_size_),
+             orig_dex_cache->NumResolvedFields() * sizeof(uint32_t));
+    }
   }
 
   // Remove the DexFile pointers. They will be fixed up when the runtime loads the oat file. Leaving
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker/code_layout.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace art {
+namespace linker {
+
+struct CodeLayout::Chain {
+  std::vector<size_t> methods;
+  uint64_t weight;
+  size_t min_index;
+};
+
+size_t CodeLayout::AddMethod(uint32_t code_size, bool hot) {
+  methods_.push_back(Method { code_size, hot });
+  if (hot) {
+    ++num_hot_methods_;
+  }
+  return methods_.size() - 1u;
+}
+
+void CodeLayout::AddCall(size_t caller, size_t callee) {
+  DCHECK_LT(caller, methods_.size());
+  DCHECK_LT(callee, methods_.size());
+  // Only the calls between hot methods influence the layout.
+  if (caller != callee && methods_[caller].hot && methods_[callee].hot) {
+    auto key = std::make_pair(std::min(caller, callee), std::max(caller, callee));
+    auto it = edges_.find(key);
+    if (it != edges_.end()) {
+      ++it->second;
+    } else {
+      edges_.Put(key, 1u);
+    }
+  }
+}
+
+uint32_t CodeLayout::GetDistance(const std::vector<size_t>& first,
+                                 const std::vector<size_t>& second,
+                                 size_t lhs,
+                                 size_t rhs) const {
+  uint32_t offset = 0u;
+  uint32_t lhs_start = 0u;
+  uint32_t rhs_start = 0u;
+  auto visit = [&](size_t method) {
+    if (method == lhs) {
+      lhs_start = offset;
+    } else if (method == rhs) {
+      rhs_start = offset;
+    }
+    offset += methods_[method].code_size;
+  };
+  std::for_each(first.begin(), first.end(), visit);
+  std::for_each(second.begin(), second.end(), visit);
+  return (lhs_start < rhs_start)
+      ? rhs_start - (lhs_start + methods_[lhs].code_size)
+      : lhs_start - (rhs_start + methods_[rhs].code_size);
+}
+
+std::vector<size_t> CodeLayout::GetOrder() const {
+  static constexpr size_t kNoChain = static_cast<size_t>(-1);
+
+  // Start with a chain for each hot method.
+  std::vector<Chain> chains;
+  chains.reserve(num_hot_methods_);
+  std::vector<size_t> chain_index(methods_.size(), kNoChain);
+  for (size_t i = 0; i != methods_.size(); ++i) {
+    if (methods_[i].hot) {
+      chain_index[i] = chains.size();
+      chains.push_back(Chain { std::vector<size_t>(1u, i), 0u, i });
+    }
+  }
+
+  // Merge the chains along the heaviest edges first. The edges are sorted by the method
+  // indexes for equal weights, so that the layout is deterministic.
+  std::vector<std::pair<std::pair<size_t, size_t>, uint32_t>> edges(edges_.begin(), edges_.end());
+  std::stable_sort(edges.begin(),
+                   edges.end(),
+                   [](const std::pair<std::pair<size_t, size_t>, uint32_t>& lhs,
+                      const std::pair<std::pair<size_t, size_t>, uint32_t>& rhs) {
+                     return lhs.second > rhs.second;
+                   });
+  for (const auto& edge : edges) {
+    const size_t lhs = edge.first.first;
+    const size_t rhs = edge.first.second;
+    Chain* lhs_chain = &chains[chain_index[lhs]];
+    Chain* rhs_chain = &chains[chain_index[rhs]];
+    if (lhs_chain == rhs_chain) {
+      lhs_chain->weight += edge.second;
+      continue;
+    }
+    // Pick the orientation of the two chains that puts the caller and callee closest.
+    // Reversing the concatenation does not change the distance, so four candidates suffice.
+    const std::vector<size_t> lhs_reversed(lhs_chain->methods.rbegin(), lhs_chain->methods.rend());
+    const std::vector<size_t> rhs_reversed(rhs_chain->methods.rbegin(), rhs_chain->methods.rend());
+    const std::vector<size_t>* candidates[][2] = {
+        { &lhs_chain->methods, &rhs_chain->methods },
+        { &lhs_chain->methods, &rhs_reversed },
+        { &lhs_reversed, &rhs_chain->methods },
+        { &lhs_reversed, &rhs_reversed },
+    };
+    size_t best = 0u;
+    uint32_t best_distance = GetDistance(*candidates[0][0], *candidates[0][1], lhs, rhs);
+    for (size_t i = 1u; i != arraysize(candidates); ++i) {
+      uint32_t distance = GetDistance(*candidates[i][0], *candidates[i][1], lhs, rhs);
+      if (distance < best_distance) {
+        best = i;
+        best_distance = distance;
+      }
+    }
+    std::vector<size_t> merged;
+    merged.reserve(lhs_chain->methods.size() + rhs_chain->methods.size());
+    merged.insert(merged.end(), candidates[best][0]->begin(), candidates[best][0]->end());
+    merged.insert(merged.end(), candidates[best][1]->begin(), candidates[best][1]->end());
+    for (size_t method : rhs_chain->methods) {
+      chain_index[method] = chain_index[lhs];
+    }
+    lhs_chain->methods.swap(merged);
+    lhs_chain->weight += rhs_chain->weight + edge.second;
+    lhs_chain->min_index = std::min(lhs_chain->min_index, rhs_chain->min_index);
+    rhs_chain->methods.clear();
+  }
+
+  // Lay out the heaviest chains first, then the cold methods in their original order.
+  std::vector<const Chain*> ordered_chains;
+  for (const Chain& chain : chains) {
+    if (!chain.methods.empty()) {
+      ordered_chains.push_back(&chain);
+    }
+  }
+  std::sort(ordered_chains.begin(),
+            ordered_chains.end(),
+            [](const Chain* lhs, const Chain* rhs) {
+              return (lhs->weight != rhs->weight)
+                  ? lhs->weight > rhs->weight
+                  : lhs->min_index < rhs->min_index;
+            });
+  std::vector<size_t> order;
+  order.reserve(methods_.size());
+  for (const Chain* chain : ordered_chains) {
+    order.insert(order.end(), chain->methods.begin(), chain->methods.end());
+  }
+  for (size_t i = 0; i != methods_.size(); ++i) {
+    if (!methods_[i].hot) {
+      order.push_back(i);
+    }
+  }
+  DCHECK_EQ(order.size(), methods_.size());
+  return order;
+}
+
+}  // namespace linker
+}  // namespace art
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_LINKER_CODE_LAYOUT_H_
+#define ART_COMPILER_LINKER_CODE_LAYOUT_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/macros.h"
+#include "safe_map.h"
+
+namespace art {
+namespace linker {
+
+// CodeLayout orders the compiled methods of an oat file so that the hot methods share as few
+// pages and cache lines as possible. Hot methods that call each other are clustered with the
+// greedy chain merging of Pettis and Hansen: starting from one chain per method, the chains
+// of the two ends of the heaviest remaining call edge are concatenated, in the orientation
+// that puts the caller and callee closest to each other.
+//
+// Methods are identified by the order in which they were added, which should be the default
+// (class definition) order of the code.
+class CodeLayout {
+ public:
+  CodeLayout() {}
+
+  // Add a method with the given code size. Returns the index of the method.
+  size_t AddMethod(uint32_t code_size, bool hot);
+
+  // Record a call from `caller` to `callee`. Each recorded call increases the weight of the
+  // edge between the two methods.
+  void AddCall(size_t caller, size_t callee);
+
+  size_t GetNumberOfHotMethods() const {
+    return num_hot_methods_;
+  }
+
+  // Returns the method indexes in layout order: the chains of hot methods, heaviest first,
+  // followed by the other methods in the order they were added.
+  std::vector<size_t> GetOrder() const;
+
+ private:
+  struct Method {
+    uint32_t code_size;
+    bool hot;
+  };
+
+  struct Chain;
+
+  // Returns the number of code bytes between the two methods of the concatenation
+  // `first` + `second`.
+  uint32_t GetDistance(const std::vector<size_t>& first,
+                       const std::vector<size_t>& second,
+                       size_t lhs,
+                       size_t rhs) const;
+
+  std::vector<Method> methods_;
+  size_t num_hot_methods_ = 0u;
+  // Call edges between hot methods, by (lower index, higher index).
+  SafeMap<std::pair<size_t, size_t>, uint32_t> edges_;
+
+  DISALLOW_COPY_AND_ASSIGN(CodeLayout);
+};
+
+}  // namespace linker
+}  // namespace art
+
+#endif  // ART_COMPILER_LINKER_CODE_LAYOUT_H_
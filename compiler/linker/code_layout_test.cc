@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker/code_layout.h"
+
+#include "gtest/gtest.h"
+
+namespace art {
+namespace linker {
+
+TEST(CodeLayoutTest, NoHotMethods) {
+  CodeLayout layout;
+  for (size_t i = 0; i != 4u; ++i) {
+    EXPECT_EQ(i, layout.AddMethod(16u, /* hot */ false));
+  }
+  layout.AddCall(0u, 3u);
+  EXPECT_EQ(0u, layout.GetNumberOfHotMethods());
+  EXPECT_EQ(std::vector<size_t>({ 0u, 1u, 2u, 3u }), layout.GetOrder());
+}
+
+TEST(CodeLayoutTest, HotMethodsFirst) {
+  CodeLayout layout;
+  for (size_t i = 0; i != 6u; ++i) {
+    layout.AddMethod(16u, /* hot */ (i % 2u) == 1u);
+  }
+  EXPECT_EQ(3u, layout.GetNumberOfHotMethods());
+  // Without calls, the hot methods keep their relative order.
+  EXPECT_EQ(std::vector<size_t>({ 1u, 3u, 5u, 0u, 2u, 4u }), layout.GetOrder());
+}
+
+TEST(CodeLayoutTest, ClusterCallers) {
+  CodeLayout layout;
+  for (size_t i = 0; i != 6u; ++i) {
+    layout.AddMethod(16u, /* hot */ (i % 2u) == 1u);
+  }
+  // 1 -> 5 is the heaviest edge and merges first. The chain with 3 is then attached next to 5.
+  layout.AddCall(1u, 5u);
+  layout.AddCall(1u, 5u);
+  layout.AddCall(5u, 1u);
+  layout.AddCall(5u, 3u);
+  // Calls involving cold methods and recursive calls are ignored.
+  layout.AddCall(0u, 1u);
+  layout.AddCall(3u, 3u);
+  EXPECT_EQ(std::vector<size_t>({ 3u, 5u, 1u, 0u, 2u, 4u }), layout.GetOrder());
+}
+
+TEST(CodeLayoutTest, HeaviestChainFirst) {
+  CodeLayout layout;
+  for (size_t i = 0; i != 4u; ++i) {
+    layout.AddMethod(16u, /* hot */ true);
+  }
+  layout.AddCall(0u, 1u);
+  layout.AddCall(2u, 3u);
+  layout.AddCall(3u, 2u);
+  EXPECT_EQ(std::vector<size_t>({ 2u, 3u, 0u, 1u }), layout.GetOrder());
+}
+
+TEST(CodeLayoutTest, ShortestDistance) {
+  CodeLayout layout;
+  layout.AddMethod(16u, /* hot */ true);
+  layout.AddMethod(1024u, /* hot */ true);
+  layout.AddMethod(16u, /* hot */ true);
+  layout.AddMethod(16u, /* hot */ true);
+  // Chain [0, 1] first, then 3 is placed next to 0 rather than after the large method 1,
+  // which reverses the chain.
+  layout.AddCall(0u, 1u);
+  layout.AddCall(0u, 1u);
+  layout.AddCall(0u, 3u);
+  EXPECT_EQ(std::vector<size_t>({ 1u, 0u, 3u, 2u }), layout.GetOrder());
+}
+
+}  // namespace linker
+}  // namespace art
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker/linker_patch_table.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/casts.h"
+#include "base/logging.h"
+#include "compiled_method.h"
+#include "leb128.h"
+#include "safe_map.h"
+
+namespace art {
+namespace linker {
+
+static void AppendUint32(std::vector<uint8_t>* data, uint32_t value) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+  data->insert(data->end(), bytes, bytes + sizeof(value));
+}
+
+static void StoreUint32(std::vector<uint8_t>* data, size_t offset, uint32_t value) {
+  DCHECK_LE(offset + sizeof(value), data->size());
+  memcpy(data->data() + offset, &value, sizeof(value));
+}
+
+static uint32_t LoadUint32(const uint8_t* data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static bool FindDexFileIndex(const std::vector<const DexFile*>& dex_files,
+                             const DexFile* dex_file,
+                             uint32_t* index) {
+  auto it = std::find(dex_files.begin(), dex_files.end(), dex_file);
+  if (it == dex_files.end()) {
+    return false;
+  }
+  *index = static_cast<uint32_t>(std::distance(dex_files.begin(), it));
+  return true;
+}
+
+bool LinkerPatchTable::EncodePatches(const std::vector<const DexFile*>& dex_files,
+                                     const CompiledMethod* compiled_method,
+                                     std::vector<uint8_t>* data) {
+  ArrayRef<const uint8_t> code = compiled_method->GetQuickCode();
+  ArrayRef<const LinkerPatch> patches = compiled_method->GetPatches();
+  EncodeUnsignedLeb128(data, dchecked_integral_cast<uint32_t>(patches.size()));
+  for (const LinkerPatch& patch : patches) {
+    uint32_t literal_offset = dchecked_integral_cast<uint32_t>(patch.LiteralOffset());
+    DCHECK_LE(literal_offset + kPatchSiteSize, code.size());
+    data->push_back(static_cast<uint8_t>(patch.GetType()));
+    EncodeUnsignedLeb128(data, literal_offset);
+    data->insert(data->end(),
+                 code.begin() + literal_offset,
+                 code.begin() + literal_offset + kPatchSiteSize);
+    uint32_t dex_file_index = 0u;
+    switch (patch.GetType()) {
+      case LinkerPatch::Type::kRecordPosition:
+        break;
+      case LinkerPatch::Type::kMethod:
+      case LinkerPatch::Type::kCall:
+      case LinkerPatch::Type::kCallRelative:
+        if (!FindDexFileIndex(dex_files, patch.TargetMethod().dex_file, &dex_file_index)) {
+          return false;
+        }
+        EncodeUnsignedLeb128(data, dex_file_index);
+        EncodeUnsignedLeb128(data, patch.TargetMethod().dex_method_index);
+        break;
+      case LinkerPatch::Type::kType:
+        if (!FindDexFileIndex(dex_files, patch.TargetTypeDexFile(), &dex_file_index)) {
+          return false;
+        }
+        EncodeUnsignedLeb128(data, dex_file_index);
+        EncodeUnsignedLeb128(data, patch.TargetTypeIndex());
+        break;
+      case LinkerPatch::Type::kString:
+      case LinkerPatch::Type::kStringRelative:
+        if (!FindDexFileIndex(dex_files, patch.TargetStringDexFile(), &dex_file_index)) {
+          return false;
+        }
+        EncodeUnsignedLeb128(data, dex_file_index);
+        EncodeUnsignedLeb128(data, patch.TargetStringIndex());
+        if (patch.GetType() == LinkerPatch::Type::kStringRelative) {
+          EncodeUnsignedLeb128(data, patch.PcInsnOffset());
+        }
+        break;
+      case LinkerPatch::Type::kDexCacheArray:
+        if (!FindDexFileIndex(dex_files, patch.TargetDexCacheDexFile(), &dex_file_index)) {
+          return false;
+        }
+        EncodeUnsignedLeb128(data, dex_file_index);
+        EncodeUnsignedLeb128(data,
+                             dchecked_integral_cast<uint32_t>(patch.TargetDexCacheElementOffset()));
+        EncodeUnsignedLeb128(data, patch.PcInsnOffset());
+        break;
+    }
+  }
+  return true;
+}
+
+void LinkerPatchTable::Encode(const std::vector<const DexFile*>& dex_files,
+                              const std::vector<MethodEntry>& methods,
+                              std::vector<uint8_t>* data) {
+  DCHECK(data->empty());
+  DCHECK(std::is_sorted(methods.begin(),
+                        methods.end(),
+                        [](const MethodEntry& lhs, const MethodEntry& rhs) {
+                          return (lhs.dex_file_index != rhs.dex_file_index)
+                              ? lhs.dex_file_index < rhs.dex_file_index
+                              : lhs.method_idx < rhs.method_idx;
+                        }));
+  size_t num_entries = 0u;
+  for (const MethodEntry& method : methods) {
+    if (!method.compiled_method->GetPatches().empty()) {
+      ++num_entries;
+    }
+  }
+  data->resize(kHeaderSize + num_entries * sizeof(Entry));
+  StoreUint32(data, sizeof(uint32_t), dchecked_integral_cast<uint32_t>(num_entries));
+
+  // Methods with deduplicated code share the patch data.
+  SafeMap<const CompiledMethod*, uint32_t> data_offsets;
+  size_t entry_offset = kHeaderSize;
+  for (const MethodEntry& method : methods) {
+    if (method.compiled_method->GetPatches().empty()) {
+      continue;
+    }
+    auto it = data_offsets.find(method.compiled_method);
+    uint32_t data_offset;
+    if (it != data_offsets.end()) {
+      data_offset = it->second;
+    } else {
+      data_offset = dchecked_integral_cast<uint32_t>(data->size());
+      if (!EncodePatches(dex_files, method.compiled_method, data)) {
+        data->resize(data_offset);
+        data_offset = kNotRelinkable;
+      }
+      data_offsets.Put(method.compiled_method, data_offset);
+    }
+    StoreUint32(data, entry_offset + offsetof(Entry, dex_file_index), method.dex_file_index);
+    StoreUint32(data, entry_offset + offsetof(Entry, method_idx), method.method_idx);
+    StoreUint32(data, entry_offset + offsetof(Entry, data_offset), data_offset);
+    entry_offset += sizeof(Entry);
+  }
+  DCHECK_EQ(entry_offset, kHeaderSize + num_entries * sizeof(Entry));
+  StoreUint32(data, 0u, dchecked_integral_cast<uint32_t>(data->size()));
+}
+
+size_t LinkerPatchTable::GetSize(const uint8_t* data, size_t available_size) {
+  if (available_size < kHeaderSize) {
+    return 0u;
+  }
+  size_t size = LoadUint32(data);
+  size_t num_entries = LoadUint32(data + sizeof(uint32_t));
+  if (size > available_size || (size - kHeaderSize) / sizeof(Entry) < num_entries) {
+    return 0u;
+  }
+  return size;
+}
+
+bool LinkerPatchTable::Decode(uint32_t dex_file_index,
+                              uint32_t method_idx,
+                              const std::vector<const DexFile*>& dex_files,
+                              std::vector<LinkerPatch>* patches,
+                              std::vector<uint8_t>* original_code) const {
+  patches->clear();
+  original_code->clear();
+  size_t num_entries = LoadUint32(data_ + sizeof(uint32_t));
+  const uint8_t* entries = data_ + kHeaderSize;
+  // Binary search for the entry of the method.
+  size_t lo = 0u;
+  size_t hi = num_entries;
+  while (lo != hi) {
+    size_t mid = lo + (hi - lo) / 2u;
+    const uint8_t* entry = entries + mid * sizeof(Entry);
+    uint32_t entry_dex_file_index = LoadUint32(entry + offsetof(Entry, dex_file_index));
+    uint32_t entry_method_idx = LoadUint32(entry + offsetof(Entry, method_idx));
+    if (entry_dex_file_index < dex_file_index ||
+        (entry_dex_file_index == dex_file_index && entry_method_idx < method_idx)) {
+      lo = mid + 1u;
+    } else {
+      hi = mid;
+    }
+  }
+  const uint8_t* entry = entries + lo * sizeof(Entry);
+  if (lo == num_entries ||
+      LoadUint32(entry + offsetof(Entry, dex_file_index)) != dex_file_index ||
+      LoadUint32(entry + offsetof(Entry, method_idx)) != method_idx) {
+    return true;  // No patches.
+  }
+  uint32_t data_offset = LoadUint32(entry + offsetof(Entry, data_offset));
+  if (data_offset == kNotRelinkable) {
+    return false;
+  }
+
+  const uint8_t* ptr = data_ + data_offset;
+  size_t num_patches = DecodeUnsignedLeb128(&ptr);
+  patches->reserve(num_patches);
+  original_code->reserve(num_patches * kPatchSiteSize);
+  auto decode_target_dex_file = [&ptr, &dex_files]() -> const DexFile* {
+    uint32_t index = DecodeUnsignedLeb128(&ptr);
+    return (index < dex_files.size()) ? dex_files[index] : nullptr;
+  };
+  for (size_t i = 0; i != num_patches; ++i) {
+    LinkerPatch::Type type = static_cast<LinkerPatch::Type>(*ptr++);
+    uint32_t literal_offset = DecodeUnsignedLeb128(&ptr);
+    original_code->insert(original_code->end(), ptr, ptr + kPatchSiteSize);
+    ptr += kPatchSiteSize;
+    if (type == LinkerPatch::Type::kRecordPosition) {
+      patches->push_back(LinkerPatch::RecordPosition(literal_offset));
+      continue;
+    }
+    const DexFile* target_dex_file = decode_target_dex_file();
+    uint32_t target_index = DecodeUnsignedLeb128(&ptr);
+    if (target_dex_file == nullptr) {
+      return false;
+    }
+    switch (type) {
+      case LinkerPatch::Type::kMethod:
+        patches->push_back(LinkerPatch::MethodPatch(literal_offset, target_dex_file, target_index));
+        break;
+      case LinkerPatch::Type::kCall:
+        patches->push_back(LinkerPatch::CodePatch(literal_offset, target_dex_file, target_index));
+        break;
+      case LinkerPatch::Type::kCallRelative:
+        patches->push_back(
+            LinkerPatch::RelativeCodePatch(literal_offset, target_dex_file, target_index));
+        break;
+      case LinkerPatch::Type::kType:
+        patches->push_back(LinkerPatch::TypePatch(literal_offset, target_dex_file, target_index));
+        break;
+      case LinkerPatch::Type::kString:
+        patches->push_back(LinkerPatch::StringPatch(literal_offset, target_dex_file, target_index));
+        break;
+      case LinkerPatch::Type::kStringRelative: {
+        uint32_t pc_insn_offset = DecodeUnsignedLeb128(&ptr);
+        patches->push_back(LinkerPatch::RelativeStringPatch(
+            literal_offset, target_dex_file, pc_insn_offset, target_index));
+        break;
+      }
+      case LinkerPatch::Type::kDexCacheArray: {
+        uint32_t pc_insn_offset = DecodeUnsignedLeb128(&ptr);
+        patches->push_back(LinkerPatch::DexCacheArrayPatch(
+            literal_offset, target_dex_file, pc_insn_offset, target_index));
+        break;
+      }
+      default:
+        LOG(WARNING) << "Unexpected linker patch type " << static_cast<uint32_t>(type);
+        return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace linker
+}  // namespace art
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_LINKER_LINKER_PATCH_TABLE_H_
+#define ART_COMPILER_LINKER_LINKER_PATCH_TABLE_H_
+
+#include <vector>
+
+#include "base/macros.h"
+
+namespace art {
+
+class CompiledMethod;
+class DexFile;
+class LinkerPatch;
+
+namespace linker {
+
+// LinkerPatchTable records the linker patches of the compiled methods of an oat file, together
+// with the code at each patch site before it was patched, so that the code can be taken out of
+// the oat file and linked again into another one. dex2oat writes the table with
+// --record-linker-patches and uses it to reuse the code of unchanged classes.
+//
+// Layout:
+//   uint32_t size             Size of the table in bytes, including this header.
+//   uint32_t number_of_entries
+//   Entry entries[]           Sorted by dex file index and method index.
+//   patch data                For each entry at its data offset, the ULEB128 number of patches
+//                             followed by the patches. A patch is the type byte, the ULEB128
+//                             literal offset, the original 4 bytes at the literal offset and
+//                             the ULEB128 encoded target, if any.
+//
+// Dex files are identified by their index in the oat file. Methods without patches have no
+// entry. Methods whose patches refer to dex files outside of the oat file cannot be linked
+// again; their entries have the data offset kNotRelinkable.
+class LinkerPatchTable {
+ public:
+  struct MethodEntry {
+    uint32_t dex_file_index;
+    uint32_t method_idx;
+    const CompiledMethod* compiled_method;
+  };
+
+  // All the patched locations in the supported instruction sets are 4 bytes wide.
+  static constexpr size_t kPatchSiteSize = 4u;
+
+  // Encode the patches of `methods`, which must be sorted by dex file index and method index.
+  // The patch targets are looked up in `dex_files`, the dex files of the oat file.
+  static void Encode(const std::vector<const DexFile*>& dex_files,
+                     const std::vector<MethodEntry>& methods,
+                     std::vector<uint8_t>* data);
+
+  // Returns the size of the table at `data`, or 0 if it does not fit in `available_size`.
+  static size_t GetSize(const uint8_t* data, size_t available_size);
+
+  explicit LinkerPatchTable(const uint8_t* data) : data_(data) {}
+
+  // Decode the patches of a method. The dex file indexes of the table are mapped to
+  // `dex_files`, where a null entry means that the code referencing that dex file cannot be
+  // reused. Returns false if the code of the method cannot be linked again. Otherwise fills
+  // `patches` and, for each patch, the original code at its literal offset in `original_code`.
+  bool Decode(uint32_t dex_file_index,
+              uint32_t method_idx,
+              const std::vector<const DexFile*>& dex_files,
+              std::vector<LinkerPatch>* patches,
+              std::vector<uint8_t>* original_code) const;
+
+ private:
+  struct Entry {
+    uint32_t dex_file_index;
+    uint32_t method_idx;
+    uint32_t data_offset;
+  };
+
+  static constexpr uint32_t kNotRelinkable = 0xffffffffu;
+  static constexpr size_t kHeaderSize = 2u * sizeof(uint32_t);
+
+  static bool EncodePatches(const std::vector<const DexFile*>& dex_files,
+                            const CompiledMethod* compiled_method,
+                            std::vector<uint8_t>* data);
+
+  const uint8_t* const data_;
+};
+
+}  // namespace linker
+}  // namespace art
+
+#endif  // ART_COMPILER_LINKER_LINKER_PATCH_TABLE_H_
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker/linker_patch_table.h"
+
+#include "compiled_method.h"
+#include "dex/quick/dex_file_to_method_inliner_map.h"
+#include "dex/verification_results.h"
+#include "driver/compiler_driver.h"
+#include "driver/compiler_options.h"
+#include "gtest/gtest.h"
+#include "utils/array_ref.h"
+
+namespace art {
+namespace linker {
+
+class LinkerPatchTableTest : public testing::Test {
+ protected:
+  LinkerPatchTableTest()
+      : compiler_options_(),
+        verification_results_(&compiler_options_),
+        inliner_map_(),
+        driver_(&compiler_options_,
+                &verification_results_,
+                &inliner_map_,
+                Compiler::kQuick,
+                kX86,
+                /* instruction_set_features*/ nullptr,
+                /* boot_image */ false,
+                /* app_image */ false,
+                /* image_classes */ nullptr,
+                /* compiled_classes */ nullptr,
+                /* compiled_methods */ nullptr,
+                /* thread_count */ 1u,
+                /* dump_stats */ false,
+                /* dump_passes */ false,
+                /* timer */ nullptr,
+                /* swap_fd */ -1,
+                /* profile_compilation_info */ nullptr) {
+    // The table only compares the dex file pointers, they are never dereferenced.
+    for (size_t i = 0; i != kNumDexFiles; ++i) {
+      dex_files_.push_back(reinterpret_cast<const DexFile*>(&fake_dex_files_[i]));
+    }
+  }
+
+  const CompiledMethod* AddCompiledMethod(const ArrayRef<const uint8_t>& code,
+                                          const ArrayRef<const LinkerPatch>& patches) {
+    compiled_methods_.emplace_back(new CompiledMethod(
+        &driver_,
+        kX86,
+        code,
+        /* frame_size_in_bytes */ 0u,
+        /* core_spill_mask */ 0u,
+        /* fp_spill_mask */ 0u,
+        /* src_mapping_table */ ArrayRef<const SrcMapElem>(),
+        /* vmap_table */ ArrayRef<const uint8_t>(),
+        /* cfi_info */ ArrayRef<const uint8_t>(),
+        patches));
+    return compiled_methods_.back().get();
+  }
+
+  static constexpr size_t kNumDexFiles = 3u;
+
+  CompilerOptions compiler_options_;
+  VerificationResults verification_results_;
+  DexFileToMethodInlinerMap inliner_map_;
+  CompilerDriver driver_;  // Needed for constructing CompiledMethod.
+  uint64_t fake_dex_files_[kNumDexFiles];
+  std::vector<const DexFile*> dex_files_;
+  std::vector<std::unique_ptr<CompiledMethod>> compiled_methods_;
+};
+
+TEST_F(LinkerPatchTableTest, Empty) {
+  std::vector<uint8_t> data;
+  LinkerPatchTable::Encode(dex_files_, std::vector<LinkerPatchTable::MethodEntry>(), &data);
+  ASSERT_EQ(data.size(), LinkerPatchTable::GetSize(data.data(), data.size()));
+  EXPECT_EQ(0u, LinkerPatchTable::GetSize(data.data(), data.size() - 1u));
+
+  LinkerPatchTable table(data.data());
+  std::vector<LinkerPatch> patches;
+  std::vector<uint8_t> original_code;
+  EXPECT_TRUE(table.Decode(0u, 1u, dex_files_, &patches, &original_code));
+  EXPECT_TRUE(patches.empty());
+  EXPECT_TRUE(original_code.empty());
+}
+
+TEST_F(LinkerPatchTableTest, RoundTrip) {
+  static const uint8_t kCode1[] = {
+      0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee
+  };
+  const LinkerPatch kPatches1[] = {
+      LinkerPatch::RelativeCodePatch(1u, dex_files_[1], 0x1234u),
+      LinkerPatch::TypePatch(5u, dex_files_[0], 7u),
+      LinkerPatch::DexCacheArrayPatch(9u, dex_files_[2], 3u, 0x4000u),
+      LinkerPatch::RecordPosition(11u),
+  };
+  static const uint8_t kCode2[] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5 };
+  const LinkerPatch kPatches2[] = {
+      LinkerPatch::RelativeStringPatch(2u, dex_files_[0], 6u, 0x12345u),
+  };
+  const CompiledMethod* method1 = AddCompiledMethod(ArrayRef<const uint8_t>(kCode1),
+                                                    ArrayRef<const LinkerPatch>(kPatches1));
+  const CompiledMethod* method2 = AddCompiledMethod(ArrayRef<const uint8_t>(kCode2),
+                                                    ArrayRef<const LinkerPatch>(kPatches2));
+  const CompiledMethod* no_patches = AddCompiledMethod(ArrayRef<const uint8_t>(kCode2),
+                                                       ArrayRef<const LinkerPatch>());
+  std::vector<LinkerPatchTable::MethodEntry> methods = {
+      { 0u, 3u, method1 },
+      { 0u, 4u, no_patches },
+      { 1u, 2u, method2 },
+      { 2u, 0u, method1 },  // Deduplicated code.
+  };
+  std::vector<uint8_t> data;
+  LinkerPatchTable::Encode(dex_files_, methods, &data);
+  ASSERT_EQ(data.size(), LinkerPatchTable::GetSize(data.data(), data.size()));
+
+  LinkerPatchTable table(data.data());
+  std::vector<LinkerPatch> patches;
+  std::vector<uint8_t> original_code;
+  for (const LinkerPatchTable::MethodEntry& method : methods) {
+    ASSERT_TRUE(table.Decode(
+        method.dex_file_index, method.method_idx, dex_files_, &patches, &original_code));
+    ArrayRef<const LinkerPatch> expected_patches = method.compiled_method->GetPatches();
+    ASSERT_EQ(expected_patches.size(), patches.size());
+    ASSERT_EQ(expected_patches.size() * LinkerPatchTable::kPatchSiteSize, original_code.size());
+    ArrayRef<const uint8_t> code = method.compiled_method->GetQuickCode();
+    for (size_t i = 0; i != patches.size(); ++i) {
+      EXPECT_TRUE(expected_patches[i] == patches[i]) << i;
+      size_t literal_offset = patches[i].LiteralOffset();
+      EXPECT_EQ(0, memcmp(&code[literal_offset],
+                          &original_code[i * LinkerPatchTable::kPatchSiteSize],
+                          LinkerPatchTable::kPatchSiteSize)) << i;
+    }
+  }
+
+  // A method that is not in the table has no patches.
+  ASSERT_TRUE(table.Decode(1u, 3u, dex_files_, &patches, &original_code));
+  EXPECT_TRUE(patches.empty());
+
+  // The code referencing a dex file that is not available cannot be linked again.
+  std::vector<const DexFile*> partial_dex_files = dex_files_;
+  partial_dex_files[2] = nullptr;
+  EXPECT_FALSE(table.Decode(0u, 3u, partial_dex_files, &patches, &original_code));
+  EXPECT_TRUE(table.Decode(1u, 2u, partial_dex_files, &patches, &original_code));
+}
+
+TEST_F(LinkerPatchTableTest, TargetOutsideOatFile) {
+  static const uint8_t kCode[] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 };
+  uint64_t other_dex_file;
+  const LinkerPatch kPatches[] = {
+      LinkerPatch::CodePatch(0u, reinterpret_cast<const DexFile*>(&other_dex_file), 1u),
+  };
+  const CompiledMethod* method = AddCompiledMethod(ArrayRef<const uint8_t>(kCode),
+                                                   ArrayRef<const LinkerPatch>(kPatches));
+  std::vector<uint8_t> data;
+  LinkerPatchTable::Encode(dex_files_, { { 1u, 5u, method } }, &data);
+  LinkerPatchTable table(data.data());
+  std::vector<LinkerPatch> patches;
+  std::vector<uint8_t> original_code;
+  EXPECT_FALSE(table.Decode(1u, 5u, dex_files_, &patches, &original_code));
+}
+
+}  // namespace linker
+}  // namespace art
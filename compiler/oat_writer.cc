@@ -16,6 +16,7 @@
 
 #include "oat_writer.h"
 
+#include <algorithm>
 #include <unistd.h>
 #include <zlib.h>
 
@@ -30,6 +31,7 @@
 #include "compiled_class.h"
 #include "compiled_method.h"
 #include "debug/method_debug_info.h"
+#include "dex/dex_layout.h"
 #include "dex/verification_results.h"
 #include "dex_file-inl.h"
 #include "driver/compiler_driver.h"
@@ -37,7 +39,12 @@
 #include "gc/space/image_space.h"
 #include "gc/space/space.h"
 #include "handle_scope-inl.h"
+#include "id_lookup_table.h"
 #include "image_writer.h"
+#include "intern_table.h"
+#include "jit/offline_profiling_info.h"
+#include "linker/code_layout.h"
+#include "linker/linker_patch_table.h"
 #include "linker/multi_oat_relative_patcher.h"
 #include "linker/output_stream.h"
 #include "mirror/array.h"
@@ -226,6 +233,7 @@ class OatWriter::OatDexFile {
   }
 
   void ReserveTypeLookupTable(OatWriter* oat_writer);
+  void ReserveIdLookupTable(OatWriter* oat_writer);
   void ReserveClassOffsets(OatWriter* oat_writer);
 
   size_t SizeOf() const;
@@ -252,6 +260,12 @@ class OatWriter::OatDexFile {
   uint32_t dex_file_offset_;
   uint32_t class_offsets_offset_;
   uint32_t lookup_table_offset_;
+  uint32_t id_lookup_table_offset_;
+
+  // Number of string and method ids, used to size the id lookup table. Initialized when writing
+  // the dex file.
+  uint32_t num_string_ids_;
+  uint32_t num_method_ids_;
 
   // Data to write to a separate section.
   dchecked_vector<uint32_t> class_offsets_;
@@ -272,7 +286,9 @@ class OatWriter::OatDexFile {
   DCHECK_EQ(static_cast<off_t>(file_offset + offset_), out->Seek(0, kSeekCurrent)) \
     << "file_offset=" << file_offset << " offset_=" << offset_
 
-OatWriter::OatWriter(bool compiling_boot_image, TimingLogger* timings)
+OatWriter::OatWriter(bool compiling_boot_image,
+                     TimingLogger* timings,
+                     const ProfileCompilationInfo* profile_compilation_info)
   : write_state_(WriteState::kAddingDexFileSources),
     timings_(timings),
     raw_dex_files_(),
@@ -282,6 +298,7 @@ OatWriter::OatWriter(bool compiling_boot_image, TimingLogger* timings)
     compiler_driver_(nullptr),
     image_writer_(nullptr),
     compiling_boot_image_(compiling_boot_image),
+    profile_compilation_info_(profile_compilation_info),
     dex_files_(nullptr),
     size_(0u),
     bss_size_(0u),
@@ -306,6 +323,8 @@ OatWriter::OatWriter(bool compiling_boot_image, TimingLogger* timings)
     size_relative_call_thunks_(0),
     size_misc_thunks_(0),
     size_vmap_table_(0),
+    size_linker_patch_table_alignment_(0),
+    size_linker_patch_table_(0),
     size_oat_dex_file_location_size_(0),
     size_oat_dex_file_location_data_(0),
     size_oat_dex_file_location_checksum_(0),
@@ -314,6 +333,9 @@ OatWriter::OatWriter(bool compiling_boot_image, TimingLogger* timings)
     size_oat_dex_file_lookup_table_offset_(0),
     size_oat_lookup_table_alignment_(0),
     size_oat_lookup_table_(0),
+    size_oat_dex_file_id_lookup_table_offset_(0),
+    size_oat_id_lookup_table_alignment_(0),
+    size_oat_id_lookup_table_(0),
     size_oat_class_offsets_alignment_(0),
     size_oat_class_offsets_(0),
     size_oat_class_type_(0),
@@ -443,9 +465,10 @@ bool OatWriter::WriteAndOpenDexFiles(
   if (!WriteDexFiles(rodata, file)) {
     return false;
   }
-  // Reserve space for type lookup tables and update type_lookup_table_offset_.
+  // Reserve space for type and id lookup tables and update their offsets.
   for (OatDexFile& oat_dex_file : oat_dex_files_) {
     oat_dex_file.ReserveTypeLookupTable(this);
+    oat_dex_file.ReserveIdLookupTable(this);
   }
   size_t size_after_type_lookup_tables = size_;
   // Reserve space for class offsets and update class_offsets_offset_.
@@ -500,6 +523,10 @@ void OatWriter::PrepareLayout(const CompilerDriver* compiler,
     TimingLogger::ScopedTiming split("InitOatMaps", timings_);
     offset = InitOatMaps(offset);
   }
+  if (compiler_driver_->GetCompilerOptions().GetRecordLinkerPatches() && !compiling_boot_image_) {
+    TimingLogger::ScopedTiming split("InitOatLinkerPatches", timings_);
+    offset = InitOatLinkerPatches(offset);
+  }
   {
     TimingLogger::ScopedTiming split("InitOatCode", timings_);
     offset = InitOatCode(offset);
@@ -665,138 +692,259 @@ class OatWriter::InitOatClassesMethodVisitor : public DexMethodVisitor {
   size_t num_non_null_compiled_methods_;
 };
 
-class OatWriter::InitCodeMethodVisitor : public OatDexMethodVisitor {
+// A compiled method with the data the code visitors need, recorded by LayoutCodeMethodVisitor
+// so that the code can be visited in an order other than the class definition order.
+struct OatWriter::OrderedMethodData {
+  const DexFile* dex_file;
+  size_t class_def_index;
+  size_t oat_class_index;
+  size_t method_offsets_index;
+  uint32_t method_idx;
+  uint32_t access_flags;
+  const DexFile::CodeItem* code_item;
+  CompiledMethod* compiled_method;
+};
+
+class OatWriter::OrderedMethodVisitor {
  public:
-  InitCodeMethodVisitor(OatWriter* writer, size_t offset)
-    : OatDexMethodVisitor(writer, offset),
-      debuggable_(writer->GetCompilerDriver()->GetCompilerOptions().GetDebuggable()) {
-    writer_->absolute_patch_locations_.reserve(
-        writer_->compiler_driver_->GetNonRelativeLinkerPatchCount());
+  OrderedMethodVisitor(OatWriter* writer, size_t offset)
+    : writer_(writer),
+      offset_(offset) {
+  }
+
+  virtual bool VisitMethod(const OrderedMethodData& method_data) = 0;
+
+  // Called after the last method.
+  virtual bool VisitComplete() = 0;
+
+  // Visit all the compiled methods in the order chosen by LayoutCodeMethodVisitor.
+  bool Visit() {
+    for (const OrderedMethodData& method_data : writer_->ordered_methods_) {
+      if (UNLIKELY(!VisitMethod(method_data))) {
+        return false;
+      }
+    }
+    return VisitComplete();
+  }
+
+  size_t GetOffset() const {
+    return offset_;
+  }
+
+ protected:
+  virtual ~OrderedMethodVisitor() { }
+
+  OatWriter* const writer_;
+
+  // The offset is usually advanced for each visited method by the derived class.
+  size_t offset_;
+};
+
+class OatWriter::LayoutCodeMethodVisitor : public OatDexMethodVisitor {
+ public:
+  LayoutCodeMethodVisitor(OatWriter* writer, size_t offset)
+    : OatDexMethodVisitor(writer, offset) {
+    writer_->ordered_methods_.clear();
   }
 
   bool EndClass() {
     OatDexMethodVisitor::EndClass();
-    if (oat_class_index_ == writer_->oat_classes_.size()) {
-      offset_ = writer_->relative_patcher_->ReserveSpaceEnd(offset_);
+    if (oat_class_index_ == writer_->oat_classes_.size() &&
+        writer_->profile_compilation_info_ != nullptr) {
+      LayoutByProfile();
     }
     return true;
   }
 
-  bool VisitMethod(size_t class_def_method_index, const ClassDataItemIterator& it)
-      SHARED_REQUIRES(Locks::mutator_lock_) {
+  bool VisitMethod(size_t class_def_method_index, const ClassDataItemIterator& it) {
     OatClass* oat_class = &writer_->oat_classes_[oat_class_index_];
     CompiledMethod* compiled_method = oat_class->GetCompiledMethod(class_def_method_index);
 
     if (compiled_method != nullptr) {
-      // Derived from CompiledMethod.
-      uint32_t quick_code_offset = 0;
-
-      ArrayRef<const uint8_t> quick_code = compiled_method->GetQuickCode();
-      uint32_t code_size = quick_code.size() * sizeof(uint8_t);
-      uint32_t thumb_offset = compiled_method->CodeDelta();
-
-      // Deduplicate code arrays if we are not producing debuggable code.
-      bool deduped = true;
-      MethodReference method_ref(dex_file_, it.GetMemberIndex());
-      if (debuggable_) {
-        quick_code_offset = writer_->relative_patcher_->GetOffset(method_ref);
-        if (quick_code_offset != 0u) {
-          // Duplicate methods, we want the same code for both of them so that the oat writer puts
-          // the same code in both ArtMethods so that we do not get different oat code at runtime.
-        } else {
-          quick_code_offset = NewQuickCodeOffset(compiled_method, it, thumb_offset);
-          deduped = false;
+      writer_->ordered_methods_.push_back(OrderedMethodData {
+          dex_file_,
+          class_def_index_,
+          oat_class_index_,
+          method_offsets_index_,
+          it.GetMemberIndex(),
+          it.GetMethodAccessFlags(),
+          it.GetMethodCodeItem(),
+          compiled_method,
+      });
+      ++method_offsets_index_;
+    }
+
+    return true;
+  }
+
+ private:
+  // Move the code of the methods in the profile to the start of the text section, clustering
+  // the methods that call each other. The profile does not record calls, so the call graph is
+  // taken from the call patches of the compiled code.
+  void LayoutByProfile() {
+    dchecked_vector<OrderedMethodData>& methods = writer_->ordered_methods_;
+    const ProfileCompilationInfo* profile = writer_->profile_compilation_info_;
+    linker::CodeLayout layout;
+    SafeMap<MethodReference, size_t, MethodReferenceComparator> method_indexes;
+    for (const OrderedMethodData& method_data : methods) {
+      MethodReference method_ref(method_data.dex_file, method_data.method_idx);
+      size_t index = layout.AddMethod(method_data.compiled_method->GetQuickCode().size(),
+                                      profile->ContainsMethod(method_ref));
+      // Keep the first definition of duplicate methods, it is the one calls are linked to.
+      if (method_indexes.find(method_ref) == method_indexes.end()) {
+        method_indexes.Put(method_ref, index);
+      }
+    }
+    if (layout.GetNumberOfHotMethods() == 0u) {
+      return;
+    }
+    for (size_t i = 0; i != methods.size(); ++i) {
+      for (const LinkerPatch& patch : methods[i].compiled_method->GetPatches()) {
+        if (patch.GetType() == LinkerPatch::Type::kCallRelative ||
+            patch.GetType() == LinkerPatch::Type::kCall) {
+          auto it = method_indexes.find(patch.TargetMethod());
+          if (it != method_indexes.end()) {
+            layout.AddCall(i, it->second);
+          }
         }
-      } else {
-        quick_code_offset = dedupe_map_.GetOrCreate(
-            compiled_method,
-            [this, &deduped, compiled_method, &it, thumb_offset]() {
-              deduped = false;
-              return NewQuickCodeOffset(compiled_method, it, thumb_offset);
-            });
       }
+    }
+    dchecked_vector<OrderedMethodData> ordered_methods;
+    ordered_methods.reserve(methods.size());
+    for (size_t index : layout.GetOrder()) {
+      ordered_methods.push_back(methods[index]);
+    }
+    methods.swap(ordered_methods);
+  }
+};
 
-      if (code_size != 0) {
-        if (writer_->relative_patcher_->GetOffset(method_ref) != 0u) {
-          // TODO: Should this be a hard failure?
-          LOG(WARNING) << "Multiple definitions of "
-              << PrettyMethod(method_ref.dex_method_index, *method_ref.dex_file)
-              << " offsets " << writer_->relative_patcher_->GetOffset(method_ref)
-              << " " << quick_code_offset;
-        } else {
-          writer_->relative_patcher_->SetOffset(method_ref, quick_code_offset);
-        }
+class OatWriter::InitCodeMethodVisitor : public OrderedMethodVisitor {
+ public:
+  InitCodeMethodVisitor(OatWriter* writer, size_t offset)
+    : OrderedMethodVisitor(writer, offset),
+      debuggable_(writer->GetCompilerDriver()->GetCompilerOptions().GetDebuggable()) {
+    writer_->absolute_patch_locations_.reserve(
+        writer_->compiler_driver_->GetNonRelativeLinkerPatchCount());
+  }
+
+  bool VisitComplete() {
+    offset_ = writer_->relative_patcher_->ReserveSpaceEnd(offset_);
+    return true;
+  }
+
+  bool VisitMethod(const OrderedMethodData& method_data)
+      SHARED_REQUIRES(Locks::mutator_lock_) {
+    OatClass* oat_class = &writer_->oat_classes_[method_data.oat_class_index];
+    CompiledMethod* compiled_method = method_data.compiled_method;
+
+    // Derived from CompiledMethod.
+    uint32_t quick_code_offset = 0;
+
+    ArrayRef<const uint8_t> quick_code = compiled_method->GetQuickCode();
+    uint32_t code_size = quick_code.size() * sizeof(uint8_t);
+    uint32_t thumb_offset = compiled_method->CodeDelta();
+
+    // Deduplicate code arrays if we are not producing debuggable code.
+    bool deduped = true;
+    MethodReference method_ref(method_data.dex_file, method_data.method_idx);
+    if (debuggable_) {
+      quick_code_offset = writer_->relative_patcher_->GetOffset(method_ref);
+      if (quick_code_offset != 0u) {
+        // Duplicate methods, we want the same code for both of them so that the oat writer puts
+        // the same code in both ArtMethods so that we do not get different oat code at runtime.
+      } else {
+        quick_code_offset = NewQuickCodeOffset(compiled_method, method_data, thumb_offset);
+        deduped = false;
       }
+    } else {
+      quick_code_offset = dedupe_map_.GetOrCreate(
+          compiled_method,
+          [this, &deduped, compiled_method, &method_data, thumb_offset]() {
+            deduped = false;
+            return NewQuickCodeOffset(compiled_method, method_data, thumb_offset);
+          });
+    }
 
-      // Update quick method header.
-      DCHECK_LT(method_offsets_index_, oat_class->method_headers_.size());
-      OatQuickMethodHeader* method_header = &oat_class->method_headers_[method_offsets_index_];
-      uint32_t vmap_table_offset = method_header->vmap_table_offset_;
-      // If we don't have quick code, then we must have a vmap, as that is how the dex2dex
-      // compiler records its transformations.
-      DCHECK(!quick_code.empty() || vmap_table_offset != 0);
-      // The code offset was 0 when the mapping/vmap table offset was set, so it's set
-      // to 0-offset and we need to adjust it by code_offset.
-      uint32_t code_offset = quick_code_offset - thumb_offset;
-      if (vmap_table_offset != 0u && code_offset != 0u) {
-        vmap_table_offset += code_offset;
-        DCHECK_LT(vmap_table_offset, code_offset) << "Overflow in oat offsets";
+    if (code_size != 0) {
+      if (writer_->relative_patcher_->GetOffset(method_ref) != 0u) {
+        // TODO: Should this be a hard failure?
+        LOG(WARNING) << "Multiple definitions of "
+            << PrettyMethod(method_ref.dex_method_index, *method_ref.dex_file)
+            << " offsets " << writer_->relative_patcher_->GetOffset(method_ref)
+            << " " << quick_code_offset;
+      } else {
+        writer_->relative_patcher_->SetOffset(method_ref, quick_code_offset);
       }
-      uint32_t frame_size_in_bytes = compiled_method->GetFrameSizeInBytes();
-      uint32_t core_spill_mask = compiled_method->GetCoreSpillMask();
-      uint32_t fp_spill_mask = compiled_method->GetFpSpillMask();
-      *method_header = OatQuickMethodHeader(vmap_table_offset,
-                                            frame_size_in_bytes,
-                                            core_spill_mask,
-                                            fp_spill_mask,
-                                            code_size);
-
-      if (!deduped) {
-        // Update offsets. (Checksum is updated when writing.)
-        offset_ += sizeof(*method_header);  // Method header is prepended before code.
-        offset_ += code_size;
-        // Record absolute patch locations.
-        if (!compiled_method->GetPatches().empty()) {
-          uintptr_t base_loc = offset_ - code_size - writer_->oat_header_->GetExecutableOffset();
-          for (const LinkerPatch& patch : compiled_method->GetPatches()) {
-            if (!patch.IsPcRelative()) {
-              writer_->absolute_patch_locations_.push_back(base_loc + patch.LiteralOffset());
-            }
+    }
+
+    // Update quick method header.
+    DCHECK_LT(method_data.method_offsets_index, oat_class->method_headers_.size());
+    OatQuickMethodHeader* method_header =
+        &oat_class->method_headers_[method_data.method_offsets_index];
+    uint32_t vmap_table_offset = method_header->vmap_table_offset_;
+    // If we don't have quick code, then we must have a vmap, as that is how the dex2dex
+    // compiler records its transformations.
+    DCHECK(!quick_code.empty() || vmap_table_offset != 0);
+    // The code offset was 0 when the mapping/vmap table offset was set, so it's set
+    // to 0-offset and we need to adjust it by code_offset.
+    uint32_t code_offset = quick_code_offset - thumb_offset;
+    if (vmap_table_offset != 0u && code_offset != 0u) {
+      vmap_table_offset += code_offset;
+      DCHECK_LT(vmap_table_offset, code_offset) << "Overflow in oat offsets";
+    }
+    uint32_t frame_size_in_bytes = compiled_method->GetFrameSizeInBytes();
+    uint32_t core_spill_mask = compiled_method->GetCoreSpillMask();
+    uint32_t fp_spill_mask = compiled_method->GetFpSpillMask();
+    *method_header = OatQuickMethodHeader(vmap_table_offset,
+                                          frame_size_in_bytes,
+                                          core_spill_mask,
+                                          fp_spill_mask,
+                                          code_size);
+
+    if (!deduped) {
+      // Update offsets. (Checksum is updated when writing.)
+      offset_ += sizeof(*method_header);  // Method header is prepended before code.
+      offset_ += code_size;
+      // Record absolute patch locations.
+      if (!compiled_method->GetPatches().empty()) {
+        uintptr_t base_loc = offset_ - code_size - writer_->oat_header_->GetExecutableOffset();
+        for (const LinkerPatch& patch : compiled_method->GetPatches()) {
+          if (!patch.IsPcRelative()) {
+            writer_->absolute_patch_locations_.push_back(base_loc + patch.LiteralOffset());
           }
         }
       }
+    }
 
-      const CompilerOptions& compiler_options = writer_->compiler_driver_->GetCompilerOptions();
-      // Exclude quickened dex methods (code_size == 0) since they have no native code.
-      if (compiler_options.GenerateAnyDebugInfo() && code_size != 0) {
-        bool has_code_info = method_header->IsOptimized();
-        // Record debug information for this function if we are doing that.
-        debug::MethodDebugInfo info = debug::MethodDebugInfo();
-        info.trampoline_name = nullptr;
-        info.dex_file = dex_file_;
-        info.class_def_index = class_def_index_;
-        info.dex_method_index = it.GetMemberIndex();
-        info.access_flags = it.GetMethodAccessFlags();
-        info.code_item = it.GetMethodCodeItem();
-        info.isa = compiled_method->GetInstructionSet();
-        info.deduped = deduped;
-        info.is_native_debuggable = compiler_options.GetNativeDebuggable();
-        info.is_optimized = method_header->IsOptimized();
-        info.is_code_address_text_relative = true;
-        info.code_address = code_offset - writer_->oat_header_->GetExecutableOffset();
-        info.code_size = code_size;
-        info.frame_size_in_bytes = compiled_method->GetFrameSizeInBytes();
-        info.code_info = has_code_info ? compiled_method->GetVmapTable().data() : nullptr;
-        info.cfi = compiled_method->GetCFIInfo();
-        writer_->method_info_.push_back(info);
-      }
-
-      DCHECK_LT(method_offsets_index_, oat_class->method_offsets_.size());
-      OatMethodOffsets* offsets = &oat_class->method_offsets_[method_offsets_index_];
-      offsets->code_offset_ = quick_code_offset;
-      ++method_offsets_index_;
+    const CompilerOptions& compiler_options = writer_->compiler_driver_->GetCompilerOptions();
+    // Exclude quickened dex methods (code_size == 0) since they have no native code.
+    if (compiler_options.GenerateAnyDebugInfo() && code_size != 0) {
+      bool has_code_info = method_header->IsOptimized();
+      // Record debug information for this function if we are doing that.
+      debug::MethodDebugInfo info = debug::MethodDebugInfo();
+      info.trampoline_name = nullptr;
+      info.dex_file = method_data.dex_file;
+      info.class_def_index = method_data.class_def_index;
+      info.dex_method_index = method_data.method_idx;
+      info.access_flags = method_data.access_flags;
+      info.code_item = method_data.code_item;
+      info.isa = compiled_method->GetInstructionSet();
+      info.deduped = deduped;
+      info.is_native_debuggable = compiler_options.GetNativeDebuggable();
+      info.is_optimized = method_header->IsOptimized();
+      info.is_code_address_text_relative = true;
+      info.code_address = code_offset - writer_->oat_header_->GetExecutableOffset();
+      info.code_size = code_size;
+      info.frame_size_in_bytes = compiled_method->GetFrameSizeInBytes();
+      info.code_info = has_code_info ? compiled_method->GetVmapTable().data() : nullptr;
+      info.cfi = compiled_method->GetCFIInfo();
+      writer_->method_info_.push_back(info);
     }
 
+    DCHECK_LT(method_data.method_offsets_index, oat_class->method_offsets_.size());
+    OatMethodOffsets* offsets = &oat_class->method_offsets_[method_data.method_offsets_index];
+    offsets->code_offset_ = quick_code_offset;
+
     return true;
   }
 
@@ -819,10 +967,10 @@ class OatWriter::InitCodeMethodVisitor : public OatDexMethodVisitor {
   };
 
   uint32_t NewQuickCodeOffset(CompiledMethod* compiled_method,
-                              const ClassDataItemIterator& it,
+                              const OrderedMethodData& method_data,
                               uint32_t thumb_offset) {
     offset_ = writer_->relative_patcher_->ReserveSpace(
-        offset_, compiled_method, MethodReference(dex_file_, it.GetMemberIndex()));
+        offset_, compiled_method, MethodReference(method_data.dex_file, method_data.method_idx));
     offset_ += CodeAlignmentSize(offset_, *compiled_method);
     DCHECK_ALIGNED_PARAM(offset_ + sizeof(OatQuickMethodHeader),
                          GetInstructionSetAlignment(compiled_method->GetInstructionSet()));
@@ -878,6 +1026,44 @@ class OatWriter::InitMapMethodVisitor : public OatDexMethodVisitor {
   SafeMap<const uint8_t*, uint32_t> dedupe_map_;
 };
 
+class OatWriter::InitLinkerPatchesMethodVisitor : public OatDexMethodVisitor {
+ public:
+  explicit InitLinkerPatchesMethodVisitor(OatWriter* writer)
+    : OatDexMethodVisitor(writer, /* offset */ 0u),
+      dex_file_index_(0u),
+      last_dex_file_(nullptr),
+      methods_() {
+  }
+
+  bool StartClass(const DexFile* dex_file, size_t class_def_index) {
+    if (dex_file != last_dex_file_) {
+      // VisitDexMethods() visits the dex files in order.
+      dex_file_index_ = (last_dex_file_ != nullptr) ? dex_file_index_ + 1u : 0u;
+      DCHECK_EQ(dex_file, (*writer_->dex_files_)[dex_file_index_]);
+      last_dex_file_ = dex_file;
+    }
+    return OatDexMethodVisitor::StartClass(dex_file, class_def_index);
+  }
+
+  bool VisitMethod(size_t class_def_method_index, const ClassDataItemIterator& it) {
+    OatClass* oat_class = &writer_->oat_classes_[oat_class_index_];
+    CompiledMethod* compiled_method = oat_class->GetCompiledMethod(class_def_method_index);
+    if (compiled_method != nullptr && !compiled_method->GetPatches().empty()) {
+      methods_.push_back({ dex_file_index_, it.GetMemberIndex(), compiled_method });
+    }
+    return true;
+  }
+
+  std::vector<linker::LinkerPatchTable::MethodEntry>* GetMethods() {
+    return &methods_;
+  }
+
+ private:
+  uint32_t dex_file_index_;
+  const DexFile* last_dex_file_;
+  std::vector<linker::LinkerPatchTable::MethodEntry> methods_;
+};
+
 class OatWriter::InitImageMethodVisitor : public OatDexMethodVisitor {
  public:
   InitImageMethodVisitor(OatWriter* writer, size_t offset)
@@ -951,17 +1137,21 @@ class OatWriter::InitImageMethodVisitor : public OatDexMethodVisitor {
   const size_t pointer_size_;
 };
 
-class OatWriter::WriteCodeMethodVisitor : public OatDexMethodVisitor {
+class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
  public:
   WriteCodeMethodVisitor(OatWriter* writer, OutputStream* out, const size_t file_offset,
                          size_t relative_offset) SHARED_LOCK_FUNCTION(Locks::mutator_lock_)
-    : OatDexMethodVisitor(writer, relative_offset),
+    : OrderedMethodVisitor(writer, relative_offset),
       out_(out),
       file_offset_(file_offset),
       soa_(Thread::Current()),
       no_thread_suspension_(soa_.Self(), "OatWriter patching"),
       class_linker_(Runtime::Current()->GetClassLinker()),
-      dex_cache_(nullptr) {
+      dex_file_(nullptr),
+      dex_cache_(nullptr),
+      write_back_batch_size_(
+          writer->GetCompilerDriver()->GetCompiledMethodStorage()->GetWriteBackBatchSize()),
+      written_since_write_back_(0u) {
     patched_code_.reserve(16 * KB);
     if (writer_->HasBootImage()) {
       // If we're creating the image, the address space must be ready so that we can apply patches.
@@ -972,144 +1162,144 @@ class OatWriter::WriteCodeMethodVisitor : public OatDexMethodVisitor {
   ~WriteCodeMethodVisitor() UNLOCK_FUNCTION(Locks::mutator_lock_) {
   }
 
-  bool StartClass(const DexFile* dex_file, size_t class_def_index)
-      SHARED_REQUIRES(Locks::mutator_lock_) {
-    OatDexMethodVisitor::StartClass(dex_file, class_def_index);
-    if (dex_cache_ == nullptr || dex_cache_->GetDexFile() != dex_file) {
-      dex_cache_ = class_linker_->FindDexCache(Thread::Current(), *dex_file);
-      DCHECK(dex_cache_ != nullptr);
+  bool VisitComplete() {
+    offset_ = writer_->relative_patcher_->WriteThunks(out_, offset_);
+    if (UNLIKELY(offset_ == 0u)) {
+      PLOG(ERROR) << "Failed to write final relative call thunks";
+      return false;
     }
     return true;
   }
 
-  bool EndClass() SHARED_REQUIRES(Locks::mutator_lock_) {
-    bool result = OatDexMethodVisitor::EndClass();
-    if (oat_class_index_ == writer_->oat_classes_.size()) {
-      DCHECK(result);  // OatDexMethodVisitor::EndClass() never fails.
-      offset_ = writer_->relative_patcher_->WriteThunks(out_, offset_);
-      if (UNLIKELY(offset_ == 0u)) {
-        PLOG(ERROR) << "Failed to write final relative call thunks";
-        result = false;
-      }
-    }
-    return result;
-  }
-
-  bool VisitMethod(size_t class_def_method_index, const ClassDataItemIterator& it)
+  bool VisitMethod(const OrderedMethodData& method_data)
       SHARED_REQUIRES(Locks::mutator_lock_) {
-    OatClass* oat_class = &writer_->oat_classes_[oat_class_index_];
-    const CompiledMethod* compiled_method = oat_class->GetCompiledMethod(class_def_method_index);
+    OatClass* oat_class = &writer_->oat_classes_[method_data.oat_class_index];
+    const CompiledMethod* compiled_method = method_data.compiled_method;
 
     // No thread suspension since dex_cache_ that may get invalidated if that occurs.
     ScopedAssertNoThreadSuspension tsc(Thread::Current(), __FUNCTION__);
-    if (compiled_method != nullptr) {  // ie. not an abstract method
-      size_t file_offset = file_offset_;
-      OutputStream* out = out_;
-
-      ArrayRef<const uint8_t> quick_code = compiled_method->GetQuickCode();
-      uint32_t code_size = quick_code.size() * sizeof(uint8_t);
-
-      // Deduplicate code arrays.
-      const OatMethodOffsets& method_offsets = oat_class->method_offsets_[method_offsets_index_];
-      if (method_offsets.code_offset_ > offset_) {
-        offset_ = writer_->relative_patcher_->WriteThunks(out, offset_);
-        if (offset_ == 0u) {
-          ReportWriteFailure("relative call thunk", it);
-          return false;
-        }
-        uint32_t alignment_size = CodeAlignmentSize(offset_, *compiled_method);
-        if (alignment_size != 0) {
-          if (!writer_->WriteCodeAlignment(out, alignment_size)) {
-            ReportWriteFailure("code alignment padding", it);
-            return false;
-          }
-          offset_ += alignment_size;
-          DCHECK_OFFSET_();
-        }
-        DCHECK_ALIGNED_PARAM(offset_ + sizeof(OatQuickMethodHeader),
-                             GetInstructionSetAlignment(compiled_method->GetInstructionSet()));
-        DCHECK_EQ(method_offsets.code_offset_,
-                  offset_ + sizeof(OatQuickMethodHeader) + compiled_method->CodeDelta())
-            << PrettyMethod(it.GetMemberIndex(), *dex_file_);
-        const OatQuickMethodHeader& method_header =
-            oat_class->method_headers_[method_offsets_index_];
-        if (!out->WriteFully(&method_header, sizeof(method_header))) {
-          ReportWriteFailure("method header", it);
+    if (dex_file_ != method_data.dex_file) {
+      dex_file_ = method_data.dex_file;
+      if (dex_cache_ == nullptr || dex_cache_->GetDexFile() != dex_file_) {
+        dex_cache_ = class_linker_->FindDexCache(Thread::Current(), *dex_file_);
+        DCHECK(dex_cache_ != nullptr);
+      }
+    }
+    size_t file_offset = file_offset_;
+    OutputStream* out = out_;
+
+    ArrayRef<const uint8_t> quick_code = compiled_method->GetQuickCode();
+    uint32_t code_size = quick_code.size() * sizeof(uint8_t);
+
+    // Deduplicate code arrays.
+    const OatMethodOffsets& method_offsets =
+        oat_class->method_offsets_[method_data.method_offsets_index];
+    if (method_offsets.code_offset_ > offset_) {
+      offset_ = writer_->relative_patcher_->WriteThunks(out, offset_);
+      if (offset_ == 0u) {
+        ReportWriteFailure("relative call thunk", method_data);
+        return false;
+      }
+      uint32_t alignment_size = CodeAlignmentSize(offset_, *compiled_method);
+      if (alignment_size != 0) {
+        if (!writer_->WriteCodeAlignment(out, alignment_size)) {
+          ReportWriteFailure("code alignment padding", method_data);
           return false;
         }
-        writer_->size_method_header_ += sizeof(method_header);
-        offset_ += sizeof(method_header);
+        offset_ += alignment_size;
         DCHECK_OFFSET_();
+      }
+      DCHECK_ALIGNED_PARAM(offset_ + sizeof(OatQuickMethodHeader),
+                           GetInstructionSetAlignment(compiled_method->GetInstructionSet()));
+      DCHECK_EQ(method_offsets.code_offset_,
+                offset_ + sizeof(OatQuickMethodHeader) + compiled_method->CodeDelta())
+          << PrettyMethod(method_data.method_idx, *dex_file_);
+      const OatQuickMethodHeader& method_header =
+          oat_class->method_headers_[method_data.method_offsets_index];
+      if (!out->WriteFully(&method_header, sizeof(method_header))) {
+        ReportWriteFailure("method header", method_data);
+        return false;
+      }
+      writer_->size_method_header_ += sizeof(method_header);
+      offset_ += sizeof(method_header);
+      DCHECK_OFFSET_();
 
-        if (!compiled_method->GetPatches().empty()) {
-          patched_code_.assign(quick_code.begin(), quick_code.end());
-          quick_code = ArrayRef<const uint8_t>(patched_code_);
-          for (const LinkerPatch& patch : compiled_method->GetPatches()) {
-            uint32_t literal_offset = patch.LiteralOffset();
-            switch (patch.GetType()) {
-              case LinkerPatch::Type::kCallRelative: {
-                // NOTE: Relative calls across oat files are not supported.
-                uint32_t target_offset = GetTargetOffset(patch);
-                writer_->relative_patcher_->PatchCall(&patched_code_,
-                                                      literal_offset,
-                                                      offset_ + literal_offset,
-                                                      target_offset);
-                break;
-              }
-              case LinkerPatch::Type::kDexCacheArray: {
-                uint32_t target_offset = GetDexCacheOffset(patch);
-                writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
-                                                                     patch,
-                                                                     offset_ + literal_offset,
-                                                                     target_offset);
-                break;
-              }
-              case LinkerPatch::Type::kStringRelative: {
-                uint32_t target_offset = GetTargetObjectOffset(GetTargetString(patch));
-                writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
-                                                                     patch,
-                                                                     offset_ + literal_offset,
-                                                                     target_offset);
-                break;
-              }
-              case LinkerPatch::Type::kCall: {
-                uint32_t target_offset = GetTargetOffset(patch);
-                PatchCodeAddress(&patched_code_, literal_offset, target_offset);
-                break;
-              }
-              case LinkerPatch::Type::kMethod: {
-                ArtMethod* method = GetTargetMethod(patch);
-                PatchMethodAddress(&patched_code_, literal_offset, method);
-                break;
-              }
-              case LinkerPatch::Type::kString: {
-                mirror::String* string = GetTargetString(patch);
-                PatchObjectAddress(&patched_code_, literal_offset, string);
-                break;
-              }
-              case LinkerPatch::Type::kType: {
-                mirror::Class* type = GetTargetType(patch);
-                PatchObjectAddress(&patched_code_, literal_offset, type);
-                break;
-              }
-              default: {
-                DCHECK_EQ(patch.GetType(), LinkerPatch::Type::kRecordPosition);
-                break;
-              }
+      if (!compiled_method->GetPatches().empty()) {
+        patched_code_.assign(quick_code.begin(), quick_code.end());
+        quick_code = ArrayRef<const uint8_t>(patched_code_);
+        for (const LinkerPatch& patch : compiled_method->GetPatches()) {
+          uint32_t literal_offset = patch.LiteralOffset();
+          switch (patch.GetType()) {
+            case LinkerPatch::Type::kCallRelative: {
+              // NOTE: Relative calls across oat files are not supported.
+              uint32_t target_offset = GetTargetOffset(patch);
+              writer_->relative_patcher_->PatchCall(&patched_code_,
+                                                    literal_offset,
+                                                    offset_ + literal_offset,
+                                                    target_offset);
+              break;
+            }
+            case LinkerPatch::Type::kDexCacheArray: {
+              uint32_t target_offset = GetDexCacheOffset(patch);
+              writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
+                                                                   patch,
+                                                                   offset_ + literal_offset,
+                                                                   target_offset);
+              break;
+            }
+            case LinkerPatch::Type::kStringRelative: {
+              uint32_t target_offset = GetTargetObjectOffset(GetTargetString(patch));
+              writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
+                                                                   patch,
+                                                                   offset_ + literal_offset,
+                                                                   target_offset);
+              break;
+            }
+            case LinkerPatch::Type::kCall: {
+              uint32_t target_offset = GetTargetOffset(patch);
+              PatchCodeAddress(&patched_code_, literal_offset, target_offset);
+              break;
+            }
+            case LinkerPatch::Type::kMethod: {
+              ArtMethod* method = GetTargetMethod(patch);
+              PatchMethodAddress(&patched_code_, literal_offset, method);
+              break;
+            }
+            case LinkerPatch::Type::kString: {
+              mirror::String* string = GetTargetString(patch);
+              PatchObjectAddress(&patched_code_, literal_offset, string);
+              break;
+            }
+            case LinkerPatch::Type::kType: {
+              mirror::Class* type = GetTargetType(patch);
+              PatchObjectAddress(&patched_code_, literal_offset, type);
+              break;
+            }
+            default: {
+              DCHECK_EQ(patch.GetType(), LinkerPatch::Type::kRecordPosition);
+              break;
             }
           }
         }
+      }
 
-        if (!out->WriteFully(quick_code.data(), code_size)) {
-          ReportWriteFailure("method code", it);
-          return false;
+      if (!out->WriteFully(quick_code.data(), code_size)) {
+        ReportWriteFailure("method code", method_data);
+        return false;
+      }
+      writer_->size_code_ += code_size;
+      offset_ += code_size;
+
+      // The compiled code is streamed from the swap file, drop what has been written.
+      if (write_back_batch_size_ != 0u) {
+        written_since_write_back_ += code_size;
+        if (written_since_write_back_ >= write_back_batch_size_) {
+          writer_->GetCompilerDriver()->GetCompiledMethodStorage()->WriteBack();
+          written_since_write_back_ = 0u;
         }
-        writer_->size_code_ += code_size;
-        offset_ += code_size;
       }
-      DCHECK_OFFSET_();
-      ++method_offsets_index_;
     }
+    DCHECK_OFFSET_();
 
     return true;
   }
@@ -1120,12 +1310,18 @@ class OatWriter::WriteCodeMethodVisitor : public OatDexMethodVisitor {
   const ScopedObjectAccess soa_;
   const ScopedAssertNoThreadSuspension no_thread_suspension_;
   ClassLinker* const class_linker_;
+  // The dex file and dex cache of the method being written.
+  const DexFile* dex_file_;
   mirror::DexCache* dex_cache_;
   std::vector<uint8_t> patched_code_;
+  // The batch size of the compiled method storage, or 0 if it does not stream.
+  const size_t write_back_batch_size_;
+  size_t written_since_write_back_;
 
-  void ReportWriteFailure(const char* what, const ClassDataItemIterator& it) {
+  void ReportWriteFailure(const char* what, const OrderedMethodData& method_data) {
     PLOG(ERROR) << "Failed to write " << what << " for "
-        << PrettyMethod(it.GetMemberIndex(), *dex_file_) << " to " << out_->GetLocation();
+        << PrettyMethod(method_data.method_idx, *method_data.dex_file)
+        << " to " << out_->GetLocation();
   }
 
   ArtMethod* GetTargetMethod(const LinkerPatch& patch)
@@ -1174,7 +1370,17 @@ class OatWriter::WriteCodeMethodVisitor : public OatDexMethodVisitor {
   }
 
   mirror::String* GetTargetString(const LinkerPatch& patch) SHARED_REQUIRES(Locks::mutator_lock_) {
-    mirror::String* string = dex_cache_->GetResolvedString(patch.TargetStringIndex());
+    uint32_t string_idx = patch.TargetStringIndex();
+    mirror::String* string = dex_cache_->GetResolvedString(string_idx);
+    if (string == nullptr) {
+      // A hashed strings array keeps only one of the strings sharing a slot. All the strings
+      // referenced by boot image code were resolved, so they are interned.
+      const DexFile& dex_file = *patch.TargetStringDexFile();
+      uint32_t utf16_length;
+      const char* utf8_data = dex_file.StringDataAndUtf16LengthByIdx(string_idx, &utf16_length);
+      string = Runtime::Current()->GetInternTable()->LookupStrong(
+          Thread::Current(), utf16_length, utf8_data);
+    }
     DCHECK(string != nullptr);
     DCHECK(writer_->HasBootImage() ||
            Runtime::Current()->GetHeap()->ObjectIsInBootImageSpace(string));
@@ -1429,6 +1635,27 @@ size_t OatWriter::InitOatMaps(size_t offset) {
   return offset;
 }
 
+size_t OatWriter::InitOatLinkerPatches(size_t offset) {
+  InitLinkerPatchesMethodVisitor visitor(this);
+  bool success = VisitDexMethods(&visitor);
+  DCHECK(success);
+  std::vector<linker::LinkerPatchTable::MethodEntry>* methods = visitor.GetMethods();
+  std::sort(methods->begin(),
+            methods->end(),
+            [](const linker::LinkerPatchTable::MethodEntry& lhs,
+               const linker::LinkerPatchTable::MethodEntry& rhs) {
+              return (lhs.dex_file_index != rhs.dex_file_index)
+                  ? lhs.dex_file_index < rhs.dex_file_index
+                  : lhs.method_idx < rhs.method_idx;
+            });
+  linker::LinkerPatchTable::Encode(*dex_files_, *methods, &linker_patch_table_);
+
+  size_t aligned_offset = RoundUp(offset, sizeof(uint32_t));
+  size_linker_patch_table_alignment_ = aligned_offset - offset;
+  oat_header_->SetLinkerPatchesOffset(aligned_offset);
+  return aligned_offset + linker_patch_table_.size();
+}
+
 size_t OatWriter::InitOatCode(size_t offset) {
   // calculate the offsets within OatHeader to executable code
   size_t old_offset = offset;
@@ -1475,7 +1702,26 @@ size_t OatWriter::InitOatCodeDexFiles(size_t offset) {
       offset = visitor.GetOffset();                   \
     } while (false)
 
-  VISIT(InitCodeMethodVisitor);
+  {
+    // Collect the compiled methods in the order their code is laid out.
+    LayoutCodeMethodVisitor layout_visitor(this, offset);
+    bool success = VisitDexMethods(&layout_visitor);
+    DCHECK(success);
+  }
+  {
+    size_t old_method_info_size = method_info_.size();
+    InitCodeMethodVisitor visitor(this, offset);
+    bool success = visitor.Visit();
+    DCHECK(success);
+    offset = visitor.GetOffset();
+    // Keep the debug info in code order, so that the compilation units, which group
+    // consecutive methods from the same source file, do not overlap.
+    std::stable_sort(method_info_.begin() + old_method_info_size,
+                     method_info_.end(),
+                     [](const debug::MethodDebugInfo& lhs, const debug::MethodDebugInfo& rhs) {
+                       return lhs.code_address < rhs.code_address;
+                     });
+  }
   if (HasImage()) {
     VISIT(InitImageMethodVisitor);
   }
@@ -1515,6 +1761,12 @@ bool OatWriter::WriteRodata(OutputStream* out) {
     return false;
   }
 
+  relative_offset = WriteLinkerPatches(out, file_offset, relative_offset);
+  if (relative_offset == 0) {
+    LOG(ERROR) << "Failed to write linker patches to " << out->GetLocation();
+    return false;
+  }
+
   // Write padding.
   off_t new_offset = out->Seek(size_executable_offset_alignment_, kSeekCurrent);
   relative_offset += size_executable_offset_alignment_;
@@ -1587,6 +1839,8 @@ bool OatWriter::WriteCode(OutputStream* out) {
     DO_STAT(size_relative_call_thunks_);
     DO_STAT(size_misc_thunks_);
     DO_STAT(size_vmap_table_);
+    DO_STAT(size_linker_patch_table_alignment_);
+    DO_STAT(size_linker_patch_table_);
     DO_STAT(size_oat_dex_file_location_size_);
     DO_STAT(size_oat_dex_file_location_data_);
     DO_STAT(size_oat_dex_file_location_checksum_);
@@ -1595,6 +1849,9 @@ bool OatWriter::WriteCode(OutputStream* out) {
     DO_STAT(size_oat_dex_file_lookup_table_offset_);
     DO_STAT(size_oat_lookup_table_alignment_);
     DO_STAT(size_oat_lookup_table_);
+    DO_STAT(size_oat_dex_file_id_lookup_table_offset_);
+    DO_STAT(size_oat_id_lookup_table_alignment_);
+    DO_STAT(size_oat_id_lookup_table_);
     DO_STAT(size_oat_class_offsets_alignment_);
     DO_STAT(size_oat_class_offsets_);
     DO_STAT(size_oat_class_type_);
@@ -1712,6 +1969,31 @@ size_t OatWriter::WriteMaps(OutputStream* out, const size_t file_offset, size_t
   return relative_offset;
 }
 
+size_t OatWriter::WriteLinkerPatches(OutputStream* out,
+                                     const size_t file_offset,
+                                     size_t relative_offset) {
+  if (oat_header_->GetLinkerPatchesOffset() == 0u) {
+    return relative_offset;
+  }
+  off_t new_offset = out->Seek(size_linker_patch_table_alignment_, kSeekCurrent);
+  relative_offset += size_linker_patch_table_alignment_;
+  DCHECK_EQ(relative_offset, oat_header_->GetLinkerPatchesOffset());
+  if (static_cast<size_t>(new_offset) != file_offset + relative_offset) {
+    PLOG(ERROR) << "Failed to seek to linker patches. Actual: " << new_offset
+                << " Expected: " << file_offset + relative_offset
+                << " File: " << out->GetLocation();
+    return 0;
+  }
+  if (!out->WriteFully(linker_patch_table_.data(), linker_patch_table_.size())) {
+    PLOG(ERROR) << "Failed to write linker patches to " << out->GetLocation();
+    return 0;
+  }
+  size_linker_patch_table_ = linker_patch_table_.size();
+  relative_offset += linker_patch_table_.size();
+  DCHECK_OFFSET();
+  return relative_offset;
+}
+
 size_t OatWriter::WriteCode(OutputStream* out, const size_t file_offset, size_t relative_offset) {
   if (compiler_driver_->IsBootImage()) {
     InstructionSet instruction_set = compiler_driver_->GetInstructionSet();
@@ -1744,18 +2026,13 @@ size_t OatWriter::WriteCode(OutputStream* out, const size_t file_offset, size_t
 size_t OatWriter::WriteCodeDexFiles(OutputStream* out,
                                     const size_t file_offset,
                                     size_t relative_offset) {
-  #define VISIT(VisitorType)                                              \
-    do {                                                                  \
-      VisitorType visitor(this, out, file_offset, relative_offset);       \
-      if (UNLIKELY(!VisitDexMethods(&visitor))) {                         \
-        return 0;                                                         \
-      }                                                                   \
-      relative_offset = visitor.GetOffset();                              \
-    } while (false)
-
-  VISIT(WriteCodeMethodVisitor);
-
-  #undef VISIT
+  {
+    WriteCodeMethodVisitor visitor(this, out, file_offset, relative_offset);
+    if (UNLIKELY(!visitor.Visit())) {
+      return 0;
+    }
+    relative_offset = visitor.GetOffset();
+  }
 
   size_code_alignment_ += relative_patcher_->CodeAlignmentSize();
   size_relative_call_thunks_ += relative_patcher_->RelativeCallThunksSize();
@@ -1791,6 +2068,8 @@ bool OatWriter::ReadDexFileHeader(File* file, OatDexFile* oat_dex_file) {
   oat_dex_file->dex_file_size_ = header->file_size_;
   oat_dex_file->dex_file_location_checksum_ = header->checksum_;
   oat_dex_file->class_offsets_.resize(header->class_defs_size_);
+  oat_dex_file->num_string_ids_ = header->string_ids_size_;
+  oat_dex_file->num_method_ids_ = header->method_ids_size_;
   return true;
 }
 
@@ -1841,7 +2120,11 @@ bool OatWriter::WriteDexFile(OutputStream* rodata, File* file, OatDexFile* oat_d
   if (!SeekToDexFile(rodata, file, oat_dex_file)) {
     return false;
   }
-  if (oat_dex_file->source_.IsZipEntry()) {
+  if (profile_compilation_info_ != nullptr) {
+    if (!LayoutAndWriteDexFile(rodata, oat_dex_file)) {
+      return false;
+    }
+  } else if (oat_dex_file->source_.IsZipEntry()) {
     if (!WriteDexFile(rodata, file, oat_dex_file, oat_dex_file->source_.GetZipEntry())) {
       return false;
     }
@@ -2067,6 +2350,77 @@ bool OatWriter::WriteDexFile(OutputStream* rodata,
   // Note: For raw data, the checksum is passed directly to AddRawDexFileSource().
   oat_dex_file->dex_file_size_ = header->file_size_;
   oat_dex_file->class_offsets_.resize(header->class_defs_size_);
+  oat_dex_file->num_string_ids_ = header->string_ids_size_;
+  oat_dex_file->num_method_ids_ = header->method_ids_size_;
+  return true;
+}
+
+bool OatWriter::LayoutAndWriteDexFile(OutputStream* rodata, OatDexFile* oat_dex_file) {
+  TimingLogger::ScopedTiming split("Dex Layout", timings_);
+  std::string error_msg;
+  std::string location(oat_dex_file->GetLocation());
+  std::unique_ptr<MemMap> mem_map;
+  std::vector<uint8_t> raw_dex_file;
+  const uint8_t* dex_file_begin;
+  size_t dex_file_size;
+  uint32_t location_checksum;
+  if (oat_dex_file->source_.IsZipEntry()) {
+    ZipEntry* zip_entry = oat_dex_file->source_.GetZipEntry();
+    mem_map.reset(zip_entry->ExtractToMemMap(location.c_str(), "classes.dex", &error_msg));
+    if (mem_map == nullptr) {
+      LOG(ERROR) << "Failed to extract dex file from ZIP entry: " << error_msg
+                 << " File: " << location;
+      return false;
+    }
+    dex_file_begin = mem_map->Begin();
+    dex_file_size = mem_map->Size();
+    location_checksum = zip_entry->GetCrc32();
+  } else if (oat_dex_file->source_.IsRawFile()) {
+    File* dex_file = oat_dex_file->source_.GetRawFile();
+    int64_t length = dex_file->GetLength();
+    if (length < static_cast<int64_t>(sizeof(DexFile::Header))) {
+      PLOG(ERROR) << "Failed to get the length of dex file. Length: " << length
+                  << " File: " << location;
+      return false;
+    }
+    raw_dex_file.resize(length);
+    if (!dex_file->PreadFully(raw_dex_file.data(), length, 0)) {
+      PLOG(ERROR) << "Failed to read dex file. File: " << location;
+      return false;
+    }
+    dex_file_begin = raw_dex_file.data();
+    dex_file_size = length;
+    location_checksum = AsUnalignedDexFileHeader(dex_file_begin)->checksum_;
+  } else {
+    DCHECK(oat_dex_file->source_.IsRawData());
+    dex_file_begin = oat_dex_file->source_.GetRawData();
+    dex_file_size = AsUnalignedDexFileHeader(dex_file_begin)->file_size_;
+    location_checksum = oat_dex_file->dex_file_location_checksum_;
+  }
+
+  std::unique_ptr<const DexFile> dex_file = DexFile::Open(dex_file_begin,
+                                                          dex_file_size,
+                                                          location,
+                                                          location_checksum,
+                                                          /* oat_dex_file */ nullptr,
+                                                          /* verify */ true,
+                                                          &error_msg);
+  if (dex_file == nullptr) {
+    LOG(ERROR) << "Failed to open dex file for layout: " << error_msg;
+    return false;
+  }
+  std::vector<uint8_t> laid_out_dex_file;
+  if (DexLayout::Layout(*dex_file, *profile_compilation_info_, &laid_out_dex_file, &error_msg)) {
+    dex_file_begin = laid_out_dex_file.data();
+  } else {
+    // Not fatal, fall back to the original layout.
+    LOG(WARNING) << "Failed to lay out dex file " << location << ": " << error_msg;
+  }
+  if (!WriteDexFile(rodata, oat_dex_file, dex_file_begin)) {
+    return false;
+  }
+  // The location checksum identifies the original dex file, not the laid out one.
+  oat_dex_file->dex_file_location_checksum_ = location_checksum;
   return true;
 }
 
@@ -2216,6 +2570,14 @@ bool OatWriter::WriteTypeLookupTables(
       uint8_t* lookup_table = opened_dex_files_map->Begin() + (lookup_table_offset - map_offset);
       opened_dex_files[i]->CreateTypeLookupTable(lookup_table);
     }
+    if (oat_dex_file->id_lookup_table_offset_ != 0u) {
+      DCHECK(oat_dex_file->create_type_lookup_table_ == CreateTypeLookupTable::kCreate);
+      size_t map_offset = oat_dex_files_[0].dex_file_offset_;
+      size_t id_lookup_table_offset = oat_dex_file->id_lookup_table_offset_;
+      uint8_t* id_lookup_table =
+          opened_dex_files_map->Begin() + (id_lookup_table_offset - map_offset);
+      opened_dex_files[i]->CreateIdLookupTable(id_lookup_table);
+    }
   }
 
   DCHECK_EQ(opened_dex_files_map == nullptr, opened_dex_files.empty());
@@ -2264,6 +2626,9 @@ OatWriter::OatDexFile::OatDexFile(const char* dex_file_location,
       dex_file_offset_(0u),
       class_offsets_offset_(0u),
       lookup_table_offset_(0u),
+      id_lookup_table_offset_(0u),
+      num_string_ids_(0u),
+      num_method_ids_(0u),
       class_offsets_() {
 }
 
@@ -2273,7 +2638,8 @@ size_t OatWriter::OatDexFile::SizeOf() const {
           + sizeof(dex_file_location_checksum_)
           + sizeof(dex_file_offset_)
           + sizeof(class_offsets_offset_)
-          + sizeof(lookup_table_offset_);
+          + sizeof(lookup_table_offset_)
+          + sizeof(id_lookup_table_offset_);
 }
 
 void OatWriter::OatDexFile::ReserveTypeLookupTable(OatWriter* oat_writer) {
@@ -2292,6 +2658,22 @@ void OatWriter::OatDexFile::ReserveTypeLookupTable(OatWriter* oat_writer) {
   }
 }
 
+void OatWriter::OatDexFile::ReserveIdLookupTable(OatWriter* oat_writer) {
+  DCHECK_EQ(id_lookup_table_offset_, 0u);
+  if (create_type_lookup_table_ == CreateTypeLookupTable::kCreate) {
+    size_t table_size = IdLookupTable::RawDataLength(num_string_ids_, num_method_ids_);
+    if (table_size != 0u) {
+      // Id tables are required to be 4 byte aligned.
+      size_t original_offset = oat_writer->size_;
+      size_t offset = RoundUp(original_offset, 4);
+      oat_writer->size_oat_id_lookup_table_alignment_ += offset - original_offset;
+      id_lookup_table_offset_ = offset;
+      oat_writer->size_ = offset + table_size;
+      oat_writer->size_oat_id_lookup_table_ += table_size;
+    }
+  }
+}
+
 void OatWriter::OatDexFile::ReserveClassOffsets(OatWriter* oat_writer) {
   DCHECK_EQ(class_offsets_offset_, 0u);
   if (!class_offsets_.empty()) {
@@ -2344,6 +2726,12 @@ bool OatWriter::OatDexFile::Write(OatWriter* oat_writer, OutputStream* out) cons
   }
   oat_writer->size_oat_dex_file_lookup_table_offset_ += sizeof(lookup_table_offset_);
 
+  if (!out->WriteFully(&id_lookup_table_offset_, sizeof(id_lookup_table_offset_))) {
+    PLOG(ERROR) << "Failed to write id lookup table offset to " << out->GetLocation();
+    return false;
+  }
+  oat_writer->size_oat_dex_file_id_lookup_table_offset_ += sizeof(id_lookup_table_offset_);
+
   return true;
 }
 
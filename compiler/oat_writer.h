@@ -39,6 +39,7 @@ class CompiledMethod;
 class CompilerDriver;
 class ImageWriter;
 class OutputStream;
+class ProfileCompilationInfo;
 class TimingLogger;
 class TypeLookupTable;
 class ZipEntry;
@@ -111,7 +112,10 @@ class OatWriter {
     kDefault = kCreate
   };
 
-  OatWriter(bool compiling_boot_image, TimingLogger* timings);
+  // If a profile is given, the dex files are laid out according to it, see DexLayout.
+  OatWriter(bool compiling_boot_image,
+            TimingLogger* timings,
+            const ProfileCompilationInfo* profile_compilation_info = nullptr);
 
   // To produce a valid oat file, the user must first add sources with any combination of
   //   - AddDexFileSource(),
@@ -229,10 +233,18 @@ class OatWriter {
   class InitOatClassesMethodVisitor;
   class InitCodeMethodVisitor;
   class InitMapMethodVisitor;
+  class InitLinkerPatchesMethodVisitor;
   class InitImageMethodVisitor;
   class WriteCodeMethodVisitor;
   class WriteMapMethodVisitor;
 
+  // The code is laid out by LayoutCodeMethodVisitor, in the definition order or, with a
+  // profile, hot methods first. The visitors for the code itself then iterate over the
+  // compiled methods in that order.
+  struct OrderedMethodData;
+  class OrderedMethodVisitor;
+  class LayoutCodeMethodVisitor;
+
   // Visit all the methods in all the compiled dex files in their definition order
   // with a given DexMethodVisitor.
   bool VisitDexMethods(DexMethodVisitor* visitor);
@@ -244,12 +256,14 @@ class OatWriter {
   size_t InitOatDexFiles(size_t offset);
   size_t InitOatClasses(size_t offset);
   size_t InitOatMaps(size_t offset);
+  size_t InitOatLinkerPatches(size_t offset);
   size_t InitOatCode(size_t offset);
   size_t InitOatCodeDexFiles(size_t offset);
 
   bool WriteClassOffsets(OutputStream* out);
   bool WriteClasses(OutputStream* out);
   size_t WriteMaps(OutputStream* out, const size_t file_offset, size_t relative_offset);
+  size_t WriteLinkerPatches(OutputStream* out, const size_t file_offset, size_t relative_offset);
   size_t WriteCode(OutputStream* out, const size_t file_offset, size_t relative_offset);
   size_t WriteCodeDexFiles(OutputStream* out, const size_t file_offset, size_t relative_offset);
 
@@ -262,6 +276,7 @@ class OatWriter {
   bool WriteDexFile(OutputStream* rodata, File* file, OatDexFile* oat_dex_file, ZipEntry* dex_file);
   bool WriteDexFile(OutputStream* rodata, File* file, OatDexFile* oat_dex_file, File* dex_file);
   bool WriteDexFile(OutputStream* rodata, OatDexFile* oat_dex_file, const uint8_t* dex_file);
+  bool LayoutAndWriteDexFile(OutputStream* rodata, OatDexFile* oat_dex_file);
   bool WriteOatDexFiles(OutputStream* rodata);
   bool ExtendForTypeLookupTables(OutputStream* rodata, File* file, size_t offset);
   bool OpenDexFiles(File* file,
@@ -298,6 +313,7 @@ class OatWriter {
   const CompilerDriver* compiler_driver_;
   ImageWriter* image_writer_;
   const bool compiling_boot_image_;
+  const ProfileCompilationInfo* const profile_compilation_info_;
 
   // note OatFile does not take ownership of the DexFiles
   const std::vector<const DexFile*>* dex_files_;
@@ -315,10 +331,15 @@ class OatWriter {
   // Offset of the oat data from the start of the mmapped region of the elf file.
   size_t oat_data_offset_;
 
+  // The encoded linker patch table, if the linker patches are recorded.
+  std::vector<uint8_t> linker_patch_table_;
+
   // data to write
   std::unique_ptr<OatHeader> oat_header_;
   dchecked_vector<OatDexFile> oat_dex_files_;
   dchecked_vector<OatClass> oat_classes_;
+  // The compiled methods in code layout order.
+  dchecked_vector<OrderedMethodData> ordered_methods_;
   std::unique_ptr<const std::vector<uint8_t>> jni_dlsym_lookup_;
   std::unique_ptr<const std::vector<uint8_t>> quick_generic_jni_trampoline_;
   std::unique_ptr<const std::vector<uint8_t>> quick_imt_conflict_trampoline_;
@@ -345,6 +366,8 @@ class OatWriter {
   uint32_t size_relative_call_thunks_;
   uint32_t size_misc_thunks_;
   uint32_t size_vmap_table_;
+  uint32_t size_linker_patch_table_alignment_;
+  uint32_t size_linker_patch_table_;
   uint32_t size_oat_dex_file_location_size_;
   uint32_t size_oat_dex_file_location_data_;
   uint32_t size_oat_dex_file_location_checksum_;
@@ -353,6 +376,9 @@ class OatWriter {
   uint32_t size_oat_dex_file_lookup_table_offset_;
   uint32_t size_oat_lookup_table_alignment_;
   uint32_t size_oat_lookup_table_;
+  uint32_t size_oat_dex_file_id_lookup_table_offset_;
+  uint32_t size_oat_id_lookup_table_alignment_;
+  uint32_t size_oat_id_lookup_table_;
   uint32_t size_oat_class_offsets_alignment_;
   uint32_t size_oat_class_offsets_;
   uint32_t size_oat_class_type_;
@@ -48,6 +48,7 @@
 #include "intrinsics.h"
 #include "leb128.h"
 #include "mirror/array-inl.h"
+#include "mirror/dex_cache.h"
 #include "mirror/object_array-inl.h"
 #include "mirror/object_reference.h"
 #include "mirror/string.h"
@@ -135,6 +136,24 @@ size_t CodeGenerator::GetCacheOffset(uint32_t index) {
   return sizeof(GcRoot<mirror::Object>) * index;
 }
 
+bool CodeGenerator::UsesHashedStringCache(HLoadString* load) {
+  return mirror::DexCache::UseHashedStrings(load->GetDexFile().NumStringIds());
+}
+
+size_t CodeGenerator::GetStringCacheOffset(uint32_t string_index) {
+  return GetCacheOffset(mirror::DexCache::StringSlot(string_index));
+}
+
+size_t CodeGenerator::GetStringCacheTagOffset(uint32_t string_index) {
+  // The tags follow the GC roots, see mirror::DexCache::GetStringTags().
+  return GetCacheOffset(mirror::DexCache::kDexCacheStringCacheSize) +
+      sizeof(uint32_t) * mirror::DexCache::StringSlot(string_index);
+}
+
+uint32_t CodeGenerator::GetStringCacheTag(uint32_t string_index) {
+  return mirror::DexCache::StringTag(string_index);
+}
+
 size_t CodeGenerator::GetCachePointerOffset(uint32_t index) {
   auto pointer_size = InstructionSetPointerSize(GetInstructionSet());
   return pointer_size * index;
@@ -342,6 +342,14 @@ class CodeGenerator : public DeletableArenaObject<kArenaAllocCodeGenerator> {
   // Pointer variant for ArtMethod and ArtField arrays.
   size_t GetCachePointerOffset(uint32_t index);
 
+  // Helpers for hashed dex cache strings arrays, see mirror::DexCache::kDexCacheStringCacheSize.
+  // Compiled code checks the slot tag both before and after loading the string root, like
+  // mirror::DexCache::GetResolvedString(), and takes the slow path if another string owns it.
+  static bool UsesHashedStringCache(HLoadString* load);
+  static size_t GetStringCacheOffset(uint32_t string_index);
+  static size_t GetStringCacheTagOffset(uint32_t string_index);
+  static uint32_t GetStringCacheTag(uint32_t string_index);
+
   // Helper that returns the offset of the array's length field.
   // Note: Besides the normal arrays, we also use the HArrayLength for
   // accessing the String's `count` field in String intrinsics.
@@ -5281,12 +5281,43 @@ void LocationsBuilderARM::VisitLoadString(HLoadString* load) {
     locations->SetInAt(0, Location::RequiresRegister());
   }
   locations->SetOut(Location::RequiresRegister());
+  if (load_kind == HLoadString::LoadKind::kDexCacheViaMethod &&
+      CodeGenerator::UsesHashedStringCache(load)) {
+    // Temporary registers for the strings array and the slot tag. Note that LoadFromOffset()
+    // may need IP for the tag offset.
+    locations->AddTemp(Location::RequiresRegister());
+    locations->AddTemp(Location::RequiresRegister());
+  }
+}
+
+void InstructionCodeGeneratorARM::GenerateHashedStringCacheLoad(HLoadString* load,
+                                                                Register strings,
+                                                                SlowPathCode* slow_path) {
+  LocationSummary* locations = load->GetLocations();
+  Register tag = locations->GetTemp(1).AsRegister<Register>();
+  uint32_t string_index = load->GetStringIndex();
+  int32_t tag_offset = CodeGenerator::GetStringCacheTagOffset(string_index);
+  uint32_t expected_tag = CodeGenerator::GetStringCacheTag(string_index);
+  // The slot may be owned by another string; check its tag.
+  __ LoadFromOffset(kLoadWord, tag, strings, tag_offset);
+  __ CmpConstant(tag, expected_tag);
+  __ b(slow_path->GetEntryLabel(), NE);
+  codegen_->GenerateMemoryBarrier(MemBarrierKind::kLoadAny);
+  // /* GcRoot<mirror::String> */ out = strings[StringSlot(string_index)]
+  GenerateGcRootFieldLoad(
+      load, locations->Out(), strings, CodeGenerator::GetStringCacheOffset(string_index));
+  // Check that the slot was not taken over while the root was being loaded.
+  codegen_->GenerateMemoryBarrier(MemBarrierKind::kLoadAny);
+  __ LoadFromOffset(kLoadWord, tag, strings, tag_offset);
+  __ CmpConstant(tag, expected_tag);
+  __ b(slow_path->GetEntryLabel(), NE);
 }
 
 void InstructionCodeGeneratorARM::VisitLoadString(HLoadString* load) {
   LocationSummary* locations = load->GetLocations();
   Location out_loc = locations->Out();
   Register out = out_loc.AsRegister<Register>();
+  SlowPathCode* slow_path = nullptr;
 
   switch (load->GetLoadKind()) {
     case HLoadString::LoadKind::kBootImageLinkTimeAddress: {
@@ -5343,6 +5374,18 @@ void InstructionCodeGeneratorARM::VisitLoadString(HLoadString* load) {
       // /* GcRoot<mirror::Class> */ out = current_method->declaring_class_
       GenerateGcRootFieldLoad(
           load, out_loc, current_method, ArtMethod::DeclaringClassOffset().Int32Value());
+      if (CodeGenerator::UsesHashedStringCache(load)) {
+        // Slots of hashed dex cache strings arrays can change owner.
+        DCHECK(!load->IsInDexCache());
+        Register strings = locations->GetTemp(0).AsRegister<Register>();
+        slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathARM(load);
+        codegen_->AddSlowPath(slow_path);
+        // /* GcRoot<mirror::String>[] */ strings = out->dex_cache_strings_
+        __ LoadFromOffset(
+            kLoadWord, strings, out, mirror::Class::DexCacheStringsOffset().Int32Value());
+        GenerateHashedStringCacheLoad(load, strings, slow_path);
+        break;
+      }
       // /* GcRoot<mirror::String>[] */ out = out->dex_cache_strings_
       __ LoadFromOffset(kLoadWord, out, out, mirror::Class::DexCacheStringsOffset().Int32Value());
       // /* GcRoot<mirror::String> */ out = out[string_index]
@@ -5356,8 +5399,10 @@ void InstructionCodeGeneratorARM::VisitLoadString(HLoadString* load) {
   }
 
   if (!load->IsInDexCache()) {
-    SlowPathCode* slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathARM(load);
-    codegen_->AddSlowPath(slow_path);
+    if (slow_path == nullptr) {
+      slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathARM(load);
+      codegen_->AddSlowPath(slow_path);
+    }
     __ CompareAndBranchIfZero(out, slow_path->GetEntryLabel());
     __ Bind(slow_path->GetExitLabel());
   }
@@ -275,6 +275,9 @@ class InstructionCodeGeneratorARM : public InstructionCodeGenerator {
                                Location root,
                                Register obj,
                                uint32_t offset);
+  // Load the string of `load` from the hashed dex cache strings array `strings` into the output
+  // of `load`, branching to `slow_path` if the slot is owned by another string.
+  void GenerateHashedStringCacheLoad(HLoadString* load, Register strings, SlowPathCode* slow_path);
   void GenerateTestAndBranch(HInstruction* instruction,
                              size_t condition_input_index,
                              Label* true_target,
@@ -4039,13 +4039,46 @@ void LocationsBuilderARM64::VisitLoadString(HLoadString* load) {
   LocationSummary* locations = new (GetGraph()->GetArena()) LocationSummary(load, call_kind);
   if (load->GetLoadKind() == HLoadString::LoadKind::kDexCacheViaMethod) {
     locations->SetInAt(0, Location::RequiresRegister());
+    if (CodeGenerator::UsesHashedStringCache(load)) {
+      // Temporary register for the strings array.
+      locations->AddTemp(Location::RequiresRegister());
+    }
   }
   locations->SetOut(Location::RequiresRegister());
 }
 
+void InstructionCodeGeneratorARM64::GenerateStringCacheTagCheck(HLoadString* load,
+                                                                Register strings,
+                                                                SlowPathCodeARM64* slow_path) {
+  MacroAssembler* masm = GetVIXLAssembler();
+  UseScratchRegisterScope temps(masm);
+  Register tag = temps.AcquireW();
+  uint32_t string_index = load->GetStringIndex();
+  __ Ldr(tag, MemOperand(strings, CodeGenerator::GetStringCacheTagOffset(string_index)));
+  __ Cmp(tag, Operand(CodeGenerator::GetStringCacheTag(string_index)));
+  __ B(ne, slow_path->GetEntryLabel());
+}
+
+void InstructionCodeGeneratorARM64::GenerateHashedStringCacheLoad(HLoadString* load,
+                                                                  Register strings,
+                                                                  SlowPathCodeARM64* slow_path) {
+  // The slot may be owned by another string; check its tag.
+  GenerateStringCacheTagCheck(load, strings, slow_path);
+  codegen_->GenerateMemoryBarrier(MemBarrierKind::kLoadAny);
+  // /* GcRoot<mirror::String> */ out = strings[StringSlot(string_index)]
+  GenerateGcRootFieldLoad(load,
+                          load->GetLocations()->Out(),
+                          strings,
+                          CodeGenerator::GetStringCacheOffset(load->GetStringIndex()));
+  // Check that the slot was not taken over while the root was being loaded.
+  codegen_->GenerateMemoryBarrier(MemBarrierKind::kLoadAny);
+  GenerateStringCacheTagCheck(load, strings, slow_path);
+}
+
 void InstructionCodeGeneratorARM64::VisitLoadString(HLoadString* load) {
   Location out_loc = load->GetLocations()->Out();
   Register out = OutputRegister(load);
+  SlowPathCodeARM64* slow_path = nullptr;
 
   switch (load->GetLoadKind()) {
     case HLoadString::LoadKind::kBootImageLinkTimeAddress:
@@ -4116,6 +4149,17 @@ void InstructionCodeGeneratorARM64::VisitLoadString(HLoadString* load) {
       // /* GcRoot<mirror::Class> */ out = current_method->declaring_class_
       GenerateGcRootFieldLoad(
           load, out_loc, current_method, ArtMethod::DeclaringClassOffset().Int32Value());
+      if (CodeGenerator::UsesHashedStringCache(load)) {
+        // Slots of hashed dex cache strings arrays can change owner.
+        DCHECK(!load->IsInDexCache());
+        Register strings = XRegisterFrom(load->GetLocations()->GetTemp(0));
+        slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathARM64(load);
+        codegen_->AddSlowPath(slow_path);
+        // /* GcRoot<mirror::String>[] */ strings = out->dex_cache_strings_
+        __ Ldr(strings, HeapOperand(out, mirror::Class::DexCacheStringsOffset().Uint32Value()));
+        GenerateHashedStringCacheLoad(load, strings, slow_path);
+        break;
+      }
       // /* GcRoot<mirror::String>[] */ out = out->dex_cache_strings_
       __ Ldr(out.X(), HeapOperand(out, mirror::Class::DexCacheStringsOffset().Uint32Value()));
       // /* GcRoot<mirror::String> */ out = out[string_index]
@@ -4129,8 +4173,10 @@ void InstructionCodeGeneratorARM64::VisitLoadString(HLoadString* load) {
   }
 
   if (!load->IsInDexCache()) {
-    SlowPathCodeARM64* slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathARM64(load);
-    codegen_->AddSlowPath(slow_path);
+    if (slow_path == nullptr) {
+      slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathARM64(load);
+      codegen_->AddSlowPath(slow_path);
+    }
     __ Cbz(out, slow_path->GetEntryLabel());
     __ Bind(slow_path->GetExitLabel());
   }
@@ -258,6 +258,14 @@ class InstructionCodeGeneratorARM64 : public InstructionCodeGenerator {
                                vixl::Register obj,
                                uint32_t offset,
                                vixl::Label* fixup_label = nullptr);
+  // Load the string of `load` from the hashed dex cache strings array `strings` into the output
+  // of `load`, branching to `slow_path` if the slot is owned by another string.
+  void GenerateHashedStringCacheLoad(HLoadString* load,
+                                     vixl::Register strings,
+                                     SlowPathCodeARM64* slow_path);
+  void GenerateStringCacheTagCheck(HLoadString* load,
+                                   vixl::Register strings,
+                                   SlowPathCodeARM64* slow_path);
 
   // Generate a floating-point comparison.
   void GenerateFcmp(HInstruction* instruction);
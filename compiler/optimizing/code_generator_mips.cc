@@ -4048,19 +4048,47 @@ void LocationsBuilderMIPS::VisitLoadString(HLoadString* load) {
   LocationSummary* locations = new (GetGraph()->GetArena()) LocationSummary(load, call_kind);
   locations->SetInAt(0, Location::RequiresRegister());
   locations->SetOut(Location::RequiresRegister());
+  if (CodeGenerator::UsesHashedStringCache(load)) {
+    // Temporary register for the strings array.
+    locations->AddTemp(Location::RequiresRegister());
+  }
 }
 
 void InstructionCodeGeneratorMIPS::VisitLoadString(HLoadString* load) {
   LocationSummary* locations = load->GetLocations();
   Register out = locations->Out().AsRegister<Register>();
   Register current_method = locations->InAt(0).AsRegister<Register>();
+  SlowPathCodeMIPS* slow_path = nullptr;
   __ LoadFromOffset(kLoadWord, out, current_method, ArtMethod::DeclaringClassOffset().Int32Value());
-  __ LoadFromOffset(kLoadWord, out, out, mirror::Class::DexCacheStringsOffset().Int32Value());
-  __ LoadFromOffset(kLoadWord, out, out, CodeGenerator::GetCacheOffset(load->GetStringIndex()));
+  if (CodeGenerator::UsesHashedStringCache(load)) {
+    // Slots of hashed dex cache strings arrays can change owner. Check the tag of the slot
+    // before and after loading the root, see mirror::DexCache::GetResolvedString().
+    DCHECK(!load->IsInDexCache());
+    uint32_t string_index = load->GetStringIndex();
+    int32_t tag_offset = CodeGenerator::GetStringCacheTagOffset(string_index);
+    Register strings = locations->GetTemp(0).AsRegister<Register>();
+    slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathMIPS(load);
+    codegen_->AddSlowPath(slow_path);
+    __ LoadFromOffset(kLoadWord, strings, out, mirror::Class::DexCacheStringsOffset().Int32Value());
+    __ LoadConst32(AT, CodeGenerator::GetStringCacheTag(string_index));
+    __ LoadFromOffset(kLoadWord, TMP, strings, tag_offset);
+    __ Bne(TMP, AT, slow_path->GetEntryLabel());
+    GenerateMemoryBarrier(MemBarrierKind::kLoadAny);
+    __ LoadFromOffset(
+        kLoadWord, out, strings, CodeGenerator::GetStringCacheOffset(string_index));
+    GenerateMemoryBarrier(MemBarrierKind::kLoadAny);
+    __ LoadFromOffset(kLoadWord, TMP, strings, tag_offset);
+    __ Bne(TMP, AT, slow_path->GetEntryLabel());
+  } else {
+    __ LoadFromOffset(kLoadWord, out, out, mirror::Class::DexCacheStringsOffset().Int32Value());
+    __ LoadFromOffset(kLoadWord, out, out, CodeGenerator::GetCacheOffset(load->GetStringIndex()));
+  }
 
   if (!load->IsInDexCache()) {
-    SlowPathCodeMIPS* slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathMIPS(load);
-    codegen_->AddSlowPath(slow_path);
+    if (slow_path == nullptr) {
+      slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathMIPS(load);
+      codegen_->AddSlowPath(slow_path);
+    }
     __ Beqz(out, slow_path->GetEntryLabel());
     __ Bind(slow_path->GetExitLabel());
   }
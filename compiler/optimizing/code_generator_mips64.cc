@@ -3267,22 +3267,52 @@ void LocationsBuilderMIPS64::VisitLoadString(HLoadString* load) {
   LocationSummary* locations = new (GetGraph()->GetArena()) LocationSummary(load, call_kind);
   locations->SetInAt(0, Location::RequiresRegister());
   locations->SetOut(Location::RequiresRegister());
+  if (CodeGenerator::UsesHashedStringCache(load)) {
+    // Temporary register for the strings array.
+    locations->AddTemp(Location::RequiresRegister());
+  }
 }
 
 void InstructionCodeGeneratorMIPS64::VisitLoadString(HLoadString* load) {
   LocationSummary* locations = load->GetLocations();
   GpuRegister out = locations->Out().AsRegister<GpuRegister>();
   GpuRegister current_method = locations->InAt(0).AsRegister<GpuRegister>();
+  SlowPathCodeMIPS64* slow_path = nullptr;
   __ LoadFromOffset(kLoadUnsignedWord, out, current_method,
                     ArtMethod::DeclaringClassOffset().Int32Value());
-  __ LoadFromOffset(kLoadDoubleword, out, out, mirror::Class::DexCacheStringsOffset().Int32Value());
-  __ LoadFromOffset(
-      kLoadUnsignedWord, out, out, CodeGenerator::GetCacheOffset(load->GetStringIndex()));
+  if (CodeGenerator::UsesHashedStringCache(load)) {
+    // Slots of hashed dex cache strings arrays can change owner. Check the tag of the slot
+    // before and after loading the root, see mirror::DexCache::GetResolvedString().
+    DCHECK(!load->IsInDexCache());
+    uint32_t string_index = load->GetStringIndex();
+    int32_t tag_offset = CodeGenerator::GetStringCacheTagOffset(string_index);
+    GpuRegister strings = locations->GetTemp(0).AsRegister<GpuRegister>();
+    slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathMIPS64(load);
+    codegen_->AddSlowPath(slow_path);
+    __ LoadFromOffset(
+        kLoadDoubleword, strings, out, mirror::Class::DexCacheStringsOffset().Int32Value());
+    __ LoadConst32(AT, CodeGenerator::GetStringCacheTag(string_index));
+    __ LoadFromOffset(kLoadUnsignedWord, TMP, strings, tag_offset);
+    __ Bnec(TMP, AT, slow_path->GetEntryLabel());
+    GenerateMemoryBarrier(MemBarrierKind::kLoadAny);
+    __ LoadFromOffset(
+        kLoadUnsignedWord, out, strings, CodeGenerator::GetStringCacheOffset(string_index));
+    GenerateMemoryBarrier(MemBarrierKind::kLoadAny);
+    __ LoadFromOffset(kLoadUnsignedWord, TMP, strings, tag_offset);
+    __ Bnec(TMP, AT, slow_path->GetEntryLabel());
+  } else {
+    __ LoadFromOffset(
+        kLoadDoubleword, out, out, mirror::Class::DexCacheStringsOffset().Int32Value());
+    __ LoadFromOffset(
+        kLoadUnsignedWord, out, out, CodeGenerator::GetCacheOffset(load->GetStringIndex()));
+  }
   // TODO: We will need a read barrier here.
 
   if (!load->IsInDexCache()) {
-    SlowPathCodeMIPS64* slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathMIPS64(load);
-    codegen_->AddSlowPath(slow_path);
+    if (slow_path == nullptr) {
+      slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathMIPS64(load);
+      codegen_->AddSlowPath(slow_path);
+    }
     __ Beqzc(out, slow_path->GetEntryLabel());
     __ Bind(slow_path->GetExitLabel());
   }
@@ -6025,12 +6025,18 @@ void LocationsBuilderX86::VisitLoadString(HLoadString* load) {
     locations->SetInAt(0, Location::RequiresRegister());
   }
   locations->SetOut(Location::RequiresRegister());
+  if (load->GetLoadKind() == HLoadString::LoadKind::kDexCacheViaMethod &&
+      CodeGenerator::UsesHashedStringCache(load)) {
+    // Temporary register for the strings array.
+    locations->AddTemp(Location::RequiresRegister());
+  }
 }
 
 void InstructionCodeGeneratorX86::VisitLoadString(HLoadString* load) {
   LocationSummary* locations = load->GetLocations();
   Location out_loc = locations->Out();
   Register out = out_loc.AsRegister<Register>();
+  SlowPathCode* slow_path = nullptr;
 
   switch (load->GetLoadKind()) {
     case HLoadString::LoadKind::kBootImageLinkTimeAddress: {
@@ -6074,6 +6080,28 @@ void InstructionCodeGeneratorX86::VisitLoadString(HLoadString* load) {
       // /* GcRoot<mirror::Class> */ out = current_method->declaring_class_
       GenerateGcRootFieldLoad(
           load, out_loc, Address(current_method, ArtMethod::DeclaringClassOffset().Int32Value()));
+      if (CodeGenerator::UsesHashedStringCache(load)) {
+        // Slots of hashed dex cache strings arrays can change owner. Check the tag of the slot
+        // before and after loading the root, see mirror::DexCache::GetResolvedString(). No
+        // barriers are needed as x86 does not reorder loads with other loads.
+        DCHECK(!load->IsInDexCache());
+        uint32_t string_index = load->GetStringIndex();
+        Register strings = locations->GetTemp(0).AsRegister<Register>();
+        Address tag_address(strings, CodeGenerator::GetStringCacheTagOffset(string_index));
+        Immediate expected_tag(CodeGenerator::GetStringCacheTag(string_index));
+        slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathX86(load);
+        codegen_->AddSlowPath(slow_path);
+        // /* GcRoot<mirror::String>[] */ strings = out->dex_cache_strings_
+        __ movl(strings, Address(out, mirror::Class::DexCacheStringsOffset().Int32Value()));
+        __ cmpl(tag_address, expected_tag);
+        __ j(kNotEqual, slow_path->GetEntryLabel());
+        // /* GcRoot<mirror::String> */ out = strings[StringSlot(string_index)]
+        GenerateGcRootFieldLoad(
+            load, out_loc, Address(strings, CodeGenerator::GetStringCacheOffset(string_index)));
+        __ cmpl(tag_address, expected_tag);
+        __ j(kNotEqual, slow_path->GetEntryLabel());
+        break;
+      }
 
       // /* GcRoot<mirror::String>[] */ out = out->dex_cache_strings_
       __ movl(out, Address(out, mirror::Class::DexCacheStringsOffset().Int32Value()));
@@ -6088,8 +6116,10 @@ void InstructionCodeGeneratorX86::VisitLoadString(HLoadString* load) {
   }
 
   if (!load->IsInDexCache()) {
-    SlowPathCode* slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathX86(load);
-    codegen_->AddSlowPath(slow_path);
+    if (slow_path == nullptr) {
+      slow_path = new (GetGraph()->GetArena()) LoadStringSlowPathX86(load);
+      codegen_->AddSlowPath(slow_path);
+    }
     __ testl(out, out);
     __ j(kEqual, slow_path->GetEntryLabel());
     __ Bind(slow_path->GetExitLabel());
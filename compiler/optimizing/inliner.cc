@@ -23,6 +23,7 @@
 #include "dead_code_elimination.h"
 #include "dex/verified_method.h"
 #include "dex/verification_results.h"
+#include "imtable.h"
 #include "driver/compiler_driver-inl.h"
 #include "driver/compiler_options.h"
 #include "driver/dex_compilation_unit.h"
@@ -476,6 +477,7 @@ bool HInliner::TryInlinePolymorphicCall(HInvoke* invoke_instruction,
 
   bool all_targets_inlined = true;
   bool one_target_inlined = false;
+  bool one_target_dispatched = false;
   for (size_t i = 0; i < InlineCache::kIndividualCacheSize; ++i) {
     if (ic.GetTypeAt(i) == nullptr) {
       break;
@@ -500,6 +502,9 @@ bool HInliner::TryInlinePolymorphicCall(HInvoke* invoke_instruction,
     if (class_index == DexFile::kDexNoIndex ||
         !TryBuildAndInline(invoke_instruction, method, &return_replacement)) {
       all_targets_inlined = false;
+      if (TryDispatchThroughVTable(invoke_instruction, ic.GetTypeAt(i), method, class_index)) {
+        one_target_dispatched = true;
+      }
     } else {
       one_target_inlined = true;
       bool is_referrer = (ic.GetTypeAt(i) == outermost_graph_->GetArtMethod()->GetDeclaringClass());
@@ -530,13 +535,15 @@ bool HInliner::TryInlinePolymorphicCall(HInvoke* invoke_instruction,
     }
   }
 
-  if (!one_target_inlined) {
+  if (!one_target_inlined && !one_target_dispatched) {
     VLOG(compiler) << "Call to " << PrettyMethod(resolved_method)
                    << " from inline cache is not inlined because none"
                    << " of its targets could be inlined";
     return false;
   }
-  MaybeRecordStat(kInlinedPolymorphicCall);
+  if (one_target_inlined) {
+    MaybeRecordStat(kInlinedPolymorphicCall);
+  }
 
   // Run type propagation to get the guards typed.
   ReferenceTypePropagation rtp_fixup(graph_,
@@ -544,6 +551,69 @@ bool HInliner::TryInlinePolymorphicCall(HInvoke* invoke_instruction,
                                      handles_,
                                      /* is_first_run */ false);
   rtp_fixup.Run();
+  // Targets called through the vtable are not inlined.
+  return one_target_inlined;
+}
+
+bool HInliner::TryDispatchThroughVTable(HInvoke* invoke_instruction,
+                                        mirror::Class* klass,
+                                        ArtMethod* method,
+                                        uint32_t class_index) {
+  if (!invoke_instruction->IsInvokeInterface() ||
+      class_index == DexFile::kDexNoIndex ||
+      method == nullptr ||
+      method->IsAbstract() ||
+      !klass->ShouldHaveImt()) {
+    return false;
+  }
+
+  // Only calls that go through an IMT conflict table are worth it, other calls
+  // already jump directly to the target.
+  size_t pointer_size = caller_compilation_unit_.GetClassLinker()->GetImagePointerSize();
+  uint32_t imt_index = invoke_instruction->AsInvokeInterface()->GetImtIndex() % ImTable::kSize;
+  ArtMethod* imt_method = klass->GetImt(pointer_size)->Get(imt_index, pointer_size);
+  if (!imt_method->IsRuntimeMethod() || imt_method->IsImtUnimplementedMethod()) {
+    return false;
+  }
+  uint32_t vtable_index = method->GetMethodIndex();
+  if (vtable_index >= static_cast<uint32_t>(klass->GetEmbeddedVTableLength()) ||
+      klass->GetEmbeddedVTableEntry(vtable_index, pointer_size) != method) {
+    return false;
+  }
+
+  HInstruction* receiver = invoke_instruction->InputAt(0);
+  HInstruction* cursor = invoke_instruction->GetPrevious();
+  HBasicBlock* bb_cursor = invoke_instruction->GetBlock();
+  bool is_referrer = (klass == outermost_graph_->GetArtMethod()->GetDeclaringClass());
+  HInstruction* compare = AddTypeGuard(receiver,
+                                       cursor,
+                                       bb_cursor,
+                                       class_index,
+                                       is_referrer,
+                                       invoke_instruction,
+                                       /* with_deoptimization */ false);
+
+  HInvokeVirtual* new_invoke = new (graph_->GetArena()) HInvokeVirtual(
+      graph_->GetArena(),
+      invoke_instruction->GetNumberOfArguments(),
+      invoke_instruction->GetType(),
+      invoke_instruction->GetDexPc(),
+      invoke_instruction->GetDexMethodIndex(),
+      vtable_index);
+  for (size_t i = 0, e = invoke_instruction->InputCount(); i < e; ++i) {
+    new_invoke->SetArgumentAt(i, invoke_instruction->InputAt(i));
+  }
+  bb_cursor->InsertInstructionBefore(new_invoke, invoke_instruction);
+  new_invoke->CopyEnvironmentFrom(invoke_instruction->GetEnvironment());
+  if (invoke_instruction->GetType() == Primitive::kPrimNot) {
+    new_invoke->SetReferenceTypeInfo(invoke_instruction->GetReferenceTypeInfo());
+  }
+
+  CreateDiamondPatternForPolymorphicInline(
+      compare,
+      (invoke_instruction->GetType() == Primitive::kPrimVoid) ? nullptr : new_invoke,
+      invoke_instruction);
+  MaybeRecordStat(kInterfaceCallDispatchedThroughVTable);
   return true;
 }
 
@@ -863,6 +933,7 @@ bool HInliner::TryPatternSubstitution(HInvoke* invoke_instruction,
     return false;
   }
 
+  size_t pointer_size = InstructionSetPointerSize(codegen_->GetInstructionSet());
   switch (inline_method.opcode) {
     case kInlineOpNop:
       DCHECK_EQ(invoke_instruction->GetType(), Primitive::kPrimVoid);
@@ -887,8 +958,14 @@ bool HInliner::TryPatternSubstitution(HInvoke* invoke_instruction,
         return false;
       }
       Handle<mirror::DexCache> dex_cache(handles_->NewHandle(resolved_method->GetDexCache()));
+      // A hashed dex cache may have evicted the field since the analysis.
+      ArtField* resolved_field = dex_cache->GetResolvedField(data.field_idx, pointer_size);
+      if (resolved_field == nullptr) {
+        return false;
+      }
       HInstruction* obj = GetInvokeInputForArgVRegIndex(invoke_instruction, data.object_arg);
-      HInstanceFieldGet* iget = CreateInstanceFieldGet(dex_cache, data.field_idx, obj);
+      HInstanceFieldGet* iget =
+          CreateInstanceFieldGet(dex_cache, resolved_field, data.field_idx, obj);
       DCHECK_EQ(iget->GetFieldOffset().Uint32Value(), data.field_offset);
       DCHECK_EQ(iget->IsVolatile() ? 1u : 0u, data.is_volatile);
       invoke_instruction->GetBlock()->InsertInstructionBefore(iget, invoke_instruction);
@@ -902,9 +979,15 @@ bool HInliner::TryPatternSubstitution(HInvoke* invoke_instruction,
         return false;
       }
       Handle<mirror::DexCache> dex_cache(handles_->NewHandle(resolved_method->GetDexCache()));
+      // A hashed dex cache may have evicted the field since the analysis.
+      ArtField* resolved_field = dex_cache->GetResolvedField(data.field_idx, pointer_size);
+      if (resolved_field == nullptr) {
+        return false;
+      }
       HInstruction* obj = GetInvokeInputForArgVRegIndex(invoke_instruction, data.object_arg);
       HInstruction* value = GetInvokeInputForArgVRegIndex(invoke_instruction, data.src_arg);
-      HInstanceFieldSet* iput = CreateInstanceFieldSet(dex_cache, data.field_idx, obj, value);
+      HInstanceFieldSet* iput =
+          CreateInstanceFieldSet(dex_cache, resolved_field, data.field_idx, obj, value);
       DCHECK_EQ(iput->GetFieldOffset().Uint32Value(), data.field_offset);
       DCHECK_EQ(iput->IsVolatile() ? 1u : 0u, data.is_volatile);
       invoke_instruction->GetBlock()->InsertInstructionBefore(iput, invoke_instruction);
@@ -937,24 +1020,30 @@ bool HInliner::TryPatternSubstitution(HInvoke* invoke_instruction,
                                  iput_field_indexes + arraysize(iput_field_indexes),
                                  [](uint16_t index) { return index != DexFile::kDexNoIndex16; }));
 
+      // Look up all the fields before changing the graph, a hashed dex cache may have evicted
+      // some of them since the analysis.
+      Handle<mirror::DexCache> dex_cache(handles_->NewHandle(resolved_method->GetDexCache()));
+      ArtField* resolved_fields[arraysize(iput_field_indexes)];
+      for (size_t i = 0; i != number_of_iputs; ++i) {
+        resolved_fields[i] = dex_cache->GetResolvedField(iput_field_indexes[i], pointer_size);
+        if (resolved_fields[i] == nullptr) {
+          return false;
+        }
+      }
+
       // Create HInstanceFieldSet for each IPUT that stores non-zero data.
-      Handle<mirror::DexCache> dex_cache;
       HInstruction* obj = GetInvokeInputForArgVRegIndex(invoke_instruction, /* this */ 0u);
       bool needs_constructor_barrier = false;
       for (size_t i = 0; i != number_of_iputs; ++i) {
         HInstruction* value = GetInvokeInputForArgVRegIndex(invoke_instruction, iput_args[i]);
         if (!value->IsConstant() || !value->AsConstant()->IsZeroBitPattern()) {
-          if (dex_cache.GetReference() == nullptr) {
-            dex_cache = handles_->NewHandle(resolved_method->GetDexCache());
-          }
+          ArtField* resolved_field = resolved_fields[i];
           uint16_t field_index = iput_field_indexes[i];
-          HInstanceFieldSet* iput = CreateInstanceFieldSet(dex_cache, field_index, obj, value);
+          HInstanceFieldSet* iput =
+              CreateInstanceFieldSet(dex_cache, resolved_field, field_index, obj, value);
           invoke_instruction->GetBlock()->InsertInstructionBefore(iput, invoke_instruction);
 
           // Check whether the field is final. If it is, we need to add a barrier.
-          size_t pointer_size = InstructionSetPointerSize(codegen_->GetInstructionSet());
-          ArtField* resolved_field = dex_cache->GetResolvedField(field_index, pointer_size);
-          DCHECK(resolved_field != nullptr);
           if (resolved_field->IsFinal()) {
             needs_constructor_barrier = true;
           }
@@ -975,11 +1064,10 @@ bool HInliner::TryPatternSubstitution(HInvoke* invoke_instruction,
 }
 
 HInstanceFieldGet* HInliner::CreateInstanceFieldGet(Handle<mirror::DexCache> dex_cache,
+                                                    ArtField* resolved_field,
                                                     uint32_t field_index,
                                                     HInstruction* obj)
     SHARED_REQUIRES(Locks::mutator_lock_) {
-  size_t pointer_size = InstructionSetPointerSize(codegen_->GetInstructionSet());
-  ArtField* resolved_field = dex_cache->GetResolvedField(field_index, pointer_size);
   DCHECK(resolved_field != nullptr);
   HInstanceFieldGet* iget = new (graph_->GetArena()) HInstanceFieldGet(
       obj,
@@ -1002,12 +1090,11 @@ HInstanceFieldGet* HInliner::CreateInstanceFieldGet(Handle<mirror::DexCache> dex
 }
 
 HInstanceFieldSet* HInliner::CreateInstanceFieldSet(Handle<mirror::DexCache> dex_cache,
+                                                    ArtField* resolved_field,
                                                     uint32_t field_index,
                                                     HInstruction* obj,
                                                     HInstruction* value)
     SHARED_REQUIRES(Locks::mutator_lock_) {
-  size_t pointer_size = InstructionSetPointerSize(codegen_->GetInstructionSet());
-  ArtField* resolved_field = dex_cache->GetResolvedField(field_index, pointer_size);
   DCHECK(resolved_field != nullptr);
   HInstanceFieldSet* iput = new (graph_->GetArena()) HInstanceFieldSet(
       obj,
@@ -22,6 +22,10 @@
 
 namespace art {
 
+namespace mirror {
+class Class;
+}  // namespace mirror
+
 class CodeGenerator;
 class CompilerDriver;
 class DexCompilationUnit;
@@ -90,10 +94,12 @@ class HInliner : public HOptimization {
 
   // Create a new HInstanceFieldGet.
   HInstanceFieldGet* CreateInstanceFieldGet(Handle<mirror::DexCache> dex_cache,
+                                            ArtField* resolved_field,
                                             uint32_t field_index,
                                             HInstruction* obj);
   // Create a new HInstanceFieldSet.
   HInstanceFieldSet* CreateInstanceFieldSet(Handle<mirror::DexCache> dex_cache,
+                                            ArtField* resolved_field,
                                             uint32_t field_index,
                                             HInstruction* obj,
                                             HInstruction* value);
@@ -118,6 +124,15 @@ class HInliner : public HOptimization {
                                             const InlineCache& ic)
     SHARED_REQUIRES(Locks::mutator_lock_);
 
+  // Try to call `method` through the vtable for receivers of type `klass`, when the
+  // interface call `invoke_instruction` would go through an IMT conflict table. The
+  // call is guarded by a type check and the original invoke handles other receivers.
+  bool TryDispatchThroughVTable(HInvoke* invoke_instruction,
+                                mirror::Class* klass,
+                                ArtMethod* method,
+                                uint32_t class_index)
+    SHARED_REQUIRES(Locks::mutator_lock_);
+
 
   HInstanceFieldGet* BuildGetReceiverClass(ClassLinker* class_linker,
                                            HInstruction* receiver,
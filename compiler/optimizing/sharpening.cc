@@ -194,6 +194,9 @@ void HSharpening::ProcessLoadString(HLoadString* load_string) {
       if (string != nullptr && runtime->GetHeap()->ObjectIsInBootImageSpace(string)) {
         desired_load_kind = HLoadString::LoadKind::kBootImageAddress;
         address = reinterpret_cast64<uint64_t>(string);
+      } else if (dex_cache->HasHashedStrings()) {
+        // Only loads via the method check the tag of hashed strings arrays.
+        desired_load_kind = HLoadString::LoadKind::kDexCacheViaMethod;
       } else {
         // Note: If the string is not in the dex cache, the instruction needs environment
         // and will not be inlined across dex files. Within a dex file, the slow-path helper
@@ -221,13 +224,22 @@ void HSharpening::ProcessLoadString(HLoadString* load_string) {
         // Not JIT and the string is not in boot image.
         desired_load_kind = HLoadString::LoadKind::kDexCachePcRelative;
       }
+      // Only loads via the method check the tag of hashed strings arrays.
+      if (desired_load_kind == HLoadString::LoadKind::kDexCachePcRelative &&
+          mirror::DexCache::UseHashedStrings(dex_file.NumStringIds())) {
+        desired_load_kind = HLoadString::LoadKind::kDexCacheViaMethod;
+      }
     }
   }
+  HLoadString::LoadKind load_kind = codegen_->GetSupportedLoadStringKind(desired_load_kind);
+  if (load_kind == HLoadString::LoadKind::kDexCacheViaMethod &&
+      mirror::DexCache::UseHashedStrings(dex_file.NumStringIds())) {
+    // The slot of the string in the hashed strings array may be taken over at any time.
+    is_in_dex_cache = false;
+  }
   if (is_in_dex_cache) {
     load_string->MarkInDexCache();
   }
-
-  HLoadString::LoadKind load_kind = codegen_->GetSupportedLoadStringKind(desired_load_kind);
   switch (load_kind) {
     case HLoadString::LoadKind::kBootImageLinkTimeAddress:
     case HLoadString::LoadKind::kBootImageLinkTimePcRelative:
@@ -23,11 +23,11 @@
 #include <inttypes.h>
 #include <unordered_map>
 
-#include "base/mutex.h"
-#include "base/hash_set.h"
+#include "base/bit_utils.h"
 #include "base/stl_util.h"
 #include "base/stringprintf.h"
 #include "base/time_utils.h"
+#include "globals.h"
 
 namespace art {
 
@@ -52,47 +52,88 @@ template <typename InKey,
           HashType kShard>
 class DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::Shard {
  public:
-  Shard(const Alloc& alloc, const std::string& lock_name)
+  explicit Shard(const Alloc& alloc)
       : alloc_(alloc),
-        lock_name_(lock_name),
-        lock_(lock_name_.c_str()),
-        keys_() {
+        table_(new Table(kInitialBuckets, nullptr)),
+        resizing_(false) {
   }
 
   ~Shard() {
-    for (const HashedKey<StoreKey>& key : keys_) {
-      DCHECK(key.Key() != nullptr);
-      alloc_.Destroy(key.Key());
+    Table* table = table_.LoadRelaxed();
+    DCHECK(table->migrating_from_.LoadRelaxed() == nullptr);
+    for (size_t i = 0; i != table->NumBuckets(); ++i) {
+      for (Node* node = table->Head(i); node != nullptr; node = node->next) {
+        DCHECK(node->key != nullptr);
+        alloc_.Destroy(node->key);
+      }
+    }
+    // The nodes of the older tables refer to the same keys, only delete the nodes.
+    while (table != nullptr) {
+      Table* older = table->older_;
+      delete table;
+      table = older;
     }
   }
 
-  const StoreKey* Add(Thread* self, size_t hash, const InKey& in_key) REQUIRES(!lock_) {
-    MutexLock lock(self, lock_);
-    HashedKey<InKey> hashed_in_key(hash, &in_key);
-    auto it = keys_.Find(hashed_in_key);
-    if (it != keys_.end()) {
-      DCHECK(it->Key() != nullptr);
-      return it->Key();
-    }
-    const StoreKey* store_key = alloc_.Copy(in_key);
-    keys_.Insert(HashedKey<StoreKey> { hash, store_key });
-    return store_key;
+  const StoreKey* Add(Thread* self ATTRIBUTE_UNUSED, size_t hash, const InKey& in_key) {
+    // The copy of the key is made before it is known to be unique, outside of any critical
+    // section. If another thread adds an equal key first, the copy is destroyed.
+    Node* node = nullptr;
+    Table* table = table_.LoadAcquire();
+    while (true) {
+      Table* old_table = table->migrating_from_.LoadAcquire();
+      if (old_table != nullptr) {
+        // The table is being resized. Freeze the bucket of the old table, so that no thread
+        // can add the key there anymore, and look for the key in it first.
+        Node* old_head = old_table->Freeze(old_table->Index(hash));
+        const StoreKey* found = Find(old_head, nullptr, hash, in_key);
+        if (found != nullptr) {
+          return Discard(node, found);
+        }
+      }
+      Atomic<Node*>& bucket = table->Bucket(table->Index(hash));
+      Node* head = bucket.LoadAcquire();
+      Node* searched_head = nullptr;
+      while (!IsFrozen(head)) {
+        // Nodes are only ever added at the head of the chain, so after a failed CAS only the
+        // nodes added since the last search need to be compared.
+        const StoreKey* found = Find(head, searched_head, hash, in_key);
+        if (found != nullptr) {
+          return Discard(node, found);
+        }
+        if (node == nullptr) {
+          node = new Node(hash, alloc_.Copy(in_key));
+        }
+        node->next = head;
+        if (bucket.CompareExchangeStrongSequentiallyConsistent(head, node)) {
+          size_t size = table->size_.FetchAndAddRelaxed(1u) + 1u;
+          if (size > table->NumBuckets() * kMaxLoadFactor) {
+            Resize(table);
+          }
+          return node->key;
+        }
+        searched_head = head;
+        head = bucket.LoadAcquire();
+      }
+      // The bucket was frozen by a resize, retry with the new table.
+      table = table_.LoadAcquire();
+    }
   }
 
-  void UpdateStats(Thread* self, Stats* global_stats) REQUIRES(!lock_) {
-    // HashSet<> doesn't keep entries ordered by hash, so we actually allocate memory
+  void UpdateStats(Thread* self ATTRIBUTE_UNUSED, Stats* global_stats) {
+    // The chains are not ordered by hash, so we actually allocate memory
     // for bookkeeping while collecting the stats.
     std::unordered_map<HashType, size_t> stats;
-    {
-      MutexLock lock(self, lock_);
-      // Note: The total_probe_distance will be updated with the current state.
-      // It may have been higher before a re-hash.
-      global_stats->total_probe_distance += keys_.TotalProbeDistance();
-      global_stats->total_size += keys_.Size();
-      for (const HashedKey<StoreKey>& key : keys_) {
-        auto it = stats.find(key.Hash());
+    Table* table = table_.LoadAcquire();
+    for (size_t i = 0; i != table->NumBuckets(); ++i) {
+      size_t depth = 0u;
+      for (Node* node = table->Head(i); node != nullptr; node = node->next) {
+        global_stats->total_probe_distance += depth;
+        ++depth;
+        ++global_stats->total_size;
+        auto it = stats.find(node->hash);
         if (it == stats.end()) {
-          stats.insert({key.Hash(), 1u});
+          stats.insert({node->hash, 1u});
         } else {
           ++it->second;
         }
@@ -108,74 +149,151 @@ class DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::Shard {
   }
 
  private:
-  template <typename T>
-  class HashedKey {
-   public:
-    HashedKey() : hash_(0u), key_(nullptr) { }
-    HashedKey(size_t hash, const T* key) : hash_(hash), key_(key) { }
+  static constexpr size_t kInitialBuckets = 1024u;
+  static constexpr size_t kMaxLoadFactor = 2u;
 
-    size_t Hash() const {
-      return hash_;
+  // Nodes are immutable once published, except that `next` is set before the CAS that
+  // publishes them. They are never removed, so lookups need no synchronization beyond the
+  // acquire loads of the bucket heads.
+  struct Node {
+    Node(size_t h, const StoreKey* k) : hash(h), key(k), next(nullptr) { }
+
+    const size_t hash;
+    const StoreKey* const key;
+    Node* next;
+  };
+
+  // A bucket array of singly linked chains. A resize freezes each bucket of the old table by
+  // setting the low bit of its head, after which the chain cannot change and is copied to the
+  // new table. Old tables are kept until the shard is destroyed, because other threads may
+  // still be reading their chains.
+  class Table {
+   public:
+    Table(size_t num_buckets, Table* older)
+        : mask_(num_buckets - 1u),
+          buckets_(new Atomic<Node*>[num_buckets]),
+          older_(older),
+          migrating_from_(older),
+          size_(0u) {
+      DCHECK(IsPowerOfTwo(num_buckets));
     }
 
-    const T* Key() const {
-      return key_;
+    ~Table() {
+      for (size_t i = 0; i != NumBuckets(); ++i) {
+        Node* node = Head(i);
+        while (node != nullptr) {
+          Node* next = node->next;
+          delete node;
+          node = next;
+        }
+      }
     }
 
-    bool IsEmpty() const {
-      return Key() == nullptr;
+    size_t NumBuckets() const {
+      return mask_ + 1u;
     }
 
-    void MakeEmpty() {
-      key_ = nullptr;
+    size_t Index(size_t hash) const {
+      return hash & mask_;
     }
 
-   private:
-    size_t hash_;
-    const T* key_;
-  };
+    Atomic<Node*>& Bucket(size_t index) {
+      return buckets_[index];
+    }
 
-  class ShardEmptyFn {
-   public:
-    bool IsEmpty(const HashedKey<StoreKey>& key) const {
-      return key.IsEmpty();
+    // Returns the head of a chain, ignoring whether it is frozen.
+    Node* Head(size_t index) const {
+      return Unfreeze(buckets_[index].LoadAcquire());
     }
 
-    void MakeEmpty(HashedKey<StoreKey>& key) {
-      key.MakeEmpty();
+    // Freeze a bucket and return the head of its chain.
+    Node* Freeze(size_t index) {
+      Atomic<Node*>& bucket = buckets_[index];
+      while (true) {
+        Node* head = bucket.LoadAcquire();
+        if (IsFrozen(head) ||
+            bucket.CompareExchangeWeakSequentiallyConsistent(head, MakeFrozen(head))) {
+          return Unfreeze(head);
+        }
+      }
     }
+
+    const size_t mask_;
+    const std::unique_ptr<Atomic<Node*>[]> buckets_;
+    Table* const older_;
+    // The table whose keys are being copied to this one, or null when the resize is done.
+    Atomic<Table*> migrating_from_;
+    Atomic<size_t> size_;
   };
 
-  struct ShardHashFn {
-    template <typename T>
-    size_t operator()(const HashedKey<T>& key) const {
-      return key.Hash();
+  static bool IsFrozen(Node* head) {
+    return (reinterpret_cast<uintptr_t>(head) & 1u) != 0u;
+  }
+
+  static Node* MakeFrozen(Node* head) {
+    return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(head) | 1u);
+  }
+
+  static Node* Unfreeze(Node* head) {
+    return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(head) & ~static_cast<uintptr_t>(1u));
+  }
+
+  // Look for the key in the chain from `first` up to, but not including, `last`.
+  static const StoreKey* Find(Node* first, Node* last, size_t hash, const InKey& in_key) {
+    for (Node* node = first; node != last; node = node->next) {
+      if (node->hash == hash &&
+          node->key->size() == in_key.size() &&
+          std::equal(in_key.begin(), in_key.end(), node->key->begin())) {
+        return node->key;
+      }
     }
-  };
+    return nullptr;
+  }
 
-  struct ShardPred {
-    typename std::enable_if<!std::is_same<StoreKey, InKey>::value, bool>::type
-    operator()(const HashedKey<StoreKey>& lhs, const HashedKey<StoreKey>& rhs) const {
-      DCHECK(lhs.Key() != nullptr);
-      DCHECK(rhs.Key() != nullptr);
-      // Rehashing: stored keys are already deduplicated, so we can simply compare key pointers.
-      return lhs.Key() == rhs.Key();
+  const StoreKey* Discard(Node* node, const StoreKey* found) {
+    if (node != nullptr) {
+      alloc_.Destroy(node->key);
+      delete node;
     }
+    return found;
+  }
 
-    template <typename LeftT, typename RightT>
-    bool operator()(const HashedKey<LeftT>& lhs, const HashedKey<RightT>& rhs) const {
-      DCHECK(lhs.Key() != nullptr);
-      DCHECK(rhs.Key() != nullptr);
-      return lhs.Hash() == rhs.Hash() &&
-          lhs.Key()->size() == rhs.Key()->size() &&
-          std::equal(lhs.Key()->begin(), lhs.Key()->end(), rhs.Key()->begin());
+  // Double the number of buckets. Only one thread resizes a shard at a time, other threads keep
+  // adding keys to the new table while the chains of the old one are copied.
+  void Resize(Table* table) {
+    if (table_.LoadAcquire() != table ||
+        !resizing_.CompareExchangeStrongSequentiallyConsistent(false, true)) {
+      return;
     }
-  };
+    if (table_.LoadAcquire() != table) {
+      // Another thread resized the table in the meantime.
+      resizing_.StoreRelease(false);
+      return;
+    }
+    Table* new_table = new Table(table->NumBuckets() * 2u, table);
+    table_.StoreRelease(new_table);
+    size_t copied = 0u;
+    for (size_t i = 0; i != table->NumBuckets(); ++i) {
+      for (Node* node = table->Freeze(i); node != nullptr; node = node->next) {
+        // The keys of a frozen chain are not in the new table: threads adding an equal key look
+        // in the frozen chain first. No need to compare the keys.
+        Node* copy = new Node(node->hash, node->key);
+        Atomic<Node*>& bucket = new_table->Bucket(new_table->Index(node->hash));
+        do {
+          copy->next = bucket.LoadAcquire();
+        } while (!bucket.CompareExchangeWeakSequentiallyConsistent(copy->next, copy));
+        ++copied;
+      }
+    }
+    new_table->size_.FetchAndAddRelaxed(copied);
+    new_table->migrating_from_.StoreRelease(nullptr);
+    resizing_.StoreRelease(false);
+  }
 
   Alloc alloc_;
-  const std::string lock_name_;
-  Mutex lock_;
-  HashSet<HashedKey<StoreKey>, ShardEmptyFn, ShardHashFn, ShardPred> keys_ GUARDED_BY(lock_);
+  Atomic<Table*> table_;
+  // Set while a thread resizes the table.
+  Atomic<bool> resizing_;
 };
 
 template <typename InKey,
@@ -193,7 +311,7 @@ const StoreKey* DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::A
   HashType raw_hash = HashFunc()(key);
   if (kIsDebugBuild) {
     uint64_t hash_end = NanoTime();
-    hash_time_ += hash_end - hash_start;
+    hash_time_.FetchAndAddRelaxed(hash_end - hash_start);
   }
   HashType shard_hash = raw_hash / kShard;
   HashType shard_bin = raw_hash % kShard;
@@ -206,13 +324,11 @@ template <typename InKey,
           typename HashType,
           typename HashFunc,
           HashType kShard>
-DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::DedupeSet(const char* set_name,
-                                                                         const Alloc& alloc)
-    : hash_time_(0) {
+DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::DedupeSet(
+    const char* set_name ATTRIBUTE_UNUSED, const Alloc& alloc)
+    : hash_time_(0u) {
   for (HashType i = 0; i < kShard; ++i) {
-    std::ostringstream oss;
-    oss << set_name << " lock " << i;
-    shards_[i].reset(new Shard(alloc, oss.str()));
+    shards_[i].reset(new Shard(alloc));
   }
 }
 
@@ -244,7 +360,7 @@ std::string DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::DumpS
                       stats.collision_max,
                       stats.total_probe_distance,
                       stats.total_size,
-                      hash_time_);
+                      hash_time_.LoadRelaxed());
 }
 
 
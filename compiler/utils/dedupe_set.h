@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <string>
 
+#include "atomic.h"
 #include "base/macros.h"
 
 namespace art {
@@ -28,8 +29,9 @@ namespace art {
 class Thread;
 
 // A set of Keys that support a HashFunc returning HashType. Used to find duplicates of Key in the
-// Add method. The data-structure is thread-safe through the use of internal locks, it also
-// supports the lock being sharded.
+// Add method. The data-structure is thread-safe and lock-free: the hash is computed before
+// touching the set, keys are added with a compare-and-swap and the shards resize without blocking
+// other threads.
 template <typename InKey,
           typename StoreKey,
           typename Alloc,
@@ -52,7 +54,7 @@ class DedupeSet {
   class Shard;
 
   std::unique_ptr<Shard> shards_[kShard];
-  uint64_t hash_time_;
+  Atomic<uint64_t> hash_time_;
 
   DISALLOW_COPY_AND_ASSIGN(DedupeSet);
 };
@@ -18,8 +18,11 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <pthread.h>
 #include <vector>
 
+#include "base/logging.h"
+#include "base/time_utils.h"
 #include "dedupe_set-inl.h"
 #include "gtest/gtest.h"
 #include "thread-inl.h"
@@ -88,4 +91,79 @@ TEST(DedupeSetTest, Test) {
   }
 }
 
+using MultiThreadedDedupeSet = DedupeSet<ArrayRef<const uint8_t>,
+                                          std::vector<uint8_t>,
+                                          DedupeSetTestAlloc,
+                                          size_t,
+                                          DedupeSetTestHashFunc,
+                                          4>;
+
+struct DedupeSetTestThreadArgs {
+  MultiThreadedDedupeSet* deduplicator;
+  const std::vector<std::vector<uint8_t>>* keys;
+  size_t start;
+  std::vector<const std::vector<uint8_t>*> results;
+};
+
+static void* DedupeSetTestThread(void* arg) {
+  DedupeSetTestThreadArgs* args = reinterpret_cast<DedupeSetTestThreadArgs*>(arg);
+  const std::vector<std::vector<uint8_t>>& keys = *args->keys;
+  args->results.resize(keys.size());
+  // Each thread starts at a different key, so that the threads add the same keys concurrently
+  // while the shards grow.
+  for (size_t i = 0; i != keys.size(); ++i) {
+    size_t index = (args->start + i) % keys.size();
+    args->results[index] = args->deduplicator->Add(nullptr, ArrayRef<const uint8_t>(keys[index]));
+  }
+  return nullptr;
+}
+
+// Add the same keys from several threads, check that all threads get the same stored keys and
+// report the time taken.
+TEST(DedupeSetTest, MultiThreaded) {
+  static constexpr size_t kNumThreads = 8u;
+  static constexpr size_t kNumKeys = 50000u;
+  std::vector<std::vector<uint8_t>> keys;
+  keys.reserve(kNumKeys);
+  for (size_t i = 0; i != kNumKeys; ++i) {
+    // Small keys with some shared content, like the CFI and the stack maps of small methods.
+    std::vector<uint8_t> key(8u + i % 24u, static_cast<uint8_t>(i % 7u));
+    key[0] = static_cast<uint8_t>(i);
+    key[1] = static_cast<uint8_t>(i >> 8);
+    key[2] = static_cast<uint8_t>(i >> 16);
+    keys.push_back(key);
+  }
+
+  DedupeSetTestAlloc alloc;
+  MultiThreadedDedupeSet deduplicator("test", alloc);
+  std::vector<DedupeSetTestThreadArgs> args(kNumThreads);
+  std::vector<pthread_t> pthreads(kNumThreads);
+  uint64_t start_time = NanoTime();
+  for (size_t t = 0; t != kNumThreads; ++t) {
+    args[t].deduplicator = &deduplicator;
+    args[t].keys = &keys;
+    args[t].start = t * kNumKeys / kNumThreads;
+    ASSERT_EQ(0, pthread_create(&pthreads[t], nullptr, DedupeSetTestThread, &args[t]));
+  }
+  for (size_t t = 0; t != kNumThreads; ++t) {
+    ASSERT_EQ(0, pthread_join(pthreads[t], nullptr));
+  }
+  uint64_t duration = NanoTime() - start_time;
+  LOG(INFO) << kNumThreads << " threads added " << kNumKeys << " keys each in "
+            << PrettyDuration(duration) << ": " << deduplicator.DumpStats(nullptr);
+
+  std::vector<const std::vector<uint8_t>*> stored_keys;
+  for (size_t i = 0; i != kNumKeys; ++i) {
+    const std::vector<uint8_t>* stored_key = args[0].results[i];
+    ASSERT_NE(stored_key, nullptr);
+    ASSERT_EQ(keys[i], *stored_key);
+    for (size_t t = 1; t != kNumThreads; ++t) {
+      ASSERT_EQ(stored_key, args[t].results[i]);
+    }
+    stored_keys.push_back(stored_key);
+  }
+  std::sort(stored_keys.begin(), stored_keys.end());
+  EXPECT_TRUE(std::adjacent_find(stored_keys.begin(), stored_keys.end()) == stored_keys.end());
+}
+
 }  // namespace art
@@ -61,6 +61,8 @@ inline void SwapSpace::InsertChunk(const SpaceChunk& chunk) {
 SwapSpace::SwapSpace(int fd, size_t initial_size)
     : fd_(fd),
       size_(0),
+      write_back_batch_size_(0u),
+      allocated_since_write_back_(0u),
       lock_("SwapSpace lock", static_cast<LockLevel>(LockLevel::kDefaultMutexLevel - 1)) {
   // Assume that the file is unlinked.
 
@@ -105,7 +107,8 @@ static size_t CollectFree(const FreeByStartSet& free_by_start, const FreeBySizeS
 }
 
 void* SwapSpace::Alloc(size_t size) {
-  MutexLock lock(Thread::Current(), lock_);
+  Thread* self = Thread::Current();
+  lock_.ExclusiveLock(self);
   size = RoundUp(size, 8U);
 
   // Check the free list for something that fits.
@@ -130,9 +133,55 @@ void* SwapSpace::Alloc(size_t size) {
     InsertChunk(new_chunk);
   }
 
+  std::vector<SpaceChunk> finished_batch;
+  if (write_back_batch_size_ != 0u) {
+    if (allocated_since_write_back_ >= write_back_batch_size_) {
+      // The allocations of the batch have been filled by now.
+      finished_batch.swap(batch_);
+      allocated_since_write_back_ = 0u;
+    }
+    allocated_since_write_back_ += size;
+    if (!batch_.empty() && batch_.back().End() == old_chunk.Start()) {
+      batch_.back().size += size;
+    } else {
+      batch_.push_back(SpaceChunk { old_chunk.ptr, size });
+    }
+  }
+  lock_.ExclusiveUnlock(self);
+
+  if (!finished_batch.empty()) {
+    WriteBackRanges(finished_batch);
+  }
   return ret;
 }
 
+void SwapSpace::WriteBack() {
+  std::vector<SpaceChunk> maps;
+  {
+    MutexLock lock(Thread::Current(), lock_);
+    maps = maps_;
+    batch_.clear();
+    allocated_since_write_back_ = 0u;
+  }
+  WriteBackRanges(maps);
+}
+
+void SwapSpace::WriteBackRanges(const std::vector<SpaceChunk>& ranges) {
+  // The maps are never unmapped before the destructor, so they can be used without the lock.
+  // The mappings are shared, so dropping the pages does not lose any data, even if other
+  // threads are writing to them concurrently.
+  for (const SpaceChunk& range : ranges) {
+    uint8_t* begin = reinterpret_cast<uint8_t*>(RoundDown(range.Start(), kPageSize));
+    size_t size = RoundUp(range.End(), kPageSize) - reinterpret_cast<uintptr_t>(begin);
+    if (msync(begin, size, MS_ASYNC) != 0) {
+      PLOG(WARNING) << "Failed to sync swap file range at " << static_cast<const void*>(begin);
+    }
+    if (madvise(begin, size, MADV_DONTNEED) != 0) {
+      PLOG(WARNING) << "Failed to release swap file range at " << static_cast<const void*>(begin);
+    }
+  }
+}
+
 SwapSpace::SpaceChunk SwapSpace::NewFileChunk(size_t min_size) {
 #if !defined(__APPLE__)
   size_t next_part = std::max(RoundUp(min_size, kPageSize), RoundUp(kMininumMapSize, kPageSize));
@@ -152,6 +201,7 @@ SwapSpace::SpaceChunk SwapSpace::NewFileChunk(size_t min_size) {
   }
   size_ += next_part;
   SpaceChunk new_chunk = {ptr, next_part};
+  maps_.push_back(new_chunk);
   return new_chunk;
 #else
   UNUSED(min_size, kMininumMapSize);
@@ -38,6 +38,20 @@ class SwapSpace {
   void* Alloc(size_t size) REQUIRES(!lock_);
   void Free(void* ptr, size_t size) REQUIRES(!lock_);
 
+  // Write the data back to the file each time `batch_size` bytes have been allocated, so that
+  // the memory used by the swap space stays bounded. Only the pages of the batch are written
+  // back, when the next allocation starts a new batch. Zero, the default, disables the batches.
+  void SetWriteBackBatchSize(size_t batch_size) {
+    write_back_batch_size_ = batch_size;
+  }
+  size_t GetWriteBackBatchSize() const {
+    return write_back_batch_size_;
+  }
+
+  // Start writing the dirty pages back to the file and drop all pages from the address space.
+  // The data stays in the file and is faulted back in when it is accessed again.
+  void WriteBack() REQUIRES(!lock_);
+
   size_t GetSize() {
     return size_;
   }
@@ -83,8 +97,12 @@ class SwapSpace {
   void RemoveChunk(FreeBySizeSet::const_iterator free_by_size_pos) REQUIRES(lock_);
   void InsertChunk(const SpaceChunk& chunk) REQUIRES(lock_);
 
+  // Start writing the pages overlapping the given ranges back to the file and drop them.
+  static void WriteBackRanges(const std::vector<SpaceChunk>& ranges);
+
   int fd_;
   size_t size_;
+  size_t write_back_batch_size_;
 
   // NOTE: Boost.Bimap would be useful for the two following members.
 
@@ -93,6 +111,12 @@ class SwapSpace {
   // Free chunks ordered by size.
   FreeBySizeSet free_by_size_ GUARDED_BY(lock_);
 
+  // All mapped parts of the file, for WriteBack().
+  std::vector<SpaceChunk> maps_ GUARDED_BY(lock_);
+  // The allocations of the current write back batch, adjacent ones merged, and their size.
+  std::vector<SpaceChunk> batch_ GUARDED_BY(lock_);
+  size_t allocated_since_write_back_ GUARDED_BY(lock_);
+
   mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   DISALLOW_COPY_AND_ASSIGN(SwapSpace);
 };
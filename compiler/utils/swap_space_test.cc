@@ -20,6 +20,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <vector>
 #include "gtest/gtest.h"
 
 #include "base/unix_file/fd_file.h"
@@ -31,6 +33,29 @@ namespace art {
 class SwapSpaceTest : public CommonRuntimeTest {
 };
 
+// Whether the page at `addr` is mapped into the address space. Unlike mincore(), which reports
+// the page cache residency of the file, this shows whether the swap space dropped the page.
+static bool IsPagePresent(const void* addr) {
+  int fd = open("/proc/self/pagemap", O_RDONLY);
+  CHECK_NE(fd, -1) << strerror(errno);
+  uint64_t entry = 0u;
+  off_t offset = static_cast<off_t>(reinterpret_cast<uintptr_t>(addr) / kPageSize * sizeof(entry));
+  CHECK_EQ(pread(fd, &entry, sizeof(entry), offset), static_cast<ssize_t>(sizeof(entry)))
+      << strerror(errno);
+  close(fd);
+  return (entry & (UINT64_C(1) << 63)) != 0u;
+}
+
+static bool AnyPagePresent(const void* ptr, size_t size) {
+  const uint8_t* begin = reinterpret_cast<const uint8_t*>(ptr);
+  for (size_t offset = 0u; offset < size; offset += kPageSize) {
+    if (IsPagePresent(begin + offset)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 static void SwapTest(bool use_file) {
   ScratchFile scratch;
   int fd = scratch.GetFd();
@@ -78,4 +103,74 @@ TEST_F(SwapSpaceTest, Swap) {
   SwapTest(true);
 }
 
+TEST_F(SwapSpaceTest, WriteBack) {
+  ScratchFile scratch;
+  int fd = scratch.GetFd();
+  unlink(scratch.GetFilename().c_str());
+
+  SwapSpace pool(fd, 1 * MB);
+  pool.SetWriteBackBatchSize(64 * KB);
+  SwapAllocator<void> alloc(&pool);
+
+  // Many small vectors, so that the batches are written back while they are being filled.
+  std::vector<SwapVector<int32_t>> vectors;
+  for (int32_t i = 0; i < 1000; ++i) {
+    vectors.emplace_back(alloc);
+    vectors.back().reserve(1000);
+    for (int32_t j = 0; j < 1000; ++j) {
+      vectors.back().push_back(i * 1000 + j);
+    }
+  }
+  pool.WriteBack();
+  for (const SwapVector<int32_t>& vector : vectors) {
+    EXPECT_FALSE(AnyPagePresent(vector.data(), vector.size() * sizeof(int32_t)));
+  }
+
+  // Verify contents.
+  for (int32_t i = 0; i < 1000; ++i) {
+    for (int32_t j = 0; j < 1000; ++j) {
+      EXPECT_EQ(i * 1000 + j, vectors[i][j]);
+    }
+  }
+
+  vectors.clear();
+  scratch.Close();
+}
+
+TEST_F(SwapSpaceTest, WriteBackFinishedBatch) {
+  ScratchFile scratch;
+  int fd = scratch.GetFd();
+  unlink(scratch.GetFilename().c_str());
+
+  SwapSpace pool(fd, 1 * MB);
+  constexpr size_t kBatchSize = 64 * KB;
+
+  // Allocated before the batches are enabled, so never part of one.
+  uint8_t* outside = reinterpret_cast<uint8_t*>(pool.Alloc(kBatchSize));
+  memset(outside, 0x11, kBatchSize);
+
+  pool.SetWriteBackBatchSize(kBatchSize);
+  uint8_t* batch = reinterpret_cast<uint8_t*>(pool.Alloc(kBatchSize));
+  memset(batch, 0x22, kBatchSize);
+  EXPECT_TRUE(AnyPagePresent(batch, kBatchSize));
+
+  // Starting the next batch writes back the finished one, and only that one.
+  void* next = pool.Alloc(8u);
+  EXPECT_FALSE(AnyPagePresent(batch, kBatchSize));
+  for (size_t offset = 0u; offset < kBatchSize; offset += kPageSize) {
+    EXPECT_TRUE(IsPagePresent(outside + offset));
+  }
+
+  // Verify contents.
+  for (size_t i = 0u; i < kBatchSize; ++i) {
+    EXPECT_EQ(0x11, outside[i]);
+    EXPECT_EQ(0x22, batch[i]);
+  }
+
+  pool.Free(next, 8u);
+  pool.Free(batch, kBatchSize);
+  pool.Free(outside, kBatchSize);
+  scratch.Close();
+}
+
 }  // namespace art
@@ -53,8 +53,10 @@
 #include "dex/quick_compiler_callbacks.h"
 #include "dex/verification_results.h"
 #include "dex_file-inl.h"
+#include "driver/compile_cache.h"
 #include "driver/compiler_driver.h"
 #include "driver/compiler_options.h"
+#include "driver/incremental_compilation.h"
 #include "elf_file.h"
 #include "elf_writer.h"
 #include "elf_writer_quick.h"
@@ -347,6 +349,8 @@ NO_RETURN static void Usage(const char* fmt, ...) {
   UsageError("      Example: --runtime-arg -Xms256m");
   UsageError("");
   UsageError("  --profile-file=<filename>: specify profiler output file to use for compilation.");
+  UsageError("      The code items and strings of the dex files are also laid out to group the");
+  UsageError("      ones used at startup together.");
   UsageError("");
   UsageError("  --profile-file-fd=<number>: same as --profile-file but accepts a file descriptor.");
   UsageError("      Cannot be used together with --profile-file.");
@@ -367,6 +371,11 @@ NO_RETURN static void Usage(const char* fmt, ...) {
   UsageError("      Example: --swap-dex-count-threshold=10");
   UsageError("      Default: %zu", kDefaultMinDexFilesForSwap);
   UsageError("");
+  UsageError("  --swap-batch-size=<size>:  streams the compiled code through the swap file in");
+  UsageError("      batches of <size> bytes, so that only the current batch is kept in memory.");
+  UsageError("      Swap is then used regardless of the thresholds, also for images.");
+  UsageError("      Example: --swap-batch-size=%zu", 32 * MB);
+  UsageError("");
   UsageError("  --very-large-app-threshold=<size>:  specifies the minimum total dex file size in");
   UsageError("      bytes to consider the input \"very large\" and punt on the compilation.");
   UsageError("      Example: --very-large-app-threshold=100000000");
@@ -384,6 +393,36 @@ NO_RETURN static void Usage(const char* fmt, ...) {
   UsageError("      This option is incompatible with read barriers (e.g., if dex2oat has been");
   UsageError("      built with the environment variable `ART_USE_READ_BARRIER` set to `true`).");
   UsageError("");
+  UsageError("  --record-linker-patches: record the linker patches in the oat file, so that a");
+  UsageError("      later compilation can reuse its code with --reuse-oat-file.");
+  UsageError("");
+  UsageError("  --reuse-oat-file=<file.oat>: reuse the code of the classes that did not change");
+  UsageError("      since the given oat file was compiled with --record-linker-patches.");
+  UsageError("      Implies --record-linker-patches. Not supported for images.");
+  UsageError("");
+  UsageError("  --compile-shard=<index>/<count>: compile only one of <count> shards of the");
+  UsageError("      class definitions, for merging with --merge-shards. Each shard can be");
+  UsageError("      compiled by a separate process. Implies --record-linker-patches.");
+  UsageError("      Not supported for images.");
+  UsageError("");
+  UsageError("  --merge-shards=<file.oat>,...: produce the oat file from the outputs of");
+  UsageError("      --compile-shard, given in shard order. All other options must be the same as");
+  UsageError("      for the shards, except that the linker patches need not be recorded.");
+  UsageError("      Fails if any of the shards cannot be opened.");
+  UsageError("      Example: --merge-shards=shard0.oat,shard1.oat");
+  UsageError("");
+  UsageError("  --compile-cache-dir=<directory>: look up the compiled methods in an on-disk");
+  UsageError("      cache shared by dex2oat invocations, and add the newly compiled ones to it.");
+  UsageError("      The entries are keyed by the build IDs of the compiler and the runtime, so");
+  UsageError("      the cache need not be cleared when dex2oat changes. Not supported for images.");
+  UsageError("      The hit rate is reported with --dump-timing.");
+  UsageError("      Example: --compile-cache-dir=/tmp/dex2oat-cache");
+  UsageError("");
+  UsageError("  --compile-times-file=<file>: schedule the compilation with the class compile");
+  UsageError("      times of a previous compilation read from <file>, if it exists, and write");
+  UsageError("      the compile times of this compilation to it.");
+  UsageError("      Example: --compile-times-file=/tmp/app.times");
+  UsageError("");
   std::cerr << "See log for usage error information\n";
   exit(EXIT_FAILURE);
 }
@@ -544,7 +583,9 @@ class Dex2Oat FINAL {
       app_image_fd_(kInvalidFd),
       profile_file_fd_(kInvalidFd),
       timings_(timings),
-      force_determinism_(false)
+      force_determinism_(false),
+      compile_shard_index_(0u),
+      num_compile_shards_(0u)
       {}
 
   ~Dex2Oat() {
@@ -681,6 +722,18 @@ class Dex2Oat FINAL {
     }
   }
 
+  void ParseCompileShard(const StringPiece& option) {
+    DCHECK(option.starts_with("--compile-shard="));
+    std::vector<std::string> parts;
+    Split(option.substr(strlen("--compile-shard=")).ToString(), '/', &parts);
+    if (parts.size() != 2u ||
+        !ParseUint(parts[0].c_str(), &compile_shard_index_) ||
+        !ParseUint(parts[1].c_str(), &num_compile_shards_) ||
+        compile_shard_index_ >= num_compile_shards_) {
+      Usage("Invalid --compile-shard option %s, expected <index>/<count>", option.data());
+    }
+  }
+
   void ProcessOptions(ParserOptions* parser_options) {
     boot_image_ = !image_filenames_.empty();
     app_image_ = app_image_fd_ != -1 || !app_image_file_name_.empty();
@@ -904,6 +957,38 @@ class Dex2Oat FINAL {
       }
     }
     compiler_options_->force_determinism_ = force_determinism_;
+
+    if (!reuse_oat_filename_.empty()) {
+      if (IsImage()) {
+        Usage("--reuse-oat-file cannot be used when compiling an image");
+      }
+      // Keep the patches so that the output can be reused in turn.
+      compiler_options_->record_linker_patches_ = true;
+    }
+
+    if (num_compile_shards_ != 0u || !merge_shard_filenames_.empty()) {
+      if (IsImage()) {
+        Usage("Sharded compilation is not supported for images");
+      }
+      if (num_compile_shards_ != 0u && !merge_shard_filenames_.empty()) {
+        Usage("--compile-shard and --merge-shards cannot be used together");
+      }
+      if (!reuse_oat_filename_.empty()) {
+        Usage("--reuse-oat-file cannot be used with sharded compilation");
+      }
+    }
+    if (num_compile_shards_ != 0u) {
+      // The shards are merged with the help of the linker patches.
+      compiler_options_->record_linker_patches_ = true;
+    }
+
+    if (!compile_cache_dir_.empty() && IsImage()) {
+      Usage("--compile-cache-dir cannot be used when compiling an image");
+    }
+
+    if (swap_batch_size_ != 0u && swap_fd_ == kInvalidFd && swap_file_name_.empty()) {
+      Usage("--swap-batch-size requires --swap-file or --swap-fd");
+    }
   }
 
   static bool SupportsDeterministicCompilation() {
@@ -1014,6 +1099,11 @@ class Dex2Oat FINAL {
   void InsertCompileOptions(int argc, char** argv) {
     std::ostringstream oss;
     for (int i = 0; i < argc; ++i) {
+      // Leave out the shards to merge so that the merged oat file is the same as the one
+      // compiled by a single process.
+      if (StartsWith(argv[i], "--merge-shards=")) {
+        continue;
+      }
       if (i > 0) {
         oss << ' ';
       }
@@ -1146,6 +1236,8 @@ class Dex2Oat FINAL {
                         "--swap-dex-size-threshold",
                         &min_dex_file_cumulative_size_for_swap_,
                         Usage);
+      } else if (option.starts_with("--swap-batch-size=")) {
+        ParseUintOption(option, "--swap-batch-size", &swap_batch_size_, Usage);
       } else if (option.starts_with("--swap-dex-count-threshold=")) {
         ParseUintOption(option,
                         "--swap-dex-count-threshold",
@@ -1169,6 +1261,16 @@ class Dex2Oat FINAL {
         multi_image_ = true;
       } else if (option.starts_with("--no-inline-from=")) {
         no_inline_from_string_ = option.substr(strlen("--no-inline-from=")).data();
+      } else if (option.starts_with("--reuse-oat-file=")) {
+        reuse_oat_filename_ = option.substr(strlen("--reuse-oat-file=")).ToString();
+      } else if (option.starts_with("--compile-shard=")) {
+        ParseCompileShard(option);
+      } else if (option.starts_with("--merge-shards=")) {
+        Split(option.substr(strlen("--merge-shards=")).ToString(), ',', &merge_shard_filenames_);
+      } else if (option.starts_with("--compile-cache-dir=")) {
+        compile_cache_dir_ = option.substr(strlen("--compile-cache-dir=")).ToString();
+      } else if (option.starts_with("--compile-times-file=")) {
+        compile_times_filename_ = option.substr(strlen("--compile-times-file=")).ToString();
       } else if (option == "--force-determinism") {
         if (!SupportsDeterministicCompilation()) {
           Usage("Cannot use --force-determinism with read barriers or non-CMS garbage collector");
@@ -1325,6 +1427,10 @@ class Dex2Oat FINAL {
       return false;
     }
 
+    // The oat writers order the code by the profile, if any.
+    key_value_store_->Put(OatHeader::kCodeLayoutKey,
+                          (profile_compilation_info_ != nullptr) ? "profile" : "class-order");
+
     CreateOatWriters();
     if (!AddDexFileSources()) {
       return false;
@@ -1515,7 +1621,8 @@ class Dex2Oat FINAL {
   }
 
   // Create and invoke the compiler driver. This will compile all the dex files.
-  void Compile() {
+  // Returns false if the compiled shards to merge cannot be opened.
+  bool Compile() {
     TimingLogger::ScopedTiming t("dex2oat Compile", timings_);
     compiler_phases_timings_.reset(new CumulativeLogger("compilation times"));
 
@@ -1584,7 +1691,89 @@ class Dex2Oat FINAL {
                                      swap_fd_,
                                      profile_compilation_info_.get()));
     driver_->SetDexFilesForOatFile(dex_files_);
+    if (swap_batch_size_ != 0u) {
+      driver_->GetCompiledMethodStorage()->SetWriteBackBatchSize(swap_batch_size_);
+    }
+    if (!reuse_oat_filename_.empty()) {
+      TimingLogger::ScopedTiming t2("Find reusable classes", timings_);
+      std::string error_msg;
+      incremental_compilation_ = IncrementalCompilation::Create(reuse_oat_filename_,
+                                                                dex_files_,
+                                                                *driver_,
+                                                                *key_value_store_,
+                                                                image_file_location_oat_checksum_,
+                                                                &error_msg);
+      if (incremental_compilation_ == nullptr) {
+        LOG(WARNING) << error_msg << ". Compiling all classes.";
+      } else {
+        LOG(INFO) << "Reusing " << incremental_compilation_->GetNumberOfReusableClasses()
+                  << " of " << incremental_compilation_->GetNumberOfClasses()
+                  << " classes from " << reuse_oat_filename_;
+        driver_->SetIncrementalCompilation(incremental_compilation_.get());
+      }
+    }
+    if (num_compile_shards_ != 0u) {
+      driver_->SetCompileShard(compile_shard_index_, num_compile_shards_);
+    }
+    if (!compile_cache_dir_.empty()) {
+      TimingLogger::ScopedTiming t2("Open compile cache", timings_);
+      std::string error_msg;
+      compile_cache_ = CompileCache::Create(compile_cache_dir_,
+                                            dex_files_,
+                                            *driver_,
+                                            *key_value_store_,
+                                            image_file_location_oat_checksum_,
+                                            &error_msg);
+      if (compile_cache_ == nullptr) {
+        LOG(WARNING) << error_msg << ". Compiling without the compile cache.";
+      } else {
+        driver_->SetCompileCache(compile_cache_.get());
+      }
+    }
+    if (!merge_shard_filenames_.empty()) {
+      TimingLogger::ScopedTiming t2("Open compiled shards", timings_);
+      std::vector<IncrementalCompilation*> compiled_shards;
+      for (const std::string& shard_filename : merge_shard_filenames_) {
+        std::string error_msg;
+        std::unique_ptr<IncrementalCompilation> shard =
+            IncrementalCompilation::Create(shard_filename,
+                                           dex_files_,
+                                           *driver_,
+                                           *key_value_store_,
+                                           image_file_location_oat_checksum_,
+                                           &error_msg);
+        if (shard == nullptr) {
+          // Recompiling the classes of the shard here would silently hide a broken build.
+          LOG(ERROR) << "Failed to open compiled shard " << shard_filename << ": " << error_msg;
+          return false;
+        }
+        compiled_shards.push_back(shard.get());
+        compiled_shards_.push_back(std::move(shard));
+      }
+      driver_->SetCompiledShards(compiled_shards);
+    }
+    if (!compile_times_filename_.empty() && OS::FileExists(compile_times_filename_.c_str())) {
+      std::string error_msg;
+      if (!driver_->GetCompileScheduler()->ReadClassTimes(compile_times_filename_, &error_msg)) {
+        LOG(WARNING) << error_msg << ". Scheduling by code size.";
+      }
+    }
     driver_->CompileAll(class_loader_, dex_files_, timings_);
+    if (!compile_times_filename_.empty()) {
+      std::string error_msg;
+      if (!driver_->GetCompileScheduler()->WriteClassTimes(compile_times_filename_, &error_msg)) {
+        LOG(WARNING) << error_msg;
+      }
+    }
+    if (incremental_compilation_ != nullptr) {
+      VLOG(compiler) << "Reused the code of "
+                     << incremental_compilation_->GetNumberOfReusedMethods() << " methods";
+    }
+    for (const std::unique_ptr<IncrementalCompilation>& shard : compiled_shards_) {
+      VLOG(compiler) << "Merged the code of " << shard->GetNumberOfReusedMethods()
+                     << " methods from a shard";
+    }
+    return true;
   }
 
   // Notes on the interleaving of creating the images and oat files to
@@ -1875,6 +2064,18 @@ class Dex2Oat FINAL {
   void DumpTiming() {
     if (dump_timing_ || (dump_slow_timing_ && timings_->GetTotalNs() > MsToNs(1000))) {
       LOG(INFO) << Dumpable<TimingLogger>(*timings_);
+      if (compile_cache_ != nullptr) {
+        std::ostringstream oss;
+        compile_cache_->DumpStats(oss);
+        LOG(INFO) << oss.str();
+      }
+      if (driver_ != nullptr) {
+        std::ostringstream oss;
+        driver_->GetCompileScheduler()->DumpUtilization(oss);
+        if (!oss.str().empty()) {
+          LOG(INFO) << oss.str();
+        }
+      }
     }
     if (dump_passes_) {
       LOG(INFO) << Dumpable<CumulativeLogger>(*driver_->GetTimingsLogger());
@@ -1933,6 +2134,10 @@ class Dex2Oat FINAL {
 
  private:
   bool UseSwap(bool is_image, const std::vector<const DexFile*>& dex_files) {
+    if (swap_batch_size_ != 0u) {
+      // Swap was requested to bound the memory used by the compiled code.
+      return true;
+    }
     if (is_image) {
       // Don't use swap, we know generation should succeed, and we don't want to slow it down.
       return false;
@@ -2147,7 +2352,8 @@ class Dex2Oat FINAL {
                                                      compiler_options_.get(),
                                                      oat_file.get()));
       elf_writers_.back()->Start();
-      oat_writers_.emplace_back(new OatWriter(IsBootImage(), timings_));
+      oat_writers_.emplace_back(
+          new OatWriter(IsBootImage(), timings_, profile_compilation_info_.get()));
     }
   }
 
@@ -2481,6 +2687,7 @@ class Dex2Oat FINAL {
   // Dex files we are compiling, does not include the class path dex files.
   std::vector<const DexFile*> dex_files_;
   std::string no_inline_from_string_;
+  std::string reuse_oat_filename_;
   std::vector<jobject> dex_caches_;
   jobject class_loader_;
 
@@ -2489,6 +2696,8 @@ class Dex2Oat FINAL {
   std::vector<OutputStream*> rodata_;
   std::unique_ptr<ImageWriter> image_writer_;
   std::unique_ptr<CompilerDriver> driver_;
+  std::unique_ptr<IncrementalCompilation> incremental_compilation_;
+  std::unique_ptr<CompileCache> compile_cache_;
 
   std::vector<std::unique_ptr<MemMap>> opened_dex_files_maps_;
   std::vector<std::unique_ptr<OatFile>> opened_oat_files_;
@@ -2505,6 +2714,7 @@ class Dex2Oat FINAL {
   int swap_fd_;
   size_t min_dex_files_for_swap_ = kDefaultMinDexFilesForSwap;
   size_t min_dex_file_cumulative_size_for_swap_ = kDefaultMinDexFileCumulativeSizeForSwap;
+  size_t swap_batch_size_ = 0u;
   size_t very_large_threshold_ = std::numeric_limits<size_t>::max();
   std::string app_image_file_name_;
   int app_image_fd_;
@@ -2522,6 +2732,18 @@ class Dex2Oat FINAL {
   // See CompilerOptions.force_determinism_.
   bool force_determinism_;
 
+  // Sharded compilation, see CompilerDriver::SetCompileShard().
+  size_t compile_shard_index_;
+  size_t num_compile_shards_;
+  std::vector<std::string> merge_shard_filenames_;
+  std::vector<std::unique_ptr<IncrementalCompilation>> compiled_shards_;
+
+  // The directory of the on-disk cache of compiled methods, see CompileCache.
+  std::string compile_cache_dir_;
+
+  // The class compile times of the previous and this compilation, see CompileScheduler.
+  std::string compile_times_filename_;
+
   DISALLOW_IMPLICIT_CONSTRUCTORS(Dex2Oat);
 };
 
@@ -2547,7 +2769,10 @@ static void b13564922() {
 
 static int CompileImage(Dex2Oat& dex2oat) {
   dex2oat.LoadClassProfileDescriptors();
-  dex2oat.Compile();
+  if (!dex2oat.Compile()) {
+    dex2oat.EraseOatFiles();
+    return EXIT_FAILURE;
+  }
 
   if (!dex2oat.WriteOatFiles()) {
     dex2oat.EraseOatFiles();
@@ -2591,7 +2816,10 @@ static int CompileImage(Dex2Oat& dex2oat) {
 }
 
 static int CompileApp(Dex2Oat& dex2oat) {
-  dex2oat.Compile();
+  if (!dex2oat.Compile()) {
+    dex2oat.EraseOatFiles();
+    return EXIT_FAILURE;
+  }
 
   if (!dex2oat.WriteOatFiles()) {
     dex2oat.EraseOatFiles();
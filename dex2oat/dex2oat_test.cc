@@ -24,8 +24,11 @@
 #include "base/macros.h"
 #include "base/stringprintf.h"
 #include "dex2oat_environment_test.h"
+#include "gc/space/image_space.h"
+#include "image.h"
 #include "oat.h"
 #include "oat_file.h"
+#include "oat_file_assistant.h"
 #include "utils.h"
 
 #include <sys/wait.h>
@@ -416,4 +419,139 @@ TEST_F(Dex2oatVeryLargeTest, UseVeryLarge) {
   RunTest(CompilerFilter::kSpeed, true, { "--very-large-app-threshold=100" });
 }
 
+class Dex2oatShardTest : public Dex2oatTest {
+ protected:
+  static constexpr size_t kNumShards = 3u;
+
+  // Compile each shard of the dex file into its own oat file and return the oat files.
+  std::vector<std::string> CompileShards(const std::string& dex_location) {
+    std::vector<std::string> shard_locations;
+    for (size_t i = 0; i != kNumShards; ++i) {
+      std::string shard_location = GetOdexDir() + StringPrintf("/Shard%zu.odex", i);
+      GenerateOdexForTest(dex_location,
+                          shard_location,
+                          CompilerFilter::kSpeed,
+                          { "-j1", StringPrintf("--compile-shard=%zu/%zu", i, kNumShards) });
+      shard_locations.push_back(shard_location);
+    }
+    return shard_locations;
+  }
+};
+
+TEST_F(Dex2oatShardTest, MergedShardsMatchSingleProcess) {
+  std::string dex_location = GetScratchDir() + "/Dex2OatShardTest.jar";
+  std::string odex_location = GetOdexDir() + "/Dex2OatShardTest.odex";
+
+  Copy(GetMultiDexSrc1(), dex_location);
+
+  // Use a single compiler thread so that the code is laid out the same way in every run.
+  GenerateOdexForTest(dex_location, odex_location, CompilerFilter::kSpeed, { "-j1" });
+  std::string expected;
+  ASSERT_TRUE(ReadFileToString(odex_location, &expected));
+  ASSERT_EQ(0, unlink(odex_location.c_str()));
+
+  std::vector<std::string> shard_locations = CompileShards(dex_location);
+  if (HasFatalFailure()) {
+    return;
+  }
+  // Merge into the same oat file name, which is part of the oat file contents.
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kSpeed,
+                      { "-j1", "--merge-shards=" + Join(shard_locations, ',') });
+  std::string merged;
+  ASSERT_TRUE(ReadFileToString(odex_location, &merged));
+
+  ASSERT_EQ(expected.size(), merged.size());
+  EXPECT_TRUE(expected == merged);
+}
+
+TEST_F(Dex2oatShardTest, MissingShardFailsMerge) {
+  std::string dex_location = GetScratchDir() + "/Dex2OatShardTest.jar";
+  std::string odex_location = GetOdexDir() + "/Dex2OatShardTest.odex";
+
+  Copy(GetMultiDexSrc1(), dex_location);
+
+  std::vector<std::string> shard_locations = CompileShards(dex_location);
+  if (HasFatalFailure()) {
+    return;
+  }
+  ASSERT_EQ(0, unlink(shard_locations[1].c_str()));
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kSpeed,
+                      { "-j1", "--merge-shards=" + Join(shard_locations, ',') },
+                      /* expect_success */ false);
+  if (!kIsTargetBuild) {
+    EXPECT_NE(output_.find("Failed to open compiled shard " + shard_locations[1]),
+              std::string::npos)
+        << output_;
+  }
+}
+
+class Dex2oatIncrementalTest : public Dex2oatTest {};
+
+TEST_F(Dex2oatIncrementalTest, RecompileDependentsOfChangedClass) {
+  std::string dex_location = GetScratchDir() + "/Dex2OatIncrementalTest.jar";
+  std::string previous_odex_location = GetOdexDir() + "/Dex2OatIncrementalTestPrevious.odex";
+  std::string odex_location = GetOdexDir() + "/Dex2OatIncrementalTest.odex";
+
+  Copy(GetTestDexFileName("ClassDependencies"), dex_location);
+  GenerateOdexForTest(dex_location,
+                      previous_odex_location,
+                      CompilerFilter::kSpeed,
+                      { "--record-linker-patches" });
+
+  // Only the code of Value changes. FieldUser and ReturnUser do not reference Value in their
+  // code, but the field they load and the method they call have the type Value, so they must
+  // be compiled again. Holder, Factory and Unrelated are reused.
+  Copy(GetTestDexFileName("ClassDependenciesModified"), dex_location);
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kSpeed,
+                      { "--reuse-oat-file=" + previous_odex_location });
+  if (!kIsTargetBuild) {
+    EXPECT_NE(output_.find("Reusing 3 of 6 classes"), std::string::npos) << output_;
+  }
+}
+
+class Dex2oatAppImageTest : public Dex2oatTest {};
+
+TEST_F(Dex2oatAppImageTest, LoadCompressedAppImage) {
+  std::string dex_location = GetScratchDir() + "/Dex2OatAppImageTest.jar";
+  std::string odex_location = GetOdexDir() + "/Dex2OatAppImageTest.odex";
+  std::string app_image_location = GetOdexDir() + "/Dex2OatAppImageTest.art";
+
+  Copy(GetDexSrc1(), dex_location);
+
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kSpeed,
+                      { "--app-image-file=" + app_image_location, "--image-format=lz4" });
+
+  std::string error_msg;
+  std::unique_ptr<OatFile> odex_file(OatFile::Open(odex_location.c_str(),
+                                                   odex_location.c_str(),
+                                                   nullptr,
+                                                   nullptr,
+                                                   /*executable*/ true,
+                                                   /*low_4gb*/ false,
+                                                   dex_location.c_str(),
+                                                   &error_msg));
+  ASSERT_TRUE(odex_file != nullptr) << error_msg;
+
+  // Open the app image the way the oat file manager does, which holds the mutator lock while
+  // the image is decompressed.
+  OatFileAssistant oat_file_assistant(dex_location.c_str(),
+                                      kRuntimeISA,
+                                      /*profile_changed*/ false,
+                                      /*load_executable*/ true);
+  std::unique_ptr<gc::space::ImageSpace> image_space(
+      oat_file_assistant.OpenImageSpace(odex_file.get()));
+  ASSERT_TRUE(image_space != nullptr);
+  const ImageHeader& image_header = image_space->GetImageHeader();
+  EXPECT_TRUE(image_header.IsAppImage());
+  EXPECT_EQ(ImageHeader::kStorageModeLZ4, image_header.GetStorageMode());
+}
+
 }  // namespace art
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/stringpiece.h"
+#include "base/stringprintf.h"
+#include "base/unix_file/fd_file.h"
+#include "dex/dex_layout.h"
+#include "dex_file.h"
+#include "jit/offline_profiling_info.h"
+#include "mem_map.h"
+#include "os.h"
+#include "utils.h"
+
+namespace art {
+
+static int original_argc;
+static char** original_argv;
+
+static std::string CommandLine() {
+  std::vector<std::string> command;
+  for (int i = 0; i < original_argc; ++i) {
+    command.push_back(original_argv[i]);
+  }
+  return Join(command, ' ');
+}
+
+static void UsageErrorV(const char* fmt, va_list ap) {
+  std::string error;
+  StringAppendV(&error, fmt, ap);
+  LOG(ERROR) << error;
+}
+
+static void UsageError(const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  UsageErrorV(fmt, ap);
+  va_end(ap);
+}
+
+NO_RETURN static void Usage(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  UsageErrorV(fmt, ap);
+  va_end(ap);
+
+  UsageError("Command: %s", CommandLine().c_str());
+  UsageError("Usage: dexlayout [options]...");
+  UsageError("");
+  UsageError("  --dex-file=<filename>: the dex, jar or apk file to lay out.");
+  UsageError("");
+  UsageError("  --dex-location=<string>: the location of the dex file as seen at runtime, used");
+  UsageError("      to find the dex file in the profile. Defaults to --dex-file.");
+  UsageError("");
+  UsageError("  --profile-file=<filename>: the profile used to order the code items and strings.");
+  UsageError("");
+  UsageError("  --output-dir=<directory>: where the laid out dex files are written, named");
+  UsageError("      classes.dex, classes2.dex, ... like the entries of a multidex apk.");
+  UsageError("");
+
+  exit(EXIT_FAILURE);
+}
+
+class DexLayoutTool FINAL {
+ public:
+  DexLayoutTool() {}
+
+  void ParseArgs(int argc, char **argv) {
+    original_argc = argc;
+    original_argv = argv;
+
+    InitLogging(argv);
+
+    // Skip over the command name.
+    argv++;
+    argc--;
+
+    if (argc == 0) {
+      Usage("No arguments specified");
+    }
+
+    for (int i = 0; i < argc; ++i) {
+      const StringPiece option(argv[i]);
+      if (option.starts_with("--dex-file=")) {
+        dex_file_ = option.substr(strlen("--dex-file=")).ToString();
+      } else if (option.starts_with("--dex-location=")) {
+        dex_location_ = option.substr(strlen("--dex-location=")).ToString();
+      } else if (option.starts_with("--profile-file=")) {
+        profile_file_ = option.substr(strlen("--profile-file=")).ToString();
+      } else if (option.starts_with("--output-dir=")) {
+        output_dir_ = option.substr(strlen("--output-dir=")).ToString();
+      } else {
+        Usage("Unknown argument '%s'", option.data());
+      }
+    }
+
+    if (dex_file_.empty()) {
+      Usage("No dex file specified.");
+    }
+    if (profile_file_.empty()) {
+      Usage("No profile file specified.");
+    }
+    if (output_dir_.empty()) {
+      Usage("No output directory specified.");
+    }
+    if (dex_location_.empty()) {
+      dex_location_ = dex_file_;
+    }
+  }
+
+  int Run() {
+    MemMap::Init();
+
+    ProfileCompilationInfo profile;
+    std::unique_ptr<File> profile_file(OS::OpenFileForReading(profile_file_.c_str()));
+    if (profile_file == nullptr || !profile.Load(profile_file->Fd())) {
+      LOG(ERROR) << "Failed to load profile " << profile_file_;
+      return EXIT_FAILURE;
+    }
+
+    std::string error_msg;
+    std::vector<std::unique_ptr<const DexFile>> dex_files;
+    if (!DexFile::Open(dex_file_.c_str(), dex_location_.c_str(), &error_msg, &dex_files)) {
+      LOG(ERROR) << "Failed to open dex file " << dex_file_ << ": " << error_msg;
+      return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i != dex_files.size(); ++i) {
+      std::vector<uint8_t> output;
+      if (!DexLayout::Layout(*dex_files[i], profile, &output, &error_msg)) {
+        LOG(ERROR) << "Failed to lay out " << dex_files[i]->GetLocation() << ": " << error_msg;
+        return EXIT_FAILURE;
+      }
+      std::string output_file = (i == 0u)
+          ? StringPrintf("%s/classes.dex", output_dir_.c_str())
+          : StringPrintf("%s/classes%zu.dex", output_dir_.c_str(), i + 1u);
+      if (!WriteOutput(output_file, output)) {
+        return EXIT_FAILURE;
+      }
+    }
+    return EXIT_SUCCESS;
+  }
+
+ private:
+  static bool WriteOutput(const std::string& output_file, const std::vector<uint8_t>& output) {
+    std::unique_ptr<File> file(OS::CreateEmptyFile(output_file.c_str()));
+    if (file == nullptr) {
+      PLOG(ERROR) << "Failed to create " << output_file;
+      return false;
+    }
+    if (!file->WriteFully(output.data(), output.size())) {
+      PLOG(ERROR) << "Failed to write " << output_file;
+      file->Erase();
+      return false;
+    }
+    if (file->FlushCloseOrErase() != 0) {
+      PLOG(ERROR) << "Failed to flush and close " << output_file;
+      return false;
+    }
+    return true;
+  }
+
+  std::string dex_file_;
+  std::string dex_location_;
+  std::string profile_file_;
+  std::string output_dir_;
+
+  DISALLOW_COPY_AND_ASSIGN(DexLayoutTool);
+};
+
+static int dexlayout(int argc, char** argv) {
+  DexLayoutTool dexlayout;
+
+  // Parse arguments. Argument mistakes will lead to exit(EXIT_FAILURE) in UsageError.
+  dexlayout.ParseArgs(argc, argv);
+  return dexlayout.Run();
+}
+
+}  // namespace art
+
+int main(int argc, char **argv) {
+  return art::dexlayout(argc, argv);
+}
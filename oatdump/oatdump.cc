@@ -41,6 +41,7 @@
 #include "gc/space/image_space.h"
 #include "gc/space/large_object_space.h"
 #include "gc/space/space-inl.h"
+#include "id_lookup_table.h"
 #include "image-inl.h"
 #include "indenter.h"
 #include "linker/buffered_output_stream.h"
@@ -288,6 +289,7 @@ class OatDumperOptions {
                    const char* method_filter,
                    bool list_classes,
                    bool list_methods,
+                   bool dump_code_layout,
                    bool dump_header_only,
                    const char* export_dex_location,
                    const char* app_image,
@@ -301,6 +303,7 @@ class OatDumperOptions {
       method_filter_(method_filter),
       list_classes_(list_classes),
       list_methods_(list_methods),
+      dump_code_layout_(dump_code_layout),
       dump_header_only_(dump_header_only),
       export_dex_location_(export_dex_location),
       app_image_(app_image),
@@ -316,6 +319,7 @@ class OatDumperOptions {
   const char* const method_filter_;
   const bool list_classes_;
   const bool list_methods_;
+  const bool dump_code_layout_;
   const bool dump_header_only_;
   const char* const export_dex_location_;
   const char* const app_image_;
@@ -414,6 +418,9 @@ class OatDumper {
     os << "IMAGE FILE LOCATION OAT BEGIN:\n";
     os << StringPrintf("0x%08x\n\n", oat_header.GetImageFileLocationOatDataBegin());
 
+    os << "LINKER PATCHES OFFSET:\n";
+    os << StringPrintf("0x%08x\n\n", oat_header.GetLinkerPatchesOffset());
+
     // Print the key-value store.
     {
       os << "KEY VALUE STORE:\n";
@@ -448,6 +455,9 @@ class OatDumper {
     }
 
     if (!options_.dump_header_only_) {
+      DumpCodeLayout(os);
+      os << std::flush;
+
       for (size_t i = 0; i < oat_dex_files_.size(); i++) {
         const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[i];
         CHECK(oat_dex_file != nullptr);
@@ -568,6 +578,90 @@ class OatDumper {
     offsets_.insert(oat_method.GetVmapTableOffset());
   }
 
+  struct CodeLayoutEntry {
+    uint32_t code_offset;
+    uint32_t code_size;
+    const DexFile* dex_file;
+    uint32_t dex_method_idx;
+  };
+
+  // Summarize how the compiled code is ordered in the text section. The methods are listed in
+  // class definition order and a method is counted as out of order when its code precedes the
+  // code of the method before it. Shared (deduplicated) code is counted once.
+  void DumpCodeLayout(std::ostream& os) {
+    std::vector<CodeLayoutEntry> entries;
+    for (const OatFile::OatDexFile* oat_dex_file : oat_dex_files_) {
+      CHECK(oat_dex_file != nullptr);
+      std::string error_msg;
+      const DexFile* const dex_file = OpenDexFile(oat_dex_file, &error_msg);
+      if (dex_file == nullptr) {
+        continue;
+      }
+      for (size_t class_def_index = 0;
+           class_def_index < dex_file->NumClassDefs();
+           class_def_index++) {
+        const DexFile::ClassDef& class_def = dex_file->GetClassDef(class_def_index);
+        const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(class_def_index);
+        const uint8_t* class_data = dex_file->GetClassData(class_def);
+        if (class_data == nullptr) {
+          continue;
+        }
+        ClassDataItemIterator it(*dex_file, class_data);
+        SkipAllFields(it);
+        for (uint32_t class_method_index = 0;
+             it.HasNextDirectMethod() || it.HasNextVirtualMethod();
+             ++class_method_index, it.Next()) {
+          const OatFile::OatMethod oat_method = oat_class.GetOatMethod(class_method_index);
+          uint32_t code_offset = AlignCodeOffset(oat_method.GetCodeOffset());
+          if (code_offset == 0u) {
+            continue;
+          }
+          entries.push_back(CodeLayoutEntry {
+              code_offset, oat_method.GetQuickCodeSize(), dex_file, it.GetMemberIndex() });
+        }
+      }
+    }
+
+    std::set<uint32_t> seen_code;
+    size_t code_bytes = 0u;
+    size_t out_of_order = 0u;
+    uint32_t last_code_offset = 0u;
+    for (const CodeLayoutEntry& entry : entries) {
+      if (!seen_code.insert(entry.code_offset).second) {
+        continue;
+      }
+      code_bytes += entry.code_size;
+      if (entry.code_offset < last_code_offset) {
+        ++out_of_order;
+      }
+      last_code_offset = entry.code_offset;
+    }
+
+    const char* layout = oat_file_.GetOatHeader().GetStoreValueByKey(OatHeader::kCodeLayoutKey);
+    os << "CODE LAYOUT:\n";
+    os << StringPrintf("%s: %zu methods with code, %zu distinct, %zu bytes, "
+                       "%zu out of class order\n",
+                       (layout != nullptr) ? layout : "class-order",
+                       entries.size(),
+                       seen_code.size(),
+                       code_bytes,
+                       out_of_order);
+    if (options_.dump_code_layout_) {
+      std::stable_sort(entries.begin(),
+                       entries.end(),
+                       [](const CodeLayoutEntry& lhs, const CodeLayoutEntry& rhs) {
+                         return lhs.code_offset < rhs.code_offset;
+                       });
+      for (const CodeLayoutEntry& entry : entries) {
+        os << StringPrintf("0x%08x %6u %s\n",
+                           entry.code_offset,
+                           entry.code_size,
+                           PrettyMethod(entry.dex_method_idx, *entry.dex_file, true).c_str());
+      }
+    }
+    os << "\n";
+  }
+
   bool DumpOatDexFile(std::ostream& os, const OatFile::OatDexFile& oat_dex_file) {
     bool success = true;
     bool stop_analysis = false;
@@ -601,6 +695,14 @@ class OatDumper {
                          table_offset,
                          table_offset + table_size - 1);
     }
+    if (oat_dex_file.GetIdLookupTableData() != nullptr) {
+      uint32_t table_offset = dchecked_integral_cast<uint32_t>(
+          oat_dex_file.GetIdLookupTableData() - oat_file_begin);
+      uint32_t table_size = IdLookupTable::RawDataLength(*dex_file);
+      os << StringPrintf("id-table: 0x%08x..0x%08x\n",
+                         table_offset,
+                         table_offset + table_size - 1);
+    }
 
     VariableIndentationOutputStream vios(&os);
     ScopedIndentation indent1(&vios);
@@ -1815,10 +1917,19 @@ class ImageDumper {
     } else if (method->IsRuntimeMethod()) {
       ImtConflictTable* table = method->GetImtConflictTable(image_header_.GetPointerSize());
       if (table != nullptr) {
-        indent_os << "IMT conflict table " << table << " method: ";
-        for (size_t i = 0, count = table->NumEntries(pointer_size); i < count; ++i) {
-          indent_os << PrettyMethod(table->GetImplementationMethod(i, pointer_size)) << " ";
-        }
+        const size_t num_entries = table->NumEntries(pointer_size);
+        const bool hashed = table->IsHashed(pointer_size);
+        stats_.imt_conflict_tables += 1;
+        stats_.imt_conflict_table_entries += num_entries;
+        stats_.imt_conflict_tables_hashed += hashed ? 1u : 0u;
+        stats_.imt_conflict_table_max_entries =
+            std::max(stats_.imt_conflict_table_max_entries, num_entries);
+        indent_os << "IMT conflict table " << table << (hashed ? " (hashed)" : "") << " method: ";
+        table->Visit([&indent_os](const std::pair<ArtMethod*, ArtMethod*>& methods)
+            SHARED_REQUIRES(Locks::mutator_lock_) {
+          indent_os << PrettyMethod(methods.second) << " ";
+          return methods;
+        }, pointer_size);
       }
     } else {
       const DexFile::CodeItem* code_item = method->GetCodeItem();
@@ -1908,6 +2019,11 @@ class ImageDumper {
 
     size_t dex_instruction_bytes;
 
+    size_t imt_conflict_tables;
+    size_t imt_conflict_tables_hashed;
+    size_t imt_conflict_table_entries;
+    size_t imt_conflict_table_max_entries;
+
     std::vector<ArtMethod*> method_outlier;
     std::vector<size_t> method_outlier_size;
     std::vector<double> method_outlier_expansion;
@@ -1933,7 +2049,11 @@ class ImageDumper {
           large_initializer_code_bytes(0),
           large_method_code_bytes(0),
           vmap_table_bytes(0),
-          dex_instruction_bytes(0) {}
+          dex_instruction_bytes(0),
+          imt_conflict_tables(0),
+          imt_conflict_tables_hashed(0),
+          imt_conflict_table_entries(0),
+          imt_conflict_table_max_entries(0) {}
 
     struct SizeAndCount {
       SizeAndCount(size_t bytes_in, size_t count_in) : bytes(bytes_in), count(count_in) {}
@@ -2162,6 +2282,13 @@ class ImageDumper {
                              static_cast<double>(dex_instruction_bytes))
          << std::flush;
 
+      os << StringPrintf("imt_conflict_tables = %zd (%zd hashed, %zd entries, max %zd)\n\n",
+                         imt_conflict_tables,
+                         imt_conflict_tables_hashed,
+                         imt_conflict_table_entries,
+                         imt_conflict_table_max_entries)
+         << std::flush;
+
       DumpOutliers(os);
     }
   } stats_;
@@ -2406,6 +2533,8 @@ struct OatdumpArgs : public CmdlineArgs {
       list_classes_ = true;
     } else if (option.starts_with("--list-methods")) {
       list_methods_ = true;
+    } else if (option == "--dump-code-layout") {
+      dump_code_layout_ = true;
     } else if (option.starts_with("--export-dex-to=")) {
       export_dex_location_ = option.substr(strlen("--export-dex-to=")).data();
     } else if (option.starts_with("--addr2instr=")) {
@@ -2494,6 +2623,10 @@ struct OatdumpArgs : public CmdlineArgs {
         "      Example: --list-methods\n"
         "      Example: --list-methods --class-filter=com.example --method-filter=foo\n"
         "\n"
+        "  --dump-code-layout may be used to list the compiled methods in the order of their\n"
+        "      code in the text section.\n"
+        "      Example: --dump-code-layout\n"
+        "\n"
         "  --symbolize=<file.oat>: output a copy of file.oat with elf symbols included.\n"
         "      Example: --symbolize=/system/framework/boot.oat\n"
         "\n"
@@ -2531,6 +2664,7 @@ struct OatdumpArgs : public CmdlineArgs {
   bool only_keep_debug_ = false;
   bool list_classes_ = false;
   bool list_methods_ = false;
+  bool dump_code_layout_ = false;
   bool dump_header_only_ = false;
   uint32_t addr2instr_ = 0;
   const char* export_dex_location_ = nullptr;
@@ -2554,6 +2688,7 @@ struct OatdumpMain : public CmdlineMain<OatdumpArgs> {
         args_->method_filter_,
         args_->list_classes_,
         args_->list_methods_,
+        args_->dump_code_layout_,
         args_->dump_header_only_,
         args_->export_dex_location_,
         args_->app_image_,
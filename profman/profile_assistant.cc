@@ -16,8 +16,20 @@
 
 #include "profile_assistant.h"
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <ostream>
+
+#include "atomic.h"
+#include "base/casts.h"
+#include "base/time_utils.h"
 #include "base/unix_file/fd_file.h"
 #include "os.h"
+#include "safe_map.h"
+#include "utils.h"
 
 namespace art {
 
@@ -153,4 +165,264 @@ ProfileAssistant::ProcessingResult ProfileAssistant::ProcessProfiles(
                                  reference_profile_file_flock);
 }
 
+namespace {
+
+// The profiles being aggregated, shared by the aggregating threads. The threads first count the
+// checksums of the dex files in the profiles, so that the checksums of the majority of the
+// profiles can be selected. Then each thread merges the profiles with these checksums into its
+// own profile and counts, so that it holds a single input profile at a time.
+struct ProfileAggregation {
+  // The number of profiles with each dex file key and checksum.
+  typedef SafeMap<std::pair<std::string, uint32_t>, size_t> ChecksumCounts;
+
+  struct ThreadResult {
+    ProfileAggregation* aggregation = nullptr;
+    ChecksumCounts checksum_counts;
+    ProfileCompilationInfo info;
+    ProfileCompilationInfo::ProfileCounts counts;
+    size_t number_of_bad_profiles = 0u;
+    size_t number_of_mismatched_profiles = 0u;
+  };
+
+  ProfileAggregation(const std::vector<std::string>& files, size_t thread_count)
+      : profile_files(files),
+        loaded(files.size(), 0u),
+        results(thread_count),
+        next_index(0u) {
+    for (ThreadResult& result : results) {
+      result.aggregation = this;
+    }
+  }
+
+  // Run `callback` on the results of this thread and of up to results.size() - 1 more threads.
+  // Returns the number of threads used.
+  size_t RunOnThreads(void* (*callback)(void*)) {
+    next_index.StoreRelaxed(0u);
+    std::vector<pthread_t> threads;
+    for (size_t i = 1; i < results.size(); ++i) {
+      pthread_t thread;
+      if (pthread_create(&thread, nullptr, callback, &results[i]) != 0) {
+        // Aggregate with the threads we have.
+        break;
+      }
+      threads.push_back(thread);
+    }
+    callback(&results[0]);
+    for (pthread_t thread : threads) {
+      CHECK_PTHREAD_CALL(pthread_join, (thread, nullptr), "profile aggregation thread");
+    }
+    return threads.size() + 1u;
+  }
+
+  bool LoadProfile(size_t index, ProfileCompilationInfo* info) {
+    int fd = open(profile_files[index].c_str(), O_RDONLY);
+    if (fd < 0) {
+      PLOG(WARNING) << "Could not open profile " << profile_files[index];
+      return false;
+    }
+    bool success = info->Load(fd);
+    close(fd);
+    if (!success) {
+      LOG(WARNING) << "Could not load profile " << profile_files[index];
+    }
+    return success;
+  }
+
+  void CountChecksums(ThreadResult* result) {
+    for (size_t i = next_index.FetchAndAddSequentiallyConsistent(1u);
+         i < profile_files.size();
+         i = next_index.FetchAndAddSequentiallyConsistent(1u)) {
+      ProfileCompilationInfo info;
+      if (!LoadProfile(i, &info)) {
+        ++result->number_of_bad_profiles;
+        continue;
+      }
+      loaded[i] = 1u;
+      for (const auto& it : info.GetDexFileChecksums()) {
+        auto count_it = result->checksum_counts.find(it);
+        if (count_it == result->checksum_counts.end()) {
+          result->checksum_counts.Put(it, 1u);
+        } else {
+          ++count_it->second;
+        }
+      }
+    }
+  }
+
+  // Keep the checksum of each dex file that the most profiles have. Ties go to the lowest
+  // checksum, so that the result does not depend on the order of the profiles.
+  void SelectChecksums() {
+    ChecksumCounts total;
+    for (const ThreadResult& result : results) {
+      for (const auto& it : result.checksum_counts) {
+        auto total_it = total.find(it.first);
+        if (total_it == total.end()) {
+          total.Put(it.first, it.second);
+        } else {
+          total_it->second += it.second;
+        }
+      }
+    }
+    SafeMap<std::string, size_t> max_counts;
+    for (const auto& it : total) {
+      const std::string& dex_key = it.first.first;
+      auto max_it = max_counts.find(dex_key);
+      if (max_it == max_counts.end()) {
+        max_counts.Put(dex_key, it.second);
+        checksums.Put(dex_key, it.first.second);
+      } else if (it.second > max_it->second) {
+        max_it->second = it.second;
+        checksums.Overwrite(dex_key, it.first.second);
+      }
+    }
+  }
+
+  void AggregateAll(ThreadResult* result) {
+    for (size_t i = next_index.FetchAndAddSequentiallyConsistent(1u);
+         i < profile_files.size();
+         i = next_index.FetchAndAddSequentiallyConsistent(1u)) {
+      if (loaded[i] == 0u) {
+        // Counted as bad when counting the checksums.
+        continue;
+      }
+      ProfileCompilationInfo info;
+      if (!LoadProfile(i, &info)) {
+        ++result->number_of_bad_profiles;
+        continue;
+      }
+      if (!HasSelectedChecksums(info) ||
+          !info.AddToCounts(&result->counts) ||
+          !result->info.MergeWith(info)) {
+        LOG(WARNING) << "Skipping profile " << profile_files[i] << " with other dex files";
+        ++result->number_of_mismatched_profiles;
+        continue;
+      }
+    }
+  }
+
+  bool HasSelectedChecksums(const ProfileCompilationInfo& info) const {
+    for (const auto& it : info.GetDexFileChecksums()) {
+      auto checksum_it = checksums.find(it.first);
+      if (checksum_it == checksums.end() || checksum_it->second != it.second) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static void* CountChecksumsCallback(void* arg) {
+    ThreadResult* result = reinterpret_cast<ThreadResult*>(arg);
+    result->aggregation->CountChecksums(result);
+    return nullptr;
+  }
+
+  static void* AggregateAllCallback(void* arg) {
+    ThreadResult* result = reinterpret_cast<ThreadResult*>(arg);
+    result->aggregation->AggregateAll(result);
+    return nullptr;
+  }
+
+  const std::vector<std::string>& profile_files;
+  // Whether each profile could be loaded when counting the checksums. Each entry is written by
+  // a single thread.
+  std::vector<uint8_t> loaded;
+  std::vector<ThreadResult> results;
+  Atomic<size_t> next_index;
+  // The selected checksum of each dex file, written before aggregating.
+  SafeMap<std::string, uint32_t> checksums;
+};
+
+}  // namespace
+
+ProfileAssistant::ProcessingResult ProfileAssistant::AggregateProfiles(
+        const std::vector<std::string>& profile_files,
+        const std::string& output_file,
+        uint32_t min_frequency_percent,
+        size_t thread_count,
+        /*out*/AggregationStats* stats) {
+  DCHECK_LE(min_frequency_percent, 100u);
+  uint64_t start_ns = NanoTime();
+  thread_count = std::max<size_t>(std::min(thread_count, profile_files.size()), 1u);
+  ProfileAggregation aggregation(profile_files, thread_count);
+
+  // Select the checksums in a first pass, so that the profiles of an old version of the dex
+  // files cannot win because they were loaded first.
+  aggregation.RunOnThreads(&ProfileAggregation::CountChecksumsCallback);
+  aggregation.SelectChecksums();
+  size_t number_of_threads = aggregation.RunOnThreads(&ProfileAggregation::AggregateAllCallback);
+
+  // Merge the results of the threads. Their dex files all have the same checksums.
+  ProfileAggregation::ThreadResult& total = aggregation.results[0];
+  for (size_t i = 1; i < aggregation.results.size(); ++i) {
+    ProfileAggregation::ThreadResult& result = aggregation.results[i];
+    CHECK(total.info.MergeWith(result.info));
+    CHECK(ProfileCompilationInfo::MergeCounts(result.counts, &total.counts));
+    total.number_of_bad_profiles += result.number_of_bad_profiles;
+    total.number_of_mismatched_profiles += result.number_of_mismatched_profiles;
+    // Free the memory of the thread as we go.
+    result = ProfileAggregation::ThreadResult();
+  }
+
+  stats->number_of_profiles = profile_files.size();
+  stats->number_of_bad_profiles = total.number_of_bad_profiles;
+  stats->number_of_mismatched_profiles = total.number_of_mismatched_profiles;
+  stats->number_of_threads = number_of_threads;
+  size_t number_of_aggregated_profiles = stats->GetNumberOfAggregatedProfiles();
+  if (number_of_aggregated_profiles == 0u) {
+    LOG(WARNING) << "Could not aggregate any profile";
+    stats->time_ns = NanoTime() - start_ns;
+    return kErrorBadProfiles;
+  }
+
+  // Keep the methods and classes that are in at least min_frequency_percent percent of the
+  // profiles, rounding the number of profiles up.
+  uint64_t min_count =
+      (static_cast<uint64_t>(min_frequency_percent) * number_of_aggregated_profiles + 99u) / 100u;
+  stats->min_count = std::max<uint32_t>(dchecked_integral_cast<uint32_t>(min_count), 1u);
+  stats->method_frequency_histogram.assign(10u, 0u);
+  for (const auto& it : total.counts) {
+    for (uint32_t count : it.second.methods) {
+      if (count != 0u) {
+        size_t tenth = (10u * count - 1u) / number_of_aggregated_profiles;
+        ++stats->method_frequency_histogram[tenth];
+      }
+    }
+  }
+  stats->number_of_methods = total.info.GetNumberOfMethods();
+  stats->number_of_classes = total.info.GetNumberOfResolvedClasses();
+  total.info.RetainFrequent(total.counts, stats->min_count);
+  stats->number_of_retained_methods = total.info.GetNumberOfMethods();
+  stats->number_of_retained_classes = total.info.GetNumberOfResolvedClasses();
+
+  std::unique_ptr<File> out(OS::CreateEmptyFileWriteOnly(output_file.c_str()));
+  if (out == nullptr) {
+    PLOG(WARNING) << "Could not create aggregated profile " << output_file;
+    stats->time_ns = NanoTime() - start_ns;
+    return kErrorIO;
+  }
+  bool saved = total.info.Save(out->Fd());
+  if (out->FlushCloseOrErase() != 0 || !saved) {
+    LOG(WARNING) << "Could not write aggregated profile " << output_file;
+    stats->time_ns = NanoTime() - start_ns;
+    return kErrorIO;
+  }
+  stats->time_ns = NanoTime() - start_ns;
+  return kCompile;
+}
+
+void ProfileAssistant::AggregationStats::Dump(std::ostream& os) const {
+  os << "Aggregated " << GetNumberOfAggregatedProfiles() << " of " << number_of_profiles
+     << " profiles in " << PrettyDuration(time_ns) << " with " << number_of_threads
+     << " threads\n";
+  os << "Skipped " << number_of_bad_profiles << " unreadable profiles and "
+     << number_of_mismatched_profiles << " profiles with other dex files\n";
+  os << "Kept the methods and classes of at least " << min_count << " profiles\n";
+  os << "Methods: " << number_of_retained_methods << " of " << number_of_methods << "\n";
+  os << "Classes: " << number_of_retained_classes << " of " << number_of_classes << "\n";
+  for (size_t i = 0; i != method_frequency_histogram.size(); ++i) {
+    os << "Methods in " << (10u * i) << "-" << (10u * (i + 1u)) << "% of the profiles: "
+       << method_frequency_histogram[i] << "\n";
+  }
+}
+
 }  // namespace art
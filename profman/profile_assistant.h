@@ -17,6 +17,7 @@
 #ifndef ART_PROFMAN_PROFILE_ASSISTANT_H_
 #define ART_PROFMAN_PROFILE_ASSISTANT_H_
 
+#include <iosfwd>
 #include <string>
 #include <vector>
 
@@ -59,6 +60,48 @@ class ProfileAssistant {
       const std::vector<int>& profile_files_fd_,
       int reference_profile_file_fd);
 
+  // Statistics of AggregateProfiles().
+  struct AggregationStats {
+    // The input profiles, those that could not be read and those whose dex files have other
+    // checksums than in most profiles.
+    size_t number_of_profiles = 0u;
+    size_t number_of_bad_profiles = 0u;
+    size_t number_of_mismatched_profiles = 0u;
+    // The number of profiles a method or class must be in to be kept.
+    uint32_t min_count = 0u;
+    // The methods and classes of all the profiles and those kept.
+    uint32_t number_of_methods = 0u;
+    uint32_t number_of_retained_methods = 0u;
+    uint32_t number_of_classes = 0u;
+    uint32_t number_of_retained_classes = 0u;
+    // The number of methods by the percentage of the profiles they are in, by tenths rounded
+    // up: the first entry counts the methods in at most 10% of the profiles.
+    std::vector<uint32_t> method_frequency_histogram;
+    size_t number_of_threads = 0u;
+    uint64_t time_ns = 0u;
+
+    size_t GetNumberOfAggregatedProfiles() const {
+      return number_of_profiles - number_of_bad_profiles - number_of_mismatched_profiles;
+    }
+
+    void Dump(std::ostream& os) const;
+  };
+
+  // Aggregate many profiles, for example those uploaded by many devices, into `output_file`.
+  // The output keeps the methods and classes that are in at least `min_frequency_percent`
+  // percent of the profiles that could be aggregated. The profiles are loaded one at a time
+  // by each of `thread_count` threads, so the memory used does not grow with their number.
+  // Profiles that cannot be read are skipped. So are the profiles whose dex files have other
+  // checksums than in most of the profiles, for example profiles of an older version of the APK.
+  //
+  // Returns kCompile on success, kErrorBadProfiles if no profile could be aggregated and
+  // kErrorIO if the output cannot be written.
+  static ProcessingResult AggregateProfiles(const std::vector<std::string>& profile_files,
+                                            const std::string& output_file,
+                                            uint32_t min_frequency_percent,
+                                            size_t thread_count,
+                                            /*out*/AggregationStats* stats);
+
  private:
   static ProcessingResult ProcessProfilesInternal(
       const std::vector<ScopedFlock>& profile_files,
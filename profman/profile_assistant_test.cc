@@ -80,6 +80,30 @@ class ProfileAssistantTest : public CommonRuntimeTest {
     std::string error;
     return ExecAndReturnCode(argv_str, &error);
   }
+
+  int AggregateProfiles(const std::vector<std::string>& profile_files,
+                        const std::string& output_file,
+                        uint32_t min_frequency_percent) {
+    std::string file_path = GetTestAndroidRoot();
+    file_path += "/bin/profman";
+    if (kIsDebugBuild) {
+      file_path += "d";
+    }
+
+    EXPECT_TRUE(OS::FileExists(file_path.c_str())) << file_path << " should be a valid file path";
+    std::vector<std::string> argv_str;
+    argv_str.push_back(file_path);
+    argv_str.push_back("--aggregate-profiles");
+    for (const std::string& profile_file : profile_files) {
+      argv_str.push_back("--profile-file=" + profile_file);
+    }
+    argv_str.push_back("--output-profile-file=" + output_file);
+    argv_str.push_back("--min-frequency-percent=" + std::to_string(min_frequency_percent));
+    argv_str.push_back("-j2");
+
+    std::string error;
+    return ExecAndReturnCode(argv_str, &error);
+  }
 };
 
 TEST_F(ProfileAssistantTest, AdviseCompilationEmptyReferences) {
@@ -282,4 +306,92 @@ TEST_F(ProfileAssistantTest, FailProcessingBecauseOfReferenceProfiles) {
   CheckProfileInfo(profile1, info1);
 }
 
+TEST_F(ProfileAssistantTest, AggregateProfiles) {
+  ScratchFile profile1;
+  ScratchFile profile2;
+  ScratchFile profile3;
+  ScratchFile rare_profile;
+  ScratchFile mismatched_profile;
+  ScratchFile bad_profile;
+  ScratchFile output_profile;
+
+  // The first three profiles have the same methods and classes, the rare methods are only in
+  // one profile.
+  ProfileCompilationInfo info1;
+  SetupProfile("p1", 1, 10, 5, profile1, &info1);
+  ProfileCompilationInfo info2;
+  SetupProfile("p1", 1, 10, 5, profile2, &info2);
+  ProfileCompilationInfo info3;
+  SetupProfile("p1", 1, 10, 5, profile3, &info3);
+  ProfileCompilationInfo rare_info;
+  SetupProfile("p1", 1, 10, 0, rare_profile, &rare_info, /* start_method_index */ 100);
+  // The same dex files with other checksums, and a profile that cannot be loaded.
+  ProfileCompilationInfo mismatched_info;
+  SetupProfile("p1", 2, 20, 0, mismatched_profile, &mismatched_info);
+  ASSERT_TRUE(bad_profile.GetFile()->WriteFully("bad profile", strlen("bad profile")));
+  ASSERT_EQ(0, bad_profile.GetFile()->Flush());
+
+  std::vector<std::string> profile_files({
+      profile1.GetFilename(),
+      profile2.GetFilename(),
+      profile3.GetFilename(),
+      rare_profile.GetFilename(),
+      mismatched_profile.GetFilename(),
+      bad_profile.GetFilename()});
+
+  // Without a threshold, the output is the merge of the profiles that can be aggregated.
+  ASSERT_EQ(ProfileAssistant::kCompile,
+            AggregateProfiles(profile_files, output_profile.GetFilename(), 0u));
+  ProfileCompilationInfo expected;
+  ASSERT_TRUE(expected.MergeWith(info1));
+  ASSERT_TRUE(expected.MergeWith(rare_info));
+  ProfileCompilationInfo result;
+  ASSERT_TRUE(output_profile.GetFile()->ResetOffset());
+  ASSERT_TRUE(result.Load(GetFd(output_profile)));
+  ASSERT_TRUE(expected.Equals(result));
+
+  // The rare methods are in one of the four profiles aggregated, less than 50%.
+  ASSERT_EQ(ProfileAssistant::kCompile,
+            AggregateProfiles(profile_files, output_profile.GetFilename(), 50u));
+  CheckProfileInfo(output_profile, info1);
+
+  // The inputs must remain the same.
+  CheckProfileInfo(profile1, info1);
+  CheckProfileInfo(rare_profile, rare_info);
+}
+
+TEST_F(ProfileAssistantTest, AggregateProfilesWithMostCommonChecksums) {
+  ScratchFile old_profile;
+  ScratchFile profile1;
+  ScratchFile profile2;
+  ScratchFile output_profile;
+
+  // The profile of an older version of the dex files comes first, it must not win.
+  ProfileCompilationInfo old_info;
+  SetupProfile("p1", 2, 20, 5, old_profile, &old_info, /* start_method_index */ 100);
+  ProfileCompilationInfo info1;
+  SetupProfile("p1", 1, 10, 5, profile1, &info1);
+  ProfileCompilationInfo info2;
+  SetupProfile("p1", 1, 10, 5, profile2, &info2);
+
+  std::vector<std::string> profile_files({
+      old_profile.GetFilename(),
+      profile1.GetFilename(),
+      profile2.GetFilename()});
+  ASSERT_EQ(ProfileAssistant::kCompile,
+            AggregateProfiles(profile_files, output_profile.GetFilename(), 0u));
+  CheckProfileInfo(output_profile, info1);
+}
+
+TEST_F(ProfileAssistantTest, FailAggregationBecauseOfProfiles) {
+  ScratchFile bad_profile;
+  ScratchFile output_profile;
+  ASSERT_TRUE(bad_profile.GetFile()->WriteFully("bad profile", strlen("bad profile")));
+  ASSERT_EQ(0, bad_profile.GetFile()->Flush());
+
+  std::vector<std::string> profile_files({bad_profile.GetFilename()});
+  ASSERT_EQ(ProfileAssistant::kErrorBadProfiles,
+            AggregateProfiles(profile_files, output_profile.GetFilename(), 50u));
+}
+
 }  // namespace art
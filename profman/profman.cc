@@ -22,6 +22,7 @@
 #include <unistd.h>
 
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -84,6 +85,22 @@ NO_RETURN static void Usage(const char *fmt, ...) {
   UsageError("  --dump-output-to-fd=<number>: redirects --dump-info-for output to a file");
   UsageError("      descriptor.");
   UsageError("");
+  UsageError("  --aggregate-profiles: merges many profiles, for example uploaded by many devices,");
+  UsageError("      into --output-profile-file and prints statistics to standard output, or to");
+  UsageError("      --dump-output-to-fd. The profiles are given with --profile-file or");
+  UsageError("      --profile-file-list.");
+  UsageError("");
+  UsageError("  --profile-file-list=<filename>: a file listing profiles to aggregate, one per line.");
+  UsageError("");
+  UsageError("  --output-profile-file=<filename>: the aggregated profile.");
+  UsageError("");
+  UsageError("  --min-frequency-percent=<number>: only keep the methods and classes that are in");
+  UsageError("      at least this percentage of the aggregated profiles. Defaults to 0, keeping");
+  UsageError("      the methods and classes of any profile.");
+  UsageError("");
+  UsageError("  -j<number>: the number of threads aggregating profiles.");
+  UsageError("      Defaults to the number of processors.");
+  UsageError("");
   UsageError("  --profile-file=<filename>: specify profiler output file to use for compilation.");
   UsageError("      Can be specified multiple time, in which case the data from the different");
   UsageError("      profiles will be aggregated.");
@@ -117,6 +134,9 @@ class ProfMan FINAL {
       reference_profile_file_fd_(kInvalidFd),
       dump_only_(false),
       dump_output_to_fd_(kInvalidFd),
+      aggregate_profiles_(false),
+      min_frequency_percent_(0u),
+      thread_count_(sysconf(_SC_NPROCESSORS_ONLN)),
       start_ns_(NanoTime()) {}
 
   ~ProfMan() {
@@ -159,11 +179,40 @@ class ProfMan FINAL {
         dex_locations_.push_back(option.substr(strlen("--dex-location=")).ToString());
       } else if (option.starts_with("--apk-fd=")) {
         ParseFdForCollection(option, "--apk-fd", &apks_fd_);
+      } else if (option == "--aggregate-profiles") {
+        aggregate_profiles_ = true;
+      } else if (option.starts_with("--profile-file-list=")) {
+        ReadProfileFileList(option.substr(strlen("--profile-file-list=")).ToString());
+      } else if (option.starts_with("--output-profile-file=")) {
+        output_profile_file_ = option.substr(strlen("--output-profile-file=")).ToString();
+      } else if (option.starts_with("--min-frequency-percent=")) {
+        ParseUintOption(option, "--min-frequency-percent", &min_frequency_percent_, Usage);
+        if (min_frequency_percent_ > 100u) {
+          Usage("--min-frequency-percent should be at most 100");
+        }
+      } else if (option.starts_with("-j")) {
+        ParseUintOption(option, "-j", &thread_count_, Usage, /* is_long_option */ false);
+        if (thread_count_ == 0u) {
+          Usage("-j should be at least 1");
+        }
       } else {
         Usage("Unknown argument '%s'", option.data());
       }
     }
 
+    if (aggregate_profiles_) {
+      if (profile_files_.empty()) {
+        Usage("No profile files specified for --aggregate-profiles.");
+      }
+      if (!profile_files_fd_.empty() || dump_only_) {
+        Usage("--aggregate-profiles should not be used with --profile-file-fd or --dump-only");
+      }
+      if (output_profile_file_.empty()) {
+        Usage("No output profile file specified for --aggregate-profiles.");
+      }
+      return;
+    }
+
     bool has_profiles = !profile_files_.empty() || !profile_files_fd_.empty();
     bool has_reference_profile = !reference_profile_file_.empty() ||
         FdIsValid(reference_profile_file_fd_);
@@ -203,6 +252,23 @@ class ProfMan FINAL {
     return result;
   }
 
+  ProfileAssistant::ProcessingResult AggregateProfiles() {
+    ProfileAssistant::AggregationStats stats;
+    ProfileAssistant::ProcessingResult result = ProfileAssistant::AggregateProfiles(
+        profile_files_, output_profile_file_, min_frequency_percent_, thread_count_, &stats);
+    std::ostringstream oss;
+    stats.Dump(oss);
+    if (!FdIsValid(dump_output_to_fd_)) {
+      std::cout << oss.str();
+    } else {
+      unix_file::FdFile out_fd(dump_output_to_fd_, false /*check_usage*/);
+      if (!out_fd.WriteFully(oss.str().c_str(), oss.str().length())) {
+        return ProfileAssistant::kErrorIO;
+      }
+    }
+    return result;
+  }
+
   int DumpOneProfile(const std::string& banner, const std::string& filename, int fd,
                      const std::vector<const DexFile*>* dex_files, std::string* dump) {
     if (!filename.empty()) {
@@ -315,6 +381,10 @@ class ProfMan FINAL {
     return dump_only_;
   }
 
+  bool ShouldAggregateProfiles() {
+    return aggregate_profiles_;
+  }
+
  private:
   static void ParseFdForCollection(const StringPiece& option,
                                    const char* arg_name,
@@ -324,6 +394,15 @@ class ProfMan FINAL {
     fds->push_back(fd);
   }
 
+  void ReadProfileFileList(const std::string& filename) {
+    std::string content;
+    if (!ReadFileToString(filename, &content)) {
+      Usage("Failed to read profile file list '%s'", filename.c_str());
+    }
+    // Split skips the empty lines.
+    Split(content, '\n', &profile_files_);
+  }
+
   static void CloseAllFds(const std::vector<int>& fds, const char* descriptor) {
     for (size_t i = 0; i < fds.size(); i++) {
       if (close(fds[i]) < 0) {
@@ -348,6 +427,10 @@ class ProfMan FINAL {
   int reference_profile_file_fd_;
   bool dump_only_;
   int dump_output_to_fd_;
+  bool aggregate_profiles_;
+  std::string output_profile_file_;
+  uint32_t min_frequency_percent_;
+  size_t thread_count_;
   uint64_t start_ns_;
 };
 
@@ -361,6 +444,9 @@ static int profman(int argc, char** argv) {
   if (profman.ShouldOnlyDumpProfile()) {
     return profman.DumpProfileInfo();
   }
+  if (profman.ShouldAggregateProfiles()) {
+    return profman.AggregateProfiles();
+  }
   // Process profile information and assess if we need to do a profile guided compilation.
   // This operation involves I/O.
   return profman.ProcessProfiles();
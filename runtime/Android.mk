@@ -23,6 +23,7 @@ LIBART_COMMON_SRC_FILES := \
   art_method.cc \
   atomic.cc.arm \
   barrier.cc \
+  base/adler32.cc \
   base/allocator.cc \
   base/arena_allocator.cc \
   base/arena_bit_vector.cc \
@@ -85,6 +86,7 @@ LIBART_COMMON_SRC_FILES := \
   gc/space/zygote_space.cc \
   gc/task_processor.cc \
   hprof/hprof.cc \
+  id_lookup_table.cc \
   image.cc \
   indirect_reference_table.cc \
   instrumentation.cc \
@@ -179,6 +181,7 @@ LIBART_COMMON_SRC_FILES := \
   signal_catcher.cc \
   stack.cc \
   stack_map.cc \
+  startup_timeline.cc \
   thread.cc \
   thread_list.cc \
   thread_pool.cc \
@@ -511,6 +511,25 @@ inline void ArtMethod::UpdateEntrypoints(const Visitor& visitor, size_t pointer_
   }
 }
 
+template<typename Visitor>
+inline void ImtConflictTable::CopyFrom(ImtConflictTable* other,
+                                       const Visitor& visitor,
+                                       size_t pointer_size) {
+  DCHECK_EQ(NumEntries(pointer_size), 0u);
+  DCHECK_EQ(GetHeaderField(kHeaderMask, pointer_size),
+            ComputeMask(other->NumEntries(pointer_size)));
+  for (size_t slot = 0, num_slots = other->NumUsedSlots(pointer_size); slot < num_slots; ++slot) {
+    ArtMethod* interface_method = other->GetInterfaceMethod(slot, pointer_size);
+    if (interface_method != nullptr) {
+      // Hash with the original method, `visitor` may return an address that is not mapped.
+      Insert(Hash(interface_method->GetDexMethodIndex()),
+             visitor(interface_method),
+             visitor(other->GetImplementationMethod(slot, pointer_size)),
+             pointer_size);
+    }
+  }
+}
+
 }  // namespace art
 
 #endif  // ART_RUNTIME_ART_METHOD_INL_H_
@@ -47,6 +47,75 @@ extern "C" void art_quick_invoke_stub(ArtMethod*, uint32_t*, uint32_t, Thread*,
 extern "C" void art_quick_invoke_static_stub(ArtMethod*, uint32_t*, uint32_t, Thread*, JValue*,
                                              const char*);
 
+ImtConflictTable::ImtConflictTable(ImtConflictTable* other,
+                                   ArtMethod* interface_method,
+                                   ArtMethod* implementation_method,
+                                   size_t pointer_size)
+    : ImtConflictTable(other->NumEntries(pointer_size) + 1u, pointer_size) {
+  for (size_t slot = 0, num_slots = other->NumUsedSlots(pointer_size); slot < num_slots; ++slot) {
+    ArtMethod* other_interface_method = other->GetInterfaceMethod(slot, pointer_size);
+    if (other_interface_method != nullptr) {
+      AddEntry(other_interface_method,
+               other->GetImplementationMethod(slot, pointer_size),
+               pointer_size);
+    }
+  }
+  AddEntry(interface_method, implementation_method, pointer_size);
+}
+
+void ImtConflictTable::AddEntry(ArtMethod* interface_method,
+                                ArtMethod* implementation_method,
+                                size_t pointer_size) {
+  Insert(Hash(interface_method->GetDexMethodIndex()),
+         interface_method,
+         implementation_method,
+         pointer_size);
+}
+
+void ImtConflictTable::Insert(uint32_t hash,
+                              ArtMethod* interface_method,
+                              ArtMethod* implementation_method,
+                              size_t pointer_size) {
+  DCHECK(interface_method != nullptr);
+  size_t slot = hash & GetHeaderField(kHeaderMask, pointer_size);
+  while (GetInterfaceMethod(slot, pointer_size) != nullptr) {
+    ++slot;
+  }
+  SetInterfaceMethod(slot, pointer_size, interface_method);
+  SetImplementationMethod(slot, pointer_size, implementation_method);
+  SetHeaderField(kHeaderNumEntries, pointer_size, NumEntries(pointer_size) + 1u);
+}
+
+ArtMethod* ImtConflictTable::Lookup(ArtMethod* interface_method, size_t pointer_size) const {
+  // Same lookup as the assembly stubs.
+  size_t slot = Hash(interface_method->GetDexMethodIndex()) &
+      GetHeaderField(kHeaderMask, pointer_size);
+  for (;; ++slot) {
+    ArtMethod* current_interface_method = GetInterfaceMethod(slot, pointer_size);
+    if (current_interface_method == nullptr) {
+      return nullptr;
+    }
+    if (current_interface_method == interface_method) {
+      return GetImplementationMethod(slot, pointer_size);
+    }
+  }
+}
+
+bool ImtConflictTable::Equals(ImtConflictTable* other, size_t pointer_size) const {
+  if (NumEntries(pointer_size) != other->NumEntries(pointer_size)) {
+    return false;
+  }
+  for (size_t slot = 0, num_slots = NumUsedSlots(pointer_size); slot < num_slots; ++slot) {
+    ArtMethod* interface_method = GetInterfaceMethod(slot, pointer_size);
+    if (interface_method != nullptr &&
+        other->Lookup(interface_method, pointer_size) !=
+            GetImplementationMethod(slot, pointer_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 ArtMethod* ArtMethod::FromReflectedMethod(const ScopedObjectAccessAlreadyRunnable& soa,
                                           jobject jlr_method) {
   auto* abstract_method = soa.Decode<mirror::AbstractMethod*>(jlr_method);
@@ -47,9 +47,16 @@ class PointerArray;
 
 // Table to resolve IMT conflicts at runtime. The table is attached to
 // the jni entrypoint of IMT conflict ArtMethods.
-// The table contains a list of pairs of { interface_method, implementation_method }
-// with the last entry being null to make an assembly implementation of a lookup
-// faster.
+// The table starts with a header holding a hash mask and the number of entries,
+// followed by slots of pairs { interface_method, implementation_method }.
+// The assembly stubs start the lookup at slot (Hash(dex method index of the interface
+// method) & mask) and scan forward until they find the interface method or a null slot.
+// Small tables have a zero mask: the entries are stored from slot 0 and followed
+// by a null slot, so that the lookup is a linear scan. Tables with more than
+// kMaxLinearEntries entries are open addressed over mask + 1 slots, with overflow
+// slots for probing past the end and a final null slot, so that probes never wrap.
+// The dex method index does not change when methods are relocated, so the slots
+// can be relocated in place.
 class ImtConflictTable {
   enum MethodIndex {
     kMethodInterface,
@@ -57,137 +64,183 @@ class ImtConflictTable {
     kMethodCount,  // Number of elements in enum.
   };
 
+  enum HeaderIndex {
+    kHeaderMask,
+    kHeaderNumEntries,
+    kHeaderCount,  // Number of elements in enum.
+  };
+
+  static_assert(static_cast<size_t>(kHeaderCount) == static_cast<size_t>(kMethodCount),
+                "The header should take the space of one slot");
+
  public:
+  // Tables with more entries are hashed.
+  static constexpr size_t kMaxLinearEntries = 8;
+
+  // The entries of a table share the IMT index, that is, the low bits of their dex method
+  // indices are often the same. Fold the higher bits in.
+  static constexpr size_t kHashShift = 6;
+
+  static uint32_t Hash(uint32_t dex_method_index) {
+    return dex_method_index ^ (dex_method_index >> kHashShift);
+  }
+
   // Build a new table copying `other` and adding the new entry formed of
   // the pair { `interface_method`, `implementation_method` }
   ImtConflictTable(ImtConflictTable* other,
                    ArtMethod* interface_method,
                    ArtMethod* implementation_method,
-                   size_t pointer_size) {
-    const size_t count = other->NumEntries(pointer_size);
-    for (size_t i = 0; i < count; ++i) {
-      SetInterfaceMethod(i, pointer_size, other->GetInterfaceMethod(i, pointer_size));
-      SetImplementationMethod(i, pointer_size, other->GetImplementationMethod(i, pointer_size));
-    }
-    SetInterfaceMethod(count, pointer_size, interface_method);
-    SetImplementationMethod(count, pointer_size, implementation_method);
-    // Add the null marker.
-    SetInterfaceMethod(count + 1, pointer_size, nullptr);
-    SetImplementationMethod(count + 1, pointer_size, nullptr);
-  }
+                   size_t pointer_size) SHARED_REQUIRES(Locks::mutator_lock_);
 
-  // num_entries excludes the header.
+  // Build an empty table with room for `num_entries` entries, see AddEntry().
   ImtConflictTable(size_t num_entries, size_t pointer_size) {
-    SetInterfaceMethod(num_entries, pointer_size, nullptr);
-    SetImplementationMethod(num_entries, pointer_size, nullptr);
-  }
-
-  // Set an entry at an index.
-  void SetInterfaceMethod(size_t index, size_t pointer_size, ArtMethod* method) {
-    SetMethod(index * kMethodCount + kMethodInterface, pointer_size, method);
-  }
-
-  void SetImplementationMethod(size_t index, size_t pointer_size, ArtMethod* method) {
-    SetMethod(index * kMethodCount + kMethodImplementation, pointer_size, method);
+    SetHeaderField(kHeaderMask, pointer_size, ComputeMask(num_entries));
+    SetHeaderField(kHeaderNumEntries, pointer_size, 0u);
+    for (size_t i = 0, num_slots = ComputeNumSlots(num_entries); i < num_slots; ++i) {
+      SetInterfaceMethod(i, pointer_size, nullptr);
+      SetImplementationMethod(i, pointer_size, nullptr);
+    }
   }
 
-  ArtMethod* GetInterfaceMethod(size_t index, size_t pointer_size) const {
-    return GetMethod(index * kMethodCount + kMethodInterface, pointer_size);
-  }
+  // Add the pair { `interface_method`, `implementation_method` }. The table must have
+  // been built with room for it.
+  void AddEntry(ArtMethod* interface_method,
+                ArtMethod* implementation_method,
+                size_t pointer_size) SHARED_REQUIRES(Locks::mutator_lock_);
 
-  ArtMethod* GetImplementationMethod(size_t index, size_t pointer_size) const {
-    return GetMethod(index * kMethodCount + kMethodImplementation, pointer_size);
-  }
+  // Add the entries of `other`, which must be empty and have the same capacity, passing
+  // each method through `visitor`. Used to relocate a table.
+  template<typename Visitor>
+  void CopyFrom(ImtConflictTable* other, const Visitor& visitor, size_t pointer_size)
+      SHARED_REQUIRES(Locks::mutator_lock_);
 
-  // Return true if two conflict tables are the same.
-  bool Equals(ImtConflictTable* other, size_t pointer_size) const {
-    size_t num = NumEntries(pointer_size);
-    if (num != other->NumEntries(pointer_size)) {
-      return false;
-    }
-    for (size_t i = 0; i < num; ++i) {
-      if (GetInterfaceMethod(i, pointer_size) != other->GetInterfaceMethod(i, pointer_size) ||
-          GetImplementationMethod(i, pointer_size) !=
-              other->GetImplementationMethod(i, pointer_size)) {
-        return false;
-      }
-    }
-    return true;
-  }
+  // Return true if two conflict tables have the same entries.
+  bool Equals(ImtConflictTable* other, size_t pointer_size) const
+      SHARED_REQUIRES(Locks::mutator_lock_);
 
   // Visit all of the entries.
   // NO_THREAD_SAFETY_ANALYSIS for calling with held locks. Visitor is passed a pair of ArtMethod*
   // and also returns one. The order is <interface, implementation>.
   template<typename Visitor>
   void Visit(const Visitor& visitor, size_t pointer_size) NO_THREAD_SAFETY_ANALYSIS {
-    uint32_t table_index = 0;
-    for (;;) {
-      ArtMethod* interface_method = GetInterfaceMethod(table_index, pointer_size);
+    for (size_t slot = 0, num_slots = NumUsedSlots(pointer_size); slot < num_slots; ++slot) {
+      ArtMethod* interface_method = GetInterfaceMethod(slot, pointer_size);
       if (interface_method == nullptr) {
-        break;
+        continue;
       }
-      ArtMethod* implementation_method = GetImplementationMethod(table_index, pointer_size);
+      ArtMethod* implementation_method = GetImplementationMethod(slot, pointer_size);
       auto input = std::make_pair(interface_method, implementation_method);
       std::pair<ArtMethod*, ArtMethod*> updated = visitor(input);
       if (input.first != updated.first) {
-        SetInterfaceMethod(table_index, pointer_size, updated.first);
+        SetInterfaceMethod(slot, pointer_size, updated.first);
       }
       if (input.second != updated.second) {
-        SetImplementationMethod(table_index, pointer_size, updated.second);
+        SetImplementationMethod(slot, pointer_size, updated.second);
       }
-      ++table_index;
     }
   }
 
   // Lookup the implementation ArtMethod associated to `interface_method`. Return null
   // if not found.
-  ArtMethod* Lookup(ArtMethod* interface_method, size_t pointer_size) const {
-    uint32_t table_index = 0;
-    for (;;) {
-      ArtMethod* current_interface_method = GetInterfaceMethod(table_index, pointer_size);
-      if (current_interface_method == nullptr) {
-        break;
-      }
-      if (current_interface_method == interface_method) {
-        return GetImplementationMethod(table_index, pointer_size);
-      }
-      ++table_index;
-    }
-    return nullptr;
-  }
+  ArtMethod* Lookup(ArtMethod* interface_method, size_t pointer_size) const
+      SHARED_REQUIRES(Locks::mutator_lock_);
 
-  // Compute the number of entries in this table.
+  // Return the number of entries in this table.
   size_t NumEntries(size_t pointer_size) const {
-    uint32_t table_index = 0;
-    while (GetInterfaceMethod(table_index, pointer_size) != nullptr) {
-      ++table_index;
-    }
-    return table_index;
+    return GetHeaderField(kHeaderNumEntries, pointer_size);
+  }
+
+  // Return true if lookups in this table are hashed rather than linear.
+  bool IsHashed(size_t pointer_size) const {
+    return GetHeaderField(kHeaderMask, pointer_size) != 0u;
   }
 
   // Compute the size in bytes taken by this table.
   size_t ComputeSize(size_t pointer_size) const {
-    // Add the end marker.
     return ComputeSize(NumEntries(pointer_size), pointer_size);
   }
 
   // Compute the size in bytes needed for copying the given `table` and add
   // one more entry.
   static size_t ComputeSizeWithOneMoreEntry(ImtConflictTable* table, size_t pointer_size) {
-    return table->ComputeSize(pointer_size) + EntrySize(pointer_size);
+    return ComputeSize(table->NumEntries(pointer_size) + 1u, pointer_size);
   }
 
   // Compute size with a fixed number of entries.
   static size_t ComputeSize(size_t num_entries, size_t pointer_size) {
-    return (num_entries + 1) * EntrySize(pointer_size);  // Add one for null terminator.
+    // Add one for the header.
+    return (ComputeNumSlots(num_entries) + 1u) * EntrySize(pointer_size);
   }
 
   static size_t EntrySize(size_t pointer_size) {
     return pointer_size * static_cast<size_t>(kMethodCount);
   }
 
+  // Offset of the first slot, used by the assembly stubs.
+  static size_t SlotsOffset(size_t pointer_size) {
+    return EntrySize(pointer_size);
+  }
+
  private:
+  static size_t ComputeMask(size_t num_entries) {
+    return (num_entries > kMaxLinearEntries) ? RoundUpToPowerOfTwo(num_entries * 2u) - 1u : 0u;
+  }
+
+  static size_t ComputeNumSlots(size_t num_entries) {
+    size_t mask = ComputeMask(num_entries);
+    // A probe starting in the last hashed slot needs up to num_entries slots to find a free
+    // one, and one more null slot ends the lookups. Linear tables need the null slot only.
+    return (mask != 0u) ? mask + 1u + num_entries : num_entries + 1u;
+  }
+
+  // Number of slots that may hold entries.
+  size_t NumUsedSlots(size_t pointer_size) const {
+    size_t mask = GetHeaderField(kHeaderMask, pointer_size);
+    return (mask != 0u ? mask + 1u : 0u) + NumEntries(pointer_size);
+  }
+
+  // Insert an entry, starting the probe at the slot for `hash`.
+  void Insert(uint32_t hash,
+              ArtMethod* interface_method,
+              ArtMethod* implementation_method,
+              size_t pointer_size);
+
+  void SetInterfaceMethod(size_t slot, size_t pointer_size, ArtMethod* method) {
+    SetMethod(slot * kMethodCount + kMethodInterface, pointer_size, method);
+  }
+
+  void SetImplementationMethod(size_t slot, size_t pointer_size, ArtMethod* method) {
+    SetMethod(slot * kMethodCount + kMethodImplementation, pointer_size, method);
+  }
+
+  ArtMethod* GetInterfaceMethod(size_t slot, size_t pointer_size) const {
+    return GetMethod(slot * kMethodCount + kMethodInterface, pointer_size);
+  }
+
+  ArtMethod* GetImplementationMethod(size_t slot, size_t pointer_size) const {
+    return GetMethod(slot * kMethodCount + kMethodImplementation, pointer_size);
+  }
+
+  size_t GetHeaderField(HeaderIndex index, size_t pointer_size) const {
+    if (pointer_size == 8) {
+      return dchecked_integral_cast<size_t>(data64_[index]);
+    } else {
+      DCHECK_EQ(pointer_size, 4u);
+      return data32_[index];
+    }
+  }
+
+  void SetHeaderField(HeaderIndex index, size_t pointer_size, size_t value) {
+    if (pointer_size == 8) {
+      data64_[index] = value;
+    } else {
+      DCHECK_EQ(pointer_size, 4u);
+      data32_[index] = dchecked_integral_cast<uint32_t>(value);
+    }
+  }
+
   ArtMethod* GetMethod(size_t index, size_t pointer_size) const {
+    index += kHeaderCount;
     if (pointer_size == 8) {
       return reinterpret_cast<ArtMethod*>(static_cast<uintptr_t>(data64_[index]));
     } else {
@@ -197,6 +250,7 @@ class ImtConflictTable {
   }
 
   void SetMethod(size_t index, size_t pointer_size, ArtMethod* method) {
+    index += kHeaderCount;
     if (pointer_size == 8) {
       data64_[index] = dchecked_integral_cast<uint64_t>(reinterpret_cast<uintptr_t>(method));
     } else {
@@ -205,7 +259,7 @@ class ImtConflictTable {
     }
   }
 
-  // Array of entries that the assembly stubs will iterate over. Note that this is
+  // Header and slots that the assembly stubs will look up. Note that this is
   // not fixed size, and we allocate data prior to calling the constructor
   // of ImtConflictTable.
   union {
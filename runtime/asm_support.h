@@ -290,6 +290,10 @@ ADD_TEST_EQ(MIRROR_STRING_COUNT_OFFSET, art::mirror::String::CountOffset().Int32
 ADD_TEST_EQ(MIRROR_STRING_VALUE_OFFSET, art::mirror::String::ValueOffset().Int32Value())
 
 // Offsets within java.lang.reflect.ArtMethod.
+#define ART_METHOD_DEX_METHOD_INDEX_OFFSET 12
+ADD_TEST_EQ(ART_METHOD_DEX_METHOD_INDEX_OFFSET,
+            art::ArtMethod::DexMethodIndexOffset().Int32Value())
+
 #define ART_METHOD_DEX_CACHE_METHODS_OFFSET_32 20
 ADD_TEST_EQ(ART_METHOD_DEX_CACHE_METHODS_OFFSET_32,
             art::ArtMethod::DexCacheResolvedMethodsOffset(4).Int32Value())
@@ -322,6 +326,20 @@ ADD_TEST_EQ(ART_METHOD_QUICK_CODE_OFFSET_32,
 ADD_TEST_EQ(ART_METHOD_QUICK_CODE_OFFSET_64,
             art::ArtMethod::EntryPointFromQuickCompiledCodeOffset(8).Int32Value())
 
+// Offsets within ImtConflictTable. The hash mask is the first pointer sized field.
+#define IMT_CONFLICT_TABLE_MASK_OFFSET 0
+#define IMT_CONFLICT_TABLE_HASH_SHIFT 6
+ADD_TEST_EQ(static_cast<size_t>(IMT_CONFLICT_TABLE_HASH_SHIFT),
+            art::ImtConflictTable::kHashShift)
+
+#define IMT_CONFLICT_TABLE_SLOTS_OFFSET_32 8
+ADD_TEST_EQ(static_cast<size_t>(IMT_CONFLICT_TABLE_SLOTS_OFFSET_32),
+            art::ImtConflictTable::SlotsOffset(4))
+
+#define IMT_CONFLICT_TABLE_SLOTS_OFFSET_64 16
+ADD_TEST_EQ(static_cast<size_t>(IMT_CONFLICT_TABLE_SLOTS_OFFSET_64),
+            art::ImtConflictTable::SlotsOffset(8))
+
 #define LOCK_WORD_STATE_SHIFT 30
 ADD_TEST_EQ(LOCK_WORD_STATE_SHIFT, static_cast<int32_t>(art::LockWord::kStateShift))
 
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "base/adler32.h"
+
+#include <zlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+
+namespace art {
+
+#if defined(__SSE2__)
+
+static constexpr uint32_t kAdler32Base = 65521u;
+// The largest number of bytes processed before reducing the sums, as in zlib.
+static constexpr size_t kAdler32MaxBlockSize = 5552u;
+static constexpr size_t kAdler32ChunkSize = 32u;
+
+static uint64_t HorizontalSum(__m128i v) {
+  alignas(16) uint32_t lanes[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+  return static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+uint32_t Adler32(uint32_t adler, const uint8_t* data, size_t size) {
+  uint32_t s1 = adler & 0xffffu;
+  uint32_t s2 = adler >> 16;
+  const __m128i zero = _mm_setzero_si128();
+  // The weights of the bytes of a chunk in s2, relative to the end of the chunk.
+  const __m128i weights1 = _mm_setr_epi16(32, 31, 30, 29, 28, 27, 26, 25);
+  const __m128i weights2 = _mm_setr_epi16(24, 23, 22, 21, 20, 19, 18, 17);
+  const __m128i weights3 = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+  const __m128i weights4 = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+  while (size >= kAdler32ChunkSize) {
+    const size_t num_chunks = std::min(size, kAdler32MaxBlockSize) / kAdler32ChunkSize;
+    const size_t block_size = num_chunks * kAdler32ChunkSize;
+    // Each chunk adds the sum of the previous chunks of the block 32 times to s2, accumulate
+    // these prefix sums in `v_prefix` and the weighted bytes of each chunk in `v_s2`.
+    __m128i v_s1 = zero;
+    __m128i v_s2 = zero;
+    __m128i v_prefix = zero;
+    for (size_t i = 0; i != num_chunks; ++i) {
+      const __m128i bytes1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+      const __m128i bytes2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+      v_prefix = _mm_add_epi32(v_prefix, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_unpacklo_epi8(bytes1, zero), weights1));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_unpackhi_epi8(bytes1, zero), weights2));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_unpacklo_epi8(bytes2, zero), weights3));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_unpackhi_epi8(bytes2, zero), weights4));
+      data += kAdler32ChunkSize;
+    }
+    uint64_t block_s2 = static_cast<uint64_t>(s2) +
+        static_cast<uint64_t>(s1) * block_size +
+        HorizontalSum(v_prefix) * kAdler32ChunkSize +
+        HorizontalSum(v_s2);
+    s1 = static_cast<uint32_t>((s1 + HorizontalSum(v_s1)) % kAdler32Base);
+    s2 = static_cast<uint32_t>(block_s2 % kAdler32Base);
+    size -= block_size;
+  }
+  // Finish with zlib, which is as fast as it gets for the last few bytes.
+  return (size != 0u) ? adler32((s2 << 16) | s1, data, size) : ((s2 << 16) | s1);
+}
+
+#else  // !defined(__SSE2__)
+
+uint32_t Adler32(uint32_t adler, const uint8_t* data, size_t size) {
+  return adler32(adler, data, size);
+}
+
+#endif
+
+}  // namespace art
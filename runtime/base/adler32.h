@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_BASE_ADLER32_H_
+#define ART_RUNTIME_BASE_ADLER32_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace art {
+
+// The adler32 checksum of the dex file headers, the same as zlib's adler32() but vectorized
+// where SSE2 is available. Start with kAdler32Initial and pass the result to continue the
+// checksum over more data.
+static constexpr uint32_t kAdler32Initial = 1u;
+uint32_t Adler32(uint32_t adler, const uint8_t* data, size_t size);
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_BASE_ADLER32_H_
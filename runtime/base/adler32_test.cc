@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "adler32.h"
+
+#include <zlib.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace art {
+
+TEST(Adler32Test, SameAsZlib) {
+  // Long enough for several blocks and filled with bytes that make the sums overflow soonest.
+  std::vector<uint8_t> data(3 * 5552 + 100, 0xffu);
+  for (size_t i = 0; i < data.size(); i += 3) {
+    data[i] = static_cast<uint8_t>(i);
+  }
+  for (size_t offset : { 0u, 1u, 7u }) {
+    for (size_t size : { 0u, 1u, 31u, 32u, 33u, 5551u, 5552u, 5553u, 3 * 5552u }) {
+      const uint8_t* begin = data.data() + offset;
+      EXPECT_EQ(adler32(adler32(0L, Z_NULL, 0), begin, size), Adler32(kAdler32Initial, begin, size))
+          << offset << " " << size;
+      // Continue from a previous checksum.
+      uint32_t adler = adler32(adler32(0L, Z_NULL, 0), begin, 17u);
+      EXPECT_EQ(adler32(adler, begin, size), Adler32(adler, begin, size)) << offset << " " << size;
+    }
+  }
+  std::vector<uint8_t> all_ones(1024 * 1024, 0xffu);
+  EXPECT_EQ(adler32(1u, all_ones.data(), all_ones.size()),
+            Adler32(kAdler32Initial, all_ones.data(), all_ones.size()));
+}
+
+}  // namespace art
@@ -63,14 +63,14 @@ inline mirror::Class* ClassLinker::FindArrayClass(Thread* self, mirror::Class**
 inline mirror::String* ClassLinker::ResolveString(uint32_t string_idx, ArtMethod* referrer) {
   mirror::Class* declaring_class = referrer->GetDeclaringClass();
   // MethodVerifier refuses methods with string_idx out of bounds.
-  DCHECK_LT(string_idx, declaring_class->GetDexCache()->NumStrings());
-  mirror::String* resolved_string = declaring_class->GetDexCacheStrings()[string_idx].Read();
+  mirror::String* resolved_string =
+      declaring_class->GetDexCache()->GetResolvedString(string_idx);
   if (UNLIKELY(resolved_string == nullptr)) {
     StackHandleScope<1> hs(Thread::Current());
     Handle<mirror::DexCache> dex_cache(hs.NewHandle(declaring_class->GetDexCache()));
     const DexFile& dex_file = *dex_cache->GetDexFile();
     resolved_string = ResolveString(dex_file, string_idx, dex_cache);
-    if (resolved_string != nullptr) {
+    if (resolved_string != nullptr && !dex_cache->HasHashedStrings()) {
       DCHECK_EQ(dex_cache->GetResolvedString(string_idx), resolved_string);
     }
   }
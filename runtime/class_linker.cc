@@ -87,6 +87,7 @@
 #include "runtime.h"
 #include "ScopedLocalRef.h"
 #include "scoped_thread_state_change.h"
+#include "startup_timeline.h"
 #include "thread-inl.h"
 #include "trace.h"
 #include "utils.h"
@@ -313,6 +314,9 @@ ClassLinker::ClassLinker(InternTable* intern_table)
     : dex_lock_("ClassLinker dex lock", kDefaultMutexLevel),
       dex_cache_boot_image_class_lookup_required_(false),
       failed_dex_cache_class_lookups_(0),
+      imt_conflict_tables_created_(0),
+      imt_conflict_tables_hashed_(0),
+      imt_conflict_table_misses_(0),
       class_roots_(nullptr),
       array_iftable_(nullptr),
       find_array_class_cache_next_victim_(0),
@@ -1274,10 +1278,10 @@ bool ClassLinker::UpdateAppImageClassLoadersAndDexCaches(
       // If the oat file expects the dex cache arrays to be in the BSS, then allocate there and
         // copy over the arrays.
         DCHECK(dex_file != nullptr);
-        const size_t num_strings = dex_file->NumStringIds();
+        const size_t num_strings = mirror::DexCache::NumStringSlots(dex_file->NumStringIds());
         const size_t num_types = dex_file->NumTypeIds();
         const size_t num_methods = dex_file->NumMethodIds();
-        const size_t num_fields = dex_file->NumFieldIds();
+        const size_t num_fields = mirror::DexCache::NumFieldSlots(dex_file->NumFieldIds());
         CHECK_EQ(num_strings, dex_cache->NumStrings());
         CHECK_EQ(num_types, dex_cache->NumResolvedTypes());
         CHECK_EQ(num_methods, dex_cache->NumResolvedMethods());
@@ -1294,6 +1298,11 @@ bool ClassLinker::UpdateAppImageClassLoadersAndDexCaches(
             DCHECK(strings[j].IsNull());
           }
           std::copy_n(image_resolved_strings, num_strings, strings);
+          if (dex_cache->HasHashedStrings()) {
+            memcpy(mirror::DexCache::GetStringTags(strings),
+                   mirror::DexCache::GetStringTags(image_resolved_strings),
+                   num_strings * sizeof(uint32_t));
+          }
           dex_cache->SetStrings(strings);
         }
         if (num_types != 0u) {
@@ -1329,6 +1338,12 @@ bool ClassLinker::UpdateAppImageClassLoadersAndDexCaches(
             DCHECK(fields[j] == nullptr);
           }
           std::copy_n(dex_cache->GetResolvedFields(), num_fields, fields);
+          if (dex_cache->HasHashedFields()) {
+            memcpy(mirror::DexCache::GetFieldTags(fields, image_pointer_size_),
+                   mirror::DexCache::GetFieldTags(dex_cache->GetResolvedFields(),
+                                                  image_pointer_size_),
+                   num_fields * sizeof(uint32_t));
+          }
           dex_cache->SetResolvedFields(fields);
         }
       }
@@ -1726,8 +1741,9 @@ bool ClassLinker::AddImageSpace(
   if (kSanityCheckObjects) {
     for (int32_t i = 0; i < dex_caches->GetLength(); i++) {
       auto* dex_cache = dex_caches->Get(i);
+      ArtField** const fields = dex_cache->GetResolvedFields();
       for (size_t j = 0; j < dex_cache->NumResolvedFields(); ++j) {
-        auto* field = dex_cache->GetResolvedField(j, image_pointer_size_);
+        auto* field = mirror::DexCache::GetElementPtrSize(fields, j, image_pointer_size_);
         if (field != nullptr) {
           CHECK(field->GetDeclaringClass()->GetClass() != nullptr);
         }
@@ -2094,31 +2110,45 @@ mirror::DexCache* ClassLinker::AllocDexCache(Thread* self,
       reinterpret_cast<ArtMethod**>(raw_arrays + layout.MethodsOffset());
   ArtField** fields = (dex_file.NumFieldIds() == 0u) ? nullptr :
       reinterpret_cast<ArtField**>(raw_arrays + layout.FieldsOffset());
+  const size_t num_strings = mirror::DexCache::NumStringSlots(dex_file.NumStringIds());
+  const size_t num_fields = mirror::DexCache::NumFieldSlots(dex_file.NumFieldIds());
   if (kIsDebugBuild) {
     // Sanity check to make sure all the dex cache arrays are empty. b/28992179
-    for (size_t i = 0; i < dex_file.NumStringIds(); ++i) {
+    for (size_t i = 0; i < num_strings; ++i) {
       CHECK(strings[i].Read<kWithoutReadBarrier>() == nullptr);
     }
+    if (mirror::DexCache::UseHashedStrings(dex_file.NumStringIds())) {
+      Atomic<uint32_t>* tags = mirror::DexCache::GetStringTags(strings);
+      for (size_t i = 0; i < num_strings; ++i) {
+        CHECK_EQ(tags[i].LoadRelaxed(), 0u);
+      }
+    }
     for (size_t i = 0; i < dex_file.NumTypeIds(); ++i) {
       CHECK(types[i].Read<kWithoutReadBarrier>() == nullptr);
     }
     for (size_t i = 0; i < dex_file.NumMethodIds(); ++i) {
       CHECK(mirror::DexCache::GetElementPtrSize(methods, i, image_pointer_size_) == nullptr);
     }
-    for (size_t i = 0; i < dex_file.NumFieldIds(); ++i) {
+    for (size_t i = 0; i < num_fields; ++i) {
       CHECK(mirror::DexCache::GetElementPtrSize(fields, i, image_pointer_size_) == nullptr);
     }
+    if (mirror::DexCache::UseHashedFields(dex_file.NumFieldIds())) {
+      Atomic<uint32_t>* tags = mirror::DexCache::GetFieldTags(fields, image_pointer_size_);
+      for (size_t i = 0; i < num_fields; ++i) {
+        CHECK_EQ(tags[i].LoadRelaxed(), 0u);
+      }
+    }
   }
   dex_cache->Init(&dex_file,
                   location.Get(),
                   strings,
-                  dex_file.NumStringIds(),
+                  num_strings,
                   types,
                   dex_file.NumTypeIds(),
                   methods,
                   dex_file.NumMethodIds(),
                   fields,
-                  dex_file.NumFieldIds(),
+                  num_fields,
                   image_pointer_size_);
   return dex_cache.Get();
 }
@@ -3617,18 +3647,33 @@ bool ClassLinker::RemoveClass(const char* descriptor, mirror::ClassLoader* class
   return class_table != nullptr && class_table->Remove(descriptor);
 }
 
-mirror::Class* ClassLinker::LookupClass(Thread* self,
+size_t ClassLinker::RemoveClasses(const std::unordered_set<mirror::Class*>& classes) {
+  WriterMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
+  std::unordered_map<ClassTable*, std::unordered_set<mirror::Class*>> classes_by_table;
+  for (mirror::Class* klass : classes) {
+    ClassTable* const class_table = ClassTableForClassLoader(klass->GetClassLoader());
+    if (class_table != nullptr) {
+      classes_by_table[class_table].insert(klass);
+    }
+  }
+  size_t num_removed = 0u;
+  for (const auto& entry : classes_by_table) {
+    num_removed += entry.first->RemoveClasses(entry.second);
+  }
+  return num_removed;
+}
+
+mirror::Class* ClassLinker::LookupClass(Thread* self ATTRIBUTE_UNUSED,
                                         const char* descriptor,
                                         size_t hash,
                                         mirror::ClassLoader* class_loader) {
-  {
-    ReaderMutexLock mu(self, *Locks::classlinker_classes_lock_);
-    ClassTable* const class_table = ClassTableForClassLoader(class_loader);
-    if (class_table != nullptr) {
-      mirror::Class* result = class_table->Lookup(descriptor, hash);
-      if (result != nullptr) {
-        return result;
-      }
+  // Class table lookups do not need any lock. The class table of a class loader is never
+  // replaced, and lives as long as the class loader.
+  ClassTable* const class_table = ClassTableForClassLoader(class_loader);
+  if (class_table != nullptr) {
+    mirror::Class* result = class_table->Lookup(descriptor, hash);
+    if (result != nullptr) {
+      return result;
     }
   }
   if (class_loader != nullptr || !dex_cache_boot_image_class_lookup_required_) {
@@ -4471,6 +4516,10 @@ bool ClassLinker::InitializeClass(Thread* self, Handle<mirror::Class> klass,
     return false;
   }
 
+  ScopedStartupPhase phase("ClassLinker::InitializeClass");
+  if (phase.IsRecording()) {
+    phase.SetDetail(PrettyDescriptor(klass.Get()));
+  }
   self->AllowThreadSuspension();
   uint64_t t0;
   {
@@ -5055,8 +5104,10 @@ void ClassLinker::RegisterClassLoader(mirror::ClassLoader* class_loader) {
   Thread* const self = Thread::Current();
   ClassLoaderData data;
   data.weak_root = self->GetJniEnv()->vm->AddWeakGlobalRef(self, class_loader);
-  // Create and set the class table.
+  // Create and set the class table. The table is looked up without locks, publish it only
+  // once constructed.
   data.class_table = new ClassTable;
+  QuasiAtomic::ThreadFenceRelease();
   class_loader->SetClassTable(data.class_table);
   // Create and set the linear allocator.
   data.allocator = Runtime::Current()->CreateLinearAlloc();
@@ -6108,6 +6159,7 @@ ArtMethod* ClassLinker::AddMethodToConflictTable(mirror::Class* klass,
                                                             interface_method,
                                                             method,
                                                             image_pointer_size_);
+  RecordImtConflictTable(new_table);
 
   // Do a fence to ensure threads see the data in the table before it is assigned
   // to the conflict method.
@@ -6230,6 +6282,19 @@ ImtConflictTable* ClassLinker::CreateImtConflictTable(size_t count, LinearAlloc*
   return CreateImtConflictTable(count, linear_alloc, image_pointer_size_);
 }
 
+void ClassLinker::RecordImtConflictTable(ImtConflictTable* table) {
+  imt_conflict_tables_created_.FetchAndAddRelaxed(1u);
+  if (table->IsHashed(image_pointer_size_)) {
+    imt_conflict_tables_hashed_.FetchAndAddRelaxed(1u);
+  }
+}
+
+void ClassLinker::DumpImtConflictStats(std::ostream& os) const {
+  os << "IMT conflict tables created=" << imt_conflict_tables_created_.LoadRelaxed()
+     << " hashed=" << imt_conflict_tables_hashed_.LoadRelaxed()
+     << " misses=" << imt_conflict_table_misses_.LoadRelaxed() << "\n";
+}
+
 void ClassLinker::FillIMTFromIfTable(mirror::IfTable* if_table,
                                      ArtMethod* unimplemented_method,
                                      ArtMethod* imt_conflict_method,
@@ -6329,9 +6394,15 @@ void ClassLinker::FillIMTFromIfTable(mirror::IfTable* if_table,
           continue;
         }
         ImtConflictTable* table = imt[imt_index]->GetImtConflictTable(image_pointer_size_);
-        const size_t num_entries = table->NumEntries(image_pointer_size_);
-        table->SetInterfaceMethod(num_entries, image_pointer_size_, interface_method);
-        table->SetImplementationMethod(num_entries, image_pointer_size_, implementation_method);
+        table->AddEntry(interface_method, implementation_method, image_pointer_size_);
+      }
+    }
+
+    for (size_t i = 0; i < ImTable::kSize; ++i) {
+      if (imt[i]->IsRuntimeMethod() &&
+          imt[i] != unimplemented_method &&
+          imt[i] != imt_conflict_method) {
+        RecordImtConflictTable(imt[i]->GetImtConflictTable(image_pointer_size_));
       }
     }
   }
@@ -8267,6 +8338,22 @@ void ClassLinker::CleanupClassLoaders() {
   }
 }
 
+void ClassLinker::DetachRetiredClassTableStorage() {
+  ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
+  boot_class_table_.DetachRetiredStorage();
+  for (const ClassLoaderData& data : class_loaders_) {
+    data.class_table->DetachRetiredStorage();
+  }
+}
+
+void ClassLinker::FreeDetachedClassTableStorage() {
+  ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
+  boot_class_table_.FreeDetachedStorage();
+  for (const ClassLoaderData& data : class_loaders_) {
+    data.class_table->FreeDetachedStorage();
+  }
+}
+
 std::set<DexCacheResolvedClasses> ClassLinker::GetResolvedClasses(bool ignore_boot_classes) {
   ScopedTrace trace(__PRETTY_FUNCTION__);
   ScopedObjectAccess soa(Thread::Current());
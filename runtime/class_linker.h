@@ -47,6 +47,8 @@ namespace mirror {
   class ClassLoader;
   class DexCache;
   class DexCachePointerArray;
+  class DexCacheTest_HashedFields_Test;
+  class DexCacheTest_HashedStrings_Test;
   class DexCacheTest_Open_Test;
   class IfTable;
   template<class T> class ObjectArray;
@@ -226,6 +228,12 @@ class ClassLinker {
       REQUIRES(!Locks::classlinker_classes_lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
 
+  // Removes the classes from the class tables of their class loaders, returns how many were
+  // removed. Used like RemoveClass, but copies each class table only once.
+  size_t RemoveClasses(const std::unordered_set<mirror::Class*>& classes)
+      REQUIRES(!Locks::classlinker_classes_lock_)
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
   void DumpAllClasses(int flags)
       REQUIRES(!Locks::classlinker_classes_lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
@@ -586,6 +594,12 @@ class ClassLinker {
       REQUIRES(!Locks::classlinker_classes_lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
 
+  // Set aside the storage that class tables replaced while lookups could read it. The GC calls
+  // FreeDetachedClassTableStorage() once it has suspended every thread, then no lookup can be
+  // reading the storage set aside anymore.
+  void DetachRetiredClassTableStorage() REQUIRES(!Locks::classlinker_classes_lock_);
+  void FreeDetachedClassTableStorage() REQUIRES(!Locks::classlinker_classes_lock_);
+
   // Unlike GetOrCreateAllocatorForClassLoader, GetAllocatorForClassLoader asserts that the
   // allocator for this class loader is already created.
   LinearAlloc* GetAllocatorForClassLoader(mirror::ClassLoader* class_loader)
@@ -626,6 +640,14 @@ class ClassLinker {
   // Create a conflict table with a specified capacity.
   ImtConflictTable* CreateImtConflictTable(size_t count, LinearAlloc* linear_alloc);
 
+  // Record an interface call that was not found in the conflict table of its IMT slot.
+  void RecordImtConflictTableMiss() {
+    imt_conflict_table_misses_.FetchAndAddRelaxed(1u);
+  }
+
+  // Dump the number of conflict tables created for classes and on misses, and the misses.
+  void DumpImtConflictStats(std::ostream& os) const;
+
   // Static version for when the class linker is not yet created.
   static ImtConflictTable* CreateImtConflictTable(size_t count,
                                                   LinearAlloc* linear_alloc,
@@ -1103,6 +1125,9 @@ class ClassLinker {
                  /*out*/bool* new_conflict,
                  /*out*/ArtMethod** imt_ref) SHARED_REQUIRES(Locks::mutator_lock_);
 
+  // Update the conflict table statistics for a newly created table.
+  void RecordImtConflictTable(ImtConflictTable* table);
+
   void FillIMTFromIfTable(mirror::IfTable* if_table,
                           ArtMethod* unimplemented_method,
                           ArtMethod* imt_conflict_method,
@@ -1143,6 +1168,11 @@ class ClassLinker {
   // the classes into the class_table_ to avoid dex cache based searches.
   Atomic<uint32_t> failed_dex_cache_class_lookups_;
 
+  // IMT conflict table statistics, see DumpImtConflictStats().
+  Atomic<uint32_t> imt_conflict_tables_created_;
+  Atomic<uint32_t> imt_conflict_tables_hashed_;
+  Atomic<uint32_t> imt_conflict_table_misses_;
+
   // Well known mirror::Class roots.
   GcRoot<mirror::ObjectArray<mirror::Class>> class_roots_;
 
@@ -1178,6 +1208,8 @@ class ClassLinker {
   friend class JniInternalTest;  // for GetRuntimeQuickGenericJniStub
   ART_FRIEND_TEST(ClassLinkerTest, RegisterDexFileName);  // for DexLock, and RegisterDexFileLocked
   ART_FRIEND_TEST(mirror::DexCacheTest, Open);  // for AllocDexCache
+  ART_FRIEND_TEST(mirror::DexCacheTest, HashedStrings);  // for AllocDexCache
+  ART_FRIEND_TEST(mirror::DexCacheTest, HashedFields);  // for AllocDexCache
   DISALLOW_COPY_AND_ASSIGN(ClassLinker);
 };
 
@@ -22,11 +22,13 @@
 #include "art_field-inl.h"
 #include "art_method-inl.h"
 #include "class_linker-inl.h"
+#include "class_table-inl.h"
 #include "common_runtime_test.h"
 #include "dex_file.h"
 #include "experimental_flags.h"
 #include "entrypoints/entrypoint_utils-inl.h"
 #include "gc/heap.h"
+#include "linear_alloc.h"
 #include "mirror/abstract_method.h"
 #include "mirror/accessible_object.h"
 #include "mirror/class-inl.h"
@@ -41,6 +43,8 @@
 #include "handle_scope-inl.h"
 #include "scoped_thread_state_change.h"
 #include "thread-inl.h"
+#include "thread_pool.h"
+#include "utils.h"
 
 namespace art {
 
@@ -1227,6 +1231,171 @@ TEST_F(ClassLinkerTest, IsBootStrapClassLoaded) {
   EXPECT_FALSE(statics.Get()->IsBootStrapClassLoaded());
 }
 
+TEST_F(ClassLinkerTest, HashedImtConflictTable) {
+  ScopedObjectAccess soa(Thread::Current());
+  mirror::Class* list = class_linker_->FindSystemClass(soa.Self(), "Ljava/util/List;");
+  ASSERT_TRUE(list != nullptr);
+  const size_t pointer_size = class_linker_->GetImagePointerSize();
+  std::vector<ArtMethod*> methods;
+  for (ArtMethod& method : list->GetVirtualMethods(pointer_size)) {
+    methods.push_back(&method);
+  }
+  ASSERT_GT(methods.size(), ImtConflictTable::kMaxLinearEntries + 1u);
+
+  // Map each method but the last one to the next one.
+  LinearAlloc* linear_alloc = Runtime::Current()->GetLinearAlloc();
+  ImtConflictTable* table = class_linker_->CreateImtConflictTable(methods.size() - 1u,
+                                                                  linear_alloc);
+  ASSERT_TRUE(table != nullptr);
+  for (size_t i = 0; i + 1u < methods.size(); ++i) {
+    table->AddEntry(methods[i], methods[i + 1u], pointer_size);
+  }
+  EXPECT_TRUE(table->IsHashed(pointer_size));
+  EXPECT_EQ(methods.size() - 1u, table->NumEntries(pointer_size));
+  for (size_t i = 0; i + 1u < methods.size(); ++i) {
+    EXPECT_EQ(methods[i + 1u], table->Lookup(methods[i], pointer_size)) << i;
+  }
+  EXPECT_TRUE(table->Lookup(methods.back(), pointer_size) == nullptr);
+
+  // Copy the table with one more entry.
+  void* data = linear_alloc->Alloc(
+      soa.Self(), ImtConflictTable::ComputeSizeWithOneMoreEntry(table, pointer_size));
+  ImtConflictTable* new_table =
+      new (data) ImtConflictTable(table, methods.back(), methods[0], pointer_size);
+  EXPECT_EQ(methods.size(), new_table->NumEntries(pointer_size));
+  EXPECT_EQ(methods[0], new_table->Lookup(methods.back(), pointer_size));
+  EXPECT_EQ(methods[1], new_table->Lookup(methods[0], pointer_size));
+  EXPECT_TRUE(new_table->Equals(new_table, pointer_size));
+  EXPECT_FALSE(new_table->Equals(table, pointer_size));
+  EXPECT_FALSE(table->Equals(new_table, pointer_size));
+
+  size_t visited = 0u;
+  new_table->Visit([&visited](const std::pair<ArtMethod*, ArtMethod*>& methods_pair) {
+    ++visited;
+    return methods_pair;
+  }, pointer_size);
+  EXPECT_EQ(methods.size(), visited);
+}
+
+class CollectClassesVisitor : public ClassVisitor {
+ public:
+  CollectClassesVisitor(size_t max_classes, std::vector<mirror::Class*>* classes)
+      : max_classes_(max_classes), classes_(classes) {}
+
+  bool operator()(mirror::Class* klass) OVERRIDE {
+    classes_->push_back(klass);
+    return classes_->size() < max_classes_;
+  }
+
+ private:
+  const size_t max_classes_;
+  std::vector<mirror::Class*>* const classes_;
+};
+
+static mirror::Class* LookupClassInTable(ClassTable* table, mirror::Class* klass)
+    SHARED_REQUIRES(Locks::mutator_lock_) {
+  std::string temp;
+  const char* descriptor = klass->GetDescriptor(&temp);
+  return table->Lookup(descriptor, ComputeModifiedUtf8Hash(descriptor));
+}
+
+class ClassTableLookupTask : public Task {
+ public:
+  ClassTableLookupTask(ClassTable* table,
+                       const std::vector<mirror::Class*>* classes,
+                       AtomicInteger* failures)
+      : table_(table), classes_(classes), failures_(failures) {}
+
+  void Run(Thread* self) OVERRIDE {
+    ScopedObjectAccess soa(self);
+    for (size_t i = 0; i != 50u; ++i) {
+      for (mirror::Class* klass : *classes_) {
+        if (LookupClassInTable(table_, klass) != klass) {
+          ++*failures_;
+        }
+      }
+    }
+  }
+
+  void Finalize() OVERRIDE {
+    delete this;
+  }
+
+ private:
+  ClassTable* const table_;
+  const std::vector<mirror::Class*>* const classes_;
+  AtomicInteger* const failures_;
+};
+
+// Lookups do not take the class table lock. Check that they keep finding the classes already in
+// the table while other classes are inserted, which publishes larger buckets, and removed, which
+// publishes copies without them.
+TEST_F(ClassLinkerTest, ClassTableLookupsDuringUpdates) {
+  static constexpr size_t kNumClasses = 600u;
+  Thread* self = Thread::Current();
+  ClassTable table;
+  std::vector<mirror::Class*> kept;
+  std::vector<mirror::Class*> removed;
+  {
+    ScopedObjectAccess soa(self);
+    std::vector<mirror::Class*> classes;
+    CollectClassesVisitor visitor(kNumClasses, &classes);
+    class_linker_->VisitClasses(&visitor);
+    ASSERT_EQ(kNumClasses, classes.size());
+    kept.assign(classes.begin(), classes.begin() + kNumClasses / 3u);
+    removed.assign(classes.begin() + kNumClasses / 3u, classes.end());
+    // Half of the kept classes are in a frozen class set, the others in the live buckets.
+    for (size_t i = 0; i != kept.size(); ++i) {
+      if (i == kept.size() / 2u) {
+        table.FreezeSnapshot();
+      }
+      table.Insert(kept[i]);
+    }
+    EXPECT_EQ(kept.size() / 2u, table.NumZygoteClasses());
+    EXPECT_EQ(kept.size() - kept.size() / 2u, table.NumNonZygoteClasses());
+  }
+
+  static constexpr size_t kNumThreads = 4u;
+  ThreadPool thread_pool("Class table test thread pool", kNumThreads);
+  AtomicInteger failures(0);
+  for (size_t i = 0; i != kNumThreads; ++i) {
+    thread_pool.AddTask(self, new ClassTableLookupTask(&table, &kept, &failures));
+  }
+  thread_pool.StartWorkers(self);
+  {
+    ScopedObjectAccess soa(self);
+    for (mirror::Class* klass : removed) {
+      table.Insert(klass);
+    }
+    EXPECT_EQ(removed.size(),
+              table.RemoveClasses(std::unordered_set<mirror::Class*>(removed.begin(),
+                                                                      removed.end())));
+  }
+  thread_pool.Wait(self, /* do_work */ false, /* may_hold_locks */ false);
+  EXPECT_EQ(0, failures.LoadSequentiallyConsistent());
+
+  ScopedObjectAccess soa(self);
+  for (mirror::Class* klass : kept) {
+    EXPECT_EQ(klass, LookupClassInTable(&table, klass)) << PrettyClass(klass);
+  }
+  for (mirror::Class* klass : removed) {
+    EXPECT_TRUE(LookupClassInTable(&table, klass) == nullptr) << PrettyClass(klass);
+  }
+
+  // Removing from a frozen class set publishes a copy of it.
+  std::string temp;
+  EXPECT_TRUE(table.Remove(kept[0]->GetDescriptor(&temp)));
+  EXPECT_TRUE(LookupClassInTable(&table, kept[0]) == nullptr);
+  EXPECT_EQ(kept.size() - 1u, table.NumZygoteClasses() + table.NumNonZygoteClasses());
+
+  // No lookup is running, the replaced storage can be freed.
+  table.DetachRetiredStorage();
+  table.FreeDetachedStorage();
+  for (size_t i = 1u; i != kept.size(); ++i) {
+    EXPECT_EQ(kept[i], LookupClassInTable(&table, kept[i])) << PrettyClass(kept[i]);
+  }
+}
+
 // Regression test for b/26799552.
 TEST_F(ClassLinkerTest, RegisterDexFileName) {
   ScopedObjectAccess soa(Thread::Current());
@@ -24,8 +24,15 @@ namespace art {
 template<class Visitor>
 void ClassTable::VisitRoots(Visitor& visitor) {
   ReaderMutexLock mu(Thread::Current(), lock_);
-  for (ClassSet& class_set : classes_) {
-    for (GcRoot<mirror::Class>& root : class_set) {
+  for (const std::unique_ptr<ClassSet>& class_set : class_sets_) {
+    for (GcRoot<mirror::Class>& root : *class_set) {
+      visitor.VisitRoot(root.AddressWithoutBarrier());
+    }
+  }
+  const Buckets* live_buckets = buckets_.get();
+  for (size_t i = 0, e = live_buckets->NumBuckets(); i != e; ++i) {
+    GcRoot<mirror::Class>& root = live_buckets->At(i);
+    if (!root.IsNull()) {
       visitor.VisitRoot(root.AddressWithoutBarrier());
     }
   }
@@ -37,8 +44,15 @@ void ClassTable::VisitRoots(Visitor& visitor) {
 template<class Visitor>
 void ClassTable::VisitRoots(const Visitor& visitor) {
   ReaderMutexLock mu(Thread::Current(), lock_);
-  for (ClassSet& class_set : classes_) {
-    for (GcRoot<mirror::Class>& root : class_set) {
+  for (const std::unique_ptr<ClassSet>& class_set : class_sets_) {
+    for (GcRoot<mirror::Class>& root : *class_set) {
+      visitor.VisitRoot(root.AddressWithoutBarrier());
+    }
+  }
+  const Buckets* live_buckets = buckets_.get();
+  for (size_t i = 0, e = live_buckets->NumBuckets(); i != e; ++i) {
+    GcRoot<mirror::Class>& root = live_buckets->At(i);
+    if (!root.IsNull()) {
       visitor.VisitRoot(root.AddressWithoutBarrier());
     }
   }
@@ -50,13 +64,20 @@ void ClassTable::VisitRoots(const Visitor& visitor) {
 template <typename Visitor>
 bool ClassTable::Visit(Visitor& visitor) {
   ReaderMutexLock mu(Thread::Current(), lock_);
-  for (ClassSet& class_set : classes_) {
-    for (GcRoot<mirror::Class>& root : class_set) {
+  for (const std::unique_ptr<ClassSet>& class_set : class_sets_) {
+    for (GcRoot<mirror::Class>& root : *class_set) {
       if (!visitor(root.Read())) {
         return false;
       }
     }
   }
+  const Buckets* live_buckets = buckets_.get();
+  for (size_t i = 0, e = live_buckets->NumBuckets(); i != e; ++i) {
+    GcRoot<mirror::Class>& root = live_buckets->At(i);
+    if (!root.IsNull() && !visitor(root.Read())) {
+      return false;
+    }
+  }
   return true;
 }
 
@@ -16,116 +16,296 @@
 
 #include "class_table.h"
 
+#include <algorithm>
+#include <iterator>
+
+#include "base/bit_utils.h"
 #include "mirror/class-inl.h"
 
 namespace art {
 
-ClassTable::ClassTable() : lock_("Class loader classes", kClassLoaderClassesLock) {
-  Runtime* const runtime = Runtime::Current();
-  classes_.push_back(ClassSet(runtime->GetHashTableMinLoadFactor(),
-                              runtime->GetHashTableMaxLoadFactor()));
+// Initial number of live buckets.
+static constexpr size_t kMinBuckets = 16u;
+
+ClassTable::Buckets::Buckets(size_t num_buckets)
+    : mask_(num_buckets - 1u),
+      roots_(new GcRoot<mirror::Class>[num_buckets]) {
+  DCHECK(IsPowerOfTwo(num_buckets));
 }
 
-void ClassTable::FreezeSnapshot() {
+mirror::Class* ClassTable::Buckets::Lookup(const char* descriptor, size_t hash) const {
+  for (size_t index = hash; ; ++index) {
+    // Copy the root, a concurrent UpdateClass() may replace it.
+    GcRoot<mirror::Class> root = At(index);
+    if (root.IsNull()) {
+      return nullptr;
+    }
+    mirror::Class* klass = root.Read();
+    if (klass->DescriptorEquals(descriptor)) {
+      return klass;
+    }
+  }
+}
+
+GcRoot<mirror::Class>* ClassTable::Buckets::Find(const char* descriptor, size_t hash) const {
+  for (size_t index = hash; ; ++index) {
+    GcRoot<mirror::Class>& root = At(index);
+    if (root.IsNull()) {
+      return nullptr;
+    }
+    if (root.Read()->DescriptorEquals(descriptor)) {
+      return &root;
+    }
+  }
+}
+
+void ClassTable::Buckets::Insert(mirror::Class* klass, size_t hash) {
+  size_t index = hash;
+  while (!At(index).IsNull()) {
+    ++index;
+  }
+  // Make the class visible to lookups only after the stores that initialized it.
+  QuasiAtomic::ThreadFenceRelease();
+  At(index) = GcRoot<mirror::Class>(klass);
+}
+
+ClassTable::ClassTable()
+    : lock_("Class loader classes", kClassLoaderClassesLock),
+      num_live_classes_(0u),
+      published_class_sets_(nullptr),
+      published_buckets_(nullptr),
+      min_load_factor_(Runtime::Current()->GetHashTableMinLoadFactor()),
+      max_load_factor_(Runtime::Current()->GetHashTableMaxLoadFactor()) {
+  // Nothing can look up the table before it is constructed.
   WriterMutexLock mu(Thread::Current(), lock_);
-  classes_.push_back(ClassSet());
+  PublishClassSets();
+  buckets_.reset(new Buckets(kMinBuckets));
+  published_buckets_.StoreRelease(buckets_.get());
 }
 
-bool ClassTable::Contains(mirror::Class* klass) {
-  ReaderMutexLock mu(Thread::Current(), lock_);
-  for (ClassSet& class_set : classes_) {
-    auto it = class_set.Find(GcRoot<mirror::Class>(klass));
-    if (it != class_set.end()) {
-      return it->Read() == klass;
+void ClassTable::PublishClassSets() {
+  ClassSetList* list = new ClassSetList;
+  for (const std::unique_ptr<ClassSet>& class_set : class_sets_) {
+    list->push_back(class_set.get());
+  }
+  if (class_set_list_ != nullptr) {
+    retired_.class_set_lists.push_back(std::move(class_set_list_));
+  }
+  class_set_list_.reset(list);
+  published_class_sets_.StoreRelease(list);
+}
+
+size_t ClassTable::ReplaceLiveBuckets(size_t num_buckets,
+                                      const std::unordered_set<mirror::Class*>& removed) {
+  Buckets* new_buckets = new Buckets(num_buckets);
+  ClassDescriptorHashEquals hash_fn;
+  size_t num_classes = 0u;
+  for (size_t i = 0, e = buckets_->NumBuckets(); i != e; ++i) {
+    const GcRoot<mirror::Class>& root = buckets_->At(i);
+    if (!root.IsNull() && removed.find(root.Read()) == removed.end()) {
+      new_buckets->Insert(root.Read(), hash_fn(root));
+      ++num_classes;
     }
   }
-  return false;
+  DCHECK_LE(num_classes, num_live_classes_);
+  const size_t num_removed = num_live_classes_ - num_classes;
+  num_live_classes_ = num_classes;
+  retired_.buckets.push_back(std::move(buckets_));
+  buckets_.reset(new_buckets);
+  published_buckets_.StoreRelease(new_buckets);
+  return num_removed;
 }
 
-mirror::Class* ClassTable::LookupByDescriptor(mirror::Class* klass) {
-  ReaderMutexLock mu(Thread::Current(), lock_);
-  for (ClassSet& class_set : classes_) {
-    auto it = class_set.Find(GcRoot<mirror::Class>(klass));
-    if (it != class_set.end()) {
-      return it->Read();
+void ClassTable::InsertLiveClass(mirror::Class* klass, size_t hash) {
+  const size_t num_buckets = buckets_->NumBuckets();
+  if (static_cast<double>(num_live_classes_ + 1u) > max_load_factor_ * num_buckets) {
+    size_t wanted = static_cast<size_t>((num_live_classes_ + 1u) / min_load_factor_) + 1u;
+    ReplaceLiveBuckets(RoundUpToPowerOfTwo(std::max(wanted, num_buckets * 2u)),
+                       std::unordered_set<mirror::Class*>());
+  }
+  buckets_->Insert(klass, hash);
+  ++num_live_classes_;
+}
+
+void ClassTable::FreezeSnapshot() {
+  WriterMutexLock mu(Thread::Current(), lock_);
+  // Move the live classes to a new class set that will not be modified anymore.
+  std::unique_ptr<ClassSet> class_set(new ClassSet());
+  for (size_t i = 0, e = buckets_->NumBuckets(); i != e; ++i) {
+    if (!buckets_->At(i).IsNull()) {
+      class_set->Insert(buckets_->At(i));
     }
   }
-  return nullptr;
+  class_sets_.push_back(std::move(class_set));
+  // Publish the class sets before the new buckets, lookups read them in the other order.
+  PublishClassSets();
+  num_live_classes_ = 0u;
+  retired_.buckets.push_back(std::move(buckets_));
+  buckets_.reset(new Buckets(kMinBuckets));
+  published_buckets_.StoreRelease(buckets_.get());
+}
+
+bool ClassTable::Contains(mirror::Class* klass) {
+  std::string temp;
+  const char* descriptor = klass->GetDescriptor(&temp);
+  return Lookup(descriptor, ComputeModifiedUtf8Hash(descriptor)) == klass;
+}
+
+mirror::Class* ClassTable::LookupByDescriptor(mirror::Class* klass) {
+  std::string temp;
+  const char* descriptor = klass->GetDescriptor(&temp);
+  return Lookup(descriptor, ComputeModifiedUtf8Hash(descriptor));
 }
 
 mirror::Class* ClassTable::UpdateClass(const char* descriptor, mirror::Class* klass, size_t hash) {
   WriterMutexLock mu(Thread::Current(), lock_);
   // Should only be updating latest table.
-  auto existing_it = classes_.back().FindWithHash(descriptor, hash);
-  if (kIsDebugBuild && existing_it == classes_.back().end()) {
-    for (const ClassSet& class_set : classes_) {
-      if (class_set.FindWithHash(descriptor, hash) != class_set.end()) {
+  GcRoot<mirror::Class>* existing_root = buckets_->Find(descriptor, hash);
+  if (kIsDebugBuild && existing_root == nullptr) {
+    for (const std::unique_ptr<ClassSet>& class_set : class_sets_) {
+      if (class_set->FindWithHash(descriptor, hash) != class_set->end()) {
         LOG(FATAL) << "Updating class found in frozen table " << descriptor;
       }
     }
     LOG(FATAL) << "Updating class not found " << descriptor;
   }
-  mirror::Class* const existing = existing_it->Read();
+  mirror::Class* const existing = existing_root->Read();
   CHECK_NE(existing, klass) << descriptor;
   CHECK(!existing->IsResolved()) << descriptor;
   CHECK_EQ(klass->GetStatus(), mirror::Class::kStatusResolving) << descriptor;
   CHECK(!klass->IsTemp()) << descriptor;
   VerifyObject(klass);
-  // Update the element in the hash set with the new class. This is safe to do since the descriptor
-  // doesn't change.
-  *existing_it = GcRoot<mirror::Class>(klass);
+  // Update the bucket with the new class. This is safe to do since the descriptor doesn't change.
+  // Concurrent lookups see either class.
+  QuasiAtomic::ThreadFenceRelease();
+  *existing_root = GcRoot<mirror::Class>(klass);
   return existing;
 }
 
 size_t ClassTable::NumZygoteClasses() const {
   ReaderMutexLock mu(Thread::Current(), lock_);
   size_t sum = 0;
-  for (size_t i = 0; i < classes_.size() - 1; ++i) {
-    sum += classes_[i].Size();
+  for (const std::unique_ptr<ClassSet>& class_set : class_sets_) {
+    sum += class_set->Size();
   }
   return sum;
 }
 
 size_t ClassTable::NumNonZygoteClasses() const {
   ReaderMutexLock mu(Thread::Current(), lock_);
-  return classes_.back().Size();
+  return num_live_classes_;
 }
 
 mirror::Class* ClassTable::Lookup(const char* descriptor, size_t hash) {
-  ReaderMutexLock mu(Thread::Current(), lock_);
-  for (ClassSet& class_set : classes_) {
-    auto it = class_set.FindWithHash(descriptor, hash);
-    if (it != class_set.end()) {
-     return it->Read();
+  // Load the live buckets first. FreezeSnapshot() publishes the class sets before emptying the
+  // live buckets, so we cannot miss the classes it moves.
+  const Buckets* live_buckets = published_buckets_.LoadAcquire();
+  const ClassSetList* class_sets = published_class_sets_.LoadAcquire();
+  for (const ClassSet* class_set : *class_sets) {
+    auto it = class_set->FindWithHash(descriptor, hash);
+    if (it != class_set->end()) {
+      return it->Read();
     }
   }
-  return nullptr;
+  return live_buckets->Lookup(descriptor, hash);
 }
 
 void ClassTable::Insert(mirror::Class* klass) {
   WriterMutexLock mu(Thread::Current(), lock_);
-  classes_.back().Insert(GcRoot<mirror::Class>(klass));
+  std::string temp;
+  InsertLiveClass(klass, ComputeModifiedUtf8Hash(klass->GetDescriptor(&temp)));
 }
 
 void ClassTable::InsertWithoutLocks(mirror::Class* klass) {
-  classes_.back().Insert(GcRoot<mirror::Class>(klass));
+  std::string temp;
+  InsertLiveClass(klass, ComputeModifiedUtf8Hash(klass->GetDescriptor(&temp)));
 }
 
 void ClassTable::InsertWithHash(mirror::Class* klass, size_t hash) {
   WriterMutexLock mu(Thread::Current(), lock_);
-  classes_.back().InsertWithHash(GcRoot<mirror::Class>(klass), hash);
+  InsertLiveClass(klass, hash);
 }
 
 bool ClassTable::Remove(const char* descriptor) {
   WriterMutexLock mu(Thread::Current(), lock_);
-  for (ClassSet& class_set : classes_) {
-    auto it = class_set.Find(descriptor);
-    if (it != class_set.end()) {
-      class_set.Erase(it);
-      return true;
+  const size_t hash = ComputeModifiedUtf8Hash(descriptor);
+  mirror::Class* klass = nullptr;
+  for (const std::unique_ptr<ClassSet>& class_set : class_sets_) {
+    auto it = class_set->FindWithHash(descriptor, hash);
+    if (it != class_set->end()) {
+      klass = it->Read();
+      break;
     }
   }
-  return false;
+  if (klass == nullptr) {
+    GcRoot<mirror::Class>* root = buckets_->Find(descriptor, hash);
+    if (root == nullptr) {
+      return false;
+    }
+    klass = root->Read();
+  }
+  return RemoveClassesLocked(std::unordered_set<mirror::Class*>({klass})) == 1u;
+}
+
+size_t ClassTable::RemoveClasses(const std::unordered_set<mirror::Class*>& classes) {
+  WriterMutexLock mu(Thread::Current(), lock_);
+  return RemoveClassesLocked(classes);
+}
+
+size_t ClassTable::RemoveClassesLocked(const std::unordered_set<mirror::Class*>& classes) {
+  // Erasing in place could move entries under concurrent lookups, publish copies without the
+  // classes instead.
+  size_t num_removed = 0u;
+  for (std::unique_ptr<ClassSet>& class_set : class_sets_) {
+    size_t num_found = 0u;
+    for (const GcRoot<mirror::Class>& root : *class_set) {
+      if (classes.find(root.Read()) != classes.end()) {
+        ++num_found;
+      }
+    }
+    if (num_found == 0u) {
+      continue;
+    }
+    std::unique_ptr<ClassSet> new_class_set(new ClassSet());
+    for (const GcRoot<mirror::Class>& root : *class_set) {
+      if (classes.find(root.Read()) == classes.end()) {
+        new_class_set->Insert(root);
+      }
+    }
+    retired_.class_sets.push_back(std::move(class_set));
+    class_set = std::move(new_class_set);
+    num_removed += num_found;
+  }
+  if (num_removed != 0u) {
+    PublishClassSets();
+  }
+  for (size_t i = 0, e = buckets_->NumBuckets(); i != e; ++i) {
+    const GcRoot<mirror::Class>& root = buckets_->At(i);
+    if (!root.IsNull() && classes.find(root.Read()) != classes.end()) {
+      num_removed += ReplaceLiveBuckets(buckets_->NumBuckets(), classes);
+      break;
+    }
+  }
+  return num_removed;
+}
+
+void ClassTable::DetachRetiredStorage() {
+  WriterMutexLock mu(Thread::Current(), lock_);
+  std::move(retired_.class_sets.begin(),
+            retired_.class_sets.end(),
+            std::back_inserter(detached_.class_sets));
+  std::move(retired_.class_set_lists.begin(),
+            retired_.class_set_lists.end(),
+            std::back_inserter(detached_.class_set_lists));
+  std::move(retired_.buckets.begin(),
+            retired_.buckets.end(),
+            std::back_inserter(detached_.buckets));
+  retired_ = RetiredStorage();
+}
+
+void ClassTable::FreeDetachedStorage() {
+  WriterMutexLock mu(Thread::Current(), lock_);
+  detached_ = RetiredStorage();
 }
 
 uint32_t ClassTable::ClassDescriptorHashEquals::operator()(const GcRoot<mirror::Class>& root)
@@ -167,11 +347,16 @@ size_t ClassTable::WriteToMemory(uint8_t* ptr) const {
   ClassSet combined;
   // Combine all the class sets in case there are multiple, also adjusts load factor back to
   // default in case classes were pruned.
-  for (const ClassSet& class_set : classes_) {
-    for (const GcRoot<mirror::Class>& root : class_set) {
+  for (const std::unique_ptr<ClassSet>& class_set : class_sets_) {
+    for (const GcRoot<mirror::Class>& root : *class_set) {
       combined.Insert(root);
     }
   }
+  for (size_t i = 0, e = buckets_->NumBuckets(); i != e; ++i) {
+    if (!buckets_->At(i).IsNull()) {
+      combined.Insert(buckets_->At(i));
+    }
+  }
   const size_t ret = combined.WriteToMemory(ptr);
   // Sanity check.
   if (kIsDebugBuild && ptr != nullptr) {
@@ -190,7 +375,8 @@ size_t ClassTable::ReadFromMemory(uint8_t* ptr) {
 
 void ClassTable::AddClassSet(ClassSet&& set) {
   WriterMutexLock mu(Thread::Current(), lock_);
-  classes_.insert(classes_.begin(), std::move(set));
+  class_sets_.emplace(class_sets_.begin(), new ClassSet(std::move(set)));
+  PublishClassSets();
 }
 
 void ClassTable::ClearStrongRoots() {
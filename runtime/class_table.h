@@ -17,10 +17,13 @@
 #ifndef ART_RUNTIME_CLASS_TABLE_H_
 #define ART_RUNTIME_CLASS_TABLE_H_
 
+#include <memory>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "atomic.h"
 #include "base/allocator.h"
 #include "base/hash_set.h"
 #include "base/macros.h"
@@ -36,7 +39,14 @@ namespace mirror {
   class ClassLoader;
 }  // namespace mirror
 
-// Each loader has a ClassTable
+// Each loader has a ClassTable. Lookups do not take any lock: the classes inserted since the last
+// FreezeSnapshot() are kept in open addressed buckets that writers fill in place while holding
+// lock_, and that are replaced by a published larger copy when they get too full. Older class
+// sets are never modified in place and are published as an immutable list; removals publish
+// copies without the removed classes. Replaced buckets, sets and lists may still be in use by
+// concurrent lookups, so they are retired rather than deleted. A lookup that loaded them finishes
+// before it can reach a suspend point, so retired storage is freed once every thread has been
+// suspended, see DetachRetiredStorage(). For the same reason, it is not visited as roots.
 class ClassTable {
  public:
   class ClassDescriptorHashEquals {
@@ -111,6 +121,7 @@ class ClassTable {
       SHARED_REQUIRES(Locks::mutator_lock_);
 
   // Return the first class that matches the descriptor. Returns null if there are none.
+  // Does not take any lock.
   mirror::Class* Lookup(const char* descriptor, size_t hash)
       REQUIRES(!lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
@@ -133,6 +144,12 @@ class ClassTable {
       REQUIRES(!lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
 
+  // Removes the classes of this table that are in `classes`, returns how many were removed. Each
+  // class set holding some of them is copied only once.
+  size_t RemoveClasses(const std::unordered_set<mirror::Class*>& classes)
+      REQUIRES(!lock_)
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
   // Return true if we inserted the strong root, false if it already exists.
   bool InsertStrongRoot(mirror::Object* obj)
       REQUIRES(!lock_)
@@ -158,17 +175,99 @@ class ClassTable {
       REQUIRES(!lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
 
+  // Set aside the storage retired so far. Once every thread has been suspended, no lookup can be
+  // reading it anymore and FreeDetachedStorage() may free it.
+  void DetachRetiredStorage() REQUIRES(!lock_);
+
+  // Free the storage set aside by DetachRetiredStorage().
+  void FreeDetachedStorage() REQUIRES(!lock_);
+
   ReaderWriterMutex& GetLock() {
     return lock_;
   }
 
  private:
+  // Open addressed buckets with linear probing, holding the classes inserted since the last
+  // FreezeSnapshot(). Empty buckets are null.
+  class Buckets {
+   public:
+    explicit Buckets(size_t num_buckets);
+
+    size_t NumBuckets() const {
+      return mask_ + 1u;
+    }
+
+    GcRoot<mirror::Class>& At(size_t index) const {
+      return roots_[index & mask_];
+    }
+
+    // Return the class with the given descriptor, or null. Safe to call concurrently with
+    // InsertClass() and UpdateClass().
+    mirror::Class* Lookup(const char* descriptor, size_t hash) const
+        SHARED_REQUIRES(Locks::mutator_lock_);
+
+    // Return the bucket holding the class with the given descriptor, or null.
+    GcRoot<mirror::Class>* Find(const char* descriptor, size_t hash) const
+        SHARED_REQUIRES(Locks::mutator_lock_);
+
+    // Store the class in the first empty bucket for `hash`. Does not check the load factor.
+    void Insert(mirror::Class* klass, size_t hash) SHARED_REQUIRES(Locks::mutator_lock_);
+
+   private:
+    const size_t mask_;
+    const std::unique_ptr<GcRoot<mirror::Class>[]> roots_;
+
+    DISALLOW_COPY_AND_ASSIGN(Buckets);
+  };
+
+  // Immutable list of the class sets created before the live buckets, in lookup order.
+  typedef std::vector<ClassSet*> ClassSetList;
+
+  // Storage replaced while concurrent lookups could be reading it.
+  struct RetiredStorage {
+    std::vector<std::unique_ptr<ClassSet>> class_sets;
+    std::vector<std::unique_ptr<ClassSetList>> class_set_lists;
+    std::vector<std::unique_ptr<Buckets>> buckets;
+  };
+
   void InsertWithoutLocks(mirror::Class* klass) NO_THREAD_SAFETY_ANALYSIS;
 
+  // Insert in the live buckets, publishing larger buckets if needed.
+  void InsertLiveClass(mirror::Class* klass, size_t hash)
+      REQUIRES(lock_)
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
+  size_t RemoveClassesLocked(const std::unordered_set<mirror::Class*>& classes)
+      REQUIRES(lock_)
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
+  // Publish new live buckets holding the current live classes, except the ones in `removed`.
+  // Returns the number of classes removed.
+  size_t ReplaceLiveBuckets(size_t num_buckets, const std::unordered_set<mirror::Class*>& removed)
+      REQUIRES(lock_)
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
+  // Publish a new immutable copy of class_sets_.
+  void PublishClassSets() REQUIRES(lock_);
+
   // Lock to guard inserting and removing.
   mutable ReaderWriterMutex lock_;
-  // We have a vector to help prevent dirty pages after the zygote forks by calling FreezeSnapshot.
-  std::vector<ClassSet> classes_ GUARDED_BY(lock_);
+  // Class sets from images and from previous snapshots. We keep them separate to help prevent
+  // dirty pages after the zygote forks by calling FreezeSnapshot.
+  std::vector<std::unique_ptr<ClassSet>> class_sets_ GUARDED_BY(lock_);
+  // The current list of class sets and live buckets.
+  std::unique_ptr<ClassSetList> class_set_list_ GUARDED_BY(lock_);
+  std::unique_ptr<Buckets> buckets_ GUARDED_BY(lock_);
+  // Number of classes in the current live buckets.
+  size_t num_live_classes_ GUARDED_BY(lock_);
+  // The current list and buckets, read without locks.
+  Atomic<const ClassSetList*> published_class_sets_;
+  Atomic<const Buckets*> published_buckets_;
+  // Storage replaced since the last DetachRetiredStorage(), and storage set aside by it.
+  RetiredStorage retired_ GUARDED_BY(lock_);
+  RetiredStorage detached_ GUARDED_BY(lock_);
+  const double min_load_factor_;
+  const double max_load_factor_;
   // Extra strong roots that can be either dex files or dex caches. Dex files used by the class
   // loader which may not be owned by the class loader must be held strongly live. Also dex caches
   // are held live to prevent them being unloading once they have classes in them.
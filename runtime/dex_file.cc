@@ -18,17 +18,20 @@
 
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <memory>
 #include <sstream>
 
 #include "art_field-inl.h"
 #include "art_method-inl.h"
+#include "atomic.h"
 #include "base/file_magic.h"
 #include "base/hash_map.h"
 #include "base/logging.h"
@@ -40,10 +43,12 @@
 #include "dex_file_verifier.h"
 #include "globals.h"
 #include "handle_scope-inl.h"
+#include "id_lookup_table.h"
 #include "leb128.h"
 #include "mirror/field.h"
 #include "mirror/method.h"
 #include "mirror/string.h"
+#include "oat_file.h"
 #include "os.h"
 #include "reflection.h"
 #include "safe_map.h"
@@ -121,7 +126,8 @@ bool DexFile::GetChecksum(const char* filename, uint32_t* checksum, std::string*
 }
 
 bool DexFile::Open(const char* filename, const char* location, std::string* error_msg,
-                   std::vector<std::unique_ptr<const DexFile>>* dex_files) {
+                   std::vector<std::unique_ptr<const DexFile>>* dex_files,
+                   const OatFile* oat_file) {
   ScopedTrace trace(std::string("Open dex file ") + location);
   DCHECK(dex_files != nullptr) << "DexFile::Open: out-param is nullptr";
   uint32_t magic;
@@ -131,7 +137,7 @@ bool DexFile::Open(const char* filename, const char* location, std::string* erro
     return false;
   }
   if (IsZipMagic(magic)) {
-    return DexFile::OpenZip(fd.release(), location, error_msg, dex_files);
+    return DexFile::OpenZip(fd.release(), location, error_msg, dex_files, oat_file);
   }
   if (IsDexMagic(magic)) {
     std::unique_ptr<const DexFile> dex_file(DexFile::OpenFile(fd.release(), location, true,
@@ -286,7 +292,8 @@ std::unique_ptr<const DexFile> DexFile::OpenFile(int fd, const char* location, b
 const char* DexFile::kClassesDex = "classes.dex";
 
 bool DexFile::OpenZip(int fd, const std::string& location, std::string* error_msg,
-                      std::vector<std::unique_ptr<const DexFile>>* dex_files) {
+                      std::vector<std::unique_ptr<const DexFile>>* dex_files,
+                      const OatFile* oat_file) {
   ScopedTrace trace("Dex file open Zip " + std::string(location));
   DCHECK(dex_files != nullptr) << "DexFile::OpenZip: out-param is nullptr";
   std::unique_ptr<ZipArchive> zip_archive(ZipArchive::OpenFromFd(fd, location.c_str(), error_msg));
@@ -294,7 +301,7 @@ bool DexFile::OpenZip(int fd, const std::string& location, std::string* error_ms
     DCHECK(!error_msg->empty());
     return false;
   }
-  return DexFile::OpenFromZip(*zip_archive, location, error_msg, dex_files);
+  return DexFile::OpenFromZip(*zip_archive, location, error_msg, dex_files, oat_file);
 }
 
 std::unique_ptr<const DexFile> DexFile::OpenMemory(const std::string& location,
@@ -311,7 +318,8 @@ std::unique_ptr<const DexFile> DexFile::OpenMemory(const std::string& location,
 }
 
 std::unique_ptr<const DexFile> DexFile::Open(const ZipArchive& zip_archive, const char* entry_name,
-                                             const std::string& location, std::string* error_msg,
+                                             const std::string& location, bool verify,
+                                             std::string* error_msg,
                                              ZipOpenErrorCode* error_code) {
   ScopedTrace trace("Dex file open from Zip Archive " + std::string(location));
   CHECK(!location.empty());
@@ -320,7 +328,12 @@ std::unique_ptr<const DexFile> DexFile::Open(const ZipArchive& zip_archive, cons
     *error_code = ZipOpenErrorCode::kEntryNotFound;
     return nullptr;
   }
-  std::unique_ptr<MemMap> map(zip_entry->ExtractToMemMap(location.c_str(), entry_name, error_msg));
+  // Dex files stored uncompressed in the zip are used in place. Their CRC32 is not checked, the
+  // verifier below checks the dex file checksum instead.
+  std::unique_ptr<MemMap> map(zip_entry->MapDirectlyOrExtract(location.c_str(),
+                                                              entry_name,
+                                                              alignof(Header),
+                                                              error_msg));
   if (map.get() == nullptr) {
     *error_msg = StringPrintf("Failed to extract '%s' from '%s': %s", entry_name, location.c_str(),
                               error_msg->c_str());
@@ -335,14 +348,15 @@ std::unique_ptr<const DexFile> DexFile::Open(const ZipArchive& zip_archive, cons
     *error_code = ZipOpenErrorCode::kDexFileError;
     return nullptr;
   }
-  if (!dex_file->DisableWrite()) {
+  // A directly mapped dex file is already read only.
+  if (!dex_file->IsReadOnly() && !dex_file->DisableWrite()) {
     *error_msg = StringPrintf("Failed to make dex file '%s' read only", location.c_str());
     *error_code = ZipOpenErrorCode::kMakeReadOnlyError;
     return nullptr;
   }
   CHECK(dex_file->IsReadOnly()) << location;
-  if (!DexFileVerifier::Verify(dex_file.get(), dex_file->Begin(), dex_file->Size(),
-                               location.c_str(), error_msg)) {
+  if (verify && !DexFileVerifier::Verify(dex_file.get(), dex_file->Begin(), dex_file->Size(),
+                                         location.c_str(), error_msg)) {
     *error_code = ZipOpenErrorCode::kVerifyError;
     return nullptr;
   }
@@ -356,53 +370,181 @@ std::unique_ptr<const DexFile> DexFile::Open(const ZipArchive& zip_archive, cons
 // seems an excessive number.
 static constexpr size_t kWarnOnManyDexFilesThreshold = 100;
 
+// The most threads verifying the dex files of a zip. Verification mostly reads the dex files, so
+// more threads than this mostly compete for the memory bandwidth.
+static constexpr size_t kMaxVerifyThreads = 4;
+
+namespace {
+
+// The dex files of a zip being verified, shared by the verifying threads.
+struct ZipDexFilesVerification {
+  struct Result {
+    // The dex file in the oat file that may be the same as the one being verified.
+    const OatDexFile* oat_dex_file = nullptr;
+    bool verified = false;
+    std::string error_msg;
+  };
+
+  explicit ZipDexFilesVerification(const std::vector<std::unique_ptr<const DexFile>>& files)
+      : dex_files(files), results(files.size()), next_index(0u) {}
+
+  void VerifyAll() {
+    for (size_t i = next_index.FetchAndAddSequentiallyConsistent(1u);
+         i < dex_files.size();
+         i = next_index.FetchAndAddSequentiallyConsistent(1u)) {
+      const DexFile* dex_file = dex_files[i].get();
+      Result* result = &results[i];
+      if (IsSameAsOatDexFile(dex_file, result->oat_dex_file)) {
+        result->verified = DexFileVerifier::VerifyChecksum(dex_file,
+                                                           dex_file->Begin(),
+                                                           dex_file->Size(),
+                                                           dex_file->GetLocation().c_str(),
+                                                           &result->error_msg);
+      } else {
+        result->verified = DexFileVerifier::Verify(dex_file,
+                                                   dex_file->Begin(),
+                                                   dex_file->Size(),
+                                                   dex_file->GetLocation().c_str(),
+                                                   &result->error_msg);
+      }
+    }
+  }
+
+  // The oat file was compiled from, and verified, the dex file if it still holds the same bytes.
+  // Matching checksums are not enough, as the oat file may have been rejected.
+  static bool IsSameAsOatDexFile(const DexFile* dex_file, const OatDexFile* oat_dex_file) {
+    return oat_dex_file != nullptr &&
+        oat_dex_file->FileSize() == dex_file->Size() &&
+        memcmp(oat_dex_file->GetDexFilePointer(), dex_file->Begin(), dex_file->Size()) == 0;
+  }
+
+  static void* VerifyAllCallback(void* arg) {
+    reinterpret_cast<ZipDexFilesVerification*>(arg)->VerifyAll();
+    return nullptr;
+  }
+
+  const std::vector<std::unique_ptr<const DexFile>>& dex_files;
+  std::vector<Result> results;
+  Atomic<size_t> next_index;
+};
+
+}  // namespace
+
+size_t DexFile::VerifyZipDexFiles(const std::vector<std::unique_ptr<const DexFile>>& dex_files,
+                                  const OatFile* oat_file,
+                                  std::string* error_msg) {
+  ScopedTrace trace("Verify dex files from Zip " + dex_files[0]->GetLocation());
+  ZipDexFilesVerification verification(dex_files);
+  if (oat_file != nullptr) {
+    // The dex files that the oat file holds a copy of only have their checksum verified, see
+    // ZipDexFilesVerification::IsSameAsOatDexFile(). The CRC32 of the zip entries must match to
+    // bother comparing them.
+    for (size_t i = 0; i != dex_files.size(); ++i) {
+      const DexFile* dex_file = dex_files[i].get();
+      const OatDexFile* oat_dex_file = oat_file->GetOatDexFile(dex_file->GetLocation().c_str(),
+                                                               nullptr,
+                                                               /* exception_if_not_found */ false);
+      if (oat_dex_file != nullptr &&
+          oat_dex_file->GetDexFileLocationChecksum() == dex_file->GetLocationChecksum()) {
+        verification.results[i].oat_dex_file = oat_dex_file;
+      }
+    }
+  }
+
+  // Verify on this thread and, for multidex zips, on a few more threads. These are plain
+  // pthreads as the runtime may not be started yet.
+  long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t num_threads = std::min(std::min(dex_files.size(), kMaxVerifyThreads),
+                                static_cast<size_t>(std::max(num_cpus, 1L)));
+  std::vector<pthread_t> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread,
+                       nullptr,
+                       &ZipDexFilesVerification::VerifyAllCallback,
+                       &verification) != 0) {
+      // Verify with the threads we have.
+      break;
+    }
+    threads.push_back(thread);
+  }
+  verification.VerifyAll();
+  for (pthread_t thread : threads) {
+    CHECK_PTHREAD_CALL(pthread_join, (thread, nullptr), "dex file verification thread");
+  }
+
+  for (size_t i = 0; i != dex_files.size(); ++i) {
+    if (!verification.results[i].verified) {
+      *error_msg = std::move(verification.results[i].error_msg);
+      return i;
+    }
+  }
+  return dex_files.size();
+}
+
 bool DexFile::OpenFromZip(const ZipArchive& zip_archive, const std::string& location,
                           std::string* error_msg,
-                          std::vector<std::unique_ptr<const DexFile>>* dex_files) {
+                          std::vector<std::unique_ptr<const DexFile>>* dex_files,
+                          const OatFile* oat_file) {
   ScopedTrace trace("Dex file open from Zip " + std::string(location));
   DCHECK(dex_files != nullptr) << "DexFile::OpenFromZip: out-param is nullptr";
+  // Open all the dex files first and verify them together.
+  std::vector<std::unique_ptr<const DexFile>> opened_dex_files;
   ZipOpenErrorCode error_code;
-  std::unique_ptr<const DexFile> dex_file(Open(zip_archive, kClassesDex, location, error_msg,
-                                               &error_code));
+  std::unique_ptr<const DexFile> dex_file(Open(zip_archive, kClassesDex, location,
+                                               /* verify */ false, error_msg, &error_code));
   if (dex_file.get() == nullptr) {
     return false;
-  } else {
-    // Had at least classes.dex.
-    dex_files->push_back(std::move(dex_file));
-
-    // Now try some more.
-
-    // We could try to avoid std::string allocations by working on a char array directly. As we
-    // do not expect a lot of iterations, this seems too involved and brittle.
-
-    for (size_t i = 1; ; ++i) {
-      std::string name = GetMultiDexClassesDexName(i);
-      std::string fake_location = GetMultiDexLocation(i, location.c_str());
-      std::unique_ptr<const DexFile> next_dex_file(Open(zip_archive, name.c_str(), fake_location,
-                                                        error_msg, &error_code));
-      if (next_dex_file.get() == nullptr) {
-        if (error_code != ZipOpenErrorCode::kEntryNotFound) {
-          LOG(WARNING) << error_msg;
-        }
-        break;
-      } else {
-        dex_files->push_back(std::move(next_dex_file));
-      }
+  }
+  // Had at least classes.dex.
+  opened_dex_files.push_back(std::move(dex_file));
 
-      if (i == kWarnOnManyDexFilesThreshold) {
-        LOG(WARNING) << location << " has in excess of " << kWarnOnManyDexFilesThreshold
-                     << " dex files. Please consider coalescing and shrinking the number to "
-                        " avoid runtime overhead.";
-      }
+  // Now try some more.
 
-      if (i == std::numeric_limits<size_t>::max()) {
-        LOG(ERROR) << "Overflow in number of dex files!";
-        break;
+  // We could try to avoid std::string allocations by working on a char array directly. As we
+  // do not expect a lot of iterations, this seems too involved and brittle.
+
+  for (size_t i = 1; ; ++i) {
+    std::string name = GetMultiDexClassesDexName(i);
+    std::string fake_location = GetMultiDexLocation(i, location.c_str());
+    std::unique_ptr<const DexFile> next_dex_file(Open(zip_archive, name.c_str(), fake_location,
+                                                      /* verify */ false, error_msg,
+                                                      &error_code));
+    if (next_dex_file.get() == nullptr) {
+      if (error_code != ZipOpenErrorCode::kEntryNotFound) {
+        LOG(WARNING) << *error_msg;
       }
+      break;
+    } else {
+      opened_dex_files.push_back(std::move(next_dex_file));
     }
 
-    return true;
+    if (i == kWarnOnManyDexFilesThreshold) {
+      LOG(WARNING) << location << " has in excess of " << kWarnOnManyDexFilesThreshold
+                   << " dex files. Please consider coalescing and shrinking the number to "
+                      " avoid runtime overhead.";
+    }
+
+    if (i == std::numeric_limits<size_t>::max()) {
+      LOG(ERROR) << "Overflow in number of dex files!";
+      break;
+    }
+  }
+
+  // As when opening them one by one, a classes.dex that fails verification fails the zip and
+  // the dex files from the first other one that fails are dropped.
+  size_t num_verified = VerifyZipDexFiles(opened_dex_files, oat_file, error_msg);
+  if (num_verified == 0u) {
+    return false;
   }
+  if (num_verified != opened_dex_files.size()) {
+    LOG(WARNING) << *error_msg;
+    opened_dex_files.resize(num_verified);
+  }
+  for (std::unique_ptr<const DexFile>& opened_dex_file : opened_dex_files) {
+    dex_files->push_back(std::move(opened_dex_file));
+  }
+  return true;
 }
 
 
@@ -439,7 +581,9 @@ DexFile::DexFile(const uint8_t* base, size_t size,
       method_ids_(reinterpret_cast<const MethodId*>(base + header_->method_ids_off_)),
       proto_ids_(reinterpret_cast<const ProtoId*>(base + header_->proto_ids_off_)),
       class_defs_(reinterpret_cast<const ClassDef*>(base + header_->class_defs_off_)),
-      oat_dex_file_(oat_dex_file) {
+      oat_dex_file_(oat_dex_file),
+      id_lookup_table_(nullptr),
+      id_lookup_misses_(0u) {
   CHECK(begin_ != nullptr) << GetLocation();
   CHECK_GT(size_, 0U) << GetLocation();
   const uint8_t* lookup_data = (oat_dex_file != nullptr)
@@ -452,6 +596,17 @@ DexFile::DexFile(const uint8_t* base, size_t size,
       lookup_table_.reset(TypeLookupTable::Open(lookup_data, *this));
     }
   }
+  const uint8_t* id_lookup_data = (oat_dex_file != nullptr)
+      ? oat_dex_file->GetIdLookupTableData()
+      : nullptr;
+  if (id_lookup_data != nullptr) {
+    if (id_lookup_data + IdLookupTable::RawDataLength(*this) >
+        oat_dex_file->GetOatFile()->End()) {
+      LOG(WARNING) << "found truncated id lookup table in " << GetLocation();
+    } else {
+      id_lookup_table_.StoreRelaxed(IdLookupTable::Open(id_lookup_data, *this));
+    }
+  }
 }
 
 DexFile::~DexFile() {
@@ -459,6 +614,7 @@ DexFile::~DexFile() {
   // that's only called after DetachCurrentThread, which means there's no JNIEnv. We could
   // re-attach, but cleaning up these global references is not obviously useful. It's not as if
   // the global reference table is otherwise empty!
+  delete id_lookup_table_.LoadRelaxed();
 }
 
 bool DexFile::Init(std::string* error_msg) {
@@ -585,10 +741,15 @@ const DexFile::FieldId* DexFile::FindFieldId(const DexFile::TypeId& declaring_kl
 const DexFile::MethodId* DexFile::FindMethodId(const DexFile::TypeId& declaring_klass,
                                                const DexFile::StringId& name,
                                                const DexFile::ProtoId& signature) const {
-  // Binary search MethodIds knowing that they are sorted by class_idx, name_idx then proto_idx
   const uint16_t class_idx = GetIndexForTypeId(declaring_klass);
   const uint32_t name_idx = GetIndexForStringId(name);
   const uint16_t proto_idx = GetIndexForProtoId(signature);
+  const IdLookupTable* id_lookup_table = GetOrCreateIdLookupTable();
+  if (LIKELY(id_lookup_table != nullptr)) {
+    const uint32_t method_idx = id_lookup_table->LookupMethod(class_idx, name_idx, proto_idx);
+    return (method_idx != DexFile::kDexNoIndex) ? &GetMethodId(method_idx) : nullptr;
+  }
+  // Binary search MethodIds knowing that they are sorted by class_idx, name_idx then proto_idx
   int32_t lo = 0;
   int32_t hi = NumMethodIds() - 1;
   while (hi >= lo) {
@@ -618,6 +779,12 @@ const DexFile::MethodId* DexFile::FindMethodId(const DexFile::TypeId& declaring_
 }
 
 const DexFile::StringId* DexFile::FindStringId(const char* string) const {
+  const IdLookupTable* id_lookup_table = GetOrCreateIdLookupTable();
+  if (LIKELY(id_lookup_table != nullptr)) {
+    const uint32_t string_idx =
+        id_lookup_table->LookupString(string, ComputeModifiedUtf8Hash(string));
+    return (string_idx != DexFile::kDexNoIndex) ? &GetStringId(string_idx) : nullptr;
+  }
   int32_t lo = 0;
   int32_t hi = NumStringIds() - 1;
   while (hi >= lo) {
@@ -637,6 +804,11 @@ const DexFile::StringId* DexFile::FindStringId(const char* string) const {
 }
 
 const DexFile::TypeId* DexFile::FindTypeId(const char* string) const {
+  if (GetIdLookupTable() != nullptr) {
+    // Replace the string comparisons with a hashed string lookup and an integer binary search.
+    const StringId* string_id = FindStringId(string);
+    return (string_id != nullptr) ? FindTypeId(GetIndexForStringId(*string_id)) : nullptr;
+  }
   int32_t lo = 0;
   int32_t hi = NumTypeIds() - 1;
   while (hi >= lo) {
@@ -732,6 +904,32 @@ void DexFile::CreateTypeLookupTable(uint8_t* storage) const {
   lookup_table_.reset(TypeLookupTable::Create(*this, storage));
 }
 
+void DexFile::CreateIdLookupTable(uint8_t* storage) const {
+  delete id_lookup_table_.LoadRelaxed();
+  id_lookup_table_.StoreRelease(IdLookupTable::Create(*this, storage));
+}
+
+// Number of string and method id lookups after which the runtime builds an id lookup table for
+// a dex file whose oat file does not provide one.
+static constexpr uint32_t kIdLookupTableThreshold = 1024u;
+
+IdLookupTable* DexFile::GetOrCreateIdLookupTable() const {
+  IdLookupTable* table = id_lookup_table_.LoadAcquire();
+  if (LIKELY(table != nullptr)) {
+    return table;
+  }
+  // Dex files that see only a few lookups are not worth the memory of a table. Exactly one
+  // thread reaches the threshold and builds the table; the others keep using binary search.
+  if (id_lookup_misses_.FetchAndAddRelaxed(1u) + 1u != kIdLookupTableThreshold) {
+    return nullptr;
+  }
+  table = IdLookupTable::Create(*this);
+  if (table != nullptr) {
+    id_lookup_table_.StoreRelease(table);
+  }
+  return table;
+}
+
 // Given a signature place the type ids into the given vector
 bool DexFile::CreateTypeList(const StringPiece& signature, uint16_t* return_type_idx,
                              std::vector<uint16_t>* param_type_idxs) const {
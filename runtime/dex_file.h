@@ -22,6 +22,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "atomic.h"
 #include "base/logging.h"
 #include "base/mutex.h"  // For Locks::mutator_lock_.
 #include "base/value_object.h"
@@ -48,10 +49,12 @@ template <class Key, class Value, class EmptyFn, class HashFn, class Pred, class
 class HashMap;
 class MemMap;
 class OatDexFile;
+class OatFile;
 class Signature;
 template<class T> class Handle;
 class StringPiece;
 class TypeLookupTable;
+class IdLookupTable;
 class ZipArchive;
 
 // TODO: move all of the macro functionality into the DexCache class.
@@ -416,8 +419,11 @@ class DexFile {
   static bool GetChecksum(const char* filename, uint32_t* checksum, std::string* error_msg);
 
   // Opens .dex files found in the container, guessing the container format based on file extension.
+  // The dex files of a zip that `oat_file` holds an identical copy of are trusted to be well
+  // formed and only have their checksum verified.
   static bool Open(const char* filename, const char* location, std::string* error_msg,
-                   std::vector<std::unique_ptr<const DexFile>>* dex_files);
+                   std::vector<std::unique_ptr<const DexFile>>* dex_files,
+                   const OatFile* oat_file = nullptr);
 
   // Checks whether the given file has the dex magic, or is a zip file with a classes.dex entry.
   // If this function returns false, Open will not succeed. The inverse is not true, however.
@@ -431,10 +437,11 @@ class DexFile {
                                              bool verify,
                                              std::string* error_msg);
 
-  // Open all classesXXX.dex files from a zip archive.
+  // Open all classesXXX.dex files from a zip archive. They are verified in parallel.
   static bool OpenFromZip(const ZipArchive& zip_archive, const std::string& location,
                           std::string* error_msg,
-                          std::vector<std::unique_ptr<const DexFile>>* dex_files);
+                          std::vector<std::unique_ptr<const DexFile>>* dex_files,
+                          const OatFile* oat_file = nullptr);
 
   // Closes a .dex file.
   virtual ~DexFile();
@@ -1175,6 +1182,14 @@ class DexFile {
 
   void CreateTypeLookupTable(uint8_t* storage = nullptr) const;
 
+  // Returns the string and method id lookup table, or null if it was neither opened from the oat
+  // file nor built yet.
+  IdLookupTable* GetIdLookupTable() const {
+    return id_lookup_table_.LoadAcquire();
+  }
+
+  void CreateIdLookupTable(uint8_t* storage = nullptr) const;
+
  private:
   // Opens a .dex file
   static std::unique_ptr<const DexFile> OpenFile(int fd, const char* location,
@@ -1182,7 +1197,8 @@ class DexFile {
 
   // Opens dex files from within a .jar, .zip, or .apk file
   static bool OpenZip(int fd, const std::string& location, std::string* error_msg,
-                      std::vector<std::unique_ptr<const DexFile>>* dex_files);
+                      std::vector<std::unique_ptr<const DexFile>>* dex_files,
+                      const OatFile* oat_file);
 
   enum class ZipOpenErrorCode {  // private
     kNoError,
@@ -1194,11 +1210,18 @@ class DexFile {
   };
 
   // Opens .dex file from the entry_name in a zip archive. error_code is undefined when non-null
-  // return.
+  // return. The structure of the dex file is verified only if `verify`.
   static std::unique_ptr<const DexFile> Open(const ZipArchive& zip_archive, const char* entry_name,
-                                             const std::string& location, std::string* error_msg,
+                                             const std::string& location, bool verify,
+                                             std::string* error_msg,
                                              ZipOpenErrorCode* error_code);
 
+  // Verify the dex files opened from a zip by OpenFromZip(), on several threads. Returns the
+  // number of dex files that passed before the first failure, whose error is in `error_msg`.
+  static size_t VerifyZipDexFiles(const std::vector<std::unique_ptr<const DexFile>>& dex_files,
+                                  const OatFile* oat_file,
+                                  std::string* error_msg);
+
   // Opens a .dex file at the given address backed by a MemMap
   static std::unique_ptr<const DexFile> OpenMemory(const std::string& location,
                                                    uint32_t location_checksum,
@@ -1226,6 +1249,10 @@ class DexFile {
   // Returns true if the header magic and version numbers are of the expected values.
   bool CheckMagicAndVersion(std::string* error_msg) const;
 
+  // Returns the id lookup table, building it once kIdLookupTableThreshold lookups had to fall
+  // back to binary search. Returns null while below the threshold.
+  IdLookupTable* GetOrCreateIdLookupTable() const;
+
   // Check whether a location denotes a multidex dex file. This is a very simple check: returns
   // whether the string contains the separator character.
   static bool IsMultiDexLocation(const char* location);
@@ -1274,9 +1301,14 @@ class DexFile {
   // null.
   const OatDexFile* oat_dex_file_;
   mutable std::unique_ptr<TypeLookupTable> lookup_table_;
+  // Owned. Published with release semantics since it may be built lazily by any thread.
+  mutable Atomic<IdLookupTable*> id_lookup_table_;
+  // Number of string and method id lookups that were done without id_lookup_table_.
+  mutable Atomic<uint32_t> id_lookup_misses_;
 
   friend class DexFileVerifierTest;
   ART_FRIEND_TEST(ClassLinkerTest, RegisterDexFileName);  // for constructor
+  ART_FRIEND_TEST(DexFileTest, VerifyZipDexFilesComparesOatDexFile);  // for VerifyZipDexFiles
 };
 
 struct DexFileReference {
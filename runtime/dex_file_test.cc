@@ -18,10 +18,16 @@
 
 #include <memory>
 
+#include <zlib.h>
+
 #include "base/stl_util.h"
 #include "base/unix_file/fd_file.h"
 #include "common_runtime_test.h"
 #include "dex_file-inl.h"
+#include "dex_file_verifier.h"
+#include "gc/heap.h"
+#include "gc/space/image_space.h"
+#include "oat_file.h"
 #include "os.h"
 #include "scoped_thread_state_change.h"
 #include "thread-inl.h"
@@ -387,6 +393,199 @@ TEST_F(DexFileTest, GetDexCanonicalLocation) {
   ASSERT_EQ(0, unlink(dex_location_sym.c_str()));
 }
 
+static void PutLE16(std::vector<uint8_t>* out, uint16_t value) {
+  out->push_back(value & 0xff);
+  out->push_back(value >> 8);
+}
+
+static void PutLE32(std::vector<uint8_t>* out, uint32_t value) {
+  PutLE16(out, value & 0xffff);
+  PutLE16(out, value >> 16);
+}
+
+// Write a zip holding the given dex files as classes.dex, classes2.dex, ..., stored uncompressed.
+static void WriteMultiDexZip(const std::string& filename,
+                             const std::vector<std::vector<uint8_t>>& dex_files) {
+  std::vector<uint8_t> zip;
+  std::vector<uint8_t> central_directory;
+  for (size_t i = 0; i != dex_files.size(); ++i) {
+    std::string name = DexFile::GetMultiDexClassesDexName(i);
+    const std::vector<uint8_t>& data = dex_files[i];
+    uint32_t crc = crc32(0u, data.data(), data.size());
+    uint32_t local_header_offset = zip.size();
+    PutLE32(&zip, 0x04034b50u);  // Local file header signature.
+    PutLE16(&zip, 10u);          // Version needed to extract.
+    PutLE16(&zip, 0u);           // Flags.
+    PutLE16(&zip, 0u);           // Stored.
+    PutLE16(&zip, 0u);           // Modification time.
+    PutLE16(&zip, 0x21u);        // Modification date, 1980-01-01.
+    PutLE32(&zip, crc);
+    PutLE32(&zip, data.size());  // Compressed size.
+    PutLE32(&zip, data.size());  // Uncompressed size.
+    PutLE16(&zip, name.size());
+    PutLE16(&zip, 0u);           // Extra field length.
+    zip.insert(zip.end(), name.begin(), name.end());
+    zip.insert(zip.end(), data.begin(), data.end());
+
+    PutLE32(&central_directory, 0x02014b50u);  // Central directory header signature.
+    PutLE16(&central_directory, 10u);          // Version made by.
+    PutLE16(&central_directory, 10u);          // Version needed to extract.
+    PutLE16(&central_directory, 0u);           // Flags.
+    PutLE16(&central_directory, 0u);           // Stored.
+    PutLE16(&central_directory, 0u);           // Modification time.
+    PutLE16(&central_directory, 0x21u);        // Modification date.
+    PutLE32(&central_directory, crc);
+    PutLE32(&central_directory, data.size());
+    PutLE32(&central_directory, data.size());
+    PutLE16(&central_directory, name.size());
+    PutLE16(&central_directory, 0u);           // Extra field length.
+    PutLE16(&central_directory, 0u);           // Comment length.
+    PutLE16(&central_directory, 0u);           // Disk number.
+    PutLE16(&central_directory, 0u);           // Internal attributes.
+    PutLE32(&central_directory, 0u);           // External attributes.
+    PutLE32(&central_directory, local_header_offset);
+    central_directory.insert(central_directory.end(), name.begin(), name.end());
+  }
+  uint32_t central_directory_offset = zip.size();
+  zip.insert(zip.end(), central_directory.begin(), central_directory.end());
+  PutLE32(&zip, 0x06054b50u);  // End of central directory signature.
+  PutLE16(&zip, 0u);           // Disk number.
+  PutLE16(&zip, 0u);           // Disk with the central directory.
+  PutLE16(&zip, dex_files.size());
+  PutLE16(&zip, dex_files.size());
+  PutLE32(&zip, central_directory.size());
+  PutLE32(&zip, central_directory_offset);
+  PutLE16(&zip, 0u);           // Comment length.
+
+  std::unique_ptr<File> file(OS::CreateEmptyFile(filename.c_str()));
+  CHECK(file.get() != nullptr);
+  if (!file->WriteFully(zip.data(), zip.size())) {
+    PLOG(FATAL) << "Failed to write zip file";
+  }
+  if (file->FlushCloseOrErase() != 0) {
+    PLOG(FATAL) << "Could not flush and close test file.";
+  }
+}
+
+// The contents of the dex files of the MultiDex test jar.
+static std::vector<std::vector<uint8_t>> GetMultiDexContents(
+    const std::vector<std::unique_ptr<const DexFile>>& dex_files) {
+  std::vector<std::vector<uint8_t>> contents;
+  for (const std::unique_ptr<const DexFile>& dex_file : dex_files) {
+    contents.emplace_back(dex_file->Begin(), dex_file->Begin() + dex_file->Size());
+  }
+  return contents;
+}
+
+TEST_F(DexFileTest, OpenZipDropsDexFilesFromFailingSecondaryDex) {
+  ScopedObjectAccess soa(Thread::Current());
+  std::vector<std::unique_ptr<const DexFile>> multidex = OpenTestDexFiles("MultiDex");
+  ASSERT_GE(multidex.size(), 2u);
+  std::vector<std::vector<uint8_t>> contents = GetMultiDexContents(multidex);
+  // A third dex file that is fine, but comes after the failing one.
+  contents.push_back(contents[1]);
+  contents[1][contents[1].size() / 2] ^= 0xff;
+
+  ScratchFile zip;
+  WriteMultiDexZip(zip.GetFilename(), contents);
+  std::string error_msg;
+  std::vector<std::unique_ptr<const DexFile>> dex_files;
+  ASSERT_TRUE(DexFile::Open(zip.GetFilename().c_str(),
+                            zip.GetFilename().c_str(),
+                            &error_msg,
+                            &dex_files)) << error_msg;
+  ASSERT_EQ(1u, dex_files.size());
+  EXPECT_EQ(zip.GetFilename(), dex_files[0]->GetLocation());
+  EXPECT_EQ(multidex[0]->GetHeader().checksum_, dex_files[0]->GetHeader().checksum_);
+}
+
+TEST_F(DexFileTest, OpenZipFailsWithFailingClassesDex) {
+  ScopedObjectAccess soa(Thread::Current());
+  std::vector<std::unique_ptr<const DexFile>> multidex = OpenTestDexFiles("MultiDex");
+  ASSERT_GE(multidex.size(), 2u);
+  std::vector<std::vector<uint8_t>> contents = GetMultiDexContents(multidex);
+  contents[0][contents[0].size() / 2] ^= 0xff;
+
+  ScratchFile zip;
+  WriteMultiDexZip(zip.GetFilename(), contents);
+  std::string error_msg;
+  std::vector<std::unique_ptr<const DexFile>> dex_files;
+  EXPECT_FALSE(DexFile::Open(zip.GetFilename().c_str(),
+                             zip.GetFilename().c_str(),
+                             &error_msg,
+                             &dex_files));
+  EXPECT_TRUE(dex_files.empty());
+  EXPECT_FALSE(error_msg.empty());
+}
+
+// Change the map offset of the dex file without changing its adler32 checksum. Adding 1, -2 and
+// 1 to three consecutive bytes keeps both sums of the checksum. The map offset changes by an odd
+// amount, which the verifier rejects.
+static bool CorruptMapOffsetKeepingChecksum(std::vector<uint8_t>* contents) {
+  uint8_t* bytes = contents->data() + OFFSETOF_MEMBER(DexFile::Header, map_off_);
+  if (bytes[0] != 0xff && bytes[1] >= 2u && bytes[2] != 0xff) {
+    bytes[0] += 1;
+    bytes[1] -= 2;
+    bytes[2] += 1;
+    return true;
+  } else if (bytes[0] != 0u && bytes[1] <= 0xfd && bytes[2] != 0u) {
+    bytes[0] -= 1;
+    bytes[1] += 2;
+    bytes[2] -= 1;
+    return true;
+  }
+  return false;
+}
+
+TEST_F(DexFileTest, VerifyZipDexFilesComparesOatDexFile) {
+  ScopedObjectAccess soa(Thread::Current());
+  const std::vector<gc::space::ImageSpace*>& image_spaces =
+      Runtime::Current()->GetHeap()->GetBootImageSpaces();
+  ASSERT_FALSE(image_spaces.empty());
+  const OatFile* oat_file = image_spaces[0]->GetOatFile();
+  ASSERT_TRUE(oat_file != nullptr);
+  const OatDexFile* oat_dex_file = oat_file->GetOatDexFiles()[0];
+  const uint8_t* begin = oat_dex_file->GetDexFilePointer();
+  std::vector<uint8_t> contents(begin, begin + oat_dex_file->FileSize());
+  std::vector<uint8_t> forged(contents);
+  ASSERT_TRUE(CorruptMapOffsetKeepingChecksum(&forged));
+
+  // Open the copies as if from the zip the oat file was compiled from.
+  std::string error_msg;
+  std::vector<std::unique_ptr<const DexFile>> copies;
+  for (const std::vector<uint8_t>* copy : { &contents, &forged }) {
+    std::unique_ptr<const DexFile> dex_file =
+        DexFile::Open(copy->data(),
+                      copy->size(),
+                      oat_dex_file->GetDexFileLocation(),
+                      oat_dex_file->GetDexFileLocationChecksum(),
+                      /* oat_dex_file */ nullptr,
+                      /* verify */ false,
+                      &error_msg);
+    ASSERT_TRUE(dex_file != nullptr) << error_msg;
+    copies.push_back(std::move(dex_file));
+  }
+  const DexFile* forged_dex_file = copies[1].get();
+  ASSERT_EQ(copies[0]->GetHeader().checksum_, forged_dex_file->GetHeader().checksum_);
+  ASSERT_TRUE(DexFileVerifier::VerifyChecksum(forged_dex_file,
+                                              forged_dex_file->Begin(),
+                                              forged_dex_file->Size(),
+                                              forged_dex_file->GetLocation().c_str(),
+                                              &error_msg)) << error_msg;
+
+  // The identical copy is trusted, and passes without a structural verification.
+  std::vector<std::unique_ptr<const DexFile>> dex_files;
+  dex_files.push_back(std::move(copies[0]));
+  EXPECT_EQ(1u, DexFile::VerifyZipDexFiles(dex_files, oat_file, &error_msg)) << error_msg;
+
+  // The forged copy has the same checksums, but is verified and fails.
+  dex_files.clear();
+  dex_files.push_back(std::move(copies[1]));
+  error_msg.clear();
+  EXPECT_EQ(0u, DexFile::VerifyZipDexFiles(dex_files, oat_file, &error_msg));
+  EXPECT_NE(std::string::npos, error_msg.find("map")) << error_msg;
+}
+
 TEST(DexFileUtilsTest, GetBaseLocationAndMultiDexSuffix) {
   EXPECT_EQ("/foo/bar/baz.jar", DexFile::GetBaseLocation("/foo/bar/baz.jar"));
   EXPECT_EQ("/foo/bar/baz.jar", DexFile::GetBaseLocation("/foo/bar/baz.jar:classes2.dex"));
@@ -17,10 +17,9 @@
 #include "dex_file_verifier.h"
 
 #include <inttypes.h>
-#include <zlib.h>
-
 #include <memory>
 
+#include "base/adler32.h"
 #include "base/stringprintf.h"
 #include "dex_file-inl.h"
 #include "experimental_flags.h"
@@ -138,6 +137,16 @@ bool DexFileVerifier::Verify(const DexFile* dex_file, const uint8_t* begin, size
   return true;
 }
 
+bool DexFileVerifier::VerifyChecksum(const DexFile* dex_file, const uint8_t* begin, size_t size,
+                                     const char* location, std::string* error_msg) {
+  std::unique_ptr<DexFileVerifier> verifier(new DexFileVerifier(dex_file, begin, size, location));
+  if (!verifier->CheckFileSizeAndChecksum()) {
+    *error_msg = verifier->FailureReason();
+    return false;
+  }
+  return true;
+}
+
 bool DexFileVerifier::CheckShortyDescriptorMatch(char shorty_char, const char* descriptor,
                                                 bool is_return_type) {
   switch (shorty_char) {
@@ -259,7 +268,7 @@ bool DexFileVerifier::CheckSizeLimit(uint32_t size, uint32_t limit, const char*
   return true;
 }
 
-bool DexFileVerifier::CheckHeader() {
+bool DexFileVerifier::CheckFileSizeAndChecksum() {
   // Check file size from the header.
   uint32_t expected_size = header_->file_size_;
   if (size_ != expected_size) {
@@ -268,14 +277,20 @@ bool DexFileVerifier::CheckHeader() {
   }
 
   // Compute and verify the checksum in the header.
-  uint32_t adler_checksum = adler32(0L, Z_NULL, 0);
   const uint32_t non_sum = sizeof(header_->magic_) + sizeof(header_->checksum_);
   const uint8_t* non_sum_ptr = reinterpret_cast<const uint8_t*>(header_) + non_sum;
-  adler_checksum = adler32(adler_checksum, non_sum_ptr, expected_size - non_sum);
+  uint32_t adler_checksum = Adler32(kAdler32Initial, non_sum_ptr, expected_size - non_sum);
   if (adler_checksum != header_->checksum_) {
     ErrorStringPrintf("Bad checksum (%08x, expected %08x)", adler_checksum, header_->checksum_);
     return false;
   }
+  return true;
+}
+
+bool DexFileVerifier::CheckHeader() {
+  if (!CheckFileSizeAndChecksum()) {
+    return false;
+  }
 
   // Check the contents of the header.
   if (header_->endian_tag_ != DexFile::kDexEndianConstant) {
@@ -2225,6 +2225,7 @@ extern "C" TwoWordReturn artInvokeInterfaceTrampoline(uint32_t deadbeef ATTRIBUT
   uint32_t imt_index = interface_method->GetDexMethodIndex();
   ArtMethod* conflict_method = imt->Get(imt_index % ImTable::kSize, sizeof(void*));
   if (conflict_method->IsRuntimeMethod()) {
+    Runtime::Current()->GetClassLinker()->RecordImtConflictTableMiss();
     ArtMethod* new_conflict_method = Runtime::Current()->GetClassLinker()->AddMethodToConflictTable(
         cls.Get(),
         conflict_method,
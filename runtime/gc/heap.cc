@@ -71,6 +71,7 @@
 #include "ScopedLocalRef.h"
 #include "scoped_thread_state_change.h"
 #include "handle_scope-inl.h"
+#include "startup_timeline.h"
 #include "thread_list.h"
 #include "well_known_classes.h"
 
@@ -260,6 +261,7 @@ Heap::Heap(size_t initial_size,
     LOG(INFO) << "Heap() entering";
   }
   ScopedTrace trace(__FUNCTION__);
+  ScopedStartupPhase phase("gc::Heap::Heap");
   Runtime* const runtime = Runtime::Current();
   // If we aren't the zygote, switch to the default non zygote allocator. This may update the
   // entrypoints.
@@ -2747,7 +2749,16 @@ collector::GcType Heap::CollectGarbageInternal(collector::GcType gc_type,
   CHECK(collector != nullptr)
       << "Could not find garbage collector with collector_type="
       << static_cast<size_t>(collector_type_) << " and gc_type=" << gc_type;
+  // Every collector suspends all threads at least once, after which no class table lookup can
+  // still be reading the storage the class tables replaced before.
+  ClassLinker* const class_linker = runtime->GetClassLinker();
+  if (class_linker != nullptr) {
+    class_linker->DetachRetiredClassTableStorage();
+  }
   collector->Run(gc_cause, clear_soft_references || runtime->IsZygote());
+  if (class_linker != nullptr) {
+    class_linker->FreeDetachedClassTableStorage();
+  }
   total_objects_freed_ever_ += GetCurrentGcIteration()->GetFreedObjects();
   total_bytes_freed_ever_ += GetCurrentGcIteration()->GetFreedBytes();
   RequestTrim(self);
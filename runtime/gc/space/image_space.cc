@@ -29,19 +29,28 @@
 #include "base/systrace.h"
 #include "base/time_utils.h"
 #include "gc/accounting/space_bitmap-inl.h"
+#include "gc/heap.h"
+#include "gc/scoped_gc_critical_section.h"
 #include "image-inl.h"
 #include "image_space_fs.h"
 #include "mirror/class-inl.h"
 #include "mirror/object-inl.h"
 #include "oat_file.h"
 #include "os.h"
+#include "runtime.h"
+#include "scoped_thread_state_change.h"
 #include "space-inl.h"
+#include "startup_timeline.h"
+#include "thread_pool.h"
 #include "utils.h"
 
 namespace art {
 namespace gc {
 namespace space {
 
+// Decompress the blocks of compressed images on a thread pool when possible.
+static constexpr bool kParallelImageDecompression = true;
+
 Atomic<uint32_t> ImageSpace::bitmap_index_(0);
 
 ImageSpace::ImageSpace(const std::string& image_filename,
@@ -373,6 +382,7 @@ ImageSpace* ImageSpace::CreateBootImage(const char* image_location,
                                         bool secondary_image,
                                         std::string* error_msg) {
   ScopedTrace trace(__FUNCTION__);
+  ScopedStartupPhase phase("ImageSpace::CreateBootImage", image_location);
   std::string system_filename;
   bool has_system = false;
   std::string cache_filename;
@@ -765,9 +775,13 @@ class FixupObjectVisitor : public FixupVisitor {
       // Space is not yet added to the heap, don't do a read barrier.
       mirror::Object* ref = obj->GetFieldObject<mirror::Object, kVerifyNone, kWithoutReadBarrier>(
           offset);
-      // Use SetFieldObjectWithoutWriteBarrier to avoid card marking since we are writing to the
-      // image.
-      obj->SetFieldObjectWithoutWriteBarrier<false, true, kVerifyNone>(offset, ForwardObject(ref));
+      mirror::Object* new_ref = ForwardObject(ref);
+      // Only write references that actually move so that pages which only hold null or boot image
+      // references are not dirtied. Use SetFieldObjectWithoutWriteBarrier to avoid card marking
+      // since we are writing to the image.
+      if (ref != new_ref) {
+        obj->SetFieldObjectWithoutWriteBarrier<false, true, kVerifyNone>(offset, new_ref);
+      }
     }
   }
 
@@ -795,9 +809,12 @@ class FixupObjectVisitor : public FixupVisitor {
   void operator()(mirror::Class* klass ATTRIBUTE_UNUSED, mirror::Reference* ref) const
       SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::heap_bitmap_lock_) {
     mirror::Object* obj = ref->GetReferent<kWithoutReadBarrier>();
-    ref->SetFieldObjectWithoutWriteBarrier<false, true, kVerifyNone>(
-        mirror::Reference::ReferentOffset(),
-        ForwardObject(obj));
+    mirror::Object* new_obj = ForwardObject(obj);
+    if (obj != new_obj) {
+      ref->SetFieldObjectWithoutWriteBarrier<false, true, kVerifyNone>(
+          mirror::Reference::ReferentOffset(),
+          new_obj);
+    }
   }
 
   void operator()(mirror::Object* obj) const NO_THREAD_SAFETY_ANALYSIS {
@@ -1146,6 +1163,118 @@ static bool RelocateInPlace(ImageHeader& image_header,
   return true;
 }
 
+// Decompresses a single block of a compressed image on a thread pool worker.
+class DecompressImageBlockTask FINAL : public Task {
+ public:
+  DecompressImageBlockTask(const ImageHeader::Block& block,
+                           uint8_t* out_ptr,
+                           const uint8_t* in_ptr,
+                           Atomic<bool>* failed)
+      : block_(block), out_ptr_(out_ptr), in_ptr_(in_ptr), failed_(failed) {}
+
+  void Run(Thread* self ATTRIBUTE_UNUSED) OVERRIDE {
+    std::string error_msg;
+    if (!block_.Decompress(out_ptr_, in_ptr_, &error_msg)) {
+      LOG(ERROR) << error_msg;
+      failed_->StoreRelaxed(true);
+    }
+  }
+
+  void Finalize() OVERRIDE {
+    delete this;
+  }
+
+ private:
+  const ImageHeader::Block& block_;
+  uint8_t* const out_ptr_;
+  const uint8_t* const in_ptr_;
+  Atomic<bool>* const failed_;
+};
+
+bool ImageSpace::DecompressImage(const ImageHeader& image_header,
+                                 uint8_t* out_ptr,
+                                 const uint8_t* in_ptr,
+                                 size_t in_size,
+                                 size_t max_threads,
+                                 std::string* error_msg) {
+  DCHECK_NE(max_threads, 0u);
+  const size_t blocks_count = image_header.GetBlocksCount();
+  const size_t blocks_offset = image_header.GetBlocksOffset();
+  if (blocks_count == 0u ||
+      blocks_offset < sizeof(ImageHeader) ||
+      blocks_offset + blocks_count * sizeof(ImageHeader::Block) > in_size) {
+    *error_msg = StringPrintf("Invalid image block table offset=%zu count=%zu file size=%zu",
+                              blocks_offset,
+                              blocks_count,
+                              in_size);
+    return false;
+  }
+  // Blocks must cover the image data after the header contiguously and their stored data must
+  // come before the block table.
+  const ImageHeader::Block* const blocks = image_header.GetBlocks(in_ptr);
+  size_t expected_image_offset = sizeof(ImageHeader);
+  for (size_t i = 0; i < blocks_count; ++i) {
+    const ImageHeader::Block& block = blocks[i];
+    if (block.GetImageOffset() != expected_image_offset ||
+        block.GetImageSize() > image_header.GetImageSize() - expected_image_offset ||
+        block.GetDataOffset() < sizeof(ImageHeader) ||
+        block.GetDataOffset() > blocks_offset ||
+        block.GetDataSize() > blocks_offset - block.GetDataOffset()) {
+      *error_msg = StringPrintf("Invalid image block %zu", i);
+      return false;
+    }
+    expected_image_offset += block.GetImageSize();
+  }
+  if (expected_image_offset != image_header.GetImageSize()) {
+    *error_msg = StringPrintf("Decompressed size does not match expected image size %zu vs %zu",
+                              expected_image_offset,
+                              image_header.GetImageSize());
+    return false;
+  }
+
+  Thread* const self = Thread::Current();
+  if (self != nullptr) {
+    // Waiting for the thread pool while holding the mutator lock would block suspend all.
+    Locks::mutator_lock_->AssertNotHeld(self);
+  }
+  // The boot image is loaded before the main thread is attached and the heap thread pool is
+  // created, in which case we decompress on the loading thread.
+  ThreadPool* const thread_pool =
+      self != nullptr ? Runtime::Current()->GetHeap()->GetThreadPool() : nullptr;
+  const size_t num_threads = thread_pool != nullptr
+      ? std::min(std::min(blocks_count, max_threads) - 1u, thread_pool->GetThreadCount())
+      : 0u;
+  if (num_threads == 0u) {
+    for (size_t i = 0; i < blocks_count; ++i) {
+      if (!blocks[i].Decompress(out_ptr, in_ptr, error_msg)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // The loading thread also takes tasks, so the pool needs one thread less than the cores.
+  // Keep the GC from using the heap thread pool until we are done with it.
+  gc::ScopedGCCriticalSection gcs(self,
+                                  gc::kGcCauseAddRemoveAppImageSpace,
+                                  gc::kCollectorTypeAddRemoveAppImageSpace);
+  Atomic<bool> failed(false);
+  for (size_t i = 0; i < blocks_count; ++i) {
+    thread_pool->AddTask(self, new DecompressImageBlockTask(blocks[i], out_ptr, in_ptr, &failed));
+  }
+  thread_pool->SetMaxActiveWorkers(num_threads);
+  thread_pool->StartWorkers(self);
+  thread_pool->Wait(self, /*do_work*/ true, /*may_hold_locks*/ false);
+  thread_pool->StopWorkers(self);
+  if (failed.LoadRelaxed()) {
+    *error_msg = "Failed to decompress image blocks";
+    return false;
+  }
+  VLOG(image) << "Decompressed " << blocks_count << " image blocks using " << num_threads + 1
+              << " threads";
+  return true;
+}
+
 ImageSpace* ImageSpace::Init(const char* image_filename,
                              const char* image_location,
                              bool validate_oat_file,
@@ -1154,6 +1283,7 @@ ImageSpace* ImageSpace::Init(const char* image_filename,
   CHECK(image_filename != nullptr);
   CHECK(image_location != nullptr);
 
+  ScopedStartupPhase phase("ImageSpace::Init", image_filename);
   TimingLogger logger(__PRETTY_FUNCTION__, true, VLOG_IS_ON(image));
   VLOG(image) << "ImageSpace::Init entering image_filename=" << image_filename;
 
@@ -1283,21 +1413,34 @@ ImageSpace* ImageSpace::Init(const char* image_filename,
         }
         memcpy(map->Begin(), image_header, sizeof(ImageHeader));
         const uint64_t start = NanoTime();
-        // LZ4HC and LZ4 have same internal format, both use LZ4_decompress.
         TimingLogger::ScopedTiming timing2("LZ4 decompress image", &logger);
-        const size_t decompressed_size = LZ4_decompress_safe(
-            reinterpret_cast<char*>(temp_map->Begin()) + sizeof(ImageHeader),
-            reinterpret_cast<char*>(map->Begin()) + decompress_offset,
-            stored_size,
-            map->Size() - decompress_offset);
-        VLOG(image) << "Decompressing image took " << PrettyDuration(NanoTime() - start);
-        if (decompressed_size + sizeof(ImageHeader) != image_header->GetImageSize()) {
-          *error_msg = StringPrintf(
-              "Decompressed size does not match expected image size %zu vs %zu",
-              decompressed_size + sizeof(ImageHeader),
-              image_header->GetImageSize());
+        const size_t max_threads = kParallelImageDecompression
+            ? static_cast<size_t>(std::max(sysconf(_SC_NPROCESSORS_CONF), 1L))
+            : 1u;
+        Thread* const self = Thread::Current();
+        bool decompressed;
+        if (self != nullptr) {
+          // App images are loaded with the mutator lock held. Release it while decompressing so
+          // that we can wait for the thread pool and do not hold up suspend all.
+          ScopedThreadSuspension sts(self, kNative);
+          decompressed = DecompressImage(*image_header,
+                                         map->Begin(),
+                                         temp_map->Begin(),
+                                         temp_map->Size(),
+                                         max_threads,
+                                         error_msg);
+        } else {
+          decompressed = DecompressImage(*image_header,
+                                         map->Begin(),
+                                         temp_map->Begin(),
+                                         temp_map->Size(),
+                                         max_threads,
+                                         error_msg);
+        }
+        if (!decompressed) {
           return nullptr;
         }
+        VLOG(image) << "Decompressing image took " << PrettyDuration(NanoTime() - start);
       }
     }
     if (map != nullptr) {
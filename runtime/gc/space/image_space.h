@@ -155,6 +155,16 @@ class ImageSpace : public MemMapSpace {
 
   void DumpSections(std::ostream& os) const;
 
+  // Decompresses the blocks of a compressed image from in_ptr (the mapped image file of size
+  // in_size) into out_ptr, on up to max_threads threads. The calling thread takes part and, if it
+  // is attached, uses the heap thread pool for the others. It must not hold the mutator lock.
+  static bool DecompressImage(const ImageHeader& image_header,
+                              uint8_t* out_ptr,
+                              const uint8_t* in_ptr,
+                              size_t in_size,
+                              size_t max_threads,
+                              std::string* error_msg);
+
  protected:
   // Tries to initialize an ImageSpace from the given image path, returning null on error.
   //
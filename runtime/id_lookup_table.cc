@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "id_lookup_table.h"
+
+#include "base/bit_utils.h"
+#include "dex_file-inl.h"
+#include "utf-inl.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace art {
+
+// Larger id sections are left to the binary search.
+static constexpr uint32_t kMaxIds = 1u << 24;
+
+IdLookupTable::~IdLookupTable() {
+  if (!owns_entries_) {
+    // We don't actually own the entries, don't let the unique_ptr release them.
+    entries_.release();
+  }
+}
+
+uint32_t IdLookupTable::RawDataLength() const {
+  return (GetStringBuckets() + GetMethodBuckets()) * sizeof(uint32_t);
+}
+
+uint32_t IdLookupTable::RawDataLength(const DexFile& dex_file) {
+  return RawDataLength(dex_file.NumStringIds(), dex_file.NumMethodIds());
+}
+
+uint32_t IdLookupTable::RawDataLength(uint32_t num_string_ids, uint32_t num_method_ids) {
+  uint32_t string_mask = CalculateMask(num_string_ids);
+  uint32_t method_mask = CalculateMask(num_method_ids);
+  uint32_t buckets = ((string_mask != 0u) ? string_mask + 1u : 0u) +
+                     ((method_mask != 0u) ? method_mask + 1u : 0u);
+  return buckets * sizeof(uint32_t);
+}
+
+uint32_t IdLookupTable::CalculateMask(uint32_t num_ids) {
+  // Keep the load factor at or below 1/2. Note that the mask is never 0 for a non-empty table.
+  return (num_ids != 0u && num_ids <= kMaxIds) ? RoundUpToPowerOfTwo(num_ids * 2u) - 1u : 0u;
+}
+
+IdLookupTable* IdLookupTable::Create(const DexFile& dex_file, uint8_t* storage) {
+  return (RawDataLength(dex_file) != 0u) ? new IdLookupTable(dex_file, storage) : nullptr;
+}
+
+IdLookupTable* IdLookupTable::Open(const uint8_t* raw_data, const DexFile& dex_file) {
+  return new IdLookupTable(raw_data, dex_file);
+}
+
+IdLookupTable::IdLookupTable(const DexFile& dex_file, uint8_t* storage)
+    : dex_file_(dex_file),
+      string_mask_(CalculateMask(dex_file.NumStringIds())),
+      method_mask_(CalculateMask(dex_file.NumMethodIds())),
+      entries_(storage != nullptr
+                   ? reinterpret_cast<uint32_t*>(storage)
+                   : new uint32_t[GetStringBuckets() + GetMethodBuckets()]),
+      owns_entries_(storage == nullptr) {
+  DCHECK_ALIGNED(storage, alignof(uint32_t));
+  uint32_t* string_entries = entries_.get();
+  uint32_t* method_entries = string_entries + GetStringBuckets();
+  std::fill_n(string_entries, GetStringBuckets() + GetMethodBuckets(), 0u);
+  if (string_mask_ != 0u) {
+    for (uint32_t i = 0, num_string_ids = dex_file.NumStringIds(); i != num_string_ids; ++i) {
+      uint32_t hash = ComputeModifiedUtf8Hash(dex_file.GetStringData(dex_file.GetStringId(i)));
+      Insert(string_entries, string_mask_, hash, i);
+    }
+  }
+  if (method_mask_ != 0u) {
+    for (uint32_t i = 0, num_method_ids = dex_file.NumMethodIds(); i != num_method_ids; ++i) {
+      const DexFile::MethodId& method_id = dex_file.GetMethodId(i);
+      uint32_t hash = HashMethodId(method_id.class_idx_, method_id.name_idx_, method_id.proto_idx_);
+      Insert(method_entries, method_mask_, hash, i);
+    }
+  }
+}
+
+IdLookupTable::IdLookupTable(const uint8_t* raw_data, const DexFile& dex_file)
+    : dex_file_(dex_file),
+      string_mask_(CalculateMask(dex_file.NumStringIds())),
+      method_mask_(CalculateMask(dex_file.NumMethodIds())),
+      entries_(reinterpret_cast<uint32_t*>(const_cast<uint8_t*>(raw_data))),
+      owns_entries_(false) {}
+
+void IdLookupTable::Insert(uint32_t* entries, uint32_t mask, uint32_t hash, uint32_t idx) {
+  uint32_t pos = hash & mask;
+  while (entries[pos] != 0u) {
+    pos = (pos + 1u) & mask;
+  }
+  entries[pos] = idx + 1u;
+}
+
+}  // namespace art
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_ID_LOOKUP_TABLE_H_
+#define ART_RUNTIME_ID_LOOKUP_TABLE_H_
+
+#include "dex_file.h"
+#include "leb128.h"
+#include "utf.h"
+
+namespace art {
+
+/**
+ * IdLookupTable maps string data to string_idx and (class_idx, name_idx, proto_idx) to
+ * method_idx, replacing the binary searches over the sorted id sections of a dex file.
+ * Like TypeLookupTable, it is created at compile time by calling Create() and written into the
+ * OAT file, then opened from the memory-mapped file at runtime by calling Open(). When the oat
+ * file does not provide a table, the runtime builds one lazily, see DexFile::FindStringId().
+ *
+ * The raw data consists of two open addressed tables with linear probing, strings first, then
+ * methods. Each bucket holds an index + 1, so that zero marks an empty bucket. Each table has
+ * at least twice as many buckets as entries, keeping probe sequences short.
+ */
+class IdLookupTable {
+ public:
+  ~IdLookupTable();
+
+  // Return the string_idx of the string with the given data and hash (as computed by
+  // ComputeModifiedUtf8Hash()), or DexFile::kDexNoIndex if there is no such string.
+  ALWAYS_INLINE uint32_t LookupString(const char* str, uint32_t hash) const {
+    if (string_mask_ == 0u) {
+      return DexFile::kDexNoIndex;
+    }
+    const uint32_t* entries = entries_.get();
+    for (uint32_t pos = hash & string_mask_; entries[pos] != 0u; pos = (pos + 1u) & string_mask_) {
+      const uint32_t string_idx = entries[pos] - 1u;
+      if (IsStringsEquals(str, string_idx)) {
+        return string_idx;
+      }
+    }
+    return DexFile::kDexNoIndex;
+  }
+
+  // Return the method_idx of the method id with the given declaring class, name and proto,
+  // or DexFile::kDexNoIndex if there is no such method id.
+  ALWAYS_INLINE uint32_t LookupMethod(uint16_t class_idx,
+                                      uint32_t name_idx,
+                                      uint16_t proto_idx) const {
+    if (method_mask_ == 0u) {
+      return DexFile::kDexNoIndex;
+    }
+    const uint32_t* entries = entries_.get() + GetStringBuckets();
+    uint32_t hash = HashMethodId(class_idx, name_idx, proto_idx);
+    for (uint32_t pos = hash & method_mask_; entries[pos] != 0u; pos = (pos + 1u) & method_mask_) {
+      const uint32_t method_idx = entries[pos] - 1u;
+      const DexFile::MethodId& method_id = dex_file_.GetMethodId(method_idx);
+      if (method_id.class_idx_ == class_idx &&
+          method_id.name_idx_ == name_idx &&
+          method_id.proto_idx_ == proto_idx) {
+        return method_idx;
+      }
+    }
+    return DexFile::kDexNoIndex;
+  }
+
+  // Method creates lookup table for dex file. Returns null if the dex file has no string
+  // or method ids.
+  static IdLookupTable* Create(const DexFile& dex_file, uint8_t* storage = nullptr);
+
+  // Method opens lookup table from binary data. Lookup table does not own binary data.
+  static IdLookupTable* Open(const uint8_t* raw_data, const DexFile& dex_file);
+
+  // Method returns pointer to binary data of lookup table. Used by the oat writer.
+  const uint8_t* RawData() const {
+    return reinterpret_cast<const uint8_t*>(entries_.get());
+  }
+
+  // Method returns length of binary data. Used by the oat writer.
+  uint32_t RawDataLength() const;
+
+  // Method returns length of binary data for the specified dex file.
+  static uint32_t RawDataLength(const DexFile& dex_file);
+
+  // Method returns length of binary data for the specified number of string and method ids.
+  static uint32_t RawDataLength(uint32_t num_string_ids, uint32_t num_method_ids);
+
+ private:
+  static uint32_t CalculateMask(uint32_t num_ids);
+
+  static uint32_t HashMethodId(uint16_t class_idx, uint32_t name_idx, uint16_t proto_idx) {
+    // The ids are sorted by class, then name, then proto, so consecutive method ids differ
+    // mostly in the low bits of name_idx and proto_idx. Mix them to spread the entries.
+    uint32_t hash = (static_cast<uint32_t>(class_idx) << 16) ^ proto_idx ^ (name_idx * 31u);
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    return hash;
+  }
+
+  // Construct from a dex file.
+  IdLookupTable(const DexFile& dex_file, uint8_t* storage);
+
+  // Construct from a dex file with existing data.
+  IdLookupTable(const uint8_t* raw_data, const DexFile& dex_file);
+
+  bool IsStringsEquals(const char* str, uint32_t string_idx) const {
+    const uint8_t* ptr = dex_file_.Begin() + dex_file_.GetStringId(string_idx).string_data_off_;
+    // Skip string length.
+    DecodeUnsignedLeb128(&ptr);
+    return CompareModifiedUtf8ToModifiedUtf8AsUtf16CodePointValues(
+        str, reinterpret_cast<const char*>(ptr)) == 0;
+  }
+
+  uint32_t GetStringBuckets() const {
+    return (string_mask_ != 0u) ? string_mask_ + 1u : 0u;
+  }
+
+  uint32_t GetMethodBuckets() const {
+    return (method_mask_ != 0u) ? method_mask_ + 1u : 0u;
+  }
+
+  // Insert an index + 1 into the table with the given mask, probing until there is an empty slot.
+  static void Insert(uint32_t* entries, uint32_t mask, uint32_t hash, uint32_t idx);
+
+  const DexFile& dex_file_;
+  const uint32_t string_mask_;
+  const uint32_t method_mask_;
+  std::unique_ptr<uint32_t[]> entries_;
+  // owns_entries_ specifies if the lookup table owns the entries_ array.
+  const bool owns_entries_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(IdLookupTable);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_ID_LOOKUP_TABLE_H_
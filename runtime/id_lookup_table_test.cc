@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+
+#include "common_runtime_test.h"
+#include "dex_file-inl.h"
+#include "id_lookup_table.h"
+#include "scoped_thread_state_change.h"
+#include "utf-inl.h"
+
+namespace art {
+
+static const size_t kDexNoIndex = DexFile::kDexNoIndex;  // Make copy to prevent linking errors.
+
+class IdLookupTableTest : public CommonRuntimeTest {};
+
+TEST_F(IdLookupTableTest, CreateLookupTable) {
+  ScopedObjectAccess soa(Thread::Current());
+  std::unique_ptr<const DexFile> dex_file(OpenTestDexFile("Lookup"));
+  std::unique_ptr<IdLookupTable> table(IdLookupTable::Create(*dex_file));
+  ASSERT_NE(nullptr, table.get());
+  ASSERT_NE(nullptr, table->RawData());
+  ASSERT_EQ(IdLookupTable::RawDataLength(*dex_file), table->RawDataLength());
+  ASSERT_EQ(IdLookupTable::RawDataLength(dex_file->NumStringIds(), dex_file->NumMethodIds()),
+            table->RawDataLength());
+}
+
+TEST_F(IdLookupTableTest, FindStrings) {
+  ScopedObjectAccess soa(Thread::Current());
+  std::unique_ptr<const DexFile> dex_file(OpenTestDexFile("Lookup"));
+  std::unique_ptr<IdLookupTable> table(IdLookupTable::Create(*dex_file));
+  ASSERT_NE(nullptr, table.get());
+  for (uint32_t i = 0; i != dex_file->NumStringIds(); ++i) {
+    const char* str = dex_file->StringDataByIdx(i);
+    EXPECT_EQ(i, table->LookupString(str, ComputeModifiedUtf8Hash(str))) << str;
+  }
+  const char* missing = "LNoSuchClass;";
+  ASSERT_EQ(nullptr, dex_file->FindStringId(missing));
+  EXPECT_EQ(kDexNoIndex, table->LookupString(missing, ComputeModifiedUtf8Hash(missing)));
+}
+
+TEST_F(IdLookupTableTest, FindMethods) {
+  ScopedObjectAccess soa(Thread::Current());
+  std::unique_ptr<const DexFile> dex_file(OpenTestDexFile("Lookup"));
+  std::unique_ptr<IdLookupTable> table(IdLookupTable::Create(*dex_file));
+  ASSERT_NE(nullptr, table.get());
+  ASSERT_NE(0u, dex_file->NumMethodIds());
+  for (uint32_t i = 0; i != dex_file->NumMethodIds(); ++i) {
+    const DexFile::MethodId& method_id = dex_file->GetMethodId(i);
+    EXPECT_EQ(i, table->LookupMethod(method_id.class_idx_,
+                                     method_id.name_idx_,
+                                     method_id.proto_idx_));
+  }
+  // The class descriptor string is never a method name.
+  const DexFile::MethodId& method_id = dex_file->GetMethodId(0);
+  uint32_t class_name_idx = dex_file->GetTypeId(method_id.class_idx_).descriptor_idx_;
+  EXPECT_EQ(kDexNoIndex, table->LookupMethod(method_id.class_idx_,
+                                             class_name_idx,
+                                             method_id.proto_idx_));
+}
+
+TEST_F(IdLookupTableTest, DexFileLookups) {
+  ScopedObjectAccess soa(Thread::Current());
+  std::unique_ptr<const DexFile> dex_file(OpenTestDexFile("Lookup"));
+  ASSERT_EQ(nullptr, dex_file->GetIdLookupTable());
+  dex_file->CreateIdLookupTable();
+  ASSERT_NE(nullptr, dex_file->GetIdLookupTable());
+  for (uint32_t i = 0; i != dex_file->NumTypeIds(); ++i) {
+    const DexFile::TypeId& type_id = dex_file->GetTypeId(i);
+    const char* descriptor = dex_file->GetTypeDescriptor(type_id);
+    EXPECT_EQ(&type_id, dex_file->FindTypeId(descriptor)) << descriptor;
+  }
+  EXPECT_EQ(nullptr, dex_file->FindTypeId("LNoSuchClass;"));
+  for (uint32_t i = 0; i != dex_file->NumMethodIds(); ++i) {
+    const DexFile::MethodId& method_id = dex_file->GetMethodId(i);
+    EXPECT_EQ(&method_id,
+              dex_file->FindMethodId(dex_file->GetTypeId(method_id.class_idx_),
+                                     dex_file->GetStringId(method_id.name_idx_),
+                                     dex_file->GetProtoId(method_id.proto_idx_)));
+  }
+}
+
+}  // namespace art
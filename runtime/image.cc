@@ -16,7 +16,10 @@
 
 #include "image.h"
 
+#include <lz4.h>
+
 #include "base/bit_utils.h"
+#include "base/stringprintf.h"
 #include "mirror/object_array.h"
 #include "mirror/object_array-inl.h"
 #include "mirror/object-inl.h"
@@ -24,7 +27,7 @@
 namespace art {
 
 const uint8_t ImageHeader::kImageMagic[] = { 'a', 'r', 't', '\n' };
-const uint8_t ImageHeader::kImageVersion[] = { '0', '3', '0', '\0' };
+const uint8_t ImageHeader::kImageVersion[] = { '0', '3', '4', '\0' };
 
 ImageHeader::ImageHeader(uint32_t image_begin,
                          uint32_t image_size,
@@ -61,7 +64,9 @@ ImageHeader::ImageHeader(uint32_t image_begin,
     compile_pic_(compile_pic),
     is_pic_(is_pic),
     storage_mode_(storage_mode),
-    data_size_(data_size) {
+    data_size_(data_size),
+    blocks_offset_(0),
+    blocks_count_(0) {
   CHECK_EQ(image_begin, RoundUp(image_begin, kPageSize));
   CHECK_EQ(oat_file_begin, RoundUp(oat_file_begin, kPageSize));
   CHECK_EQ(oat_data_begin, RoundUp(oat_data_begin, kPageSize));
@@ -143,6 +148,44 @@ const ImageSection& ImageHeader::GetImageSection(ImageSections index) const {
   return sections_[index];
 }
 
+bool ImageHeader::Block::Decompress(uint8_t* out_ptr,
+                                     const uint8_t* in_ptr,
+                                     std::string* error_msg) const {
+  switch (storage_mode_) {
+    case kStorageModeUncompressed: {
+      CHECK_EQ(image_size_, data_size_);
+      memcpy(out_ptr + image_offset_, in_ptr + data_offset_, data_size_);
+      break;
+    }
+    case kStorageModeLZ4:
+    case kStorageModeLZ4HC: {
+      // LZ4HC and LZ4 have same internal format, both use LZ4_decompress.
+      const int decompressed_size = LZ4_decompress_safe(
+          reinterpret_cast<const char*>(in_ptr) + data_offset_,
+          reinterpret_cast<char*>(out_ptr) + image_offset_,
+          data_size_,
+          image_size_);
+      if (decompressed_size < 0 || static_cast<uint32_t>(decompressed_size) != image_size_) {
+        if (error_msg != nullptr) {
+          *error_msg = StringPrintf("Decompressed size does not match expected block size %d vs %u",
+                                    decompressed_size,
+                                    image_size_);
+        }
+        return false;
+      }
+      break;
+    }
+    default: {
+      if (error_msg != nullptr) {
+        *error_msg = StringPrintf("Invalid image block storage mode %u",
+                                  static_cast<uint32_t>(storage_mode_));
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
 std::ostream& operator<<(std::ostream& os, const ImageSection& section) {
   return os << "size=" << section.Size() << " range=" << section.Offset() << "-" << section.End();
 }
@@ -80,6 +80,61 @@ class PACKED(4) ImageHeader {
   };
   static constexpr StorageMode kDefaultStorageMode = kStorageModeUncompressed;
 
+  // Uncompressed size of the blocks that a compressed image is split into. Each block is
+  // compressed independently so that the loader can decompress several of them in parallel.
+  static constexpr size_t kBlockSize = 256 * KB;
+
+  // Describes one independently compressed block of the image data. Offsets are relative to the
+  // start of the image file (data) and the start of the image (image), both include the header.
+  class PACKED(4) Block {
+   public:
+    Block(StorageMode storage_mode,
+          uint32_t data_offset,
+          uint32_t data_size,
+          uint32_t image_offset,
+          uint32_t image_size)
+        : storage_mode_(storage_mode),
+          data_offset_(data_offset),
+          data_size_(data_size),
+          image_offset_(image_offset),
+          image_size_(image_size) {}
+
+    // Decompress the block from in_ptr (start of the file data) into out_ptr (start of the image).
+    bool Decompress(uint8_t* out_ptr, const uint8_t* in_ptr, std::string* error_msg) const;
+
+    StorageMode GetStorageMode() const {
+      return storage_mode_;
+    }
+
+    uint32_t GetDataOffset() const {
+      return data_offset_;
+    }
+
+    uint32_t GetDataSize() const {
+      return data_size_;
+    }
+
+    uint32_t GetImageOffset() const {
+      return image_offset_;
+    }
+
+    uint32_t GetImageSize() const {
+      return image_size_;
+    }
+
+   private:
+    // Storage method for the block.
+    StorageMode storage_mode_;
+
+    // Compressed offset and size in the file.
+    uint32_t data_offset_;
+    uint32_t data_size_;
+
+    // Decompressed offset and size in the image.
+    uint32_t image_offset_;
+    uint32_t image_size_;
+  };
+
   ImageHeader()
       : image_begin_(0U),
         image_size_(0U),
@@ -98,7 +153,9 @@ class PACKED(4) ImageHeader {
         compile_pic_(0),
         is_pic_(0),
         storage_mode_(kDefaultStorageMode),
-        data_size_(0) {}
+        data_size_(0),
+        blocks_offset_(0),
+        blocks_count_(0) {}
 
   ImageHeader(uint32_t image_begin,
               uint32_t image_size,
@@ -265,6 +322,20 @@ class PACKED(4) ImageHeader {
     return data_size_;
   }
 
+  // Offset of the block table in the image file, only valid for compressed images.
+  uint32_t GetBlocksOffset() const {
+    return blocks_offset_;
+  }
+
+  uint32_t GetBlocksCount() const {
+    return blocks_count_;
+  }
+
+  // Returns the block table of a compressed image, base is the start of the mapped image file.
+  const Block* GetBlocks(const uint8_t* base) const {
+    return reinterpret_cast<const Block*>(base + blocks_offset_);
+  }
+
   bool IsAppImage() const {
     // App images currently require a boot image, if the size is non zero then it is an app image
     // header.
@@ -355,9 +426,13 @@ class PACKED(4) ImageHeader {
   StorageMode storage_mode_;
 
   // Data size for the image data excluding the bitmap and the header. For compressed images, this
-  // is the compressed size in the file.
+  // is the compressed size in the file, including the block table.
   uint32_t data_size_;
 
+  // File offset and number of entries of the block table for compressed images.
+  uint32_t blocks_offset_;
+  uint32_t blocks_count_;
+
   friend class ImageWriter;
 };
 
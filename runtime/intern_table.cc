@@ -16,10 +16,12 @@
 
 #include "intern_table.h"
 
+#include <algorithm>
 #include <memory>
 
 #include "gc_root-inl.h"
 #include "gc/collector/garbage_collector.h"
+#include "gc/heap.h"
 #include "gc/space/image_space.h"
 #include "gc/weak_root_state.h"
 #include "image-inl.h"
@@ -28,30 +30,57 @@
 #include "mirror/object-inl.h"
 #include "mirror/string-inl.h"
 #include "thread.h"
+#include "thread_pool.h"
 #include "utf.h"
 
 namespace art {
 
+// Minimum number of weak interns for which SweepInternTableWeaks() uses the heap thread pool.
+static constexpr size_t kMinParallelSweepInterns = 4 * KB;
+
+InternTable::Shard::Shard()
+    : lock_("InternTable shard lock", kInternTableShardLock),
+      log_new_roots_(false) {
+}
+
 InternTable::InternTable()
     : images_added_to_intern_table_(false),
-      log_new_roots_(false),
       weak_intern_condition_("New intern condition", *Locks::intern_table_lock_),
+      published_image_sets_(nullptr),
       weak_root_state_(gc::kWeakRootStateNormal) {
+  // Nothing can look up the table before it is constructed.
+  MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
+  PublishImageSets();
 }
 
 size_t InternTable::Size() const {
-  MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
-  return strong_interns_.Size() + weak_interns_.Size();
+  return StrongSize() + WeakSize();
 }
 
 size_t InternTable::StrongSize() const {
-  MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
-  return strong_interns_.Size();
+  Thread* const self = Thread::Current();
+  size_t size = 0;
+  {
+    MutexLock mu(self, *Locks::intern_table_lock_);
+    for (const std::unique_ptr<UnorderedSet>& set : image_sets_) {
+      size += set->Size();
+    }
+  }
+  for (const Shard& shard : shards_) {
+    MutexLock mu(self, shard.lock_);
+    size += shard.strong_interns_.Size();
+  }
+  return size;
 }
 
 size_t InternTable::WeakSize() const {
-  MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
-  return weak_interns_.Size();
+  Thread* const self = Thread::Current();
+  size_t size = 0;
+  for (const Shard& shard : shards_) {
+    MutexLock mu(self, shard.lock_);
+    size += shard.weak_interns_.Size();
+  }
+  return size;
 }
 
 void InternTable::DumpForSigQuit(std::ostream& os) const {
@@ -59,42 +88,69 @@ void InternTable::DumpForSigQuit(std::ostream& os) const {
 }
 
 void InternTable::VisitRoots(RootVisitor* visitor, VisitRootFlags flags) {
-  MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
+  Thread* const self = Thread::Current();
   if ((flags & kVisitRootFlagAllRoots) != 0) {
-    strong_interns_.VisitRoots(visitor);
-  } else if ((flags & kVisitRootFlagNewRoots) != 0) {
-    for (auto& root : new_strong_intern_roots_) {
-      mirror::String* old_ref = root.Read<kWithoutReadBarrier>();
-      root.VisitRoot(visitor, RootInfo(kRootInternedString));
-      mirror::String* new_ref = root.Read<kWithoutReadBarrier>();
-      if (new_ref != old_ref) {
-        // The GC moved a root in the log. Need to search the strong interns and update the
-        // corresponding object. This is slow, but luckily for us, this may only happen with a
-        // concurrent moving GC.
-        strong_interns_.Remove(old_ref);
-        strong_interns_.Insert(new_ref);
+    MutexLock mu(self, *Locks::intern_table_lock_);
+    BufferedRootVisitor<kDefaultBufferedRootCount> buffered_visitor(
+        visitor, RootInfo(kRootInternedString));
+    for (const std::unique_ptr<UnorderedSet>& set : image_sets_) {
+      for (auto& intern : *set) {
+        buffered_visitor.VisitRoot(intern);
       }
     }
   }
-  if ((flags & kVisitRootFlagClearRootLog) != 0) {
-    new_strong_intern_roots_.clear();
+  for (Shard& shard : shards_) {
+    MutexLock mu(self, shard.lock_);
+    if ((flags & kVisitRootFlagAllRoots) != 0) {
+      shard.strong_interns_.VisitRoots(visitor);
+    } else if ((flags & kVisitRootFlagNewRoots) != 0) {
+      for (auto& root : shard.new_strong_intern_roots_) {
+        mirror::String* old_ref = root.Read<kWithoutReadBarrier>();
+        root.VisitRoot(visitor, RootInfo(kRootInternedString));
+        mirror::String* new_ref = root.Read<kWithoutReadBarrier>();
+        if (new_ref != old_ref) {
+          // The GC moved a root in the log. Need to search the strong interns and update the
+          // corresponding object. This is slow, but luckily for us, this may only happen with a
+          // concurrent moving GC. The hash code moves with the string, so does its shard.
+          shard.strong_interns_.Remove(old_ref);
+          shard.strong_interns_.Insert(new_ref);
+        }
+      }
+    }
+    if ((flags & kVisitRootFlagClearRootLog) != 0) {
+      shard.new_strong_intern_roots_.clear();
+    }
+    if ((flags & kVisitRootFlagStartLoggingNewRoots) != 0) {
+      shard.log_new_roots_ = true;
+    } else if ((flags & kVisitRootFlagStopLoggingNewRoots) != 0) {
+      shard.log_new_roots_ = false;
+    }
   }
-  if ((flags & kVisitRootFlagStartLoggingNewRoots) != 0) {
-    log_new_roots_ = true;
-  } else if ((flags & kVisitRootFlagStopLoggingNewRoots) != 0) {
-    log_new_roots_ = false;
+  // Note: we deliberately don't visit the weak_interns_ table.
+}
+
+template <typename K>
+mirror::String* InternTable::LookupImageString(const K& key, size_t hash) const {
+  const ImageSetList* image_sets = published_image_sets_.LoadAcquire();
+  for (const UnorderedSet* set : *image_sets) {
+    auto it = set->FindWithHash(key, hash);
+    if (it != set->end()) {
+      return it->Read();
+    }
   }
-  // Note: we deliberately don't visit the weak_interns_ table and the immutable image roots.
+  return nullptr;
 }
 
 mirror::String* InternTable::LookupWeak(Thread* self, mirror::String* s) {
-  MutexLock mu(self, *Locks::intern_table_lock_);
-  return LookupWeakLocked(s);
+  Shard* const shard = GetShard(s->GetHashCode());
+  MutexLock mu(self, shard->lock_);
+  return LookupWeakLocked(shard, s);
 }
 
 mirror::String* InternTable::LookupStrong(Thread* self, mirror::String* s) {
-  MutexLock mu(self, *Locks::intern_table_lock_);
-  return LookupStrongLocked(s);
+  Shard* const shard = GetShard(s->GetHashCode());
+  MutexLock mu(self, shard->lock_);
+  return LookupStrongLocked(shard, s);
 }
 
 mirror::String* InternTable::LookupStrong(Thread* self,
@@ -104,77 +160,100 @@ mirror::String* InternTable::LookupStrong(Thread* self,
   Utf8String string(utf16_length,
                     utf8_data,
                     ComputeUtf16HashFromModifiedUtf8(utf8_data, utf16_length));
-  MutexLock mu(self, *Locks::intern_table_lock_);
-  return strong_interns_.Find(string);
+  mirror::String* image_string =
+      LookupImageString(string, static_cast<size_t>(string.GetHash()));
+  if (image_string != nullptr) {
+    return image_string;
+  }
+  Shard* const shard = GetShard(string.GetHash());
+  MutexLock mu(self, shard->lock_);
+  return shard->strong_interns_.Find(string);
 }
 
-mirror::String* InternTable::LookupWeakLocked(mirror::String* s) {
-  return weak_interns_.Find(s);
+mirror::String* InternTable::LookupWeakLocked(Shard* shard, mirror::String* s) {
+  return shard->weak_interns_.Find(s);
 }
 
-mirror::String* InternTable::LookupStrongLocked(mirror::String* s) {
-  return strong_interns_.Find(s);
+mirror::String* InternTable::LookupStrongLocked(Shard* shard, mirror::String* s) {
+  mirror::String* image_string =
+      LookupImageString(GcRoot<mirror::String>(s), static_cast<size_t>(s->GetHashCode()));
+  if (image_string != nullptr) {
+    return image_string;
+  }
+  return shard->strong_interns_.Find(s);
 }
 
 void InternTable::AddNewTable() {
-  MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
-  weak_interns_.AddNewTable();
-  strong_interns_.AddNewTable();
+  Thread* const self = Thread::Current();
+  for (Shard& shard : shards_) {
+    MutexLock mu(self, shard.lock_);
+    shard.weak_interns_.AddNewTable();
+    shard.strong_interns_.AddNewTable();
+  }
 }
 
-mirror::String* InternTable::InsertStrong(mirror::String* s) {
+mirror::String* InternTable::InsertStrong(Shard* shard, mirror::String* s) {
   Runtime* runtime = Runtime::Current();
   if (runtime->IsActiveTransaction()) {
     runtime->RecordStrongStringInsertion(s);
   }
-  if (log_new_roots_) {
-    new_strong_intern_roots_.push_back(GcRoot<mirror::String>(s));
+  if (shard->log_new_roots_) {
+    shard->new_strong_intern_roots_.push_back(GcRoot<mirror::String>(s));
   }
-  strong_interns_.Insert(s);
+  shard->strong_interns_.Insert(s);
   return s;
 }
 
-mirror::String* InternTable::InsertWeak(mirror::String* s) {
+mirror::String* InternTable::InsertWeak(Shard* shard, mirror::String* s) {
   Runtime* runtime = Runtime::Current();
   if (runtime->IsActiveTransaction()) {
     runtime->RecordWeakStringInsertion(s);
   }
-  weak_interns_.Insert(s);
+  shard->weak_interns_.Insert(s);
   return s;
 }
 
-void InternTable::RemoveStrong(mirror::String* s) {
-  strong_interns_.Remove(s);
+void InternTable::RemoveStrong(Shard* shard, mirror::String* s) {
+  shard->strong_interns_.Remove(s);
 }
 
-void InternTable::RemoveWeak(mirror::String* s) {
+void InternTable::RemoveWeak(Shard* shard, mirror::String* s) {
   Runtime* runtime = Runtime::Current();
   if (runtime->IsActiveTransaction()) {
     runtime->RecordWeakStringRemoval(s);
   }
-  weak_interns_.Remove(s);
+  shard->weak_interns_.Remove(s);
 }
 
 // Insert/remove methods used to undo changes made during an aborted transaction.
 mirror::String* InternTable::InsertStrongFromTransaction(mirror::String* s) {
   DCHECK(!Runtime::Current()->IsActiveTransaction());
-  return InsertStrong(s);
+  Shard* const shard = GetShard(s->GetHashCode());
+  MutexLock mu(Thread::Current(), shard->lock_);
+  return InsertStrong(shard, s);
 }
 mirror::String* InternTable::InsertWeakFromTransaction(mirror::String* s) {
   DCHECK(!Runtime::Current()->IsActiveTransaction());
-  return InsertWeak(s);
+  Shard* const shard = GetShard(s->GetHashCode());
+  MutexLock mu(Thread::Current(), shard->lock_);
+  return InsertWeak(shard, s);
 }
 void InternTable::RemoveStrongFromTransaction(mirror::String* s) {
   DCHECK(!Runtime::Current()->IsActiveTransaction());
-  RemoveStrong(s);
+  Shard* const shard = GetShard(s->GetHashCode());
+  MutexLock mu(Thread::Current(), shard->lock_);
+  RemoveStrong(shard, s);
 }
 void InternTable::RemoveWeakFromTransaction(mirror::String* s) {
   DCHECK(!Runtime::Current()->IsActiveTransaction());
-  RemoveWeak(s);
+  Shard* const shard = GetShard(s->GetHashCode());
+  MutexLock mu(Thread::Current(), shard->lock_);
+  RemoveWeak(shard, s);
 }
 
 void InternTable::AddImagesStringsToTable(const std::vector<gc::space::ImageSpace*>& image_spaces) {
-  MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
+  Thread* const self = Thread::Current();
+  MutexLock mu(self, *Locks::intern_table_lock_);
   for (gc::space::ImageSpace* image_space : image_spaces) {
     const ImageHeader* const header = &image_space->GetImageHeader();
     // Check if we have the interned strings section.
@@ -187,13 +266,16 @@ void InternTable::AddImagesStringsToTable(const std::vector<gc::space::ImageSpac
       mirror::ObjectArray<mirror::DexCache>* dex_caches = root->AsObjectArray<mirror::DexCache>();
       for (int32_t i = 0; i < dex_caches->GetLength(); ++i) {
         mirror::DexCache* dex_cache = dex_caches->Get(i);
+        GcRoot<mirror::String>* const strings = dex_cache->GetStrings();
         const size_t num_strings = dex_cache->NumStrings();
         for (size_t j = 0; j < num_strings; ++j) {
-          mirror::String* image_string = dex_cache->GetResolvedString(j);
+          mirror::String* image_string = strings[j].Read();
           if (image_string != nullptr) {
-            mirror::String* found = LookupStrongLocked(image_string);
+            Shard* const shard = GetShard(image_string->GetHashCode());
+            MutexLock mu2(self, shard->lock_);
+            mirror::String* found = LookupStrongLocked(shard, image_string);
             if (found == nullptr) {
-              InsertStrong(image_string);
+              InsertStrong(shard, image_string);
             } else {
               DCHECK_EQ(found, image_string);
             }
@@ -202,11 +284,11 @@ void InternTable::AddImagesStringsToTable(const std::vector<gc::space::ImageSpac
       }
     }
   }
-  images_added_to_intern_table_ = true;
+  images_added_to_intern_table_.StoreRelaxed(true);
 }
 
 mirror::String* InternTable::LookupStringFromImage(mirror::String* s) {
-  DCHECK(!images_added_to_intern_table_);
+  DCHECK(!images_added_to_intern_table_.LoadRelaxed());
   const std::vector<gc::space::ImageSpace*>& image_spaces =
       Runtime::Current()->GetHeap()->GetBootImageSpaces();
   if (image_spaces.empty()) {
@@ -214,7 +296,20 @@ mirror::String* InternTable::LookupStringFromImage(mirror::String* s) {
   }
   const std::string utf8 = s->ToModifiedUtf8();
   for (gc::space::ImageSpace* image_space : image_spaces) {
-    mirror::Object* root = image_space->GetImageHeader().GetImageRoot(ImageHeader::kDexCaches);
+    const ImageHeader& header = image_space->GetImageHeader();
+    const ImageSection& section = header.GetImageSection(ImageHeader::kSectionInternedStrings);
+    if (section.Size() > 0) {
+      // Hashed dex cache strings arrays do not keep all the image strings, look them up in the
+      // interned strings section instead.
+      size_t read_count = 0;
+      UnorderedSet set(image_space->Begin() + section.Offset(), /*make copy*/false, &read_count);
+      auto it = set.Find(GcRoot<mirror::String>(s));
+      if (it != set.end()) {
+        return it->Read();
+      }
+      continue;
+    }
+    mirror::Object* root = header.GetImageRoot(ImageHeader::kDexCaches);
     mirror::ObjectArray<mirror::DexCache>* dex_caches = root->AsObjectArray<mirror::DexCache>();
     for (int32_t i = 0; i < dex_caches->GetLength(); ++i) {
       mirror::DexCache* dex_cache = dex_caches->Get(i);
@@ -241,16 +336,16 @@ void InternTable::BroadcastForNewInterns() {
   weak_intern_condition_.Broadcast(self);
 }
 
-void InternTable::WaitUntilAccessible(Thread* self) {
-  Locks::intern_table_lock_->ExclusiveUnlock(self);
+void InternTable::WaitUntilAccessible(Thread* self, Shard* shard) {
+  shard->lock_.ExclusiveUnlock(self);
   {
     ScopedThreadSuspension sts(self, kWaitingWeakGcRootRead);
     MutexLock mu(self, *Locks::intern_table_lock_);
-    while (weak_root_state_ == gc::kWeakRootStateNoReadsOrWrites) {
+    while (weak_root_state_.LoadRelaxed() == gc::kWeakRootStateNoReadsOrWrites) {
       weak_intern_condition_.Wait(self);
     }
   }
-  Locks::intern_table_lock_->ExclusiveLock(self);
+  shard->lock_.ExclusiveLock(self);
 }
 
 mirror::String* InternTable::Insert(mirror::String* s, bool is_strong, bool holding_locks) {
@@ -258,7 +353,15 @@ mirror::String* InternTable::Insert(mirror::String* s, bool is_strong, bool hold
     return nullptr;
   }
   Thread* const self = Thread::Current();
-  MutexLock mu(self, *Locks::intern_table_lock_);
+  const int32_t hash = s->GetHashCode();
+  // Most strings interned by the boot class path come from the images, find them without locking.
+  mirror::String* image_string =
+      LookupImageString(GcRoot<mirror::String>(s), static_cast<size_t>(hash));
+  if (image_string != nullptr) {
+    return image_string;
+  }
+  Shard* const shard = GetShard(hash);
+  MutexLock mu(self, shard->lock_);
   if (kDebugLocking && !holding_locks) {
     Locks::mutator_lock_->AssertSharedHeld(self);
     CHECK_EQ(2u, self->NumberOfHeldMutexes()) << "may only safely hold the mutator lock";
@@ -266,17 +369,18 @@ mirror::String* InternTable::Insert(mirror::String* s, bool is_strong, bool hold
   while (true) {
     if (holding_locks) {
       if (!kUseReadBarrier) {
-        CHECK_EQ(weak_root_state_, gc::kWeakRootStateNormal);
+        CHECK_EQ(weak_root_state_.LoadRelaxed(), gc::kWeakRootStateNormal);
       } else {
         CHECK(self->GetWeakRefAccessEnabled());
       }
     }
     // Check the strong table for a match.
-    mirror::String* strong = LookupStrongLocked(s);
+    mirror::String* strong = shard->strong_interns_.Find(s);
     if (strong != nullptr) {
       return strong;
     }
-    if ((!kUseReadBarrier && weak_root_state_ != gc::kWeakRootStateNoReadsOrWrites) ||
+    if ((!kUseReadBarrier &&
+         weak_root_state_.LoadRelaxed() != gc::kWeakRootStateNoReadsOrWrites) ||
         (kUseReadBarrier && self->GetWeakRefAccessEnabled())) {
       break;
     }
@@ -286,32 +390,32 @@ mirror::String* InternTable::Insert(mirror::String* s, bool is_strong, bool hold
     CHECK(!holding_locks);
     StackHandleScope<1> hs(self);
     auto h = hs.NewHandleWrapper(&s);
-    WaitUntilAccessible(self);
+    WaitUntilAccessible(self, shard);
   }
   if (!kUseReadBarrier) {
-    CHECK_EQ(weak_root_state_, gc::kWeakRootStateNormal);
+    CHECK_EQ(weak_root_state_.LoadRelaxed(), gc::kWeakRootStateNormal);
   } else {
     CHECK(self->GetWeakRefAccessEnabled());
   }
   // There is no match in the strong table, check the weak table.
-  mirror::String* weak = LookupWeakLocked(s);
+  mirror::String* weak = LookupWeakLocked(shard, s);
   if (weak != nullptr) {
     if (is_strong) {
       // A match was found in the weak table. Promote to the strong table.
-      RemoveWeak(weak);
-      return InsertStrong(weak);
+      RemoveWeak(shard, weak);
+      return InsertStrong(shard, weak);
     }
     return weak;
   }
   // Check the image for a match.
-  if (!images_added_to_intern_table_) {
-    mirror::String* const image_string = LookupStringFromImage(s);
+  if (!images_added_to_intern_table_.LoadRelaxed()) {
+    image_string = LookupStringFromImage(s);
     if (image_string != nullptr) {
-      return is_strong ? InsertStrong(image_string) : InsertWeak(image_string);
+      return is_strong ? InsertStrong(shard, image_string) : InsertWeak(shard, image_string);
     }
   }
   // No match in the strong table or the weak table. Insert into the strong / weak table.
-  return is_strong ? InsertStrong(s) : InsertWeak(s);
+  return is_strong ? InsertStrong(shard, s) : InsertWeak(shard, s);
 }
 
 mirror::String* InternTable::InternStrong(int32_t utf16_length, const char* utf8_data) {
@@ -348,9 +452,61 @@ bool InternTable::ContainsWeak(mirror::String* s) {
   return LookupWeak(Thread::Current(), s) == s;
 }
 
+class InternTable::SweepWeaksTask : public Task {
+ public:
+  SweepWeaksTask(Shard* shard, IsMarkedVisitor* visitor, std::vector<mirror::Object*>* dead)
+      : shard_(shard), visitor_(visitor), dead_(dead) {}
+
+  void Run(Thread* self) OVERRIDE NO_THREAD_SAFETY_ANALYSIS {
+    MutexLock mu(self, shard_->lock_);
+    shard_->weak_interns_.MarkWeaks(visitor_, dead_);
+  }
+
+  void Finalize() OVERRIDE {
+    delete this;
+  }
+
+ private:
+  Shard* const shard_;
+  IsMarkedVisitor* const visitor_;
+  std::vector<mirror::Object*>* const dead_;
+};
+
 void InternTable::SweepInternTableWeaks(IsMarkedVisitor* visitor) {
-  MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
-  weak_interns_.SweepWeaks(visitor);
+  Thread* const self = Thread::Current();
+  gc::Heap* const heap = Runtime::Current()->GetHeap();
+  ThreadPool* const thread_pool = heap->GetThreadPool();
+  // Like the collectors, use less threads if we are in a background state.
+  size_t thread_count = 1;
+  if (thread_pool != nullptr && Runtime::Current()->InJankPerceptibleProcessState()) {
+    thread_count += Locks::mutator_lock_->IsExclusiveHeld(self)
+        ? heap->GetParallelGCThreadCount()
+        : heap->GetConcGCThreadCount();
+  }
+  if (thread_count == 1 || WeakSize() < kMinParallelSweepInterns) {
+    for (Shard& shard : shards_) {
+      MutexLock mu(self, shard.lock_);
+      shard.weak_interns_.SweepWeaks(visitor);
+    }
+    return;
+  }
+  // Checking the marks is the expensive part, do it in parallel. Erasing moves the following
+  // elements, which need to be hashed, so leave that to this thread.
+  std::vector<mirror::Object*> dead[kNumShards];
+  for (size_t i = 0; i != kNumShards; ++i) {
+    thread_pool->AddTask(self, new SweepWeaksTask(&shards_[i], visitor, &dead[i]));
+  }
+  thread_pool->SetMaxActiveWorkers(thread_count - 1);
+  thread_pool->StartWorkers(self);
+  thread_pool->Wait(self, true, true);
+  thread_pool->StopWorkers(self);
+  for (size_t i = 0; i != kNumShards; ++i) {
+    if (!dead[i].empty()) {
+      std::sort(dead[i].begin(), dead[i].end());
+      MutexLock mu(self, shards_[i].lock_);
+      shards_[i].weak_interns_.EraseWeaks(dead[i]);
+    }
+  }
 }
 
 size_t InternTable::AddTableFromMemory(const uint8_t* ptr) {
@@ -359,12 +515,52 @@ size_t InternTable::AddTableFromMemory(const uint8_t* ptr) {
 }
 
 size_t InternTable::AddTableFromMemoryLocked(const uint8_t* ptr) {
-  return strong_interns_.AddTableFromMemory(ptr);
+  size_t read_count = 0;
+  std::unique_ptr<UnorderedSet> set(new UnorderedSet(ptr, /*make copy*/false, &read_count));
+  if (set->Empty()) {
+    // Avoid inserting empty sets.
+    return read_count;
+  }
+  // TODO: Disable this for app images if app images have intern tables.
+  static constexpr bool kCheckDuplicates = true;
+  if (kCheckDuplicates) {
+    Thread* const self = Thread::Current();
+    for (GcRoot<mirror::String>& string : *set) {
+      CHECK(LookupStrong(self, string.Read()) == nullptr)
+          << "Already found " << string.Read()->ToModifiedUtf8();
+    }
+  }
+  // Insert at the front, the sets read before were looked up after the ones they conflicted with.
+  image_sets_.insert(image_sets_.begin(), std::move(set));
+  PublishImageSets();
+  return read_count;
+}
+
+void InternTable::PublishImageSets() {
+  ImageSetList* list = new ImageSetList();
+  list->reserve(image_sets_.size());
+  for (const std::unique_ptr<UnorderedSet>& set : image_sets_) {
+    list->push_back(set.get());
+  }
+  image_set_lists_.emplace_back(list);
+  published_image_sets_.StoreRelease(list);
 }
 
 size_t InternTable::WriteToMemory(uint8_t* ptr) {
-  MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
-  return strong_interns_.WriteToMemory(ptr);
+  // The image and shard tables are combined into a single one.
+  Thread* const self = Thread::Current();
+  UnorderedSet combined;
+  MutexLock mu(self, *Locks::intern_table_lock_);
+  for (const std::unique_ptr<UnorderedSet>& set : image_sets_) {
+    for (const GcRoot<mirror::String>& string : *set) {
+      combined.Insert(string);
+    }
+  }
+  for (Shard& shard : shards_) {
+    MutexLock mu2(self, shard.lock_);
+    shard.strong_interns_.CopyTo(&combined);
+  }
+  return combined.WriteToMemory(ptr);
 }
 
 std::size_t InternTable::StringHashEquals::operator()(const GcRoot<mirror::String>& root) const {
@@ -411,42 +607,12 @@ bool InternTable::StringHashEquals::operator()(const GcRoot<mirror::String>& a,
   }
 }
 
-size_t InternTable::Table::AddTableFromMemory(const uint8_t* ptr) {
-  size_t read_count = 0;
-  UnorderedSet set(ptr, /*make copy*/false, &read_count);
-  if (set.Empty()) {
-    // Avoid inserting empty sets.
-    return read_count;
-  }
-  // TODO: Disable this for app images if app images have intern tables.
-  static constexpr bool kCheckDuplicates = true;
-  if (kCheckDuplicates) {
-    for (GcRoot<mirror::String>& string : set) {
-      CHECK(Find(string.Read()) == nullptr) << "Already found " << string.Read()->ToModifiedUtf8();
+void InternTable::Table::CopyTo(UnorderedSet* set) const {
+  for (const UnorderedSet& table : tables_) {
+    for (const GcRoot<mirror::String>& string : table) {
+      set->Insert(string);
     }
   }
-  // Insert at the front since we add new interns into the back.
-  tables_.insert(tables_.begin(), std::move(set));
-  return read_count;
-}
-
-size_t InternTable::Table::WriteToMemory(uint8_t* ptr) {
-  if (tables_.empty()) {
-    return 0;
-  }
-  UnorderedSet* table_to_write;
-  UnorderedSet combined;
-  if (tables_.size() > 1) {
-    table_to_write = &combined;
-    for (UnorderedSet& table : tables_) {
-      for (GcRoot<mirror::String>& string : table) {
-        combined.Insert(string);
-      }
-    }
-  } else {
-    table_to_write = &tables_.back();
-  }
-  return table_to_write->WriteToMemory(ptr);
 }
 
 void InternTable::Table::Remove(mirror::String* s) {
@@ -461,7 +627,6 @@ void InternTable::Table::Remove(mirror::String* s) {
 }
 
 mirror::String* InternTable::Table::Find(mirror::String* s) {
-  Locks::intern_table_lock_->AssertHeld(Thread::Current());
   for (UnorderedSet& table : tables_) {
     auto it = table.Find(GcRoot<mirror::String>(s));
     if (it != table.end()) {
@@ -472,7 +637,6 @@ mirror::String* InternTable::Table::Find(mirror::String* s) {
 }
 
 mirror::String* InternTable::Table::Find(const Utf8String& string) {
-  Locks::intern_table_lock_->AssertHeld(Thread::Current());
   for (UnorderedSet& table : tables_) {
     auto it = table.Find(string);
     if (it != table.end()) {
@@ -487,8 +651,8 @@ void InternTable::Table::AddNewTable() {
 }
 
 void InternTable::Table::Insert(mirror::String* s) {
-  // Always insert the last table, the image tables are before and we avoid inserting into these
-  // to prevent dirty pages.
+  // Always insert the last table, the pre zygote tables are before and we avoid inserting into
+  // these to prevent dirty pages.
   DCHECK(!tables_.empty());
   tables_.back().Insert(GcRoot<mirror::String>(s));
 }
@@ -523,6 +687,35 @@ void InternTable::Table::SweepWeaks(UnorderedSet* set, IsMarkedVisitor* visitor)
   }
 }
 
+void InternTable::Table::MarkWeaks(IsMarkedVisitor* visitor, std::vector<mirror::Object*>* dead) {
+  for (UnorderedSet& table : tables_) {
+    for (GcRoot<mirror::String>& root : table) {
+      // This does not need a read barrier because this is called by GC.
+      mirror::Object* object = root.Read<kWithoutReadBarrier>();
+      mirror::Object* new_object = visitor->IsMarked(object);
+      if (new_object == nullptr) {
+        dead->push_back(object);
+      } else if (new_object != object) {
+        root = GcRoot<mirror::String>(down_cast<mirror::String*>(new_object));
+      }
+    }
+  }
+}
+
+void InternTable::Table::EraseWeaks(const std::vector<mirror::Object*>& dead) {
+  DCHECK(std::is_sorted(dead.begin(), dead.end()));
+  for (UnorderedSet& table : tables_) {
+    for (auto it = table.begin(), end = table.end(); it != end;) {
+      mirror::Object* object = it->Read<kWithoutReadBarrier>();
+      if (std::binary_search(dead.begin(), dead.end(), object)) {
+        it = table.Erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
 size_t InternTable::Table::Size() const {
   return std::accumulate(tables_.begin(),
                          tables_.end(),
@@ -539,7 +732,7 @@ void InternTable::ChangeWeakRootState(gc::WeakRootState new_state) {
 
 void InternTable::ChangeWeakRootStateLocked(gc::WeakRootState new_state) {
   CHECK(!kUseReadBarrier);
-  weak_root_state_ = new_state;
+  weak_root_state_.StoreRelaxed(new_state);
   if (new_state != gc::kWeakRootStateNoReadsOrWrites) {
     weak_intern_condition_.Broadcast(Thread::Current());
   }
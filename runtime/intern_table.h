@@ -17,7 +17,9 @@
 #ifndef ART_RUNTIME_INTERN_TABLE_H_
 #define ART_RUNTIME_INTERN_TABLE_H_
 
+#include <memory>
 #include <unordered_set>
+#include <vector>
 
 #include "atomic.h"
 #include "base/allocator.h"
@@ -51,6 +53,11 @@ class Transaction;
  * String.intern. Some code (XML parsers being a prime example) relies on being able to intern
  * arbitrarily many strings for the duration of a parse without permanently increasing the memory
  * footprint.
+ *
+ * The strong interns read from images never change, they are looked up without locking. The other
+ * interns are split into shards by string hash, each with its own lock, so that threads interning
+ * different strings rarely contend. Locks::intern_table_lock_ only guards the image tables and the
+ * weak root state.
  */
 class InternTable {
  public:
@@ -78,23 +85,21 @@ class InternTable {
   mirror::String* InternWeak(mirror::String* s) SHARED_REQUIRES(Locks::mutator_lock_)
       REQUIRES(!Roles::uninterruptible_);
 
+  // Sweep the weak interns, splitting the shards among the heap thread pool workers if there are
+  // many of them. The visitor may then be called concurrently from several threads.
   void SweepInternTableWeaks(IsMarkedVisitor* visitor) SHARED_REQUIRES(Locks::mutator_lock_)
       REQUIRES(!Locks::intern_table_lock_);
 
-  bool ContainsWeak(mirror::String* s) SHARED_REQUIRES(Locks::mutator_lock_)
-      REQUIRES(!Locks::intern_table_lock_);
+  bool ContainsWeak(mirror::String* s) SHARED_REQUIRES(Locks::mutator_lock_);
 
   // Lookup a strong intern, returns null if not found.
   mirror::String* LookupStrong(Thread* self, mirror::String* s)
-      REQUIRES(!Locks::intern_table_lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
   mirror::String* LookupStrong(Thread* self, uint32_t utf16_length, const char* utf8_data)
-      REQUIRES(!Locks::intern_table_lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
 
   // Lookup a weak intern, returns null if not found.
   mirror::String* LookupWeak(Thread* self, mirror::String* s)
-      REQUIRES(!Locks::intern_table_lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
 
   // Total number of interned strings.
@@ -104,7 +109,7 @@ class InternTable {
   size_t StrongSize() const REQUIRES(!Locks::intern_table_lock_);
 
   // Total number of strongly live interned strings.
-  size_t WeakSize() const REQUIRES(!Locks::intern_table_lock_);
+  size_t WeakSize() const;
 
   void VisitRoots(RootVisitor* visitor, VisitRootFlags flags)
       SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(!Locks::intern_table_lock_);
@@ -121,8 +126,7 @@ class InternTable {
 
   // Add a new intern table for inserting to, previous intern tables are still there but no
   // longer inserted into and ideally unmodified. This is done to prevent dirty pages.
-  void AddNewTable()
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(!Locks::intern_table_lock_);
+  void AddNewTable() SHARED_REQUIRES(Locks::mutator_lock_);
 
   // Read the intern table from memory. The elements aren't copied, the intern hash set data will
   // point to somewhere within ptr. Only reads the strong interns.
@@ -176,106 +180,150 @@ class InternTable {
     }
   };
 
+  typedef HashSet<GcRoot<mirror::String>, GcRootEmptyFn, StringHashEquals, StringHashEquals,
+      TrackingAllocator<GcRoot<mirror::String>, kAllocatorTagInternTable>> UnorderedSet;
+
   // Table which holds pre zygote and post zygote interned strings. There is one instance for
-  // weak interns and strong interns.
+  // weak interns and strong interns in each shard, guarded by the lock of the shard.
   class Table {
    public:
     Table();
-    mirror::String* Find(mirror::String* s) SHARED_REQUIRES(Locks::mutator_lock_)
-        REQUIRES(Locks::intern_table_lock_);
-    mirror::String* Find(const Utf8String& string) SHARED_REQUIRES(Locks::mutator_lock_)
-        REQUIRES(Locks::intern_table_lock_);
-    void Insert(mirror::String* s) SHARED_REQUIRES(Locks::mutator_lock_)
-        REQUIRES(Locks::intern_table_lock_);
-    void Remove(mirror::String* s)
-        SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
-    void VisitRoots(RootVisitor* visitor)
-        SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
-    void SweepWeaks(IsMarkedVisitor* visitor)
-        SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
+    mirror::String* Find(mirror::String* s) SHARED_REQUIRES(Locks::mutator_lock_);
+    mirror::String* Find(const Utf8String& string) SHARED_REQUIRES(Locks::mutator_lock_);
+    void Insert(mirror::String* s) SHARED_REQUIRES(Locks::mutator_lock_);
+    void Remove(mirror::String* s) SHARED_REQUIRES(Locks::mutator_lock_);
+    void VisitRoots(RootVisitor* visitor) SHARED_REQUIRES(Locks::mutator_lock_);
+    void SweepWeaks(IsMarkedVisitor* visitor) SHARED_REQUIRES(Locks::mutator_lock_);
+    // First half of a parallel SweepWeaks(). Updates the moved strings in place and collects the
+    // strings that are not marked in dead, without moving any element. Does not hash strings, so
+    // it may run on a thread pool worker that does not hold the mutator lock.
+    void MarkWeaks(IsMarkedVisitor* visitor, std::vector<mirror::Object*>* dead)
+        NO_THREAD_SAFETY_ANALYSIS;
+    // Second half of a parallel SweepWeaks(). Erases the strings collected by MarkWeaks(), which
+    // must be sorted.
+    void EraseWeaks(const std::vector<mirror::Object*>& dead)
+        SHARED_REQUIRES(Locks::mutator_lock_);
     // Add a new intern table that will only be inserted into from now on.
-    void AddNewTable() REQUIRES(Locks::intern_table_lock_);
-    size_t Size() const REQUIRES(Locks::intern_table_lock_);
-    // Read and add an intern table from ptr.
-    // Tables read are inserted at the front of the table array. Only checks for conflicts in
-    // debug builds. Returns how many bytes were read.
-    size_t AddTableFromMemory(const uint8_t* ptr)
-        REQUIRES(Locks::intern_table_lock_) SHARED_REQUIRES(Locks::mutator_lock_);
-    // Write the intern tables to ptr, if there are multiple tables they are combined into a single
-    // one. Returns how many bytes were written.
-    size_t WriteToMemory(uint8_t* ptr)
-        REQUIRES(Locks::intern_table_lock_) SHARED_REQUIRES(Locks::mutator_lock_);
+    void AddNewTable();
+    size_t Size() const;
+    // Insert all the interned strings into set.
+    void CopyTo(UnorderedSet* set) const SHARED_REQUIRES(Locks::mutator_lock_);
 
    private:
-    typedef HashSet<GcRoot<mirror::String>, GcRootEmptyFn, StringHashEquals, StringHashEquals,
-        TrackingAllocator<GcRoot<mirror::String>, kAllocatorTagInternTable>> UnorderedSet;
-
     void SweepWeaks(UnorderedSet* set, IsMarkedVisitor* visitor)
-        SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
+        SHARED_REQUIRES(Locks::mutator_lock_);
 
     // We call AddNewTable when we create the zygote to reduce private dirty pages caused by
     // modifying the zygote intern table. The back of table is modified when strings are interned.
     std::vector<UnorderedSet> tables_;
   };
 
+  // Interns which hash to the same shard share a lock.
+  struct Shard {
+    Shard();
+
+    mutable Mutex lock_ ACQUIRED_AFTER(Locks::intern_table_lock_);
+    bool log_new_roots_ GUARDED_BY(lock_);
+    // Since this contains (strong) roots, they need a read barrier to
+    // enable concurrent intern table (strong) root scan. Do not
+    // directly access the strings in it. Use functions that contain
+    // read barriers.
+    Table strong_interns_ GUARDED_BY(lock_);
+    std::vector<GcRoot<mirror::String>> new_strong_intern_roots_ GUARDED_BY(lock_);
+    // Since this contains (weak) roots, they need a read barrier. Do
+    // not directly access the strings in it. Use functions that contain
+    // read barriers.
+    Table weak_interns_ GUARDED_BY(lock_);
+
+    DISALLOW_COPY_AND_ASSIGN(Shard);
+  };
+
+  // Immutable list of the strong intern sets read from images, in lookup order.
+  typedef std::vector<const UnorderedSet*> ImageSetList;
+
+  class SweepWeaksTask;
+
+  static constexpr size_t kShardBits = 4;
+  static constexpr size_t kNumShards = 1u << kShardBits;
+
+  static size_t ShardIndex(int32_t hash) {
+    // The hash sets take the hash modulo their number of buckets, keep the low bits for them and
+    // pick the shard from the high bits of a multiplicative hash.
+    return (static_cast<uint32_t>(hash) * 0x9e3779b9u) >> (32u - kShardBits);
+  }
+
+  Shard* GetShard(int32_t hash) {
+    return &shards_[ShardIndex(hash)];
+  }
+
+  // Lookup a strong intern read from an image, does not need any lock.
+  template <typename K>
+  mirror::String* LookupImageString(const K& key, size_t hash) const
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
   // Insert if non null, otherwise return null. Must be called holding the mutator lock.
   // If holding_locks is true, then we may also hold other locks. If holding_locks is true, then we
   // require GC is not running since it is not safe to wait while holding locks.
   mirror::String* Insert(mirror::String* s, bool is_strong, bool holding_locks)
       REQUIRES(!Locks::intern_table_lock_) SHARED_REQUIRES(Locks::mutator_lock_);
 
-  mirror::String* LookupStrongLocked(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
-  mirror::String* LookupWeakLocked(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
-  mirror::String* InsertStrong(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
-  mirror::String* InsertWeak(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
-  void RemoveStrong(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
-  void RemoveWeak(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
+  mirror::String* LookupStrongLocked(Shard* shard, mirror::String* s)
+      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(shard->lock_);
+  mirror::String* LookupWeakLocked(Shard* shard, mirror::String* s)
+      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(shard->lock_);
+  mirror::String* InsertStrong(Shard* shard, mirror::String* s)
+      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(shard->lock_);
+  mirror::String* InsertWeak(Shard* shard, mirror::String* s)
+      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(shard->lock_);
+  void RemoveStrong(Shard* shard, mirror::String* s)
+      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(shard->lock_);
+  void RemoveWeak(Shard* shard, mirror::String* s)
+      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(shard->lock_);
 
   // Transaction rollback access.
   mirror::String* LookupStringFromImage(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
+      SHARED_REQUIRES(Locks::mutator_lock_);
   mirror::String* InsertStrongFromTransaction(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
+      SHARED_REQUIRES(Locks::mutator_lock_);
   mirror::String* InsertWeakFromTransaction(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
+      SHARED_REQUIRES(Locks::mutator_lock_);
   void RemoveStrongFromTransaction(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
+      SHARED_REQUIRES(Locks::mutator_lock_);
   void RemoveWeakFromTransaction(mirror::String* s)
-      SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
+      SHARED_REQUIRES(Locks::mutator_lock_);
 
   size_t AddTableFromMemoryLocked(const uint8_t* ptr)
       REQUIRES(Locks::intern_table_lock_) SHARED_REQUIRES(Locks::mutator_lock_);
 
+  // Publish a new immutable copy of image_sets_.
+  void PublishImageSets() REQUIRES(Locks::intern_table_lock_);
+
   // Change the weak root state. May broadcast to waiters.
   void ChangeWeakRootStateLocked(gc::WeakRootState new_state)
       REQUIRES(Locks::intern_table_lock_);
 
   // Wait until we can read weak roots.
-  void WaitUntilAccessible(Thread* self)
-      REQUIRES(Locks::intern_table_lock_) SHARED_REQUIRES(Locks::mutator_lock_);
+  void WaitUntilAccessible(Thread* self, Shard* shard)
+      REQUIRES(shard->lock_, !Locks::intern_table_lock_) SHARED_REQUIRES(Locks::mutator_lock_);
 
-  bool images_added_to_intern_table_ GUARDED_BY(Locks::intern_table_lock_);
-  bool log_new_roots_ GUARDED_BY(Locks::intern_table_lock_);
+  // Only changes from false to true while the runtime starts.
+  Atomic<bool> images_added_to_intern_table_;
   ConditionVariable weak_intern_condition_ GUARDED_BY(Locks::intern_table_lock_);
-  // Since this contains (strong) roots, they need a read barrier to
-  // enable concurrent intern table (strong) root scan. Do not
-  // directly access the strings in it. Use functions that contain
-  // read barriers.
-  Table strong_interns_ GUARDED_BY(Locks::intern_table_lock_);
-  std::vector<GcRoot<mirror::String>> new_strong_intern_roots_
+  Shard shards_[kNumShards];
+  // Strong intern sets read from images, the most recently added first. They are never modified
+  // except for root visiting, which does not move image strings.
+  std::vector<std::unique_ptr<UnorderedSet>> image_sets_ GUARDED_BY(Locks::intern_table_lock_);
+  // All the published lists of image sets, the last one being current. The older lists may still
+  // be in use by concurrent lookups, so they are kept until the table is deleted.
+  std::vector<std::unique_ptr<ImageSetList>> image_set_lists_
       GUARDED_BY(Locks::intern_table_lock_);
-  // Since this contains (weak) roots, they need a read barrier. Do
-  // not directly access the strings in it. Use functions that contain
-  // read barriers.
-  Table weak_interns_ GUARDED_BY(Locks::intern_table_lock_);
-  // Weak root state, used for concurrent system weak processing and more.
-  gc::WeakRootState weak_root_state_ GUARDED_BY(Locks::intern_table_lock_);
+  // The current list of image sets, read without locks.
+  Atomic<const ImageSetList*> published_image_sets_;
+  // Weak root state, used for concurrent system weak processing and more. Only changed while
+  // holding Locks::intern_table_lock_, but read while holding a shard lock. Either the threads
+  // reading it are suspended when it changes to kWeakRootStateNoReadsOrWrites, or they wait for
+  // the change back under Locks::intern_table_lock_.
+  Atomic<gc::WeakRootState> weak_root_state_;
 
   friend class Transaction;
   DISALLOW_COPY_AND_ASSIGN(InternTable);
@@ -16,8 +16,12 @@
 
 #include "intern_table.h"
 
+#include <set>
+#include <string>
+
 #include "common_runtime_test.h"
 #include "mirror/object.h"
+#include "mirror/object_array-inl.h"
 #include "handle_scope-inl.h"
 #include "mirror/string.h"
 #include "scoped_thread_state_change.h"
@@ -122,6 +126,64 @@ TEST_F(InternTableTest, SweepInternTableWeaks) {
   EXPECT_EQ(3U, t.Size());
 }
 
+// Keeps the strings in a fixed set. Can be called concurrently.
+class SetPredicate : public IsMarkedVisitor {
+ public:
+  mirror::Object* IsMarked(mirror::Object* s) OVERRIDE SHARED_REQUIRES(Locks::mutator_lock_) {
+    return marked_.find(s) != marked_.end() ? s : nullptr;
+  }
+
+  void Mark(mirror::Object* s) {
+    marked_.insert(s);
+  }
+
+ private:
+  std::set<mirror::Object*> marked_;
+};
+
+class InternTableParallelSweepTest : public InternTableTest {
+ protected:
+  void SetUpRuntimeOptions(RuntimeOptions* options) OVERRIDE {
+    // Create the heap thread pool.
+    options->push_back(std::make_pair("-XX:ParallelGCThreads=3", nullptr));
+    options->push_back(std::make_pair("-XX:ConcGCThreads=3", nullptr));
+  }
+};
+
+TEST_F(InternTableParallelSweepTest, SweepInternTableWeaks) {
+  ScopedObjectAccess soa(Thread::Current());
+  ASSERT_TRUE(Runtime::Current()->GetHeap()->GetThreadPool() != nullptr);
+  static constexpr int32_t kNumStrings = 8192;
+  StackHandleScope<1> hs(soa.Self());
+  mirror::Class* array_class = class_linker_->FindSystemClass(soa.Self(), "[Ljava/lang/String;");
+  ASSERT_TRUE(array_class != nullptr);
+  Handle<mirror::ObjectArray<mirror::String>> strings(hs.NewHandle(
+      mirror::ObjectArray<mirror::String>::Alloc(soa.Self(), array_class, kNumStrings)));
+  ASSERT_TRUE(strings.Get() != nullptr);
+  InternTable t;
+  SetPredicate p;
+  for (int32_t i = 0; i != kNumStrings; ++i) {
+    std::string s = "weak " + std::to_string(i);
+    mirror::String* weak = t.InternWeak(mirror::String::AllocFromModifiedUtf8(soa.Self(),
+                                                                             s.c_str()));
+    ASSERT_TRUE(weak != nullptr);
+    strings->Set<false>(i, weak);
+    if (i % 3 == 0) {
+      p.Mark(weak);
+    }
+  }
+  EXPECT_EQ(static_cast<size_t>(kNumStrings), t.WeakSize());
+  {
+    ReaderMutexLock mu(soa.Self(), *Locks::heap_bitmap_lock_);
+    t.SweepInternTableWeaks(&p);
+  }
+  EXPECT_EQ(static_cast<size_t>((kNumStrings + 2) / 3), t.WeakSize());
+  for (int32_t i = 0; i != kNumStrings; ++i) {
+    mirror::String* weak = strings->Get(i);
+    EXPECT_EQ(i % 3 == 0, t.ContainsWeak(weak)) << i;
+  }
+}
+
 TEST_F(InternTableTest, ContainsWeak) {
   ScopedObjectAccess soa(Thread::Current());
   {
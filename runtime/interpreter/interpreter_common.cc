@@ -51,6 +51,12 @@ bool DoFieldGet(Thread* self, ShadowFrame& shadow_frame, const Instruction* inst
   Object* obj;
   if (is_static) {
     obj = f->GetDeclaringClass();
+    Runtime* const runtime = Runtime::Current();
+    if (UNLIKELY(runtime->IsActiveTransaction()) && runtime->IsTransactionReadConstraint(f)) {
+      AbortTransactionF(self, "Can't read static field %s in strict transaction",
+                        PrettyField(f).c_str());
+      return false;
+    }
   } else {
     obj = shadow_frame.GetVRegReference(inst->VRegB_22c(inst_data));
     if (UNLIKELY(obj == nullptr)) {
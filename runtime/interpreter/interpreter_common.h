@@ -348,7 +348,7 @@ static inline const char* GetStringDataByDexStringIndexOrThrow(ShadowFrame& shad
   mirror::Class* declaring_class = method->GetDeclaringClass();
   if (!do_access_check) {
     // MethodVerifier refuses methods with string_idx out of bounds.
-    DCHECK_LT(string_idx, declaring_class->GetDexCache()->NumStrings());
+    DCHECK_LT(string_idx, dex_file->NumStringIds());
   } else {
     // Access checks enabled: perform string index bounds ourselves.
     if (string_idx >= dex_file->GetHeader().string_ids_size_) {
@@ -751,8 +751,7 @@ static inline String* ResolveString(Thread* self, ShadowFrame& shadow_frame, uin
   ArtMethod* method = shadow_frame.GetMethod();
   mirror::Class* declaring_class = method->GetDeclaringClass();
   // MethodVerifier refuses methods with string_idx out of bounds.
-  DCHECK_LT(string_idx, declaring_class->GetDexCache()->NumStrings());
-  mirror::String* s = declaring_class->GetDexCacheStrings()[string_idx].Read();
+  mirror::String* s = declaring_class->GetDexCache()->GetResolvedString(string_idx);
   if (UNLIKELY(s == nullptr)) {
     StackHandleScope<1> hs(self);
     Handle<mirror::DexCache> dex_cache(hs.NewHandle(declaring_class->GetDexCache()));
@@ -73,6 +73,19 @@ static void AbortTransactionOrFail(Thread* self, const char* fmt, ...) {
   }
 }
 
+// Unsafe accesses static fields through the class object. Abort strict transactions reading the
+// static fields of boot image classes, as DoFieldGet does for sget.
+static bool CheckUnsafeRead(Thread* self, mirror::Object* obj)
+    SHARED_REQUIRES(Locks::mutator_lock_) {
+  Runtime* const runtime = Runtime::Current();
+  if (runtime->IsActiveTransaction() && runtime->IsTransactionReadConstraint(obj)) {
+    AbortTransactionOrFail(self, "Can't read static fields of %s in strict transaction",
+                           PrettyClass(obj->AsClass()).c_str());
+    return false;
+  }
+  return true;
+}
+
 // Restricted support for character upper case / lower case. Only support ASCII, where
 // it's easy. Abort the transaction otherwise.
 static void CharacterLowerUpper(Thread* self,
@@ -1177,6 +1190,9 @@ void UnstartedRuntime::UnstartedUnsafeCompareAndSwapLong(
     AbortTransactionOrFail(self, "Cannot access null object, retry at runtime.");
     return;
   }
+  if (!CheckUnsafeRead(self, obj)) {
+    return;
+  }
   int64_t offset = shadow_frame->GetVRegLong(arg_offset + 2);
   int64_t expectedValue = shadow_frame->GetVRegLong(arg_offset + 4);
   int64_t newValue = shadow_frame->GetVRegLong(arg_offset + 6);
@@ -1215,6 +1231,9 @@ void UnstartedRuntime::UnstartedUnsafeCompareAndSwapObject(
     AbortTransactionOrFail(self, "Cannot access null object, retry at runtime.");
     return;
   }
+  if (!CheckUnsafeRead(self, obj)) {
+    return;
+  }
   int64_t offset = shadow_frame->GetVRegLong(arg_offset + 2);
   mirror::Object* expected_value = shadow_frame->GetVRegReference(arg_offset + 4);
   mirror::Object* newValue = shadow_frame->GetVRegReference(arg_offset + 5);
@@ -1254,6 +1273,9 @@ void UnstartedRuntime::UnstartedUnsafeGetObjectVolatile(
     AbortTransactionOrFail(self, "Cannot access null object, retry at runtime.");
     return;
   }
+  if (!CheckUnsafeRead(self, obj)) {
+    return;
+  }
   int64_t offset = shadow_frame->GetVRegLong(arg_offset + 2);
   mirror::Object* value = obj->GetFieldObjectVolatile<mirror::Object>(MemberOffset(offset));
   result->SetL(value);
@@ -1587,9 +1609,12 @@ void UnstartedRuntime::UnstartedJNIByteOrderIsLittleEndian(
 }
 
 void UnstartedRuntime::UnstartedJNIUnsafeCompareAndSwapInt(
-    Thread* self ATTRIBUTE_UNUSED, ArtMethod* method ATTRIBUTE_UNUSED,
+    Thread* self, ArtMethod* method ATTRIBUTE_UNUSED,
     mirror::Object* receiver ATTRIBUTE_UNUSED, uint32_t* args, JValue* result) {
   mirror::Object* obj = reinterpret_cast<mirror::Object*>(args[0]);
+  if (!CheckUnsafeRead(self, obj)) {
+    return;
+  }
   jlong offset = (static_cast<uint64_t>(args[2]) << 32) | args[1];
   jint expectedValue = args[3];
   jint newValue = args[4];
@@ -1612,6 +1637,9 @@ void UnstartedRuntime::UnstartedJNIUnsafeGetIntVolatile(
     AbortTransactionOrFail(self, "Cannot access null object, retry at runtime.");
     return;
   }
+  if (!CheckUnsafeRead(self, obj)) {
+    return;
+  }
 
   jlong offset = (static_cast<uint64_t>(args[2]) << 32) | args[1];
   result->SetI(obj->GetField32Volatile(MemberOffset(offset)));
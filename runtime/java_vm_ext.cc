@@ -37,6 +37,7 @@
 #include "runtime_options.h"
 #include "ScopedLocalRef.h"
 #include "scoped_thread_state_change.h"
+#include "startup_timeline.h"
 #include "thread-inl.h"
 #include "thread_list.h"
 
@@ -856,7 +857,11 @@ bool JavaVMExt::LoadNativeLibrary(JNIEnv* env,
     VLOG(jni) << "[Calling JNI_OnLoad in \"" << path << "\"]";
     typedef int (*JNI_OnLoadFn)(JavaVM*, void*);
     JNI_OnLoadFn jni_on_load = reinterpret_cast<JNI_OnLoadFn>(sym);
-    int version = (*jni_on_load)(this, nullptr);
+    int version;
+    {
+      ScopedStartupPhase phase("JNI_OnLoad", path);
+      version = (*jni_on_load)(this, nullptr);
+    }
 
     if (runtime_->GetTargetSdkVersion() != 0 && runtime_->GetTargetSdkVersion() <= 21) {
       fault_manager.EnsureArtActionInFrontOfSignalChain();
@@ -966,6 +971,10 @@ extern "C" jint JNI_CreateJavaVM(JavaVM** p_vm, JNIEnv** p_env, void* vm_args) {
     return JNI_ERR;
   }
 
+  if (runtime->GetStartupTimeline() != nullptr) {
+    runtime->GetStartupTimeline()->Finish();
+  }
+
   *p_env = Thread::Current()->GetJniEnv();
   *p_vm = runtime->GetJavaVM();
   return JNI_OK;
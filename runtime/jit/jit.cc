@@ -17,8 +17,13 @@
 #include "jit.h"
 
 #include <dlfcn.h>
+#include <stdio.h>
+#include <unistd.h>
 
 #include "art_method-inl.h"
+#include "base/stringprintf.h"
+#include "base/systrace.h"
+#include "base/unix_file/fd_file.h"
 #include "debugger.h"
 #include "entrypoints/runtime_asm_entrypoints.h"
 #include "interpreter/interpreter.h"
@@ -26,6 +31,7 @@
 #include "oat_file_manager.h"
 #include "oat_quick_method_header.h"
 #include "offline_profiling_info.h"
+#include "os.h"
 #include "profile_saver.h"
 #include "runtime.h"
 #include "runtime_options.h"
@@ -39,6 +45,8 @@ namespace jit {
 static constexpr bool kEnableOnStackReplacement = true;
 // At what priority to schedule jit threads. 9 is the lowest foreground priority on device.
 static constexpr int kJitPoolThreadPthreadPriority = 9;
+// How many methods to compile before saving the warm start file again.
+static constexpr uint32_t kWarmStartSaveBatch = 256;
 
 // JIT compiler
 void* Jit::jit_library_handle_= nullptr;
@@ -61,6 +69,11 @@ JitOptions* JitOptions::CreateFromRuntimeArguments(const RuntimeArgumentMap& opt
       options.Exists(RuntimeArgumentMap::DumpJITInfoOnShutdown);
   jit_options->save_profiling_info_ =
       options.GetOrDefault(RuntimeArgumentMap::JITSaveProfilingInfo);
+  jit_options->compact_code_cache_ =
+      options.GetOrDefault(RuntimeArgumentMap::JITCompactCodeCache);
+  if (options.Exists(RuntimeArgumentMap::JITWarmStartFile)) {
+    jit_options->warm_start_file_ = *options.Get(RuntimeArgumentMap::JITWarmStartFile);
+  }
 
   jit_options->compile_threshold_ = options.GetOrDefault(RuntimeArgumentMap::JITCompileThreshold);
   if (jit_options->compile_threshold_ > std::numeric_limits<uint16_t>::max()) {
@@ -126,6 +139,10 @@ bool Jit::ShouldUsePriorityThreadWeight() {
 
 void Jit::DumpInfo(std::ostream& os) {
   code_cache_->Dump(os);
+  if (!warm_start_file_.empty()) {
+    os << "Warm start compilations=" << warm_start_compilations_.LoadRelaxed() << "\n";
+  }
+  Runtime::Current()->GetClassLinker()->DumpImtConflictStats(os);
   cumulative_timings_.Dump(os);
   MutexLock mu(Thread::Current(), lock_);
   memory_use_.PrintMemoryUse(os);
@@ -145,7 +162,13 @@ Jit::Jit() : dump_info_on_shutdown_(false),
              memory_use_("Memory used for compilation", 16),
              lock_("JIT memory use lock"),
              use_jit_compilation_(true),
-             save_profiling_info_(false) {}
+             save_profiling_info_(false),
+             has_warm_start_methods_(false),
+             warm_start_lock_("JIT warm start lock"),
+             warm_start_snapshots_(0),
+             last_saved_warm_start_snapshot_(0),
+             methods_compiled_since_warm_start_save_(0),
+             warm_start_compilations_(0) {}
 
 Jit* Jit::Create(JitOptions* options, std::string* error_msg) {
   DCHECK(options->UseJitCompilation() || options->GetSaveProfilingInfo());
@@ -158,6 +181,7 @@ Jit* Jit::Create(JitOptions* options, std::string* error_msg) {
       options->GetCodeCacheInitialCapacity(),
       options->GetCodeCacheMaxCapacity(),
       jit->generate_debug_info_,
+      options->GetCompactCodeCache(),
       error_msg));
   if (jit->GetCodeCache() == nullptr) {
     return nullptr;
@@ -168,8 +192,13 @@ Jit* Jit::Create(JitOptions* options, std::string* error_msg) {
       << PrettySize(options->GetCodeCacheInitialCapacity())
       << ", max_capacity=" << PrettySize(options->GetCodeCacheMaxCapacity())
       << ", compile_threshold=" << options->GetCompileThreshold()
-      << ", save_profiling_info=" << options->GetSaveProfilingInfo();
+      << ", save_profiling_info=" << options->GetSaveProfilingInfo()
+      << ", warm_start_file=" << options->GetWarmStartFile();
 
+  if (jit->use_jit_compilation_ && !options->GetWarmStartFile().empty()) {
+    jit->warm_start_file_ = options->GetWarmStartFile();
+    jit->LoadWarmStartFile();
+  }
 
   jit->hot_method_threshold_ = options->GetCompileThreshold();
   jit->warm_method_threshold_ = options->GetWarmupThreshold();
@@ -240,6 +269,22 @@ bool Jit::LoadCompiler(std::string* error_msg) {
   return true;
 }
 
+class JitWarmStartSaveTask FINAL : public Task {
+ public:
+  JitWarmStartSaveTask() {}
+
+  void Run(Thread* self) OVERRIDE {
+    Runtime::Current()->GetJit()->SaveWarmStartFile(self);
+  }
+
+  void Finalize() OVERRIDE {
+    delete this;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(JitWarmStartSaveTask);
+};
+
 bool Jit::CompileMethod(ArtMethod* method, Thread* self, bool osr) {
   DCHECK(Runtime::Current()->UseJitCompilation());
   DCHECK(!method->IsRuntimeMethod());
@@ -273,6 +318,13 @@ bool Jit::CompileMethod(ArtMethod* method, Thread* self, bool osr) {
     VLOG(jit) << "Failed to compile method "
               << PrettyMethod(method_to_compile)
               << " osr=" << std::boolalpha << osr;
+  } else if (!osr &&
+             !warm_start_file_.empty() &&
+             methods_compiled_since_warm_start_save_.FetchAndAddRelaxed(1) + 1 ==
+                 kWarmStartSaveBatch &&
+             thread_pool_ != nullptr) {
+    // Save from a separate task, the file is written without holding the mutator lock.
+    thread_pool_->AddTask(self, new JitWarmStartSaveTask());
   }
   return success;
 }
@@ -321,6 +373,98 @@ void Jit::StopProfileSaver() {
   }
 }
 
+void Jit::LoadWarmStartFile() {
+  ScopedTrace trace(__FUNCTION__);
+  if (!ReadWarmStartFile(warm_start_file_, &warm_start_info_)) {
+    return;
+  }
+  has_warm_start_methods_ = warm_start_info_.GetNumberOfMethods() != 0;
+  VLOG(jit) << "Loaded " << warm_start_info_.GetNumberOfMethods()
+            << " methods from the JIT warm start file " << warm_start_file_;
+}
+
+bool Jit::ReadWarmStartFile(const std::string& filename, ProfileCompilationInfo* info) {
+  std::unique_ptr<File> file(OS::OpenFileForReading(filename.c_str()));
+  if (file == nullptr) {
+    // There is no file before the first run.
+    VLOG(jit) << "No JIT warm start file " << filename;
+    return false;
+  }
+  ProfileCompilationInfo file_info;
+  if (!file_info.Load(file->Fd()) || !info->MergeWith(file_info)) {
+    LOG(WARNING) << "Ignoring invalid JIT warm start file " << filename;
+    return false;
+  }
+  return true;
+}
+
+bool Jit::IsWarmStartMethod(ArtMethod* method) {
+  return has_warm_start_methods_ &&
+      warm_start_info_.ContainsMethod(
+          MethodReference(method->GetDexFile(), method->GetDexMethodIndex()));
+}
+
+void Jit::SaveWarmStartFile(Thread* self) {
+  if (warm_start_file_.empty()) {
+    return;
+  }
+  ScopedTrace trace(__FUNCTION__);
+  methods_compiled_since_warm_start_save_.StoreRelaxed(0);
+  ProfileCompilationInfo info;
+  uint32_t snapshot;
+  {
+    ScopedObjectAccess soa(self);
+    std::vector<MethodReference> methods;
+    code_cache_->GetCompiledMethods(&methods);
+    snapshot = warm_start_snapshots_.FetchAndAddSequentiallyConsistent(1) + 1;
+    if (!info.AddMethodsAndClasses(methods, std::set<DexCacheResolvedClasses>())) {
+      LOG(WARNING) << "Could not record the JIT compiled methods";
+      return;
+    }
+  }
+
+  // The periodic JitWarmStartSaveTask may still be running when the runtime saves at shutdown.
+  MutexLock mu(self, warm_start_lock_);
+  if (snapshot < last_saved_warm_start_snapshot_) {
+    VLOG(jit) << "Not saving an older list of JIT compiled methods";
+    return;
+  }
+  if (WriteWarmStartFile(warm_start_file_, &info)) {
+    last_saved_warm_start_snapshot_ = snapshot;
+    VLOG(jit) << "Saved " << info.GetNumberOfMethods()
+              << " methods to the JIT warm start file " << warm_start_file_;
+  }
+}
+
+bool Jit::WriteWarmStartFile(const std::string& filename, ProfileCompilationInfo* info) {
+  // Write a temporary file and rename it, so that a process killed while saving keeps the
+  // previous file. The name is unique to the thread, as other threads or processes using the
+  // same warm start file may be saving at the same time.
+  const std::string temp_file = StringPrintf("%s.%d.%d.tmp", filename.c_str(), getpid(), GetTid());
+  std::unique_ptr<File> file(OS::CreateEmptyFileWriteOnly(temp_file.c_str()));
+  if (file == nullptr) {
+    PLOG(WARNING) << "Could not create the JIT warm start file " << temp_file;
+    return false;
+  }
+  if (!info->Save(file->Fd())) {
+    LOG(WARNING) << "Could not write the JIT warm start file " << temp_file;
+    file->Erase();
+    unlink(temp_file.c_str());
+    return false;
+  }
+  if (file->FlushCloseOrErase() != 0) {
+    PLOG(WARNING) << "Could not close the JIT warm start file " << temp_file;
+    unlink(temp_file.c_str());
+    return false;
+  }
+  if (rename(temp_file.c_str(), filename.c_str()) != 0) {
+    PLOG(WARNING) << "Could not rename " << temp_file << " to " << filename;
+    unlink(temp_file.c_str());
+    return false;
+  }
+  return true;
+}
+
 bool Jit::JitAtFirstUse() {
   return HotMethodThreshold() == 0;
 }
@@ -606,6 +750,31 @@ void Jit::AddSamples(Thread* self, ArtMethod* method, uint16_t count, bool with_
   DCHECK_LE(priority_thread_weight_, hot_method_threshold_);
 
   int32_t starting_count = method->GetCounter();
+  if (UNLIKELY(starting_count == 0) &&
+      has_warm_start_methods_ &&
+      use_jit_compilation_ &&
+      !method->IsProxyMethod() &&
+      IsWarmStartMethod(method)) {
+    // The first use of a method compiled by the previous run: compile it now rather than
+    // waiting for it to get hot again. The compilation is done against the classes loaded in
+    // this run, so nothing assumed by the previous code is reused.
+    bool has_profiling_info = (method->GetProfilingInfo(sizeof(void*)) != nullptr) ||
+        ProfilingInfo::Create(self, method, /* retry_allocation */ false);
+    if (thread_pool_ == nullptr) {
+      // Calling ProfilingInfo::Create might put us in a suspended state, which could
+      // lead to the thread pool being deleted when we are shutting down.
+      DCHECK(Runtime::Current()->IsShuttingDown(self));
+      return;
+    }
+    if (has_profiling_info) {
+      VLOG(jit) << "Warm start compilation of " << PrettyMethod(method);
+      thread_pool_->AddTask(self, new JitCompileTask(method, JitCompileTask::kCompile));
+      warm_start_compilations_.FetchAndAddRelaxed(1);
+      method->SetCounter(hot_method_threshold_);
+      return;
+    }
+    // Otherwise, the method goes through the regular thresholds.
+  }
   if (Jit::ShouldUsePriorityThreadWeight()) {
     count *= priority_thread_weight_;
   }
@@ -17,6 +17,7 @@
 #ifndef ART_RUNTIME_JIT_JIT_H_
 #define ART_RUNTIME_JIT_JIT_H_
 
+#include "atomic.h"
 #include "base/arena_allocator.h"
 #include "base/histogram-inl.h"
 #include "base/macros.h"
@@ -136,6 +137,20 @@ class Jit {
                          const std::string& app_dir);
   void StopProfileSaver();
 
+  // Writes the methods which currently have JIT code to the warm start file, if there is one.
+  // The next run of the process compiles them at their first use instead of waiting for them
+  // to get hot again.
+  void SaveWarmStartFile(Thread* self) REQUIRES(!warm_start_lock_, !Locks::mutator_lock_);
+
+  // Reads the methods recorded in the warm start file `filename` into `info`. Returns false if
+  // the file does not exist or is not a valid profile.
+  static bool ReadWarmStartFile(const std::string& filename, ProfileCompilationInfo* info);
+
+  // Writes `info` to the warm start file `filename`. The data goes to a temporary file private
+  // to the calling thread which is then renamed, so that concurrent writers and a process killed
+  // while writing always leave a complete file.
+  static bool WriteWarmStartFile(const std::string& filename, ProfileCompilationInfo* info);
+
   void DumpForSigQuit(std::ostream& os) REQUIRES(!lock_);
 
   static void NewTypeLoadedIfUsingJit(mirror::Class* type)
@@ -172,6 +187,13 @@ class Jit {
 
   static bool LoadCompiler(std::string* error_msg);
 
+  // Loads the methods compiled by a previous run of the process from the warm start file.
+  void LoadWarmStartFile();
+
+  // Returns whether `method` was compiled by a previous run. The dex file checksums recorded
+  // in the warm start file must match the ones of the loaded dex files.
+  bool IsWarmStartMethod(ArtMethod* method) SHARED_REQUIRES(Locks::mutator_lock_);
+
   // JIT compiler
   static void* jit_library_handle_;
   static void* jit_compiler_handle_;
@@ -198,6 +220,19 @@ class Jit {
   uint16_t invoke_transition_weight_;
   std::unique_ptr<ThreadPool> thread_pool_;
 
+  // The file recording the compiled methods across runs, empty if there is none.
+  std::string warm_start_file_;
+  // The methods compiled by the previous run. Only written when creating the JIT.
+  ProfileCompilationInfo warm_start_info_;
+  bool has_warm_start_methods_;
+  Mutex warm_start_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  // Orders the snapshots of the compiled methods, so that a save which took its snapshot before
+  // the last written one does not overwrite it.
+  Atomic<uint32_t> warm_start_snapshots_;
+  uint32_t last_saved_warm_start_snapshot_ GUARDED_BY(warm_start_lock_);
+  Atomic<uint32_t> methods_compiled_since_warm_start_save_;
+  Atomic<uint32_t> warm_start_compilations_;
+
   DISALLOW_COPY_AND_ASSIGN(Jit);
 };
 
@@ -231,6 +266,12 @@ class JitOptions {
   bool GetSaveProfilingInfo() const {
     return save_profiling_info_;
   }
+  bool GetCompactCodeCache() const {
+    return compact_code_cache_;
+  }
+  const std::string& GetWarmStartFile() const {
+    return warm_start_file_;
+  }
   bool UseJitCompilation() const {
     return use_jit_compilation_;
   }
@@ -256,6 +297,8 @@ class JitOptions {
   size_t invoke_transition_weight_;
   bool dump_info_on_shutdown_;
   bool save_profiling_info_;
+  bool compact_code_cache_;
+  std::string warm_start_file_;
 
   JitOptions()
       : use_jit_compilation_(false),
@@ -263,7 +306,8 @@ class JitOptions {
         code_cache_max_capacity_(0),
         compile_threshold_(0),
         dump_info_on_shutdown_(false),
-        save_profiling_info_(false) { }
+        save_profiling_info_(false),
+        compact_code_cache_(false) { }
 
   DISALLOW_COPY_AND_ASSIGN(JitOptions);
 };
@@ -27,6 +27,7 @@
 #include "gc/accounting/bitmap-inl.h"
 #include "gc/scoped_gc_critical_section.h"
 #include "jit/jit.h"
+#include "jit/offline_profiling_info.h"
 #include "jit/profiling_info.h"
 #include "linear_alloc.h"
 #include "mem_map.h"
@@ -56,6 +57,7 @@ static constexpr size_t kStackMapSizeLogThreshold = 50 * KB;
 JitCodeCache* JitCodeCache::Create(size_t initial_capacity,
                                    size_t max_capacity,
                                    bool generate_debug_info,
+                                   bool compact_code,
                                    std::string* error_msg) {
   ScopedTrace trace(__PRETTY_FUNCTION__);
   CHECK_GE(max_capacity, initial_capacity);
@@ -111,8 +113,15 @@ JitCodeCache* JitCodeCache::Create(size_t initial_capacity,
   data_size = initial_capacity / 2;
   code_size = initial_capacity - data_size;
   DCHECK_EQ(code_size + data_size, initial_capacity);
-  return new JitCodeCache(
-      code_map, data_map, code_size, data_size, max_capacity, garbage_collect_code);
+  // Moving the code would need the debug information to be moved too.
+  compact_code = compact_code && garbage_collect_code;
+  return new JitCodeCache(code_map,
+                          data_map,
+                          code_size,
+                          data_size,
+                          max_capacity,
+                          garbage_collect_code,
+                          compact_code);
 }
 
 JitCodeCache::JitCodeCache(MemMap* code_map,
@@ -120,7 +129,8 @@ JitCodeCache::JitCodeCache(MemMap* code_map,
                            size_t initial_code_capacity,
                            size_t initial_data_capacity,
                            size_t max_capacity,
-                           bool garbage_collect_code)
+                           bool garbage_collect_code,
+                           bool compact_code)
     : lock_("Jit code cache", kJitCodeCacheLock),
       lock_cond_("Jit code cache variable", lock_),
       collection_in_progress_(false),
@@ -133,12 +143,17 @@ JitCodeCache::JitCodeCache(MemMap* code_map,
       last_collection_increased_code_cache_(false),
       last_update_time_ns_(0),
       garbage_collect_code_(garbage_collect_code),
+      compact_code_(compact_code),
+      pending_code_commits_(0),
       used_memory_for_data_(0),
       used_memory_for_code_(0),
       number_of_compilations_(0),
       number_of_osr_compilations_(0),
       number_of_deoptimizations_(0),
       number_of_collections_(0),
+      number_of_evictions_(0),
+      number_of_compactions_(0),
+      number_of_relocated_methods_(0),
       histogram_stack_map_memory_use_("Memory used for stack maps", 16),
       histogram_code_memory_use_("Memory used for compiled code", 16),
       histogram_profiling_info_memory_use_("Memory used for profiling info", 16) {
@@ -332,6 +347,8 @@ uint8_t* JitCodeCache::CommitCodeInternal(Thread* self,
       if (memory == nullptr) {
         return nullptr;
       }
+      // The code cache cannot be compacted until the code is in method_code_map_.
+      pending_code_commits_++;
       code_ptr = memory + header_size;
 
       std::copy(code, code + code_size, code_ptr);
@@ -351,6 +368,8 @@ uint8_t* JitCodeCache::CommitCodeInternal(Thread* self,
   // We need to update the entry point in the runnable state for the instrumentation.
   {
     MutexLock mu(self, lock_);
+    DCHECK_NE(pending_code_commits_, 0u);
+    pending_code_commits_--;
     method_code_map_.Put(code_ptr, method);
     if (osr) {
       number_of_osr_compilations_++;
@@ -613,6 +632,16 @@ void JitCodeCache::GarbageCollectCache(Thread* self) {
 
     DoCollection(self, /* collect_profiling_info */ do_full_collection);
 
+    bool do_compaction = false;
+    if (do_full_collection && compact_code_) {
+      MutexLock mu(self, lock_);
+      do_compaction = ShouldCompactCode();
+    }
+    if (do_compaction) {
+      TimingLogger::ScopedTiming st2("Code cache compaction", &logger);
+      CompactCode(self);
+    }
+
     if (!kIsDebugBuild || VLOG_IS_ON(jit)) {
       LOG(INFO) << "After code cache collection, code="
                 << PrettySize(CodeCacheSize())
@@ -670,8 +699,200 @@ void JitCodeCache::RemoveUnmarkedCode(Thread* self) {
     } else {
       FreeCode(code_ptr, method);
       it = method_code_map_.erase(it);
+      number_of_evictions_++;
+    }
+  }
+}
+
+void JitCodeCache::SelectCodeToEvict() {
+  // The methods whose entry point is still the interpreter were not called since the polling
+  // for the liveness of compiled code started, see GarbageCollectCache(). Calling a method puts
+  // its saved entry point back, see Jit::MethodEntered().
+  std::vector<ProfilingInfo*> unused;
+  for (ProfilingInfo* info : profiling_infos_) {
+    if (ContainsPc(info->GetMethod()->GetEntryPointFromQuickCompiledCode())) {
+      info->ResetCodeAge();
+    } else if (info->GetSavedEntryPoint() != nullptr) {
+      info->IncrementCodeAge();
+      unused.push_back(info);
+    }
+  }
+
+  // Evict the code unused for kMaxCodeAge collections. When the code cache is full, also evict
+  // the oldest unused code until a quarter of the code memory is freed.
+  std::stable_sort(unused.begin(), unused.end(), [](ProfilingInfo* lhs, ProfilingInfo* rhs) {
+    return lhs->GetCodeAge() > rhs->GetCodeAge();
+  });
+  size_t bytes_to_evict = (current_capacity_ == max_capacity_) ? used_memory_for_code_ / 4 : 0u;
+  size_t evicted_bytes = 0u;
+  for (ProfilingInfo* info : unused) {
+    const void* entry_point = info->GetSavedEntryPoint();
+    if (info->GetCodeAge() >= kMaxCodeAge || evicted_bytes < bytes_to_evict) {
+      evicted_bytes += OatQuickMethodHeader::FromEntryPoint(entry_point)->GetCodeSize();
+    } else {
+      // Keep the code. Restoring the entry point marks it live below.
+      info->SetSavedEntryPoint(nullptr);
+      Runtime::Current()->GetInstrumentation()->UpdateMethodsCode(info->GetMethod(), entry_point);
+    }
+  }
+}
+
+bool JitCodeCache::ShouldCompactCode() {
+  // The memory lost in the holes between the live code, that dlmalloc can only reuse for code
+  // that fits in them.
+  size_t code_end = 0u;
+  for (const auto& it : method_code_map_) {
+    const OatQuickMethodHeader* method_header = OatQuickMethodHeader::FromCodePointer(it.first);
+    const uint8_t* end = reinterpret_cast<const uint8_t*>(it.first) + method_header->GetCodeSize();
+    code_end = std::max(code_end, static_cast<size_t>(end - code_map_->Begin()));
+  }
+  size_t holes = (code_end > used_memory_for_code_) ? code_end - used_memory_for_code_ : 0u;
+  return holes >= kPageSize && holes >= code_end / 4;
+}
+
+// Collect the addresses of the return pcs into the code cache, in the frames of a thread.
+class CollectCodeReturnPcsVisitor FINAL : public StackVisitor {
+ public:
+  CollectCodeReturnPcsVisitor(Thread* thread_in,
+                              JitCodeCache* code_cache_in,
+                              std::vector<uintptr_t*>* return_pc_addresses)
+      : StackVisitor(thread_in, nullptr, StackVisitor::StackWalkKind::kSkipInlinedFrames),
+        code_cache_(code_cache_in),
+        return_pc_addresses_(return_pc_addresses) {}
+
+  bool VisitFrame() OVERRIDE SHARED_REQUIRES(Locks::mutator_lock_) {
+    if (GetCurrentQuickFrame() == nullptr) {
+      return true;
+    }
+    uint8_t* sp = reinterpret_cast<uint8_t*>(GetCurrentQuickFrame());
+    uintptr_t* return_pc_address =
+        reinterpret_cast<uintptr_t*>(sp + GetCurrentQuickFrameInfo().GetReturnPcOffset());
+    if (code_cache_->ContainsPc(reinterpret_cast<const void*>(*return_pc_address))) {
+      return_pc_addresses_->push_back(return_pc_address);
+    }
+    return true;
+  }
+
+ private:
+  JitCodeCache* const code_cache_;
+  std::vector<uintptr_t*>* const return_pc_addresses_;
+};
+
+void JitCodeCache::CompactCode(Thread* self) {
+  ScopedTrace trace(__FUNCTION__);
+  ScopedThreadSuspension sts(self, kSuspended);
+  ScopedSuspendAll ssa(__FUNCTION__);
+  Runtime* runtime = Runtime::Current();
+  if (runtime->GetInstrumentation()->AreExitStubsInstalled()) {
+    // The return pcs in the instrumentation stacks would need to be moved too.
+    return;
+  }
+
+  // Find the return pcs before moving the code, as walking the stacks needs to find the code of
+  // the frames.
+  std::vector<uintptr_t*> return_pc_addresses;
+  {
+    MutexLock mu(self, *Locks::thread_list_lock_);
+    for (Thread* thread : runtime->GetThreadList()->GetList()) {
+      CollectCodeReturnPcsVisitor visitor(thread, this, &return_pc_addresses);
+      visitor.WalkStack();
     }
   }
+
+  MutexLock mu(self, lock_);
+  if (pending_code_commits_ != 0u) {
+    // A compiler thread is between allocating code and adding it to method_code_map_.
+    return;
+  }
+
+  // Save the live code, in address order.
+  size_t alignment = GetInstructionSetAlignment(kRuntimeISA);
+  size_t header_size = RoundUp(sizeof(OatQuickMethodHeader), alignment);
+  struct LiveCode {
+    const void* old_code_ptr;
+    ArtMethod* method;
+    const uint8_t* vmap_table;
+    std::vector<uint8_t> memory;
+  };
+  std::vector<LiveCode> live_code;
+  live_code.reserve(method_code_map_.size());
+  for (const auto& it : method_code_map_) {
+    const OatQuickMethodHeader* method_header = OatQuickMethodHeader::FromCodePointer(it.first);
+    const uint8_t* allocation = reinterpret_cast<const uint8_t*>(FromCodeToAllocation(it.first));
+    live_code.push_back(LiveCode {
+        it.first,
+        it.second,
+        (method_header->vmap_table_offset_ == 0)
+            ? nullptr
+            : method_header->code_ - method_header->vmap_table_offset_,
+        std::vector<uint8_t>(allocation, allocation + header_size + method_header->code_size_) });
+  }
+
+  // Allocate the code again from a new mspace over the same memory, which puts it together at
+  // the start of the code cache.
+  SafeMap<const void*, const void*> new_code_ptrs;
+  {
+    ScopedCodeCacheWrite scc(code_map_.get());
+    code_mspace_ = create_mspace_with_base(code_map_->Begin(), code_end_, false /*locked*/);
+    if (code_mspace_ == nullptr) {
+      PLOG(FATAL) << "create_mspace_with_base failed";
+    }
+    mspace_set_footprint_limit(code_mspace_, current_capacity_ / 2);
+    used_memory_for_code_ = 0;
+    for (const LiveCode& code : live_code) {
+      uint8_t* memory = AllocateCode(code.memory.size());
+      CHECK(memory != nullptr) << "No room for the live code after compaction";
+      std::copy(code.memory.begin(), code.memory.end(), memory);
+      uint8_t* code_ptr = memory + header_size;
+      OatQuickMethodHeader* method_header = OatQuickMethodHeader::FromCodePointer(code_ptr);
+      method_header->vmap_table_offset_ =
+          (code.vmap_table == nullptr) ? 0 : dchecked_integral_cast<uint32_t>(
+              code_ptr - code.vmap_table);
+      FlushInstructionCache(reinterpret_cast<char*>(code_ptr),
+                            reinterpret_cast<char*>(code_ptr + method_header->code_size_));
+      new_code_ptrs.Put(code.old_code_ptr, code_ptr);
+    }
+  }
+  auto relocate = [&new_code_ptrs](const void* ptr) {
+    // The code containing `ptr` starts at the last code pointer not after it.
+    auto it = new_code_ptrs.lower_bound(ptr);
+    if (it == new_code_ptrs.end() || it->first != ptr) {
+      DCHECK(it != new_code_ptrs.begin());
+      --it;
+    }
+    return reinterpret_cast<const uint8_t*>(it->second) +
+        (reinterpret_cast<const uint8_t*>(ptr) - reinterpret_cast<const uint8_t*>(it->first));
+  };
+
+  // Update the references to the code.
+  for (uintptr_t* return_pc_address : return_pc_addresses) {
+    *return_pc_address = reinterpret_cast<uintptr_t>(
+        relocate(reinterpret_cast<const void*>(*return_pc_address)));
+  }
+  for (const LiveCode& code : live_code) {
+    const void* entry_point = code.method->GetEntryPointFromQuickCompiledCode();
+    if (ContainsPc(entry_point)) {
+      runtime->GetInstrumentation()->UpdateMethodsCode(code.method, relocate(entry_point));
+    }
+  }
+  for (ProfilingInfo* info : profiling_infos_) {
+    if (info->GetSavedEntryPoint() != nullptr) {
+      info->SetSavedEntryPoint(relocate(info->GetSavedEntryPoint()));
+    }
+  }
+  for (auto& it : osr_code_map_) {
+    it.second = relocate(it.second);
+  }
+  method_code_map_.clear();
+  for (const LiveCode& code : live_code) {
+    method_code_map_.Put(new_code_ptrs.Get(code.old_code_ptr), code.method);
+  }
+
+  number_of_compactions_++;
+  number_of_relocated_methods_ += live_code.size();
+  last_update_time_ns_.StoreRelease(NanoTime());
+  VLOG(jit) << "Compacted JIT code cache, moved " << live_code.size() << " methods, code="
+            << PrettySize(used_memory_for_code_);
 }
 
 void JitCodeCache::DoCollection(Thread* self, bool collect_profiling_info) {
@@ -679,6 +900,7 @@ void JitCodeCache::DoCollection(Thread* self, bool collect_profiling_info) {
   {
     MutexLock mu(self, lock_);
     if (collect_profiling_info) {
+      SelectCodeToEvict();
       // Clear the profiling info of methods that do not have compiled code as entrypoint.
       // Also remove the saved entry point from the ProfilingInfo objects.
       for (ProfilingInfo* info : profiling_infos_) {
@@ -892,18 +1114,65 @@ void* JitCodeCache::MoreCore(const void* mspace, intptr_t increment) NO_THREAD_S
 }
 
 void JitCodeCache::GetProfiledMethods(const std::set<std::string>& dex_base_locations,
-                                      std::vector<MethodReference>& methods) {
+                                      std::vector<ProfileMethodInfo>& methods,
+                                      bool only_new) {
   ScopedTrace trace(__FUNCTION__);
   MutexLock mu(Thread::Current(), lock_);
-  for (const ProfilingInfo* info : profiling_infos_) {
+  for (ProfilingInfo* info : profiling_infos_) {
+    if (only_new && info->is_reported_to_profile_saver_) {
+      continue;
+    }
     ArtMethod* method = info->GetMethod();
     const DexFile* dex_file = method->GetDexFile();
-    if (ContainsElement(dex_base_locations, dex_file->GetBaseLocation())) {
-      methods.emplace_back(dex_file,  method->GetDexMethodIndex());
+    if (!ContainsElement(dex_base_locations, dex_file->GetBaseLocation())) {
+      continue;
+    }
+    info->is_reported_to_profile_saver_ = true;
+    methods.emplace_back(dex_file, method->GetDexMethodIndex());
+    ProfileMethodInfo& method_info = methods.back();
+    for (size_t i = 0; i < info->number_of_inline_caches_; ++i) {
+      const InlineCache& cache = info->cache_[i];
+      if (cache.IsUninitialized()) {
+        continue;
+      }
+      ProfileMethodInfo::ProfileInlineCache profile_cache;
+      profile_cache.dex_pc = cache.GetDexPc();
+      profile_cache.is_missing_types = false;
+      profile_cache.is_megamorphic = cache.IsMegamorphic();
+      if (!profile_cache.is_megamorphic) {
+        for (size_t k = 0; k < InlineCache::kIndividualCacheSize; ++k) {
+          mirror::Class* cls = cache.GetTypeAt(k);
+          if (cls == nullptr) {
+            break;
+          }
+          // Only the classes of the profiled dex files can be named in the profile. The others,
+          // including array and proxy classes, are just recorded as missing.
+          if (cls->IsProxyClass() ||
+              cls->GetDexCache() == nullptr ||
+              cls->GetDexTypeIndex() == DexFile::kDexNoIndex16 ||
+              !ContainsElement(dex_base_locations, cls->GetDexFile().GetBaseLocation())) {
+            profile_cache.is_missing_types = true;
+            continue;
+          }
+          profile_cache.classes.push_back(
+              ProfileMethodInfo::ProfileClassReference { &cls->GetDexFile(),
+                                                         cls->GetDexTypeIndex() });
+        }
+      }
+      method_info.inline_caches.push_back(std::move(profile_cache));
     }
   }
 }
 
+void JitCodeCache::GetCompiledMethods(std::vector<MethodReference>* methods) {
+  ScopedTrace trace(__FUNCTION__);
+  MutexLock mu(Thread::Current(), lock_);
+  for (const auto& it : method_code_map_) {
+    ArtMethod* method = it.second;
+    methods->push_back(MethodReference(method->GetDexFile(), method->GetDexMethodIndex()));
+  }
+}
+
 uint64_t JitCodeCache::GetLastUpdateTimeNs() const {
   return last_update_time_ns_.LoadAcquire();
 }
@@ -1033,7 +1302,11 @@ void JitCodeCache::Dump(std::ostream& os) {
      << "Total number of JIT compilations for on stack replacement: "
         << number_of_osr_compilations_ << "\n"
      << "Total number of deoptimizations: " << number_of_deoptimizations_ << "\n"
-     << "Total number of JIT code cache collections: " << number_of_collections_ << std::endl;
+     << "Total number of JIT code cache collections: " << number_of_collections_ << "\n"
+     << "Total number of JIT code evictions: " << number_of_evictions_ << "\n"
+     << "Total number of JIT code cache compactions: " << number_of_compactions_ << "\n"
+     << "Total number of JIT compiled methods moved by compactions: "
+        << number_of_relocated_methods_ << std::endl;
   histogram_stack_map_memory_use_.PrintMemoryUse(os);
   histogram_code_memory_use_.PrintMemoryUse(os);
   histogram_profiling_info_memory_use_.PrintMemoryUse(os);
@@ -37,6 +37,7 @@ namespace art {
 class ArtMethod;
 class LinearAlloc;
 class ProfilingInfo;
+struct ProfileMethodInfo;
 
 namespace jit {
 
@@ -56,11 +57,17 @@ class JitCodeCache {
   // By default, do not GC until reaching 256KB.
   static constexpr size_t kReservedCapacity = kInitialCapacity * 4;
 
+  // Number of full collections compiled code can stay unused before being evicted. When the code
+  // cache is full, younger unused code is evicted too, oldest first.
+  static constexpr uint16_t kMaxCodeAge = 3;
+
   // Create the code cache with a code + data capacity equal to "capacity", error message is passed
-  // in the out arg error_msg.
+  // in the out arg error_msg. If `compact_code` is true, the live code is moved together after
+  // the collections that leave the code cache fragmented.
   static JitCodeCache* Create(size_t initial_capacity,
                               size_t max_capacity,
                               bool generate_debug_info,
+                              bool compact_code,
                               std::string* error_msg);
 
   // Number of bytes allocated in the code cache.
@@ -165,9 +172,18 @@ class JitCodeCache {
 
   void* MoreCore(const void* mspace, intptr_t increment);
 
-  // Adds to `methods` all profiled methods which are part of any of the given dex locations.
+  // Adds to `methods` all profiled methods which are part of any of the given dex locations,
+  // with the receiver classes of their inline caches. If `only_new` is true, the methods
+  // already returned by a previous call are skipped.
   void GetProfiledMethods(const std::set<std::string>& dex_base_locations,
-                          std::vector<MethodReference>& methods)
+                          std::vector<ProfileMethodInfo>& methods,
+                          bool only_new)
+      REQUIRES(!lock_)
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
+  // Adds to `methods` all methods which have their code in the cache. OSR-only code is not
+  // included.
+  void GetCompiledMethods(std::vector<MethodReference>* methods)
       REQUIRES(!lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
 
@@ -195,7 +211,8 @@ class JitCodeCache {
                size_t initial_code_capacity,
                size_t initial_data_capacity,
                size_t max_capacity,
-               bool garbage_collect_code);
+               bool garbage_collect_code,
+               bool compact_code);
 
   // Internal version of 'CommitCode' that will not retry if the
   // allocation fails. Return null if the allocation fails.
@@ -249,6 +266,21 @@ class JitCodeCache {
       REQUIRES(!lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
 
+  // Age the compiled code that was not used since the previous collection and restore the entry
+  // points of the code that is kept, so that only the rest is collected.
+  void SelectCodeToEvict()
+      REQUIRES(lock_)
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
+  // Return whether enough memory is lost between the live code to compact the code cache.
+  bool ShouldCompactCode() REQUIRES(lock_);
+
+  // Move the live code to the start of the code cache, updating the entry points of the methods
+  // and the return pcs in the thread stacks. All the threads are suspended while moving.
+  void CompactCode(Thread* self)
+      REQUIRES(!lock_)
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
   void MarkCompiledCodeOnThreadStacks(Thread* self)
       REQUIRES(!lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
@@ -306,6 +338,13 @@ class JitCodeCache {
   // Whether we can do garbage collection.
   const bool garbage_collect_code_;
 
+  // Whether we compact the code after collections.
+  const bool compact_code_;
+
+  // Number of code allocations not yet in method_code_map_. The code cache cannot be compacted
+  // while there are some.
+  size_t pending_code_commits_ GUARDED_BY(lock_);
+
   // The size in bytes of used memory for the data portion of the code cache.
   size_t used_memory_for_data_ GUARDED_BY(lock_);
 
@@ -324,6 +363,13 @@ class JitCodeCache {
   // Number of code cache collections done throughout the lifetime of the JIT.
   size_t number_of_collections_ GUARDED_BY(lock_);
 
+  // Number of compiled methods removed by code cache collections.
+  size_t number_of_evictions_ GUARDED_BY(lock_);
+
+  // Number of code cache compactions, and of compiled methods they moved.
+  size_t number_of_compactions_ GUARDED_BY(lock_);
+  size_t number_of_relocated_methods_ GUARDED_BY(lock_);
+
   // Histograms for keeping track of stack map size statistics.
   Histogram<uint64_t> histogram_stack_map_memory_use_ GUARDED_BY(lock_);
 
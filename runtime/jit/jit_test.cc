@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "jit/jit.h"
+
+#include "base/unix_file/fd_file.h"
+#include "common_runtime_test.h"
+#include "dex_file.h"
+#include "jit/offline_profiling_info.h"
+#include "method_reference.h"
+#include "os.h"
+#include "thread-inl.h"
+#include "thread_pool.h"
+
+namespace art {
+namespace jit {
+
+class JitWarmStartTest : public CommonRuntimeTest {
+ public:
+  void SetUp() OVERRIDE {
+    CommonRuntimeTest::SetUp();
+    scratch_dir_ = android_data_ + "/JitWarmStartTest";
+    ASSERT_EQ(0, mkdir(scratch_dir_.c_str(), 0700));
+    warm_start_file_ = scratch_dir_ + "/warm_start.prof";
+  }
+
+  void TearDown() OVERRIDE {
+    ClearDirectory(scratch_dir_.c_str());
+    ASSERT_EQ(0, rmdir(scratch_dir_.c_str()));
+    CommonRuntimeTest::TearDown();
+  }
+
+ protected:
+  // Records the methods `first` to `first + count - 1` of `dex_file` as JIT compiled.
+  void AddMethods(const DexFile* dex_file,
+                  uint32_t first,
+                  uint32_t count,
+                  ProfileCompilationInfo* info) {
+    ASSERT_LE(first + count, dex_file->NumMethodIds());
+    std::vector<MethodReference> methods;
+    for (uint32_t i = first; i != first + count; ++i) {
+      methods.push_back(MethodReference(dex_file, i));
+    }
+    ASSERT_TRUE(info->AddMethodsAndClasses(methods, std::set<DexCacheResolvedClasses>()));
+  }
+
+  std::vector<std::string> GetScratchFiles() {
+    std::vector<std::string> files;
+    DIR* dir = opendir(scratch_dir_.c_str());
+    CHECK(dir != nullptr);
+    dirent* e;
+    while ((e = readdir(dir)) != nullptr) {
+      if ((strcmp(e->d_name, ".") != 0) && (strcmp(e->d_name, "..") != 0)) {
+        files.push_back(e->d_name);
+      }
+    }
+    closedir(dir);
+    return files;
+  }
+
+  std::string scratch_dir_;
+  std::string warm_start_file_;
+};
+
+TEST_F(JitWarmStartTest, SaveAndLoad) {
+  std::unique_ptr<const DexFile> dex_file(OpenTestDexFile("ClassDependencies"));
+  ASSERT_GT(dex_file->NumMethodIds(), 3u);
+
+  ProfileCompilationInfo saved;
+  // Nothing to load before the first run.
+  ASSERT_FALSE(Jit::ReadWarmStartFile(warm_start_file_, &saved));
+
+  AddMethods(dex_file.get(), 0u, 2u, &saved);
+  ASSERT_TRUE(Jit::WriteWarmStartFile(warm_start_file_, &saved));
+  // Only the warm start file is left behind.
+  EXPECT_EQ(std::vector<std::string>({ "warm_start.prof" }), GetScratchFiles());
+
+  ProfileCompilationInfo loaded;
+  ASSERT_TRUE(Jit::ReadWarmStartFile(warm_start_file_, &loaded));
+  EXPECT_TRUE(loaded.Equals(saved));
+  EXPECT_TRUE(loaded.ContainsMethod(MethodReference(dex_file.get(), 0u)));
+  EXPECT_TRUE(loaded.ContainsMethod(MethodReference(dex_file.get(), 1u)));
+  EXPECT_FALSE(loaded.ContainsMethod(MethodReference(dex_file.get(), 2u)));
+
+  // Saving again replaces the previous list.
+  ProfileCompilationInfo resaved;
+  AddMethods(dex_file.get(), 2u, 1u, &resaved);
+  ASSERT_TRUE(Jit::WriteWarmStartFile(warm_start_file_, &resaved));
+  ProfileCompilationInfo reloaded;
+  ASSERT_TRUE(Jit::ReadWarmStartFile(warm_start_file_, &reloaded));
+  EXPECT_TRUE(reloaded.Equals(resaved));
+  EXPECT_FALSE(reloaded.ContainsMethod(MethodReference(dex_file.get(), 0u)));
+  EXPECT_TRUE(reloaded.ContainsMethod(MethodReference(dex_file.get(), 2u)));
+}
+
+TEST_F(JitWarmStartTest, LoadInvalidFile) {
+  std::unique_ptr<File> file(OS::CreateEmptyFile(warm_start_file_.c_str()));
+  ASSERT_TRUE(file != nullptr);
+  ASSERT_TRUE(file->WriteFully("not a profile", sizeof("not a profile")));
+  ASSERT_EQ(0, file->FlushCloseOrErase());
+
+  ProfileCompilationInfo loaded;
+  EXPECT_FALSE(Jit::ReadWarmStartFile(warm_start_file_, &loaded));
+  EXPECT_EQ(0u, loaded.GetNumberOfMethods());
+}
+
+TEST_F(JitWarmStartTest, RejectChangedDexFile) {
+  std::unique_ptr<const DexFile> dex_file(OpenTestDexFile("ClassDependencies"));
+  ProfileCompilationInfo saved;
+  AddMethods(dex_file.get(), 0u, dex_file->NumMethodIds(), &saved);
+  ASSERT_TRUE(Jit::WriteWarmStartFile(warm_start_file_, &saved));
+
+  // The next run loads a different dex file from the same location.
+  std::string error_msg;
+  std::vector<std::unique_ptr<const DexFile>> modified_files;
+  ASSERT_TRUE(DexFile::Open(GetTestDexFileName("ClassDependenciesModified").c_str(),
+                            dex_file->GetLocation().c_str(),
+                            &error_msg,
+                            &modified_files)) << error_msg;
+  ASSERT_EQ(1u, modified_files.size());
+  const DexFile* modified = modified_files[0].get();
+  ASSERT_EQ(dex_file->GetLocation(), modified->GetLocation());
+  ASSERT_NE(dex_file->GetLocationChecksum(), modified->GetLocationChecksum());
+
+  ProfileCompilationInfo loaded;
+  ASSERT_TRUE(Jit::ReadWarmStartFile(warm_start_file_, &loaded));
+  EXPECT_TRUE(loaded.ContainsMethod(MethodReference(dex_file.get(), 0u)));
+  for (uint32_t i = 0; i != modified->NumMethodIds(); ++i) {
+    EXPECT_FALSE(loaded.ContainsMethod(MethodReference(modified, i))) << i;
+  }
+}
+
+class WriteWarmStartFileTask : public Task {
+ public:
+  WriteWarmStartFileTask(const std::string& filename,
+                         ProfileCompilationInfo* info,
+                         AtomicInteger* failures)
+      : filename_(filename), info_(info), failures_(failures) {}
+
+  void Run(Thread* self ATTRIBUTE_UNUSED) OVERRIDE {
+    if (!Jit::WriteWarmStartFile(filename_, info_)) {
+      ++*failures_;
+    }
+  }
+
+  void Finalize() OVERRIDE {
+    delete this;
+  }
+
+ private:
+  const std::string filename_;
+  ProfileCompilationInfo* const info_;
+  AtomicInteger* const failures_;
+};
+
+// The periodic save task of the JIT pool and the save at runtime shutdown may write the same
+// warm start file at the same time. Every save must leave a complete file.
+TEST_F(JitWarmStartTest, ConcurrentSaves) {
+  std::unique_ptr<const DexFile> dex_file(OpenTestDexFile("ClassDependencies"));
+  ASSERT_GT(dex_file->NumMethodIds(), 2u);
+  ProfileCompilationInfo periodic;
+  AddMethods(dex_file.get(), 0u, 1u, &periodic);
+  ProfileCompilationInfo shutdown;
+  AddMethods(dex_file.get(), 0u, 2u, &shutdown);
+
+  static constexpr size_t kNumThreads = 2;
+  static constexpr size_t kNumSaves = 200;
+  Thread* self = Thread::Current();
+  ThreadPool thread_pool("Jit warm start test thread pool", kNumThreads);
+  AtomicInteger failures(0);
+  for (size_t i = 0; i != kNumSaves; ++i) {
+    thread_pool.AddTask(
+        self, new WriteWarmStartFileTask(warm_start_file_, (i % 2 == 0) ? &periodic : &shutdown,
+                                         &failures));
+  }
+  thread_pool.StartWorkers(self);
+  // The test thread saves too, like the thread shutting down the runtime.
+  thread_pool.Wait(self, true, false);
+  EXPECT_EQ(0, failures.LoadSequentiallyConsistent());
+
+  EXPECT_EQ(std::vector<std::string>({ "warm_start.prof" }), GetScratchFiles());
+  ProfileCompilationInfo loaded;
+  ASSERT_TRUE(Jit::ReadWarmStartFile(warm_start_file_, &loaded));
+  EXPECT_TRUE(loaded.Equals(periodic) || loaded.Equals(shutdown));
+}
+
+}  // namespace jit
+}  // namespace art
@@ -22,24 +22,38 @@
 #include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
+#include <zlib.h>
 
 #include "art_method-inl.h"
+#include "base/bit_utils.h"
 #include "base/mutex.h"
 #include "base/scoped_flock.h"
 #include "base/stl_util.h"
 #include "base/systrace.h"
 #include "base/unix_file/fd_file.h"
 #include "jit/profiling_info.h"
+#include "leb128.h"
 #include "os.h"
 #include "safe_map.h"
 
 namespace art {
 
 const uint8_t ProfileCompilationInfo::kProfileMagic[] = { 'p', 'r', 'o', '\0' };
-const uint8_t ProfileCompilationInfo::kProfileVersion[] = { '0', '0', '1', '\0' };
+const uint8_t ProfileCompilationInfo::kProfileVersion[] = { '0', '0', '2', '\0' };
+const uint8_t ProfileCompilationInfo::kProfileVersionV1[] = { '0', '0', '1', '\0' };
 
 static constexpr uint16_t kMaxDexFileKeyLength = PATH_MAX;
 
+// The largest uncompressed profile data we load, far above the size of real profiles.
+static constexpr uint32_t kMaxProfileDataSize = 64 * MB;
+
+// An inline cache with more receiver classes is megamorphic, as at runtime.
+static constexpr size_t kMaxInlineCacheClasses = InlineCache::kIndividualCacheSize;
+
+// The flags of a DexPcData in the v2 format.
+static constexpr uint8_t kDexPcMissingTypes = 1u << 0;
+static constexpr uint8_t kDexPcMegamorphic = 1u << 1;
+
 // Transform the actual dex location into relative paths.
 // Note: this is OK because we don't store profiles of different apps into the same file.
 // Apps with split apks don't cause trouble because each split has a different name and will not
@@ -57,11 +71,13 @@ std::string ProfileCompilationInfo::GetProfileDexFileKey(const std::string& dex_
 
 bool ProfileCompilationInfo::AddMethodsAndClasses(
     const std::vector<MethodReference>& methods,
-    const std::set<DexCacheResolvedClasses>& resolved_classes) {
+    const std::set<DexCacheResolvedClasses>& resolved_classes,
+    uint8_t method_flags) {
   for (const MethodReference& method : methods) {
     if (!AddMethodIndex(GetProfileDexFileKey(method.dex_file->GetLocation()),
                         method.dex_file->GetLocationChecksum(),
-                        method.dex_method_index)) {
+                        method.dex_method_index,
+                        method_flags)) {
       return false;
     }
   }
@@ -73,6 +89,98 @@ bool ProfileCompilationInfo::AddMethodsAndClasses(
   return true;
 }
 
+bool ProfileCompilationInfo::AddMethods(const std::vector<ProfileMethodInfo>& methods,
+                                        uint8_t method_flags) {
+  for (const ProfileMethodInfo& method : methods) {
+    DexFileData* const data =
+        GetOrAddDexFileData(GetProfileDexFileKey(method.dex_file->GetLocation()),
+                            method.dex_file->GetLocationChecksum());
+    if (data == nullptr) {
+      return false;
+    }
+    data->AddMethodFlags(method.dex_method_index, method_flags);
+    if (!AddInlineCaches(data, method)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void SetMegamorphic(ProfileCompilationInfo::DexPcData* dex_pc_data) {
+  dex_pc_data->is_megamorphic = true;
+  dex_pc_data->classes.clear();
+}
+
+static void AddInlineCacheClass(ProfileCompilationInfo::DexPcData* dex_pc_data,
+                                const ProfileCompilationInfo::ClassReference& class_ref) {
+  if (dex_pc_data->is_megamorphic) {
+    return;
+  }
+  dex_pc_data->classes.insert(class_ref);
+  if (dex_pc_data->classes.size() > kMaxInlineCacheClasses) {
+    SetMegamorphic(dex_pc_data);
+  }
+}
+
+static ProfileCompilationInfo::DexPcData* GetOrAddDexPcData(
+    ProfileCompilationInfo::InlineCacheMap* inline_caches,
+    uint32_t dex_pc) {
+  auto it = inline_caches->find(dex_pc);
+  if (it == inline_caches->end()) {
+    it = inline_caches->Put(dex_pc, ProfileCompilationInfo::DexPcData());
+  }
+  return &it->second;
+}
+
+static ProfileCompilationInfo::InlineCacheMap* GetOrAddInlineCaches(
+    SafeMap<uint16_t, ProfileCompilationInfo::InlineCacheMap>* inline_caches,
+    uint16_t method_idx) {
+  auto it = inline_caches->find(method_idx);
+  if (it == inline_caches->end()) {
+    it = inline_caches->Put(method_idx, ProfileCompilationInfo::InlineCacheMap());
+  }
+  return &it->second;
+}
+
+bool ProfileCompilationInfo::AddInlineCaches(DexFileData* data, const ProfileMethodInfo& method) {
+  if (method.inline_caches.empty()) {
+    return true;
+  }
+  InlineCacheMap* inline_caches = GetOrAddInlineCaches(&data->inline_caches,
+                                                       method.dex_method_index);
+  for (const ProfileMethodInfo::ProfileInlineCache& cache : method.inline_caches) {
+    DexPcData* dex_pc_data = GetOrAddDexPcData(inline_caches, cache.dex_pc);
+    if (cache.is_missing_types) {
+      dex_pc_data->is_missing_types = true;
+    }
+    if (cache.is_megamorphic) {
+      SetMegamorphic(dex_pc_data);
+      continue;
+    }
+    for (const ProfileMethodInfo::ProfileClassReference& class_ref : cache.classes) {
+      const DexFileData* class_data =
+          GetOrAddDexFileData(GetProfileDexFileKey(class_ref.dex_file->GetLocation()),
+                              class_ref.dex_file->GetLocationChecksum());
+      if (class_data == nullptr) {
+        return false;
+      }
+      AddInlineCacheClass(dex_pc_data, ClassReference { class_data->profile_index,
+                                                        class_ref.type_index });
+    }
+  }
+  return true;
+}
+
+void ProfileCompilationInfo::DexFileData::AddMethodFlags(uint16_t method_idx, uint8_t flags) {
+  if (method_idx >= method_flags.size()) {
+    method_flags.resize(method_idx + 1u, 0u);
+  }
+  if (method_flags[method_idx] == 0u && flags != 0u) {
+    ++number_of_methods;
+  }
+  method_flags[method_idx] |= flags;
+}
+
 bool ProfileCompilationInfo::MergeAndSave(const std::string& filename,
                                           uint64_t* bytes_written,
                                           bool force) {
@@ -163,79 +271,162 @@ static void AddUintToBuffer(std::vector<uint8_t>* buffer, T value) {
   }
 }
 
+// The size of a line header in the v1 format.
 static constexpr size_t kLineHeaderSize =
     3 * sizeof(uint16_t) +  // method_set.size + class_set.size + dex_location.size
     sizeof(uint32_t);       // checksum
 
+// Reads a little endian uint32_t previously written with AddUintToBuffer.
+static uint32_t DecodeUint32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) |
+      (static_cast<uint32_t>(data[1]) << 8) |
+      (static_cast<uint32_t>(data[2]) << 16) |
+      (static_cast<uint32_t>(data[3]) << 24);
+}
+
 /**
- * Serialization format:
- *    magic,version,number_of_lines
- *    dex_location1,number_of_methods1,number_of_classes1,dex_location_checksum1, \
- *        method_id11,method_id12...,class_id1,class_id2...
- *    dex_location2,number_of_methods2,number_of_classes2,dex_location_checksum2, \
- *        method_id21,method_id22...,,class_id1,class_id2...
+ * Serialization format (v2):
+ *    magic,version,uncompressed_size,compressed_size,zlib compressed data
+ * optionally followed by chunks appended with AppendTo, which are merged in when loading:
+ *    uncompressed_size,compressed_size,zlib compressed data
+ * where the data is, with all the numbers except the checksums in unsigned LEB128:
+ *    number_of_dex_files
+ *    dex_location1,dex_location_checksum1
+ *    dex_location2,dex_location_checksum2
  *    .....
+ *    number_of_method_ids1,number_of_classes1,class_id_delta11,class_id_delta12..., \
+ *        hot_bitmap1,startup_bitmap1,post_startup_bitmap1, \
+ *        number_of_methods_with_inline_caches1, \
+ *        method_id11,number_of_dex_pcs11, \
+ *            dex_pc111,flags111,number_of_classes111,dex_file_index1111,type_id1111,...
+ *    .....
+ * The bitmaps have a bit per method id, a dex file index is its position in the list of dex
+ * files and each class id is written as the difference with the previous one.
  **/
 bool ProfileCompilationInfo::Save(int fd) {
   ScopedTrace trace(__PRETTY_FUNCTION__);
   DCHECK_GE(fd, 0);
 
-  // Cache at most 5KB before writing.
-  static constexpr size_t kMaxSizeToKeepBeforeWriting = 5 * KB;
-  // Use a vector wrapper to avoid keeping track of offsets when we add elements.
-  std::vector<uint8_t> buffer;
-  WriteBuffer(fd, kProfileMagic, sizeof(kProfileMagic));
-  WriteBuffer(fd, kProfileVersion, sizeof(kProfileVersion));
-  AddUintToBuffer(&buffer, static_cast<uint16_t>(info_.size()));
+  return WriteBuffer(fd, kProfileMagic, sizeof(kProfileMagic)) &&
+      WriteBuffer(fd, kProfileVersion, sizeof(kProfileVersion)) &&
+      WriteDataChunk(fd);
+}
 
-  for (const auto& it : info_) {
-    if (buffer.size() > kMaxSizeToKeepBeforeWriting) {
-      if (!WriteBuffer(fd, buffer.data(), buffer.size())) {
-        return false;
-      }
-      buffer.clear();
-    }
-    const std::string& dex_location = it.first;
-    const DexFileData& dex_data = it.second;
-    if (dex_data.method_set.empty() && dex_data.class_set.empty()) {
-      continue;
-    }
+bool ProfileCompilationInfo::AppendTo(const std::string& filename,
+                                      uint64_t expected_size,
+                                      uint64_t* bytes_written) {
+  ScopedTrace trace(__PRETTY_FUNCTION__);
+  ScopedFlock flock;
+  std::string error;
+  if (!flock.Init(filename.c_str(), O_RDWR | O_NOFOLLOW | O_CLOEXEC, /* block */ false, &error)) {
+    LOG(WARNING) << "Couldn't lock the profile file " << filename << ": " << error;
+    return false;
+  }
 
-    if (dex_location.size() >= kMaxDexFileKeyLength) {
-      LOG(WARNING) << "DexFileKey exceeds allocated limit";
-      return false;
+  int fd = flock.GetFile()->Fd();
+  struct stat stat_buffer;
+  if (fstat(fd, &stat_buffer) != 0) {
+    PLOG(WARNING) << "Could not stat the profile file " << filename;
+    return false;
+  }
+  if (static_cast<uint64_t>(stat_buffer.st_size) != expected_size) {
+    // Someone else wrote the file, its content needs to be merged with a full save.
+    VLOG(profiler) << "Not appending to the modified profile file " << filename;
+    return false;
+  }
+  if (lseek(fd, 0, SEEK_END) < 0 || !WriteDataChunk(fd)) {
+    PLOG(WARNING) << "Could not append to the profile file " << filename;
+    // Drop a partially written chunk, the file would not load anymore.
+    if (TEMP_FAILURE_RETRY(ftruncate(fd, stat_buffer.st_size)) != 0) {
+      PLOG(WARNING) << "Could not truncate the profile file " << filename;
     }
+    return false;
+  }
+  if (bytes_written != nullptr) {
+    *bytes_written = GetFileSizeBytes(filename) - expected_size;
+  }
+  return true;
+}
 
-    // Make sure that the buffer has enough capacity to avoid repeated resizings
-    // while we add data.
-    size_t required_capacity = buffer.size() +
-        kLineHeaderSize +
-        dex_location.size() +
-        sizeof(uint16_t) * (dex_data.class_set.size() + dex_data.method_set.size());
+bool ProfileCompilationInfo::WriteDataChunk(int fd) const {
+  std::vector<uint8_t> data;
+  WriteDataV2(&data);
+  if (data.size() > kMaxProfileDataSize) {
+    LOG(WARNING) << "Profile data too large: " << data.size();
+    return false;
+  }
 
-    buffer.reserve(required_capacity);
+  uLongf compressed_size = compressBound(data.size());
+  std::vector<uint8_t> compressed_data(compressed_size);
+  if (compress2(compressed_data.data(), &compressed_size, data.data(), data.size(),
+                Z_BEST_SPEED) != Z_OK) {
+    LOG(WARNING) << "Failed to compress profile data";
+    return false;
+  }
 
-    DCHECK_LE(dex_location.size(), std::numeric_limits<uint16_t>::max());
-    DCHECK_LE(dex_data.method_set.size(), std::numeric_limits<uint16_t>::max());
-    DCHECK_LE(dex_data.class_set.size(), std::numeric_limits<uint16_t>::max());
-    AddUintToBuffer(&buffer, static_cast<uint16_t>(dex_location.size()));
-    AddUintToBuffer(&buffer, static_cast<uint16_t>(dex_data.method_set.size()));
-    AddUintToBuffer(&buffer, static_cast<uint16_t>(dex_data.class_set.size()));
-    AddUintToBuffer(&buffer, dex_data.checksum);  // uint32_t
+  std::vector<uint8_t> buffer;
+  AddUintToBuffer(&buffer, static_cast<uint32_t>(data.size()));
+  AddUintToBuffer(&buffer, static_cast<uint32_t>(compressed_size));
+  return WriteBuffer(fd, buffer.data(), buffer.size()) &&
+      WriteBuffer(fd, compressed_data.data(), compressed_size);
+}
 
-    AddStringToBuffer(&buffer, dex_location);
+void ProfileCompilationInfo::WriteDataV2(/*out*/std::vector<uint8_t>* buffer) const {
+  // The dex files are written in the order of their keys, the class references of the inline
+  // caches use that order rather than the profile indexes.
+  std::vector<uint16_t> file_indexes(next_profile_index_);
+  uint16_t file_index = 0u;
+  EncodeUnsignedLeb128(buffer, info_.size());
+  for (const auto& it : info_) {
+    const std::string& dex_location = it.first;
+    const DexFileData& dex_data = it.second;
+    file_indexes[dex_data.profile_index] = file_index++;
+    EncodeUnsignedLeb128(buffer, dex_location.size());
+    AddStringToBuffer(buffer, dex_location);
+    AddUintToBuffer(buffer, dex_data.checksum);  // uint32_t
+  }
 
-    for (auto method_it : dex_data.method_set) {
-      AddUintToBuffer(&buffer, method_it);
+  for (const auto& it : info_) {
+    const DexFileData& dex_data = it.second;
+    const size_t number_of_method_ids = dex_data.method_flags.size();
+    EncodeUnsignedLeb128(buffer, number_of_method_ids);
+
+    EncodeUnsignedLeb128(buffer, dex_data.class_set.size());
+    uint16_t last_class_idx = 0u;
+    for (uint16_t class_idx : dex_data.class_set) {
+      EncodeUnsignedLeb128(buffer, class_idx - last_class_idx);
+      last_class_idx = class_idx;
     }
-    for (auto class_id : dex_data.class_set) {
-      AddUintToBuffer(&buffer, class_id);
+
+    const size_t bitmap_size = RoundUp(number_of_method_ids, kBitsPerByte) / kBitsPerByte;
+    for (size_t flag = 0; flag != kNumberOfMethodFlags; ++flag) {
+      size_t bitmap_start = buffer->size();
+      buffer->resize(bitmap_start + bitmap_size, 0u);
+      uint8_t* bitmap = buffer->data() + bitmap_start;
+      for (size_t method_idx = 0; method_idx != number_of_method_ids; ++method_idx) {
+        if ((dex_data.method_flags[method_idx] & (1u << flag)) != 0u) {
+          bitmap[method_idx / kBitsPerByte] |= 1u << (method_idx % kBitsPerByte);
+        }
+      }
     }
-    DCHECK_EQ(required_capacity, buffer.size())
-        << "Failed to add the expected number of bytes in the buffer";
-  }
 
-  return WriteBuffer(fd, buffer.data(), buffer.size());
+    EncodeUnsignedLeb128(buffer, dex_data.inline_caches.size());
+    for (const auto& method_it : dex_data.inline_caches) {
+      EncodeUnsignedLeb128(buffer, method_it.first);
+      EncodeUnsignedLeb128(buffer, method_it.second.size());
+      for (const auto& dex_pc_it : method_it.second) {
+        const DexPcData& dex_pc_data = dex_pc_it.second;
+        EncodeUnsignedLeb128(buffer, dex_pc_it.first);
+        buffer->push_back((dex_pc_data.is_missing_types ? kDexPcMissingTypes : 0u) |
+                          (dex_pc_data.is_megamorphic ? kDexPcMegamorphic : 0u));
+        EncodeUnsignedLeb128(buffer, dex_pc_data.classes.size());
+        for (const ClassReference& class_ref : dex_pc_data.classes) {
+          EncodeUnsignedLeb128(buffer, file_indexes[class_ref.dex_profile_index]);
+          EncodeUnsignedLeb128(buffer, class_ref.type_index);
+        }
+      }
+    }
+  }
 }
 
 ProfileCompilationInfo::DexFileData* ProfileCompilationInfo::GetOrAddDexFileData(
@@ -243,7 +434,11 @@ ProfileCompilationInfo::DexFileData* ProfileCompilationInfo::GetOrAddDexFileData
     uint32_t checksum) {
   auto info_it = info_.find(dex_location);
   if (info_it == info_.end()) {
-    info_it = info_.Put(dex_location, DexFileData(checksum));
+    if (next_profile_index_ == std::numeric_limits<uint16_t>::max()) {
+      LOG(WARNING) << "Too many dex files in the profile";
+      return nullptr;
+    }
+    info_it = info_.Put(dex_location, DexFileData(checksum, next_profile_index_++));
   }
   if (info_it->second.checksum != checksum) {
     LOG(WARNING) << "Checksum mismatch for dex " << dex_location;
@@ -252,6 +447,23 @@ ProfileCompilationInfo::DexFileData* ProfileCompilationInfo::GetOrAddDexFileData
   return &info_it->second;
 }
 
+const ProfileCompilationInfo::DexFileData* ProfileCompilationInfo::FindDexFileData(
+    const DexFile& dex_file) const {
+  auto info_it = info_.find(GetProfileDexFileKey(dex_file.GetLocation()));
+  if (info_it == info_.end() || info_it->second.checksum != dex_file.GetLocationChecksum()) {
+    return nullptr;
+  }
+  return &info_it->second;
+}
+
+std::vector<const std::string*> ProfileCompilationInfo::GetDexFileKeys() const {
+  std::vector<const std::string*> keys(next_profile_index_, nullptr);
+  for (const auto& it : info_) {
+    keys[it.second.profile_index] = &it.first;
+  }
+  return keys;
+}
+
 bool ProfileCompilationInfo::AddResolvedClasses(const DexCacheResolvedClasses& classes) {
   const std::string dex_location = GetProfileDexFileKey(classes.GetDexLocation());
   const uint32_t checksum = classes.GetLocationChecksum();
@@ -265,12 +477,13 @@ bool ProfileCompilationInfo::AddResolvedClasses(const DexCacheResolvedClasses& c
 
 bool ProfileCompilationInfo::AddMethodIndex(const std::string& dex_location,
                                             uint32_t checksum,
-                                            uint16_t method_idx) {
+                                            uint16_t method_idx,
+                                            uint8_t flags) {
   DexFileData* const data = GetOrAddDexFileData(dex_location, checksum);
   if (data == nullptr) {
     return false;
   }
-  data->method_set.insert(method_idx);
+  data->AddMethodFlags(method_idx, flags);
   return true;
 }
 
@@ -329,6 +542,35 @@ T ProfileCompilationInfo::SafeBuffer::ReadUintAndAdvance() {
   return value;
 }
 
+bool ProfileCompilationInfo::SafeBuffer::ReadUleb128AndAdvance(/*out*/uint32_t* value) {
+  uint32_t result = 0u;
+  for (size_t shift = 0u; shift < 32u; shift += 7u) {
+    if (ptr_current_ == ptr_end_) {
+      return false;
+    }
+    uint8_t byte = *ptr_current_++;
+    if (shift == 28u && byte > 0x0fu) {
+      return false;
+    }
+    result |= static_cast<uint32_t>(byte & 0x7fu) << shift;
+    if ((byte & 0x80u) == 0u) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ProfileCompilationInfo::SafeBuffer::ReadBytesAndAdvance(size_t size,
+                                                            /*out*/const uint8_t** data) {
+  if (static_cast<size_t>(ptr_end_ - ptr_current_) < size) {
+    return false;
+  }
+  *data = ptr_current_;
+  ptr_current_ += size;
+  return true;
+}
+
 bool ProfileCompilationInfo::SafeBuffer::CompareAndAdvance(const uint8_t* data, size_t data_size) {
   if (ptr_current_ + data_size > ptr_end_) {
     return false;
@@ -363,13 +605,12 @@ ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::SafeBuffer::Fil
 
 ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::ReadProfileHeader(
       int fd,
-      /*out*/uint16_t* number_of_lines,
+      /*out*/bool* is_v1,
       /*out*/std::string* error) {
   // Read magic and version
   const size_t kMagicVersionSize =
     sizeof(kProfileMagic) +
-    sizeof(kProfileVersion) +
-    sizeof(uint16_t);  // number of lines
+    sizeof(kProfileVersion);
 
   SafeBuffer safe_buffer(kMagicVersionSize);
 
@@ -382,11 +623,14 @@ ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::ReadProfileHead
     *error = "Profile missing magic";
     return kProfileLoadVersionMismatch;
   }
-  if (!safe_buffer.CompareAndAdvance(kProfileVersion, sizeof(kProfileVersion))) {
+  if (safe_buffer.CompareAndAdvance(kProfileVersion, sizeof(kProfileVersion))) {
+    *is_v1 = false;
+  } else if (safe_buffer.CompareAndAdvance(kProfileVersionV1, sizeof(kProfileVersionV1))) {
+    *is_v1 = true;
+  } else {
     *error = "Profile version mismatch";
     return kProfileLoadVersionMismatch;
   }
-  *number_of_lines = safe_buffer.ReadUintAndAdvance<uint16_t>();
   return kProfileLoadSuccess;
 }
 
@@ -468,6 +712,200 @@ bool ProfileCompilationInfo::Load(int fd) {
   }
 }
 
+ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::ReadProfileV1(
+      int fd, /*out*/std::string* error) {
+  SafeBuffer safe_buffer(sizeof(uint16_t));  // number of lines
+  ProfileLoadSatus status = safe_buffer.FillFromFd(fd, "ReadProfileV1", error);
+  if (status != kProfileLoadSuccess) {
+    return status;
+  }
+  uint16_t number_of_lines = safe_buffer.ReadUintAndAdvance<uint16_t>();
+
+  while (number_of_lines > 0) {
+    ProfileLineHeader line_header;
+    // First, read the line header to get the amount of data we need to read.
+    status = ReadProfileLineHeader(fd, &line_header, error);
+    if (status != kProfileLoadSuccess) {
+      return status;
+    }
+
+    // Now read the actual profile line.
+    status = ReadProfileLine(fd, line_header, error);
+    if (status != kProfileLoadSuccess) {
+      return status;
+    }
+    number_of_lines--;
+  }
+  return kProfileLoadSuccess;
+}
+
+ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::ReadProfileV2(
+      int fd, /*out*/std::string* error) {
+  SafeBuffer header_buffer(2 * sizeof(uint32_t));  // uncompressed size + compressed size
+  ProfileLoadSatus status = header_buffer.FillFromFd(fd, "ReadProfileV2", error);
+  if (status != kProfileLoadSuccess) {
+    return status;
+  }
+  uint32_t uncompressed_size = header_buffer.ReadUintAndAdvance<uint32_t>();
+  uint32_t compressed_size = header_buffer.ReadUintAndAdvance<uint32_t>();
+  if (uncompressed_size == 0u ||
+      uncompressed_size > kMaxProfileDataSize ||
+      compressed_size == 0u ||
+      compressed_size > compressBound(kMaxProfileDataSize)) {
+    *error = "Profile data has an invalid size: " + std::to_string(uncompressed_size) + " " +
+        std::to_string(compressed_size);
+    return kProfileLoadBadData;
+  }
+
+  SafeBuffer compressed_buffer(compressed_size);
+  status = compressed_buffer.FillFromFd(fd, "ReadProfileV2Data", error);
+  if (status != kProfileLoadSuccess) {
+    return status;
+  }
+  SafeBuffer data_buffer(uncompressed_size);
+  uLongf data_size = uncompressed_size;
+  if (uncompress(data_buffer.Get(), &data_size, compressed_buffer.Get(), compressed_size) !=
+          Z_OK ||
+      data_size != uncompressed_size) {
+    *error = "Failed to uncompress profile data";
+    return kProfileLoadBadData;
+  }
+  if (!ProcessDataV2(data_buffer, error)) {
+    return kProfileLoadBadData;
+  }
+  return kProfileLoadSuccess;
+}
+
+bool ProfileCompilationInfo::ProcessDataV2(SafeBuffer& buffer, /*out*/std::string* error) {
+  *error = "Bad profile data";
+  uint32_t number_of_dex_files;
+  if (!buffer.ReadUleb128AndAdvance(&number_of_dex_files) ||
+      number_of_dex_files > std::numeric_limits<uint16_t>::max()) {
+    return false;
+  }
+  // The profile indexes in this object of the dex files in the file.
+  std::vector<uint16_t> profile_indexes;
+  std::vector<DexFileData*> dex_data;
+  for (uint32_t i = 0; i != number_of_dex_files; ++i) {
+    uint32_t dex_location_size;
+    const uint8_t* dex_location;
+    const uint8_t* checksum;
+    if (!buffer.ReadUleb128AndAdvance(&dex_location_size) ||
+        dex_location_size == 0u ||
+        dex_location_size > kMaxDexFileKeyLength ||
+        !buffer.ReadBytesAndAdvance(dex_location_size, &dex_location) ||
+        !buffer.ReadBytesAndAdvance(sizeof(uint32_t), &checksum)) {
+      return false;
+    }
+    DexFileData* data = GetOrAddDexFileData(
+        std::string(reinterpret_cast<const char*>(dex_location), dex_location_size),
+        DecodeUint32(checksum));
+    if (data == nullptr) {
+      *error = "Profile checksum mismatch";
+      return false;
+    }
+    profile_indexes.push_back(data->profile_index);
+    dex_data.push_back(data);
+  }
+
+  static constexpr uint32_t kMaxIndex = std::numeric_limits<uint16_t>::max();
+  for (DexFileData* data : dex_data) {
+    uint32_t number_of_method_ids;
+    uint32_t number_of_classes;
+    if (!buffer.ReadUleb128AndAdvance(&number_of_method_ids) ||
+        number_of_method_ids > kMaxIndex + 1u ||
+        !buffer.ReadUleb128AndAdvance(&number_of_classes)) {
+      return false;
+    }
+    uint32_t class_idx = 0u;
+    for (uint32_t i = 0; i != number_of_classes; ++i) {
+      uint32_t delta;
+      if (!buffer.ReadUleb128AndAdvance(&delta) || delta > kMaxIndex - class_idx) {
+        return false;
+      }
+      class_idx += delta;
+      data->class_set.insert(class_idx);
+    }
+
+    const size_t bitmap_size = RoundUp(number_of_method_ids, kBitsPerByte) / kBitsPerByte;
+    for (size_t flag = 0; flag != kNumberOfMethodFlags; ++flag) {
+      const uint8_t* bitmap;
+      if (!buffer.ReadBytesAndAdvance(bitmap_size, &bitmap)) {
+        return false;
+      }
+      for (size_t i = 0; i != bitmap_size; ++i) {
+        for (uint32_t bits = bitmap[i]; bits != 0u; bits &= bits - 1u) {
+          size_t method_idx = i * kBitsPerByte + CTZ(bits);
+          if (method_idx >= number_of_method_ids) {
+            return false;
+          }
+          data->AddMethodFlags(method_idx, 1u << flag);
+        }
+      }
+    }
+
+    uint32_t number_of_methods_with_inline_caches;
+    if (!buffer.ReadUleb128AndAdvance(&number_of_methods_with_inline_caches)) {
+      return false;
+    }
+    for (uint32_t i = 0; i != number_of_methods_with_inline_caches; ++i) {
+      uint32_t method_idx;
+      if (!buffer.ReadUleb128AndAdvance(&method_idx) || method_idx > kMaxIndex) {
+        return false;
+      }
+      InlineCacheMap* inline_caches = GetOrAddInlineCaches(&data->inline_caches, method_idx);
+      if (!ReadInlineCachesV2(buffer, profile_indexes, inline_caches)) {
+        return false;
+      }
+    }
+  }
+  if (!buffer.IsAtEnd()) {
+    *error = "Unexpected content in the profile data";
+    return false;
+  }
+  error->clear();
+  return true;
+}
+
+bool ProfileCompilationInfo::ReadInlineCachesV2(SafeBuffer& buffer,
+                                                const std::vector<uint16_t>& profile_indexes,
+                                                /*out*/InlineCacheMap* inline_caches) {
+  uint32_t number_of_dex_pcs;
+  if (!buffer.ReadUleb128AndAdvance(&number_of_dex_pcs)) {
+    return false;
+  }
+  for (uint32_t i = 0; i != number_of_dex_pcs; ++i) {
+    uint32_t dex_pc;
+    const uint8_t* flags;
+    uint32_t number_of_classes;
+    if (!buffer.ReadUleb128AndAdvance(&dex_pc) ||
+        !buffer.ReadBytesAndAdvance(1u, &flags) ||
+        !buffer.ReadUleb128AndAdvance(&number_of_classes)) {
+      return false;
+    }
+    DexPcData* dex_pc_data = GetOrAddDexPcData(inline_caches, dex_pc);
+    if ((*flags & kDexPcMissingTypes) != 0u) {
+      dex_pc_data->is_missing_types = true;
+    }
+    if ((*flags & kDexPcMegamorphic) != 0u) {
+      SetMegamorphic(dex_pc_data);
+    }
+    for (uint32_t j = 0; j != number_of_classes; ++j) {
+      uint32_t file_index;
+      uint32_t type_idx;
+      if (!buffer.ReadUleb128AndAdvance(&file_index) ||
+          file_index >= profile_indexes.size() ||
+          !buffer.ReadUleb128AndAdvance(&type_idx) ||
+          type_idx > std::numeric_limits<uint16_t>::max()) {
+        return false;
+      }
+      AddInlineCacheClass(dex_pc_data, ClassReference { profile_indexes[file_index],
+                                                        static_cast<uint16_t>(type_idx) });
+    }
+  }
+  return true;
+}
+
 ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::LoadInternal(
       int fd, std::string* error) {
   ScopedTrace trace(__PRETTY_FUNCTION__);
@@ -483,27 +921,30 @@ ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::LoadInternal(
   if (stat_buffer.st_size == 0) {
     return kProfileLoadSuccess;
   }
-  // Read profile header: magic + version + number_of_lines.
-  uint16_t number_of_lines;
-  ProfileLoadSatus status = ReadProfileHeader(fd, &number_of_lines, error);
+  // Read profile header: magic + version.
+  bool is_v1;
+  ProfileLoadSatus status = ReadProfileHeader(fd, &is_v1, error);
   if (status != kProfileLoadSuccess) {
     return status;
   }
 
-  while (number_of_lines > 0) {
-    ProfileLineHeader line_header;
-    // First, read the line header to get the amount of data we need to read.
-    status = ReadProfileLineHeader(fd, &line_header, error);
-    if (status != kProfileLoadSuccess) {
-      return status;
+  status = is_v1 ? ReadProfileV1(fd, error) : ReadProfileV2(fd, error);
+  if (status != kProfileLoadSuccess) {
+    return status;
+  }
+  // Merge the chunks appended to a v2 profile.
+  while (!is_v1) {
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset < 0) {
+      return kProfileLoadIOError;
     }
-
-    // Now read the actual profile line.
-    status = ReadProfileLine(fd, line_header, error);
+    if (offset >= stat_buffer.st_size) {
+      break;
+    }
+    status = ReadProfileV2(fd, error);
     if (status != kProfileLoadSuccess) {
       return status;
     }
-    number_of_lines--;
   }
 
   // Check that we read everything and that profiles don't contain junk data.
@@ -530,32 +971,79 @@ bool ProfileCompilationInfo::MergeWith(const ProfileCompilationInfo& other) {
       return false;
     }
   }
-  // All checksums match. Import the data.
+  // All checksums match. Map the profile indexes of the other dex files to ours.
+  std::vector<DexFileData*> dex_data(other.next_profile_index_, nullptr);
+  for (const auto& other_it : other.info_) {
+    DexFileData* data = GetOrAddDexFileData(other_it.first, other_it.second.checksum);
+    if (data == nullptr) {
+      return false;
+    }
+    dex_data[other_it.second.profile_index] = data;
+  }
+  // Import the data.
   for (const auto& other_it : other.info_) {
-    const std::string& other_dex_location = other_it.first;
     const DexFileData& other_dex_data = other_it.second;
-    auto info_it = info_.find(other_dex_location);
-    if (info_it == info_.end()) {
-      info_it = info_.Put(other_dex_location, DexFileData(other_dex_data.checksum));
+    DexFileData* data = dex_data[other_dex_data.profile_index];
+    const std::vector<uint8_t>& other_method_flags = other_dex_data.method_flags;
+    if (data->method_flags.size() < other_method_flags.size()) {
+      data->method_flags.resize(other_method_flags.size(), 0u);
+    }
+    uint32_t number_of_methods = 0u;
+    for (size_t i = 0, size = data->method_flags.size(); i != size; ++i) {
+      if (i < other_method_flags.size()) {
+        data->method_flags[i] |= other_method_flags[i];
+      }
+      number_of_methods += (data->method_flags[i] != 0u) ? 1u : 0u;
+    }
+    data->number_of_methods = number_of_methods;
+    data->class_set.insert(other_dex_data.class_set.begin(), other_dex_data.class_set.end());
+    for (const auto& method_it : other_dex_data.inline_caches) {
+      InlineCacheMap* inline_caches = GetOrAddInlineCaches(&data->inline_caches, method_it.first);
+      for (const auto& dex_pc_it : method_it.second) {
+        const DexPcData& other_dex_pc_data = dex_pc_it.second;
+        DexPcData* dex_pc_data = GetOrAddDexPcData(inline_caches, dex_pc_it.first);
+        if (other_dex_pc_data.is_missing_types) {
+          dex_pc_data->is_missing_types = true;
+        }
+        if (other_dex_pc_data.is_megamorphic) {
+          SetMegamorphic(dex_pc_data);
+        }
+        for (const ClassReference& class_ref : other_dex_pc_data.classes) {
+          uint16_t profile_index = dex_data[class_ref.dex_profile_index]->profile_index;
+          AddInlineCacheClass(dex_pc_data, ClassReference { profile_index, class_ref.type_index });
+        }
+      }
     }
-    info_it->second.method_set.insert(other_dex_data.method_set.begin(),
-                                      other_dex_data.method_set.end());
-    info_it->second.class_set.insert(other_dex_data.class_set.begin(),
-                                     other_dex_data.class_set.end());
   }
   return true;
 }
 
 bool ProfileCompilationInfo::ContainsMethod(const MethodReference& method_ref) const {
-  auto info_it = info_.find(GetProfileDexFileKey(method_ref.dex_file->GetLocation()));
-  if (info_it != info_.end()) {
-    if (method_ref.dex_file->GetLocationChecksum() != info_it->second.checksum) {
-      return false;
+  return (GetMethodFlags(method_ref) & kMethodFlagHot) != 0u;
+}
+
+uint8_t ProfileCompilationInfo::GetMethodFlags(const MethodReference& method_ref) const {
+  const DexFileData* data = FindDexFileData(*method_ref.dex_file);
+  return (data != nullptr) ? data->GetMethodFlags(method_ref.dex_method_index) : 0u;
+}
+
+const ProfileCompilationInfo::InlineCacheMap* ProfileCompilationInfo::GetInlineCaches(
+    const MethodReference& method_ref) const {
+  const DexFileData* data = FindDexFileData(*method_ref.dex_file);
+  if (data == nullptr) {
+    return nullptr;
+  }
+  auto it = data->inline_caches.find(method_ref.dex_method_index);
+  return (it != data->inline_caches.end()) ? &it->second : nullptr;
+}
+
+const std::string* ProfileCompilationInfo::GetDexFileKey(uint16_t dex_profile_index) const {
+  for (const auto& it : info_) {
+    if (it.second.profile_index == dex_profile_index) {
+      return &it.first;
     }
-    const std::set<uint16_t>& methods = info_it->second.method_set;
-    return methods.find(method_ref.dex_method_index) != methods.end();
   }
-  return false;
+  return nullptr;
 }
 
 bool ProfileCompilationInfo::ContainsClass(const DexFile& dex_file, uint16_t class_def_idx) const {
@@ -573,7 +1061,7 @@ bool ProfileCompilationInfo::ContainsClass(const DexFile& dex_file, uint16_t cla
 uint32_t ProfileCompilationInfo::GetNumberOfMethods() const {
   uint32_t total = 0;
   for (const auto& it : info_) {
-    total += it.second.method_set.size();
+    total += it.second.number_of_methods;
   }
   return total;
 }
@@ -616,11 +1104,18 @@ std::string ProfileCompilationInfo::DumpInfo(const std::vector<const DexFile*>*
       }
     }
     os << "\n\tmethods: ";
-    for (const auto method_it : dex_data.method_set) {
+    for (size_t method_idx = 0; method_idx != dex_data.method_flags.size(); ++method_idx) {
+      uint8_t flags = dex_data.method_flags[method_idx];
+      if (flags == 0u) {
+        continue;
+      }
+      std::string flags_string = std::string((flags & kMethodFlagHot) != 0u ? "H" : "") +
+          ((flags & kMethodFlagStartup) != 0u ? "S" : "") +
+          ((flags & kMethodFlagPostStartup) != 0u ? "P" : "");
       if (dex_file != nullptr) {
-        os << "\n\t\t" << PrettyMethod(method_it, *dex_file, true);
+        os << "\n\t\t" << PrettyMethod(method_idx, *dex_file, true) << " " << flags_string;
       } else {
-        os << method_it << ",";
+        os << method_idx << ":" << flags_string << ",";
       }
     }
     os << "\n\tclasses: ";
@@ -631,12 +1126,92 @@ std::string ProfileCompilationInfo::DumpInfo(const std::vector<const DexFile*>*
         os << class_it << ",";
       }
     }
+    if (!dex_data.inline_caches.empty()) {
+      os << "\n\tinline caches: ";
+      for (const auto& method_it : dex_data.inline_caches) {
+        for (const auto& dex_pc_it : method_it.second) {
+          const DexPcData& dex_pc_data = dex_pc_it.second;
+          os << "\n\t\t" << method_it.first << "@" << dex_pc_it.first << ":";
+          if (dex_pc_data.is_missing_types) {
+            os << " missing types";
+          }
+          if (dex_pc_data.is_megamorphic) {
+            os << " megamorphic";
+          }
+          for (const ClassReference& class_ref : dex_pc_data.classes) {
+            const std::string* key = GetDexFileKey(class_ref.dex_profile_index);
+            os << " " << ((key != nullptr) ? *key : "?") << "/" << class_ref.type_index;
+          }
+        }
+      }
+    }
   }
   return os.str();
 }
 
-bool ProfileCompilationInfo::Equals(const ProfileCompilationInfo& other) {
-  return info_.Equals(other.info_);
+bool ProfileCompilationInfo::Equals(const ProfileCompilationInfo& other) const {
+  if (info_.size() != other.info_.size()) {
+    return false;
+  }
+  // The inline caches refer to the dex files by index, compare their keys instead.
+  std::vector<const std::string*> keys = GetDexFileKeys();
+  std::vector<const std::string*> other_keys = other.GetDexFileKeys();
+  auto same_classes = [&](const DexPcData& lhs, const DexPcData& rhs) {
+    if (lhs.classes.size() != rhs.classes.size()) {
+      return false;
+    }
+    std::set<std::pair<std::string, uint16_t>> classes;
+    for (const ClassReference& class_ref : lhs.classes) {
+      classes.emplace(*keys[class_ref.dex_profile_index], class_ref.type_index);
+    }
+    for (const ClassReference& class_ref : rhs.classes) {
+      if (classes.find(std::make_pair(*other_keys[class_ref.dex_profile_index],
+                                      class_ref.type_index)) == classes.end()) {
+        return false;
+      }
+    }
+    return true;
+  };
+  for (auto it = info_.begin(), other_it = other.info_.begin();
+       it != info_.end();
+       ++it, ++other_it) {
+    const DexFileData& data = it->second;
+    const DexFileData& other_data = other_it->second;
+    if (it->first != other_it->first ||
+        data.checksum != other_data.checksum ||
+        data.number_of_methods != other_data.number_of_methods ||
+        data.class_set != other_data.class_set ||
+        data.inline_caches.size() != other_data.inline_caches.size()) {
+      return false;
+    }
+    size_t max_size = std::max(data.method_flags.size(), other_data.method_flags.size());
+    for (size_t i = 0; i != max_size; ++i) {
+      if (data.GetMethodFlags(i) != other_data.GetMethodFlags(i)) {
+        return false;
+      }
+    }
+    for (auto method_it = data.inline_caches.begin(),
+              other_method_it = other_data.inline_caches.begin();
+         method_it != data.inline_caches.end();
+         ++method_it, ++other_method_it) {
+      if (method_it->first != other_method_it->first ||
+          method_it->second.size() != other_method_it->second.size()) {
+        return false;
+      }
+      for (auto dex_pc_it = method_it->second.begin(),
+                other_dex_pc_it = other_method_it->second.begin();
+           dex_pc_it != method_it->second.end();
+           ++dex_pc_it, ++other_dex_pc_it) {
+        if (dex_pc_it->first != other_dex_pc_it->first ||
+            dex_pc_it->second.is_missing_types != other_dex_pc_it->second.is_missing_types ||
+            dex_pc_it->second.is_megamorphic != other_dex_pc_it->second.is_megamorphic ||
+            !same_classes(dex_pc_it->second, other_dex_pc_it->second)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
 }
 
 std::set<DexCacheResolvedClasses> ProfileCompilationInfo::GetResolvedClasses() const {
@@ -658,4 +1233,133 @@ void ProfileCompilationInfo::ClearResolvedClasses() {
   }
 }
 
+SafeMap<std::string, uint32_t> ProfileCompilationInfo::GetDexFileChecksums() const {
+  SafeMap<std::string, uint32_t> checksums;
+  for (const auto& it : info_) {
+    checksums.Put(it.first, it.second.checksum);
+  }
+  return checksums;
+}
+
+static void IncrementCount(std::vector<uint32_t>* counts, size_t index, uint32_t increment) {
+  if (index >= counts->size()) {
+    counts->resize(index + 1u, 0u);
+  }
+  (*counts)[index] += increment;
+}
+
+static bool IsFrequent(const std::vector<uint32_t>* counts, size_t index, uint32_t min_count) {
+  return counts != nullptr && index < counts->size() && (*counts)[index] >= min_count;
+}
+
+static bool ChecksumsMatch(const ProfileCompilationInfo::ProfileCounts& counts,
+                           const std::string& dex_location,
+                           uint32_t checksum) {
+  auto it = counts.find(dex_location);
+  if (it != counts.end() && it->second.checksum != checksum) {
+    LOG(WARNING) << "Checksum mismatch for dex " << dex_location;
+    return false;
+  }
+  return true;
+}
+
+static ProfileCompilationInfo::DexFileCounts* GetOrAddDexFileCounts(
+    ProfileCompilationInfo::ProfileCounts* counts,
+    const std::string& dex_location,
+    uint32_t checksum) {
+  auto it = counts->find(dex_location);
+  if (it == counts->end()) {
+    it = counts->Put(dex_location, ProfileCompilationInfo::DexFileCounts(checksum));
+  }
+  return &it->second;
+}
+
+bool ProfileCompilationInfo::AddToCounts(ProfileCounts* counts) const {
+  for (const auto& it : info_) {
+    if (!ChecksumsMatch(*counts, it.first, it.second.checksum)) {
+      return false;
+    }
+  }
+  for (const auto& it : info_) {
+    const DexFileData& data = it.second;
+    DexFileCounts* dex_counts = GetOrAddDexFileCounts(counts, it.first, data.checksum);
+    for (size_t i = 0, size = data.method_flags.size(); i != size; ++i) {
+      if (data.method_flags[i] != 0u) {
+        IncrementCount(&dex_counts->methods, i, 1u);
+      }
+    }
+    for (uint16_t class_idx : data.class_set) {
+      IncrementCount(&dex_counts->classes, class_idx, 1u);
+    }
+  }
+  return true;
+}
+
+bool ProfileCompilationInfo::MergeCounts(const ProfileCounts& other, ProfileCounts* counts) {
+  for (const auto& it : other) {
+    if (!ChecksumsMatch(*counts, it.first, it.second.checksum)) {
+      return false;
+    }
+  }
+  for (const auto& it : other) {
+    const DexFileCounts& other_counts = it.second;
+    DexFileCounts* dex_counts = GetOrAddDexFileCounts(counts, it.first, other_counts.checksum);
+    for (size_t i = 0, size = other_counts.methods.size(); i != size; ++i) {
+      if (other_counts.methods[i] != 0u) {
+        IncrementCount(&dex_counts->methods, i, other_counts.methods[i]);
+      }
+    }
+    for (size_t i = 0, size = other_counts.classes.size(); i != size; ++i) {
+      if (other_counts.classes[i] != 0u) {
+        IncrementCount(&dex_counts->classes, i, other_counts.classes[i]);
+      }
+    }
+  }
+  return true;
+}
+
+void ProfileCompilationInfo::RetainFrequent(const ProfileCounts& counts, uint32_t min_count) {
+  for (auto& it : info_) {
+    DexFileData& data = it.second;
+    auto counts_it = counts.find(it.first);
+    const DexFileCounts* dex_counts =
+        (counts_it != counts.end() && counts_it->second.checksum == data.checksum)
+            ? &counts_it->second
+            : nullptr;
+    const std::vector<uint32_t>* method_counts =
+        (dex_counts != nullptr) ? &dex_counts->methods : nullptr;
+    const std::vector<uint32_t>* class_counts =
+        (dex_counts != nullptr) ? &dex_counts->classes : nullptr;
+
+    uint32_t number_of_methods = 0u;
+    size_t method_flags_size = 0u;
+    for (size_t i = 0, size = data.method_flags.size(); i != size; ++i) {
+      if (data.method_flags[i] != 0u) {
+        if (IsFrequent(method_counts, i, min_count)) {
+          ++number_of_methods;
+          method_flags_size = i + 1u;
+        } else {
+          data.method_flags[i] = 0u;
+        }
+      }
+    }
+    data.method_flags.resize(method_flags_size);
+    data.number_of_methods = number_of_methods;
+    for (auto method_it = data.inline_caches.begin(); method_it != data.inline_caches.end(); ) {
+      if (data.GetMethodFlags(method_it->first) == 0u) {
+        method_it = data.inline_caches.erase(method_it);
+      } else {
+        ++method_it;
+      }
+    }
+    for (auto class_it = data.class_set.begin(); class_it != data.class_set.end(); ) {
+      if (IsFrequent(class_counts, *class_it, min_count)) {
+        ++class_it;
+      } else {
+        class_it = data.class_set.erase(class_it);
+      }
+    }
+  }
+}
+
 }  // namespace art
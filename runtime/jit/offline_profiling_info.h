@@ -28,22 +28,99 @@
 
 namespace art {
 
+/**
+ * The profile of a method collected at runtime: the method and the receiver classes seen
+ * by its inline caches.
+ */
+struct ProfileMethodInfo {
+  struct ProfileClassReference {
+    const DexFile* dex_file;
+    uint16_t type_index;
+  };
+
+  struct ProfileInlineCache {
+    uint32_t dex_pc;
+    // Some receiver classes could not be recorded, e.g. array classes or classes of
+    // dex files that are not profiled.
+    bool is_missing_types;
+    bool is_megamorphic;
+    std::vector<ProfileClassReference> classes;
+  };
+
+  ProfileMethodInfo(const DexFile* dex, uint32_t method_index)
+      : dex_file(dex), dex_method_index(method_index) {}
+
+  const DexFile* dex_file;
+  uint32_t dex_method_index;
+  std::vector<ProfileInlineCache> inline_caches;
+};
+
 // TODO: rename file.
 /**
  * Profile information in a format suitable to be queried by the compiler and
  * performing profile guided compilation.
  * It is a serialize-friendly format based on information collected by the
  * interpreter (ProfileInfo).
- * Currently it stores only the hot compiled methods.
+ * It stores the methods with flags telling how they were used, the resolved
+ * classes and the receiver classes seen by the inline caches of the methods.
  */
 class ProfileCompilationInfo {
  public:
   static const uint8_t kProfileMagic[];
   static const uint8_t kProfileVersion[];
+  // The first version, with only lists of methods and classes. It can still be loaded.
+  static const uint8_t kProfileVersionV1[];
+
+  // How a method was used. A method may have several flags.
+  enum MethodFlag : uint8_t {
+    kMethodFlagHot = 1u << 0,
+    kMethodFlagStartup = 1u << 1,
+    kMethodFlagPostStartup = 1u << 2,
+  };
+  static constexpr size_t kNumberOfMethodFlags = 3u;
+
+  // A receiver class of an inline cache, as the index of its dex file in the profile
+  // and its type index.
+  struct ClassReference {
+    uint16_t dex_profile_index;
+    uint16_t type_index;
+
+    bool operator<(const ClassReference& other) const {
+      return (dex_profile_index == other.dex_profile_index)
+          ? type_index < other.type_index
+          : dex_profile_index < other.dex_profile_index;
+    }
+  };
+
+  // The receiver classes seen at a call site.
+  struct DexPcData {
+    bool is_missing_types = false;
+    bool is_megamorphic = false;
+    std::set<ClassReference> classes;
+  };
+
+  // The inline caches of a method, by dex pc.
+  using InlineCacheMap = SafeMap<uint32_t, DexPcData>;
+
+  // The number of profiles that contain each method and class of a dex file, used to keep only
+  // the frequent ones when aggregating many profiles.
+  struct DexFileCounts {
+    explicit DexFileCounts(uint32_t location_checksum) : checksum(location_checksum) {}
+    uint32_t checksum;
+    // By method index and by class def index. The vectors only grow as far as needed.
+    std::vector<uint32_t> methods;
+    std::vector<uint32_t> classes;
+  };
+
+  // The counts of the dex files, by profile key.
+  using ProfileCounts = SafeMap<std::string, DexFileCounts>;
 
   // Add the given methods and classes to the current profile object.
   bool AddMethodsAndClasses(const std::vector<MethodReference>& methods,
-                            const std::set<DexCacheResolvedClasses>& resolved_classes);
+                            const std::set<DexCacheResolvedClasses>& resolved_classes,
+                            uint8_t method_flags = kMethodFlagHot);
+  // Add the given methods with `method_flags` and their inline caches.
+  bool AddMethods(const std::vector<ProfileMethodInfo>& methods, uint8_t method_flags);
   // Loads profile information from the given file descriptor.
   bool Load(int fd);
   // Merge the data from another ProfileCompilationInfo into the current object.
@@ -56,15 +133,29 @@ class ProfileCompilationInfo {
   // has bad data or its version does not match. In this cases the profile content
   // is ignored.
   bool MergeAndSave(const std::string& filename, uint64_t* bytes_written, bool force);
+  // Appends the profile data to the given file, where it is merged with the previous content
+  // when loading. Nothing is written if the file size is not `expected_size`, the size it had
+  // after the last save of this process, as the file has then been written by someone else.
+  bool AppendTo(const std::string& filename, uint64_t expected_size, uint64_t* bytes_written);
 
   // Returns the number of methods that were profiled.
   uint32_t GetNumberOfMethods() const;
   // Returns the number of resolved classes that were profiled.
   uint32_t GetNumberOfResolvedClasses() const;
 
-  // Returns true if the method reference is present in the profiling info.
+  // Returns true if the method reference is present in the profiling info as a hot method.
   bool ContainsMethod(const MethodReference& method_ref) const;
 
+  // Returns the MethodFlag flags of the method, 0 if the method is not in the profile.
+  uint8_t GetMethodFlags(const MethodReference& method_ref) const;
+
+  // Returns the inline caches of the method, or null if none were recorded. The dex files of
+  // the receiver classes are found with GetDexFileKey().
+  const InlineCacheMap* GetInlineCaches(const MethodReference& method_ref) const;
+
+  // Returns the profile key of the dex file with the given index, or null.
+  const std::string* GetDexFileKey(uint16_t dex_profile_index) const;
+
   // Returns true if the class is present in the profiling info.
   bool ContainsClass(const DexFile& dex_file, uint16_t class_def_idx) const;
 
@@ -75,7 +166,8 @@ class ProfileCompilationInfo {
   std::string DumpInfo(const std::vector<const DexFile*>* dex_files,
                        bool print_full_dex_location = true) const;
 
-  bool Equals(const ProfileCompilationInfo& other);
+  // Returns true if both profiles have the same content, whatever the indexes of their dex files.
+  bool Equals(const ProfileCompilationInfo& other) const;
 
   static std::string GetProfileDexFileKey(const std::string& dex_location);
 
@@ -87,6 +179,20 @@ class ProfileCompilationInfo {
   // Clears the resolved classes from the current object.
   void ClearResolvedClasses();
 
+  // Returns the location checksums of the dex files, by profile key.
+  SafeMap<std::string, uint32_t> GetDexFileChecksums() const;
+
+  // Count the methods and classes of this profile in `counts`. Returns false, leaving `counts`
+  // unchanged, if a dex file has a different checksum in `counts`.
+  bool AddToCounts(ProfileCounts* counts) const;
+
+  // Add the counts of `other` to `counts`, with the same checksum check as AddToCounts().
+  static bool MergeCounts(const ProfileCounts& other, ProfileCounts* counts);
+
+  // Remove the methods, with their inline caches, and the classes that are in fewer than
+  // `min_count` profiles according to `counts`.
+  void RetainFrequent(const ProfileCounts& counts, uint32_t min_count);
+
  private:
   enum ProfileLoadSatus {
     kProfileLoadIOError,
@@ -96,22 +202,38 @@ class ProfileCompilationInfo {
   };
 
   struct DexFileData {
-    explicit DexFileData(uint32_t location_checksum) : checksum(location_checksum) {}
+    DexFileData(uint32_t location_checksum, uint16_t index)
+        : checksum(location_checksum), profile_index(index), number_of_methods(0u) {}
     uint32_t checksum;
-    std::set<uint16_t> method_set;
+    // The index of the dex file in the profile, used by the class references of the inline
+    // caches. Two profiles may give different indexes to the same dex file.
+    uint16_t profile_index;
+    // The MethodFlag flags of the methods, by method index, and the number of methods with
+    // flags. The vector only grows as far as the largest profiled method index.
+    std::vector<uint8_t> method_flags;
+    uint32_t number_of_methods;
     std::set<uint16_t> class_set;
+    SafeMap<uint16_t, InlineCacheMap> inline_caches;
 
-    bool operator==(const DexFileData& other) const {
-      return checksum == other.checksum && method_set == other.method_set;
+    void AddMethodFlags(uint16_t method_idx, uint8_t flags);
+    uint8_t GetMethodFlags(uint16_t method_idx) const {
+      return (method_idx < method_flags.size()) ? method_flags[method_idx] : 0u;
     }
   };
 
   using DexFileToProfileInfoMap = SafeMap<const std::string, DexFileData>;
 
   DexFileData* GetOrAddDexFileData(const std::string& dex_location, uint32_t checksum);
-  bool AddMethodIndex(const std::string& dex_location, uint32_t checksum, uint16_t method_idx);
+  const DexFileData* FindDexFileData(const DexFile& dex_file) const;
+  // Returns the profile keys of the dex files by DexFileData::profile_index.
+  std::vector<const std::string*> GetDexFileKeys() const;
+  bool AddMethodIndex(const std::string& dex_location,
+                      uint32_t checksum,
+                      uint16_t method_idx,
+                      uint8_t flags = kMethodFlagHot);
   bool AddClassIndex(const std::string& dex_location, uint32_t checksum, uint16_t class_idx);
   bool AddResolvedClasses(const DexCacheResolvedClasses& classes);
+  bool AddInlineCaches(DexFileData* data, const ProfileMethodInfo& method);
 
   // Parsing functionality.
 
@@ -130,6 +252,8 @@ class ProfileCompilationInfo {
       ptr_end_ = ptr_current_ + size;
     }
 
+    size_t Size() const { return ptr_end_ - storage_.get(); }
+
     // Reads the content of the descriptor at the current position.
     ProfileLoadSatus FillFromFd(int fd,
                                 const std::string& source,
@@ -139,15 +263,24 @@ class ProfileCompilationInfo {
     // with the number of bits read.
     template <typename T> T ReadUintAndAdvance();
 
+    // Reads an unsigned LEB128 value. Returns false if it does not fit in the buffer or in
+    // the uint32_t.
+    bool ReadUleb128AndAdvance(/*out*/uint32_t* value);
+
+    // Reads `size` bytes. Returns false if there are fewer bytes left.
+    bool ReadBytesAndAdvance(size_t size, /*out*/const uint8_t** data);
+
     // Compares the given data with the content current pointer. If the contents are
     // equal it advances the current pointer by data_size.
     bool CompareAndAdvance(const uint8_t* data, size_t data_size);
 
+    bool IsAtEnd() const { return ptr_current_ == ptr_end_; }
+
     // Get the underlying raw buffer.
     uint8_t* Get() { return storage_.get(); }
 
    private:
-    std::unique_ptr<uint8_t> storage_;
+    std::unique_ptr<uint8_t[]> storage_;
     uint8_t* ptr_current_;
     uint8_t* ptr_end_;
   };
@@ -155,9 +288,19 @@ class ProfileCompilationInfo {
   ProfileLoadSatus LoadInternal(int fd, std::string* error);
 
   ProfileLoadSatus ReadProfileHeader(int fd,
-                                     /*out*/uint16_t* number_of_lines,
+                                     /*out*/bool* is_v1,
                                      /*out*/std::string* error);
 
+  ProfileLoadSatus ReadProfileV1(int fd, /*out*/std::string* error);
+  ProfileLoadSatus ReadProfileV2(int fd, /*out*/std::string* error);
+  bool ProcessDataV2(SafeBuffer& buffer, /*out*/std::string* error);
+  bool ReadInlineCachesV2(SafeBuffer& buffer,
+                          const std::vector<uint16_t>& profile_indexes,
+                          /*out*/InlineCacheMap* inline_caches);
+  void WriteDataV2(/*out*/std::vector<uint8_t>* buffer) const;
+  // Writes the sizes and the compressed data of the v2 format.
+  bool WriteDataChunk(int fd) const;
+
   ProfileLoadSatus ReadProfileLineHeader(int fd,
                                          /*out*/ProfileLineHeader* line_header,
                                          /*out*/std::string* error);
@@ -176,6 +319,8 @@ class ProfileCompilationInfo {
   friend class ProfileAssistantTest;
 
   DexFileToProfileInfoMap info_;
+  // The number of dex files ever added, the next DexFileData::profile_index.
+  uint16_t next_profile_index_ = 0u;
 };
 
 }  // namespace art
@@ -26,6 +26,7 @@
 #include "mirror/class_loader.h"
 #include "handle_scope-inl.h"
 #include "jit/offline_profiling_info.h"
+#include "jit/profiling_info.h"
 #include "scoped_thread_state_change.h"
 
 namespace art {
@@ -57,11 +58,73 @@ class ProfileCompilationInfoTest : public CommonRuntimeTest {
     return info->AddMethodIndex(dex_location, checksum, method_index);
   }
 
+  bool AddMethodWithFlags(const std::string& dex_location,
+                          uint32_t checksum,
+                          uint16_t method_index,
+                          uint8_t flags,
+                          ProfileCompilationInfo* info) {
+    return info->AddMethodIndex(dex_location, checksum, method_index, flags);
+  }
+
+  // Record that the receiver of the call at `dex_pc` was of type `type_index` of the dex file
+  // `class_location`.
+  bool AddInlineCacheClass(const std::string& dex_location,
+                           uint32_t checksum,
+                           uint16_t method_index,
+                           uint32_t dex_pc,
+                           const std::string& class_location,
+                           uint32_t class_checksum,
+                           uint16_t type_index,
+                           ProfileCompilationInfo* info) {
+    ProfileCompilationInfo::DexFileData* class_data =
+        info->GetOrAddDexFileData(class_location, class_checksum);
+    ProfileCompilationInfo::DexFileData* data = info->GetOrAddDexFileData(dex_location, checksum);
+    if (class_data == nullptr || data == nullptr) {
+      return false;
+    }
+    auto method_it = data->inline_caches.find(method_index);
+    if (method_it == data->inline_caches.end()) {
+      method_it = data->inline_caches.Put(method_index, ProfileCompilationInfo::InlineCacheMap());
+    }
+    auto dex_pc_it = method_it->second.find(dex_pc);
+    if (dex_pc_it == method_it->second.end()) {
+      dex_pc_it = method_it->second.Put(dex_pc, ProfileCompilationInfo::DexPcData());
+    }
+    dex_pc_it->second.classes.insert(
+        ProfileCompilationInfo::ClassReference { class_data->profile_index, type_index });
+    return true;
+  }
+
   bool AddClass(const std::string& dex_location,
                 uint32_t checksum,
                 uint16_t class_index,
                 ProfileCompilationInfo* info) {
-    return info->AddMethodIndex(dex_location, checksum, class_index);
+    return info->AddClassIndex(dex_location, checksum, class_index);
+  }
+
+  uint8_t GetMethodFlags(const std::string& dex_location,
+                         uint32_t checksum,
+                         uint16_t method_index,
+                         ProfileCompilationInfo* info) {
+    ProfileCompilationInfo::DexFileData* data = info->GetOrAddDexFileData(dex_location, checksum);
+    return (data != nullptr) ? data->GetMethodFlags(method_index) : 0u;
+  }
+
+  const ProfileCompilationInfo::DexPcData* GetDexPcData(const std::string& dex_location,
+                                                        uint32_t checksum,
+                                                        uint16_t method_index,
+                                                        uint32_t dex_pc,
+                                                        ProfileCompilationInfo* info) {
+    ProfileCompilationInfo::DexFileData* data = info->GetOrAddDexFileData(dex_location, checksum);
+    if (data == nullptr) {
+      return nullptr;
+    }
+    auto method_it = data->inline_caches.find(method_index);
+    if (method_it == data->inline_caches.end()) {
+      return nullptr;
+    }
+    auto dex_pc_it = method_it->second.find(dex_pc);
+    return (dex_pc_it != method_it->second.end()) ? &dex_pc_it->second : nullptr;
   }
 
   uint32_t GetFd(const ScratchFile& file) {
@@ -271,7 +334,7 @@ TEST_F(ProfileCompilationInfoTest, Incomplete) {
   ASSERT_TRUE(profile.GetFile()->WriteFully(
       ProfileCompilationInfo::kProfileMagic, kProfileMagicSize));
   ASSERT_TRUE(profile.GetFile()->WriteFully(
-      ProfileCompilationInfo::kProfileVersion, kProfileVersionSize));
+      ProfileCompilationInfo::kProfileVersionV1, kProfileVersionSize));
   // Write that we have at least one line.
   uint8_t line_number[] = { 0, 1 };
   ASSERT_TRUE(profile.GetFile()->WriteFully(line_number, sizeof(line_number)));
@@ -287,7 +350,7 @@ TEST_F(ProfileCompilationInfoTest, TooLongDexLocation) {
   ASSERT_TRUE(profile.GetFile()->WriteFully(
       ProfileCompilationInfo::kProfileMagic, kProfileMagicSize));
   ASSERT_TRUE(profile.GetFile()->WriteFully(
-      ProfileCompilationInfo::kProfileVersion, kProfileVersionSize));
+      ProfileCompilationInfo::kProfileVersionV1, kProfileVersionSize));
   // Write that we have at least one line.
   uint8_t line_number[] = { 0, 1 };
   ASSERT_TRUE(profile.GetFile()->WriteFully(line_number, sizeof(line_number)));
@@ -324,4 +387,198 @@ TEST_F(ProfileCompilationInfoTest, UnexpectedContent) {
   ASSERT_FALSE(loaded_info.Load(GetFd(profile)));
 }
 
+TEST_F(ProfileCompilationInfoTest, SaveMethodFlagsAndInlineCaches) {
+  ScratchFile profile;
+
+  ProfileCompilationInfo saved_info;
+  for (uint16_t i = 0; i < 10; i++) {
+    ASSERT_TRUE(AddMethodWithFlags("dex_location1", /* checksum */ 1, /* method_idx */ i,
+                                   ProfileCompilationInfo::kMethodFlagStartup, &saved_info));
+    ASSERT_TRUE(AddMethodWithFlags("dex_location2", /* checksum */ 2, /* method_idx */ 2 * i,
+                                   ProfileCompilationInfo::kMethodFlagHot |
+                                       ProfileCompilationInfo::kMethodFlagPostStartup,
+                                   &saved_info));
+  }
+  ASSERT_TRUE(AddInlineCacheClass("dex_location1", /* checksum */ 1, /* method_idx */ 3,
+                                  /* dex_pc */ 7, "dex_location2", /* checksum */ 2,
+                                  /* type_idx */ 11, &saved_info));
+  ASSERT_TRUE(AddInlineCacheClass("dex_location1", /* checksum */ 1, /* method_idx */ 3,
+                                  /* dex_pc */ 7, "dex_location3", /* checksum */ 3,
+                                  /* type_idx */ 12, &saved_info));
+  ASSERT_TRUE(saved_info.Save(GetFd(profile)));
+  ASSERT_EQ(0, profile.GetFile()->Flush());
+
+  // Check that we get back what we saved.
+  ProfileCompilationInfo loaded_info;
+  ASSERT_TRUE(profile.GetFile()->ResetOffset());
+  ASSERT_TRUE(loaded_info.Load(GetFd(profile)));
+  ASSERT_TRUE(loaded_info.Equals(saved_info));
+  ASSERT_EQ(20u, loaded_info.GetNumberOfMethods());
+
+  // The startup methods are not hot.
+  ASSERT_EQ(ProfileCompilationInfo::kMethodFlagStartup,
+            GetMethodFlags("dex_location1", /* checksum */ 1, /* method_idx */ 3, &loaded_info));
+  ASSERT_EQ(0u, GetMethodFlags("dex_location1", /* checksum */ 1, /* method_idx */ 10,
+                               &loaded_info));
+  ASSERT_EQ(ProfileCompilationInfo::kMethodFlagHot | ProfileCompilationInfo::kMethodFlagPostStartup,
+            GetMethodFlags("dex_location2", /* checksum */ 2, /* method_idx */ 18, &loaded_info));
+  ASSERT_EQ(0u, GetMethodFlags("dex_location2", /* checksum */ 2, /* method_idx */ 17,
+                               &loaded_info));
+
+  // The inline cache refers to the classes of the other dex files.
+  const ProfileCompilationInfo::DexPcData* dex_pc_data =
+      GetDexPcData("dex_location1", /* checksum */ 1, /* method_idx */ 3, /* dex_pc */ 7,
+                   &loaded_info);
+  ASSERT_TRUE(dex_pc_data != nullptr);
+  ASSERT_FALSE(dex_pc_data->is_megamorphic);
+  ASSERT_EQ(2u, dex_pc_data->classes.size());
+  for (const ProfileCompilationInfo::ClassReference& class_ref : dex_pc_data->classes) {
+    const std::string* key = loaded_info.GetDexFileKey(class_ref.dex_profile_index);
+    ASSERT_TRUE(key != nullptr);
+    ASSERT_EQ((*key == "dex_location2") ? 11u : 12u, class_ref.type_index);
+  }
+}
+
+TEST_F(ProfileCompilationInfoTest, MergeInlineCaches) {
+  ProfileCompilationInfo info1;
+  ProfileCompilationInfo info2;
+  // Add the dex files in a different order so that they get different profile indexes.
+  for (uint16_t i = 0; i < InlineCache::kIndividualCacheSize; i++) {
+    ASSERT_TRUE(AddInlineCacheClass("dex_location1", /* checksum */ 1, /* method_idx */ 1,
+                                    /* dex_pc */ 0, "dex_location2", /* checksum */ 2,
+                                    /* type_idx */ i, &info1));
+  }
+  ASSERT_TRUE(AddMethod("dex_location2", /* checksum */ 2, /* method_idx */ 1, &info2));
+  ASSERT_TRUE(AddInlineCacheClass("dex_location1", /* checksum */ 1, /* method_idx */ 1,
+                                  /* dex_pc */ 0, "dex_location2", /* checksum */ 2,
+                                  /* type_idx */ 0, &info2));
+  ASSERT_TRUE(AddInlineCacheClass("dex_location1", /* checksum */ 1, /* method_idx */ 1,
+                                  /* dex_pc */ 4, "dex_location2", /* checksum */ 2,
+                                  /* type_idx */ 0, &info2));
+
+  // Merging a class already seen keeps the inline cache polymorphic.
+  ProfileCompilationInfo merged;
+  ASSERT_TRUE(merged.MergeWith(info1));
+  ASSERT_TRUE(merged.MergeWith(info2));
+  const ProfileCompilationInfo::DexPcData* dex_pc_data0 =
+      GetDexPcData("dex_location1", /* checksum */ 1, /* method_idx */ 1, /* dex_pc */ 0, &merged);
+  const ProfileCompilationInfo::DexPcData* dex_pc_data4 =
+      GetDexPcData("dex_location1", /* checksum */ 1, /* method_idx */ 1, /* dex_pc */ 4, &merged);
+  ASSERT_TRUE(dex_pc_data0 != nullptr);
+  ASSERT_TRUE(dex_pc_data4 != nullptr);
+  ASSERT_FALSE(dex_pc_data0->is_megamorphic);
+  ASSERT_EQ(static_cast<size_t>(InlineCache::kIndividualCacheSize), dex_pc_data0->classes.size());
+  ASSERT_EQ(1u, dex_pc_data4->classes.size());
+
+  // One more class makes it megamorphic.
+  ASSERT_TRUE(AddInlineCacheClass("dex_location1", /* checksum */ 1, /* method_idx */ 1,
+                                  /* dex_pc */ 0, "dex_location2", /* checksum */ 2,
+                                  /* type_idx */ InlineCache::kIndividualCacheSize, &info2));
+  ASSERT_TRUE(merged.MergeWith(info2));
+  ASSERT_TRUE(dex_pc_data0->is_megamorphic);
+  ASSERT_TRUE(dex_pc_data0->classes.empty());
+}
+
+TEST_F(ProfileCompilationInfoTest, LoadV1) {
+  ScratchFile profile;
+  ASSERT_TRUE(profile.GetFile()->WriteFully(
+      ProfileCompilationInfo::kProfileMagic, kProfileMagicSize));
+  ASSERT_TRUE(profile.GetFile()->WriteFully(
+      ProfileCompilationInfo::kProfileVersionV1, kProfileVersionSize));
+  // One line with two methods and one class.
+  uint8_t line[] = { 1, 0,
+                     4, 0, 2, 0, 1, 0, 7, 0, 0, 0,
+                     'd', 'e', 'x', '1',
+                     3, 0, 4, 0,
+                     9, 0 };
+  ASSERT_TRUE(profile.GetFile()->WriteFully(line, sizeof(line)));
+  ASSERT_EQ(0, profile.GetFile()->Flush());
+
+  ProfileCompilationInfo loaded_info;
+  ASSERT_TRUE(profile.GetFile()->ResetOffset());
+  ASSERT_TRUE(loaded_info.Load(GetFd(profile)));
+
+  // The v1 methods are hot.
+  ProfileCompilationInfo expected_info;
+  ASSERT_TRUE(AddMethod("dex1", /* checksum */ 7, /* method_idx */ 3, &expected_info));
+  ASSERT_TRUE(AddMethod("dex1", /* checksum */ 7, /* method_idx */ 4, &expected_info));
+  ASSERT_TRUE(AddClass("dex1", /* checksum */ 7, /* class_idx */ 9, &expected_info));
+  ASSERT_TRUE(loaded_info.Equals(expected_info));
+}
+
+TEST_F(ProfileCompilationInfoTest, RetainFrequent) {
+  // Method 1 and class 1 are in both profiles, the others in one.
+  ProfileCompilationInfo info1;
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 1, &info1));
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 2, &info1));
+  ASSERT_TRUE(AddClass("dex_location1", /* checksum */ 1, /* class_idx */ 1, &info1));
+  ASSERT_TRUE(AddInlineCacheClass("dex_location1", 1, /* method_idx */ 2, /* dex_pc */ 3,
+                                  "dex_location1", 1, /* type_index */ 4, &info1));
+  ProfileCompilationInfo info2;
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 1, &info2));
+  ASSERT_TRUE(AddMethod("dex_location2", /* checksum */ 2, /* method_idx */ 3, &info2));
+  ASSERT_TRUE(AddClass("dex_location1", /* checksum */ 1, /* class_idx */ 1, &info2));
+  ASSERT_TRUE(AddClass("dex_location1", /* checksum */ 1, /* class_idx */ 2, &info2));
+
+  ProfileCompilationInfo::ProfileCounts counts1;
+  ASSERT_TRUE(info1.AddToCounts(&counts1));
+  ProfileCompilationInfo::ProfileCounts counts;
+  ASSERT_TRUE(info2.AddToCounts(&counts));
+  ASSERT_TRUE(ProfileCompilationInfo::MergeCounts(counts1, &counts));
+
+  // A profile with another checksum cannot be counted.
+  ProfileCompilationInfo mismatched_info;
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 2, /* method_idx */ 1, &mismatched_info));
+  ASSERT_FALSE(mismatched_info.AddToCounts(&counts));
+
+  ProfileCompilationInfo info;
+  ASSERT_TRUE(info.MergeWith(info1));
+  ASSERT_TRUE(info.MergeWith(info2));
+  info.RetainFrequent(counts, /* min_count */ 2u);
+
+  ASSERT_EQ(1u, info.GetNumberOfMethods());
+  ASSERT_EQ(1u, info.GetNumberOfResolvedClasses());
+  ASSERT_EQ(ProfileCompilationInfo::kMethodFlagHot,
+            GetMethodFlags("dex_location1", /* checksum */ 1, /* method_idx */ 1, &info));
+  ASSERT_EQ(0u, GetMethodFlags("dex_location1", /* checksum */ 1, /* method_idx */ 2, &info));
+  ASSERT_EQ(0u, GetMethodFlags("dex_location2", /* checksum */ 2, /* method_idx */ 3, &info));
+  ASSERT_TRUE(GetDexPcData("dex_location1", 1, /* method_idx */ 2, /* dex_pc */ 3, &info) ==
+              nullptr);
+}
+
+TEST_F(ProfileCompilationInfoTest, AppendTo) {
+  ScratchFile profile;
+
+  ProfileCompilationInfo saved_info;
+  for (uint16_t i = 0; i < 10; i++) {
+    ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ i, &saved_info));
+  }
+  ASSERT_TRUE(saved_info.Save(GetFd(profile)));
+  ASSERT_EQ(0, profile.GetFile()->Flush());
+  uint64_t file_size = GetFileSizeBytes(profile.GetFilename());
+
+  // Append a delta with new methods, and a method already in the file.
+  ProfileCompilationInfo delta;
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 5, &delta));
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 20, &delta));
+  ASSERT_TRUE(AddMethod("dex_location2", /* checksum */ 2, /* method_idx */ 3, &delta));
+  uint64_t bytes_written = 0;
+  ASSERT_TRUE(delta.AppendTo(profile.GetFilename(), file_size, &bytes_written));
+  ASSERT_GT(bytes_written, 0u);
+  file_size += bytes_written;
+  ASSERT_EQ(static_cast<int64_t>(file_size), GetFileSizeBytes(profile.GetFilename()));
+
+  // The loaded profile is the merge of the saved profile and the delta.
+  ASSERT_TRUE(saved_info.MergeWith(delta));
+  ProfileCompilationInfo loaded_info;
+  ASSERT_TRUE(profile.GetFile()->ResetOffset());
+  ASSERT_TRUE(loaded_info.Load(GetFd(profile)));
+  ASSERT_TRUE(loaded_info.Equals(saved_info));
+  ASSERT_EQ(12u, loaded_info.GetNumberOfMethods());
+
+  // Nothing is appended to a file which changed since the last save.
+  ASSERT_FALSE(delta.AppendTo(profile.GetFilename(), file_size - 1, &bytes_written));
+  ASSERT_EQ(static_cast<int64_t>(file_size), GetFileSizeBytes(profile.GetFilename()));
+}
+
 }  // namespace art
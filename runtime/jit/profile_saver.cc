@@ -26,6 +26,7 @@
 #include "compiler_filter.h"
 #include "oat_file_manager.h"
 #include "scoped_thread_state_change.h"
+#include "utils.h"
 
 
 namespace art {
@@ -43,6 +44,16 @@ static constexpr const uint32_t kMinimumNumberOfClassesToSave = 10;
 static constexpr const uint32_t kMinimumNumberOfNotificationBeforeWake =
     kMinimumNumberOfMethodsToSave;
 static constexpr const uint32_t kMaximumNumberOfNotificationBeforeWake = 50;
+// The new methods are appended to a profile file at most this number of times in a row, after
+// which the file is rewritten to merge the appended deltas.
+static constexpr const uint32_t kMaximumNumberOfAppends = 8;
+// The new methods are merged into the file rather than appended when they are more than this
+// fraction of the methods of the profile.
+static constexpr const uint32_t kFullSaveMethodsRatio = 4;
+
+static constexpr const uint64_t kBytesWrittenBucketSize = 1 * KB;
+static constexpr const uint64_t kSaveTimeBucketSizeUs = 500;
+static constexpr const size_t kHistogramBucketCount = 32;
 
 
 ProfileSaver* ProfileSaver::instance_ = nullptr;
@@ -64,6 +75,7 @@ ProfileSaver::ProfileSaver(const std::string& output_filename,
       period_condition_("ProfileSaver period condition", wait_lock_),
       total_bytes_written_(0),
       total_number_of_writes_(0),
+      total_number_of_appended_writes_(0),
       total_number_of_code_cache_queries_(0),
       total_number_of_skipped_writes_(0),
       total_number_of_failed_writes_(0),
@@ -72,7 +84,13 @@ ProfileSaver::ProfileSaver(const std::string& output_filename,
       total_number_of_foreign_dex_marks_(0),
       max_number_of_profile_entries_cached_(0),
       total_number_of_hot_spikes_(0),
-      total_number_of_wake_ups_(0) {
+      total_number_of_wake_ups_(0),
+      bytes_written_histogram_("ProfileSaver bytes written",
+                               kBytesWrittenBucketSize,
+                               kHistogramBucketCount),
+      save_time_histogram_("ProfileSaver save time",
+                           kSaveTimeBucketSizeUs,
+                           kHistogramBucketCount) {
   AddTrackedLocations(output_filename, app_data_dir, code_paths);
 }
 
@@ -193,6 +211,14 @@ ProfileCompilationInfo* ProfileSaver::GetCachedProfiledInfo(const std::string& f
   return &info_it->second;
 }
 
+ProfileSaver::ProfileFileState* ProfileSaver::GetProfileFileState(const std::string& filename) {
+  auto state_it = profile_file_states_.find(filename);
+  if (state_it == profile_file_states_.end()) {
+    state_it = profile_file_states_.Put(filename, ProfileFileState());
+  }
+  return &state_it->second;
+}
+
 // Get resolved methods that have a profile info or more than kStartupMethodSamples samples.
 // Excludes native methods and classes in the boot image.
 class GetMethodsVisitor : public ClassVisitor {
@@ -259,7 +285,10 @@ void ProfileSaver::FetchAndCacheResolvedClassesAndMethods() {
       }
     }
     ProfileCompilationInfo* info = GetCachedProfiledInfo(filename);
-    info->AddMethodsAndClasses(methods_for_location, resolved_classes_for_location);
+    info->AddMethodsAndClasses(methods_for_location,
+                               resolved_classes_for_location,
+                               ProfileCompilationInfo::kMethodFlagHot |
+                                   ProfileCompilationInfo::kMethodFlagStartup);
     total_number_of_profile_entries_cached += resolved_classes_for_location.size();
   }
   max_number_of_profile_entries_cached_ = std::max(
@@ -286,15 +315,21 @@ bool ProfileSaver::ProcessProfilingInfo(uint16_t* new_methods) {
     }
     const std::string& filename = it.first;
     const std::set<std::string>& locations = it.second;
-    std::vector<MethodReference> methods;
+    std::vector<ProfileMethodInfo> methods;
     {
       ScopedObjectAccess soa(Thread::Current());
-      jit_code_cache_->GetProfiledMethods(locations, methods);
+      jit_code_cache_->GetProfiledMethods(locations, methods, /* only_new */ true);
       total_number_of_code_cache_queries_++;
     }
 
+    // The saver only runs once the startup methods have been recorded, the methods compiled by
+    // the JIT since are also used after startup.
+    const uint8_t method_flags =
+        ProfileCompilationInfo::kMethodFlagHot | ProfileCompilationInfo::kMethodFlagPostStartup;
     ProfileCompilationInfo* cached_info = GetCachedProfiledInfo(filename);
-    cached_info->AddMethodsAndClasses(methods, std::set<DexCacheResolvedClasses>());
+    ProfileFileState* state = GetProfileFileState(filename);
+    cached_info->AddMethods(methods, method_flags);
+    state->delta.AddMethods(methods, method_flags);
     int64_t delta_number_of_methods =
         cached_info->GetNumberOfMethods() -
         static_cast<int64_t>(last_save_number_of_methods_);
@@ -312,14 +347,20 @@ bool ProfileSaver::ProcessProfilingInfo(uint16_t* new_methods) {
     }
     *new_methods = std::max(static_cast<uint16_t>(delta_number_of_methods), *new_methods);
     uint64_t bytes_written;
-    // Force the save. In case the profile data is corrupted or the the profile
-    // has the wrong version this will "fix" the file to the correct format.
-    if (cached_info->MergeAndSave(filename, &bytes_written, /*force*/ true)) {
+    uint64_t start_save = NanoTime();
+    if (SaveProfile(filename, locations, cached_info, state, &bytes_written)) {
       last_save_number_of_methods_ = cached_info->GetNumberOfMethods();
       last_save_number_of_classes_ = cached_info->GetNumberOfResolvedClasses();
       // Clear resolved classes. No need to store them around as
       // they don't change after the first write.
       cached_info->ClearResolvedClasses();
+      {
+        MutexLock mu(Thread::Current(), *Locks::profiler_lock_);
+        save_time_histogram_.AdjustAndAddValue(NanoTime() - start_save);
+        if (bytes_written > 0) {
+          bytes_written_histogram_.AddValue(bytes_written);
+        }
+      }
       if (bytes_written > 0) {
         total_number_of_writes_++;
         total_bytes_written_ += bytes_written;
@@ -345,6 +386,46 @@ bool ProfileSaver::ProcessProfilingInfo(uint16_t* new_methods) {
   return profile_file_saved;
 }
 
+bool ProfileSaver::SaveProfile(const std::string& filename,
+                               const std::set<std::string>& locations,
+                               ProfileCompilationInfo* cached_info,
+                               ProfileFileState* state,
+                               /*out*/uint64_t* bytes_written) {
+  // Append the new methods to a file we wrote last, as long as they are few compared to the
+  // methods already saved. This avoids reading back and rewriting the whole file.
+  bool append = (state->file_size != 0u) &&
+      (state->number_of_appends < kMaximumNumberOfAppends) &&
+      (state->delta.GetNumberOfMethods() * kFullSaveMethodsRatio <=
+          cached_info->GetNumberOfMethods());
+  if (append && state->delta.AppendTo(filename, state->file_size, bytes_written)) {
+    state->file_size += *bytes_written;
+    state->number_of_appends++;
+    total_number_of_appended_writes_++;
+  } else {
+    // A full save also refreshes the inline caches of the methods saved before.
+    std::vector<ProfileMethodInfo> methods;
+    {
+      ScopedObjectAccess soa(Thread::Current());
+      jit_code_cache_->GetProfiledMethods(locations, methods, /* only_new */ false);
+      total_number_of_code_cache_queries_++;
+    }
+    cached_info->AddMethods(methods,
+                            ProfileCompilationInfo::kMethodFlagHot |
+                                ProfileCompilationInfo::kMethodFlagPostStartup);
+    // Force the save. In case the profile data is corrupted or the the profile
+    // has the wrong version this will "fix" the file to the correct format.
+    if (!cached_info->MergeAndSave(filename, bytes_written, /*force*/ true)) {
+      state->file_size = 0u;
+      return false;
+    }
+    int64_t file_size = GetFileSizeBytes(filename);
+    state->file_size = (file_size > 0) ? static_cast<uint64_t>(file_size) : 0u;
+    state->number_of_appends = 0u;
+  }
+  state->delta = ProfileCompilationInfo();
+  return true;
+}
+
 void* ProfileSaver::RunProfileSaverThread(void* arg) {
   Runtime* runtime = Runtime::Current();
 
@@ -642,6 +723,8 @@ void ProfileSaver::DumpInstanceInfo(std::ostream& os) {
 void ProfileSaver::DumpInfo(std::ostream& os) {
   os << "ProfileSaver total_bytes_written=" << total_bytes_written_ << '\n'
      << "ProfileSaver total_number_of_writes=" << total_number_of_writes_ << '\n'
+     << "ProfileSaver total_number_of_appended_writes="
+     << total_number_of_appended_writes_ << '\n'
      << "ProfileSaver total_number_of_code_cache_queries="
      << total_number_of_code_cache_queries_ << '\n'
      << "ProfileSaver total_number_of_skipped_writes=" << total_number_of_skipped_writes_ << '\n'
@@ -654,6 +737,12 @@ void ProfileSaver::DumpInfo(std::ostream& os) {
      << max_number_of_profile_entries_cached_ << '\n'
      << "ProfileSaver total_number_of_hot_spikes=" << total_number_of_hot_spikes_ << '\n'
      << "ProfileSaver total_number_of_wake_ups=" << total_number_of_wake_ups_ << '\n';
+  bytes_written_histogram_.PrintMemoryUse(os);
+  if (save_time_histogram_.SampleSize() != 0u) {
+    Histogram<uint64_t>::CumulativeData cumulative_data;
+    save_time_histogram_.CreateHistogram(&cumulative_data);
+    save_time_histogram_.PrintConfidenceIntervals(os, 0.99, cumulative_data);
+  }
 }
 
 
@@ -17,6 +17,7 @@
 #ifndef ART_RUNTIME_JIT_PROFILE_SAVER_H_
 #define ART_RUNTIME_JIT_PROFILE_SAVER_H_
 
+#include "base/histogram-inl.h"
 #include "base/mutex.h"
 #include "jit_code_cache.h"
 #include "offline_profiling_info.h"
@@ -61,6 +62,16 @@ class ProfileSaver {
                             uint16_t method_idx);
 
  private:
+  // What the saver knows about a profile file it writes.
+  struct ProfileFileState {
+    // The methods not saved to the file yet.
+    ProfileCompilationInfo delta;
+    // The size of the file after the last save, 0 if it is not known.
+    uint64_t file_size = 0;
+    // The number of deltas appended since the file was last fully written.
+    uint32_t number_of_appends = 0;
+  };
+
   ProfileSaver(const std::string& output_filename,
                jit::JitCodeCache* jit_code_cache,
                const std::vector<std::string>& code_paths,
@@ -95,6 +106,17 @@ class ProfileSaver {
   // If no entry exists, a new empty one will be created, added to the cache and
   // then returned.
   ProfileCompilationInfo* GetCachedProfiledInfo(const std::string& filename);
+  // Retrieves the state of the given profile file, creating it if needed.
+  ProfileFileState* GetProfileFileState(const std::string& filename);
+  // Saves the new methods of the given profile file, by appending them to the file or by
+  // merging the cached profile with the file content. Returns whether the save succeeded.
+  bool SaveProfile(const std::string& filename,
+                   const std::set<std::string>& locations,
+                   ProfileCompilationInfo* cached_info,
+                   ProfileFileState* state,
+                   /*out*/uint64_t* bytes_written)
+      REQUIRES(!Locks::profiler_lock_)
+      REQUIRES(!Locks::mutator_lock_);
   // Fetches the current resolved classes and methods from the ClassLinker and stores them in the
   // profile_cache_ for later save.
   void FetchAndCacheResolvedClassesAndMethods();
@@ -105,7 +127,7 @@ class ProfileSaver {
       const std::string& foreign_dex_profile_path,
       const std::set<std::string>& app_data_dirs);
 
-  void DumpInfo(std::ostream& os);
+  void DumpInfo(std::ostream& os) REQUIRES(Locks::profiler_lock_);
 
   // The only instance of the saver.
   static ProfileSaver* instance_ GUARDED_BY(Locks::profiler_lock_);
@@ -137,6 +159,9 @@ class ProfileSaver {
   // to just a few hundreds entries in the ProfileCompilationInfo objects.
   // It helps avoiding unnecessary writes to disk.
   SafeMap<std::string, ProfileCompilationInfo> profile_cache_;
+  // The state of each tracked file, used to append the new methods instead of rewriting the
+  // file at every save.
+  SafeMap<std::string, ProfileFileState> profile_file_states_;
 
   // Save period condition support.
   Mutex wait_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
@@ -144,6 +169,7 @@ class ProfileSaver {
 
   uint64_t total_bytes_written_;
   uint64_t total_number_of_writes_;
+  uint64_t total_number_of_appended_writes_;
   uint64_t total_number_of_code_cache_queries_;
   uint64_t total_number_of_skipped_writes_;
   uint64_t total_number_of_failed_writes_;
@@ -154,6 +180,8 @@ class ProfileSaver {
   uint64_t max_number_of_profile_entries_cached_;
   uint64_t total_number_of_hot_spikes_;
   uint64_t total_number_of_wake_ups_;
+  Histogram<uint64_t> bytes_written_histogram_ GUARDED_BY(Locks::profiler_lock_);
+  Histogram<uint64_t> save_time_histogram_ GUARDED_BY(Locks::profiler_lock_);
 
   DISALLOW_COPY_AND_ASSIGN(ProfileSaver);
 };
@@ -30,7 +30,9 @@ ProfilingInfo::ProfilingInfo(ArtMethod* method, const std::vector<uint32_t>& ent
         method_(method),
         is_method_being_compiled_(false),
         is_osr_method_being_compiled_(false),
+        is_reported_to_profile_saver_(false),
         current_inline_uses_(0),
+        code_age_(0),
         saved_entry_point_(nullptr) {
   memset(&cache_, 0, number_of_inline_caches_ * sizeof(InlineCache));
   for (size_t i = 0; i < number_of_inline_caches_; ++i) {
@@ -73,6 +73,10 @@ class InlineCache {
     return classes_[i].Read();
   }
 
+  uint32_t GetDexPc() const {
+    return dex_pc_;
+  }
+
   static constexpr uint16_t kIndividualCacheSize = 5;
 
  private:
@@ -142,6 +146,22 @@ class ProfilingInfo {
     return saved_entry_point_;
   }
 
+  // The number of full code cache collections in a row that did not see the compiled code of
+  // the method being used. The oldest code is evicted first.
+  uint16_t GetCodeAge() const {
+    return code_age_;
+  }
+
+  void IncrementCodeAge() {
+    if (code_age_ != std::numeric_limits<uint16_t>::max()) {
+      code_age_++;
+    }
+  }
+
+  void ResetCodeAge() {
+    code_age_ = 0;
+  }
+
   void ClearGcRootsInInlineCaches() {
     for (size_t i = 0; i < number_of_inline_caches_; ++i) {
       InlineCache* cache = &cache_[i];
@@ -184,10 +204,18 @@ class ProfilingInfo {
   bool is_method_being_compiled_;
   bool is_osr_method_being_compiled_;
 
+  // Whether the method was already reported to the profile saver. Implicitly guarded by the
+  // JIT code cache lock.
+  bool is_reported_to_profile_saver_;
+
   // When the compiler inlines the method associated to this ProfilingInfo,
   // it updates this counter so that the GC does not try to clear the inline caches.
   uint16_t current_inline_uses_;
 
+  // Number of full code cache collections since the compiled code was last used.
+  // Implicitly guarded by the JIT code cache lock.
+  uint16_t code_age_;
+
   // Entry point of the corresponding ArtMethod, while the JIT code cache
   // is poking for the liveness of compiled code.
   const void* saved_entry_point_;
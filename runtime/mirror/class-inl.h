@@ -1100,7 +1100,11 @@ inline void Class::FixupNativePointers(mirror::Class* dest,
     }
   }
   if (!IsTemp() && ShouldHaveImt<kVerifyNone, kReadBarrierOption>()) {
-    dest->SetImt(visitor(GetImt(pointer_size)), pointer_size);
+    ImTable* imt = GetImt(pointer_size);
+    ImTable* new_imt = visitor(imt);
+    if (imt != new_imt) {
+      dest->SetImt(new_imt, pointer_size);
+    }
   }
 }
 
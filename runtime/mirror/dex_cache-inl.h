@@ -34,15 +34,59 @@ inline uint32_t DexCache::ClassSize(size_t pointer_size) {
   return Class::ComputeClassSize(true, vtable_entries, 0, 0, 0, 0, 0, pointer_size);
 }
 
+inline bool DexCache::LockHashedSlot(Atomic<uint32_t>* tag) {
+  uint32_t old_tag = tag->LoadRelaxed();
+  if (old_tag == kHashedSlotLocked ||
+      !tag->CompareExchangeStrongSequentiallyConsistent(old_tag, kHashedSlotLocked)) {
+    // Another thread is replacing the entry.
+    return false;
+  }
+  // Pairs with the acquire fence of the readers: a reader that sees the new entry sees the
+  // locked tag when it loads the tag again.
+  QuasiAtomic::ThreadFenceRelease();
+  return true;
+}
+
+inline void DexCache::UnlockHashedSlot(Atomic<uint32_t>* tag, uint32_t new_tag) {
+  DCHECK_EQ(tag->LoadRelaxed(), kHashedSlotLocked);
+  tag->StoreRelease(new_tag);
+}
+
 inline String* DexCache::GetResolvedString(uint32_t string_idx) {
-  DCHECK_LT(string_idx, NumStrings());
-  return GetStrings()[string_idx].Read();
+  const uint32_t slot = StringSlot(string_idx);
+  DCHECK_LT(slot, NumStrings());
+  DCHECK(HasHashedStrings() || slot == string_idx);
+  GcRoot<String>* strings = GetStrings();
+  if (!HasHashedStrings()) {
+    return strings[slot].Read();
+  }
+  Atomic<uint32_t>* tag = &GetStringTags(strings)[slot];
+  const uint32_t expected_tag = StringTag(string_idx);
+  if (tag->LoadAcquire() != expected_tag) {
+    return nullptr;
+  }
+  String* string = strings[slot].Read();
+  QuasiAtomic::ThreadFenceAcquire();
+  return (tag->LoadRelaxed() == expected_tag) ? string : nullptr;
 }
 
 inline void DexCache::SetResolvedString(uint32_t string_idx, String* resolved) {
-  DCHECK_LT(string_idx, NumStrings());
-  // TODO default transaction support.
-  GetStrings()[string_idx] = GcRoot<String>(resolved);
+  const uint32_t slot = StringSlot(string_idx);
+  DCHECK_LT(slot, NumStrings());
+  DCHECK(HasHashedStrings() || slot == string_idx);
+  GcRoot<String>* strings = GetStrings();
+  if (!HasHashedStrings()) {
+    // TODO default transaction support.
+    strings[slot] = GcRoot<String>(resolved);
+  } else {
+    Atomic<uint32_t>* tag = &GetStringTags(strings)[slot];
+    if (!LockHashedSlot(tag)) {
+      // Leave the slot to the other thread, string_idx stays a cache miss.
+      return;
+    }
+    strings[slot] = GcRoot<String>(resolved);
+    UnlockHashedSlot(tag, StringTag(string_idx));
+  }
   // TODO: Fine-grained marking, so that we don't need to go through all arrays in full.
   Runtime::Current()->GetHeap()->WriteBarrierEveryFieldOf(this);
 }
@@ -62,8 +106,25 @@ inline void DexCache::SetResolvedType(uint32_t type_idx, Class* resolved) {
 
 inline ArtField* DexCache::GetResolvedField(uint32_t field_idx, size_t ptr_size) {
   DCHECK_EQ(Runtime::Current()->GetClassLinker()->GetImagePointerSize(), ptr_size);
-  DCHECK_LT(field_idx, NumResolvedFields());  // NOTE: Unchecked, i.e. not throwing AIOOB.
-  ArtField* field = GetElementPtrSize(GetResolvedFields(), field_idx, ptr_size);
+  const uint32_t slot = FieldSlot(field_idx);
+  DCHECK_LT(slot, NumResolvedFields());  // NOTE: Unchecked, i.e. not throwing AIOOB.
+  DCHECK(HasHashedFields() || slot == field_idx);
+  ArtField** fields = GetResolvedFields();
+  ArtField* field;
+  if (!HasHashedFields()) {
+    field = GetElementPtrSize(fields, slot, ptr_size);
+  } else {
+    Atomic<uint32_t>* tag = &GetFieldTags(fields, ptr_size)[slot];
+    const uint32_t expected_tag = FieldTag(field_idx);
+    if (tag->LoadAcquire() != expected_tag) {
+      return nullptr;
+    }
+    field = GetElementPtrSize(fields, slot, ptr_size);
+    QuasiAtomic::ThreadFenceAcquire();
+    if (tag->LoadRelaxed() != expected_tag) {
+      return nullptr;
+    }
+  }
   if (field == nullptr || field->GetDeclaringClass()->IsErroneous()) {
     return nullptr;
   }
@@ -72,8 +133,19 @@ inline ArtField* DexCache::GetResolvedField(uint32_t field_idx, size_t ptr_size)
 
 inline void DexCache::SetResolvedField(uint32_t field_idx, ArtField* field, size_t ptr_size) {
   DCHECK_EQ(Runtime::Current()->GetClassLinker()->GetImagePointerSize(), ptr_size);
-  DCHECK_LT(field_idx, NumResolvedFields());  // NOTE: Unchecked, i.e. not throwing AIOOB.
-  SetElementPtrSize(GetResolvedFields(), field_idx, field, ptr_size);
+  const uint32_t slot = FieldSlot(field_idx);
+  DCHECK_LT(slot, NumResolvedFields());  // NOTE: Unchecked, i.e. not throwing AIOOB.
+  DCHECK(HasHashedFields() || slot == field_idx);
+  ArtField** fields = GetResolvedFields();
+  if (!HasHashedFields()) {
+    SetElementPtrSize(fields, slot, field, ptr_size);
+  } else {
+    Atomic<uint32_t>* tag = &GetFieldTags(fields, ptr_size)[slot];
+    if (LockHashedSlot(tag)) {
+      SetElementPtrSize(fields, slot, field, ptr_size);
+      UnlockHashedSlot(tag, FieldTag(field_idx));
+    }
+  }
 }
 
 inline ArtMethod* DexCache::GetResolvedMethod(uint32_t method_idx, size_t ptr_size) {
@@ -147,7 +219,14 @@ inline void DexCache::FixupStrings(GcRoot<mirror::String>* dest, const Visitor&
   for (size_t i = 0, count = NumStrings(); i < count; ++i) {
     mirror::String* source = src[i].Read<kReadBarrierOption>();
     mirror::String* new_source = visitor(source);
-    dest[i] = GcRoot<mirror::String>(new_source);
+    // Skip unchanged entries when fixing up in place to avoid dirtying mostly null arrays.
+    if (dest != src || source != new_source) {
+      dest[i] = GcRoot<mirror::String>(new_source);
+    }
+  }
+  if (dest != src && HasHashedStrings()) {
+    // The tags are plain indexes and need no fixup.
+    memcpy(GetStringTags(dest), GetStringTags(src), NumStrings() * sizeof(uint32_t));
   }
 }
 
@@ -157,7 +236,10 @@ inline void DexCache::FixupResolvedTypes(GcRoot<mirror::Class>* dest, const Visi
   for (size_t i = 0, count = NumResolvedTypes(); i < count; ++i) {
     mirror::Class* source = src[i].Read<kReadBarrierOption>();
     mirror::Class* new_source = visitor(source);
-    dest[i] = GcRoot<mirror::Class>(new_source);
+    // Skip unchanged entries when fixing up in place to avoid dirtying mostly null arrays.
+    if (dest != src || source != new_source) {
+      dest[i] = GcRoot<mirror::Class>(new_source);
+    }
   }
 }
 
@@ -20,6 +20,7 @@
 #include "array.h"
 #include "art_field.h"
 #include "art_method.h"
+#include "atomic.h"
 #include "class.h"
 #include "object.h"
 #include "object_array.h"
@@ -41,6 +42,64 @@ class MANAGED DexCache FINAL : public Object {
   // Size of java.lang.DexCache.class.
   static uint32_t ClassSize(size_t pointer_size);
 
+  // Dex files with at least this many string ids use a fixed-size, hashed strings array of this
+  // many slots instead of one slot per string id. String string_idx maps to slot
+  // string_idx % kDexCacheStringCacheSize. A tag array stored right after the GC roots records
+  // which string_idx owns each slot. The most recently resolved string takes the slot over, see
+  // LockHashedSlot(). Compiled code checks the tag before and after loading the root.
+  static constexpr size_t kDexCacheStringCacheSize = 1024;
+
+  static bool UseHashedStrings(size_t num_string_ids) {
+    return num_string_ids >= kDexCacheStringCacheSize;
+  }
+
+  // Number of GC roots in the strings array for a dex file with num_string_ids string ids.
+  static size_t NumStringSlots(size_t num_string_ids) {
+    return UseHashedStrings(num_string_ids) ? kDexCacheStringCacheSize : num_string_ids;
+  }
+
+  static uint32_t StringSlot(uint32_t string_idx) {
+    return string_idx % kDexCacheStringCacheSize;
+  }
+
+  // Tag of string_idx in a hashed strings array. Zero marks a free slot.
+  static uint32_t StringTag(uint32_t string_idx) {
+    return string_idx / kDexCacheStringCacheSize + 1u;
+  }
+
+  static Atomic<uint32_t>* GetStringTags(GcRoot<String>* strings) {
+    static_assert(sizeof(GcRoot<String>) == sizeof(uint32_t), "Expected GC root to be 4 bytes.");
+    return reinterpret_cast<Atomic<uint32_t>*>(strings + kDexCacheStringCacheSize);
+  }
+
+  // Dex files with at least this many field ids use a fixed-size, hashed resolved fields array,
+  // laid out and updated like the hashed strings array. Resolved methods are not hashed because
+  // compiled invoke sequences index the resolved methods array directly.
+  static constexpr size_t kDexCacheFieldCacheSize = 1024;
+
+  static bool UseHashedFields(size_t num_field_ids) {
+    return num_field_ids >= kDexCacheFieldCacheSize;
+  }
+
+  // Number of ArtField* in the resolved fields array for a dex file with num_field_ids field ids.
+  static size_t NumFieldSlots(size_t num_field_ids) {
+    return UseHashedFields(num_field_ids) ? kDexCacheFieldCacheSize : num_field_ids;
+  }
+
+  static uint32_t FieldSlot(uint32_t field_idx) {
+    return field_idx % kDexCacheFieldCacheSize;
+  }
+
+  // Tag of field_idx in a hashed resolved fields array. Zero marks a free slot.
+  static uint32_t FieldTag(uint32_t field_idx) {
+    return field_idx / kDexCacheFieldCacheSize + 1u;
+  }
+
+  static Atomic<uint32_t>* GetFieldTags(ArtField** fields, size_t ptr_size) {
+    return reinterpret_cast<Atomic<uint32_t>*>(
+        reinterpret_cast<uint8_t*>(fields) + kDexCacheFieldCacheSize * ptr_size);
+  }
+
   // Size of an instance of java.lang.DexCache not including referenced values.
   static constexpr uint32_t InstanceSize() {
     return sizeof(DexCache);
@@ -171,10 +230,16 @@ class MANAGED DexCache FINAL : public Object {
     SetFieldPtr<false>(ResolvedFieldsOffset(), resolved_fields);
   }
 
+  // Number of GC roots in the strings array, see kDexCacheStringCacheSize.
   size_t NumStrings() SHARED_REQUIRES(Locks::mutator_lock_) {
     return GetField32(NumStringsOffset());
   }
 
+  bool HasHashedStrings() SHARED_REQUIRES(Locks::mutator_lock_) {
+    // Dex caches that are not hashed have fewer than kDexCacheStringCacheSize slots.
+    return NumStrings() == kDexCacheStringCacheSize;
+  }
+
   size_t NumResolvedTypes() SHARED_REQUIRES(Locks::mutator_lock_) {
     return GetField32(NumResolvedTypesOffset());
   }
@@ -183,10 +248,16 @@ class MANAGED DexCache FINAL : public Object {
     return GetField32(NumResolvedMethodsOffset());
   }
 
+  // Number of ArtField* in the resolved fields array, see kDexCacheFieldCacheSize.
   size_t NumResolvedFields() SHARED_REQUIRES(Locks::mutator_lock_) {
     return GetField32(NumResolvedFieldsOffset());
   }
 
+  bool HasHashedFields() SHARED_REQUIRES(Locks::mutator_lock_) {
+    // Dex caches that are not hashed have fewer than kDexCacheFieldCacheSize slots.
+    return NumResolvedFields() == kDexCacheFieldCacheSize;
+  }
+
   const DexFile* GetDexFile() ALWAYS_INLINE SHARED_REQUIRES(Locks::mutator_lock_) {
     return GetFieldPtr<const DexFile*>(OFFSET_OF_OBJECT_MEMBER(DexCache, dex_file_));
   }
@@ -216,13 +287,24 @@ class MANAGED DexCache FINAL : public Object {
   void VisitReferences(mirror::Class* klass, const Visitor& visitor)
       SHARED_REQUIRES(Locks::mutator_lock_) REQUIRES(Locks::heap_bitmap_lock_);
 
+  // Tag value of a hashed slot whose entry is being replaced.
+  static constexpr uint32_t kHashedSlotLocked = 0xffffffffu;
+
+  // A hashed slot is read by loading its tag, the entry and its tag again, and is a hit only if
+  // both tags are the expected one. A writer locks the tag, stores the entry, and unlocks the tag
+  // with the tag of the new entry. If the tag is already locked, the writer leaves the slot as is.
+  static bool LockHashedSlot(Atomic<uint32_t>* tag);
+  static void UnlockHashedSlot(Atomic<uint32_t>* tag, uint32_t new_tag);
+
   HeapReference<Object> dex_;
   HeapReference<String> location_;
   uint64_t dex_file_;           // const DexFile*
-  uint64_t resolved_fields_;    // ArtField*, array with num_resolved_fields_ elements.
+  uint64_t resolved_fields_;    // ArtField*, array with num_resolved_fields_ elements,
+                                // followed by as many tags if HasHashedFields().
   uint64_t resolved_methods_;   // ArtMethod*, array with num_resolved_methods_ elements.
   uint64_t resolved_types_;     // GcRoot<Class>*, array with num_resolved_types_ elements.
-  uint64_t strings_;            // GcRoot<String>*, array with num_strings_ elements.
+  uint64_t strings_;            // GcRoot<String>*, array with num_strings_ elements, followed
+                                // by as many tags if HasHashedStrings().
   uint32_t num_resolved_fields_;    // Number of elements in the resolved_fields_ array.
   uint32_t num_resolved_methods_;   // Number of elements in the resolved_methods_ array.
   uint32_t num_resolved_types_;     // Number of elements in the resolved_types_ array.
@@ -23,6 +23,7 @@
 #include "linear_alloc.h"
 #include "mirror/class_loader-inl.h"
 #include "handle_scope-inl.h"
+#include "mirror/string.h"
 #include "scoped_thread_state_change.h"
 
 namespace art {
@@ -40,10 +41,91 @@ TEST_F(DexCacheTest, Open) {
                                                 Runtime::Current()->GetLinearAlloc())));
   ASSERT_TRUE(dex_cache.Get() != nullptr);
 
-  EXPECT_EQ(java_lang_dex_file_->NumStringIds(), dex_cache->NumStrings());
+  EXPECT_EQ(DexCache::NumStringSlots(java_lang_dex_file_->NumStringIds()),
+            dex_cache->NumStrings());
   EXPECT_EQ(java_lang_dex_file_->NumTypeIds(),   dex_cache->NumResolvedTypes());
   EXPECT_EQ(java_lang_dex_file_->NumMethodIds(), dex_cache->NumResolvedMethods());
-  EXPECT_EQ(java_lang_dex_file_->NumFieldIds(),  dex_cache->NumResolvedFields());
+  EXPECT_EQ(DexCache::NumFieldSlots(java_lang_dex_file_->NumFieldIds()),
+            dex_cache->NumResolvedFields());
+}
+
+TEST_F(DexCacheTest, HashedStrings) {
+  ScopedObjectAccess soa(Thread::Current());
+  StackHandleScope<3> hs(soa.Self());
+  ASSERT_TRUE(java_lang_dex_file_ != nullptr);
+  const size_t cache_size = DexCache::kDexCacheStringCacheSize;
+  ASSERT_TRUE(DexCache::UseHashedStrings(java_lang_dex_file_->NumStringIds()));
+  ASSERT_GT(java_lang_dex_file_->NumStringIds(), cache_size + 1u);
+  Handle<DexCache> dex_cache(
+      hs.NewHandle(class_linker_->AllocDexCache(soa.Self(),
+                                                *java_lang_dex_file_,
+                                                Runtime::Current()->GetLinearAlloc())));
+  ASSERT_TRUE(dex_cache.Get() != nullptr);
+  ASSERT_TRUE(dex_cache->HasHashedStrings());
+  EXPECT_EQ(cache_size, dex_cache->NumStrings());
+
+  Handle<String> first(hs.NewHandle(String::AllocFromModifiedUtf8(soa.Self(), "first")));
+  Handle<String> second(hs.NewHandle(String::AllocFromModifiedUtf8(soa.Self(), "second")));
+  ASSERT_TRUE(first.Get() != nullptr);
+  ASSERT_TRUE(second.Get() != nullptr);
+
+  // Both indexes map to the same slot. The last one to be resolved owns it.
+  const uint32_t first_idx = 1u;
+  const uint32_t second_idx = first_idx + cache_size;
+  ASSERT_EQ(DexCache::StringSlot(first_idx), DexCache::StringSlot(second_idx));
+  EXPECT_TRUE(dex_cache->GetResolvedString(first_idx) == nullptr);
+  EXPECT_TRUE(dex_cache->GetResolvedString(second_idx) == nullptr);
+
+  dex_cache->SetResolvedString(first_idx, first.Get());
+  EXPECT_EQ(first.Get(), dex_cache->GetResolvedString(first_idx));
+  EXPECT_TRUE(dex_cache->GetResolvedString(second_idx) == nullptr);
+
+  dex_cache->SetResolvedString(second_idx, second.Get());
+  EXPECT_TRUE(dex_cache->GetResolvedString(first_idx) == nullptr);
+  EXPECT_EQ(second.Get(), dex_cache->GetResolvedString(second_idx));
+
+  dex_cache->SetResolvedString(first_idx, first.Get());
+  EXPECT_EQ(first.Get(), dex_cache->GetResolvedString(first_idx));
+  EXPECT_TRUE(dex_cache->GetResolvedString(second_idx) == nullptr);
+}
+
+TEST_F(DexCacheTest, HashedFields) {
+  ScopedObjectAccess soa(Thread::Current());
+  StackHandleScope<2> hs(soa.Self());
+  ASSERT_TRUE(java_lang_dex_file_ != nullptr);
+  const size_t cache_size = DexCache::kDexCacheFieldCacheSize;
+  ASSERT_TRUE(DexCache::UseHashedFields(java_lang_dex_file_->NumFieldIds()));
+  ASSERT_GT(java_lang_dex_file_->NumFieldIds(), cache_size + 1u);
+  Handle<DexCache> dex_cache(
+      hs.NewHandle(class_linker_->AllocDexCache(soa.Self(),
+                                                *java_lang_dex_file_,
+                                                Runtime::Current()->GetLinearAlloc())));
+  ASSERT_TRUE(dex_cache.Get() != nullptr);
+  ASSERT_TRUE(dex_cache->HasHashedFields());
+  EXPECT_EQ(cache_size, dex_cache->NumResolvedFields());
+
+  Handle<Class> string_class(hs.NewHandle(class_linker_->FindSystemClass(soa.Self(),
+                                                                         "Ljava/lang/String;")));
+  ASSERT_TRUE(string_class.Get() != nullptr);
+  ASSERT_GE(string_class->NumInstanceFields(), 2u);
+  ArtField* first = string_class->GetInstanceField(0);
+  ArtField* second = string_class->GetInstanceField(1);
+  const size_t pointer_size = class_linker_->GetImagePointerSize();
+
+  // Both indexes map to the same slot. The last one to be resolved owns it.
+  const uint32_t first_idx = 1u;
+  const uint32_t second_idx = first_idx + cache_size;
+  ASSERT_EQ(DexCache::FieldSlot(first_idx), DexCache::FieldSlot(second_idx));
+  EXPECT_TRUE(dex_cache->GetResolvedField(first_idx, pointer_size) == nullptr);
+  EXPECT_TRUE(dex_cache->GetResolvedField(second_idx, pointer_size) == nullptr);
+
+  dex_cache->SetResolvedField(first_idx, first, pointer_size);
+  EXPECT_EQ(first, dex_cache->GetResolvedField(first_idx, pointer_size));
+  EXPECT_TRUE(dex_cache->GetResolvedField(second_idx, pointer_size) == nullptr);
+
+  dex_cache->SetResolvedField(second_idx, second, pointer_size);
+  EXPECT_TRUE(dex_cache->GetResolvedField(first_idx, pointer_size) == nullptr);
+  EXPECT_EQ(second, dex_cache->GetResolvedField(second_idx, pointer_size));
 }
 
 TEST_F(DexCacheTest, LinearAlloc) {
@@ -68,8 +68,8 @@ inline mirror::Field* Field::CreateFromArtField(Thread* self, ArtField* field,
     if (resolved_field != nullptr) {
       DCHECK_EQ(resolved_field, field);
     } else {
-      // We rely on the field being resolved so that we can back to the ArtField
-      // (i.e. FromReflectedMethod).
+      // Field::GetArtField() uses the dex cache to get back to the ArtField
+      // (i.e. FromReflectedMethod), and the declaring class if a hashed dex cache evicted it.
       field->GetDexCache()->SetResolvedField(dex_field_index, field, pointer_size);
     }
   }
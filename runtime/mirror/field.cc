@@ -68,8 +68,15 @@ ArtField* Field::GetArtField() {
     }
   }
   mirror::DexCache* const dex_cache = declaring_class->GetDexCache();
-  ArtField* const art_field = dex_cache->GetResolvedField(GetDexFieldIndex(), sizeof(void*));
-  CHECK(art_field != nullptr);
+  ArtField* art_field = dex_cache->GetResolvedField(GetDexFieldIndex(), sizeof(void*));
+  if (UNLIKELY(art_field == nullptr)) {
+    // Evicted from a hashed dex cache, look it up in the declaring class.
+    art_field = IsStatic()
+        ? declaring_class->FindDeclaredStaticField(dex_cache, GetDexFieldIndex())
+        : declaring_class->FindDeclaredInstanceField(dex_cache, GetDexFieldIndex());
+    CHECK(art_field != nullptr);
+    dex_cache->SetResolvedField(GetDexFieldIndex(), art_field, sizeof(void*));
+  }
   CHECK_EQ(declaring_class, art_field->GetDeclaringClass());
   return art_field;
 }
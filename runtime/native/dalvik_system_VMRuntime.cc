@@ -443,8 +443,9 @@ static void PreloadDexCachesStatsFilled(DexCacheStats* filled)
     if (dex_cache == nullptr) {
       continue;
     }
+    GcRoot<mirror::String>* const strings = dex_cache->GetStrings();
     for (size_t j = 0; j < dex_cache->NumStrings(); j++) {
-      mirror::String* string = dex_cache->GetResolvedString(j);
+      mirror::String* string = strings[j].Read();
       if (string != nullptr) {
         filled->num_strings++;
       }
@@ -455,8 +456,9 @@ static void PreloadDexCachesStatsFilled(DexCacheStats* filled)
         filled->num_types++;
       }
     }
+    ArtField** const fields = dex_cache->GetResolvedFields();
     for (size_t j = 0; j < dex_cache->NumResolvedFields(); j++) {
-      ArtField* field = class_linker->GetResolvedField(j, dex_cache);
+      ArtField* field = mirror::DexCache::GetElementPtrSize(fields, j, sizeof(void*));
       if (field != nullptr) {
         filled->num_fields++;
       }
@@ -507,7 +509,7 @@ static void VMRuntime_preloadDexCaches(JNIEnv* env, jobject) {
     Handle<mirror::DexCache> dex_cache(hs.NewHandle(linker->RegisterDexFile(*dex_file, nullptr)));
 
     if (kPreloadDexCachesStrings) {
-      for (size_t j = 0; j < dex_cache->NumStrings(); j++) {
+      for (size_t j = 0; j < dex_file->NumStringIds(); j++) {
         PreloadDexCachesResolveString(dex_cache, j, strings);
       }
     }
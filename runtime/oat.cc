@@ -78,7 +78,8 @@ OatHeader::OatHeader(InstructionSet instruction_set,
       quick_to_interpreter_bridge_offset_(0),
       image_patch_delta_(0),
       image_file_location_oat_checksum_(0),
-      image_file_location_oat_data_begin_(0) {
+      image_file_location_oat_data_begin_(0),
+      linker_patches_offset_(0) {
   // Don't want asserts in header as they would be checked in each file that includes it. But the
   // fields are private, so we check inside a method.
   static_assert(sizeof(magic_) == sizeof(kOatMagic),
@@ -155,6 +156,7 @@ void OatHeader::UpdateChecksumWithHeaderData() {
   UpdateChecksum(&dex_file_count_, sizeof(dex_file_count_));
   UpdateChecksum(&image_file_location_oat_checksum_, sizeof(image_file_location_oat_checksum_));
   UpdateChecksum(&image_file_location_oat_data_begin_, sizeof(image_file_location_oat_data_begin_));
+  UpdateChecksum(&linker_patches_offset_, sizeof(linker_patches_offset_));
 
   // Update checksum for variable data size.
   UpdateChecksum(&key_value_store_size_, sizeof(key_value_store_size_));
@@ -384,6 +386,20 @@ void OatHeader::SetImageFileLocationOatDataBegin(uint32_t image_file_location_oa
   image_file_location_oat_data_begin_ = image_file_location_oat_data_begin;
 }
 
+uint32_t OatHeader::GetLinkerPatchesOffset() const {
+  DCHECK(IsValid());
+  return linker_patches_offset_;
+}
+
+void OatHeader::SetLinkerPatchesOffset(uint32_t linker_patches_offset) {
+  CHECK_ALIGNED(linker_patches_offset, sizeof(uint32_t));
+  CHECK_GT(linker_patches_offset, sizeof(OatHeader));
+  DCHECK(IsValid());
+  DCHECK_EQ(linker_patches_offset_, 0U);
+
+  linker_patches_offset_ = linker_patches_offset;
+}
+
 uint32_t OatHeader::GetKeyValueStoreSize() const {
   CHECK(IsValid());
   return key_value_store_size_;
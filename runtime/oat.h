@@ -32,7 +32,7 @@ class InstructionSetFeatures;
 class PACKED(4) OatHeader {
  public:
   static constexpr uint8_t kOatMagic[] = { 'o', 'a', 't', '\n' };
-  static constexpr uint8_t kOatVersion[] = { '0', '8', '8', '\0' };
+  static constexpr uint8_t kOatVersion[] = { '0', '9', '3', '\0' };
 
   static constexpr const char* kImageLocationKey = "image-location";
   static constexpr const char* kDex2OatCmdLineKey = "dex2oat-cmdline";
@@ -44,6 +44,8 @@ class PACKED(4) OatHeader {
   static constexpr const char* kCompilerFilter = "compiler-filter";
   static constexpr const char* kClassPathKey = "classpath";
   static constexpr const char* kBootClassPathKey = "bootclasspath";
+  // How the compiled code is ordered in the text section, "class-order" or "profile".
+  static constexpr const char* kCodeLayoutKey = "code-layout";
 
   static constexpr const char kTrueValue[] = "true";
   static constexpr const char kFalseValue[] = "false";
@@ -103,6 +105,10 @@ class PACKED(4) OatHeader {
   uint32_t GetImageFileLocationOatDataBegin() const;
   void SetImageFileLocationOatDataBegin(uint32_t image_file_location_oat_data_begin);
 
+  // Offset of the linker patch table, or 0 if the linker patches were not recorded.
+  uint32_t GetLinkerPatchesOffset() const;
+  void SetLinkerPatchesOffset(uint32_t linker_patches_offset);
+
   uint32_t GetKeyValueStoreSize() const;
   const uint8_t* GetKeyValueStore() const;
   const char* GetStoreValueByKey(const char* key) const;
@@ -150,6 +156,8 @@ class PACKED(4) OatHeader {
   uint32_t image_file_location_oat_checksum_;
   uint32_t image_file_location_oat_data_begin_;
 
+  uint32_t linker_patches_offset_;
+
   uint32_t key_value_store_size_;
   uint8_t key_value_store_[0];  // note variable width data at end
 
@@ -39,6 +39,7 @@
 #include "base/unix_file/fd_file.h"
 #include "elf_file.h"
 #include "elf_utils.h"
+#include "id_lookup_table.h"
 #include "oat.h"
 #include "mem_map.h"
 #include "mirror/class.h"
@@ -434,6 +435,36 @@ bool OatFileBase::Setup(const char* abs_dex_location, std::string* error_msg) {
       return false;
     }
 
+    uint32_t id_lookup_table_offset;
+    if (UNLIKELY(!ReadOatDexFileData(*this, &oat, &id_lookup_table_offset))) {
+      *error_msg = StringPrintf("In oat file '%s' found OatDexFile #%zd for '%s' truncated "
+                                    "after id lookup table offset",
+                                GetLocation().c_str(),
+                                i,
+                                dex_file_location.c_str());
+      return false;
+    }
+    const uint8_t* id_lookup_table_data = id_lookup_table_offset != 0u
+        ? Begin() + id_lookup_table_offset
+        : nullptr;
+    if (id_lookup_table_offset != 0u &&
+        (UNLIKELY(id_lookup_table_offset > Size()) ||
+            UNLIKELY(Size() - id_lookup_table_offset <
+                     IdLookupTable::RawDataLength(header->string_ids_size_,
+                                                  header->method_ids_size_)))) {
+      *error_msg = StringPrintf("In oat file '%s' found OatDexFile #%zu for '%s' with truncated "
+                                    "id lookup table, offset %u of %zu, string ids %u, "
+                                    "method ids %u",
+                                GetLocation().c_str(),
+                                i,
+                                dex_file_location.c_str(),
+                                id_lookup_table_offset,
+                                Size(),
+                                header->string_ids_size_,
+                                header->method_ids_size_);
+      return false;
+    }
+
     uint8_t* current_dex_cache_arrays = nullptr;
     if (dex_cache_arrays != nullptr) {
       DexCacheArraysLayout layout(pointer_size, *header);
@@ -462,6 +493,7 @@ bool OatFileBase::Setup(const char* abs_dex_location, std::string* error_msg) {
                                               dex_file_checksum,
                                               dex_file_pointer,
                                               lookup_table_data,
+                                              id_lookup_table_data,
                                               class_offsets_pointer,
                                               current_dex_cache_arrays);
     oat_dex_files_storage_.push_back(oat_dex_file);
@@ -1148,6 +1180,7 @@ OatFile::OatDexFile::OatDexFile(const OatFile* oat_file,
                                 uint32_t dex_file_location_checksum,
                                 const uint8_t* dex_file_pointer,
                                 const uint8_t* lookup_table_data,
+                                const uint8_t* id_lookup_table_data,
                                 const uint32_t* oat_class_offsets_pointer,
                                 uint8_t* dex_cache_arrays)
     : oat_file_(oat_file),
@@ -1156,6 +1189,7 @@ OatFile::OatDexFile::OatDexFile(const OatFile* oat_file,
       dex_file_location_checksum_(dex_file_location_checksum),
       dex_file_pointer_(dex_file_pointer),
       lookup_table_data_(lookup_table_data),
+      id_lookup_table_data_(id_lookup_table_data),
       oat_class_offsets_pointer_(oat_class_offsets_pointer),
       dex_cache_arrays_(dex_cache_arrays) {}
 
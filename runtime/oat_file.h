@@ -373,6 +373,10 @@ class OatDexFile FINAL {
     return lookup_table_data_;
   }
 
+  const uint8_t* GetIdLookupTableData() const {
+    return id_lookup_table_data_;
+  }
+
   const uint8_t* GetDexFilePointer() const {
     return dex_file_pointer_;
   }
@@ -386,6 +390,7 @@ class OatDexFile FINAL {
              uint32_t dex_file_checksum,
              const uint8_t* dex_file_pointer,
              const uint8_t* lookup_table_data,
+             const uint8_t* id_lookup_table_data,
              const uint32_t* oat_class_offsets_pointer,
              uint8_t* dex_cache_arrays);
 
@@ -395,6 +400,7 @@ class OatDexFile FINAL {
   const uint32_t dex_file_location_checksum_;
   const uint8_t* const dex_file_pointer_;
   const uint8_t* lookup_table_data_;
+  const uint8_t* id_lookup_table_data_;
   const uint32_t* const oat_class_offsets_pointer_;
   uint8_t* const dex_cache_arrays_;
 
@@ -31,6 +31,7 @@
 #include "mirror/class_loader.h"
 #include "oat_file_assistant.h"
 #include "scoped_thread_state_change.h"
+#include "startup_timeline.h"
 #include "thread-inl.h"
 #include "thread_list.h"
 
@@ -548,6 +549,7 @@ std::vector<std::unique_ptr<const DexFile>> OatFileManager::OpenDexFilesFromOat(
   ScopedTrace trace(__FUNCTION__);
   CHECK(dex_location != nullptr);
   CHECK(error_msgs != nullptr);
+  ScopedStartupPhase phase("OatFileManager::OpenDexFilesFromOat", dex_location);
 
   // Verify we aren't holding the mutator lock, which could starve GC if we
   // have to generate or relocate an oat file.
@@ -695,7 +697,14 @@ std::vector<std::unique_ptr<const DexFile>> OatFileManager::OpenDexFilesFromOat(
   if (dex_files.empty()) {
     if (oat_file_assistant.HasOriginalDexFiles()) {
       if (Runtime::Current()->IsDexFileFallbackEnabled()) {
-        if (!DexFile::Open(dex_location, dex_location, /*out*/ &error_msg, &dex_files)) {
+        // The oat file, even if rejected, vouches for the dex files it was compiled from.
+        const OatFile* trusted_oat_file =
+            (source_oat_file != nullptr) ? source_oat_file : oat_file.get();
+        if (!DexFile::Open(dex_location,
+                           dex_location,
+                           /*out*/ &error_msg,
+                           &dex_files,
+                           trusted_oat_file)) {
           LOG(WARNING) << error_msg;
           error_msgs->push_back("Failed to open dex files from " + std::string(dex_location)
                                 + " because: " + error_msg);
@@ -227,7 +227,10 @@ bool RecordConstructorIPut(ArtMethod* method,
       break;
     }
     ArtField* f = dex_cache->GetResolvedField(iputs[old_pos].field_index, pointer_size);
-    DCHECK(f != nullptr);
+    if (UNLIKELY(f == nullptr)) {
+      // Evicted from a hashed dex cache.
+      return false;
+    }
     if (f == field) {
       auto back_it = std::copy(iputs + old_pos + 1, iputs + arraysize(iputs), iputs + old_pos);
       *back_it = ConstructorIPutData();
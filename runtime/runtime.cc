@@ -132,6 +132,7 @@
 #include "sigchain.h"
 #include "signal_catcher.h"
 #include "signal_set.h"
+#include "startup_timeline.h"
 #include "thread.h"
 #include "thread_list.h"
 #include "trace.h"
@@ -283,6 +284,11 @@ Runtime::~Runtime() {
 
   Trace::Shutdown();
 
+  if (jit_ != nullptr) {
+    // Record the JIT compiled methods while the shutdown thread is still attached.
+    jit_->SaveWarmStartFile(self);
+  }
+
   if (attach_shutdown_thread) {
     DetachCurrentThread();
     self = nullptr;
@@ -565,6 +571,7 @@ std::string Runtime::GetCompilerExecutable() const {
 
 bool Runtime::Start() {
   VLOG(startup) << "Runtime::Start entering";
+  ScopedStartupPhase start_phase("Runtime::Start");
 
   CHECK(!no_sig_chain_) << "A started runtime should have sig chain enabled";
 
@@ -617,6 +624,7 @@ bool Runtime::Start() {
   // it touches will have methods linked to the oat file if necessary.
   {
     ScopedTrace trace2("InitNativeMethods");
+    ScopedStartupPhase phase("Runtime::InitNativeMethods");
     InitNativeMethods();
   }
 
@@ -625,7 +633,10 @@ bool Runtime::Start() {
 
   Thread::FinishStartup();
 
-  system_class_loader_ = CreateSystemClassLoader(this);
+  {
+    ScopedStartupPhase phase("Runtime::CreateSystemClassLoader");
+    system_class_loader_ = CreateSystemClassLoader(this);
+  }
 
   if (is_zygote_) {
     if (!InitZygote()) {
@@ -784,6 +795,7 @@ bool Runtime::IsDebuggable() const {
 
 void Runtime::StartDaemonThreads() {
   ScopedTrace trace(__FUNCTION__);
+  ScopedStartupPhase phase("Runtime::StartDaemonThreads");
   VLOG(startup) << "Runtime::StartDaemonThreads entering";
 
   Thread* self = Thread::Current();
@@ -943,6 +955,12 @@ bool Runtime::Init(RuntimeArgumentMap&& runtime_options_in) {
   using Opt = RuntimeArgumentMap;
   VLOG(startup) << "Runtime::Init -verbose:startup enabled";
 
+  if (runtime_options.Exists(Opt::StartupTimelineFile)) {
+    startup_timeline_.reset(
+        new StartupTimeline(runtime_options.ReleaseOrDefault(Opt::StartupTimelineFile)));
+  }
+  ScopedStartupPhase init_phase("Runtime::Init");
+
   QuasiAtomic::Startup();
 
   oat_file_manager_ = new OatFileManager;
@@ -1156,7 +1174,11 @@ bool Runtime::Init(RuntimeArgumentMap&& runtime_options_in) {
   class_linker_ = new ClassLinker(intern_table_);
   if (GetHeap()->HasBootImageSpace()) {
     std::string error_msg;
-    bool result = class_linker_->InitFromBootImage(&error_msg);
+    bool result;
+    {
+      ScopedStartupPhase phase("ClassLinker::InitFromBootImage");
+      result = class_linker_->InitFromBootImage(&error_msg);
+    }
     if (!result) {
       LOG(ERROR) << "Could not initialize from image: " << error_msg;
       return false;
@@ -1178,10 +1200,12 @@ bool Runtime::Init(RuntimeArgumentMap&& runtime_options_in) {
     }
     {
       ScopedTrace trace2("AddImageStringsToTable");
+      ScopedStartupPhase phase("InternTable::AddImagesStringsToTable");
       GetInternTable()->AddImagesStringsToTable(heap_->GetBootImageSpaces());
     }
     {
       ScopedTrace trace2("MoveImageClassesToClassTable");
+      ScopedStartupPhase phase("ClassLinker::AddBootImageClassesToClassTable");
       GetClassLinker()->AddBootImageClassesToClassTable();
     }
   } else {
@@ -1207,6 +1231,7 @@ bool Runtime::Init(RuntimeArgumentMap&& runtime_options_in) {
     }
     instruction_set_ = runtime_options.GetOrDefault(Opt::ImageInstructionSet);
     std::string error_msg;
+    ScopedStartupPhase phase("ClassLinker::InitWithoutImage");
     if (!class_linker_->InitWithoutImage(std::move(boot_class_path), &error_msg)) {
       LOG(ERROR) << "Could not initialize without image: " << error_msg;
       return false;
@@ -1327,7 +1352,10 @@ void Runtime::InitNativeMethods() {
 
   // Initialize classes used in JNI. The initialization requires runtime native
   // methods to be loaded first.
-  WellKnownClasses::Init(env);
+  {
+    ScopedStartupPhase phase("WellKnownClasses::Init");
+    WellKnownClasses::Init(env);
+  }
 
   // Then set up libjavacore / libopenjdk, which are just a regular JNI libraries with
   // a regular JNI_OnLoad. Most JNI libraries can just use System.loadLibrary, but
@@ -1831,6 +1859,18 @@ bool Runtime::IsTransactionAborted() const {
   }
 }
 
+bool Runtime::IsTransactionReadConstraint(ArtField* field) const {
+  DCHECK(IsAotCompiler());
+  DCHECK(IsActiveTransaction());
+  return preinitialization_transaction_->ReadConstraint(field);
+}
+
+bool Runtime::IsTransactionReadConstraint(mirror::Object* obj) const {
+  DCHECK(IsAotCompiler());
+  DCHECK(IsActiveTransaction());
+  return preinitialization_transaction_->ReadConstraint(obj);
+}
+
 void Runtime::AbortTransactionAndThrowAbortError(Thread* self, const std::string& abort_message) {
   DCHECK(IsAotCompiler());
   DCHECK(IsActiveTransaction());
@@ -1953,6 +1993,7 @@ void Runtime::AddCurrentRuntimeFeaturesAsDex2OatArguments(std::vector<std::strin
 
 void Runtime::CreateJit() {
   CHECK(!IsAotCompiler());
+  ScopedStartupPhase phase("Runtime::CreateJit");
   if (kIsDebugBuild && GetInstrumentation()->IsForcedInterpretOnly()) {
     DCHECK(!jit_options_->UseJitCompilation());
   }
@@ -88,6 +88,7 @@ class OatFileManager;
 struct RuntimeArgumentMap;
 class SignalCatcher;
 class StackOverflowHandler;
+class StartupTimeline;
 class SuspensionHandler;
 class ThreadList;
 class Trace;
@@ -485,6 +486,13 @@ class Runtime {
   void ExitTransactionMode();
   bool IsTransactionAborted() const;
 
+  // Returns true if the active transaction may not read the static field.
+  bool IsTransactionReadConstraint(ArtField* field) const
+      SHARED_REQUIRES(Locks::mutator_lock_);
+  // Returns true if the active transaction may not read the fields of `obj` through Unsafe.
+  bool IsTransactionReadConstraint(mirror::Object* obj) const
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
   void AbortTransactionAndThrowAbortError(Thread* self, const std::string& abort_message)
       SHARED_REQUIRES(Locks::mutator_lock_);
   void ThrowTransactionAbortError(Thread* self)
@@ -506,14 +514,10 @@ class Runtime {
                                  mirror::Object* value, bool is_volatile) const;
   void RecordWriteArray(mirror::Array* array, size_t index, uint64_t value) const
       SHARED_REQUIRES(Locks::mutator_lock_);
-  void RecordStrongStringInsertion(mirror::String* s) const
-      REQUIRES(Locks::intern_table_lock_);
-  void RecordWeakStringInsertion(mirror::String* s) const
-      REQUIRES(Locks::intern_table_lock_);
-  void RecordStrongStringRemoval(mirror::String* s) const
-      REQUIRES(Locks::intern_table_lock_);
-  void RecordWeakStringRemoval(mirror::String* s) const
-      REQUIRES(Locks::intern_table_lock_);
+  void RecordStrongStringInsertion(mirror::String* s) const;
+  void RecordWeakStringInsertion(mirror::String* s) const;
+  void RecordStrongStringRemoval(mirror::String* s) const;
+  void RecordWeakStringRemoval(mirror::String* s) const;
 
   void SetFaultMessage(const std::string& message) REQUIRES(!fault_message_lock_);
   // Only read by the signal handler, NO_THREAD_SAFETY_ANALYSIS to prevent lock order violations
@@ -612,6 +616,11 @@ class Runtime {
     return *oat_file_manager_;
   }
 
+  // Null unless -Xstartup-timeline was given.
+  StartupTimeline* GetStartupTimeline() const {
+    return startup_timeline_.get();
+  }
+
   double GetHashTableMinLoadFactor() const;
   double GetHashTableMaxLoadFactor() const;
 
@@ -793,6 +802,8 @@ class Runtime {
 
   std::unique_ptr<TraceConfig> trace_config_;
 
+  std::unique_ptr<StartupTimeline> startup_timeline_;
+
   instrumentation::Instrumentation instrumentation_;
 
   jobject main_thread_group_;
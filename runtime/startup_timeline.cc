@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "startup_timeline.h"
+
+#include <unistd.h>
+
+#include <memory>
+#include <sstream>
+
+#include "base/stringprintf.h"
+#include "base/time_utils.h"
+#include "base/unix_file/fd_file.h"
+#include "os.h"
+#include "runtime.h"
+#include "thread-inl.h"
+#include "utils.h"
+
+namespace art {
+
+static void DumpJsonString(std::ostream& os, const char* str) {
+  os << '"';
+  for (const char* p = str; *p != '\0'; ++p) {
+    const unsigned char c = static_cast<unsigned char>(*p);
+    if (c == '"' || c == '\\') {
+      os << '\\' << c;
+    } else if (c < 0x20) {
+      os << StringPrintf("\\u%04x", c);
+    } else {
+      os << c;
+    }
+  }
+  os << '"';
+}
+
+// Chrome trace event timestamps are in microseconds, keep the nanoseconds as decimals.
+static void DumpMicros(std::ostream& os, uint64_t ns) {
+  os << ns / 1000u << '.' << StringPrintf("%03u", static_cast<unsigned>(ns % 1000u));
+}
+
+StartupTimeline::StartupTimeline(const std::string& output_file)
+    : output_file_(output_file),
+      recording_(true),
+      lock_("Startup timeline lock", kStartupTimelineLock) {
+}
+
+void StartupTimeline::RecordPhase(const char* name,
+                                  const std::string& detail,
+                                  uint32_t tid,
+                                  uint64_t begin_ns,
+                                  uint64_t end_ns) {
+  DCHECK_LE(begin_ns, end_ns);
+  MutexLock mu(Thread::Current(), lock_);
+  if (IsRecording()) {
+    phases_.push_back(Phase { name, detail, tid, begin_ns, end_ns });
+  }
+}
+
+bool StartupTimeline::Finish() {
+  {
+    MutexLock mu(Thread::Current(), lock_);
+    recording_.StoreRelaxed(false);
+  }
+  std::ostringstream oss;
+  Dump(oss);
+  const std::string json = oss.str();
+  std::unique_ptr<File> file(OS::CreateEmptyFile(output_file_.c_str()));
+  if (file == nullptr) {
+    PLOG(ERROR) << "Could not create startup timeline file " << output_file_;
+    return false;
+  }
+  if (!file->WriteFully(json.c_str(), json.length())) {
+    PLOG(ERROR) << "Could not write startup timeline file " << output_file_;
+    file->Erase();
+    return false;
+  }
+  if (file->FlushCloseOrErase() != 0) {
+    PLOG(ERROR) << "Could not close startup timeline file " << output_file_;
+    return false;
+  }
+  VLOG(startup) << "Wrote startup timeline to " << output_file_;
+  return true;
+}
+
+void StartupTimeline::Dump(std::ostream& os) const {
+  MutexLock mu(Thread::Current(), lock_);
+  const pid_t pid = getpid();
+  os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  for (const Phase& phase : phases_) {
+    os << (first ? "\n" : ",\n") << "{\"name\":";
+    first = false;
+    DumpJsonString(os, phase.name);
+    os << ",\"cat\":\"art\",\"ph\":\"X\",\"ts\":";
+    DumpMicros(os, phase.begin_ns);
+    os << ",\"dur\":";
+    DumpMicros(os, phase.end_ns - phase.begin_ns);
+    os << ",\"pid\":" << pid << ",\"tid\":" << phase.tid;
+    if (!phase.detail.empty()) {
+      os << ",\"args\":{\"detail\":";
+      DumpJsonString(os, phase.detail.c_str());
+      os << "}";
+    }
+    os << "}";
+  }
+  os << "\n]}\n";
+}
+
+static StartupTimeline* GetRecordingStartupTimeline() {
+  Runtime* const runtime = Runtime::Current();
+  if (runtime == nullptr) {
+    return nullptr;
+  }
+  StartupTimeline* const timeline = runtime->GetStartupTimeline();
+  return (timeline != nullptr && timeline->IsRecording()) ? timeline : nullptr;
+}
+
+ScopedStartupPhase::ScopedStartupPhase(const char* name)
+    : timeline_(GetRecordingStartupTimeline()),
+      name_(name),
+      begin_ns_(timeline_ != nullptr ? NanoTime() : 0u) {
+}
+
+ScopedStartupPhase::ScopedStartupPhase(const char* name, const std::string& detail)
+    : timeline_(GetRecordingStartupTimeline()),
+      name_(name),
+      detail_(timeline_ != nullptr ? detail : std::string()),
+      begin_ns_(timeline_ != nullptr ? NanoTime() : 0u) {
+}
+
+ScopedStartupPhase::~ScopedStartupPhase() {
+  if (timeline_ != nullptr) {
+    timeline_->RecordPhase(name_, detail_, static_cast<uint32_t>(GetTid()), begin_ns_, NanoTime());
+  }
+}
+
+}  // namespace art
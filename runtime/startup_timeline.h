@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_STARTUP_TIMELINE_H_
+#define ART_RUNTIME_STARTUP_TIMELINE_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+
+namespace art {
+
+// Records when the phases of the runtime startup begin and end, and on which thread. Enabled with
+// -Xstartup-timeline:<file>. The timeline is written to the file in the Chrome trace event format
+// once JNI_CreateJavaVM() has started the runtime; phases ending after that are not recorded.
+class StartupTimeline {
+ public:
+  explicit StartupTimeline(const std::string& output_file);
+
+  bool IsRecording() const {
+    return recording_.LoadRelaxed();
+  }
+
+  // The name must be a string literal.
+  void RecordPhase(const char* name,
+                   const std::string& detail,
+                   uint32_t tid,
+                   uint64_t begin_ns,
+                   uint64_t end_ns) REQUIRES(!lock_);
+
+  // Stop recording and write the timeline to the output file. Returns false on error.
+  bool Finish() REQUIRES(!lock_);
+
+  // Write the phases recorded so far as a Chrome trace event JSON object.
+  void Dump(std::ostream& os) const REQUIRES(!lock_);
+
+ private:
+  struct Phase {
+    const char* name;
+    std::string detail;
+    uint32_t tid;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+  };
+
+  const std::string output_file_;
+  Atomic<bool> recording_;
+  mutable Mutex lock_;
+  std::vector<Phase> phases_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(StartupTimeline);
+};
+
+// Records a phase of the runtime startup spanning the lifetime of the object, when the startup
+// timeline of the current runtime is recording.
+class ScopedStartupPhase {
+ public:
+  // The name must be a string literal.
+  explicit ScopedStartupPhase(const char* name);
+  ScopedStartupPhase(const char* name, const std::string& detail);
+  ~ScopedStartupPhase();
+
+  bool IsRecording() const {
+    return timeline_ != nullptr;
+  }
+
+  // Set the detail shown with the phase, for details that are only worth computing when recording.
+  void SetDetail(const std::string& detail) {
+    detail_ = detail;
+  }
+
+ private:
+  StartupTimeline* const timeline_;
+  const char* const name_;
+  std::string detail_;
+  const uint64_t begin_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedStartupPhase);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_STARTUP_TIMELINE_H_
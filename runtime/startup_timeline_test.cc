@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "startup_timeline.h"
+
+#include "common_runtime_test.h"
+#include "runtime.h"
+#include "utils.h"
+
+namespace art {
+
+class StartupTimelineTest : public CommonRuntimeTest {};
+
+TEST_F(StartupTimelineTest, Dump) {
+  ScratchFile tmp;
+  StartupTimeline timeline(tmp.GetFilename());
+  EXPECT_TRUE(timeline.IsRecording());
+
+  // Check dumping the empty timeline.
+  {
+    std::ostringstream oss;
+    timeline.Dump(oss);
+    EXPECT_EQ("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n]}\n", oss.str());
+  }
+
+  timeline.RecordPhase("Outer", "", 42u, 1000u, 2001234u);
+  timeline.RecordPhase("Inner", "a \"quoted\\path\"\n", 43u, 1500u, 1750u);
+  std::ostringstream oss;
+  timeline.Dump(oss);
+  const std::string json = oss.str();
+  EXPECT_NE(json.find("{\"name\":\"Outer\",\"cat\":\"art\",\"ph\":\"X\",\"ts\":1.000,"
+                      "\"dur\":2000.234,"), std::string::npos) << json;
+  EXPECT_NE(json.find(",\"tid\":42}"), std::string::npos) << json;
+  EXPECT_NE(json.find("{\"name\":\"Inner\",\"cat\":\"art\",\"ph\":\"X\",\"ts\":1.500,"
+                      "\"dur\":0.250,"), std::string::npos) << json;
+  EXPECT_NE(json.find(",\"tid\":43,\"args\":{\"detail\":\"a \\\"quoted\\\\path\\\"\\u000a\"}}"),
+            std::string::npos) << json;
+}
+
+TEST_F(StartupTimelineTest, Finish) {
+  ScratchFile tmp;
+  StartupTimeline timeline(tmp.GetFilename());
+  timeline.RecordPhase("Before", "", 1u, 0u, 1000u);
+  ASSERT_TRUE(timeline.Finish());
+  EXPECT_FALSE(timeline.IsRecording());
+
+  // Phases ending after the timeline is finished are dropped.
+  timeline.RecordPhase("After", "", 1u, 1000u, 2000u);
+  std::ostringstream oss;
+  timeline.Dump(oss);
+  EXPECT_EQ(oss.str().find("After"), std::string::npos) << oss.str();
+
+  std::string contents;
+  ASSERT_TRUE(ReadFileToString(tmp.GetFilename(), &contents));
+  EXPECT_EQ(oss.str(), contents);
+  EXPECT_NE(contents.find("\"name\":\"Before\""), std::string::npos) << contents;
+}
+
+TEST_F(StartupTimelineTest, ScopedStartupPhaseWithoutTimeline) {
+  // The runtime of the test has no timeline, so the scoped phase does not record anything.
+  ASSERT_TRUE(Runtime::Current()->GetStartupTimeline() == nullptr);
+  ScopedStartupPhase phase("Test");
+  EXPECT_FALSE(phase.IsRecording());
+}
+
+}  // namespace art
@@ -16,8 +16,10 @@
 
 #include "transaction.h"
 
+#include "art_field-inl.h"
 #include "base/stl_util.h"
 #include "base/logging.h"
+#include "gc/heap.h"
 #include "gc/accounting/card_table-inl.h"
 #include "intern_table.h"
 #include "mirror/class-inl.h"
@@ -31,8 +33,10 @@ namespace art {
 // TODO: remove (only used for debugging purpose).
 static constexpr bool kEnableTransactionStats = false;
 
-Transaction::Transaction()
-  : log_lock_("transaction log lock", kTransactionLogLock), aborted_(false) {
+Transaction::Transaction() : Transaction(/* strict */ false) {}
+
+Transaction::Transaction(bool strict)
+  : log_lock_("transaction log lock", kTransactionLogLock), aborted_(false), strict_(strict) {
   CHECK(Runtime::Current()->IsAotCompiler());
 }
 
@@ -88,6 +92,44 @@ void Transaction::ThrowAbortError(Thread* self, const std::string* abort_message
   }
 }
 
+bool Transaction::ReadConstraint(ArtField* field) {
+  DCHECK(field->IsStatic());
+  return !field->IsFinal() && ReadConstraint(field->GetDeclaringClass());
+}
+
+bool Transaction::ReadConstraint(mirror::Object* obj) {
+  DCHECK(obj != nullptr);
+  if (!strict_ || !obj->IsClass()) {
+    return false;
+  }
+  return Runtime::Current()->GetHeap()->ObjectIsInBootImageSpace(obj);
+}
+
+bool Transaction::HasBootImageWrites() {
+  gc::Heap* const heap = Runtime::Current()->GetHeap();
+  MutexLock mu(Thread::Current(), log_lock_);
+  for (const auto& it : object_logs_) {
+    if (heap->ObjectIsInBootImageSpace(it.first)) {
+      return true;
+    }
+  }
+  for (const auto& it : array_logs_) {
+    if (heap->ObjectIsInBootImageSpace(it.first)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Transaction::GetWrittenClasses(std::vector<mirror::Class*>* classes) {
+  MutexLock mu(Thread::Current(), log_lock_);
+  for (const auto& it : object_logs_) {
+    if (it.first->IsClass()) {
+      classes->push_back(it.first->AsClass());
+    }
+  }
+}
+
 bool Transaction::IsAborted() {
   MutexLock mu(Thread::Current(), log_lock_);
   return aborted_;
@@ -186,7 +228,6 @@ void Transaction::RecordWeakStringRemoval(mirror::String* s) {
 }
 
 void Transaction::LogInternedString(const InternStringLog& log) {
-  Locks::intern_table_lock_->AssertExclusiveHeld(Thread::Current());
   MutexLock mu(Thread::Current(), log_lock_);
   intern_string_logs_.push_front(log);
 }
@@ -195,11 +236,14 @@ void Transaction::Rollback() {
   CHECK(!Runtime::Current()->IsActiveTransaction());
   Thread* self = Thread::Current();
   self->AssertNoPendingException();
-  MutexLock mu1(self, *Locks::intern_table_lock_);
-  MutexLock mu2(self, log_lock_);
-  UndoObjectModifications();
-  UndoArrayModifications();
-  UndoInternStringTableModifications();
+  std::list<InternStringLog> intern_string_logs;
+  {
+    MutexLock mu(self, log_lock_);
+    UndoObjectModifications();
+    UndoArrayModifications();
+    intern_string_logs.swap(intern_string_logs_);
+  }
+  UndoInternStringTableModifications(&intern_string_logs);
 }
 
 void Transaction::UndoObjectModifications() {
@@ -220,14 +264,15 @@ void Transaction::UndoArrayModifications() {
   array_logs_.clear();
 }
 
-void Transaction::UndoInternStringTableModifications() {
+void Transaction::UndoInternStringTableModifications(
+    std::list<InternStringLog>* intern_string_logs) {
   InternTable* const intern_table = Runtime::Current()->GetInternTable();
   // We want to undo each operation from the most recent to the oldest. List has been filled so the
   // most recent operation is at list begin so just have to iterate over it.
-  for (InternStringLog& string_log : intern_string_logs_) {
+  for (InternStringLog& string_log : *intern_string_logs) {
     string_log.Undo(intern_table);
   }
-  intern_string_logs_.clear();
+  intern_string_logs->clear();
 }
 
 void Transaction::VisitRoots(RootVisitor* visitor) {
@@ -28,13 +28,16 @@
 
 #include <list>
 #include <map>
+#include <vector>
 
 namespace art {
 namespace mirror {
 class Array;
+class Class;
 class Object;
 class String;
 }
+class ArtField;
 class InternTable;
 
 class Transaction FINAL {
@@ -43,8 +46,34 @@ class Transaction FINAL {
   static constexpr const char* kAbortExceptionSignature = "Ldalvik/system/TransactionAbortError;";
 
   Transaction();
+  // A strict transaction is used to initialize app image classes. The class initializer may only
+  // modify objects that end up in the app image and may not depend on mutable boot image state.
+  explicit Transaction(bool strict);
   ~Transaction();
 
+  bool IsStrict() const {
+    return strict_;
+  }
+
+  // Returns true if a strict transaction may not read the static field. Non-final statics of
+  // boot image classes can have a different value at runtime.
+  bool ReadConstraint(ArtField* field) SHARED_REQUIRES(Locks::mutator_lock_);
+
+  // Returns true if a strict transaction may not read the fields of `obj` without going through
+  // an ArtField, as Unsafe does. The static fields of boot image classes are read this way.
+  bool ReadConstraint(mirror::Object* obj) SHARED_REQUIRES(Locks::mutator_lock_);
+
+  // Returns true if the transaction recorded a write to an object in the boot image. Such writes
+  // would be lost when the result is stored in an app image.
+  bool HasBootImageWrites()
+      REQUIRES(!log_lock_)
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
+  // Adds the classes whose status or static fields the transaction wrote to `classes`.
+  void GetWrittenClasses(std::vector<mirror::Class*>* classes)
+      REQUIRES(!log_lock_)
+      SHARED_REQUIRES(Locks::mutator_lock_);
+
   void Abort(const std::string& abort_message)
       REQUIRES(!log_lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
@@ -83,16 +112,12 @@ class Transaction FINAL {
 
   // Record intern string table changes.
   void RecordStrongStringInsertion(mirror::String* s)
-      REQUIRES(Locks::intern_table_lock_)
       REQUIRES(!log_lock_);
   void RecordWeakStringInsertion(mirror::String* s)
-      REQUIRES(Locks::intern_table_lock_)
       REQUIRES(!log_lock_);
   void RecordStrongStringRemoval(mirror::String* s)
-      REQUIRES(Locks::intern_table_lock_)
       REQUIRES(!log_lock_);
   void RecordWeakStringRemoval(mirror::String* s)
-      REQUIRES(Locks::intern_table_lock_)
       REQUIRES(!log_lock_);
 
   // Abort transaction by undoing all recorded changes.
@@ -182,8 +207,7 @@ class Transaction FINAL {
     }
 
     void Undo(InternTable* intern_table)
-        SHARED_REQUIRES(Locks::mutator_lock_)
-        REQUIRES(Locks::intern_table_lock_);
+        SHARED_REQUIRES(Locks::mutator_lock_);
     void VisitRoots(RootVisitor* visitor) SHARED_REQUIRES(Locks::mutator_lock_);
 
    private:
@@ -193,7 +217,6 @@ class Transaction FINAL {
   };
 
   void LogInternedString(const InternStringLog& log)
-      REQUIRES(Locks::intern_table_lock_)
       REQUIRES(!log_lock_);
 
   void UndoObjectModifications()
@@ -202,9 +225,10 @@ class Transaction FINAL {
   void UndoArrayModifications()
       REQUIRES(log_lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
-  void UndoInternStringTableModifications()
-      REQUIRES(Locks::intern_table_lock_)
-      REQUIRES(log_lock_)
+  // The intern table shard locks are acquired before log_lock_ when recording, so the intern
+  // string logs are undone after releasing it.
+  void UndoInternStringTableModifications(std::list<InternStringLog>* intern_string_logs)
+      REQUIRES(!log_lock_)
       SHARED_REQUIRES(Locks::mutator_lock_);
 
   void VisitObjectLogs(RootVisitor* visitor)
@@ -224,6 +248,7 @@ class Transaction FINAL {
   std::map<mirror::Array*, ArrayLog> array_logs_  GUARDED_BY(log_lock_);
   std::list<InternStringLog> intern_string_logs_ GUARDED_BY(log_lock_);
   bool aborted_ GUARDED_BY(log_lock_);
+  const bool strict_;
   std::string abort_message_ GUARDED_BY(log_lock_);
 
   DISALLOW_COPY_AND_ASSIGN(Transaction);
@@ -28,7 +28,7 @@ namespace art {
 class TransactionTest : public CommonRuntimeTest {
  public:
   // Tests failing class initialization due to native call with transaction rollback.
-  void testTransactionAbort(const char* tested_class_signature) {
+  void testTransactionAbort(const char* tested_class_signature, bool strict = false) {
     ScopedObjectAccess soa(Thread::Current());
     jobject jclass_loader = LoadDex("Transaction");
     StackHandleScope<2> hs(soa.Self());
@@ -68,7 +68,7 @@ class TransactionTest : public CommonRuntimeTest {
     mirror::Class::Status old_status = h_klass->GetStatus();
     LockWord old_lock_word = h_klass->GetLockWord(false);
 
-    Transaction transaction;
+    Transaction transaction(strict);
     Runtime::Current()->EnterTransactionMode(&transaction);
     bool success = class_linker_->EnsureInitialized(soa.Self(), h_klass, true, true);
     Runtime::Current()->ExitTransactionMode();
@@ -556,4 +556,62 @@ TEST_F(TransactionTest, MultipleNativeCallAbortClass) {
 TEST_F(TransactionTest, FinalizableAbortClass) {
   testTransactionAbort("LTransaction$FinalizableAbortClass;");
 }
+
+// Tests that strict transactions detect writes to boot image objects.
+TEST_F(TransactionTest, StrictBootImageWrites) {
+  ScopedObjectAccess soa(Thread::Current());
+  StackHandleScope<2> hs(soa.Self());
+  Handle<mirror::Class> h_klass(
+      hs.NewHandle(class_linker_->FindSystemClass(soa.Self(), "Ljava/lang/Object;")));
+  ASSERT_TRUE(h_klass.Get() != nullptr);
+  ASSERT_TRUE(Runtime::Current()->GetHeap()->ObjectIsInBootImageSpace(h_klass.Get()));
+  Handle<mirror::Object> h_obj(hs.NewHandle(h_klass->AllocObject(soa.Self())));
+  ASSERT_TRUE(h_obj.Get() != nullptr);
+
+  Transaction transaction(/* strict */ true);
+  EXPECT_TRUE(transaction.IsStrict());
+  transaction.RecordWriteField32(h_obj.Get(), mirror::Object::MonitorOffset(), 0u, false);
+  EXPECT_FALSE(transaction.HasBootImageWrites());
+  transaction.RecordWriteField32(h_klass.Get(), mirror::Class::StatusOffset(), 0u, false);
+  EXPECT_TRUE(transaction.HasBootImageWrites());
+}
+
+// Tests that a strict transaction aborts the initialization of a class reading a non-final
+// static field of a boot image class.
+TEST_F(TransactionTest, StrictBootImageStaticReadAbortClass) {
+  testTransactionAbort("LTransaction$BootImageStaticReadClass;", /* strict */ true);
+}
+
+// Tests that the initialization of a class writing a static field of a boot image class in a
+// strict transaction is rolled back, as the compiler driver does.
+TEST_F(TransactionTest, StrictBootImageStaticWriteClass) {
+  ScopedObjectAccess soa(Thread::Current());
+  jobject jclass_loader = LoadDex("Transaction");
+  StackHandleScope<2> hs(soa.Self());
+  Handle<mirror::ClassLoader> class_loader(
+      hs.NewHandle(soa.Decode<mirror::ClassLoader*>(jclass_loader)));
+  ASSERT_TRUE(class_loader.Get() != nullptr);
+
+  Handle<mirror::Class> h_klass(
+      hs.NewHandle(class_linker_->FindClass(soa.Self(),
+                                            "LTransaction$BootImageStaticWriteClass;",
+                                            class_loader)));
+  ASSERT_TRUE(h_klass.Get() != nullptr);
+  class_linker_->VerifyClass(soa.Self(), h_klass);
+  ASSERT_TRUE(h_klass->IsVerified());
+  mirror::Class::Status old_status = h_klass->GetStatus();
+
+  Transaction transaction(/* strict */ true);
+  Runtime::Current()->EnterTransactionMode(&transaction);
+  bool success = class_linker_->EnsureInitialized(soa.Self(), h_klass, true, true);
+  Runtime::Current()->ExitTransactionMode();
+  ASSERT_TRUE(success);
+  ASSERT_FALSE(transaction.IsAborted());
+  ASSERT_TRUE(transaction.HasBootImageWrites());
+
+  transaction.Rollback();
+  ASSERT_EQ(old_status, h_klass->GetStatus());
+  ASSERT_FALSE(h_klass->IsInitialized());
+}
+
 }  // namespace art
@@ -23,6 +23,7 @@
 #include "base/logging.h"
 #include "gc_root.h"
 #include "globals.h"
+#include "mirror/dex_cache.h"
 #include "primitive.h"
 
 namespace art {
@@ -83,11 +84,17 @@ inline size_t DexCacheArraysLayout::MethodsAlignment() const {
 }
 
 inline size_t DexCacheArraysLayout::StringOffset(uint32_t string_idx) const {
-  return strings_offset_ + ElementOffset(sizeof(GcRoot<mirror::String>), string_idx);
+  return strings_offset_ +
+      ElementOffset(sizeof(GcRoot<mirror::String>), mirror::DexCache::StringSlot(string_idx));
 }
 
 inline size_t DexCacheArraysLayout::StringsSize(size_t num_elements) const {
-  return ArraySize(sizeof(GcRoot<mirror::String>), num_elements);
+  // Hashed strings arrays are followed by one 32-bit tag per slot.
+  size_t num_slots = mirror::DexCache::NumStringSlots(num_elements);
+  size_t size = ArraySize(sizeof(GcRoot<mirror::String>), num_slots);
+  return mirror::DexCache::UseHashedStrings(num_elements)
+      ? size + ArraySize(sizeof(uint32_t), num_slots)
+      : size;
 }
 
 inline size_t DexCacheArraysLayout::StringsAlignment() const {
@@ -95,11 +102,16 @@ inline size_t DexCacheArraysLayout::StringsAlignment() const {
 }
 
 inline size_t DexCacheArraysLayout::FieldOffset(uint32_t field_idx) const {
-  return fields_offset_ + ElementOffset(pointer_size_, field_idx);
+  return fields_offset_ + ElementOffset(pointer_size_, mirror::DexCache::FieldSlot(field_idx));
 }
 
 inline size_t DexCacheArraysLayout::FieldsSize(size_t num_elements) const {
-  return ArraySize(pointer_size_, num_elements);
+  // Hashed fields arrays are followed by one 32-bit tag per slot.
+  size_t num_slots = mirror::DexCache::NumFieldSlots(num_elements);
+  size_t size = ArraySize(pointer_size_, num_slots);
+  return mirror::DexCache::UseHashedFields(num_elements)
+      ? size + ArraySize(sizeof(uint32_t), num_slots)
+      : size;
 }
 
 inline size_t DexCacheArraysLayout::FieldsAlignment() const {
@@ -78,6 +78,7 @@ class DexCacheArraysLayout {
     return strings_offset_;
   }
 
+  // Offset of the slot of string_idx, see mirror::DexCache::kDexCacheStringCacheSize.
   size_t StringOffset(uint32_t string_idx) const;
 
   size_t StringsSize(size_t num_elements) const;
@@ -88,6 +89,7 @@ class DexCacheArraysLayout {
     return fields_offset_;
   }
 
+  // Offset of the slot of field_idx, see mirror::DexCache::kDexCacheFieldCacheSize.
   size_t FieldOffset(uint32_t field_idx) const;
 
   size_t FieldsSize(size_t num_elements) const;
@@ -23,6 +23,7 @@
 #include <unistd.h>
 #include <vector>
 
+#include "base/bit_utils.h"
 #include "base/stringprintf.h"
 #include "base/unix_file/fd_file.h"
 
@@ -36,6 +37,15 @@ uint32_t ZipEntry::GetCrc32() {
   return zip_entry_->crc32;
 }
 
+bool ZipEntry::IsUncompressed() {
+  return zip_entry_->method == kCompressStored;
+}
+
+bool ZipEntry::IsAlignedTo(size_t alignment) {
+  DCHECK(IsPowerOfTwo(alignment)) << alignment;
+  return IsAlignedParam(zip_entry_->offset, static_cast<int>(alignment));
+}
+
 ZipEntry::~ZipEntry() {
   delete zip_entry_;
 }
@@ -74,6 +84,47 @@ MemMap* ZipEntry::ExtractToMemMap(const char* zip_filename, const char* entry_fi
   return map.release();
 }
 
+MemMap* ZipEntry::MapDirectlyFromFile(const char* zip_filename, std::string* error_msg) {
+  if (!IsUncompressed()) {
+    *error_msg = StringPrintf("Cannot map '%s' directly because it is compressed.", zip_filename);
+    return nullptr;
+  }
+  std::string name(zip_filename);
+  name += " mapped directly in memory";
+  // The mapping is private and read-only, it stays valid after the zip archive is closed.
+  int zip_fd = GetFileDescriptor(handle_);
+  std::unique_ptr<MemMap> map(MemMap::MapFile(GetUncompressedLength(),
+                                              PROT_READ,
+                                              MAP_PRIVATE,
+                                              zip_fd,
+                                              zip_entry_->offset,
+                                              /* low_4gb */ false,
+                                              name.c_str(),
+                                              error_msg));
+  if (map == nullptr) {
+    DCHECK(!error_msg->empty());
+    return nullptr;
+  }
+  return map.release();
+}
+
+MemMap* ZipEntry::MapDirectlyOrExtract(const char* zip_filename,
+                                       const char* entry_filename,
+                                       size_t alignment,
+                                       std::string* error_msg) {
+  if (IsUncompressed() && IsAlignedTo(alignment)) {
+    MemMap* map = MapDirectlyFromFile(zip_filename, error_msg);
+    if (map != nullptr) {
+      return map;
+    }
+    // Fall back to extracting the entry.
+    LOG(WARNING) << "Failed to map '" << entry_filename << "' directly from '" << zip_filename
+                 << "': " << *error_msg;
+    error_msg->clear();
+  }
+  return ExtractToMemMap(zip_filename, entry_filename, error_msg);
+}
+
 static void SetCloseOnExec(int fd) {
   // This dance is more portable than Linux's O_CLOEXEC open(2) flag.
   int flags = fcntl(fd, F_GETFD);
@@ -41,9 +41,23 @@ class ZipEntry {
                           std::string* error_msg);
   virtual ~ZipEntry();
 
+  // Map the data of an uncompressed entry in place from the zip file, without copying it.
+  // The CRC32 of the entry is not checked.
+  MemMap* MapDirectlyFromFile(const char* zip_filename, std::string* error_msg);
+
+  // Map the entry in place if it is uncompressed and aligned to `alignment` in the zip file,
+  // otherwise extract it to memory.
+  MemMap* MapDirectlyOrExtract(const char* zip_filename,
+                               const char* entry_filename,
+                               size_t alignment,
+                               std::string* error_msg);
+
   uint32_t GetUncompressedLength();
   uint32_t GetCrc32();
 
+  bool IsUncompressed();
+  bool IsAlignedTo(size_t alignment);
+
  private:
   ZipEntry(ZipArchiveHandle handle,
            ::ZipEntry* zip_entry) : handle_(handle), zip_entry_(zip_entry) {}
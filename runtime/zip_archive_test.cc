@@ -21,14 +21,116 @@
 #include <sys/types.h>
 #include <zlib.h>
 #include <memory>
+#include <vector>
 
+#include "base/bit_utils.h"
 #include "base/unix_file/fd_file.h"
 #include "common_runtime_test.h"
 #include "os.h"
 
 namespace art {
 
-class ZipArchiveTest : public CommonRuntimeTest {};
+class ZipArchiveTest : public CommonRuntimeTest {
+ protected:
+  static void Put16(std::vector<uint8_t>* data, uint16_t value) {
+    data->push_back(static_cast<uint8_t>(value));
+    data->push_back(static_cast<uint8_t>(value >> 8));
+  }
+
+  static void Put32(std::vector<uint8_t>* data, uint32_t value) {
+    Put16(data, static_cast<uint16_t>(value));
+    Put16(data, static_cast<uint16_t>(value >> 16));
+  }
+
+  // Returns a zip file with a single entry stored uncompressed, whose data starts at an offset
+  // that is a multiple of `alignment` plus `misalignment`.
+  static std::vector<uint8_t> MakeStoredZip(const std::string& name,
+                                            const std::vector<uint8_t>& content,
+                                            size_t alignment,
+                                            size_t misalignment) {
+    const uint32_t crc = crc32(crc32(0L, Z_NULL, 0), content.data(), content.size());
+    const size_t header_size = 30u + name.size();
+    const size_t extra_size = RoundUp(header_size, alignment) - header_size + misalignment;
+    std::vector<uint8_t> zip;
+    // Local file header.
+    Put32(&zip, 0x04034b50u);
+    Put16(&zip, 10u);  // Version needed to extract.
+    Put16(&zip, 0u);  // Flags.
+    Put16(&zip, 0u);  // Stored.
+    Put32(&zip, 0u);  // Modification time and date.
+    Put32(&zip, crc);
+    Put32(&zip, content.size());
+    Put32(&zip, content.size());
+    Put16(&zip, name.size());
+    Put16(&zip, extra_size);
+    zip.insert(zip.end(), name.begin(), name.end());
+    zip.insert(zip.end(), extra_size, 0u);
+    zip.insert(zip.end(), content.begin(), content.end());
+    // Central directory.
+    const uint32_t central_directory_offset = zip.size();
+    Put32(&zip, 0x02014b50u);
+    Put16(&zip, 10u);  // Version made by.
+    Put16(&zip, 10u);  // Version needed to extract.
+    Put16(&zip, 0u);  // Flags.
+    Put16(&zip, 0u);  // Stored.
+    Put32(&zip, 0u);  // Modification time and date.
+    Put32(&zip, crc);
+    Put32(&zip, content.size());
+    Put32(&zip, content.size());
+    Put16(&zip, name.size());
+    Put16(&zip, 0u);  // Extra field length.
+    Put16(&zip, 0u);  // Comment length.
+    Put16(&zip, 0u);  // Disk number.
+    Put16(&zip, 0u);  // Internal attributes.
+    Put32(&zip, 0u);  // External attributes.
+    Put32(&zip, 0u);  // Offset of the local file header.
+    zip.insert(zip.end(), name.begin(), name.end());
+    const uint32_t central_directory_size = zip.size() - central_directory_offset;
+    // End of central directory.
+    Put32(&zip, 0x06054b50u);
+    Put16(&zip, 0u);  // Disk number.
+    Put16(&zip, 0u);  // Disk with the central directory.
+    Put16(&zip, 1u);  // Entries on this disk.
+    Put16(&zip, 1u);  // Entries.
+    Put32(&zip, central_directory_size);
+    Put32(&zip, central_directory_offset);
+    Put16(&zip, 0u);  // Comment length.
+    return zip;
+  }
+
+  void TestMapDirectlyOrExtract(size_t misalignment, bool expect_direct_map) {
+    std::vector<uint8_t> content(3 * kPageSize + 42u);
+    for (size_t i = 0; i != content.size(); ++i) {
+      content[i] = static_cast<uint8_t>(i * 7u);
+    }
+    std::vector<uint8_t> zip = MakeStoredZip("classes.dex", content, 4u, misalignment);
+    ScratchFile tmp;
+    ASSERT_TRUE(tmp.GetFile()->WriteFully(zip.data(), zip.size()));
+    ASSERT_EQ(0, tmp.GetFile()->Flush());
+
+    std::string error_msg;
+    std::unique_ptr<ZipArchive> zip_archive(
+        ZipArchive::Open(tmp.GetFilename().c_str(), &error_msg));
+    ASSERT_TRUE(zip_archive != nullptr) << error_msg;
+    std::unique_ptr<ZipEntry> zip_entry(zip_archive->Find("classes.dex", &error_msg));
+    ASSERT_TRUE(zip_entry != nullptr) << error_msg;
+    EXPECT_TRUE(zip_entry->IsUncompressed());
+    EXPECT_EQ(misalignment == 0u, zip_entry->IsAlignedTo(4u));
+
+    std::unique_ptr<MemMap> map(zip_entry->MapDirectlyOrExtract(tmp.GetFilename().c_str(),
+                                                                "classes.dex",
+                                                                4u,
+                                                                &error_msg));
+    ASSERT_TRUE(map != nullptr) << error_msg;
+    // A direct mapping is read only, an extracted copy is writable.
+    EXPECT_EQ(expect_direct_map, map->GetProtect() == PROT_READ);
+    // The map outlives the archive.
+    zip_entry.reset();
+    zip_archive.reset();
+    ASSERT_EQ(content.size(), map->Size());
+    EXPECT_EQ(0, memcmp(content.data(), map->Begin(), content.size()));
+  }
+};
 
 TEST_F(ZipArchiveTest, FindAndExtract) {
   std::string error_msg;
@@ -63,4 +165,12 @@ TEST_F(ZipArchiveTest, FindAndExtract) {
   EXPECT_EQ(zip_entry->GetCrc32(), computed_crc);
 }
 
+TEST_F(ZipArchiveTest, MapDirectly) {
+  TestMapDirectlyOrExtract(/* misalignment */ 0u, /* expect_direct_map */ true);
+}
+
+TEST_F(ZipArchiveTest, ExtractUnaligned) {
+  TestMapDirectlyOrExtract(/* misalignment */ 1u, /* expect_direct_map */ false);
+}
+
 }  // namespace art
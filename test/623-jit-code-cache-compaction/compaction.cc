@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+
+#include "art_method-inl.h"
+#include "jit/jit.h"
+#include "jit/jit_code_cache.h"
+#include "mirror/class-inl.h"
+#include "scoped_thread_state_change.h"
+#include "ScopedUtfChars.h"
+
+namespace art {
+
+extern "C" JNIEXPORT jboolean JNICALL Java_Main_hasJit(JNIEnv*, jclass) {
+  return Runtime::Current()->UseJitCompilation();
+}
+
+extern "C" JNIEXPORT jboolean JNICALL Java_Main_isJitCompiled(JNIEnv* env,
+                                                              jclass,
+                                                              jclass cls,
+                                                              jstring method_name) {
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  if (jit == nullptr) {
+    return false;
+  }
+  ScopedUtfChars chars(env, method_name);
+  CHECK(chars.c_str() != nullptr);
+  ScopedObjectAccess soa(Thread::Current());
+  mirror::Class* klass = soa.Decode<mirror::Class*>(cls);
+  ArtMethod* method = klass->FindDeclaredDirectMethodByName(chars.c_str(), sizeof(void*));
+  CHECK(method != nullptr) << chars.c_str();
+  return jit->GetCodeCache()->ContainsMethod(method);
+}
+
+extern "C" JNIEXPORT void JNICALL Java_Main_collectCodeCache(JNIEnv*, jclass) {
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  if (jit == nullptr) {
+    return;
+  }
+  ScopedObjectAccess soa(Thread::Current());
+  jit->GetCodeCache()->GarbageCollectCache(soa.Self());
+}
+
+// Return the value of the counter printed as "<name>: <value>" by Jit::DumpInfo.
+extern "C" JNIEXPORT jlong JNICALL Java_Main_getCodeCacheCounter(JNIEnv* env,
+                                                                 jclass,
+                                                                 jstring name) {
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  if (jit == nullptr) {
+    return 0;
+  }
+  ScopedUtfChars chars(env, name);
+  CHECK(chars.c_str() != nullptr);
+  std::ostringstream oss;
+  jit->DumpInfo(oss);
+  std::string info = oss.str();
+  std::string prefix = std::string(chars.c_str()) + ": ";
+  size_t pos = info.find(prefix);
+  CHECK_NE(pos, std::string::npos) << prefix << " not found in\n" << info;
+  return strtoll(info.c_str() + pos + prefix.size(), nullptr, 10);
+}
+
+}  // namespace art
@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Loaded by a separate class loader for each method of the warm and cold sets, so that the JIT
+// compiles its method once per class loader.
+public class Code {
+  public static int $noinline$compute(int x) {
+    x = x * 31 + 1; x ^= x >>> 3; x = x * 37 - 1; x ^= x << 1;
+    x = x * 33 + 2; x ^= x >>> 4; x = x * 39 - 2; x ^= x << 2;
+    x = x * 35 + 3; x ^= x >>> 5; x = x * 41 - 3; x ^= x << 3;
+    x = x * 37 + 4; x ^= x >>> 6; x = x * 43 - 4; x ^= x << 4;
+    x = x * 39 + 5; x ^= x >>> 7; x = x * 45 - 5; x ^= x << 5;
+    x = x * 41 + 6; x ^= x >>> 3; x = x * 47 - 6; x ^= x << 6;
+    x = x * 43 + 7; x ^= x >>> 4; x = x * 49 - 7; x ^= x << 7;
+    x = x * 45 + 8; x ^= x >>> 5; x = x * 51 - 8; x ^= x << 1;
+    x = x * 47 + 9; x ^= x >>> 6; x = x * 53 - 9; x ^= x << 2;
+    x = x * 49 + 10; x ^= x >>> 7; x = x * 55 - 10; x ^= x << 3;
+    return x;
+  }
+}
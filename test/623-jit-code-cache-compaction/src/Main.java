@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.lang.reflect.Method;
+
+import dalvik.system.PathClassLoader;
+
+public class Main {
+  static final String DEX_FILE =
+      System.getenv("DEX_LOCATION") + "/623-jit-code-cache-compaction-ex.jar";
+
+  // JitCodeCache::kMaxCodeAge.
+  static final int MAX_CODE_AGE = 3;
+
+  // The cold and the warm methods are compiled in turn, so that evicting the cold ones leaves
+  // holes between the warm ones that the code cache compacts.
+  static final int NUM_METHODS = 24;
+
+  static boolean hasJit;
+
+  // Each Code class comes from its own class loader and has its own compiled method.
+  static Class<?>[] coldClasses = new Class<?>[NUM_METHODS];
+  static Class<?>[] warmClasses = new Class<?>[NUM_METHODS];
+  static Method[] warmMethods = new Method[NUM_METHODS];
+
+  public static void main(String[] args) throws Exception {
+    System.loadLibrary(args[0]);
+    hasJit = hasJit();
+
+    for (int i = 0; i < NUM_METHODS; ++i) {
+      coldClasses[i] = loadCode();
+      warmClasses[i] = loadCode();
+      warmMethods[i] = warmClasses[i].getDeclaredMethod("$noinline$compute", int.class);
+    }
+
+    int expected = $noinline$callWarmMethods(42);
+    for (int i = 0; i < NUM_METHODS; ++i) {
+      ensureJitCompiled(coldClasses[i], "$noinline$compute");
+      ensureJitCompiled(warmClasses[i], "$noinline$compute");
+    }
+    ensureJitCompiled(Main.class, "$noinline$runCollections");
+
+    long evictions = getCodeCacheCounter("Total number of JIT code evictions");
+    long compactions = getCodeCacheCounter("Total number of JIT code cache compactions");
+    long moved = getCodeCacheCounter("Total number of JIT compiled methods moved by compactions");
+
+    // The collections run with the compiled code of $noinline$runCollections on the stack.
+    int result = $noinline$runCollections(42);
+    if (result != MAX_CODE_AGE * expected) {
+      System.out.println("Unexpected result " + result + ", expected " + MAX_CODE_AGE * expected);
+    }
+    checkMethods("warm", warmClasses, true);
+    checkMethods("cold", coldClasses, false);
+    if ($noinline$callWarmMethods(42) != expected) {
+      System.out.println("Unexpected result of the warm methods after compaction");
+    }
+
+    if (hasJit) {
+      if (getCodeCacheCounter("Total number of JIT code evictions") < evictions + NUM_METHODS) {
+        System.out.println("The cold methods were not counted as evicted");
+      }
+      if (getCodeCacheCounter("Total number of JIT code cache compactions") == compactions) {
+        System.out.println("The code cache was not compacted");
+      }
+      if (getCodeCacheCounter("Total number of JIT compiled methods moved by compactions")
+              < moved + NUM_METHODS) {
+        System.out.println("The warm methods were not counted as moved");
+      }
+    }
+
+    if ($noinline$osrLoop(100000) != 100000) {
+      System.out.println("Unexpected result of the OSR loop");
+    }
+    System.out.println("passed");
+  }
+
+  static Class<?> loadCode() throws Exception {
+    ClassLoader loader = new PathClassLoader(DEX_FILE, Main.class.getClassLoader());
+    return loader.loadClass("Code");
+  }
+
+  // Collections alternate between partial and full ones below the maximum capacity of the code
+  // cache. The partial collection starts polling the liveness of the compiled code, and the full
+  // collection that follows ages and evicts the code that was not used in between.
+  public static int $noinline$runCollections(int x) throws Exception {
+    int sum = 0;
+    for (int age = 1; age <= MAX_CODE_AGE; ++age) {
+      collectCodeCache();
+      sum += $noinline$callWarmMethods(x);
+      collectCodeCache();
+      if (age < MAX_CODE_AGE) {
+        // Unused code younger than kMaxCodeAge is kept.
+        checkMethods("cold", coldClasses, true);
+      }
+      checkMethods("warm", warmClasses, true);
+    }
+    return sum;
+  }
+
+  static void checkMethods(String name, Class<?>[] classes, boolean expectCompiled) {
+    if (!hasJit) {
+      return;
+    }
+    for (int i = 0; i < NUM_METHODS; ++i) {
+      if (isJitCompiled(classes[i], "$noinline$compute") != expectCompiled) {
+        System.out.println(name + i + (expectCompiled ? " was evicted" : " was not evicted"));
+      }
+    }
+  }
+
+  public static int $noinline$osrLoop(int n) {
+    int i = 0;
+    for (; i < n; ++i) {
+    }
+    // Check that code compiled after the compaction can be entered on stack replacement.
+    if (isInInterpreter("$noinline$osrLoop")) {
+      ensureHasProfilingInfo("$noinline$osrLoop");
+      ensureHasOsrCode("$noinline$osrLoop");
+      while (!isInOsrCode("$noinline$osrLoop")) {}
+    }
+    return i;
+  }
+
+  public static int $noinline$callWarmMethods(int x) throws Exception {
+    int sum = 0;
+    for (Method method : warmMethods) {
+      sum += (Integer) method.invoke(null, x);
+    }
+    return sum;
+  }
+
+  public static native boolean hasJit();
+  public static native void ensureJitCompiled(Class<?> cls, String methodName);
+  public static native boolean isJitCompiled(Class<?> cls, String methodName);
+  public static native void collectCodeCache();
+  public static native long getCodeCacheCounter(String name);
+  public static native boolean isInInterpreter(String methodName);
+  public static native void ensureHasProfilingInfo(String methodName);
+  public static native void ensureHasOsrCode(String methodName);
+  public static native boolean isInOsrCode(String methodName);
+}
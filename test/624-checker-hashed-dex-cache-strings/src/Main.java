@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+
+  public static boolean doThrow = false;
+
+  // The generated Strings class gives this dex file a hashed dex cache strings array. Strings
+  // that are not in the boot image are then loaded via the method, and the compiled code checks
+  // the tag of the slot before and after loading the string instead of calling the runtime.
+
+  /// CHECK-START: java.lang.String Main.$noinline$getString() sharpening (after)
+  /// CHECK:                LoadString load_kind:DexCacheViaMethod
+
+  /// CHECK-START-X86: java.lang.String Main.$noinline$getString() disassembly (after)
+  /// CHECK:                LoadString load_kind:DexCacheViaMethod
+  /// CHECK-NOT:            jmp
+  /// CHECK:                Return
+
+  /// CHECK-START-X86_64: java.lang.String Main.$noinline$getString() disassembly (after)
+  /// CHECK:                LoadString load_kind:DexCacheViaMethod
+  /// CHECK-NOT:            jmp
+  /// CHECK:                Return
+
+  /// CHECK-START-ARM: java.lang.String Main.$noinline$getString() disassembly (after)
+  /// CHECK:                LoadString load_kind:DexCacheViaMethod
+  /// CHECK-NOT:            Return
+  /// CHECK:                dmb
+  /// CHECK-NOT:            Return
+  /// CHECK:                dmb
+  /// CHECK:                Return
+
+  /// CHECK-START-ARM64: java.lang.String Main.$noinline$getString() disassembly (after)
+  /// CHECK:                LoadString load_kind:DexCacheViaMethod
+  /// CHECK-NOT:            Return
+  /// CHECK:                dmb
+  /// CHECK-NOT:            Return
+  /// CHECK:                dmb
+  /// CHECK:                Return
+
+  public static String $noinline$getString() {
+    // Prevent inlining.
+    if (doThrow) { throw new Error(); }
+    return "hashed-dex-cache-string";
+  }
+
+  public static String $noinline$getGeneratedString() {
+    // Prevent inlining.
+    if (doThrow) { throw new Error(); }
+    return Strings.s1099;
+  }
+
+  public static void main(String[] args) {
+    // The first call resolves the string through the runtime, the second one finds it in the
+    // dex cache. Both must return the same string.
+    String first = $noinline$getString();
+    String second = $noinline$getString();
+    if (first != second) {
+      throw new Error("Expected the same string");
+    }
+    System.out.println(second);
+    System.out.println($noinline$getGeneratedString());
+  }
+}
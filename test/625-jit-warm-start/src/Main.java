@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+  public static void main(String[] args) throws Exception {
+    System.loadLibrary(args[0]);
+    boolean warm = args[1].equals("warm");
+
+    if (hasJit()) {
+      if (!warm) {
+        // Compiled by the JIT and written to the warm start file when the runtime shuts down.
+        ensureJitCompiled(Main.class, "$noinline$recorded");
+      } else {
+        // A single call without a loop stays far below the hot threshold, only the warm start
+        // file gets the method compiled.
+        if ($noinline$recorded(21) != 42) {
+          System.out.println("Unexpected result");
+        }
+        for (int i = 0; i < 1000 && !isJitCompiled(Main.class, "$noinline$recorded"); ++i) {
+          Thread.sleep(10);
+        }
+        if (!isJitCompiled(Main.class, "$noinline$recorded")) {
+          System.out.println("The recorded method was not compiled at its first use");
+        }
+        if (getWarmStartCompilations() == 0) {
+          System.out.println("No warm start compilation was counted");
+        }
+        // The method not compiled by the first run goes through the regular thresholds.
+        if ($noinline$notRecorded(21) != 42) {
+          System.out.println("Unexpected result");
+        }
+        if (isJitCompiled(Main.class, "$noinline$notRecorded")) {
+          System.out.println("An unrecorded method was compiled at its first use");
+        }
+      }
+    }
+    System.out.println("passed");
+  }
+
+  public static int $noinline$recorded(int value) {
+    return value * 2;
+  }
+
+  public static int $noinline$notRecorded(int value) {
+    return value * 2;
+  }
+
+  private static native boolean hasJit();
+  private static native void ensureJitCompiled(Class<?> cls, String methodName);
+  private static native boolean isJitCompiled(Class<?> cls, String methodName);
+  private static native long getWarmStartCompilations();
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <sstream>
+
+#include "jit/jit.h"
+#include "jni.h"
+#include "runtime.h"
+
+namespace art {
+
+// Return the number of methods compiled at their first use because the warm start file lists
+// them, as printed by Jit::DumpInfo.
+extern "C" JNIEXPORT jlong JNICALL Java_Main_getWarmStartCompilations(JNIEnv*, jclass) {
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  if (jit == nullptr) {
+    return 0;
+  }
+  std::ostringstream oss;
+  jit->DumpInfo(oss);
+  std::string info = oss.str();
+  static constexpr const char* kPrefix = "Warm start compilations=";
+  size_t pos = info.find(kPrefix);
+  CHECK_NE(pos, std::string::npos) << kPrefix << " not found in\n" << info;
+  return strtoll(info.c_str() + pos + strlen(kPrefix), nullptr, 10);
+}
+
+}  // namespace art
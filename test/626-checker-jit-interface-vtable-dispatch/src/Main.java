@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The padding methods sort after `callee`, so that the last one has a dex method index 64
+// above it and takes the same IMT slot for IMT sizes up to 64. The IMT of the receivers then
+// holds a conflict method for `callee`.
+interface Itf {
+  int callee();
+  void m0();
+  void m1();
+  void m2();
+  void m3();
+  void m4();
+  void m5();
+  void m6();
+  void m7();
+  void m8();
+  void m9();
+  void m10();
+  void m11();
+  void m12();
+  void m13();
+  void m14();
+  void m15();
+  void m16();
+  void m17();
+  void m18();
+  void m19();
+  void m20();
+  void m21();
+  void m22();
+  void m23();
+  void m24();
+  void m25();
+  void m26();
+  void m27();
+  void m28();
+  void m29();
+  void m30();
+  void m31();
+  void m32();
+  void m33();
+  void m34();
+  void m35();
+  void m36();
+  void m37();
+  void m38();
+  void m39();
+  void m40();
+  void m41();
+  void m42();
+  void m43();
+  void m44();
+  void m45();
+  void m46();
+  void m47();
+  void m48();
+  void m49();
+  void m50();
+  void m51();
+  void m52();
+  void m53();
+  void m54();
+  void m55();
+  void m56();
+  void m57();
+  void m58();
+  void m59();
+  void m60();
+  void m61();
+  void m62();
+  void m63();
+}
+
+class Base implements Itf {
+  public int callee() {
+    return 44;
+  }
+  public void m0() {}
+  public void m1() {}
+  public void m2() {}
+  public void m3() {}
+  public void m4() {}
+  public void m5() {}
+  public void m6() {}
+  public void m7() {}
+  public void m8() {}
+  public void m9() {}
+  public void m10() {}
+  public void m11() {}
+  public void m12() {}
+  public void m13() {}
+  public void m14() {}
+  public void m15() {}
+  public void m16() {}
+  public void m17() {}
+  public void m18() {}
+  public void m19() {}
+  public void m20() {}
+  public void m21() {}
+  public void m22() {}
+  public void m23() {}
+  public void m24() {}
+  public void m25() {}
+  public void m26() {}
+  public void m27() {}
+  public void m28() {}
+  public void m29() {}
+  public void m30() {}
+  public void m31() {}
+  public void m32() {}
+  public void m33() {}
+  public void m34() {}
+  public void m35() {}
+  public void m36() {}
+  public void m37() {}
+  public void m38() {}
+  public void m39() {}
+  public void m40() {}
+  public void m41() {}
+  public void m42() {}
+  public void m43() {}
+  public void m44() {}
+  public void m45() {}
+  public void m46() {}
+  public void m47() {}
+  public void m48() {}
+  public void m49() {}
+  public void m50() {}
+  public void m51() {}
+  public void m52() {}
+  public void m53() {}
+  public void m54() {}
+  public void m55() {}
+  public void m56() {}
+  public void m57() {}
+  public void m58() {}
+  public void m59() {}
+  public void m60() {}
+  public void m61() {}
+  public void m62() {}
+  public void m63() {}
+}
+
+class Inlined extends Base {
+  public int callee() {
+    return 42;
+  }
+}
+
+class Dispatched extends Base {
+  public int callee() {
+    // The try block keeps this method from being inlined.
+    try {
+      return Integer.parseInt("43");
+    } catch (NumberFormatException e) {
+      return -1;
+    }
+  }
+}
+
+class Other extends Base {
+}
+
+public class Main {
+  /// CHECK-START: int Main.$noinline$callCallee(Itf) inliner (before)
+  /// CHECK:                       InvokeInterface method_name:Itf.callee
+  /// CHECK-NOT:                   InvokeVirtual
+
+  /// CHECK-START: int Main.$noinline$callCallee(Itf) inliner (after)
+  /// CHECK-DAG:   <<Inlined:i\d+>>   IntConstant 42
+  /// CHECK-DAG:   <<Virtual:i\d+>>   InvokeVirtual method_name:Itf.callee
+  /// CHECK-DAG:   <<Interface:i\d+>> InvokeInterface method_name:Itf.callee
+  /// CHECK-DAG:   <<Dispatch:i\d+>>  Phi [<<Virtual>>,<<Interface>>]
+  /// CHECK-DAG:   <<Result:i\d+>>    Phi [<<Inlined>>,<<Dispatch>>]
+  /// CHECK-DAG:                       Return [<<Result>>]
+  public static int $noinline$callCallee(Itf itf) {
+    return itf.callee();
+  }
+
+  public static void main(String[] args) {
+    System.loadLibrary(args[0]);
+    ensureProfilingInfo626();
+
+    // The inline cache records Inlined first: its target is inlined. The target of Dispatched
+    // cannot be inlined and is called through the vtable instead of the IMT conflict table.
+    Itf inlined = new Inlined();
+    Itf dispatched = new Dispatched();
+    for (int i = 0; i < 100; ++i) {
+      expectEquals(42, $noinline$callCallee(inlined));
+      expectEquals(43, $noinline$callCallee(dispatched));
+    }
+    ensureJitCompiled(Main.class, "$noinline$callCallee");
+
+    expectEquals(42, $noinline$callCallee(inlined));
+    expectEquals(43, $noinline$callCallee(dispatched));
+    // Receivers missing from the inline cache take the interface call.
+    expectEquals(44, $noinline$callCallee(new Other()));
+    System.out.println("passed");
+  }
+
+  public static void expectEquals(int expected, int result) {
+    if (expected != result) {
+      throw new Error("Expected: " + expected + ", found: " + result);
+    }
+  }
+
+  private static native void ensureProfilingInfo626();
+  private static native void ensureJitCompiled(Class<?> cls, String methodName);
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "art_method-inl.h"
+#include "jit/jit.h"
+#include "jit/profiling_info.h"
+#include "mirror/class-inl.h"
+#include "scoped_thread_state_change.h"
+
+namespace art {
+
+// Create the profiling info of $noinline$callCallee before it runs, so that its inline cache
+// records the receivers of all calls.
+extern "C" JNIEXPORT void JNICALL Java_Main_ensureProfilingInfo626(JNIEnv*, jclass cls) {
+  if (Runtime::Current()->GetJit() == nullptr) {
+    return;
+  }
+  ScopedObjectAccess soa(Thread::Current());
+  mirror::Class* klass = soa.Decode<mirror::Class*>(cls);
+  ArtMethod* method = klass->FindDeclaredDirectMethodByName("$noinline$callCallee", sizeof(void*));
+  ProfilingInfo::Create(soa.Self(), method, /* retry_allocation */ true);
+}
+
+}  // namespace art
@@ -426,11 +426,18 @@ TEST_ART_BROKEN_FALLBACK_RUN_TESTS :=
 # 802 and 570-checker-osr:
 # This test dynamically enables tracing to force a deoptimization. This makes the test meaningless
 # when already tracing, and writes an error message that we do not want to check for.
+# 623-jit-code-cache-compaction:
+# The JIT code cache is not compacted while the instrumentation exit stubs are installed.
+# 625-jit-warm-start and 626-checker-jit-interface-vtable-dispatch:
+# The tests wait for JIT compiled code, which is not used while tracing.
 TEST_ART_BROKEN_TRACING_RUN_TESTS := \
   087-gc-after-link \
   137-cfi \
   141-class-unload \
   570-checker-osr \
+  623-jit-code-cache-compaction \
+  625-jit-warm-start \
+  626-checker-jit-interface-vtable-dispatch \
   802-deoptimization
 
 ifneq (,$(filter trace stream,$(TRACE_TYPES)))
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+class Value {
+    int get() {
+        return 2;
+    }
+}
+
+class Holder {
+    static Value value;
+}
+
+interface Factory {
+    Value create();
+}
+
+// Depends on Value only through the type of the field it loads.
+class FieldUser {
+    static Object field() {
+        return Holder.value;
+    }
+}
+
+// Depends on Value only through the return type of the method it calls.
+class ReturnUser {
+    static Object result(Factory factory) {
+        return factory.create();
+    }
+}
+
+class Unrelated {
+    static int run() {
+        return 42;
+    }
+}
@@ -25,6 +25,14 @@ public class Transaction {
       }
     }
 
+    static class AppImagePrunedClass {
+      public static Object emptyStatic;
+      static {
+        // EmptyStatic is not an app image class, so referencing it prunes this class.
+        emptyStatic = new EmptyStatic();
+      }
+    }
+
     static class FinalizableAbortClass {
       public static AbortHelperClass finalizableObject;
       static {
@@ -70,6 +78,21 @@ public class Transaction {
       }
     }
 
+    static class BootImageStaticReadClass {
+      public static Thread.UncaughtExceptionHandler handler;
+      static {
+        // Reads a non-final static field of the boot image class Thread.
+        handler = Thread.getDefaultUncaughtExceptionHandler();
+      }
+    }
+
+    static class BootImageStaticWriteClass {
+      static {
+        // Writes a non-final static field of the boot image class Thread.
+        Thread.setDefaultUncaughtExceptionHandler(null);
+      }
+    }
+
     // Helper class to abort transaction: finalizable class with natve methods.
     static class AbortHelperClass {
       public void finalize() throws Throwable {